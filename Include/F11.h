@@ -22,6 +22,12 @@
 #define RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_OPERATING   0
 #define RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_SLEEPING    1
 
+//
+// F11 packs two status bits per finger into at most three data registers
+// and cannot report more than ten contacts
+//
+#define RMI4_F11_MAX_FINGERS                           10
+
 typedef struct _RMI4_F11_QUERY0_REGISTERS
 {
 	BYTE NumberOfSensors : 3;
@@ -2,6 +2,7 @@
 
 #include <wdf.h>
 #include <wdm.h>
+#include "bitops.h"
 
 //
 // Defines from Synaptics RMI4 Data Sheet, please refer to
@@ -51,6 +52,17 @@ typedef enum _RMI4_F12_OBJECT_TYPE
 #define RMI_F12_REPORTING_MODE_MASK         7
 
 #define F12_2D_CTRL20   20
+#define F12_2D_CTRL20_SIZE   3
+
+//
+// Dynamic reporting mode. Contacts that moved no more than the still
+// threshold for RMI_F12_REDUCED_ENTER_FRAMES consecutive frames switch the
+// controller to reduced reporting. Any contact moving beyond the (larger)
+// exit threshold, or a change in the set of contacts, switches it back.
+//
+#define RMI_F12_REDUCED_ENTER_FRAMES        30
+#define RMI_F12_STILL_THRESHOLD             4
+#define RMI_F12_MOTION_EXIT_THRESHOLD       12
 
 //
 // Logical structure for getting registry config settings
@@ -97,26 +109,41 @@ typedef struct _RMI4_F12_CTRL_REGISTERS_LOGICAL
 } RMI4_F12_CTRL_REGISTERS_LOGICAL;
 
 /* describes a single packet register */
-#define BITS_PER_BYTE		8
-
-#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
-#define BITS_TO_LONGS(nr)	DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
-
 #define RMI_REG_DESC_PRESENSE_BITS	(32 * BITS_PER_BYTE)
 #define RMI_REG_DESC_SUBPACKET_BITS	(37 * BITS_PER_BYTE)
 
+#define RMI_REG_DESC_PRESENCE_MAX	35
+#define RMI_REG_DESC_COUNT			3
+
+//
+// SubPacketMap points into the function's descriptor arena and holds
+// SubPacketBits bits, 7 per subpacket presence byte the device reported
+//
 typedef struct _RMI_REGISTER_DESC_ITEM
 {
 	USHORT Register;
+	USHORT SubPacketBits;
 	ULONG RegisterSize;
-	BYTE NumSubPackets;
-	ULONG SubPacketMap[BITS_TO_LONGS(RMI_REG_DESC_SUBPACKET_BITS)];
+	USHORT NumSubPackets;
+	BITMAP_WORD* SubPacketMap;
 } RMI_REGISTER_DESC_ITEM, * PRMI_REGISTER_DESC_ITEM;
 
 typedef struct _RMI_REGISTER_DESCRIPTOR
 {
 	ULONG StructSize;
-	ULONG PresenceMap[BITS_TO_LONGS(RMI_REG_DESC_PRESENSE_BITS)];
-	UINT8 NumRegisters;
+	BITMAP_WORD PresenceMap[BITS_TO_WORDS(RMI_REG_DESC_PRESENSE_BITS)];
+	USHORT NumRegisters;
 	RMI_REGISTER_DESC_ITEM* Registers;
 } RMI_REGISTER_DESCRIPTOR, * PRMI_REGISTER_DESCRIPTOR;
+
+//
+// Backing store for the register descriptors of one function. A first
+// pass over the descriptors measures the items and subpacket maps, which
+// are then carved out of a single allocation of exactly that size.
+//
+typedef struct _RMI_DESC_ARENA
+{
+	PUCHAR Base;
+	SIZE_T Size;
+	SIZE_T Used;
+} RMI_DESC_ARENA;
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <wdf.h>
+#include <wdm.h>
+
+//
+// Defines from Synaptics RMI4 Data Sheet, please refer to
+// the spec for details about the fields and values.
+//
+
+#define RMI4_F34_FLASH_MEMORY_MANAGEMENT  0x34
+
+//
+// Function $34 - Flash Memory Management (bootloader V5)
+//
+
+//
+// Data registers are the block number, followed by one block of data,
+// followed by the flash command register. Block data and the command
+// are contiguous so a block and its write command go out in one
+// transfer.
+//
+#define RMI4_F34_DATA_BLOCK_NUMBER        0
+#define RMI4_F34_DATA_BLOCK_DATA          2
+
+#define RMI4_F34_COMMAND_MASK             0x0F
+#define RMI4_F34_STATUS(Command)          (((Command) >> 4) & 0x07)
+#define RMI4_F34_PROGRAM_ENABLED          0x80
+
+#define RMI4_F34_COMMAND_WRITE_FW_BLOCK       0x02
+#define RMI4_F34_COMMAND_ERASE_ALL            0x03
+#define RMI4_F34_COMMAND_READ_CONFIG_BLOCK    0x05
+#define RMI4_F34_COMMAND_WRITE_CONFIG_BLOCK   0x06
+#define RMI4_F34_COMMAND_ERASE_CONFIG         0x07
+#define RMI4_F34_COMMAND_ENABLE_FLASH_PROG    0x0F
+
+#define RMI4_F34_BOOTLOADER_ID_SIZE       2
+
+#include <pshpack1.h>
+
+typedef struct _RMI4_F34_QUERY_REGISTERS
+{
+	BYTE BootloaderId[RMI4_F34_BOOTLOADER_ID_SIZE];
+	struct
+	{
+		BYTE RegMap : 1;
+		BYTE Unlocked : 1;
+		BYTE HasConfigId : 1;
+		BYTE Reserved0 : 5;
+	};
+	USHORT BlockSize;
+	USHORT FirmwareBlocks;
+	USHORT ConfigBlocks;
+} RMI4_F34_QUERY_REGISTERS;
+
+//
+// Header of a Synaptics firmware image (.img). The firmware area is
+// followed by the configuration area. Checksum is a Fletcher-32 of the
+// little-endian 16 bit words that follow it up to the end of the
+// configuration area, a trailing odd byte padded with zero.
+//
+#define RMI4_F34_IMAGE_HEADER_SIZE        0x100
+#define RMI4_F34_IMAGE_BOOTLOADER_V5      5
+#define RMI4_F34_PRODUCT_ID_SIZE          10
+
+typedef struct _RMI4_F34_IMAGE_HEADER
+{
+	ULONG Checksum;
+	BYTE Reserved0[3];
+	BYTE BootloaderVersion;
+	ULONG FirmwareSize;
+	ULONG ConfigSize;
+	BYTE ProductId[RMI4_F34_PRODUCT_ID_SIZE];
+	BYTE ProductInfo[2];
+} RMI4_F34_IMAGE_HEADER;
+
+#include <poppack.h>
+
+//
+// Flashing steps, in the order they run. A failed step is kept so the
+// update can be resumed from it.
+//
+typedef enum _RMI4_F34_FLASH_STATE
+{
+	F34FlashIdle = 0,
+	F34FlashEnterBootloader,
+	F34FlashErase,
+	F34FlashWriteFirmware,
+	F34FlashWriteConfig,
+	F34FlashVerifyConfig,
+	F34FlashReset,
+	F34FlashDone
+} RMI4_F34_FLASH_STATE;
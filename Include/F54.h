@@ -0,0 +1,52 @@
+#pragma once
+
+#include <wdf.h>
+#include <wdm.h>
+
+//
+// Defines from Synaptics RMI4 Data Sheet, please refer to
+// the spec for details about the fields and values.
+//
+
+#define RMI4_F54_TEST_REPORTING           0x54
+
+//
+// Function $54 - Test Reporting
+//
+
+//
+// Data register offsets. The report type selects what the next
+// GetReport command captures, the FIFO index addresses the byte of
+// the captured report returned by reads of the report data register.
+//
+#define RMI4_F54_DATA_REPORT_TYPE         0
+#define RMI4_F54_DATA_FIFO_INDEX          1
+#define RMI4_F54_DATA_REPORT_DATA         3
+
+#define RMI4_F54_COMMAND_GET_REPORT       0x01
+#define RMI4_F54_COMMAND_FORCE_CAL        0x02
+
+#define RMI4_F54_REPORT_8BIT_IMAGE        1
+#define RMI4_F54_REPORT_16BIT_IMAGE       2
+#define RMI4_F54_REPORT_RAW_16BIT_IMAGE   3
+#define RMI4_F54_REPORT_TRUE_BASELINE     9
+#define RMI4_F54_REPORT_FULL_RAW_CAP      19
+#define RMI4_F54_REPORT_FULL_RAW_CAP_RX_COUPLING_COMP 20
+
+typedef struct _RMI4_F54_QUERY_REGISTERS
+{
+	BYTE NumRxElectrodes;
+	BYTE NumTxElectrodes;
+	struct
+	{
+		BYTE Reserved0 : 2;
+		BYTE HasBaseline : 1;
+		BYTE HasImage8 : 1;
+		BYTE Reserved1 : 2;
+		BYTE HasImage16 : 1;
+		BYTE Reserved2 : 1;
+	};
+	BYTE ClockRateLo;
+	BYTE ClockRateHi;
+	BYTE Family;
+} RMI4_F54_QUERY_REGISTERS;
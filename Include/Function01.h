@@ -9,6 +9,17 @@ RmiConfigureFunction01(
 	IN SPB_CONTEXT* SpbContext
 );
 
+ULONG
+RmiGetInterruptEnableMask(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+NTSTATUS
+RmiSetInterruptEnable(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
 VOID
 RmiConvertF01ToPhysical(
 	IN RMI4_F01_CTRL_REGISTERS_LOGICAL* Logical,
@@ -22,6 +22,12 @@ RmiConfigureFunction11(
 	IN SPB_CONTEXT* SpbContext
 );
 
+NTSTATUS
+RmiSetFunction11Control(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
 VOID
 RmiConvertF11ToPhysical(
 	IN RMI4_F11_CTRL_REGISTERS_LOGICAL* Logical,
@@ -11,8 +11,6 @@ GetTouchesFromF12(
 
 VOID
 UpdateLocalFingerCacheF12(
-	IN ULONG FingerStatusRegister,
-	IN RMI4_F12_DATA_POSITION* FingerPosRegisters,
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
 );
 
@@ -30,11 +28,32 @@ RmiSetReportingMode(
 	OUT UCHAR* OldMode
 );
 
+NTSTATUS
+RmiUpdateReportingMode(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
 NTSTATUS
 RmiReadRegisterDescriptor(
 	IN SPB_CONTEXT* Context,
 	IN UCHAR Address,
-	IN PRMI_REGISTER_DESCRIPTOR Rdesc
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	OUT BYTE* Presence,
+	OUT BYTE* PresenceSize,
+	OUT BYTE** StructBuf
+);
+
+NTSTATUS
+RmiLoadRegisterDescriptors(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Address
+);
+
+VOID
+RmiFreeRegisterDescriptors(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
 );
 
 size_t
@@ -42,6 +61,12 @@ RmiRegisterDescriptorCalcSize(
 	IN PRMI_REGISTER_DESCRIPTOR Rdesc
 );
 
+size_t
+RmiRegisterDescriptorCalcRegOffset(
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	IN USHORT Reg
+);
+
 const PRMI_REGISTER_DESC_ITEM RmiGetRegisterDescItem(
 	PRMI_REGISTER_DESCRIPTOR Rdesc,
 	USHORT reg
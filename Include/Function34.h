@@ -0,0 +1,12 @@
+#include "rmiinternal.h"
+
+#pragma once
+
+NTSTATUS
+RmiF34Flash(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Image,
+	IN SIZE_T ImageBytes,
+	IN ULONG Flags
+);
@@ -0,0 +1,45 @@
+#include "rmiinternal.h"
+
+#pragma once
+
+NTSTATUS
+RmiConfigureFunction54(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
+NTSTATUS
+RmiF54Initialize(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+NTSTATUS
+RmiF54StartStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN UCHAR ReportType,
+	IN PVOID Ring,
+	IN SIZE_T RingBytes
+);
+
+VOID
+RmiF54StopStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+VOID
+RmiF54ParkStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+VOID
+RmiF54ResumeStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+VOID
+RmiF54ServiceInterrupt(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
+EVT_WDF_TIMER RmiF54OnPollTimer;
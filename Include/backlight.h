@@ -34,10 +34,19 @@
 #define BKL_LUX_TABLE_INTENSITIES_1  L"IntensityMappings1"
 #define BKL_LUX_TABLE_INTENSITIES_2  L"IntensityMappings2"
 #define BKL_INACTIVITY_TIMEOUT       L"InactivityTimeout"
+#define BKL_FADE_TIME                L"FadeTime"
+#define BKL_INTERPOLATE              L"InterpolateIntensity"
 
 #define BKL_NUM_LEVELS_DEFAULT     4
+#define BKL_MAX_LEVELS             32
+#define BKL_MAX_INTENSITY          100      // percent
 #define BKL_DEFAULT_INTENSITY      5        // percent
 #define BKL_ALS_SAMPLING_INTERVAL  5000000  // usec
+#define BKL_ALS_RETRY_INTERVAL     5000     // msec
+#define BKL_MIN_UPDATE_INTERVAL    2000     // msec
+#define BKL_LUX_HYSTERESIS_PERCENT 10
+#define BKL_DEFAULT_FADE_TIME      250      // msec
+#define BKL_FADE_TICK              20       // msec
 
 #define HUNDRED_NS_PER_MS 10000
 #define GetTickCount() (KeQueryInterruptTime() / HUNDRED_NS_PER_MS)
@@ -80,6 +89,9 @@ typedef struct _BKL_CONTEXT
 	size_t HwnConfigurationSize;
 	ULONG HwnNumLeds;
 	PULONG HwnLedIndexList;
+	WDFREQUEST HwnRequest;
+	WDFMEMORY HwnMemory;
+	volatile LONG HwnRequestPending;
 
 	WDFIOTARGET AlsIoTarget;
 	PVOID AlsPnpNotificationEntry;
@@ -87,19 +99,35 @@ typedef struct _BKL_CONTEXT
 	SENSOR_NOTIFICATION AlsConfiguration;
 	ALS_DATA AlsData;
 	NTSTATUS AlsStatus;
+	WDFREQUEST AlsReadRequest;
+	WDFMEMORY AlsReadMemory;
+	BOOLEAN AlsReadPending;
+	WDFTIMER AlsRetryTimer;
 
 	WDFWAITLOCK BacklightLock;
 	WDFWORKITEM TchBklPollAlsWorkItem;
 	BOOLEAN TchBklPollAls;
 	ULONG CurrentBklIntensity;
+	ULONG TargetBklIntensity;
+	ULONG FadeFromIntensity;
+	ULONG FadeStartTime;
+	ULONG FadeTime;
+	WDFTIMER FadeTimer;
+	ULONG AlsLuxLevel;
+	ULONG LastIntensityUpdateTime;
 
 	ULONG BklNumLevels;
-	BKL_LUX_TABLE_ENTRY* BklLuxTable;
+	BKL_LUX_TABLE_ENTRY BklLuxTable[BKL_MAX_LEVELS];
+	BOOLEAN BklInterpolate;
+	ULONG AlsLux;
 
 	ULONG Timeout;
-	ULONG LastInputTime;
+	volatile LONG LastInputTime;
 
-	PVOID MonitorChangeNotificationHandle;
+	WDFWORKITEM ReenableWorkItem;
+	volatile LONG ReenablePending;
+	volatile LONG ReenableRequests;
+	ULONG ReenableCount;
 } BKL_CONTEXT;
 
 typedef struct _WORKITEM_CONTEXT
@@ -122,7 +150,52 @@ TchBklEnable(
 
 BKL_CONTEXT*
 TchBklInitialize(
-	IN WDFDEVICE FxDevice
+	IN WDFDEVICE FxDevice,
+	IN const BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+);
+
+VOID
+TchBklGetDefaultLuxIntensityMap(
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
+);
+
+VOID
+TchBklLoadLuxTable(
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
+);
+
+NTSTATUS
+TchBklValidateLuxTable(
+	IN OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+);
+
+ULONG
+TchBklGetLuxLevel(
+	IN BKL_CONTEXT* BklContext,
+	IN ULONG LuxValue
+);
+
+ULONG
+TchBklGetIntensity(
+	IN BKL_CONTEXT* BklContext,
+	IN ULONG Level,
+	IN ULONG LuxValue
+);
+
+VOID
+TchBklSetLuxTable(
+	IN BKL_CONTEXT* BklContext,
+	IN const BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+);
+
+VOID
+TchBklFlushFade(
+	IN BKL_CONTEXT* BklContext
 );
 
 VOID
@@ -133,6 +206,16 @@ TchBklNotifyTouchActivity(
 
 EVT_WDF_WORKITEM TchBklGetLightSensorValue;
 
+EVT_WDF_WORKITEM TchBklReenableWorkItem;
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE TchBklOnAlsReadComplete;
+
+EVT_WDF_TIMER TchBklOnAlsRetryTimer;
+
+EVT_WDF_REQUEST_COMPLETION_ROUTINE TchBklOnHwnRequestComplete;
+
+EVT_WDF_TIMER TchBklOnFadeTimer;
+
 DRIVER_NOTIFICATION_CALLBACK_ROUTINE TchBklOnAlsDeviceReady;
 
 DRIVER_NOTIFICATION_CALLBACK_ROUTINE TchBklOnHwnDeviceReady;
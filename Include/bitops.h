@@ -1,44 +1,115 @@
 #pragma once
 
-#ifndef __COMPAT_H__
-#define __COMPAT_H__
-#endif
-
 #ifndef __BITOPS_H__
 #define __BITOPS_H__
 
-#ifndef __SIZEOF_LONG__
-#define __SIZEOF_LONG__ sizeof(long)
-#endif
+//
+// Bitmaps are arrays of BITMAP_WORD. The word is 32 bits on every
+// architecture the driver builds for, so a map declared with
+// BITS_TO_WORDS() has the same layout on ARM, ARM64, x86 and x64.
+//
+typedef ULONG BITMAP_WORD;
 
-#ifndef __WORDSIZE
-#define __WORDSIZE (__SIZEOF_LONG__ * 8)
-#endif
+#define BITS_PER_BYTE			8
+#define BITS_PER_BITMAP_WORD	(sizeof(BITMAP_WORD) * BITS_PER_BYTE)
+#define BITMAP_WORD_MAX			((BITMAP_WORD)~(BITMAP_WORD)0)
+
+#define DIV_ROUND_UP(n, d)		(((n) + (d) - 1) / (d))
+#define BITS_TO_WORDS(nr)		DIV_ROUND_UP(nr, BITS_PER_BITMAP_WORD)
+
+#define BIT(nr)					((BITMAP_WORD)1 << (nr))
+#define BIT_WORD(nr)			((nr) / BITS_PER_BITMAP_WORD)
+#define BIT_MASK(nr)			((BITMAP_WORD)1 << ((nr) % BITS_PER_BITMAP_WORD))
+
+#define BITMAP_FIRST_WORD_MASK(start) \
+	(BITMAP_WORD_MAX << ((start) & (BITS_PER_BITMAP_WORD - 1)))
+#define BITMAP_LAST_WORD_MASK(nbits) \
+	(BITMAP_WORD_MAX >> ((0U - (nbits)) & (BITS_PER_BITMAP_WORD - 1)))
+
+/*++
 
-#ifndef BITS_PER_LONG
-# define BITS_PER_LONG __WORDSIZE
+Routine Description:
+
+	Returns the number of set bits in a single bitmap word. ARM targets
+	use the VCNT based intrinsic, the rest fall back to a branch free
+	SWAR count since POPCNT is not guaranteed on every x86 part.
+
+--*/
+static __forceinline ULONG
+bitmap_word_weight(
+	IN BITMAP_WORD Word
+)
+{
+#if defined(_M_ARM) || defined(_M_ARM64)
+	return _CountOneBits(Word);
+#else
+	Word = Word - ((Word >> 1) & 0x55555555);
+	Word = (Word & 0x33333333) + ((Word >> 2) & 0x33333333);
+	Word = (Word + (Word >> 4)) & 0x0F0F0F0F;
+	return (Word * 0x01010101) >> 24;
 #endif
-#define BITS_PER_BYTE		8
+}
+
+/*++
+
+Routine Description:
 
-#define DIV_ROUND_UP(n, d)	(((n) + (d) - 1) / (d))
-#define BITS_TO_LONGS(nr)	DIV_ROUND_UP(nr, BITS_PER_BYTE * sizeof(long))
+	Returns the index of the lowest set bit of a word. The caller must
+	guarantee that Word is not zero.
 
-#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
+--*/
+static __forceinline ULONG
+bitmap_word_ffs(
+	IN BITMAP_WORD Word
+)
+{
+	ULONG index;
 
-#define BITMAP_FIRST_WORD_MASK(start) (~0UL << ((start) & (BITS_PER_LONG - 1)))
-#define BITMAP_LAST_WORD_MASK(nbits) (~0UL >> (-(nbits) & (BITS_PER_LONG - 1)))
+	_BitScanForward(&index, Word);
+	return index;
+}
 
-#define __round_mask_ul(x, y) ((unsigned long) ((y)-1))
-#define round_down_ul(x, y) ((x) & ~__round_mask_ul(x, y))
+static __forceinline BOOLEAN
+test_bit(
+	IN ULONG Nr,
+	IN const BITMAP_WORD* Map
+)
+{
+	return (Map[BIT_WORD(Nr)] & BIT_MASK(Nr)) != 0;
+}
 
-#define BIT(nr)			(1UL << (nr))
-#define BIT_MASK(nr)		(1UL << ((nr) % BITS_PER_LONG))
-#define BIT_WORD(nr)		((nr) / BITS_PER_LONG)
-#define BITS_TO_TYPE(nr, t)	(((nr)+(t)-1)/(t))
+static __forceinline VOID
+__set_bit(
+	IN ULONG Nr,
+	IN OUT BITMAP_WORD* Map
+)
+{
+	Map[BIT_WORD(Nr)] |= BIT_MASK(Nr);
+}
 
-void bitmap_set(unsigned long* map, unsigned int start, int len);
-int bitmap_weight(const unsigned long* bitmap, unsigned int bits);
-unsigned long find_first_bit(const unsigned long* addr, unsigned long size);
-unsigned long find_next_bit(const unsigned long* addr, unsigned long size, unsigned long offset);
+static __forceinline VOID
+__clear_bit(
+	IN ULONG Nr,
+	IN OUT BITMAP_WORD* Map
+)
+{
+	Map[BIT_WORD(Nr)] &= ~BIT_MASK(Nr);
+}
 
-#endif
\ No newline at end of file
+static __forceinline VOID
+bitmap_zero(
+	OUT BITMAP_WORD* Map,
+	IN ULONG Bits
+)
+{
+	RtlZeroMemory(Map, BITS_TO_WORDS(Bits) * sizeof(BITMAP_WORD));
+}
+
+VOID bitmap_set(BITMAP_WORD* Map, ULONG Start, ULONG Len);
+BOOLEAN bitmap_empty(const BITMAP_WORD* Map, ULONG Bits);
+BOOLEAN bitmap_equal(const BITMAP_WORD* Map1, const BITMAP_WORD* Map2, ULONG Bits);
+ULONG bitmap_weight(const BITMAP_WORD* Map, ULONG Bits);
+ULONG find_first_bit(const BITMAP_WORD* Map, ULONG Size);
+ULONG find_next_bit(const BITMAP_WORD* Map, ULONG Size, ULONG Offset);
+
+#endif
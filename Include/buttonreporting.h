@@ -11,6 +11,35 @@ typedef enum _REPORTED_BUTTON
 	BUTTON_UNKNOWN
 } REPORTED_BUTTON;
 
+//
+// Button settings shared by every device, the values of a device's
+// hardware key override them
+//
+#define BUTTONS_REGISTRY_PATH        L"\\Registry\\Machine\\SYSTEM\\TOUCH\\BUTTONS"
+#define BUTTON_REGIONS_VALUE         L"ButtonRegions"
+#define BUTTON_REGION_FIELDS         5
+
+//
+// Registry button actions are packed into a DWORD:
+// bits 0-7 report id, bits 8-15 keys, bits 16-23 latched keys
+//
+#define BUTTON_ACTION_REPORTID(v)    ((UCHAR)((v) & 0xFF))
+#define BUTTON_ACTION_KEYS(v)        ((UCHAR)(((v) >> 8) & 0xFF))
+#define BUTTON_ACTION_LATCH_KEYS(v)  ((UCHAR)(((v) >> 16) & 0xFF))
+
+//
+// Key bits, in the order of the capkey collections of the report descriptor
+//
+#define BUTTON_KEYBOARD_GUI          (1 << 0)
+#define BUTTON_KEYBOARD_TAB          (1 << 1)
+#define BUTTON_KEYBOARD_ALT          (1 << 2)
+#define BUTTON_CONSUMER_SEARCH       (1 << 0)
+#define BUTTON_CONSUMER_BACK         (1 << 1)
+
+#define BUTTONS_DEFAULT_HOLD_TIME    1500
+
+#define BUTTONS_MS_TO_INTERRUPT_TIME(ms) ((ULONG64)(ms) * 10000)
+
 NTSTATUS
 RmiServiceCapacitiveButtonInterrupt(
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
@@ -20,22 +49,31 @@ RmiServiceCapacitiveButtonInterrupt(
 
 REPORTED_BUTTON
 TchHandleButtonArea(
+	IN RMI4_BUTTON_REGIONS* Regions,
 	IN ULONG ControllerX,
-	IN ULONG ControllerY,
-	IN PTOUCH_SCREEN_PROPERTIES Props
+	IN ULONG ControllerY
 );
 
 NTSTATUS
 FillButtonsReportFromCache(
-    IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN ULONG64 Timestamp
 );
 
-void
-ButtonsTimerHandler(
-    WDFTIMER Timer
+VOID
+ButtonsResetState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
 );
 
-void
-ButtonsInitTimer(
-    RMI4_CONTROLLER_CONTEXT* ControllerContext
+EVT_WDF_TIMER ButtonsTimerHandler;
+
+VOID
+ButtonsLoadConfiguration(
+	IN WDFDEVICE FxDevice,
+	IN OUT RMI4_CONFIG_SNAPSHOT* Config
+);
+
+NTSTATUS
+ButtonsInitialize(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
 );
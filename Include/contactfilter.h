@@ -0,0 +1,82 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contactfilter.h
+
+	Abstract:
+
+		Adaptive low pass filter applied to contact positions
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "rmiinternal.h"
+
+//
+// Filtered positions carry 8 fractional bits, smoothing factors are in
+// 16.16 fixed point
+//
+#define RMI4_FILTER_FRACTION_BITS         8
+#define RMI4_FILTER_ALPHA_SHIFT           16
+#define RMI4_FILTER_ALPHA_ONE             (1 << RMI4_FILTER_ALPHA_SHIFT)
+#define RMI4_FILTER_TWO_PI                411775
+
+//
+// Scan times are in 100us units and cutoffs in mHz
+//
+#define RMI4_FILTER_TICKS_PER_SECOND      10000
+#define RMI4_FILTER_RATE_DIVISOR          (1000 * RMI4_FILTER_TICKS_PER_SECOND)
+
+//
+// Bounds on the tuning, so the fixed point arithmetic cannot overflow.
+// A gap between frames longer than RMI4_FILTER_MAX_ELAPSED is treated as
+// one of that length.
+//
+#define RMI4_FILTER_MAX_CUTOFF            1000000
+#define RMI4_FILTER_MAX_BETA              1000000
+#define RMI4_FILTER_MAX_ELAPSED           1000
+
+//
+// Tuning used when the registry does not override it
+//
+#define RMI4_FILTER_DEFAULT_MIN_CUTOFF    1000
+#define RMI4_FILTER_DEFAULT_BETA          7
+#define RMI4_FILTER_DEFAULT_DERIVATIVE_CUTOFF 1000
+
+VOID
+RmiFilterCompile(
+	IN const RMI4_FILTER_SETTINGS* Settings,
+	OUT RMI4_FILTER_PARAMETERS* Parameters
+);
+
+VOID
+RmiFilterStart(
+	OUT RMI4_FILTER_STATE* State,
+	IN USHORT X,
+	IN USHORT Y,
+	IN ULONG Time
+);
+
+VOID
+RmiFilterSample(
+	IN const RMI4_FILTER_PARAMETERS* Parameters,
+	IN OUT RMI4_FILTER_STATE* State,
+	IN OUT PUSHORT X,
+	IN OUT PUSHORT Y,
+	IN ULONG Time
+);
+
+VOID
+RmiFilterContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
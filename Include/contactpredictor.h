@@ -0,0 +1,77 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contactpredictor.h
+
+	Abstract:
+
+		Extrapolation of contact positions to compensate for the latency
+		between a scan and the frame that displays it
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "rmiinternal.h"
+
+//
+// Scan times are in 100us units
+//
+#define RMI4_PREDICTOR_TICKS_PER_SECOND   10000
+#define RMI4_PREDICTOR_TICKS_PER_MS       10
+
+//
+// A contact is extrapolated once it has been seen this many times, so
+// that its velocity and acceleration come from at least two intervals
+//
+#define RMI4_PREDICTOR_MIN_SAMPLES        3
+
+//
+// A gap between frames longer than this, in 100us units, restarts the
+// history of a contact
+//
+#define RMI4_PREDICTOR_MAX_GAP            500
+
+//
+// Bounds on the tuning and on the estimates, so the fixed point
+// arithmetic cannot overflow
+//
+#define RMI4_PREDICTOR_MAX_HORIZON        50
+#define RMI4_PREDICTOR_MAX_VELOCITY       1000000
+#define RMI4_PREDICTOR_MAX_ACCELERATION   100000000
+
+//
+// Tuning used when the registry does not override it
+//
+#define RMI4_PREDICTOR_DEFAULT_HORIZON    0
+#define RMI4_PREDICTOR_DEFAULT_MAX_DISTANCE 32
+#define RMI4_PREDICTOR_DEFAULT_MIN_SPEED  100
+
+VOID
+RmiPredictorCompile(
+	IN const RMI4_PREDICTOR_SETTINGS* Settings,
+	OUT RMI4_PREDICTOR_PARAMETERS* Parameters
+);
+
+VOID
+RmiPredictorSample(
+	IN const RMI4_PREDICTOR_PARAMETERS* Parameters,
+	IN OUT RMI4_PREDICTOR_STATE* State,
+	IN OUT PUSHORT X,
+	IN OUT PUSHORT Y,
+	IN ULONG Time
+);
+
+VOID
+RmiPredictContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
@@ -0,0 +1,49 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contacttracker.h
+
+	Abstract:
+
+		Assignment of stable contact IDs across hardware slot reassignment
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "rmiinternal.h"
+
+//
+// Without a configured distance a contact may move this fraction of the
+// sensor width plus height beyond where it was expected
+//
+#define RMI4_TRACKER_DISTANCE_DIVISOR     16
+
+//
+// The nearest contact of the previous frame is only taken when the next
+// nearest is at least this many times further away
+//
+#define RMI4_TRACKER_AMBIGUITY_RATIO      2
+
+#define RMI4_TRACKER_NO_MATCH             MAXUCHAR
+
+VOID
+RmiTrackerCompile(
+	IN const RMI4_TRACKER_SETTINGS* Settings,
+	IN const TOUCH_SCREEN_PROPERTIES* Props,
+	OUT RMI4_TRACKER_PARAMETERS* Parameters
+);
+
+VOID
+RmiTrackContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
@@ -26,7 +26,7 @@
 #define RESHUB_USE_HELPER_ROUTINES
 #include <reshub.h>
 #include <kbdmou.h>
-#include "spb.h"
+#include "transport.h"
 #include "hid.h"
 
 #define TOUCH_POOL_TAG                  (ULONG)'cuoT'
@@ -58,7 +58,11 @@
 #define REPORTID_FEATURE                7
 #define REPORTID_MAX_COUNT              8
 
-#define  MAX_REPORTS_IN_QUEUE            10  //5 for 10 touches + 2 for keyboard + 2 for consumer + 1 reserved
+//
+// The report queue holds one report per SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT
+// contacts plus these
+//
+#define  EXTRA_REPORTS_IN_QUEUE          5  //2 for keyboard + 2 for consumer + 1 reserved
 
 // 
 // Type defintions
@@ -139,6 +143,33 @@ typedef struct _HID_INPUT_REPORT
 #include <poppack.h>
 #pragma warning(pop)
 
+//
+// Device start timeline. Touch input is available once the device has
+// entered D0, the phases after TchStartPhaseD0Entry complete on the
+// start work item.
+//
+typedef enum _TCH_START_PHASE
+{
+	TchStartPhasePrepareHardware = 0,
+	TchStartPhaseTransport,
+	TchStartPhaseSettings,
+	TchStartPhaseTopology,
+	TchStartPhaseConfigured,
+	TchStartPhaseReportDescriptor,
+	TchStartPhaseD0Entry,
+	TchStartPhaseWorkItem,
+	TchStartPhaseBacklight,
+	TchStartPhaseDisplayCallback,
+	TchStartPhaseComplete,
+	TchStartPhaseCount
+} TCH_START_PHASE;
+
+VOID
+TchMarkStartPhase(
+	IN WDFDEVICE FxDevice,
+	IN TCH_START_PHASE Phase
+);
+
 NTSTATUS
 TchAllocateContext(
 	OUT VOID** ControllerContext,
@@ -179,6 +210,31 @@ TchRegistryGetControllerSettings(
 	IN VOID* ControllerContext
 );
 
+//
+// Results of a configuration reload. The F01/F11 register images
+// changed, and they are waiting for the controller to be woken before
+// they are programmed.
+//
+#define TCH_CONFIG_REGISTERS_CHANGED      0x00000001
+#define TCH_CONFIG_REGISTERS_PENDING      0x00000002
+
+NTSTATUS
+TchReloadConfiguration(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	OUT PULONG Version,
+	OUT PULONG Flags
+);
+
+NTSTATUS
+TchRegistryQueryTable(
+	IN WDFDEVICE FxDevice,
+	IN PCWSTR SharedKeyPath,
+	IN const RTL_QUERY_REGISTRY_TABLE* Template,
+	IN ULONG TemplateBytes,
+	IN PVOID Base
+);
+
 NTSTATUS
 TchServiceInterrupts(
 	IN VOID* ControllerContext,
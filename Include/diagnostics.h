@@ -0,0 +1,274 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		diagnostics.h
+
+	Abstract:
+
+		Diagnostic device interface, IOCTL codes and the structures
+		returned by them. This header is shared with user mode tools.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+// {AB98A28A-0CD7-4B26-8AC1-116958D3CE7B}
+DEFINE_GUID(GUID_DEVINTERFACE_TOUCH_DIAGNOSTICS,
+	0xab98a28a, 0x0cd7, 0x4b26, 0x8a, 0xc1, 0x11, 0x69, 0x58, 0xd3, 0xce, 0x7b);
+
+#define TOUCH_DIAG_IOCTL(Function, Method, Access) \
+	CTL_CODE(FILE_DEVICE_UNKNOWN, 0x800 + (Function), (Method), (Access))
+
+#define IOCTL_TOUCH_DIAG_GET_MEMORY_USAGE \
+	TOUCH_DIAG_IOCTL(0, METHOD_BUFFERED, FILE_READ_ACCESS)
+#define IOCTL_TOUCH_DIAG_F54_START \
+	TOUCH_DIAG_IOCTL(1, METHOD_OUT_DIRECT, FILE_READ_ACCESS | FILE_WRITE_ACCESS)
+#define IOCTL_TOUCH_DIAG_F54_STOP \
+	TOUCH_DIAG_IOCTL(2, METHOD_BUFFERED, FILE_READ_ACCESS | FILE_WRITE_ACCESS)
+#define IOCTL_TOUCH_DIAG_F34_FLASH \
+	TOUCH_DIAG_IOCTL(3, METHOD_IN_DIRECT, FILE_READ_ACCESS | FILE_WRITE_ACCESS)
+#define IOCTL_TOUCH_DIAG_F34_GET_PROGRESS \
+	TOUCH_DIAG_IOCTL(4, METHOD_BUFFERED, FILE_READ_ACCESS)
+#define IOCTL_TOUCH_DIAG_GET_START_TIMELINE \
+	TOUCH_DIAG_IOCTL(5, METHOD_BUFFERED, FILE_READ_ACCESS)
+#define IOCTL_TOUCH_DIAG_RELOAD_CONFIG \
+	TOUCH_DIAG_IOCTL(6, METHOD_BUFFERED, FILE_READ_ACCESS | FILE_WRITE_ACCESS)
+#define IOCTL_TOUCH_DIAG_GET_STATISTICS \
+	TOUCH_DIAG_IOCTL(7, METHOD_BUFFERED, FILE_READ_ACCESS)
+
+//
+// Memory held by the driver for one touch controller, in bytes.
+// Size is set to the size of the structure returned.
+//
+typedef struct _TOUCH_DIAG_MEMORY_USAGE
+{
+	ULONG Size;
+	ULONG ControllerContextBytes;
+	ULONG BacklightContextBytes;
+	ULONG F12DescriptorArenaBytes;
+	ULONG F12DescriptorArenaUsed;
+	ULONG F12RegisterCount;
+} TOUCH_DIAG_MEMORY_USAGE, * PTOUCH_DIAG_MEMORY_USAGE;
+
+//
+// Input of IOCTL_TOUCH_DIAG_F54_START, ReportType is one of the RMI4
+// F54 report types (2 delta image, 3 raw image, 19 full raw capacitance)
+//
+typedef struct _TOUCH_DIAG_F54_START
+{
+	ULONG ReportType;
+} TOUCH_DIAG_F54_START, * PTOUCH_DIAG_F54_START;
+
+//
+// The output buffer of IOCTL_TOUCH_DIAG_F54_START is a ring of frames
+// shared with the caller for as long as the request stays pending. It
+// starts with this header, followed at HeaderBytes by SlotCount slots of
+// SlotBytes each. Frame n is written to slot (n - 1) % SlotCount.
+//
+typedef struct _TOUCH_DIAG_F54_RING
+{
+	ULONG HeaderBytes;
+	ULONG ReportType;
+	ULONG RxCount;
+	ULONG TxCount;
+	ULONG FrameBytes;
+	ULONG SlotBytes;
+	ULONG SlotCount;
+	volatile ULONG WriteSequence;
+	volatile ULONG Errors;
+} TOUCH_DIAG_F54_RING, * PTOUCH_DIAG_F54_RING;
+
+//
+// Sequence is zero while the driver fills the slot and holds the frame
+// number once it is complete. A reader copies the frame and accepts it
+// only if Sequence is unchanged and non zero afterwards.
+//
+typedef struct _TOUCH_DIAG_F54_FRAME
+{
+	volatile ULONG Sequence;
+	ULONG Length;
+	ULONG64 Timestamp;
+	UCHAR Data[ANYSIZE_ARRAY];
+} TOUCH_DIAG_F54_FRAME, * PTOUCH_DIAG_F54_FRAME;
+
+#define TOUCH_DIAG_F54_ALIGNMENT 64
+
+//
+// Input of IOCTL_TOUCH_DIAG_F34_FLASH, the output buffer holds the
+// Synaptics firmware image. CONFIG_ONLY only rewrites the configuration
+// area, RESUME continues a failed update of the same image from the
+// step that failed.
+//
+#define TOUCH_DIAG_F34_FLASH_CONFIG_ONLY 0x00000001
+#define TOUCH_DIAG_F34_FLASH_RESUME      0x00000002
+
+typedef struct _TOUCH_DIAG_F34_FLASH
+{
+	ULONG Flags;
+} TOUCH_DIAG_F34_FLASH, * PTOUCH_DIAG_F34_FLASH;
+
+//
+// Update steps reported in TOUCH_DIAG_F34_PROGRESS.State
+//
+#define TOUCH_DIAG_F34_STATE_IDLE             0
+#define TOUCH_DIAG_F34_STATE_ENTER_BOOTLOADER 1
+#define TOUCH_DIAG_F34_STATE_ERASE            2
+#define TOUCH_DIAG_F34_STATE_WRITE_FIRMWARE   3
+#define TOUCH_DIAG_F34_STATE_WRITE_CONFIG     4
+#define TOUCH_DIAG_F34_STATE_VERIFY_CONFIG    5
+#define TOUCH_DIAG_F34_STATE_RESET            6
+#define TOUCH_DIAG_F34_STATE_DONE             7
+
+//
+// Progress of the last update. State is the step that failed if
+// LastStatus is an error. ElapsedTime is in 100ns units, so the write
+// throughput is BytesWritten / ElapsedTime.
+//
+typedef struct _TOUCH_DIAG_F34_PROGRESS
+{
+	ULONG Size;
+	ULONG State;
+	ULONG Flags;
+	LONG LastStatus;
+	ULONG ControllerStatus;
+	ULONG BlockSize;
+	ULONG FirmwareBlocks;
+	ULONG ConfigBlocks;
+	ULONG NextBlock;
+	ULONG BytesWritten;
+	ULONG BytesVerified;
+	ULONG64 ElapsedTime;
+} TOUCH_DIAG_F34_PROGRESS, * PTOUCH_DIAG_F34_PROGRESS;
+
+//
+// Device start phases reported in TOUCH_DIAG_START_TIMELINE.PhaseTime.
+// Touch input is available from D0_ENTRY on, the phases after it run
+// on a work item off the start path.
+//
+#define TOUCH_DIAG_START_PREPARE_HARDWARE   0
+#define TOUCH_DIAG_START_TRANSPORT          1
+#define TOUCH_DIAG_START_SETTINGS           2
+#define TOUCH_DIAG_START_TOPOLOGY           3
+#define TOUCH_DIAG_START_CONFIGURED         4
+#define TOUCH_DIAG_START_REPORT_DESCRIPTOR  5
+#define TOUCH_DIAG_START_D0_ENTRY           6
+#define TOUCH_DIAG_START_WORK_ITEM          7
+#define TOUCH_DIAG_START_BACKLIGHT          8
+#define TOUCH_DIAG_START_DISPLAY_CALLBACK   9
+#define TOUCH_DIAG_START_COMPLETE           10
+#define TOUCH_DIAG_START_PHASE_COUNT        11
+
+//
+// Set in TOUCH_DIAG_START_TIMELINE.Flags when the controller was started
+// from the topology persisted by an earlier start
+//
+#define TOUCH_DIAG_START_TOPOLOGY_PERSISTED 0x00000001
+
+//
+// Timeline of the last device start. PhaseTime is the time each phase
+// completed in 100ns units from the start of PREPARE_HARDWARE, which
+// itself is zero, or MAXULONG64 if the phase has not completed yet.
+//
+typedef struct _TOUCH_DIAG_START_TIMELINE
+{
+	ULONG Size;
+	ULONG Flags;
+	ULONG PhaseCount;
+	ULONG Reserved;
+	ULONG64 PhaseTime[TOUCH_DIAG_START_PHASE_COUNT];
+} TOUCH_DIAG_START_TIMELINE, * PTOUCH_DIAG_START_TIMELINE;
+
+//
+// Set in TOUCH_DIAG_RELOAD_CONFIG.Flags when the reloaded configuration
+// changed the controller registers, and when writing them waits for the
+// controller to leave sleep or the screen-off state
+//
+#define TOUCH_DIAG_RELOAD_REGISTERS_CHANGED 0x00000001
+#define TOUCH_DIAG_RELOAD_REGISTERS_PENDING 0x00000002
+
+//
+// Output of IOCTL_TOUCH_DIAG_RELOAD_CONFIG. The registry configuration
+// is read again and replaces the running one, Version counts the
+// configurations published since the device was started at 1.
+//
+typedef struct _TOUCH_DIAG_RELOAD_CONFIG
+{
+	ULONG Size;
+	ULONG Version;
+	ULONG Flags;
+} TOUCH_DIAG_RELOAD_CONFIG, * PTOUCH_DIAG_RELOAD_CONFIG;
+
+//
+// Output of IOCTL_TOUCH_DIAG_GET_STATISTICS, latencies are in 100ns
+// units. ScreenOffTransitions counts the monitor off notifications that
+// put the controller in its screen-off state, the screen latencies are
+// those of the last completed transitions. The idle counters follow the
+// HIDClass idle notification requests: entry latency runs from their
+// arrival to the idle callback, exit latency from the start of D0 entry
+// to their completion. BacklightReenables counts the backlight timeouts undone
+// by touch activity out of BacklightReenableRequests queued for it.
+//
+typedef struct _TOUCH_DIAG_STATISTICS
+{
+	ULONG Size;
+	ULONG ScreenOffTransitions;
+	ULONG64 ScreenOffLatency;
+	ULONG64 ScreenOnLatency;
+	ULONG IdleRequests;
+	ULONG IdleCompletions;
+	ULONG IdleCancellations;
+	ULONG Reserved;
+	ULONG64 IdleLastEntryLatency;
+	ULONG64 IdleMaxEntryLatency;
+	ULONG64 IdleLastExitLatency;
+	ULONG64 IdleMaxExitLatency;
+	ULONG BacklightReenableRequests;
+	ULONG BacklightReenables;
+} TOUCH_DIAG_STATISTICS, * PTOUCH_DIAG_STATISTICS;
+
+#ifdef _KERNEL_MODE
+
+//
+// The diagnostic interface is exposed on a raw PDO, a child of the
+// touch device that needs no function driver. Its requests are forwarded
+// to the diagnostic queue of the parent.
+//
+#define TOUCH_DIAG_PDO_DEVICE_ID \
+	L"{AB98A28A-0CD7-4B26-8AC1-116958D3CE7B}\\SynapticsTouchDiagnostics\0"
+#define TOUCH_DIAG_PDO_INSTANCE_ID    L"0"
+#define TOUCH_DIAG_PDO_DESCRIPTION    L"Synaptics RMI4 Touch Diagnostics"
+#define TOUCH_DIAG_PDO_LOCATION       L"Synaptics RMI4 Touch Controller"
+
+typedef struct _TOUCH_DIAG_PDO_CONTEXT
+{
+	WDFQUEUE ParentQueue;
+} TOUCH_DIAG_PDO_CONTEXT;
+
+WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(TOUCH_DIAG_PDO_CONTEXT, GetDiagPdoContext);
+
+NTSTATUS
+TchDiagCreatePdo(
+	IN WDFDEVICE FxDevice,
+	IN WDFQUEUE ParentQueue,
+	OUT WDFDEVICE* Pdo
+);
+
+NTSTATUS
+TchDiagInitialize(
+	IN WDFDEVICE FxDevice
+);
+
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL TchDiagOnDeviceControl;
+EVT_WDF_IO_QUEUE_IO_DEVICE_CONTROL TchDiagPdoOnDeviceControl;
+EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE TchDiagF54RequestCanceled;
+
+#endif
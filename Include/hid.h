@@ -39,6 +39,7 @@
             REPORT_COUNT, 0x06,                     /*     REPORT_COUNT (6) */ \
             INPUT, 0x03,                            /*       INPUT (Cnst,Ary,Abs) */ \
             REPORT_SIZE, 0x08,                      /*     REPORT_SIZE (8) */ \
+            LOGICAL_MAXIMUM_2, 251, 251,            /*     LOGICAL_MAXIMUM (slots - 1) */ \
             USAGE, 0x51,                            /*     USAGE (Contact Identifier) */ \
             REPORT_COUNT, 0x01,                     /*     REPORT_COUNT (1) */ \
             INPUT, 0x02,                            /*       INPUT (Data,Var,Abs) */ \
@@ -88,7 +89,7 @@
 			INPUT, 0x02,                                     /*      INPUT (Data,Var,Abs) */ \
 			REPORT_ID, REPORTID_MAX_COUNT,                   /*    REPORT_ID (Feature) */ \
 			USAGE, 0x55,                                     /*    USAGE(Maximum Count) */ \
-			LOGICAL_MAXIMUM, 0x02,                           /*    LOGICAL_MAXIMUM (2) */ \
+			LOGICAL_MAXIMUM_2, 252, 252,                     /*    LOGICAL_MAXIMUM (slots) */ \
 			FEATURE, 0x02,                                   /*    FEATURE (Data,Var,Abs) */ \
 		END_COLLECTION
 
@@ -156,6 +157,16 @@ TchGetReportDescriptor(
 	IN WDFREQUEST Request
 );
 
+NTSTATUS
+TchBuildReportDescriptor(
+	IN WDFDEVICE Device
+);
+
+VOID
+TchFreeReportDescriptor(
+	IN WDFDEVICE Device
+);
+
 NTSTATUS
 TchGetString(
 	IN WDFDEVICE Device,
@@ -57,6 +57,5 @@
 
 #define REPORT_BUFFER_SIZE   1024
 #define DEVICE_VERSION 0x01
-#define MAX_FINGERS	16
 
 #endif
\ No newline at end of file
@@ -22,21 +22,6 @@
 #pragma once
 
 
-//
-// Power Idle Workitem context
-// 
-typedef struct _IDLE_WORKITEM_CONTEXT
-{
-	// Handle to a WDF device object
-	WDFDEVICE FxDevice;
-
-	// Handle to a WDF request object
-	WDFREQUEST FxRequest;
-
-} IDLE_WORKITEM_CONTEXT, * PIDLE_WORKITEM_CONTEXT;
-
-WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(IDLE_WORKITEM_CONTEXT, GetWorkItemContext)
-
 NTSTATUS
 TchProcessIdleRequest(
 	IN WDFDEVICE Device,
@@ -46,9 +31,12 @@ TchProcessIdleRequest(
 
 VOID
 TchCompleteIdleIrp(
-	IN PDEVICE_EXTENSION FxDeviceContext
+	IN PDEVICE_EXTENSION FxDeviceContext,
+	IN ULONG64 WakeStartTime
 );
 
 EVT_WDF_WORKITEM TchIdleIrpWorkitem;
 
+EVT_WDF_IO_QUEUE_IO_CANCELED_ON_QUEUE TchIdleRequestCanceledOnQueue;
+
 
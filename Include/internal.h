@@ -23,6 +23,34 @@
 
 #include "controller.h"
 
+//
+// Idle notification handshake. HIDClass keeps at most one idle
+// notification request outstanding; it moves Active -> Pending when
+// received, Pending -> Parked once the idle callback ran and the request
+// sits in the IdleQueue, and back to Active when completed on D0 entry
+// or cancelled.
+//
+typedef enum _IDLE_STATE
+{
+	IdleStateActive = 0,
+	IdleStatePending,
+	IdleStateParked
+} IDLE_STATE;
+
+//
+// Idle statistics, latencies are in 100ns units
+//
+typedef struct _IDLE_STATISTICS
+{
+	volatile LONG Requests;
+	volatile LONG Completions;
+	volatile LONG Cancellations;
+	ULONG64 LastEntryLatency;
+	ULONG64 MaxEntryLatency;
+	ULONG64 LastExitLatency;
+	ULONG64 MaxExitLatency;
+} IDLE_STATISTICS;
+
 //
 // Device context
 //
@@ -48,14 +76,16 @@ typedef struct _DEVICE_EXTENSION
 	BOOLEAN ServiceInterruptsAfterD0Entry;
 
 	//
-	// Spb (I2C) related members used for the lifetime of the device
+	// Spb (I2C or SPI) related members used for the lifetime of the device
 	//
-	SPB_CONTEXT I2CContext;
+	SPB_CONTEXT SpbContext;
 
 	//
 	// Test related
 	//
+	WDFDEVICE DiagPdo;
 	WDFQUEUE TestQueue;
+	WDFQUEUE F54Queue;
 	volatile LONG TestSessionRefCnt;
 	BOOLEAN DiagnosticMode;
 
@@ -63,11 +93,29 @@ typedef struct _DEVICE_EXTENSION
 	// Power related
 	//
 	WDFQUEUE IdleQueue;
+	WDFWORKITEM IdleWorkItem;
+	WDFREQUEST IdleRequest;
+	volatile LONG IdleState;
+	ULONG64 IdleRequestTime;
+	IDLE_STATISTICS IdleStats;
+
+	//
+	// Interrupt time at which each start phase completed, zero until it
+	// has completed since the hardware was last prepared
+	//
+	ULONG64 StartPhaseTime[TchStartPhaseCount];
 
 	//
 	// Touch related members used for the lifetime of the device
 	//
 	VOID* TouchContext;
+
+	//
+	// Report descriptor patched for this controller, built when the
+	// hardware is prepared
+	//
+	PUCHAR ReportDescriptor;
+	USHORT ReportMaxCount;
 } DEVICE_EXTENSION, * PDEVICE_EXTENSION;
 
 WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(DEVICE_EXTENSION, GetDeviceContext)
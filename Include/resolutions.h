@@ -48,8 +48,9 @@ typedef struct _TOUCH_SCREEN_PROPERTIES
 	ULONG DisplayViewableHeight;
 } TOUCH_SCREEN_PROPERTIES, * PTOUCH_SCREEN_PROPERTIES;
 
-VOID
+NTSTATUS
 TchGetScreenProperties(
+	IN WDFDEVICE FxDevice,
 	IN PTOUCH_SCREEN_PROPERTIES Props
 );
 
@@ -27,26 +27,32 @@
 #include "resolutions.h"
 #include "backlight.h"
 
+#include "bitops.h"
 #include "F01.h"
 #include "F11.h"
 #include "F12.h"
 #include "F1A.h"
+#include "F34.h"
+#include "F54.h"
 
 //
 // Defines from Synaptics RMI4 Data Sheet, please refer to
 // the spec for details about the fields and values.
 //
-#define RMI4_MAX_TOUCHES                  10
+//
+// Upper bound of the contact slot capacity. F12 reports its object
+// count in a byte and slot numbers are stored as UCHAR.
+//
+#define RMI4_MAX_TOUCHES                  MAXUCHAR
 
 #define RMI4_FIRST_FUNCTION_ADDRESS       0xE9
 #define RMI4_PAGE_SELECT_ADDRESS          0xFF
 
-#define RMI4_F34_FLASH_MEMORY_MANAGEMENT  0x34
-#define RMI4_F54_TEST_REPORTING           0x54
-
 #define RMI4_MAX_FUNCTIONS                10
 
 #define RMI4_MAX_BUTTONS                  3
+#define RMI4_MAX_BUTTON_REGIONS           8
+#define RMI4_BUTTON_REGION_COLUMNS        32
 
 #define LOGICAL_TO_PHYSICAL(LOGICAL_VALUE) ((LOGICAL_VALUE) & 0xff)
 
@@ -73,62 +79,502 @@ typedef struct _RMI4_FUNCTION_DESCRIPTOR
 #define RMI4_MILLISECONDS_TO_TENTH_MILLISECONDS(n) n/10
 #define RMI4_SECONDS_TO_HALF_SECONDS(n) 2*n
 
-#define RMI4_INTERRUPT_BIT_2D_TOUCH               0x04
-#define RMI4_INTERRUPT_BIT_0D_CAP_BUTTON          0x10
+//
+// Controllers that place the F1A interrupt source on this bit report
+// their capacitive buttons in reverse order
+//
 #define RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED 0x20
 
+//
+// F01 carries a single interrupt enable/status register, every function
+// interrupt source must be one of its bits
+//
+#define RMI4_MAX_INTERRUPT_SOURCES        8
+
 #define TOUCH_POOL_TAG_F12              (ULONG)'21oT'
 
 //
 // Driver structures
 //
 
+//
+// Contact filter tuning as read from the registry. Cutoffs are in mHz,
+// Beta in mHz per controller unit per second of contact speed.
+//
+typedef struct _RMI4_FILTER_SETTINGS
+{
+	UINT32 Enable;
+	UINT32 MinCutoff;
+	UINT32 Beta;
+	UINT32 DerivativeCutoff;
+} RMI4_FILTER_SETTINGS;
+
+//
+// Contact prediction tuning as read from the registry. Horizon is in ms,
+// prediction is off when it is 0. MaxDistance bounds how far a contact
+// is moved, in controller units, and contacts slower than MinSpeed
+// controller units per second are not moved.
+//
+typedef struct _RMI4_PREDICTOR_SETTINGS
+{
+	UINT32 Horizon;
+	UINT32 MaxDistance;
+	UINT32 MinSpeed;
+} RMI4_PREDICTOR_SETTINGS;
+
+//
+// Contact tracking tuning as read from the registry. MaxDistance is how
+// far, in controller units, a contact may land from where it was
+// expected between two frames and still be taken for the same contact.
+// It is derived from the sensor size when 0.
+//
+typedef struct _RMI4_TRACKER_SETTINGS
+{
+	UINT32 Enable;
+	UINT32 MaxDistance;
+} RMI4_TRACKER_SETTINGS;
+
 typedef struct _RMI4_CONFIGURATION
 {
 	RMI4_F01_CTRL_REGISTERS_LOGICAL DeviceSettings;
 	RMI4_F11_CTRL_REGISTERS_LOGICAL TouchSettings;
 	UINT32 PepRemovesVoltageInD3;
+	RMI4_FILTER_SETTINGS FilterSettings;
+	RMI4_PREDICTOR_SETTINGS PredictorSettings;
+	RMI4_TRACKER_SETTINGS TrackerSettings;
 } RMI4_CONFIGURATION;
 
+//
+// Contact filter tuning compiled for the interrupt path. Cutoffs are
+// kept as rates, the cutoff scaled by 2*pi in 16.16 fixed point, and
+// SpeedLimit is the contact speed past which the cutoff saturates.
+//
+typedef struct _RMI4_FILTER_PARAMETERS
+{
+	BOOLEAN Enabled;
+	ULONG64 MinCutoffRate;
+	ULONG64 BetaRate;
+	ULONG64 DerivativeRate;
+	ULONG64 SpeedLimit;
+} RMI4_FILTER_PARAMETERS;
+
+//
+// Contact prediction tuning compiled for the interrupt path, Horizon is
+// in 100us units like the scan time
+//
+typedef struct _RMI4_PREDICTOR_PARAMETERS
+{
+	BOOLEAN Enabled;
+	ULONG Horizon;
+	ULONG MaxDistance;
+	ULONG MinSpeed;
+} RMI4_PREDICTOR_PARAMETERS;
+
+typedef struct _RMI4_TRACKER_PARAMETERS
+{
+	BOOLEAN Enabled;
+	ULONG64 MaxDistanceSquared;
+} RMI4_TRACKER_PARAMETERS;
+
 typedef struct _RMI4_FINGER_INFO
 {
-	int x;
-	int y;
+	USHORT x;
+	USHORT y;
 	UCHAR fingerStatus;
 } RMI4_FINGER_INFO;
 
+//
+// Contact filter state of one slot. Positions are in controller units
+// with RMI4_FILTER_FRACTION_BITS fractional bits, speeds in controller
+// units per second and Time is the scan time of the last sample.
+//
+typedef struct _RMI4_FILTER_STATE
+{
+	LONG X;
+	LONG Y;
+	LONG SpeedX;
+	LONG SpeedY;
+	ULONG Time;
+} RMI4_FILTER_STATE;
+
+//
+// Contact prediction history of one slot. X and Y are the last position
+// fed to the predictor, velocities are in controller units per second,
+// accelerations in controller units per second squared. Samples counts
+// the positions seen since the contact went down, 0 when the slot is
+// not tracked.
+//
+typedef struct _RMI4_PREDICTOR_STATE
+{
+	LONG X;
+	LONG Y;
+	LONG VelocityX;
+	LONG VelocityY;
+	LONG AccelerationX;
+	LONG AccelerationY;
+	ULONG Time;
+	ULONG Samples;
+} RMI4_PREDICTOR_STATE;
+
+//
+// Contact tracking. Contacts are matched against the previous frame by
+// nearest neighbour, so a contact keeps its ID when the firmware moves
+// it to another slot and a contact landing in a slot just vacated gets
+// a new one. Matching is bounded to RMI4_TRACKER_MAX_CONTACTS contacts,
+// past that IDs follow the slots.
+//
+#define RMI4_TRACKER_MAX_CONTACTS         10
+#define RMI4_TRACKER_OVERFLOW             MAXULONG
+
+//
+// A contact of the previous frame and the distance it moved over the
+// frame before, which is where it is expected next
+//
+typedef struct _RMI4_TRACKED_CONTACT
+{
+	UCHAR Slot;
+	UCHAR Id;
+	USHORT X;
+	USHORT Y;
+	LONG DeltaX;
+	LONG DeltaY;
+} RMI4_TRACKED_CONTACT;
+
+//
+// A contact whose slot was taken by a new contact on this frame. It is
+// reported lifted at the position it was last reported at.
+//
+typedef struct _RMI4_CONTACT_LIFT
+{
+	UCHAR Id;
+	USHORT X;
+	USHORT Y;
+} RMI4_CONTACT_LIFT;
+
+typedef struct _RMI4_CONTACT_TRACKER
+{
+	ULONG Count;
+	RMI4_TRACKED_CONTACT Previous[RMI4_TRACKER_MAX_CONTACTS];
+	ULONG LiftCount;
+	RMI4_CONTACT_LIFT Lifts[RMI4_TRACKER_MAX_CONTACTS];
+} RMI4_CONTACT_TRACKER;
+
+//
+// Contact slots. The arrays and bitmaps hold MaxFingers entries and live
+// in slot storage sized when the touch function is configured. FingerSlot
+// holds the positions the controller reported, Report the positions the
+// contacts are reported at once filtered and predicted. Frame holds what
+// the controller reported on the last read, FrameValid the slots it
+// reported present. FilterPrimed marks the slots whose Filter
+// state follows a contact, Predictor holds the history used to
+// extrapolate each contact. ContactId is the ID each slot is reported
+// with, ContactTracked the slots present on the previous frame and
+// ContactHidden the slots not reported: lifted slots whose contact went
+// on in another slot, and new contacts waiting for a free ID.
+//
 typedef struct _RMI4_FINGER_CACHE
 {
-	RMI4_FINGER_INFO FingerSlot[RMI4_MAX_TOUCHES];
-	UINT32 FingerSlotValid;
-	UINT32 FingerSlotDirty;
-	int FingerDownOrder[RMI4_MAX_TOUCHES];
-	int FingerDownCount;
 	ULONG64 ScanTime;
-    BOOLEAN IsKey[RMI4_MAX_TOUCHES];
+	RMI4_FINGER_INFO* FingerSlot;
+	RMI4_FINGER_INFO* Frame;
+	RMI4_FINGER_INFO* Report;
+	RMI4_FILTER_STATE* Filter;
+	RMI4_PREDICTOR_STATE* Predictor;
+	BITMAP_WORD* FingerSlotValid;
+	BITMAP_WORD* FingerSlotDirty;
+	BITMAP_WORD* FrameValid;
+	BITMAP_WORD* KeyMask;
+	BITMAP_WORD* FilterPrimed;
+	BITMAP_WORD* ContactTracked;
+	BITMAP_WORD* ContactHidden;
+	UCHAR* ContactId;
+	RMI4_CONTACT_TRACKER* Tracker;
+	UCHAR* FingerDownOrder;
+	UCHAR FingerDownCount;
 } RMI4_FINGER_CACHE;
 
+typedef enum _RMI4_BUTTON_STATE
+{
+	ButtonStateUp = 0,
+	ButtonStateDown,
+	ButtonStateHeld
+} RMI4_BUTTON_STATE;
+
+//
+// A key combination sent on a button event. LatchKeys stay pressed
+// after the event until the button is released (e.g. ALT for ALT+TAB)
+//
+typedef struct _RMI4_BUTTON_ACTION
+{
+	UCHAR ReportId;
+	UCHAR Keys;
+	UCHAR LatchKeys;
+} RMI4_BUTTON_ACTION;
+
+typedef struct _RMI4_BUTTON_MAP
+{
+	RMI4_BUTTON_ACTION Tap;
+	RMI4_BUTTON_ACTION Hold;
+	ULONG HoldTime;
+	ULONG RepeatInterval;
+} RMI4_BUTTON_MAP;
+
 typedef struct _RMI4_BUTTONS_CACHE
 {
-    BOOLEAN prevPhysicalState[RMI4_MAX_BUTTONS];
-    BOOLEAN PhysicalState[RMI4_MAX_BUTTONS];
-    BOOLEAN LogicalState[RMI4_MAX_BUTTONS];
+	BOOLEAN PhysicalState[RMI4_MAX_BUTTONS];
+	UCHAR State[RMI4_MAX_BUTTONS];
+	ULONG64 NextEventTime[RMI4_MAX_BUTTONS];
+	ULONG64 TimerDeadline;
+	BOOLEAN TimerArmed;
 } RMI4_BUTTONS_CACHE;
 
+//
+// Touch screen areas reported as capacitive keys or swallowed as dead
+// zones, kept in controller coordinates. The bounding box of all regions
+// is split into columns along its longer axis, each column holding a mask
+// of the regions that cross it.
+//
+typedef struct _RMI4_BUTTON_REGION
+{
+	ULONG XMin;
+	ULONG YMin;
+	ULONG XMax;
+	ULONG YMax;
+	UCHAR Button;
+} RMI4_BUTTON_REGION;
+
+typedef struct _RMI4_BUTTON_REGIONS
+{
+	ULONG Count;
+	RMI4_BUTTON_REGION Region[RMI4_MAX_BUTTON_REGIONS];
+	ULONG XMin;
+	ULONG YMin;
+	ULONG XMax;
+	ULONG YMax;
+	BOOLEAN ColumnsOnY;
+	UCHAR ColumnShift;
+	UCHAR Columns[RMI4_BUTTON_REGION_COLUMNS];
+} RMI4_BUTTON_REGIONS;
+
+//
+// Controller configuration snapshot. Every registry source is read once
+// into a snapshot, validated, and compiled into the forms used at run
+// time: the register images written to F01 and F11, the screen
+// properties with their derived transform values, the button regions in
+// controller coordinates, the contact filter rates, the prediction
+// horizon, the contact tracking distance and the lux table. A snapshot is not modified
+// once published, a reload builds a new one and swaps the pointer under
+// the controller lock.
+//
+typedef struct _RMI4_CONFIG_SNAPSHOT
+{
+	ULONG Version;
+
+	RMI4_CONFIGURATION Settings;
+	TOUCH_SCREEN_PROPERTIES Props;
+
+	RMI4_F01_CTRL_REGISTERS F01Ctrl;
+	RMI4_F11_CTRL_REGISTERS F11Ctrl;
+
+	RMI4_BUTTON_REGIONS ButtonRegions;
+	RMI4_BUTTON_MAP ButtonMap[RMI4_MAX_BUTTONS];
+
+	RMI4_FILTER_PARAMETERS Filter;
+	RMI4_PREDICTOR_PARAMETERS Predictor;
+	RMI4_TRACKER_PARAMETERS Tracker;
+
+	ULONG LuxLevels;
+	BKL_LUX_TABLE_ENTRY LuxTable[BKL_MAX_LEVELS];
+} RMI4_CONFIG_SNAPSHOT;
+
+//
+// F54 capture settings. A completed report raises the F54 interrupt, it
+// is read from the interrupt and the next one requested right away, so
+// frames are captured at the rate the controller produces them. The
+// stream timer only sends the first request RMI4_F54_START_DELAY ms
+// after a start or a return to D0, then watches the stream every
+// RMI4_F54_REPORT_TIMEOUT ms and requests again if no report completed
+// in that time. It is a passive WDF timer: it fires on the system clock
+// tick, 15.6 ms by default, which is fine for a timeout but far too
+// coarse to pace captures with.
+//
+#define RMI4_F54_START_DELAY              1
+#define RMI4_F54_REPORT_TIMEOUT           100
+#define RMI4_F54_READ_CHUNK               256
+
+//
+// F54 report stream into a ring buffer owned by a diagnostic request.
+// Frames are read from the controller straight into the ring slots.
+//
+typedef struct _RMI4_F54_STREAM
+{
+	PUCHAR Ring;
+	ULONG FrameBytes;
+	ULONG SlotBytes;
+	ULONG SlotCount;
+	ULONG SlotOffset;
+	ULONG Sequence;
+	ULONG WatchdogSequence;
+	UCHAR ReportType;
+	BOOLEAN Active;
+	BOOLEAN ReportRequested;
+	WDFTIMER PollTimer;
+} RMI4_F54_STREAM;
+
+//
+// F34 flashing settings. Block writes are polled for completion
+// without sleeping, erase and mode changes take long enough to poll
+// every RMI4_F34_SLOW_POLL_INTERVAL ms. Timeouts are in ms.
+//
+#define RMI4_F34_FLASH_CONFIG_ONLY        0x00000001
+#define RMI4_F34_FLASH_RESUME             0x00000002
+
+#define RMI4_F34_SLOW_POLL_INTERVAL       10
+#define RMI4_F34_BLOCK_TIMEOUT            100
+#define RMI4_F34_ENABLE_TIMEOUT           1000
+#define RMI4_F34_ERASE_TIMEOUT            5000
+#define RMI4_F34_RESET_DELAY              100
+#define RMI4_F34_RESET_TIMEOUT            2000
+
+//
+// F34 update progress. It outlives a failed update so the update can
+// be resumed from the failed step with the same image.
+//
+typedef struct _RMI4_F34_FLASH
+{
+	RMI4_F34_FLASH_STATE State;
+	ULONG Flags;
+	ULONG ImageChecksum;
+	ULONG NextBlock;
+	RMI4_F34_QUERY_REGISTERS Query;
+	BYTE ControllerStatus;
+	NTSTATUS LastStatus;
+	ULONG BytesWritten;
+	ULONG BytesVerified;
+	ULONG64 StartTime;
+	ULONG64 ElapsedTime;
+} RMI4_F34_FLASH;
+
+//
+// Controller topology persisted in the device key, so that a start with
+// unchanged firmware skips function discovery. It is keyed by the F01
+// query registers holding the product ID and firmware build, which are
+// read back once to validate it. F12 register descriptors are kept as
+// read from the controller and parsed again when the function is
+// configured, F12Valid is cleared whenever the functions are rescanned.
+//
+#define RMI4_TOPOLOGY_SIGNATURE           (ULONG)'poTR'
+#define RMI4_TOPOLOGY_VERSION             2
+#define RMI4_TOPOLOGY_F12_BYTES           512
+#define TOUCH_TOPOLOGY_VALUE_NAME         L"RmiTopology"
+
+//
+// F01 query registers read when the firmware is identified, all of them
+// so that a build changing only the trailing product ID or build bytes
+// does not reuse the topology of the previous one
+//
+#define RMI4_F01_IDENTITY_BYTES           sizeof(RMI4_F01_QUERY_REGISTERS)
+
+typedef struct _RMI4_TOPOLOGY
+{
+	ULONG Signature;
+	ULONG Version;
+	RMI4_F01_QUERY_REGISTERS F01QueryRegisters;
+	ULONG FunctionCount;
+	RMI4_FUNCTION_DESCRIPTOR Descriptors[RMI4_MAX_FUNCTIONS];
+	UCHAR FunctionOnPage[RMI4_MAX_FUNCTIONS];
+	ULONG FunctionIrqMask[RMI4_MAX_FUNCTIONS];
+	BOOLEAN F12Valid;
+	UCHAR F12PresenceSize[RMI_REG_DESC_COUNT];
+	UCHAR F12Presence[RMI_REG_DESC_COUNT][RMI_REG_DESC_PRESENCE_MAX];
+	USHORT F12StructSize[RMI_REG_DESC_COUNT];
+	UCHAR F12Structs[RMI4_TOPOLOGY_F12_BYTES];
+} RMI4_TOPOLOGY;
+
+//
+// Controller configuration. It is written when the controller is started
+// or reconfigured and only read while servicing interrupts, so it is
+// allocated apart from the per frame state.
+//
+typedef struct _RMI4_CONTROLLER_SETUP
+{
+	RMI4_F01_QUERY_REGISTERS F01QueryRegisters;
+	RMI4_F54_QUERY_REGISTERS F54QueryRegisters;
+
+	//
+	// RMI4 F12 register descriptors, the items and subpacket maps live in
+	// F12DescArena which is released on stop and on reconfiguration
+	//
+	RMI_DESC_ARENA F12DescArena;
+	RMI_REGISTER_DESCRIPTOR QueryRegDesc;
+	RMI_REGISTER_DESCRIPTOR ControlRegDesc;
+	RMI_REGISTER_DESCRIPTOR DataRegDesc;
+
+	//
+	// Topology of the running firmware, TopologyCached is set when it
+	// was taken from the device key instead of discovered
+	//
+	RMI4_TOPOLOGY Topology;
+	BOOLEAN TopologyCached;
+} RMI4_CONTROLLER_SETUP;
+
 typedef struct _RMI4_CONTROLLER_CONTEXT
 {
+	//
+	// Per frame state, read or written on every interrupt. It is kept
+	// together at the start of the context, apart from the configuration
+	// in Setup. Keep anything that is not touched on every interrupt out
+	// of this block.
+	//
+	DECLSPEC_CACHEALIGN RMI4_FINGER_CACHE FingerCache;
+	ULONG InterruptStatus;
+
+	//
+	// Interrupt sources serviced by the driver and the mask last
+	// programmed into F01. Button, touch and test reporting sources are
+	// dropped while the display is off.
+	//
+	ULONG DeviceIrqMask;
+	ULONG TouchIrqMask;
+	ULONG ButtonIrqMask;
+	ULONG TestIrqMask;
+	ULONG InterruptEnableMask;
+	int CurrentPage;
+	BOOLEAN DisplayOff;
+
+	int HidQueueCount;
+	int HidQueueCapacity;
+	PHID_INPUT_REPORT HidQueue;
+
 	WDFDEVICE FxDevice;
 	WDFWAITLOCK ControllerLock;
 
+	RMI4_CONTROLLER_SETUP* Setup;
+
+	//
+	// Published configuration snapshot. ConfigurePending is set when a
+	// reload changed the register images while the controller could not
+	// be programmed, they are written when it is next woken.
+	//
+	RMI4_CONFIG_SNAPSHOT* Config;
+	BOOLEAN ConfigurePending;
+
 	//
 	// Controller state
 	//
 	int FunctionCount;
 	RMI4_FUNCTION_DESCRIPTOR Descriptors[RMI4_MAX_FUNCTIONS];
 	int FunctionOnPage[RMI4_MAX_FUNCTIONS];
-	int CurrentPage;
+	ULONG FunctionIrqMask[RMI4_MAX_FUNCTIONS];
 
-	ULONG InterruptStatus;
+	PVOID MonitorChangeNotificationHandle;
+
+	//
+	// Screen-off low power state transitions, latencies in 100ns units
+	//
+	ULONG ScreenOffTransitions;
+	ULONG64 ScreenOffLatency;
+	ULONG64 ScreenOnLatency;
 
 	BOOLEAN HasButtons;
 	BOOLEAN ResetOccurred;
@@ -136,66 +582,80 @@ typedef struct _RMI4_CONTROLLER_CONTEXT
 	BOOLEAN DeviceFailure;
 	BOOLEAN UnknownStatus;
 	BOOLEAN IsF12Digitizer;
+	BOOLEAN HasTestReporting;
 
 	BYTE UnknownStatusMessage;
 
-	RMI4_F01_QUERY_REGISTERS F01QueryRegisters;
-
 	//
 	// Power state
 	//
 	DEVICE_POWER_STATE DevicePowerState;
 
 	//
-	// Register configuration programmed to chip
+	// Backlight keys. Set up by the start work item along with the rest
+	// of the device start that touch input does not wait for.
 	//
-	TOUCH_SCREEN_PROPERTIES Props;
-	RMI4_CONFIGURATION Config;
+	BKL_CONTEXT* BklContext;
+	WDFWORKITEM StartWorkItem;
 
 	//
-	// Current touch state
+	// RMI4 F12 state
 	//
-	RMI4_FINGER_CACHE FingerCache;
+	size_t PacketSize;
+
+	USHORT Data1Offset;
+	BYTE MaxFingers;
 
 	//
-	// Backlight keys
+	// Backing storage of the finger cache and the HID report queue,
+	// SlotCapacity is the MaxFingers it was sized for
 	//
-	BKL_CONTEXT* BklContext;
+	PVOID SlotStorage;
+	BYTE SlotCapacity;
 
 	//
-	// RMI4 F12 state
+	// F12 Ctrl20 (reporting control) shadow, used to switch between
+	// continuous and reduced reporting without re-reading the register
 	//
+	UCHAR F12Ctrl20Address;
+	UCHAR F12Ctrl20Shadow[3];
+	BOOLEAN F12Ctrl20Valid;
+	UCHAR F12ReportingMode;
+	ULONG F12StillFrames;
 
-	/*
-		!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	
-		DO NOT remove these. Even if the variables are not
-		used by any function down the line, these have an effect
-		on memory allocation. If you remove these and make them
-		local to a function, you will BREAK F12 and register
-		readings.
-
-		!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
-	*/
-
-	RMI_REGISTER_DESCRIPTOR QueryRegDesc;
-	RMI_REGISTER_DESCRIPTOR ControlRegDesc;
-	RMI_REGISTER_DESCRIPTOR DataRegDesc;
-	size_t PacketSize;
+	//
+	// RMI4 F54 raw capacitance capture
+	//
+	RMI4_F54_STREAM F54Stream;
 
-	USHORT Data1Offset;
-	BYTE MaxFingers;
+	//
+	// RMI4 F34 firmware update
+	//
+	RMI4_F34_FLASH F34Flash;
 
 	//
 	// Current button state
 	//
 	RMI4_BUTTONS_CACHE ButtonsCache;
     WDFTIMER ButtonsTimer;
-
-    HID_INPUT_REPORT HidQueue[MAX_REPORTS_IN_QUEUE];
-    int HidQueueCount;
 } RMI4_CONTROLLER_CONTEXT;
 
+//
+// Keep the per frame block from growing unnoticed, it fits in five 64
+// byte lines today
+//
+C_ASSERT(FIELD_OFFSET(RMI4_CONTROLLER_CONTEXT, FxDevice) <= 5 * 64);
+
+//
+// Maximum Count of the report descriptor, Contact Identifiers range
+// from 0 to one less
+//
+#define RMI4_REPORT_MAX_COUNT(Controller) \
+	(((Controller)->MaxFingers != 0) ? (USHORT)(Controller)->MaxFingers : (USHORT)OEM_MAX_TOUCHES)
+
+POWER_SETTING_CALLBACK TchOnDisplayStateChange;
+EVT_WDF_WORKITEM TchStartWorkItem;
+
 NTSTATUS
 RmiCheckInterrupts(
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
@@ -203,6 +663,18 @@ RmiCheckInterrupts(
 	IN ULONG* InterruptStatus
 );
 
+NTSTATUS
+RmiApplyPendingConfiguration(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
+NTSTATUS
+RmiBuildFunctionsTable(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+);
+
 int
 RmiGetFunctionIndex(
 	IN RMI4_FUNCTION_DESCRIPTOR* FunctionDescriptors,
@@ -217,17 +689,55 @@ RmiChangePage(
 	IN int DesiredPage
 );
 
+NTSTATUS
+TchConfigBuild(
+	IN WDFDEVICE FxDevice,
+	OUT RMI4_CONFIG_SNAPSHOT** Config
+);
+
+VOID
+TchConfigFree(
+	IN RMI4_CONFIG_SNAPSHOT* Config
+);
+
+NTSTATUS
+TchRegistryReadTopology(
+	IN WDFDEVICE FxDevice,
+	OUT RMI4_TOPOLOGY* Topology
+);
+
+NTSTATUS
+TchRegistryWriteTopology(
+	IN WDFDEVICE FxDevice,
+	IN const RMI4_TOPOLOGY* Topology
+);
+
 NTSTATUS
 RmiGetTouchesFromController(
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
 	IN SPB_CONTEXT* SpbContext
 );
 
-UINT8 RmiGetRegisterIndex(
+USHORT RmiGetRegisterIndex(
 	PRMI_REGISTER_DESCRIPTOR Rdesc,
 	USHORT reg
 );
 
+NTSTATUS
+RmiAllocateSlotStorage(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+VOID
+RmiFreeSlotStorage(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
+VOID
+RmiResetFingerCache(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+);
+
 NTSTATUS
 GetNextHidReport(
     IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
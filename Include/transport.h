@@ -0,0 +1,148 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		transport.h
+
+	Abstract:
+
+		This module contains the RMI4 bus transport definitions. The
+		controller is reached through an SPB target over I2C or SPI,
+		the touch core only uses the Spb* routines below and does not
+		know which bus is in use.
+
+	Environment:
+
+		Kernel Mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+#include <wdf.h>
+
+#define DEFAULT_SPB_BUFFER_SIZE 64
+
+typedef struct _SPB_CONTEXT SPB_CONTEXT;
+
+//
+// Transport operations. They are called with SpbLock held and take the
+// full 16 bit RMI address, the page in the high byte.
+//
+typedef NTSTATUS
+SPB_TRANSPORT_READ(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+typedef NTSTATUS
+SPB_TRANSPORT_WRITE(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+typedef NTSTATUS
+SPB_TRANSPORT_SET_PAGE(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Page
+);
+
+typedef struct _SPB_TRANSPORT
+{
+	PCSTR Name;
+
+	//
+	// Largest payload moved by one Read or Write burst
+	//
+	ULONG MaxTransferSize;
+
+	SPB_TRANSPORT_READ* Read;
+	SPB_TRANSPORT_WRITE* Write;
+	SPB_TRANSPORT_SET_PAGE* SetPage;
+} SPB_TRANSPORT;
+
+extern const SPB_TRANSPORT SpbI2cTransport;
+extern const SPB_TRANSPORT SpbSpiTransport;
+
+//
+// SPB (I2C or SPI) context
+//
+
+typedef struct _SPB_CONTEXT
+{
+	const SPB_TRANSPORT* Transport;
+	WDFIOTARGET SpbIoTarget;
+	LARGE_INTEGER ResHubId;
+	WDFMEMORY WriteMemory;
+	WDFMEMORY ReadMemory;
+	WDFWAITLOCK SpbLock;
+	UCHAR Page;
+
+	//
+	// Private state of transports not built on SpbIoTarget
+	//
+	PVOID TransportContext;
+} SPB_CONTEXT;
+
+NTSTATUS
+SpbReadDataSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Address,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+NTSTATUS
+SpbSetPage(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Page
+);
+
+ULONG
+SpbGetMaxTransferSize(
+	IN SPB_CONTEXT* SpbContext
+);
+
+VOID
+SpbTargetDeinitialize(
+	IN WDFDEVICE FxDevice,
+	IN SPB_CONTEXT* SpbContext
+);
+
+NTSTATUS
+SpbTargetInitialize(
+	IN WDFDEVICE FxDevice,
+	IN SPB_CONTEXT* SpbContext
+);
+
+NTSTATUS
+SpbWriteDataSynchronously(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Address,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+//
+// Helpers shared by the transport implementations
+//
+
+NTSTATUS
+SpbSendWrite(
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Header,
+	IN ULONG HeaderLength,
+	IN PVOID Data,
+	IN ULONG Length
+);
+
+SPB_TRANSPORT_SET_PAGE SpbSetPageRegister;
@@ -0,0 +1,37 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		debug.h
+
+	Abstract:
+
+		Wraps the driver's debug.h so Trace goes through the daemon's
+		log, filtered by level, and accepts messages without arguments.
+		Flags are dropped like in the driver build.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include_next "debug.h"
+
+#undef Trace
+
+#define Trace(Level, Flags, Msg, ...) \
+	HostTrace((Level), "ST: " Msg "\n", ##__VA_ARGS__)
+
+VOID
+HostTrace(
+	IN ULONG Level,
+	IN PCSTR Format,
+	...
+);
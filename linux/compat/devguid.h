@@ -0,0 +1,24 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		devguid.h
+
+	Abstract:
+
+		Device setup class GUIDs. The core names none of them, the header
+		only has to exist.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
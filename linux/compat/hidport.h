@@ -0,0 +1,25 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		hidport.h
+
+	Abstract:
+
+		HID class miniport definitions. The host delivers reports to a
+		sink instead of HIDClass, the shared headers only need the
+		report structures they define themselves.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdf.h>
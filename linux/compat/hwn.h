@@ -0,0 +1,69 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		hwn.h
+
+	Abstract:
+
+		Hardware notification (LED) interface the backlight context drives.
+		The host has no HWN driver, the unit checks register their own
+		target under HWN_DEVINTERFACE_NLED. The values are the host's own.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+
+// {C2D3B9B4-7F6E-4B8C-9A5D-1E2F3A4B5C6D}
+DEFINE_GUID(HWN_DEVINTERFACE_NLED,
+	0xC2D3B9B4, 0x7F6E, 0x4B8C, 0x9A, 0x5D, 0x1E, 0x2F, 0x3A, 0x4B, 0x5C, 0x6D);
+
+#define FILE_DEVICE_HWN 0x00008000
+
+#define IOCTL_HWN_SET_STATE \
+	CTL_CODE(FILE_DEVICE_HWN, 0x801, METHOD_BUFFERED, FILE_ANY_ACCESS)
+
+//
+// HwNType
+//
+#define HWN_LED 0
+
+//
+// OffOnBlink
+//
+#define HWN_OFF   0
+#define HWN_ON    1
+#define HWN_BLINK 2
+
+//
+// Index of each setting in HwNSettings
+//
+#define HWN_INTENSITY 0
+
+typedef struct _HWN_SETTINGS
+{
+	ULONG HwNId;
+	ULONG HwNType;
+	ULONG OffOnBlink;
+	ULONG HwNSettings[10];
+} HWN_SETTINGS;
+
+typedef struct _HWN_HEADER
+{
+	ULONG HwNPayloadSize;
+	ULONG HwNPayloadVersion;
+	ULONG HwNRequests;
+	HWN_SETTINGS HwNSettingsInfo[ANYSIZE_ARRAY];
+} HWN_HEADER, * PHWN_HEADER;
+
+#define HWN_HEADER_SIZE FIELD_OFFSET(HWN_HEADER, HwNSettingsInfo)
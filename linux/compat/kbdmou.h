@@ -0,0 +1,24 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		kbdmou.h
+
+	Abstract:
+
+		Keyboard and mouse class definitions, nothing is used by the
+		touch core on the host.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
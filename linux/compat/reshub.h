@@ -0,0 +1,32 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		reshub.h
+
+	Abstract:
+
+		Resource hub definitions. There is no resource hub on the host,
+		building a path always fails like the I/O targets it would open.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+
+#define RESOURCE_HUB_PATH_SIZE 128
+
+#define RESOURCE_HUB_CREATE_PATH_FROM_ID(RequestString, IdLowPart, IdHighPart) \
+	(UNREFERENCED_PARAMETER(RequestString), \
+	 UNREFERENCED_PARAMETER(IdLowPart), \
+	 UNREFERENCED_PARAMETER(IdHighPart), \
+	 STATUS_NOT_SUPPORTED)
@@ -0,0 +1,122 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		spb.h
+
+	Abstract:
+
+		SPB transfer lists, as sent with IOCTL_SPB_EXECUTE_SEQUENCE. Only
+		simple buffers are used by the core, the simulated bus behind
+		HostSimOpen executes them.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+
+#define FILE_DEVICE_SPB 0x0000003e
+
+#define IOCTL_SPB_EXECUTE_SEQUENCE \
+	CTL_CODE(FILE_DEVICE_SPB, 0x0001, METHOD_NEITHER, FILE_ANY_ACCESS)
+
+typedef enum _SPB_TRANSFER_DIRECTION
+{
+	SpbTransferDirectionNone = 0,
+	SpbTransferDirectionFromDevice,
+	SpbTransferDirectionToDevice,
+	SpbTransferDirectionMax
+} SPB_TRANSFER_DIRECTION;
+
+typedef enum _SPB_TRANSFER_BUFFER_FORMAT
+{
+	SpbTransferBufferFormatInvalid = 0,
+	SpbTransferBufferFormatSimple,
+	SpbTransferBufferFormatList,
+	SpbTransferBufferFormatSimpleNonPaged,
+	SpbTransferBufferFormatMdl,
+	SpbTransferBufferFormatMax
+} SPB_TRANSFER_BUFFER_FORMAT;
+
+typedef struct _SPB_TRANSFER_BUFFER
+{
+	SPB_TRANSFER_BUFFER_FORMAT Format;
+	union
+	{
+		struct
+		{
+			PVOID Buffer;
+			ULONG BufferCb;
+		} Simple;
+	};
+} SPB_TRANSFER_BUFFER, * PSPB_TRANSFER_BUFFER;
+
+typedef struct _SPB_TRANSFER_LIST_ENTRY
+{
+	SPB_TRANSFER_DIRECTION Direction;
+	ULONG DelayInUs;
+	SPB_TRANSFER_BUFFER Buffer;
+} SPB_TRANSFER_LIST_ENTRY, * PSPB_TRANSFER_LIST_ENTRY;
+
+typedef struct _SPB_TRANSFER_LIST
+{
+	ULONG Size;
+	ULONG Reserved;
+	ULONG TransferCount;
+	SPB_TRANSFER_LIST_ENTRY Transfers[1];
+} SPB_TRANSFER_LIST, * PSPB_TRANSFER_LIST;
+
+//
+// A transfer list with room for Count entries, Transfers[i] is valid
+// for every i below Count
+//
+#define SPB_TRANSFER_LIST_AND_ENTRIES(Count) \
+	union \
+	{ \
+		SPB_TRANSFER_LIST List; \
+		UCHAR Space[FIELD_OFFSET(SPB_TRANSFER_LIST, Transfers) + \
+			(Count) * sizeof(SPB_TRANSFER_LIST_ENTRY)]; \
+	}
+
+static inline VOID
+SPB_TRANSFER_LIST_INIT(
+	OUT PSPB_TRANSFER_LIST List,
+	IN ULONG TransferCount
+)
+{
+	RtlZeroMemory(
+		List,
+		FIELD_OFFSET(SPB_TRANSFER_LIST, Transfers) +
+			TransferCount * sizeof(SPB_TRANSFER_LIST_ENTRY));
+	List->Size = sizeof(SPB_TRANSFER_LIST);
+	List->TransferCount = TransferCount;
+}
+
+static inline SPB_TRANSFER_LIST_ENTRY
+SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+	IN SPB_TRANSFER_DIRECTION Direction,
+	IN ULONG DelayInUs,
+	IN PVOID Buffer,
+	IN ULONG BufferCb
+)
+{
+	SPB_TRANSFER_LIST_ENTRY entry;
+
+	RtlZeroMemory(&entry, sizeof(entry));
+	entry.Direction = Direction;
+	entry.DelayInUs = DelayInUs;
+	entry.Buffer.Format = SpbTransferBufferFormatSimple;
+	entry.Buffer.Simple.Buffer = Buffer;
+	entry.Buffer.Simple.BufferCb = BufferCb;
+
+	return entry;
+}
@@ -0,0 +1,702 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		wdf.h
+
+	Abstract:
+
+		The subset of KMDF the touch core uses, implemented over a small
+		object model in wdfhost.c. Every handle is a HOST_OBJECT, deleted
+		with its children. Wait locks are mutexes, timers are timerfds
+		serviced by the event loop and registry keys read the daemon
+		configuration.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+
+typedef struct _HOST_OBJECT* WDFOBJECT;
+
+typedef WDFOBJECT WDFDEVICE;
+typedef WDFOBJECT WDFDRIVER;
+typedef WDFOBJECT WDFQUEUE;
+typedef WDFOBJECT WDFREQUEST;
+typedef WDFOBJECT WDFINTERRUPT;
+typedef WDFOBJECT WDFWAITLOCK;
+typedef WDFOBJECT WDFTIMER;
+typedef WDFOBJECT WDFWORKITEM;
+typedef WDFOBJECT WDFIOTARGET;
+typedef WDFOBJECT WDFMEMORY;
+typedef WDFOBJECT WDFCOLLECTION;
+typedef WDFOBJECT WDFKEY;
+typedef WDFOBJECT WDFSTRING;
+typedef PVOID WDFCONTEXT;
+
+#define WDF_NO_OBJECT_ATTRIBUTES NULL
+#define WDF_NO_HANDLE NULL
+
+//
+// Objects and contexts
+//
+
+typedef struct _WDF_OBJECT_CONTEXT_TYPE_INFO
+{
+	PCSTR ContextName;
+	SIZE_T ContextSize;
+} WDF_OBJECT_CONTEXT_TYPE_INFO, * PWDF_OBJECT_CONTEXT_TYPE_INFO;
+
+typedef enum _WDF_EXECUTION_LEVEL
+{
+	WdfExecutionLevelInvalid = 0,
+	WdfExecutionLevelInheritFromParent,
+	WdfExecutionLevelPassive,
+	WdfExecutionLevelDispatch
+} WDF_EXECUTION_LEVEL;
+
+typedef enum _WDF_SYNCHRONIZATION_SCOPE
+{
+	WdfSynchronizationScopeInvalid = 0,
+	WdfSynchronizationScopeInheritFromParent,
+	WdfSynchronizationScopeDevice,
+	WdfSynchronizationScopeQueue,
+	WdfSynchronizationScopeNone
+} WDF_SYNCHRONIZATION_SCOPE;
+
+typedef VOID EVT_WDF_OBJECT_CONTEXT_CLEANUP(IN WDFOBJECT Object);
+typedef VOID EVT_WDF_OBJECT_CONTEXT_DESTROY(IN WDFOBJECT Object);
+
+typedef struct _WDF_OBJECT_ATTRIBUTES
+{
+	ULONG Size;
+	EVT_WDF_OBJECT_CONTEXT_CLEANUP* EvtCleanupCallback;
+	EVT_WDF_OBJECT_CONTEXT_DESTROY* EvtDestroyCallback;
+	WDF_EXECUTION_LEVEL ExecutionLevel;
+	WDF_SYNCHRONIZATION_SCOPE SynchronizationScope;
+	WDFOBJECT ParentObject;
+	SIZE_T ContextSizeOverride;
+	const WDF_OBJECT_CONTEXT_TYPE_INFO* ContextTypeInfo;
+} WDF_OBJECT_ATTRIBUTES, * PWDF_OBJECT_ATTRIBUTES;
+
+static inline VOID
+WDF_OBJECT_ATTRIBUTES_INIT(
+	OUT PWDF_OBJECT_ATTRIBUTES Attributes
+)
+{
+	RtlZeroMemory(Attributes, sizeof(WDF_OBJECT_ATTRIBUTES));
+	Attributes->Size = sizeof(WDF_OBJECT_ATTRIBUTES);
+	Attributes->ExecutionLevel = WdfExecutionLevelInheritFromParent;
+	Attributes->SynchronizationScope = WdfSynchronizationScopeInheritFromParent;
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	IN WDFOBJECT Handle,
+	IN const WDF_OBJECT_CONTEXT_TYPE_INFO* TypeInfo
+);
+
+#define WDF_DECLARE_CONTEXT_TYPE_WITH_NAME(_contexttype, _castingfunction) \
+	static const WDF_OBJECT_CONTEXT_TYPE_INFO WDF_##_contexttype##_TYPE_INFO = \
+		{ #_contexttype, sizeof(_contexttype) }; \
+	static inline _contexttype* \
+	_castingfunction(WDFOBJECT Handle) \
+	{ \
+		return (_contexttype*)WdfObjectGetTypedContextWorker( \
+			Handle, &WDF_##_contexttype##_TYPE_INFO); \
+	}
+
+#define WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(_attributes, _contexttype) \
+	(_attributes)->ContextTypeInfo = &WDF_##_contexttype##_TYPE_INFO
+
+#define WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(_attributes, _contexttype) \
+	WDF_OBJECT_ATTRIBUTES_INIT(_attributes); \
+	WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(_attributes, _contexttype)
+
+NTSTATUS
+WdfObjectCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFOBJECT* Object
+);
+
+VOID
+WdfObjectDelete(
+	IN WDFOBJECT Object
+);
+
+//
+// Drivers
+//
+
+WDFDRIVER
+WdfGetDriver(
+	VOID
+);
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	IN WDFDRIVER Driver
+);
+
+//
+// Devices
+//
+
+#define PLUGPLAY_REGKEY_DEVICE 1
+#define PLUGPLAY_REGKEY_DRIVER 2
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetDeviceObject(
+	IN WDFDEVICE Device
+);
+
+NTSTATUS
+WdfDeviceOpenRegistryKey(
+	IN WDFDEVICE Device,
+	IN ULONG DeviceInstanceKeyType,
+	IN ACCESS_MASK DesiredAccess,
+	IN PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	OUT WDFKEY* Key
+);
+
+//
+// Wait locks
+//
+
+NTSTATUS
+WdfWaitLockCreate(
+	IN PWDF_OBJECT_ATTRIBUTES LockAttributes,
+	OUT WDFWAITLOCK* Lock
+);
+
+NTSTATUS
+WdfWaitLockAcquire(
+	IN WDFWAITLOCK Lock,
+	IN PLONGLONG Timeout
+);
+
+VOID
+WdfWaitLockRelease(
+	IN WDFWAITLOCK Lock
+);
+
+//
+// Timers
+//
+
+typedef VOID EVT_WDF_TIMER(IN WDFTIMER Timer);
+typedef EVT_WDF_TIMER* PFN_WDF_TIMER;
+
+typedef struct _WDF_TIMER_CONFIG
+{
+	ULONG Size;
+	PFN_WDF_TIMER EvtTimerFunc;
+	ULONG Period;
+	BOOLEAN AutomaticSerialization;
+	ULONG TolerableDelay;
+	BOOLEAN UseHighResolutionTimer;
+} WDF_TIMER_CONFIG, * PWDF_TIMER_CONFIG;
+
+static inline VOID
+WDF_TIMER_CONFIG_INIT(
+	OUT PWDF_TIMER_CONFIG Config,
+	IN PFN_WDF_TIMER EvtTimerFunc
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_TIMER_CONFIG));
+	Config->Size = sizeof(WDF_TIMER_CONFIG);
+	Config->EvtTimerFunc = EvtTimerFunc;
+	Config->AutomaticSerialization = TRUE;
+}
+
+#define WDF_REL_TIMEOUT_IN_SEC(Time) ((LONGLONG)(Time) * -10000000LL)
+#define WDF_REL_TIMEOUT_IN_MS(Time)  ((LONGLONG)(Time) * -10000LL)
+#define WDF_REL_TIMEOUT_IN_US(Time)  ((LONGLONG)(Time) * -10LL)
+
+NTSTATUS
+WdfTimerCreate(
+	IN PWDF_TIMER_CONFIG Config,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFTIMER* Timer
+);
+
+BOOLEAN
+WdfTimerStart(
+	IN WDFTIMER Timer,
+	IN LONGLONG DueTime
+);
+
+BOOLEAN
+WdfTimerStop(
+	IN WDFTIMER Timer,
+	IN BOOLEAN Wait
+);
+
+WDFOBJECT
+WdfTimerGetParentObject(
+	IN WDFTIMER Timer
+);
+
+//
+// Work items
+//
+
+typedef VOID EVT_WDF_WORKITEM(IN WDFWORKITEM WorkItem);
+typedef EVT_WDF_WORKITEM* PFN_WDF_WORKITEM;
+
+typedef struct _WDF_WORKITEM_CONFIG
+{
+	ULONG Size;
+	PFN_WDF_WORKITEM EvtWorkItemFunc;
+	BOOLEAN AutomaticSerialization;
+} WDF_WORKITEM_CONFIG, * PWDF_WORKITEM_CONFIG;
+
+static inline VOID
+WDF_WORKITEM_CONFIG_INIT(
+	OUT PWDF_WORKITEM_CONFIG Config,
+	IN PFN_WDF_WORKITEM EvtWorkItemFunc
+)
+{
+	RtlZeroMemory(Config, sizeof(WDF_WORKITEM_CONFIG));
+	Config->Size = sizeof(WDF_WORKITEM_CONFIG);
+	Config->EvtWorkItemFunc = EvtWorkItemFunc;
+	Config->AutomaticSerialization = TRUE;
+}
+
+NTSTATUS
+WdfWorkItemCreate(
+	IN PWDF_WORKITEM_CONFIG Config,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFWORKITEM* WorkItem
+);
+
+VOID
+WdfWorkItemEnqueue(
+	IN WDFWORKITEM WorkItem
+);
+
+VOID
+WdfWorkItemFlush(
+	IN WDFWORKITEM WorkItem
+);
+
+WDFOBJECT
+WdfWorkItemGetParentObject(
+	IN WDFWORKITEM WorkItem
+);
+
+//
+// Memory
+//
+
+NTSTATUS
+WdfMemoryCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN POOL_TYPE PoolType,
+	IN ULONG PoolTag,
+	IN SIZE_T BufferSize,
+	OUT WDFMEMORY* Memory,
+	OUT PVOID* Buffer
+);
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN PVOID Buffer,
+	IN SIZE_T BufferSize,
+	OUT WDFMEMORY* Memory
+);
+
+PVOID
+WdfMemoryGetBuffer(
+	IN WDFMEMORY Memory,
+	OUT SIZE_T* BufferSize
+);
+
+typedef struct _WDFMEMORY_OFFSET
+{
+	SIZE_T BufferOffset;
+	SIZE_T BufferLength;
+} WDFMEMORY_OFFSET, * PWDFMEMORY_OFFSET;
+
+typedef enum _WDF_MEMORY_DESCRIPTOR_TYPE
+{
+	WdfMemoryDescriptorTypeInvalid = 0,
+	WdfMemoryDescriptorTypeBuffer,
+	WdfMemoryDescriptorTypeMdl,
+	WdfMemoryDescriptorTypeHandle
+} WDF_MEMORY_DESCRIPTOR_TYPE;
+
+typedef struct _WDF_MEMORY_DESCRIPTOR
+{
+	WDF_MEMORY_DESCRIPTOR_TYPE Type;
+	union
+	{
+		struct
+		{
+			PVOID Buffer;
+			ULONG Length;
+		} BufferType;
+		struct
+		{
+			WDFMEMORY Memory;
+			PWDFMEMORY_OFFSET Offsets;
+		} HandleType;
+	} u;
+} WDF_MEMORY_DESCRIPTOR, * PWDF_MEMORY_DESCRIPTOR;
+
+static inline VOID
+WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+	OUT PWDF_MEMORY_DESCRIPTOR Descriptor,
+	IN PVOID Buffer,
+	IN ULONG BufferLength
+)
+{
+	RtlZeroMemory(Descriptor, sizeof(WDF_MEMORY_DESCRIPTOR));
+	Descriptor->Type = WdfMemoryDescriptorTypeBuffer;
+	Descriptor->u.BufferType.Buffer = Buffer;
+	Descriptor->u.BufferType.Length = BufferLength;
+}
+
+static inline VOID
+WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
+	OUT PWDF_MEMORY_DESCRIPTOR Descriptor,
+	IN WDFMEMORY Memory,
+	IN PWDFMEMORY_OFFSET Offsets
+)
+{
+	RtlZeroMemory(Descriptor, sizeof(WDF_MEMORY_DESCRIPTOR));
+	Descriptor->Type = WdfMemoryDescriptorTypeHandle;
+	Descriptor->u.HandleType.Memory = Memory;
+	Descriptor->u.HandleType.Offsets = Offsets;
+}
+
+//
+// I/O targets. A target opened by name is served by the device
+// interface the host registered under that name, there is no resource
+// hub. The simulator creates its own target with HostIoTargetCreate so
+// the I2C and SPI transports can run against it.
+//
+
+#define WDF_REQUEST_SEND_OPTION_TIMEOUT             0x00000001
+#define WDF_REQUEST_SEND_OPTION_SYNCHRONOUS         0x00000002
+#define WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE 0x00000004
+
+typedef struct _WDF_REQUEST_SEND_OPTIONS
+{
+	ULONG Size;
+	ULONG Flags;
+	LONGLONG Timeout;
+} WDF_REQUEST_SEND_OPTIONS, * PWDF_REQUEST_SEND_OPTIONS;
+
+#define WDF_NO_SEND_OPTIONS NULL
+
+static inline VOID
+WDF_REQUEST_SEND_OPTIONS_INIT(
+	OUT PWDF_REQUEST_SEND_OPTIONS Options,
+	IN ULONG Flags
+)
+{
+	RtlZeroMemory(Options, sizeof(WDF_REQUEST_SEND_OPTIONS));
+	Options->Size = sizeof(WDF_REQUEST_SEND_OPTIONS);
+	Options->Flags = Flags;
+}
+
+typedef enum _WDF_IO_TARGET_SENT_IO_ACTION
+{
+	WdfIoTargetSentIoUndefined = 0,
+	WdfIoTargetCancelSentIo,
+	WdfIoTargetWaitForSentIoToComplete,
+	WdfIoTargetLeaveSentIoPending
+} WDF_IO_TARGET_SENT_IO_ACTION;
+
+typedef enum _WDF_IO_TARGET_OPEN_TYPE
+{
+	WdfIoTargetOpenUndefined = 0,
+	WdfIoTargetOpenUseExistingDevice,
+	WdfIoTargetOpenByName
+} WDF_IO_TARGET_OPEN_TYPE;
+
+typedef struct _WDF_IO_TARGET_OPEN_PARAMS
+{
+	ULONG Size;
+	WDF_IO_TARGET_OPEN_TYPE Type;
+	PCUNICODE_STRING TargetDeviceName;
+	ACCESS_MASK DesiredAccess;
+	ULONG ShareAccess;
+	ULONG FileAttributes;
+	ULONG CreateDisposition;
+} WDF_IO_TARGET_OPEN_PARAMS, * PWDF_IO_TARGET_OPEN_PARAMS;
+
+static inline VOID
+WDF_IO_TARGET_OPEN_PARAMS_INIT_OPEN_BY_NAME(
+	OUT PWDF_IO_TARGET_OPEN_PARAMS Params,
+	IN PCUNICODE_STRING TargetDeviceName,
+	IN ACCESS_MASK DesiredAccess
+)
+{
+	RtlZeroMemory(Params, sizeof(WDF_IO_TARGET_OPEN_PARAMS));
+	Params->Size = sizeof(WDF_IO_TARGET_OPEN_PARAMS);
+	Params->Type = WdfIoTargetOpenByName;
+	Params->TargetDeviceName = TargetDeviceName;
+	Params->DesiredAccess = DesiredAccess;
+}
+
+NTSTATUS
+WdfIoTargetCreate(
+	IN WDFDEVICE Device,
+	IN PWDF_OBJECT_ATTRIBUTES IoTargetAttributes,
+	OUT WDFIOTARGET* IoTarget
+);
+
+NTSTATUS
+WdfIoTargetOpen(
+	IN WDFIOTARGET IoTarget,
+	IN PWDF_IO_TARGET_OPEN_PARAMS OpenParams
+);
+
+NTSTATUS
+WdfIoTargetStart(
+	IN WDFIOTARGET IoTarget
+);
+
+VOID
+WdfIoTargetStop(
+	IN WDFIOTARGET IoTarget,
+	IN WDF_IO_TARGET_SENT_IO_ACTION Action
+);
+
+NTSTATUS
+WdfIoTargetSendWriteSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	IN PLONGLONG DeviceOffset,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesWritten
+);
+
+NTSTATUS
+WdfIoTargetSendReadSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	IN PLONGLONG DeviceOffset,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesRead
+);
+
+NTSTATUS
+WdfIoTargetSendIoctlSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN ULONG IoctlCode,
+	IN PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	IN PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesReturned
+);
+
+//
+// Requests sent asynchronously to an I/O target. Only the framework's
+// own requests are supported, created with WdfRequestCreate.
+//
+
+typedef enum _WDF_REQUEST_TYPE
+{
+	WdfRequestTypeCreate = 0x0,
+	WdfRequestTypeRead = 0x3,
+	WdfRequestTypeWrite = 0x4,
+	WdfRequestTypeDeviceControl = 0xE,
+	WdfRequestTypeMax = 0x1C
+} WDF_REQUEST_TYPE;
+
+typedef struct _WDF_REQUEST_COMPLETION_PARAMS
+{
+	ULONG Size;
+	WDF_REQUEST_TYPE Type;
+	IO_STATUS_BLOCK IoStatus;
+} WDF_REQUEST_COMPLETION_PARAMS, * PWDF_REQUEST_COMPLETION_PARAMS;
+
+typedef VOID
+EVT_WDF_REQUEST_COMPLETION_ROUTINE(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+	IN WDFCONTEXT Context
+);
+
+typedef EVT_WDF_REQUEST_COMPLETION_ROUTINE* PFN_WDF_REQUEST_COMPLETION_ROUTINE;
+
+#define WDF_REQUEST_REUSE_NO_FLAGS 0x00000000
+
+typedef struct _WDF_REQUEST_REUSE_PARAMS
+{
+	ULONG Size;
+	ULONG Flags;
+	NTSTATUS Status;
+} WDF_REQUEST_REUSE_PARAMS, * PWDF_REQUEST_REUSE_PARAMS;
+
+static inline VOID
+WDF_REQUEST_REUSE_PARAMS_INIT(
+	OUT PWDF_REQUEST_REUSE_PARAMS Params,
+	IN ULONG Flags,
+	IN NTSTATUS Status
+)
+{
+	RtlZeroMemory(Params, sizeof(WDF_REQUEST_REUSE_PARAMS));
+	Params->Size = sizeof(WDF_REQUEST_REUSE_PARAMS);
+	Params->Flags = Flags;
+	Params->Status = Status;
+}
+
+NTSTATUS
+WdfRequestCreate(
+	IN PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	IN WDFIOTARGET IoTarget,
+	OUT WDFREQUEST* Request
+);
+
+NTSTATUS
+WdfRequestReuse(
+	IN WDFREQUEST Request,
+	IN PWDF_REQUEST_REUSE_PARAMS ReuseParams
+);
+
+NTSTATUS
+WdfIoTargetFormatRequestForRead(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN WDFMEMORY OutputBuffer,
+	IN PWDFMEMORY_OFFSET OutputBufferOffset,
+	IN PLONGLONG DeviceOffset
+);
+
+NTSTATUS
+WdfIoTargetFormatRequestForIoctl(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN ULONG IoctlCode,
+	IN WDFMEMORY InputBuffer,
+	IN PWDFMEMORY_OFFSET InputBufferOffset,
+	IN WDFMEMORY OutputBuffer,
+	IN PWDFMEMORY_OFFSET OutputBufferOffset
+);
+
+VOID
+WdfRequestSetCompletionRoutine(
+	IN WDFREQUEST Request,
+	IN PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	IN WDFCONTEXT CompletionContext
+);
+
+BOOLEAN
+WdfRequestSend(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_SEND_OPTIONS Options
+);
+
+NTSTATUS
+WdfRequestGetStatus(
+	IN WDFREQUEST Request
+);
+
+BOOLEAN
+WdfRequestCancelSentRequest(
+	IN WDFREQUEST Request
+);
+
+//
+// Registry
+//
+
+HANDLE
+WdfRegistryWdmGetHandle(
+	IN WDFKEY Key
+);
+
+NTSTATUS
+WdfRegistryOpenKey(
+	IN WDFKEY ParentKey,
+	IN PCUNICODE_STRING KeyName,
+	IN ACCESS_MASK DesiredAccess,
+	IN PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	OUT WDFKEY* Key
+);
+
+VOID
+WdfRegistryClose(
+	IN WDFKEY Key
+);
+
+NTSTATUS
+WdfRegistryQueryULong(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	OUT PULONG Value
+);
+
+NTSTATUS
+WdfRegistryQueryMultiString(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN PWDF_OBJECT_ATTRIBUTES StringsAttributes,
+	IN WDFCOLLECTION Collection
+);
+
+NTSTATUS
+WdfRegistryQueryValue(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN ULONG ValueLength,
+	OUT PVOID Value,
+	OUT PULONG ValueLengthQueried,
+	OUT PULONG ValueType
+);
+
+NTSTATUS
+WdfRegistryAssignValue(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN ULONG ValueType,
+	IN ULONG ValueLength,
+	IN PVOID Value
+);
+
+//
+// Collections and strings
+//
+
+NTSTATUS
+WdfCollectionCreate(
+	IN PWDF_OBJECT_ATTRIBUTES CollectionAttributes,
+	OUT WDFCOLLECTION* Collection
+);
+
+ULONG
+WdfCollectionGetCount(
+	IN WDFCOLLECTION Collection
+);
+
+WDFOBJECT
+WdfCollectionGetItem(
+	IN WDFCOLLECTION Collection,
+	IN ULONG Index
+);
+
+VOID
+WdfStringGetUnicodeString(
+	IN WDFSTRING String,
+	OUT PUNICODE_STRING UnicodeString
+);
+
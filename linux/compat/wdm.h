@@ -0,0 +1,570 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		wdm.h
+
+	Abstract:
+
+		The subset of the kernel types and routines the touch core uses,
+		mapped onto a Linux user-space process. Types keep their LLP64
+		sizes so register layouts and configuration structures match the
+		driver build. Routines are implemented in ntoskrnl.c.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+//
+// Base types
+//
+
+typedef void VOID;
+typedef void* PVOID;
+typedef char CHAR, * PCHAR, * PSTR;
+typedef const char* PCSTR;
+typedef unsigned char UCHAR, * PUCHAR;
+typedef unsigned char BYTE, * PBYTE;
+typedef unsigned char BOOLEAN, * PBOOLEAN;
+typedef int16_t SHORT;
+typedef uint16_t USHORT, * PUSHORT;
+typedef uint16_t WORD;
+typedef int32_t INT;
+typedef uint32_t UINT;
+typedef int32_t LONG, * PLONG;
+typedef uint32_t ULONG, * PULONG;
+typedef uint32_t DWORD;
+typedef int64_t LONGLONG, LONG64, * PLONGLONG;
+typedef uint64_t ULONGLONG, ULONG64, * PULONG64;
+typedef int8_t INT8;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef int32_t INT32;
+typedef uint32_t UINT32;
+typedef uint64_t UINT64;
+typedef size_t SIZE_T, * PSIZE_T;
+typedef uintptr_t ULONG_PTR, * PULONG_PTR;
+typedef intptr_t LONG_PTR;
+typedef PVOID HANDLE;
+typedef ULONG ACCESS_MASK;
+
+//
+// Wide strings are UTF-16, the host is built with -fshort-wchar so
+// L"" literals have the same layout
+//
+typedef wchar_t WCHAR, * PWCHAR, * PWSTR;
+typedef const wchar_t* PCWSTR;
+
+typedef LONG NTSTATUS;
+typedef UCHAR KIRQL;
+typedef CHAR KPROCESSOR_MODE;
+
+typedef union _LARGE_INTEGER
+{
+	struct
+	{
+		ULONG LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER, * PLARGE_INTEGER;
+
+typedef struct _GUID
+{
+	ULONG Data1;
+	USHORT Data2;
+	USHORT Data3;
+	UCHAR Data4[8];
+} GUID, * LPGUID;
+
+typedef const GUID* LPCGUID;
+
+typedef struct _UNICODE_STRING
+{
+	USHORT Length;
+	USHORT MaximumLength;
+	PWSTR Buffer;
+} UNICODE_STRING, * PUNICODE_STRING;
+
+typedef const UNICODE_STRING* PCUNICODE_STRING;
+
+typedef struct _DEVICE_OBJECT* PDEVICE_OBJECT;
+typedef struct _DRIVER_OBJECT* PDRIVER_OBJECT;
+
+typedef struct _IO_STATUS_BLOCK
+{
+	NTSTATUS Status;
+	ULONG_PTR Information;
+} IO_STATUS_BLOCK, * PIO_STATUS_BLOCK;
+
+//
+// Annotations
+//
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define _In_
+#define _In_opt_
+#define _Out_
+#define _Out_opt_
+#define _Inout_
+#define _Inout_opt_
+#define _In_reads_bytes_(Size)
+#define _Use_decl_annotations_
+#define _Function_class_(Name)
+#define _IRQL_requires_max_(Irql)
+#define _Must_inspect_result_
+
+#define TRUE  1
+#define FALSE 0
+
+#define FORCEINLINE static inline __attribute__((always_inline))
+#define __forceinline inline __attribute__((always_inline))
+#define DECLSPEC_CACHEALIGN __attribute__((aligned(SYSTEM_CACHE_ALIGNMENT_SIZE)))
+#define ANYSIZE_ARRAY 1
+
+#define UNREFERENCED_PARAMETER(P) ((void)(P))
+#define PAGED_CODE()
+
+#define FIELD_OFFSET(Type, Field) ((LONG)offsetof(Type, Field))
+#define RTL_FIELD_SIZE(Type, Field) (sizeof(((Type*)0)->Field))
+#define ARRAYSIZE(A) (sizeof(A) / sizeof((A)[0]))
+#define RTL_NUMBER_OF(A) ARRAYSIZE(A)
+#define C_ASSERT(E) _Static_assert(E, #E)
+#define ALIGN_UP_BY(Length, Alignment) \
+	(((ULONG_PTR)(Length) + (Alignment) - 1) & ~((ULONG_PTR)(Alignment) - 1))
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define SYSTEM_CACHE_ALIGNMENT_SIZE 64
+
+#define MAXUCHAR    0xff
+#define MAXUSHORT   0xffff
+#define MAXULONG    0xffffffffUL
+#define MAXLONG     0x7fffffffL
+#define MAXULONG64  0xffffffffffffffffULL
+
+//
+// Status codes
+//
+
+#define NT_SUCCESS(Status) (((NTSTATUS)(Status)) >= 0)
+
+#define STATUS_SUCCESS                    ((NTSTATUS)0x00000000L)
+#define STATUS_TIMEOUT                    ((NTSTATUS)0x00000102L)
+#define STATUS_PENDING                    ((NTSTATUS)0x00000103L)
+#define STATUS_BUFFER_OVERFLOW            ((NTSTATUS)0x80000005L)
+#define STATUS_DEVICE_BUSY                ((NTSTATUS)0x80000011L)
+#define STATUS_NO_MORE_ENTRIES            ((NTSTATUS)0x8000001AL)
+#define STATUS_NO_DATA_DETECTED           ((NTSTATUS)0x80000022L)
+#define STATUS_UNSUCCESSFUL               ((NTSTATUS)0xC0000001L)
+#define STATUS_NOT_IMPLEMENTED            ((NTSTATUS)0xC0000002L)
+#define STATUS_INVALID_PARAMETER          ((NTSTATUS)0xC000000DL)
+#define STATUS_NO_SUCH_DEVICE             ((NTSTATUS)0xC000000EL)
+#define STATUS_INVALID_DEVICE_REQUEST     ((NTSTATUS)0xC0000010L)
+#define STATUS_NO_MEMORY                  ((NTSTATUS)0xC0000017L)
+#define STATUS_ACCESS_DENIED              ((NTSTATUS)0xC0000022L)
+#define STATUS_BUFFER_TOO_SMALL           ((NTSTATUS)0xC0000023L)
+#define STATUS_OBJECT_TYPE_MISMATCH       ((NTSTATUS)0xC0000024L)
+#define STATUS_OBJECT_NAME_INVALID        ((NTSTATUS)0xC0000033L)
+#define STATUS_OBJECT_NAME_NOT_FOUND      ((NTSTATUS)0xC0000034L)
+#define STATUS_DATA_ERROR                 ((NTSTATUS)0xC000003EL)
+#define STATUS_CRC_ERROR                  ((NTSTATUS)0xC000003FL)
+#define STATUS_REVISION_MISMATCH          ((NTSTATUS)0xC0000059L)
+#define STATUS_INVALID_IMAGE_FORMAT       ((NTSTATUS)0xC000007BL)
+#define STATUS_INTEGER_OVERFLOW           ((NTSTATUS)0xC0000095L)
+#define STATUS_INSUFFICIENT_RESOURCES     ((NTSTATUS)0xC000009AL)
+#define STATUS_DEVICE_DATA_ERROR          ((NTSTATUS)0xC000009CL)
+#define STATUS_DEVICE_NOT_CONNECTED       ((NTSTATUS)0xC000009DL)
+#define STATUS_DEVICE_NOT_READY           ((NTSTATUS)0xC00000A3L)
+#define STATUS_IO_TIMEOUT                 ((NTSTATUS)0xC00000B5L)
+#define STATUS_NOT_SUPPORTED              ((NTSTATUS)0xC00000BBL)
+#define STATUS_CANCELLED                  ((NTSTATUS)0xC0000120L)
+#define STATUS_INVALID_BLOCK_LENGTH       ((NTSTATUS)0xC0000173L)
+#define STATUS_DEVICE_CONFIGURATION_ERROR ((NTSTATUS)0xC0000182L)
+#define STATUS_INVALID_DEVICE_STATE       ((NTSTATUS)0xC0000184L)
+#define STATUS_DEVICE_PROTOCOL_ERROR      ((NTSTATUS)0xC0000186L)
+#define STATUS_INVALID_BUFFER_SIZE        ((NTSTATUS)0xC0000206L)
+#define STATUS_NOT_FOUND                  ((NTSTATUS)0xC0000225L)
+#define STATUS_DEVICE_REMOVED             ((NTSTATUS)0xC00002B6L)
+
+//
+// Device I/O control codes
+//
+
+#define FILE_DEVICE_UNKNOWN 0x00000022
+
+#define METHOD_BUFFERED   0
+#define METHOD_IN_DIRECT  1
+#define METHOD_OUT_DIRECT 2
+#define METHOD_NEITHER    3
+
+#define FILE_ANY_ACCESS   0
+#define FILE_READ_ACCESS  0x0001
+#define FILE_WRITE_ACCESS 0x0002
+
+#define CTL_CODE(DeviceType, Function, Method, Access) \
+	(((DeviceType) << 16) | ((Access) << 14) | ((Function) << 2) | (Method))
+
+//
+// GUIDs
+//
+
+#define DEFINE_GUID(Name, l, w1, w2, b1, b2, b3, b4, b5, b6, b7, b8) \
+	static const GUID Name = { l, w1, w2, { b1, b2, b3, b4, b5, b6, b7, b8 } }
+
+#define InlineIsEqualGUID(Guid1, Guid2) \
+	(memcmp((Guid1), (Guid2), sizeof(GUID)) == 0)
+#define IsEqualGUID(Guid1, Guid2) InlineIsEqualGUID(Guid1, Guid2)
+
+extern const GUID GUID_MONITOR_POWER_ON;
+
+//
+// Memory
+//
+
+typedef enum _POOL_TYPE
+{
+	NonPagedPool = 0,
+	PagedPool = 1,
+	NonPagedPoolNx = 512,
+	NonPagedPoolNxCacheAligned = 516
+} POOL_TYPE;
+
+#define RtlZeroMemory(Destination, Length) memset((Destination), 0, (Length))
+#define RtlFillMemory(Destination, Length, Fill) memset((Destination), (Fill), (Length))
+#define RtlCopyMemory(Destination, Source, Length) memcpy((Destination), (Source), (Length))
+#define RtlMoveMemory(Destination, Source, Length) memmove((Destination), (Source), (Length))
+#define RtlEqualMemory(Source1, Source2, Length) (!memcmp((Source1), (Source2), (Length)))
+
+SIZE_T
+RtlCompareMemory(
+	IN const VOID* Source1,
+	IN const VOID* Source2,
+	IN SIZE_T Length
+);
+
+PVOID
+ExAllocatePoolWithTag(
+	IN POOL_TYPE PoolType,
+	IN SIZE_T NumberOfBytes,
+	IN ULONG Tag
+);
+
+VOID
+ExFreePoolWithTag(
+	IN PVOID P,
+	IN ULONG Tag
+);
+
+//
+// Strings
+//
+
+#define RTL_CONSTANT_STRING(s) \
+	{ sizeof(s) - sizeof((s)[0]), sizeof(s), (PWSTR)(s) }
+
+#define DECLARE_CONST_UNICODE_STRING(Name, String) \
+	const UNICODE_STRING Name = RTL_CONSTANT_STRING(String)
+
+VOID
+RtlInitUnicodeString(
+	OUT PUNICODE_STRING DestinationString,
+	IN PCWSTR SourceString
+);
+
+NTSTATUS
+RtlUnicodeStringToInteger(
+	IN PCUNICODE_STRING String,
+	IN ULONG Base,
+	OUT PULONG Value
+);
+
+static inline VOID
+RtlInitEmptyUnicodeString(
+	OUT PUNICODE_STRING UnicodeString,
+	IN PWCHAR Buffer,
+	IN USHORT BufferSize
+)
+{
+	UnicodeString->Length = 0;
+	UnicodeString->MaximumLength = BufferSize;
+	UnicodeString->Buffer = Buffer;
+}
+
+//
+// Time, in 100ns units like the kernel's interrupt time
+//
+
+#define KernelMode 0
+
+ULONG64
+KeQueryInterruptTime(
+	VOID
+);
+
+ULONG64
+KeQueryInterruptTimePrecise(
+	OUT PULONG64 QpcTimeStamp
+);
+
+NTSTATUS
+KeDelayExecutionThread(
+	IN KPROCESSOR_MODE WaitMode,
+	IN BOOLEAN Alertable,
+	IN PLARGE_INTEGER Interval
+);
+
+//
+// Interlocked operations
+//
+
+#define InterlockedExchange(Target, Value) \
+	__atomic_exchange_n((Target), (Value), __ATOMIC_SEQ_CST)
+#define InterlockedIncrement(Target) \
+	__atomic_add_fetch((Target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedDecrement(Target) \
+	__atomic_sub_fetch((Target), 1, __ATOMIC_SEQ_CST)
+#define InterlockedCompareExchange(Target, Exchange, Comparand) \
+	__sync_val_compare_and_swap((Target), (Comparand), (Exchange))
+#define KeMemoryBarrier() __atomic_thread_fence(__ATOMIC_SEQ_CST)
+
+static inline PVOID
+InterlockedExchangePointer(
+	IN PVOID volatile* Target,
+	IN PVOID Value
+)
+{
+	return __atomic_exchange_n(Target, Value, __ATOMIC_SEQ_CST);
+}
+
+//
+// Bit scanning
+//
+
+static inline BOOLEAN
+_BitScanForward(
+	OUT ULONG* Index,
+	IN ULONG Mask
+)
+{
+	if (Mask == 0)
+	{
+		return FALSE;
+	}
+
+	*Index = (ULONG)__builtin_ctz(Mask);
+	return TRUE;
+}
+
+static inline BOOLEAN
+_BitScanReverse(
+	OUT ULONG* Index,
+	IN ULONG Mask
+)
+{
+	if (Mask == 0)
+	{
+		return FALSE;
+	}
+
+	*Index = 31 - (ULONG)__builtin_clz(Mask);
+	return TRUE;
+}
+
+//
+// Debugging
+//
+
+#define DPFLTR_IHVDRIVER_ID 77
+#define DPFLTR_ERROR_LEVEL  0
+#define DPFLTR_WARNING_LEVEL 1
+#define DPFLTR_TRACE_LEVEL  2
+#define DPFLTR_INFO_LEVEL   3
+
+ULONG
+DbgPrintEx(
+	IN ULONG ComponentId,
+	IN ULONG Level,
+	IN PCSTR Format,
+	...
+);
+
+VOID
+HostAssertFailed(
+	IN PCSTR Expression,
+	IN PCSTR File,
+	IN int Line
+);
+
+#define NT_ASSERT(Expression) \
+	((Expression) ? (void)0 : HostAssertFailed(#Expression, __FILE__, __LINE__))
+
+//
+// Registry
+//
+
+#define REG_NONE      0
+#define REG_SZ        1
+#define REG_BINARY    3
+#define REG_DWORD     4
+#define REG_MULTI_SZ  7
+
+#define KEY_READ  0x20019
+#define KEY_WRITE 0x20006
+
+#define RTL_REGISTRY_ABSOLUTE 0
+#define RTL_REGISTRY_HANDLE   0x40000000
+
+#define RTL_QUERY_REGISTRY_REQUIRED 0x00000004
+#define RTL_QUERY_REGISTRY_DIRECT   0x00000020
+
+typedef NTSTATUS
+RTL_QUERY_REGISTRY_ROUTINE(
+	IN PWSTR ValueName,
+	IN ULONG ValueType,
+	IN PVOID ValueData,
+	IN ULONG ValueLength,
+	IN PVOID Context,
+	IN PVOID EntryContext
+);
+
+typedef RTL_QUERY_REGISTRY_ROUTINE* PRTL_QUERY_REGISTRY_ROUTINE;
+
+typedef struct _RTL_QUERY_REGISTRY_TABLE
+{
+	PRTL_QUERY_REGISTRY_ROUTINE QueryRoutine;
+	ULONG Flags;
+	PWSTR Name;
+	PVOID EntryContext;
+	ULONG DefaultType;
+	PVOID DefaultData;
+	ULONG DefaultLength;
+} RTL_QUERY_REGISTRY_TABLE, * PRTL_QUERY_REGISTRY_TABLE;
+
+NTSTATUS
+RtlQueryRegistryValues(
+	IN ULONG RelativeTo,
+	IN PCWSTR Path,
+	IN PRTL_QUERY_REGISTRY_TABLE QueryTable,
+	IN PVOID Context,
+	IN PVOID Environment
+);
+
+//
+// Power setting notifications
+//
+
+typedef NTSTATUS
+POWER_SETTING_CALLBACK(
+	IN LPCGUID SettingGuid,
+	IN PVOID Value,
+	IN ULONG ValueLength,
+	IN OUT PVOID Context
+);
+
+typedef POWER_SETTING_CALLBACK* PPOWER_SETTING_CALLBACK;
+
+NTSTATUS
+PoRegisterPowerSettingCallback(
+	IN PDEVICE_OBJECT DeviceObject,
+	IN LPCGUID SettingGuid,
+	IN PPOWER_SETTING_CALLBACK Callback,
+	IN PVOID Context,
+	OUT PVOID* Handle
+);
+
+NTSTATUS
+PoUnregisterPowerSettingCallback(
+	IN PVOID Handle
+);
+
+//
+// Plug and play notifications, only device interface changes are
+// delivered
+//
+
+typedef enum _IO_NOTIFICATION_EVENT_CATEGORY
+{
+	EventCategoryReserved = 0,
+	EventCategoryHardwareProfileChange,
+	EventCategoryDeviceInterfaceChange,
+	EventCategoryTargetDeviceChange
+} IO_NOTIFICATION_EVENT_CATEGORY;
+
+#define PNPNOTIFY_DEVICE_INTERFACE_INCLUDE_EXISTING_INTERFACES 0x00000001
+
+typedef struct _DEVICE_INTERFACE_CHANGE_NOTIFICATION
+{
+	USHORT Version;
+	USHORT Size;
+	GUID Event;
+	GUID InterfaceClassGuid;
+	PUNICODE_STRING SymbolicLinkName;
+} DEVICE_INTERFACE_CHANGE_NOTIFICATION, * PDEVICE_INTERFACE_CHANGE_NOTIFICATION;
+
+typedef NTSTATUS
+DRIVER_NOTIFICATION_CALLBACK_ROUTINE(
+	IN PVOID NotificationStructure,
+	IN OUT PVOID Context
+);
+
+typedef DRIVER_NOTIFICATION_CALLBACK_ROUTINE* PDRIVER_NOTIFICATION_CALLBACK_ROUTINE;
+
+NTSTATUS
+IoRegisterPlugPlayNotification(
+	IN IO_NOTIFICATION_EVENT_CATEGORY EventCategory,
+	IN ULONG EventCategoryFlags,
+	IN PVOID EventCategoryData,
+	IN PDRIVER_OBJECT DriverObject,
+	IN PDRIVER_NOTIFICATION_CALLBACK_ROUTINE CallbackRoutine,
+	IN PVOID Context,
+	OUT PVOID* NotificationEntry
+);
+
+NTSTATUS
+IoUnregisterPlugPlayNotificationEx(
+	IN PVOID NotificationEntry
+);
+
+typedef enum _DEVICE_POWER_STATE
+{
+	PowerDeviceUnspecified = 0,
+	PowerDeviceD0,
+	PowerDeviceD1,
+	PowerDeviceD2,
+	PowerDeviceD3,
+	PowerDeviceMaximum
+} DEVICE_POWER_STATE;
+
+//
+// Resource connection types, used by the device to pick a transport
+//
+
+#define CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C 1
+#define CM_RESOURCE_CONNECTION_TYPE_SERIAL_SPI 2
+
+#define GENERIC_READ          0x80000000
+#define GENERIC_WRITE         0x40000000
+#define FILE_SHARE_READ       0x00000001
+#define FILE_SHARE_WRITE      0x00000002
+#define FILE_OPEN             0x00000001
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
@@ -0,0 +1,30 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		wdmguid.h
+
+	Abstract:
+
+		Plug and play event GUIDs delivered with device interface change
+		notifications
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include <wdm.h>
+
+DEFINE_GUID(GUID_DEVICE_INTERFACE_ARRIVAL,
+	0xCB3A4004, 0x46F0, 0x11D0, 0xB0, 0x8F, 0x00, 0x60, 0x97, 0x13, 0x05, 0x3F);
+
+DEFINE_GUID(GUID_DEVICE_INTERFACE_REMOVAL,
+	0xCB3A4005, 0x46F0, 0x11D0, 0xB0, 0x8F, 0x00, 0x60, 0x97, 0x13, 0x05, 0x3F);
@@ -0,0 +1,62 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		driver.c
+
+	Abstract:
+
+		Stands in for the part of the Windows driver the core calls out
+		to, the completion of HID reports. Shared by the daemon and the
+		unit checks.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include "host.h"
+#include "rmiinternal.h"
+#include "debug.h"
+
+void
+SendHidReports(
+	WDFQUEUE PingPongQueue,
+	PHID_INPUT_REPORT hidReportsFromDriver,
+	int hidReportsCount
+)
+/*++
+
+  Routine Description:
+
+	Hands the reports of one servicing pass to the queue's sink, in
+	the order the driver completes them to HIDClass
+
+--*/
+{
+	HOST_SINK* sink;
+	NTSTATUS status;
+	int i;
+
+	sink = HostQueueGetSink(PingPongQueue);
+
+	for (i = 0; i < hidReportsCount; i++)
+	{
+		status = sink->Ops->Report(sink, &hidReportsFromDriver[i]);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_REPORTING,
+				"Report dropped by %s sink - STATUS:%X",
+				sink->Ops->Name,
+				status);
+		}
+	}
+}
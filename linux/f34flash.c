@@ -0,0 +1,198 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		f34flash.c
+
+	Abstract:
+
+		User mode side of an F34 update. The image is read from a file
+		and handed to the core like the output buffer of
+		IOCTL_TOUCH_DIAG_F34_FLASH, with the controller lock held and any
+		F54 capture stopped. An update that fails can be resumed once
+		from another copy of the image, as a diagnostic client would
+		after IOCTL_TOUCH_DIAG_F34_GET_PROGRESS.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "Function34.h"
+#include "Function54.h"
+#include "debug.h"
+
+static NTSTATUS
+HostF34ReadImage(
+	IN PCSTR Path,
+	OUT PUCHAR* Image,
+	OUT PSIZE_T ImageBytes
+)
+{
+	PUCHAR image = NULL;
+	FILE* file;
+	long bytes;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	file = fopen(Path, "rb");
+
+	if (file == NULL)
+	{
+		return HostStatusFromErrno(errno);
+	}
+
+	if (fseek(file, 0, SEEK_END) != 0 ||
+		(bytes = ftell(file)) < 0 ||
+		fseek(file, 0, SEEK_SET) != 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	image = (PUCHAR)malloc(bytes + 1);
+
+	if (image == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	if (fread(image, 1, bytes, file) != (size_t)bytes)
+	{
+		status = STATUS_UNSUCCESSFUL;
+		goto exit;
+	}
+
+	*Image = image;
+	*ImageBytes = bytes;
+	image = NULL;
+
+exit:
+	free(image);
+	fclose(file);
+
+	return status;
+}
+
+static NTSTATUS
+HostF34Run(
+	IN RMI4_CONTROLLER_CONTEXT* Controller,
+	IN SPB_CONTEXT* SpbContext,
+	IN PCSTR Path,
+	IN ULONG Flags
+)
+{
+	PUCHAR image = NULL;
+	SIZE_T imageBytes = 0;
+	NTSTATUS status;
+
+	status = HostF34ReadImage(Path, &image, &imageBytes);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not read firmware image %s - STATUS:%X",
+			Path,
+			status);
+
+		return status;
+	}
+
+	WdfWaitLockAcquire(Controller->ControllerLock, NULL);
+
+	RmiF54StopStream(Controller);
+
+	status = RmiF34Flash(Controller, SpbContext, image, imageBytes, Flags);
+
+	WdfWaitLockRelease(Controller->ControllerLock);
+
+	free(image);
+
+	return status;
+}
+
+NTSTATUS
+HostF34Flash(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PCSTR Path,
+	IN ULONG Flags,
+	IN PCSTR ResumePath
+)
+/*++
+
+  Routine Description:
+
+	Flashes the image at Path and traces how many blocks were written
+	and at what rate, resuming once from ResumePath if the update fails
+
+  Arguments:
+
+	ControllerContext - Touch controller context
+	SpbContext - Transport of the controller
+	Path - Firmware image
+	Flags - RMI4_F34_FLASH_XXX flags
+	ResumePath - Image to resume a failed update from, or NULL
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	RMI4_F34_FLASH* flash = &controller->F34Flash;
+	ULONG64 elapsedUs;
+	ULONG blocks;
+	NTSTATUS status;
+
+	status = HostF34Run(controller, SpbContext, Path, Flags);
+
+	if (!NT_SUCCESS(status) && ResumePath != NULL)
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Resuming F34 update in state %d at block %u",
+			flash->State,
+			flash->NextBlock);
+
+		status = HostF34Run(
+			controller,
+			SpbContext,
+			ResumePath,
+			Flags | RMI4_F34_FLASH_RESUME);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	blocks = flash->BytesWritten / flash->Query.BlockSize;
+	elapsedUs = flash->ElapsedTime / 10;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F34 wrote %u blocks of %u bytes in %llu us, %llu blocks per second",
+		blocks,
+		flash->Query.BlockSize,
+		(unsigned long long)elapsedUs,
+		(unsigned long long)((elapsedUs != 0) ? blocks * 1000000ULL / elapsedUs : 0));
+
+exit:
+	return status;
+}
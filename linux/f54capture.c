@@ -0,0 +1,360 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		f54capture.c
+
+	Abstract:
+
+		User mode side of an F54 capture. The ring is allocated here and
+		handed to the core like the output buffer of
+		IOCTL_TOUCH_DIAG_F54_START. A reader thread follows the ring while
+		the driver fills it from the F54 interrupt on the loop thread, takes
+		frames as a diagnostic client would and checks each one against
+		the report the simulator captured.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "Function54.h"
+#include "diagnostics.h"
+#include "debug.h"
+
+//
+// Time the reader sleeps when no new frame was published, in us
+//
+#define HOST_F54_READER_IDLE_US   100
+
+struct _HOST_F54_CAPTURE
+{
+	PUCHAR Ring;
+	SIZE_T RingBytes;
+	PUCHAR Copy;
+
+	pthread_t Reader;
+	volatile BOOLEAN Stop;
+	ULONG64 StartTime;
+
+	//
+	// Frames taken intact, overwritten before they could be taken,
+	// rewritten while being copied, and taken with the wrong content
+	//
+	ULONG Read;
+	ULONG Missed;
+	ULONG Torn;
+	ULONG Corrupt;
+	ULONG LastCapture;
+};
+
+static BOOLEAN
+HostF54CheckFrame(
+	IN HOST_F54_CAPTURE* Capture,
+	IN const TOUCH_DIAG_F54_RING* Header,
+	IN const TOUCH_DIAG_F54_FRAME* Frame
+)
+/*++
+
+  Routine Description:
+
+	Checks a copied frame is one whole simulator report, newer than
+	the frame taken before it
+
+--*/
+{
+	ULONG capture;
+	ULONG i;
+
+	if (Frame->Length != Header->FrameBytes || Frame->Length < sizeof(ULONG))
+	{
+		return FALSE;
+	}
+
+	RtlCopyMemory(&capture, Frame->Data, sizeof(capture));
+
+	if (capture <= Capture->LastCapture)
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < Frame->Length; i++)
+	{
+		if (Frame->Data[i] != HostSimF54Byte(capture, i))
+		{
+			return FALSE;
+		}
+	}
+
+	Capture->LastCapture = capture;
+
+	return TRUE;
+}
+
+static PVOID
+HostF54Reader(
+	IN PVOID Context
+)
+/*++
+
+  Routine Description:
+
+	Takes every frame published since the last pass, oldest first,
+	following the protocol of TOUCH_DIAG_F54_FRAME: a frame is copied
+	and only accepted if its sequence is the expected one before and
+	after the copy.
+
+--*/
+{
+	HOST_F54_CAPTURE* capture = (HOST_F54_CAPTURE*)Context;
+	PTOUCH_DIAG_F54_RING header = (PTOUCH_DIAG_F54_RING)capture->Ring;
+	PTOUCH_DIAG_F54_FRAME frame;
+	ULONG taken = 0;
+	ULONG written;
+	ULONG sequence;
+	ULONG before;
+	ULONG after;
+
+	while (!capture->Stop)
+	{
+		written = __atomic_load_n(&header->WriteSequence, __ATOMIC_ACQUIRE);
+
+		if (written == taken)
+		{
+			usleep(HOST_F54_READER_IDLE_US);
+			continue;
+		}
+
+		for (sequence = taken + 1; sequence <= written; sequence++)
+		{
+			if (written - sequence >= header->SlotCount)
+			{
+				capture->Missed++;
+				continue;
+			}
+
+			frame = (PTOUCH_DIAG_F54_FRAME)(capture->Ring + header->HeaderBytes +
+				((sequence - 1) % header->SlotCount) * header->SlotBytes);
+
+			before = __atomic_load_n(&frame->Sequence, __ATOMIC_ACQUIRE);
+
+			if (before != sequence)
+			{
+				capture->Missed++;
+				continue;
+			}
+
+			RtlCopyMemory(capture->Copy, frame, header->SlotBytes);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			after = __atomic_load_n(&frame->Sequence, __ATOMIC_RELAXED);
+
+			if (after != sequence)
+			{
+				capture->Torn++;
+			}
+			else if (HostF54CheckFrame(
+				capture,
+				header,
+				(PTOUCH_DIAG_F54_FRAME)capture->Copy))
+			{
+				capture->Read++;
+			}
+			else
+			{
+				capture->Corrupt++;
+			}
+		}
+
+		taken = written;
+	}
+
+	return NULL;
+}
+
+NTSTATUS
+HostF54CaptureStart(
+	IN VOID* ControllerContext,
+	IN ULONG ReportType,
+	IN ULONG Slots,
+	OUT HOST_F54_CAPTURE** Capture
+)
+/*++
+
+  Routine Description:
+
+	Starts capturing reports of a type into a ring of Slots frames and
+	the thread reading them
+
+  Arguments:
+
+	ControllerContext - started touch controller context
+	ReportType - RMI4 F54 report type
+	Slots - frames the ring holds, for the largest report type
+	Capture - receives the capture
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	const RMI4_F54_QUERY_REGISTERS* query = &controller->Setup->F54QueryRegisters;
+	HOST_F54_CAPTURE* capture;
+	SIZE_T slotBytes;
+	NTSTATUS status;
+
+	*Capture = NULL;
+
+	capture = (HOST_F54_CAPTURE*)calloc(1, sizeof(HOST_F54_CAPTURE));
+
+	if (capture == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	slotBytes = ALIGN_UP_BY(
+		FIELD_OFFSET(TOUCH_DIAG_F54_FRAME, Data) +
+			query->NumRxElectrodes * query->NumTxElectrodes * sizeof(USHORT),
+		TOUCH_DIAG_F54_ALIGNMENT);
+
+	capture->RingBytes =
+		ALIGN_UP_BY(sizeof(TOUCH_DIAG_F54_RING), TOUCH_DIAG_F54_ALIGNMENT) +
+		Slots * slotBytes;
+	capture->Ring = (PUCHAR)calloc(1, capture->RingBytes);
+	capture->Copy = (PUCHAR)malloc(slotBytes);
+
+	if (capture->Ring == NULL || capture->Copy == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	status = RmiF54StartStream(
+		controller,
+		(UCHAR)ReportType,
+		capture->Ring,
+		capture->RingBytes);
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not start F54 capture of report type %u - STATUS:%X",
+			ReportType,
+			status);
+
+		goto exit;
+	}
+
+	capture->StartTime = KeQueryInterruptTime();
+
+	if (pthread_create(&capture->Reader, NULL, HostF54Reader, capture) != 0)
+	{
+		WdfWaitLockAcquire(controller->ControllerLock, NULL);
+		RmiF54StopStream(controller);
+		WdfWaitLockRelease(controller->ControllerLock);
+
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	*Capture = capture;
+	capture = NULL;
+
+exit:
+
+	if (capture != NULL)
+	{
+		free(capture->Copy);
+		free(capture->Ring);
+		free(capture);
+	}
+
+	return status;
+}
+
+NTSTATUS
+HostF54CaptureStop(
+	IN VOID* ControllerContext,
+	IN HOST_F54_CAPTURE* Capture
+)
+/*++
+
+  Routine Description:
+
+	Stops the capture and its reader and logs what was captured
+
+  Arguments:
+
+	ControllerContext - touch controller context the capture runs on
+	Capture - capture to stop, freed on return
+
+  Return Value:
+
+	STATUS_DATA_ERROR when a frame taken was not a whole report, when
+	the driver counted errors or when no frame was taken at all
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	PTOUCH_DIAG_F54_RING header = (PTOUCH_DIAG_F54_RING)Capture->Ring;
+	ULONG64 elapsed;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+	RmiF54StopStream(controller);
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	elapsed = max(KeQueryInterruptTime() - Capture->StartTime, 1);
+
+	Capture->Stop = TRUE;
+	pthread_join(Capture->Reader, NULL);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F54 captured %u frames of %u bytes in %u slots, %llu per second",
+		header->WriteSequence,
+		header->FrameBytes,
+		header->SlotCount,
+		(unsigned long long)(header->WriteSequence * 10000000ULL / elapsed));
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F54 frames read %u, missed %u, torn %u, corrupt %u, errors %u",
+		Capture->Read,
+		Capture->Missed,
+		Capture->Torn,
+		Capture->Corrupt,
+		header->Errors);
+
+	if (Capture->Corrupt != 0 || header->Errors != 0 || Capture->Read == 0)
+	{
+		status = STATUS_DATA_ERROR;
+	}
+
+	free(Capture->Copy);
+	free(Capture->Ring);
+	free(Capture);
+
+	return status;
+}
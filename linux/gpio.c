@@ -0,0 +1,175 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		gpio.c
+
+	Abstract:
+
+		Attention line through the GPIO character device. The line is
+		requested active low with edge events on assertion, which is how
+		the interrupt resource of the ACPI tables describes ATTN.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/gpio.h>
+#include "host.h"
+#include "debug.h"
+
+static VOID
+HostGpioAcknowledge(
+	IN HOST_ATTENTION* Attention
+)
+{
+	struct gpio_v2_line_event event;
+
+	//
+	// Drain every queued edge, servicing reads the controller until the
+	// line is released anyway
+	//
+	while (read(Attention->Fd, &event, sizeof(event)) == sizeof(event))
+	{
+	}
+}
+
+static BOOLEAN
+HostGpioAsserted(
+	IN HOST_ATTENTION* Attention
+)
+{
+	struct gpio_v2_line_values values;
+
+	RtlZeroMemory(&values, sizeof(values));
+	values.mask = 1;
+
+	if (ioctl(Attention->Fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
+	{
+		return FALSE;
+	}
+
+	//
+	// Values are logical, the line was requested active low
+	//
+	return (values.bits & 1) ? TRUE : FALSE;
+}
+
+static VOID
+HostGpioClose(
+	IN HOST_ATTENTION* Attention
+)
+{
+	if (Attention->Fd >= 0)
+	{
+		close(Attention->Fd);
+		Attention->Fd = -1;
+	}
+}
+
+static const HOST_ATTENTION_OPS HostGpioOps =
+{
+	HostGpioAcknowledge,
+	HostGpioAsserted,
+	HostGpioClose
+};
+
+NTSTATUS
+HostGpioOpenAttention(
+	IN PCSTR Chip,
+	IN ULONG Line,
+	OUT HOST_ATTENTION* Attention
+)
+/*++
+
+  Routine Description:
+
+	Requests the attention line of the controller
+
+  Arguments:
+
+	Chip      - GPIO chip device, e.g. /dev/gpiochip0
+	Line      - line offset on the chip
+	Attention - receives the line
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	struct gpio_v2_line_request request;
+	NTSTATUS status;
+	int chipFd;
+
+	Attention->Fd = -1;
+	Attention->Ops = &HostGpioOps;
+	Attention->Context = NULL;
+
+	chipFd = open(Chip, O_RDWR | O_CLOEXEC);
+
+	if (chipFd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	RtlZeroMemory(&request, sizeof(request));
+	request.offsets[0] = Line;
+	request.num_lines = 1;
+	strncpy(request.consumer, "rmi4d", sizeof(request.consumer) - 1);
+
+	//
+	// With an active low line a rising edge is the physical falling edge
+	//
+	request.config.flags =
+		GPIO_V2_LINE_FLAG_INPUT |
+		GPIO_V2_LINE_FLAG_ACTIVE_LOW |
+		GPIO_V2_LINE_FLAG_EDGE_RISING;
+
+	if (ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &request) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	Attention->Fd = request.fd;
+
+	//
+	// Acknowledge drains without blocking
+	//
+	fcntl(Attention->Fd, F_SETFL, fcntl(Attention->Fd, F_GETFL) | O_NONBLOCK);
+
+	status = STATUS_SUCCESS;
+
+exit:
+
+	if (chipFd >= 0)
+	{
+		close(chipFd);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error requesting attention line %s:%u - STATUS:%X",
+			Chip,
+			Line,
+			status);
+	}
+
+	return status;
+}
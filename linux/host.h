@@ -0,0 +1,525 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		host.h
+
+	Abstract:
+
+		Linux user-space host for the RMI4 touch core. The daemon runs
+		one epoll loop that services the attention line, the core's
+		timers and the simulator. Register access goes through an
+		SPB_TRANSPORT, reports leave through a HOST_SINK.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "internal.h"
+#include "controller.h"
+
+//
+// Event loop. Callbacks run on the loop thread, one at a time.
+//
+
+typedef VOID
+HOST_LOOP_CALLBACK(
+	IN PVOID Context,
+	IN ULONG Events
+);
+
+NTSTATUS
+HostLoopInitialize(
+	VOID
+);
+
+VOID
+HostLoopDeinitialize(
+	VOID
+);
+
+NTSTATUS
+HostLoopAdd(
+	IN int Fd,
+	IN ULONG Events,
+	IN HOST_LOOP_CALLBACK* Callback,
+	IN PVOID Context
+);
+
+VOID
+HostLoopRemove(
+	IN int Fd
+);
+
+NTSTATUS
+HostLoopRun(
+	VOID
+);
+
+VOID
+HostLoopStop(
+	VOID
+);
+
+//
+// Attention line. Fd becomes readable when the controller asserts the
+// line, Acknowledge consumes the wake-up and Asserted tells whether the
+// line is still held so the daemon keeps servicing until it is released.
+//
+
+typedef struct _HOST_ATTENTION HOST_ATTENTION;
+
+typedef struct _HOST_ATTENTION_OPS
+{
+	VOID (*Acknowledge)(HOST_ATTENTION* Attention);
+	BOOLEAN (*Asserted)(HOST_ATTENTION* Attention);
+	VOID (*Close)(HOST_ATTENTION* Attention);
+} HOST_ATTENTION_OPS;
+
+struct _HOST_ATTENTION
+{
+	int Fd;
+	const HOST_ATTENTION_OPS* Ops;
+	PVOID Context;
+};
+
+NTSTATUS
+HostGpioOpenAttention(
+	IN PCSTR Chip,
+	IN ULONG Line,
+	OUT HOST_ATTENTION* Attention
+);
+
+//
+// Transports. Open fills the transport, its private context and the
+// SPB lock in SpbContext, Close releases them.
+//
+
+extern const SPB_TRANSPORT HostI2cDevTransport;
+extern const SPB_TRANSPORT HostSimTransport;
+
+NTSTATUS
+HostI2cDevOpen(
+	IN PCSTR Path,
+	IN ULONG Address,
+	OUT SPB_CONTEXT* SpbContext
+);
+
+VOID
+HostI2cDevClose(
+	IN SPB_CONTEXT* SpbContext
+);
+
+//
+// Simulated controller. It exposes an F01, F11 or F12, F54, F34 and
+// optionally F1A register map, signals attention through an eventfd and
+// plays a scripted gesture, stopping the loop once the last frame has
+// been read. The frame clock is set to the time of each frame as it is
+// played.
+//
+
+//
+// Scan times follow the frame clock once it is set, in 100ns units
+//
+VOID
+HostClockSetFrameTime(
+	IN ULONG64 Time
+);
+
+//
+// Moves the interrupt time forward by Time, in 100ns units, so checks of
+// intervals measured in seconds need not wait them out
+//
+VOID
+HostClockAdvance(
+	IN ULONG64 Time
+);
+
+//
+// Notifies the monitor power callbacks of a simulated monitor state
+//
+VOID
+HostSetMonitorState(
+	IN BOOLEAN On
+);
+
+//
+// Bus the simulated controller is reached over. Direct hands register
+// accesses straight to the simulator, I2C and SPI run the driver's own
+// transports against an SPB target decoding their transfers.
+//
+typedef enum _HOST_SIM_BUS
+{
+	HostSimBusDirect = 0,
+	HostSimBusI2c,
+	HostSimBusSpi
+} HOST_SIM_BUS;
+
+//
+// 2D sensor function the simulated controller reports contacts through
+//
+typedef enum _HOST_SIM_TOUCH
+{
+	HostSimTouchF11 = 0,
+	HostSimTouchF12
+} HOST_SIM_TOUCH;
+
+//
+// Most objects an F12 function of the simulator reports
+//
+#define HOST_SIM_MAX_OBJECTS    32
+
+typedef struct _HOST_SIM_OPTIONS
+{
+	//
+	// Gesture script, the built-in gesture is played when NULL
+	//
+	PCSTR ScriptPath;
+
+	//
+	// Firmware build the F01 query registers report
+	//
+	ULONG FirmwareBuild;
+
+	HOST_SIM_BUS Bus;
+	HOST_SIM_TOUCH Touch;
+
+	//
+	// Objects an F12 function reports, 10 when 0
+	//
+	ULONG Objects;
+
+	//
+	// Whether an F1A function reports the buttons scripts hold
+	//
+	BOOLEAN Buttons;
+
+	//
+	// Firmware block, counting from 1, whose first F34 write fails.
+	// None when 0.
+	//
+	ULONG F34FailBlock;
+} HOST_SIM_OPTIONS;
+
+NTSTATUS
+HostSimOpen(
+	IN const HOST_SIM_OPTIONS* Options,
+	OUT SPB_CONTEXT* SpbContext,
+	OUT HOST_ATTENTION* Attention
+);
+
+VOID
+HostSimClose(
+	IN SPB_CONTEXT* SpbContext
+);
+
+NTSTATUS
+HostSimBusAttach(
+	IN HOST_SIM_BUS Bus,
+	IN OUT SPB_CONTEXT* SpbContext
+);
+
+VOID
+HostSimBusDetach(
+	IN OUT SPB_CONTEXT* SpbContext
+);
+
+//
+// Faults of a single transfer on the simulated I2C or SPI bus. Error
+// fails it with STATUS_IO_TIMEOUT, Short moves half of the data.
+//
+typedef enum _HOST_SIM_BUS_FAULT
+{
+	HostSimBusFaultNone = 0,
+	HostSimBusFaultError,
+	HostSimBusFaultShort
+} HOST_SIM_BUS_FAULT;
+
+VOID
+HostSimBusInjectFault(
+	IN SPB_CONTEXT* SpbContext,
+	IN ULONG Transfer,
+	IN HOST_SIM_BUS_FAULT Fault
+);
+
+VOID
+HostSimGetBusStatistics(
+	IN SPB_CONTEXT* SpbContext,
+	OUT PULONG Transfers,
+	OUT PULONG64 BusTime
+);
+
+//
+// Byte at Offset of the F54 report the simulator returns for its
+// Capture-th GetReport, counting from 1
+//
+UCHAR
+HostSimF54Byte(
+	IN ULONG Capture,
+	IN ULONG Offset
+);
+
+//
+// Writes a firmware image the simulated controller with the given 2D
+// sensor function takes, what its flash holds
+//
+NTSTATUS
+HostSimWriteF34Image(
+	IN HOST_SIM_TOUCH Touch,
+	IN PCSTR Path
+);
+
+//
+// F34 update, the user mode side of IOCTL_TOUCH_DIAG_F34_FLASH. An
+// update that fails is resumed once from ResumePath when it is not
+// NULL. The controller is left for the caller to restart.
+//
+NTSTATUS
+HostF34Flash(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PCSTR Path,
+	IN ULONG Flags,
+	IN PCSTR ResumePath
+);
+
+//
+// F54 capture, the user mode side of IOCTL_TOUCH_DIAG_F54_START. A
+// reader thread follows the ring the driver fills and checks every
+// frame it takes against the simulator's report pattern.
+//
+
+typedef struct _HOST_F54_CAPTURE HOST_F54_CAPTURE;
+
+NTSTATUS
+HostF54CaptureStart(
+	IN VOID* ControllerContext,
+	IN ULONG ReportType,
+	IN ULONG Slots,
+	OUT HOST_F54_CAPTURE** Capture
+);
+
+NTSTATUS
+HostF54CaptureStop(
+	IN VOID* ControllerContext,
+	IN HOST_F54_CAPTURE* Capture
+);
+
+//
+// Report sinks. The core's HID reports are handed to Report in the
+// order the driver would complete them to HIDClass.
+//
+
+typedef struct _HOST_SINK HOST_SINK;
+
+typedef struct _HOST_SINK_OPS
+{
+	PCSTR Name;
+	NTSTATUS (*Report)(HOST_SINK* Sink, const HID_INPUT_REPORT* Report);
+	VOID (*Close)(HOST_SINK* Sink);
+} HOST_SINK_OPS;
+
+//
+// Extents of the coordinates in the reports and the contact count,
+// taken from the controller once it has started
+//
+typedef struct _HOST_SINK_PROPERTIES
+{
+	ULONG Width;
+	ULONG Height;
+	ULONG MaxContacts;
+} HOST_SINK_PROPERTIES;
+
+struct _HOST_SINK
+{
+	const HOST_SINK_OPS* Ops;
+	PVOID Context;
+};
+
+NTSTATUS
+HostUinputSinkOpen(
+	IN PCSTR Path,
+	IN const HOST_SINK_PROPERTIES* Properties,
+	OUT HOST_SINK* Sink
+);
+
+NTSTATUS
+HostMemorySinkOpen(
+	IN const HOST_SINK_PROPERTIES* Properties,
+	IN BOOLEAN Dump,
+	OUT HOST_SINK* Sink
+);
+
+ULONG
+HostMemorySinkGetCount(
+	IN HOST_SINK* Sink
+);
+
+//
+// Framework services used by the daemon itself
+//
+
+NTSTATUS
+HostDeviceCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFDEVICE* Device
+);
+
+NTSTATUS
+HostQueueCreate(
+	IN WDFDEVICE Device,
+	IN HOST_SINK* Sink,
+	OUT WDFQUEUE* Queue
+);
+
+HOST_SINK*
+HostQueueGetSink(
+	IN WDFQUEUE Queue
+);
+
+//
+// I/O target served by the host. Requests reach the ops with their
+// buffer resolved, each op returns the status and the bytes it moved.
+// Send, when set, takes the requests sent asynchronously instead. It
+// returns STATUS_PENDING to complete one later with HostRequestComplete,
+// any other status completes it right away. Cancel, when set, is told
+// of a pending request being cancelled, which is then completed with
+// STATUS_CANCELLED unless Cancel completed it.
+//
+
+typedef struct _HOST_IO_TARGET_OPS
+{
+	NTSTATUS (*Read)(PVOID Context, PVOID Buffer, ULONG Length, PULONG_PTR BytesRead);
+	NTSTATUS (*Write)(PVOID Context, PVOID Buffer, ULONG Length, PULONG_PTR BytesWritten);
+	NTSTATUS (*Ioctl)(PVOID Context, ULONG IoctlCode, PVOID Input, ULONG InputLength, PULONG_PTR BytesReturned);
+	NTSTATUS (*Send)(PVOID Context, WDFREQUEST Request);
+	VOID (*Cancel)(PVOID Context, WDFREQUEST Request);
+} HOST_IO_TARGET_OPS;
+
+NTSTATUS
+HostIoTargetCreate(
+	IN const HOST_IO_TARGET_OPS* Ops,
+	IN PVOID Context,
+	OUT WDFIOTARGET* IoTarget
+);
+
+PVOID
+HostIoTargetGetContext(
+	IN WDFIOTARGET IoTarget
+);
+
+//
+// Buffer of a request sent to a target, the input of an IOCTL or the
+// output of a read
+//
+VOID
+HostRequestGetParameters(
+	IN WDFREQUEST Request,
+	OUT WDF_REQUEST_TYPE* Type,
+	OUT PULONG IoctlCode,
+	OUT PVOID* Buffer,
+	OUT PULONG Length
+);
+
+VOID
+HostRequestComplete(
+	IN WDFREQUEST Request,
+	IN NTSTATUS Status,
+	IN ULONG_PTR Information
+);
+
+//
+// Device interfaces. Drivers registered for plug and play notifications
+// of InterfaceClass are told of the interface arriving and going away,
+// and a target opened by SymbolicLinkName is served by Ops. The name
+// must stay valid while the interface is registered.
+//
+
+NTSTATUS
+HostRegisterDeviceInterface(
+	IN LPCGUID InterfaceClass,
+	IN PCWSTR SymbolicLinkName,
+	IN const HOST_IO_TARGET_OPS* Ops,
+	IN PVOID Context
+);
+
+VOID
+HostUnregisterDeviceInterface(
+	IN PCWSTR SymbolicLinkName
+);
+
+BOOLEAN
+HostFindDeviceInterface(
+	IN PCUNICODE_STRING SymbolicLinkName,
+	OUT const HOST_IO_TARGET_OPS** Ops,
+	OUT PVOID* Context
+);
+
+//
+// Expires an armed timer right away on the calling thread, so checks
+// need not wait out its due time. Returns whether it was armed.
+//
+BOOLEAN
+HostTimerFire(
+	IN WDFTIMER Timer
+);
+
+//
+// Configuration. Every registry key the core opens reads this one set
+// of values, loaded from Name=Value lines. Multi-string values separate
+// their strings with ';'.
+//
+
+NTSTATUS
+HostRegistrySetValue(
+	IN PCSTR Name,
+	IN PCSTR Value
+);
+
+//
+// A value set for one device is read through that device's keys in
+// place of the shared value of the same name
+//
+NTSTATUS
+HostRegistrySetDeviceValue(
+	IN WDFDEVICE Device,
+	IN PCSTR Name,
+	IN PCSTR Value
+);
+
+NTSTATUS
+HostRegistryLoadFile(
+	IN PCSTR Path
+);
+
+//
+// Values the core writes are saved to the state file, which is loaded
+// like a configuration file on the next run
+//
+NTSTATUS
+HostRegistryLoadState(
+	IN PCSTR Path
+);
+
+VOID
+HostRegistryClear(
+	VOID
+);
+
+VOID
+HostSetVerbose(
+	IN BOOLEAN Verbose
+);
+
+NTSTATUS
+HostStatusFromErrno(
+	IN int Error
+);
@@ -0,0 +1,1042 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		hostreg.c
+
+	Abstract:
+
+		Registry for the host. There is one flat set of Name=Value pairs,
+		loaded from a configuration file or the command line, and every
+		key the core opens - the device key, its subkeys and the machine
+		wide settings key - reads that same set. A value may also be set
+		for one device only, it is then read through that device's keys
+		in place of the shared value of the same name. Values the core
+		writes are kept in a state file, when one is given, so they
+		survive restarts the way the device key does.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include "wdfhost.h"
+#include "debug.h"
+
+#define HOST_REGISTRY_MAX_NAME 64
+#define HOST_REGISTRY_MAX_VALUE 256
+#define HOST_REGISTRY_MAX_DATA 2048
+
+//
+// Binary values are written as hex:<bytes> and kept in Data
+//
+#define HOST_REGISTRY_HEX_PREFIX "hex:"
+
+typedef struct _HOST_REGISTRY_VALUE
+{
+	struct _HOST_REGISTRY_VALUE* Next;
+
+	//
+	// Device the value was set for, NULL for a shared value
+	//
+	WDFDEVICE Device;
+
+	CHAR Name[HOST_REGISTRY_MAX_NAME];
+	CHAR Value[HOST_REGISTRY_MAX_VALUE];
+	PUCHAR Data;
+	ULONG DataLength;
+
+	//
+	// Written by the core, saved to the state file
+	//
+	BOOLEAN Persist;
+} HOST_REGISTRY_VALUE;
+
+//
+// Keys remember the device they were opened for, the machine wide key
+// is not opened through a handle and reads the shared values only
+//
+typedef struct _HOST_REGISTRY_KEY
+{
+	HOST_OBJECT Header;
+	WDFDEVICE Device;
+} HOST_REGISTRY_KEY;
+
+static HOST_REGISTRY_VALUE* gValues = NULL;
+static PCSTR gStatePath = NULL;
+
+static HOST_REGISTRY_VALUE*
+HostRegistryFind(
+	IN WDFDEVICE Device,
+	IN PCSTR Name
+)
+/*++
+
+  Routine Description:
+
+	Returns the value a key of Device reads, the one set for the device
+	before the shared one. A NULL Device only finds shared values.
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+	HOST_REGISTRY_VALUE* shared = NULL;
+
+	for (value = gValues; value != NULL; value = value->Next)
+	{
+		if (strcasecmp(value->Name, Name) != 0)
+		{
+			continue;
+		}
+
+		if (value->Device == Device)
+		{
+			return value;
+		}
+
+		if (value->Device == NULL)
+		{
+			shared = value;
+		}
+	}
+
+	return shared;
+}
+
+static WDFDEVICE
+HostRegistryKeyDevice(
+	IN WDFKEY Key
+)
+{
+	return (Key != NULL) ? ((HOST_REGISTRY_KEY*)Key)->Device : NULL;
+}
+
+static BOOLEAN
+HostRegistryNarrowName(
+	IN PCWSTR Source,
+	IN SIZE_T Length,
+	OUT CHAR Name[HOST_REGISTRY_MAX_NAME]
+)
+/*++
+
+  Routine Description:
+
+	Converts a value name from the core to ASCII. Value names are plain
+	identifiers, anything else is treated as not present.
+
+--*/
+{
+	SIZE_T i;
+
+	if (Length >= HOST_REGISTRY_MAX_NAME)
+	{
+		return FALSE;
+	}
+
+	for (i = 0; i < Length; i++)
+	{
+		if (Source[i] == 0 || Source[i] > 0x7F)
+		{
+			return FALSE;
+		}
+
+		Name[i] = (CHAR)Source[i];
+	}
+
+	Name[Length] = '\0';
+
+	return TRUE;
+}
+
+static HOST_REGISTRY_VALUE*
+HostRegistryFindUnicode(
+	IN WDFDEVICE Device,
+	IN PCUNICODE_STRING ValueName
+)
+{
+	CHAR name[HOST_REGISTRY_MAX_NAME];
+
+	if (!HostRegistryNarrowName(
+		ValueName->Buffer,
+		ValueName->Length / sizeof(WCHAR),
+		name))
+	{
+		return NULL;
+	}
+
+	return HostRegistryFind(Device, name);
+}
+
+static NTSTATUS
+HostRegistryParseULong(
+	IN PCSTR String,
+	OUT PULONG Value
+)
+{
+	unsigned long parsed;
+	char* end;
+
+	errno = 0;
+	parsed = strtoul(String, &end, 0);
+
+	if (errno != 0 || end == String || *end != '\0' || parsed > MAXULONG)
+	{
+		return STATUS_OBJECT_TYPE_MISMATCH;
+	}
+
+	*Value = (ULONG)parsed;
+
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+HostRegistryAllocateValue(
+	IN WDFDEVICE Device,
+	IN PCSTR Name,
+	OUT HOST_REGISTRY_VALUE** Value
+)
+/*++
+
+  Routine Description:
+
+	Returns the value of that name set for Device emptied, adding it
+	when missing
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+
+	if (strlen(Name) == 0 || strlen(Name) >= HOST_REGISTRY_MAX_NAME)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	value = HostRegistryFind(Device, Name);
+
+	if (value == NULL || value->Device != Device)
+	{
+		value = (HOST_REGISTRY_VALUE*)calloc(1, sizeof(HOST_REGISTRY_VALUE));
+
+		if (value == NULL)
+		{
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		value->Device = Device;
+		strcpy(value->Name, Name);
+		value->Next = gValues;
+		gValues = value;
+	}
+
+	free(value->Data);
+	value->Data = NULL;
+	value->DataLength = 0;
+	value->Value[0] = '\0';
+	*Value = value;
+
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+HostRegistrySetBinary(
+	IN WDFDEVICE Device,
+	IN PCSTR Name,
+	IN const VOID* Data,
+	IN ULONG Length,
+	OUT HOST_REGISTRY_VALUE** Value
+)
+{
+	HOST_REGISTRY_VALUE* value;
+	PUCHAR data;
+	NTSTATUS status;
+
+	if (Length == 0 || Length > HOST_REGISTRY_MAX_DATA)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	data = (PUCHAR)malloc(Length);
+
+	if (data == NULL)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	status = HostRegistryAllocateValue(Device, Name, &value);
+
+	if (!NT_SUCCESS(status))
+	{
+		free(data);
+		return status;
+	}
+
+	RtlCopyMemory(data, Data, Length);
+	value->Data = data;
+	value->DataLength = Length;
+	*Value = value;
+
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+HostRegistrySetHex(
+	IN WDFDEVICE Device,
+	IN PCSTR Name,
+	IN PCSTR Hex
+)
+{
+	UCHAR data[HOST_REGISTRY_MAX_DATA];
+	HOST_REGISTRY_VALUE* value;
+	ULONG length = 0;
+	unsigned int byte;
+
+	while (Hex[0] != '\0')
+	{
+		if (length == sizeof(data) ||
+			!isxdigit((UCHAR)Hex[0]) ||
+			!isxdigit((UCHAR)Hex[1]) ||
+			sscanf(Hex, "%2x", &byte) != 1)
+		{
+			return STATUS_INVALID_PARAMETER;
+		}
+
+		data[length++] = (UCHAR)byte;
+		Hex += 2;
+	}
+
+	return HostRegistrySetBinary(Device, Name, data, length, &value);
+}
+
+NTSTATUS
+HostRegistrySetValue(
+	IN PCSTR Name,
+	IN PCSTR Value
+)
+/*++
+
+  Routine Description:
+
+	Adds a shared value or replaces an existing one of the same name
+
+--*/
+{
+	return HostRegistrySetDeviceValue(NULL, Name, Value);
+}
+
+NTSTATUS
+HostRegistrySetDeviceValue(
+	IN WDFDEVICE Device,
+	IN PCSTR Name,
+	IN PCSTR Value
+)
+/*++
+
+  Routine Description:
+
+	Adds a value read through the keys of one device only, or replaces
+	the one of the same name set for it
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+	NTSTATUS status;
+
+	if (strncasecmp(Value, HOST_REGISTRY_HEX_PREFIX, strlen(HOST_REGISTRY_HEX_PREFIX)) == 0)
+	{
+		status = HostRegistrySetHex(Device, Name, Value + strlen(HOST_REGISTRY_HEX_PREFIX));
+		goto exit;
+	}
+
+	if (strlen(Value) >= HOST_REGISTRY_MAX_VALUE)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	status = HostRegistryAllocateValue(Device, Name, &value);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	strcpy(value->Value, Value);
+
+exit:
+
+	return status;
+}
+
+static PSTR
+HostRegistryTrim(
+	IN PSTR String
+)
+{
+	PSTR end;
+
+	while (isspace((UCHAR)*String))
+	{
+		String++;
+	}
+
+	end = String + strlen(String);
+
+	while (end > String && isspace((UCHAR)end[-1]))
+	{
+		*--end = '\0';
+	}
+
+	return String;
+}
+
+static NTSTATUS
+HostRegistryParseFile(
+	IN PCSTR Path,
+	IN BOOLEAN Persist
+)
+{
+	static CHAR line[HOST_REGISTRY_MAX_NAME + 2 * HOST_REGISTRY_MAX_DATA + 16];
+	ULONG lineNumber = 0;
+	PSTR separator;
+	PSTR name;
+	FILE* file;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	file = fopen(Path, "r");
+
+	if (file == NULL)
+	{
+		status = HostStatusFromErrno(errno);
+
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Could not open configuration %s - STATUS:%X",
+			Path,
+			status);
+
+		goto exit;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lineNumber++;
+		name = HostRegistryTrim(line);
+
+		if (*name == '\0' || *name == '#' || *name == ';' || *name == '[')
+		{
+			continue;
+		}
+
+		separator = strchr(name, '=');
+
+		if (separator == NULL)
+		{
+			status = STATUS_INVALID_PARAMETER;
+		}
+		else
+		{
+			*separator = '\0';
+			name = HostRegistryTrim(name);
+			status = HostRegistrySetValue(
+				name,
+				HostRegistryTrim(separator + 1));
+
+			if (NT_SUCCESS(status) && Persist)
+			{
+				HostRegistryFind(NULL, name)->Persist = TRUE;
+			}
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_REGISTRY,
+				"Invalid configuration line %s:%u - STATUS:%X",
+				Path,
+				lineNumber,
+				status);
+
+			break;
+		}
+	}
+
+	fclose(file);
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+HostRegistryLoadFile(
+	IN PCSTR Path
+)
+/*++
+
+  Routine Description:
+
+	Loads Name=Value lines from a file. Blank lines, lines starting
+	with '#' or ';' and [section] headers are skipped, so an INF style
+	AddReg list pasted into the file only needs its values reformatted.
+	Binary values are written hex: followed by their bytes in hex.
+
+  Arguments:
+
+	Path - configuration file
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	return HostRegistryParseFile(Path, FALSE);
+}
+
+VOID
+HostRegistryClear(
+	VOID
+)
+{
+	HOST_REGISTRY_VALUE* value;
+
+	while (gValues != NULL)
+	{
+		value = gValues;
+		gValues = value->Next;
+		free(value->Data);
+		free(value);
+	}
+
+	gStatePath = NULL;
+}
+
+static NTSTATUS
+HostRegistrySaveState(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Rewrites the state file with the values written by the core. The
+	file is replaced in one rename so a crash leaves the old state.
+
+--*/
+{
+	CHAR temporary[PATH_MAX];
+	HOST_REGISTRY_VALUE* value;
+	FILE* file;
+	ULONG i;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (gStatePath == NULL)
+	{
+		goto exit;
+	}
+
+	snprintf(temporary, sizeof(temporary), "%s.tmp", gStatePath);
+	file = fopen(temporary, "w");
+
+	if (file == NULL)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	for (value = gValues; value != NULL; value = value->Next)
+	{
+		if (!value->Persist)
+		{
+			continue;
+		}
+
+		if (value->Data != NULL)
+		{
+			fprintf(file, "%s=%s", value->Name, HOST_REGISTRY_HEX_PREFIX);
+
+			for (i = 0; i < value->DataLength; i++)
+			{
+				fprintf(file, "%02x", value->Data[i]);
+			}
+
+			fprintf(file, "\n");
+		}
+		else
+		{
+			fprintf(file, "%s=%s\n", value->Name, value->Value);
+		}
+	}
+
+	if (fclose(file) != 0 || rename(temporary, gStatePath) != 0)
+	{
+		status = HostStatusFromErrno(errno);
+		unlink(temporary);
+	}
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Could not save state %s - STATUS:%X",
+			gStatePath,
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+HostRegistryLoadState(
+	IN PCSTR Path
+)
+/*++
+
+  Routine Description:
+
+	Loads the values the core wrote on earlier runs and keeps Path as
+	the file later writes are saved to. A missing file is an empty
+	state.
+
+  Arguments:
+
+	Path - state file
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (access(Path, F_OK) == 0)
+	{
+		status = HostRegistryParseFile(Path, TRUE);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	gStatePath = Path;
+
+exit:
+
+	return status;
+}
+
+static NTSTATUS
+HostRegistryOpen(
+	IN PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	IN WDFDEVICE Device,
+	OUT WDFKEY* Key
+)
+{
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectKey,
+		sizeof(HOST_REGISTRY_KEY),
+		KeyAttributes,
+		NULL,
+		NULL,
+		Key);
+
+	if (NT_SUCCESS(status))
+	{
+		((HOST_REGISTRY_KEY*)*Key)->Device = Device;
+	}
+
+	return status;
+}
+
+NTSTATUS
+WdfDeviceOpenRegistryKey(
+	IN WDFDEVICE Device,
+	IN ULONG DeviceInstanceKeyType,
+	IN ACCESS_MASK DesiredAccess,
+	IN PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	OUT WDFKEY* Key
+)
+{
+	UNREFERENCED_PARAMETER(DeviceInstanceKeyType);
+	UNREFERENCED_PARAMETER(DesiredAccess);
+
+	return HostRegistryOpen(KeyAttributes, Device, Key);
+}
+
+NTSTATUS
+WdfRegistryOpenKey(
+	IN WDFKEY ParentKey,
+	IN PCUNICODE_STRING KeyName,
+	IN ACCESS_MASK DesiredAccess,
+	IN PWDF_OBJECT_ATTRIBUTES KeyAttributes,
+	OUT WDFKEY* Key
+)
+{
+	UNREFERENCED_PARAMETER(KeyName);
+	UNREFERENCED_PARAMETER(DesiredAccess);
+
+	return HostRegistryOpen(KeyAttributes, HostRegistryKeyDevice(ParentKey), Key);
+}
+
+HANDLE
+WdfRegistryWdmGetHandle(
+	IN WDFKEY Key
+)
+{
+	return (HANDLE)Key;
+}
+
+VOID
+WdfRegistryClose(
+	IN WDFKEY Key
+)
+{
+	WdfObjectDelete(Key);
+}
+
+NTSTATUS
+WdfRegistryQueryULong(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	OUT PULONG Value
+)
+{
+	HOST_REGISTRY_VALUE* value;
+
+	value = HostRegistryFindUnicode(HostRegistryKeyDevice(Key), ValueName);
+
+	if (value == NULL)
+	{
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+	}
+
+	return HostRegistryParseULong(value->Value, Value);
+}
+
+NTSTATUS
+WdfRegistryQueryMultiString(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN PWDF_OBJECT_ATTRIBUTES StringsAttributes,
+	IN WDFCOLLECTION Collection
+)
+/*++
+
+  Routine Description:
+
+	Adds one string object per ';' separated string of the value to
+	Collection. The strings are parented to the collection unless
+	StringsAttributes names another parent.
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+	WDFSTRING string;
+	PCSTR start;
+	PCSTR end;
+	NTSTATUS status;
+
+	value = HostRegistryFindUnicode(HostRegistryKeyDevice(Key), ValueName);
+
+	if (value == NULL)
+	{
+		status = STATUS_OBJECT_NAME_NOT_FOUND;
+		goto exit;
+	}
+
+	status = STATUS_SUCCESS;
+
+	for (start = value->Value; *start != '\0'; start = (*end == ';') ? end + 1 : end)
+	{
+		end = strchr(start, ';');
+
+		if (end == NULL)
+		{
+			end = start + strlen(start);
+		}
+
+		if (end == start)
+		{
+			continue;
+		}
+
+		status = HostStringCreate(
+			start,
+			end - start,
+			StringsAttributes,
+			Collection,
+			&string);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		status = HostCollectionAdd(Collection, string);
+
+		if (!NT_SUCCESS(status))
+		{
+			WdfObjectDelete(string);
+			goto exit;
+		}
+	}
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+WdfRegistryQueryValue(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN ULONG ValueLength,
+	OUT PVOID Value,
+	OUT PULONG ValueLengthQueried,
+	OUT PULONG ValueType
+)
+/*++
+
+  Routine Description:
+
+	Returns binary values as REG_BINARY and numbers as REG_DWORD, other
+	text values are not typed and cannot be read this way
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+	const VOID* data;
+	ULONG length;
+	ULONG number;
+	NTSTATUS status;
+
+	value = HostRegistryFindUnicode(HostRegistryKeyDevice(Key), ValueName);
+
+	if (value == NULL)
+	{
+		status = STATUS_OBJECT_NAME_NOT_FOUND;
+		goto exit;
+	}
+
+	if (value->Data != NULL)
+	{
+		*ValueType = REG_BINARY;
+		data = value->Data;
+		length = value->DataLength;
+	}
+	else
+	{
+		status = HostRegistryParseULong(value->Value, &number);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		*ValueType = REG_DWORD;
+		data = &number;
+		length = sizeof(number);
+	}
+
+	*ValueLengthQueried = length;
+
+	if (length > ValueLength)
+	{
+		status = STATUS_BUFFER_OVERFLOW;
+		goto exit;
+	}
+
+	RtlCopyMemory(Value, data, length);
+	status = STATUS_SUCCESS;
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+WdfRegistryAssignValue(
+	IN WDFKEY Key,
+	IN PCUNICODE_STRING ValueName,
+	IN ULONG ValueType,
+	IN ULONG ValueLength,
+	IN PVOID Value
+)
+/*++
+
+  Routine Description:
+
+	Stores a REG_BINARY or REG_DWORD value written by the core and saves
+	the state file. Values written are shared, whatever key they were
+	written through, so the state file holds them by name alone.
+
+--*/
+{
+	HOST_REGISTRY_VALUE* value;
+	CHAR name[HOST_REGISTRY_MAX_NAME];
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Key);
+
+	if (!HostRegistryNarrowName(
+		ValueName->Buffer,
+		ValueName->Length / sizeof(WCHAR),
+		name))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (ValueType == REG_BINARY)
+	{
+		status = HostRegistrySetBinary(NULL, name, Value, ValueLength, &value);
+	}
+	else if (ValueType == REG_DWORD && ValueLength == sizeof(ULONG))
+	{
+		status = HostRegistryAllocateValue(NULL, name, &value);
+
+		if (NT_SUCCESS(status))
+		{
+			snprintf(value->Value, sizeof(value->Value), "0x%x", *(PULONG)Value);
+		}
+	}
+	else
+	{
+		status = STATUS_NOT_SUPPORTED;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	value->Persist = TRUE;
+	status = HostRegistrySaveState();
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+RtlQueryRegistryValues(
+	IN ULONG RelativeTo,
+	IN PCWSTR Path,
+	IN PRTL_QUERY_REGISTRY_TABLE QueryTable,
+	IN PVOID Context,
+	IN PVOID Environment
+)
+/*++
+
+  Routine Description:
+
+	Runs a query table against the value set. Direct entries receive
+	the value as a ULONG, the others have their QueryRoutine called
+	with a REG_DWORD. A missing value only fails REQUIRED entries. A
+	query relative to a key handle reads the values of the key's device.
+
+--*/
+{
+	PRTL_QUERY_REGISTRY_TABLE entry;
+	HOST_REGISTRY_VALUE* value;
+	WDFDEVICE device = NULL;
+	CHAR name[HOST_REGISTRY_MAX_NAME];
+	SIZE_T length;
+	ULONG data;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (RelativeTo == RTL_REGISTRY_HANDLE)
+	{
+		device = HostRegistryKeyDevice((WDFKEY)Path);
+	}
+
+	for (entry = QueryTable;
+		entry->QueryRoutine != NULL || entry->Name != NULL;
+		entry++)
+	{
+		value = NULL;
+
+		if (entry->Name != NULL)
+		{
+			for (length = 0; entry->Name[length] != 0; length++)
+			{
+			}
+
+			if (HostRegistryNarrowName(entry->Name, length, name))
+			{
+				value = HostRegistryFind(device, name);
+			}
+		}
+
+		if (value == NULL)
+		{
+			if (entry->Flags & RTL_QUERY_REGISTRY_REQUIRED)
+			{
+				status = STATUS_OBJECT_NAME_NOT_FOUND;
+				goto exit;
+			}
+
+			continue;
+		}
+
+		status = HostRegistryParseULong(value->Value, &data);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_REGISTRY,
+				"Value %s is not a number - STATUS:%X",
+				name,
+				status);
+
+			goto exit;
+		}
+
+		if (entry->Flags & RTL_QUERY_REGISTRY_DIRECT)
+		{
+			*(PULONG)entry->EntryContext = data;
+		}
+		else
+		{
+			status = entry->QueryRoutine(
+				entry->Name,
+				REG_DWORD,
+				&data,
+				sizeof(data),
+				Context,
+				entry->EntryContext);
+
+			if (!NT_SUCCESS(status))
+			{
+				goto exit;
+			}
+		}
+	}
+
+exit:
+
+	return status;
+}
@@ -0,0 +1,316 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		i2cdev.c
+
+	Abstract:
+
+		RMI4 over I2C through the i2c-dev character device. Register
+		accesses are framed the way SpbI2cTransport frames them: the
+		register offset of the mapped page followed by the data, reads
+		as a write-then-read combined transfer.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+#include "host.h"
+#include "debug.h"
+
+//
+// i2c-dev rejects I2C_RDWR messages longer than 8192 bytes
+//
+#define HOST_I2CDEV_MAX_TRANSFER 8192
+
+typedef struct _HOST_I2CDEV_CONTEXT
+{
+	int Fd;
+	USHORT Address;
+} HOST_I2CDEV_CONTEXT;
+
+static SPB_TRANSPORT_READ HostI2cDevRead;
+static SPB_TRANSPORT_WRITE HostI2cDevWrite;
+
+const SPB_TRANSPORT HostI2cDevTransport =
+{
+	"i2c-dev",
+	HOST_I2CDEV_MAX_TRANSFER,
+	HostI2cDevRead,
+	HostI2cDevWrite,
+	SpbSetPageRegister
+};
+
+static
+NTSTATUS
+HostI2cDevWrite(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	Writes the register offset and the data in one message
+
+--*/
+{
+	HOST_I2CDEV_CONTEXT* context = (HOST_I2CDEV_CONTEXT*)SpbContext->TransportContext;
+	UCHAR stackBuffer[DEFAULT_SPB_BUFFER_SIZE + 1];
+	struct i2c_rdwr_ioctl_data transfer;
+	struct i2c_msg message;
+	PUCHAR buffer;
+	NTSTATUS status;
+
+	if (Length + 1 > HOST_I2CDEV_MAX_TRANSFER)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto exit;
+	}
+
+	buffer = stackBuffer;
+
+	if (Length + 1 > sizeof(stackBuffer))
+	{
+		buffer = (PUCHAR)malloc(Length + 1);
+
+		if (buffer == NULL)
+		{
+			status = STATUS_INSUFFICIENT_RESOURCES;
+			goto exit;
+		}
+	}
+
+	buffer[0] = (UCHAR)(Address & 0xFF);
+
+	if (Length != 0)
+	{
+		RtlCopyMemory(buffer + 1, Data, Length);
+	}
+
+	message.addr = context->Address;
+	message.flags = 0;
+	message.len = (__u16)(Length + 1);
+	message.buf = buffer;
+
+	transfer.msgs = &message;
+	transfer.nmsgs = 1;
+
+	if (ioctl(context->Fd, I2C_RDWR, &transfer) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+	}
+	else
+	{
+		status = STATUS_SUCCESS;
+	}
+
+	if (buffer != stackBuffer)
+	{
+		free(buffer);
+	}
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error writing register %04X over i2c-dev - STATUS:%X",
+			Address,
+			status);
+	}
+
+	return status;
+}
+
+static
+NTSTATUS
+HostI2cDevRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	Reads registers with a combined transfer, the register offset is
+	written and the data read back under a repeated start
+
+--*/
+{
+	HOST_I2CDEV_CONTEXT* context = (HOST_I2CDEV_CONTEXT*)SpbContext->TransportContext;
+	struct i2c_rdwr_ioctl_data transfer;
+	struct i2c_msg messages[2];
+	UCHAR offset;
+	NTSTATUS status;
+
+	offset = (UCHAR)(Address & 0xFF);
+
+	messages[0].addr = context->Address;
+	messages[0].flags = 0;
+	messages[0].len = sizeof(offset);
+	messages[0].buf = &offset;
+
+	messages[1].addr = context->Address;
+	messages[1].flags = I2C_M_RD;
+	messages[1].len = (__u16)Length;
+	messages[1].buf = (PUCHAR)Data;
+
+	transfer.msgs = messages;
+	transfer.nmsgs = 2;
+
+	if (ioctl(context->Fd, I2C_RDWR, &transfer) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error reading register %04X over i2c-dev - STATUS:%X",
+			Address,
+			status);
+	}
+	else
+	{
+		status = STATUS_SUCCESS;
+	}
+
+	return status;
+}
+
+NTSTATUS
+HostI2cDevOpen(
+	IN PCSTR Path,
+	IN ULONG Address,
+	OUT SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Opens an I2C adapter and sets up SpbContext to reach the
+	controller at the 7 bit Address through it
+
+  Arguments:
+
+	Path       - adapter device, e.g. /dev/i2c-1
+	Address    - 7 bit slave address of the controller
+	SpbContext - receives the transport
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	HOST_I2CDEV_CONTEXT* context;
+	unsigned long functionality;
+	NTSTATUS status;
+
+	RtlZeroMemory(SpbContext, sizeof(SPB_CONTEXT));
+
+	if (Address > 0x7F)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	context = (HOST_I2CDEV_CONTEXT*)calloc(1, sizeof(HOST_I2CDEV_CONTEXT));
+
+	if (context == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	SpbContext->Transport = &HostI2cDevTransport;
+	SpbContext->TransportContext = context;
+	context->Address = (USHORT)Address;
+	context->Fd = open(Path, O_RDWR | O_CLOEXEC);
+
+	if (context->Fd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	//
+	// Register reads need combined transfers
+	//
+	if (ioctl(context->Fd, I2C_FUNCS, &functionality) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	if ((functionality & I2C_FUNC_I2C) == 0)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	status = WdfWaitLockCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&SpbContext->SpbLock);
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error opening %s for address %02X - STATUS:%X",
+			Path,
+			Address,
+			status);
+
+		HostI2cDevClose(SpbContext);
+	}
+
+	return status;
+}
+
+VOID
+HostI2cDevClose(
+	IN SPB_CONTEXT* SpbContext
+)
+{
+	HOST_I2CDEV_CONTEXT* context = (HOST_I2CDEV_CONTEXT*)SpbContext->TransportContext;
+
+	if (SpbContext->SpbLock != NULL)
+	{
+		WdfObjectDelete(SpbContext->SpbLock);
+		SpbContext->SpbLock = NULL;
+	}
+
+	if (context != NULL)
+	{
+		if (context->Fd >= 0)
+		{
+			close(context->Fd);
+		}
+
+		free(context);
+		SpbContext->TransportContext = NULL;
+	}
+}
@@ -0,0 +1,213 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		loop.c
+
+	Abstract:
+
+		Single threaded epoll loop. It takes the place of the interrupt,
+		timer and work item dispatch of the framework, so the core never
+		sees two of its callbacks run at once.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "host.h"
+#include "debug.h"
+
+#define HOST_LOOP_MAX_ENTRIES 32
+#define HOST_LOOP_MAX_EVENTS 8
+
+typedef struct _HOST_LOOP_ENTRY
+{
+	int Fd;
+	HOST_LOOP_CALLBACK* Callback;
+	PVOID Context;
+} HOST_LOOP_ENTRY;
+
+static int gEpollFd = -1;
+static BOOLEAN gStopping = FALSE;
+static HOST_LOOP_ENTRY gEntries[HOST_LOOP_MAX_ENTRIES];
+
+NTSTATUS
+HostLoopInitialize(
+	VOID
+)
+{
+	ULONG i;
+
+	for (i = 0; i < HOST_LOOP_MAX_ENTRIES; i++)
+	{
+		gEntries[i].Fd = -1;
+	}
+
+	gStopping = FALSE;
+	gEpollFd = epoll_create1(EPOLL_CLOEXEC);
+
+	if (gEpollFd < 0)
+	{
+		return HostStatusFromErrno(errno);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+HostLoopDeinitialize(
+	VOID
+)
+{
+	if (gEpollFd >= 0)
+	{
+		close(gEpollFd);
+		gEpollFd = -1;
+	}
+}
+
+NTSTATUS
+HostLoopAdd(
+	IN int Fd,
+	IN ULONG Events,
+	IN HOST_LOOP_CALLBACK* Callback,
+	IN PVOID Context
+)
+/*++
+
+  Routine Description:
+
+	Calls Callback on the loop whenever Fd signals one of Events
+
+--*/
+{
+	struct epoll_event event;
+	NTSTATUS status;
+	ULONG i;
+
+	for (i = 0; i < HOST_LOOP_MAX_ENTRIES; i++)
+	{
+		if (gEntries[i].Fd < 0)
+		{
+			break;
+		}
+	}
+
+	if (i == HOST_LOOP_MAX_ENTRIES)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	event.events = Events;
+	event.data.fd = Fd;
+
+	if (epoll_ctl(gEpollFd, EPOLL_CTL_ADD, Fd, &event) != 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	gEntries[i].Fd = Fd;
+	gEntries[i].Callback = Callback;
+	gEntries[i].Context = Context;
+	status = STATUS_SUCCESS;
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not add fd %d to the event loop - STATUS:%X",
+			Fd,
+			status);
+	}
+
+	return status;
+}
+
+VOID
+HostLoopRemove(
+	IN int Fd
+)
+{
+	ULONG i;
+
+	for (i = 0; i < HOST_LOOP_MAX_ENTRIES; i++)
+	{
+		if (gEntries[i].Fd == Fd)
+		{
+			epoll_ctl(gEpollFd, EPOLL_CTL_DEL, Fd, NULL);
+			gEntries[i].Fd = -1;
+			break;
+		}
+	}
+}
+
+NTSTATUS
+HostLoopRun(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Dispatches events until HostLoopStop is called. Entries are looked
+	up by fd for every event, so a callback may remove any entry,
+	including ones with events still pending in this batch.
+
+--*/
+{
+	struct epoll_event events[HOST_LOOP_MAX_EVENTS];
+	int count;
+	int i;
+	ULONG j;
+
+	while (!gStopping)
+	{
+		count = epoll_wait(gEpollFd, events, HOST_LOOP_MAX_EVENTS, -1);
+
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			return HostStatusFromErrno(errno);
+		}
+
+		for (i = 0; i < count && !gStopping; i++)
+		{
+			for (j = 0; j < HOST_LOOP_MAX_ENTRIES; j++)
+			{
+				if (gEntries[j].Fd == events[i].data.fd)
+				{
+					gEntries[j].Callback(gEntries[j].Context, events[i].events);
+					break;
+				}
+			}
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+HostLoopStop(
+	VOID
+)
+{
+	gStopping = TRUE;
+}
@@ -0,0 +1,821 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		ntoskrnl.c
+
+	Abstract:
+
+		Kernel routines declared in compat/wdm.h: pool, time, tracing,
+		strings, registry queries and power setting notifications.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "host.h"
+#include "wdmguid.h"
+#include "debug.h"
+
+// {02731015-4510-4526-99E6-E5A17EBD1AEA}
+const GUID GUID_MONITOR_POWER_ON =
+	{ 0x02731015, 0x4510, 0x4526, { 0x99, 0xe6, 0xe5, 0xa1, 0x7e, 0xbd, 0x1a, 0xea } };
+
+static BOOLEAN gVerbose = FALSE;
+
+//
+// Monitor power notifications. There is no display on the host, the
+// simulator turns the monitor off and on, and registrations are handed
+// the current state right away as on Windows.
+//
+#define HOST_MONITOR_IS_OFF         0
+#define HOST_MONITOR_IS_ON          1
+#define HOST_MAX_MONITOR_CALLBACKS  4
+
+typedef struct _HOST_MONITOR_CALLBACK
+{
+	PPOWER_SETTING_CALLBACK Callback;
+	PVOID Context;
+} HOST_MONITOR_CALLBACK;
+
+static HOST_MONITOR_CALLBACK gMonitorCallbacks[HOST_MAX_MONITOR_CALLBACKS];
+static ULONG gMonitorState = HOST_MONITOR_IS_ON;
+
+//
+// Time of the simulated frame being played, zero when scan times come
+// from the monotonic clock
+//
+static ULONG64 gFrameTime = 0;
+
+//
+// Offset HostClockAdvance adds to the monotonic clock
+//
+static ULONG64 gClockOffset = 0;
+
+//
+// Device interfaces and the drivers registered for their arrival. There
+// are a couple of each, the backlight's light sensor and LEDs.
+//
+#define HOST_MAX_DEVICE_INTERFACES      4
+#define HOST_MAX_PNP_NOTIFICATIONS      4
+
+typedef struct _HOST_DEVICE_INTERFACE
+{
+	GUID InterfaceClass;
+	UNICODE_STRING SymbolicLinkName;
+	const HOST_IO_TARGET_OPS* Ops;
+	PVOID Context;
+} HOST_DEVICE_INTERFACE;
+
+typedef struct _HOST_PNP_NOTIFICATION
+{
+	GUID InterfaceClass;
+	PDRIVER_NOTIFICATION_CALLBACK_ROUTINE Callback;
+	PVOID Context;
+} HOST_PNP_NOTIFICATION;
+
+static HOST_DEVICE_INTERFACE gDeviceInterfaces[HOST_MAX_DEVICE_INTERFACES];
+static HOST_PNP_NOTIFICATION gPnpNotifications[HOST_MAX_PNP_NOTIFICATIONS];
+
+VOID
+HostSetVerbose(
+	IN BOOLEAN Verbose
+)
+{
+	gVerbose = Verbose;
+}
+
+VOID
+HostTrace(
+	IN ULONG Level,
+	IN PCSTR Format,
+	...
+)
+/*++
+
+  Routine Description:
+
+	Writes a Trace message to stderr. Errors and warnings are always
+	written, the remaining levels only in verbose mode.
+
+--*/
+{
+	va_list args;
+
+	if (!gVerbose &&
+		Level != TRACE_LEVEL_ERROR &&
+		Level != TRACE_LEVEL_WARNING)
+	{
+		return;
+	}
+
+	va_start(args, Format);
+	vfprintf(stderr, Format, args);
+	va_end(args);
+}
+
+ULONG
+DbgPrintEx(
+	IN ULONG ComponentId,
+	IN ULONG Level,
+	IN PCSTR Format,
+	...
+)
+{
+	va_list args;
+	int written;
+
+	UNREFERENCED_PARAMETER(ComponentId);
+	UNREFERENCED_PARAMETER(Level);
+
+	va_start(args, Format);
+	written = vfprintf(stderr, Format, args);
+	va_end(args);
+
+	return (written < 0) ? 0 : (ULONG)written;
+}
+
+VOID
+HostAssertFailed(
+	IN PCSTR Expression,
+	IN PCSTR File,
+	IN int Line
+)
+{
+	fprintf(stderr, "ST: Assertion failed: %s, %s:%d\n", Expression, File, Line);
+	abort();
+}
+
+NTSTATUS
+HostStatusFromErrno(
+	IN int Error
+)
+/*++
+
+  Routine Description:
+
+	Maps an errno value from a failed system call to the closest
+	NTSTATUS, so host code reports errors the way the core does.
+
+--*/
+{
+	switch (Error)
+	{
+	case 0:
+		return STATUS_SUCCESS;
+	case ENOMEM:
+		return STATUS_INSUFFICIENT_RESOURCES;
+	case ENOENT:
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+	case EACCES:
+	case EPERM:
+		return STATUS_ACCESS_DENIED;
+	case ENODEV:
+	case ENXIO:
+		return STATUS_NO_SUCH_DEVICE;
+	case EBUSY:
+		return STATUS_DEVICE_BUSY;
+	case ETIMEDOUT:
+		return STATUS_IO_TIMEOUT;
+	case EINVAL:
+		return STATUS_INVALID_PARAMETER;
+	case EREMOTEIO:
+	case EIO:
+		return STATUS_DEVICE_DATA_ERROR;
+	case EOPNOTSUPP:
+		return STATUS_NOT_SUPPORTED;
+	default:
+		return STATUS_UNSUCCESSFUL;
+	}
+}
+
+PVOID
+ExAllocatePoolWithTag(
+	IN POOL_TYPE PoolType,
+	IN SIZE_T NumberOfBytes,
+	IN ULONG Tag
+)
+{
+	PVOID p;
+
+	UNREFERENCED_PARAMETER(Tag);
+
+	if (PoolType == NonPagedPoolNxCacheAligned)
+	{
+		if (posix_memalign(
+			&p,
+			SYSTEM_CACHE_ALIGNMENT_SIZE,
+			ALIGN_UP_BY(NumberOfBytes, SYSTEM_CACHE_ALIGNMENT_SIZE)) != 0)
+		{
+			p = NULL;
+		}
+
+		return p;
+	}
+
+	return malloc(NumberOfBytes);
+}
+
+VOID
+ExFreePoolWithTag(
+	IN PVOID P,
+	IN ULONG Tag
+)
+{
+	UNREFERENCED_PARAMETER(Tag);
+
+	free(P);
+}
+
+SIZE_T
+RtlCompareMemory(
+	IN const VOID* Source1,
+	IN const VOID* Source2,
+	IN SIZE_T Length
+)
+{
+	const UCHAR* a = (const UCHAR*)Source1;
+	const UCHAR* b = (const UCHAR*)Source2;
+	SIZE_T i;
+
+	for (i = 0; i < Length && a[i] == b[i]; i++)
+	{
+	}
+
+	return i;
+}
+
+VOID
+RtlInitUnicodeString(
+	OUT PUNICODE_STRING DestinationString,
+	IN PCWSTR SourceString
+)
+{
+	USHORT length = 0;
+
+	if (SourceString != NULL)
+	{
+		while (SourceString[length] != L'\0')
+		{
+			length++;
+		}
+	}
+
+	DestinationString->Length = length * sizeof(WCHAR);
+	DestinationString->MaximumLength = DestinationString->Length + sizeof(WCHAR);
+	DestinationString->Buffer = (PWSTR)SourceString;
+}
+
+NTSTATUS
+RtlUnicodeStringToInteger(
+	IN PCUNICODE_STRING String,
+	IN ULONG Base,
+	OUT PULONG Value
+)
+/*++
+
+  Routine Description:
+
+	Converts a number in Base, or in the base its 0x, 0o or 0b prefix
+	names when Base is 0, stopping at the first character that is not
+	a digit of the base
+
+--*/
+{
+	ULONG length = String->Length / sizeof(WCHAR);
+	PCWSTR buffer = String->Buffer;
+	BOOLEAN negative = FALSE;
+	ULONG value = 0;
+	ULONG digit;
+	ULONG i = 0;
+
+	while (i < length && buffer[i] <= L' ')
+	{
+		i++;
+	}
+
+	if (i < length && (buffer[i] == L'-' || buffer[i] == L'+'))
+	{
+		negative = (buffer[i] == L'-');
+		i++;
+	}
+
+	if (Base == 0)
+	{
+		Base = 10;
+
+		if (i + 1 < length && buffer[i] == L'0')
+		{
+			switch (buffer[i + 1])
+			{
+			case L'x':
+				Base = 16;
+				i += 2;
+				break;
+			case L'o':
+				Base = 8;
+				i += 2;
+				break;
+			case L'b':
+				Base = 2;
+				i += 2;
+				break;
+			default:
+				break;
+			}
+		}
+	}
+	else if (Base != 2 && Base != 8 && Base != 10 && Base != 16)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	for (; i < length; i++)
+	{
+		if (buffer[i] >= L'0' && buffer[i] <= L'9')
+		{
+			digit = buffer[i] - L'0';
+		}
+		else if (buffer[i] >= L'a' && buffer[i] <= L'f')
+		{
+			digit = buffer[i] - L'a' + 10;
+		}
+		else if (buffer[i] >= L'A' && buffer[i] <= L'F')
+		{
+			digit = buffer[i] - L'A' + 10;
+		}
+		else
+		{
+			break;
+		}
+
+		if (digit >= Base)
+		{
+			break;
+		}
+
+		value = (value * Base) + digit;
+	}
+
+	*Value = negative ? (ULONG)(-(LONG)value) : value;
+
+	return STATUS_SUCCESS;
+}
+
+ULONG64
+KeQueryInterruptTime(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Monotonic time in 100ns units, the unit the core measures
+	latencies and scan times in
+
+--*/
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return ((ULONG64)now.tv_sec * 10000000ULL) + ((ULONG64)now.tv_nsec / 100) +
+		gClockOffset;
+}
+
+VOID
+HostClockAdvance(
+	IN ULONG64 Time
+)
+{
+	gClockOffset += Time;
+}
+
+VOID
+HostClockSetFrameTime(
+	IN ULONG64 Time
+)
+{
+	gFrameTime = Time;
+}
+
+ULONG64
+KeQueryInterruptTimePrecise(
+	OUT PULONG64 QpcTimeStamp
+)
+/*++
+
+  Routine Description:
+
+	Time in 100ns units the core takes scan times from. While the
+	simulator plays frames it is the time of the current frame, so
+	that runs against it are reproducible.
+
+--*/
+{
+	struct timespec now;
+
+	if (gFrameTime != 0)
+	{
+		*QpcTimeStamp = gFrameTime * 100;
+
+		return gFrameTime;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	//
+	// The performance counter is reported in nanoseconds
+	//
+	*QpcTimeStamp = ((ULONG64)now.tv_sec * 1000000000ULL) + (ULONG64)now.tv_nsec +
+		(gClockOffset * 100);
+
+	return *QpcTimeStamp / 100;
+}
+
+NTSTATUS
+KeDelayExecutionThread(
+	IN KPROCESSOR_MODE WaitMode,
+	IN BOOLEAN Alertable,
+	IN PLARGE_INTEGER Interval
+)
+/*++
+
+  Routine Description:
+
+	Sleeps for a relative (negative) interval in 100ns units. The core
+	only waits relative intervals, absolute ones return immediately.
+
+--*/
+{
+	struct timespec delay;
+	LONGLONG ticks;
+
+	UNREFERENCED_PARAMETER(WaitMode);
+	UNREFERENCED_PARAMETER(Alertable);
+
+	ticks = -Interval->QuadPart;
+
+	if (ticks <= 0)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	delay.tv_sec = (time_t)(ticks / 10000000LL);
+	delay.tv_nsec = (long)((ticks % 10000000LL) * 100);
+
+	while (nanosleep(&delay, &delay) != 0 && errno == EINTR)
+	{
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+PoRegisterPowerSettingCallback(
+	IN PDEVICE_OBJECT DeviceObject,
+	IN LPCGUID SettingGuid,
+	IN PPOWER_SETTING_CALLBACK Callback,
+	IN PVOID Context,
+	OUT PVOID* Handle
+)
+/*++
+
+  Routine Description:
+
+	Only monitor power notifications are delivered, the callback is
+	invoked with the current monitor state before this returns
+
+--*/
+{
+	ULONG i;
+
+	UNREFERENCED_PARAMETER(DeviceObject);
+
+	*Handle = NULL;
+
+	if (!InlineIsEqualGUID(SettingGuid, &GUID_MONITOR_POWER_ON))
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	for (i = 0; i < HOST_MAX_MONITOR_CALLBACKS; i++)
+	{
+		if (gMonitorCallbacks[i].Callback == NULL)
+		{
+			break;
+		}
+	}
+
+	if (i == HOST_MAX_MONITOR_CALLBACKS)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	gMonitorCallbacks[i].Callback = Callback;
+	gMonitorCallbacks[i].Context = Context;
+	*Handle = &gMonitorCallbacks[i];
+
+	(VOID)Callback(
+		&GUID_MONITOR_POWER_ON,
+		&gMonitorState,
+		sizeof(gMonitorState),
+		Context);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+PoUnregisterPowerSettingCallback(
+	IN PVOID Handle
+)
+{
+	HOST_MONITOR_CALLBACK* registration = (HOST_MONITOR_CALLBACK*)Handle;
+
+	registration->Callback = NULL;
+	registration->Context = NULL;
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+HostSetMonitorState(
+	IN BOOLEAN On
+)
+/*++
+
+  Routine Description:
+
+	Turns the simulated monitor off or on and notifies the registered
+	monitor power callbacks of the change
+
+--*/
+{
+	ULONG state = On ? HOST_MONITOR_IS_ON : HOST_MONITOR_IS_OFF;
+	ULONG i;
+
+	if (state == gMonitorState)
+	{
+		return;
+	}
+
+	gMonitorState = state;
+
+	for (i = 0; i < HOST_MAX_MONITOR_CALLBACKS; i++)
+	{
+		if (gMonitorCallbacks[i].Callback != NULL)
+		{
+			(VOID)gMonitorCallbacks[i].Callback(
+				&GUID_MONITOR_POWER_ON,
+				&gMonitorState,
+				sizeof(gMonitorState),
+				gMonitorCallbacks[i].Context);
+		}
+	}
+}
+
+static VOID
+HostNotifyDeviceInterface(
+	IN const HOST_PNP_NOTIFICATION* Notification,
+	IN const HOST_DEVICE_INTERFACE* Interface,
+	IN const GUID* Event
+)
+{
+	DEVICE_INTERFACE_CHANGE_NOTIFICATION change;
+
+	RtlZeroMemory(&change, sizeof(change));
+	change.Version = 1;
+	change.Size = sizeof(change);
+	change.Event = *Event;
+	change.InterfaceClassGuid = Interface->InterfaceClass;
+	change.SymbolicLinkName = (PUNICODE_STRING)&Interface->SymbolicLinkName;
+
+	(VOID)Notification->Callback(&change, Notification->Context);
+}
+
+NTSTATUS
+IoRegisterPlugPlayNotification(
+	IN IO_NOTIFICATION_EVENT_CATEGORY EventCategory,
+	IN ULONG EventCategoryFlags,
+	IN PVOID EventCategoryData,
+	IN PDRIVER_OBJECT DriverObject,
+	IN PDRIVER_NOTIFICATION_CALLBACK_ROUTINE CallbackRoutine,
+	IN PVOID Context,
+	OUT PVOID* NotificationEntry
+)
+/*++
+
+  Routine Description:
+
+	Registers for the arrival and removal of the device interfaces of
+	the class EventCategoryData points to. Interfaces registered
+	already are reported before this returns when asked for.
+
+--*/
+{
+	HOST_PNP_NOTIFICATION* notification;
+	ULONG i;
+
+	UNREFERENCED_PARAMETER(DriverObject);
+
+	*NotificationEntry = NULL;
+
+	if (EventCategory != EventCategoryDeviceInterfaceChange)
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	for (i = 0; i < HOST_MAX_PNP_NOTIFICATIONS; i++)
+	{
+		if (gPnpNotifications[i].Callback == NULL)
+		{
+			break;
+		}
+	}
+
+	if (i == HOST_MAX_PNP_NOTIFICATIONS)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	notification = &gPnpNotifications[i];
+	notification->InterfaceClass = *(const GUID*)EventCategoryData;
+	notification->Callback = CallbackRoutine;
+	notification->Context = Context;
+	*NotificationEntry = notification;
+
+	if ((EventCategoryFlags & PNPNOTIFY_DEVICE_INTERFACE_INCLUDE_EXISTING_INTERFACES) != 0)
+	{
+		for (i = 0; i < HOST_MAX_DEVICE_INTERFACES; i++)
+		{
+			if (gDeviceInterfaces[i].Ops != NULL &&
+				InlineIsEqualGUID(
+					&gDeviceInterfaces[i].InterfaceClass,
+					&notification->InterfaceClass))
+			{
+				HostNotifyDeviceInterface(
+					notification,
+					&gDeviceInterfaces[i],
+					&GUID_DEVICE_INTERFACE_ARRIVAL);
+			}
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+IoUnregisterPlugPlayNotificationEx(
+	IN PVOID NotificationEntry
+)
+{
+	HOST_PNP_NOTIFICATION* notification = (HOST_PNP_NOTIFICATION*)NotificationEntry;
+
+	RtlZeroMemory(notification, sizeof(HOST_PNP_NOTIFICATION));
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+HostRegisterDeviceInterface(
+	IN LPCGUID InterfaceClass,
+	IN PCWSTR SymbolicLinkName,
+	IN const HOST_IO_TARGET_OPS* Ops,
+	IN PVOID Context
+)
+{
+	HOST_DEVICE_INTERFACE* deviceInterface;
+	ULONG i;
+
+	for (i = 0; i < HOST_MAX_DEVICE_INTERFACES; i++)
+	{
+		if (gDeviceInterfaces[i].Ops == NULL)
+		{
+			break;
+		}
+	}
+
+	if (i == HOST_MAX_DEVICE_INTERFACES)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	deviceInterface = &gDeviceInterfaces[i];
+	deviceInterface->InterfaceClass = *InterfaceClass;
+	RtlInitUnicodeString(&deviceInterface->SymbolicLinkName, SymbolicLinkName);
+	deviceInterface->Ops = Ops;
+	deviceInterface->Context = Context;
+
+	for (i = 0; i < HOST_MAX_PNP_NOTIFICATIONS; i++)
+	{
+		if (gPnpNotifications[i].Callback != NULL &&
+			InlineIsEqualGUID(&gPnpNotifications[i].InterfaceClass, InterfaceClass))
+		{
+			HostNotifyDeviceInterface(
+				&gPnpNotifications[i],
+				deviceInterface,
+				&GUID_DEVICE_INTERFACE_ARRIVAL);
+		}
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static HOST_DEVICE_INTERFACE*
+HostLookupDeviceInterface(
+	IN PCUNICODE_STRING SymbolicLinkName
+)
+{
+	ULONG i;
+
+	for (i = 0; i < HOST_MAX_DEVICE_INTERFACES; i++)
+	{
+		if (gDeviceInterfaces[i].Ops != NULL &&
+			gDeviceInterfaces[i].SymbolicLinkName.Length == SymbolicLinkName->Length &&
+			RtlEqualMemory(
+				gDeviceInterfaces[i].SymbolicLinkName.Buffer,
+				SymbolicLinkName->Buffer,
+				SymbolicLinkName->Length))
+		{
+			return &gDeviceInterfaces[i];
+		}
+	}
+
+	return NULL;
+}
+
+VOID
+HostUnregisterDeviceInterface(
+	IN PCWSTR SymbolicLinkName
+)
+/*++
+
+  Routine Description:
+
+	Tells the drivers registered for the interface's class that it is
+	going away, then removes it
+
+--*/
+{
+	HOST_DEVICE_INTERFACE* deviceInterface;
+	UNICODE_STRING name;
+	ULONG i;
+
+	RtlInitUnicodeString(&name, SymbolicLinkName);
+
+	deviceInterface = HostLookupDeviceInterface(&name);
+
+	if (deviceInterface == NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < HOST_MAX_PNP_NOTIFICATIONS; i++)
+	{
+		if (gPnpNotifications[i].Callback != NULL &&
+			InlineIsEqualGUID(
+				&gPnpNotifications[i].InterfaceClass,
+				&deviceInterface->InterfaceClass))
+		{
+			HostNotifyDeviceInterface(
+				&gPnpNotifications[i],
+				deviceInterface,
+				&GUID_DEVICE_INTERFACE_REMOVAL);
+		}
+	}
+
+	RtlZeroMemory(deviceInterface, sizeof(HOST_DEVICE_INTERFACE));
+}
+
+BOOLEAN
+HostFindDeviceInterface(
+	IN PCUNICODE_STRING SymbolicLinkName,
+	OUT const HOST_IO_TARGET_OPS** Ops,
+	OUT PVOID* Context
+)
+{
+	HOST_DEVICE_INTERFACE* deviceInterface;
+
+	deviceInterface = HostLookupDeviceInterface(SymbolicLinkName);
+
+	if (deviceInterface == NULL)
+	{
+		return FALSE;
+	}
+
+	*Ops = deviceInterface->Ops;
+	*Context = deviceInterface->Context;
+
+	return TRUE;
+}
@@ -0,0 +1,957 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		rmi4d.c
+
+	Abstract:
+
+		Linux user-space daemon hosting the RMI4 touch core. It plays the
+		part of the KMDF device: the core is started on a transport,
+		attention is serviced the way OnInterruptIsr services it and the
+		resulting HID reports are handed to a sink.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "debug.h"
+
+//
+// Bound on the reads done for one attention, a controller holding the
+// line forever must not starve the loop
+//
+#define RMI4D_MAX_SERVICE_PASSES 16
+
+typedef enum _RMI4D_SINK_TYPE
+{
+	Rmi4dSinkUinput = 0,
+	Rmi4dSinkMemory
+} RMI4D_SINK_TYPE;
+
+typedef struct _RMI4D_OPTIONS
+{
+	PCSTR I2cPath;
+	ULONG I2cAddress;
+	PCSTR GpioChip;
+	ULONG GpioLine;
+	BOOLEAN Simulate;
+	HOST_SIM_OPTIONS Simulator;
+	RMI4D_SINK_TYPE Sink;
+	PCSTR UinputPath;
+	PCSTR ConfigPath;
+	BOOLEAN Dump;
+	ULONG F54ReportType;
+	ULONG F54Slots;
+	PCSTR F34ImagePath;
+	PCSTR F34ResumePath;
+	PCSTR F34ImageOutPath;
+	ULONG F34Flags;
+} RMI4D_OPTIONS;
+
+typedef struct _RMI4D_CONTEXT
+{
+	WDFDEVICE FxDevice;
+	PDEVICE_EXTENSION DevContext;
+	HOST_ATTENTION Attention;
+	HOST_SINK Sink;
+	int SignalFd;
+	PCSTR ConfigPath;
+	BOOLEAN Simulate;
+
+	//
+	// Interrupts serviced and the time spent in the core servicing them
+	// and sending their reports, in 100 ns units
+	//
+	ULONG ServiceCount;
+	ULONG64 ServiceTime;
+} RMI4D_CONTEXT;
+
+static VOID
+Rmi4dServiceInterrupts(
+	IN RMI4D_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Services the controller the way OnInterruptIsr does, once
+
+--*/
+{
+	PDEVICE_EXTENSION devContext = Context->DevContext;
+	PHID_INPUT_REPORT hidReports;
+	int hidReportsCount = 0;
+	ULONG64 startTime = KeQueryInterruptTime();
+	NTSTATUS status;
+
+	status = TchServiceInterrupts(
+		devContext->TouchContext,
+		&devContext->SpbContext,
+		devContext->InputMode,
+		&hidReports,
+		&hidReportsCount);
+
+	if (NT_SUCCESS(status))
+	{
+		SendHidReports(
+			devContext->PingPongQueue,
+			hidReports,
+			hidReportsCount);
+	}
+
+	Context->ServiceTime += KeQueryInterruptTime() - startTime;
+	Context->ServiceCount++;
+}
+
+static VOID
+Rmi4dOnAttention(
+	IN PVOID Context,
+	IN ULONG Events
+)
+{
+	RMI4D_CONTEXT* context = (RMI4D_CONTEXT*)Context;
+	HOST_ATTENTION* attention = &context->Attention;
+	ULONG pass;
+
+	UNREFERENCED_PARAMETER(Events);
+
+	attention->Ops->Acknowledge(attention);
+
+	//
+	// ATTN is level triggered, keep servicing while it is held
+	//
+	pass = 0;
+
+	do
+	{
+		Rmi4dServiceInterrupts(context);
+		pass++;
+	} while (attention->Ops->Asserted(attention) &&
+		pass < RMI4D_MAX_SERVICE_PASSES);
+}
+
+static VOID
+Rmi4dReloadConfiguration(
+	IN RMI4D_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Reads the configuration file again and has the core publish it, the
+	equivalent of IOCTL_TOUCH_DIAG_RELOAD_CONFIG. Values the file no
+	longer sets keep the value they were loaded with.
+
+--*/
+{
+	ULONG version;
+	ULONG flags;
+	NTSTATUS status;
+
+	if (Context->ConfigPath != NULL)
+	{
+		status = HostRegistryLoadFile(Context->ConfigPath);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Could not read %s again - STATUS:%X",
+				Context->ConfigPath,
+				status);
+
+			return;
+		}
+	}
+
+	status = TchReloadConfiguration(
+		Context->DevContext->TouchContext,
+		&Context->DevContext->SpbContext,
+		&version,
+		&flags);
+
+	if (NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Reloaded configuration %u, registers %s",
+			version,
+			(flags & TCH_CONFIG_REGISTERS_PENDING) ? "pending" :
+			(flags & TCH_CONFIG_REGISTERS_CHANGED) ? "written" : "unchanged");
+	}
+}
+
+static VOID
+Rmi4dOnSignal(
+	IN PVOID Context,
+	IN ULONG Events
+)
+{
+	RMI4D_CONTEXT* context = (RMI4D_CONTEXT*)Context;
+	struct signalfd_siginfo info;
+
+	UNREFERENCED_PARAMETER(Events);
+
+	if (read(context->SignalFd, &info, sizeof(info)) != sizeof(info))
+	{
+		return;
+	}
+
+	if (info.ssi_signo == SIGHUP)
+	{
+		Rmi4dReloadConfiguration(context);
+		return;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Stopping on signal %u",
+		info.ssi_signo);
+
+	HostLoopStop();
+}
+
+static VOID
+Rmi4dTraceStartTimeline(
+	IN PDEVICE_EXTENSION DevContext
+)
+/*++
+
+  Routine Description:
+
+	Logs the start timeline the diagnostic interface reports, in
+	microseconds from the start of the equivalent of OnPrepareHardware
+
+--*/
+{
+	static const PCSTR PhaseNames[TchStartPhaseCount] =
+	{
+		"prepare hardware",
+		"transport",
+		"settings",
+		"topology",
+		"configured",
+		"report descriptor",
+		"D0 entry",
+		"work item",
+		"backlight",
+		"display callback",
+		"complete"
+	};
+	ULONG64 startTime;
+	ULONG i;
+
+	startTime = DevContext->StartPhaseTime[TchStartPhasePrepareHardware];
+
+	for (i = 0; i < TchStartPhaseCount; i++)
+	{
+		if (DevContext->StartPhaseTime[i] == 0)
+		{
+			continue;
+		}
+
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Start phase %-17s %6llu us",
+			PhaseNames[i],
+			(unsigned long long)((DevContext->StartPhaseTime[i] - startTime) / 10));
+	}
+}
+
+static VOID
+Rmi4dUsage(
+	IN PCSTR Program
+)
+{
+	fprintf(
+		stderr,
+		"usage: %s [options]\n"
+		"  --i2c DEV          I2C adapter the controller is on, e.g. /dev/i2c-1\n"
+		"  --address N        7 bit controller address (default 0x20)\n"
+		"  --gpio CHIP        GPIO chip of the attention line, e.g. /dev/gpiochip0\n"
+		"  --line N           attention line offset\n"
+		"  --simulate         run against the simulated controller\n"
+		"  --script FILE      gesture played by the simulator\n"
+		"  --firmware-build N firmware build the simulator reports\n"
+		"  --bus i2c|spi      reach the simulator through the driver's\n"
+		"                     I2C or SPI transport\n"
+		"  --touch f11|f12    2D sensor function of the simulator\n"
+		"  --objects N        objects the simulated F12 reports (default 10)\n"
+		"  --buttons          give the simulator F1A capacitive buttons\n"
+		"  --sink=uinput|memory  where reports go (default uinput)\n"
+		"  --uinput DEV       uinput device (default /dev/uinput)\n"
+		"  --dump             print the reports kept by the memory sink\n"
+		"  --config FILE      load Name=Value settings, read again on SIGHUP\n"
+		"  --state FILE       keep values written by the driver, such as\n"
+		"                     the controller topology, across runs\n"
+		"  --set NAME=VALUE   set one setting\n"
+		"  --f54 TYPE         capture F54 reports of TYPE while running\n"
+		"  --f54-slots N      frames the capture ring holds (default 4)\n"
+		"  --f34 FILE         flash the firmware image FILE once started\n"
+		"  --f34-config-only  only flash the configuration area\n"
+		"  --f34-resume FILE  resume a failed update once from FILE\n"
+		"  --f34-fail-block N fail the first write of simulated firmware\n"
+		"                     block N, counting from 1\n"
+		"  --write-f34-image FILE  write an image for the simulator and exit\n"
+		"  -v                 verbose tracing\n",
+		Program);
+}
+
+static NTSTATUS
+Rmi4dParseOptions(
+	IN int argc,
+	IN char** argv,
+	OUT RMI4D_OPTIONS* Options
+)
+{
+	PSTR separator;
+	NTSTATUS status = STATUS_SUCCESS;
+	int i;
+
+	RtlZeroMemory(Options, sizeof(RMI4D_OPTIONS));
+	Options->I2cAddress = 0x20;
+	Options->UinputPath = "/dev/uinput";
+	Options->F54Slots = 4;
+
+	for (i = 1; i < argc && NT_SUCCESS(status); i++)
+	{
+		PCSTR option = argv[i];
+		PCSTR value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(option, "--simulate") == 0)
+		{
+			Options->Simulate = TRUE;
+			continue;
+		}
+		else if (strcmp(option, "--dump") == 0)
+		{
+			Options->Dump = TRUE;
+			continue;
+		}
+		else if (strcmp(option, "-v") == 0)
+		{
+			HostSetVerbose(TRUE);
+			continue;
+		}
+		else if (strcmp(option, "--sink=uinput") == 0)
+		{
+			Options->Sink = Rmi4dSinkUinput;
+			continue;
+		}
+		else if (strcmp(option, "--sink=memory") == 0)
+		{
+			Options->Sink = Rmi4dSinkMemory;
+			continue;
+		}
+		else if (strcmp(option, "--buttons") == 0)
+		{
+			Options->Simulator.Buttons = TRUE;
+			continue;
+		}
+		else if (strcmp(option, "--f34-config-only") == 0)
+		{
+			Options->F34Flags |= RMI4_F34_FLASH_CONFIG_ONLY;
+			continue;
+		}
+
+		//
+		// The remaining options take a value
+		//
+		if (value == NULL)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		i++;
+
+		if (strcmp(option, "--i2c") == 0)
+		{
+			Options->I2cPath = value;
+		}
+		else if (strcmp(option, "--address") == 0)
+		{
+			Options->I2cAddress = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--gpio") == 0)
+		{
+			Options->GpioChip = value;
+		}
+		else if (strcmp(option, "--line") == 0)
+		{
+			Options->GpioLine = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--script") == 0)
+		{
+			Options->Simulator.ScriptPath = value;
+		}
+		else if (strcmp(option, "--firmware-build") == 0)
+		{
+			Options->Simulator.FirmwareBuild = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--bus") == 0)
+		{
+			if (strcmp(value, "i2c") == 0)
+			{
+				Options->Simulator.Bus = HostSimBusI2c;
+			}
+			else if (strcmp(value, "spi") == 0)
+			{
+				Options->Simulator.Bus = HostSimBusSpi;
+			}
+			else
+			{
+				status = STATUS_INVALID_PARAMETER;
+			}
+		}
+		else if (strcmp(option, "--touch") == 0)
+		{
+			if (strcmp(value, "f11") == 0)
+			{
+				Options->Simulator.Touch = HostSimTouchF11;
+			}
+			else if (strcmp(value, "f12") == 0)
+			{
+				Options->Simulator.Touch = HostSimTouchF12;
+			}
+			else
+			{
+				status = STATUS_INVALID_PARAMETER;
+			}
+		}
+		else if (strcmp(option, "--objects") == 0)
+		{
+			Options->Simulator.Objects = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--f54") == 0)
+		{
+			Options->F54ReportType = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--f54-slots") == 0)
+		{
+			Options->F54Slots = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--f34") == 0)
+		{
+			Options->F34ImagePath = value;
+		}
+		else if (strcmp(option, "--f34-resume") == 0)
+		{
+			Options->F34ResumePath = value;
+		}
+		else if (strcmp(option, "--f34-fail-block") == 0)
+		{
+			Options->Simulator.F34FailBlock = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--write-f34-image") == 0)
+		{
+			Options->F34ImageOutPath = value;
+		}
+		else if (strcmp(option, "--uinput") == 0)
+		{
+			Options->UinputPath = value;
+		}
+		else if (strcmp(option, "--config") == 0)
+		{
+			status = HostRegistryLoadFile(value);
+			Options->ConfigPath = value;
+		}
+		else if (strcmp(option, "--state") == 0)
+		{
+			status = HostRegistryLoadState(value);
+		}
+		else if (strcmp(option, "--set") == 0)
+		{
+			CHAR setting[128];
+
+			strncpy(setting, value, sizeof(setting) - 1);
+			setting[sizeof(setting) - 1] = '\0';
+			separator = strchr(setting, '=');
+
+			if (separator == NULL)
+			{
+				status = STATUS_INVALID_PARAMETER;
+			}
+			else
+			{
+				*separator = '\0';
+				status = HostRegistrySetValue(setting, separator + 1);
+			}
+		}
+		else
+		{
+			status = STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	if (NT_SUCCESS(status) &&
+		!Options->Simulate &&
+		(Options->I2cPath == NULL || Options->GpioChip == NULL))
+	{
+		status = STATUS_INVALID_PARAMETER;
+	}
+
+	return status;
+}
+
+static NTSTATUS
+Rmi4dFlash(
+	IN RMI4D_CONTEXT* Context,
+	IN const RMI4D_OPTIONS* Options
+)
+/*++
+
+  Routine Description:
+
+	Flashes the controller and restarts it through the regular start
+	path, as TchDiagF34Flash does. Against the simulator the rate the
+	update would reach on a 400 kHz I2C bus is traced as well, it is
+	not bounded by the bus on the direct path.
+
+--*/
+{
+	PDEVICE_EXTENSION devContext = Context->DevContext;
+	RMI4_CONTROLLER_CONTEXT* controller = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+	ULONG64 busTimeBefore = 0;
+	ULONG64 busTime;
+	ULONG transfersBefore = 0;
+	ULONG transfers;
+	ULONG blocks;
+	NTSTATUS status;
+
+	if (Options->Simulate)
+	{
+		HostSimGetBusStatistics(&devContext->SpbContext, &transfersBefore, &busTimeBefore);
+	}
+
+	status = HostF34Flash(
+		controller,
+		&devContext->SpbContext,
+		Options->F34ImagePath,
+		Options->F34Flags,
+		Options->F34ResumePath);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (Options->Simulate)
+	{
+		HostSimGetBusStatistics(&devContext->SpbContext, &transfers, &busTime);
+
+		transfers -= transfersBefore;
+		busTime -= busTimeBefore;
+		blocks = controller->F34Flash.BytesWritten / controller->F34Flash.Query.BlockSize;
+
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"F34 update made %u bus transfers, %llu us of 400 kHz I2C, %llu blocks per second",
+			transfers,
+			(unsigned long long)busTime,
+			(unsigned long long)((busTime != 0) ? blocks * 1000000ULL / busTime : 0));
+	}
+
+	TchStopDevice(controller, &devContext->SpbContext);
+
+	status = TchStartDevice(controller, &devContext->SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error restarting touch device after update - STATUS:%X",
+			status);
+	}
+
+exit:
+	return status;
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	RMI4D_CONTEXT context;
+	RMI4D_OPTIONS options;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	HOST_SINK_PROPERTIES sinkProperties;
+	RMI4_CONTROLLER_CONTEXT* controller = NULL;
+	HOST_F54_CAPTURE* capture = NULL;
+	ULONG64 startTime;
+	ULONG64 busTime;
+	ULONG transfers;
+	BOOLEAN started = FALSE;
+	sigset_t signals;
+	NTSTATUS status;
+	int exitCode = EXIT_FAILURE;
+
+	RtlZeroMemory(&context, sizeof(context));
+	context.Attention.Fd = -1;
+	context.SignalFd = -1;
+
+	status = Rmi4dParseOptions(argc, argv, &options);
+
+	if (!NT_SUCCESS(status))
+	{
+		Rmi4dUsage(argv[0]);
+		goto exit;
+	}
+
+	context.Simulate = options.Simulate;
+	context.ConfigPath = options.ConfigPath;
+
+	if (options.F34ImageOutPath != NULL)
+	{
+		status = HostSimWriteF34Image(options.Simulator.Touch, options.F34ImageOutPath);
+
+		if (NT_SUCCESS(status))
+		{
+			exitCode = EXIT_SUCCESS;
+		}
+
+		goto exit;
+	}
+
+	status = HostLoopInitialize();
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, DEVICE_EXTENSION);
+
+	status = HostDeviceCreate(&attributes, &context.FxDevice);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	context.DevContext = GetDeviceContext(context.FxDevice);
+	context.DevContext->FxDevice = context.FxDevice;
+	context.DevContext->InputMode = MODE_MULTI_TOUCH;
+
+	TchMarkStartPhase(context.FxDevice, TchStartPhasePrepareHardware);
+
+	//
+	// Open the transport and attention line, what OnPrepareHardware
+	// does with the SPB and interrupt resources
+	//
+	if (options.Simulate)
+	{
+		status = HostSimOpen(
+			&options.Simulator,
+			&context.DevContext->SpbContext,
+			&context.Attention);
+	}
+	else
+	{
+		status = HostI2cDevOpen(
+			options.I2cPath,
+			options.I2cAddress,
+			&context.DevContext->SpbContext);
+
+		if (NT_SUCCESS(status))
+		{
+			status = HostGpioOpenAttention(
+				options.GpioChip,
+				options.GpioLine,
+				&context.Attention);
+		}
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	TchMarkStartPhase(context.FxDevice, TchStartPhaseTransport);
+
+	status = TchAllocateContext(
+		&context.DevContext->TouchContext,
+		context.FxDevice);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = TchRegistryGetControllerSettings(context.DevContext->TouchContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error retrieving controller settings - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	TchMarkStartPhase(context.FxDevice, TchStartPhaseSettings);
+
+	startTime = KeQueryInterruptTime();
+
+	status = TchStartDevice(
+		context.DevContext->TouchContext,
+		&context.DevContext->SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not start the controller - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	started = TRUE;
+	controller = (RMI4_CONTROLLER_CONTEXT*)context.DevContext->TouchContext;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Controller started in %llu us, topology %s",
+		(unsigned long long)((KeQueryInterruptTime() - startTime) / 10),
+		controller->Setup->TopologyCached ? "persisted" : "discovered");
+
+	if (options.Simulate)
+	{
+		HostSimGetBusStatistics(
+			&context.DevContext->SpbContext,
+			&transfers,
+			&busTime);
+
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Start made %u bus transfers, %llu us of 400 kHz I2C",
+			transfers,
+			(unsigned long long)busTime);
+	}
+
+	if (options.F34ImagePath != NULL)
+	{
+		status = Rmi4dFlash(&context, &options);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	//
+	// Reports are scaled to the viewable display area
+	//
+	sinkProperties.Width = controller->Config->Props.DisplayViewableWidth;
+	sinkProperties.Height = controller->Config->Props.DisplayViewableHeight;
+	sinkProperties.MaxContacts = controller->MaxFingers;
+
+	if (options.Sink == Rmi4dSinkMemory)
+	{
+		status = HostMemorySinkOpen(&sinkProperties, options.Dump, &context.Sink);
+	}
+	else
+	{
+		status = HostUinputSinkOpen(options.UinputPath, &sinkProperties, &context.Sink);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = HostQueueCreate(
+		context.FxDevice,
+		&context.Sink,
+		&context.DevContext->PingPongQueue);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	sigaddset(&signals, SIGHUP);
+	sigprocmask(SIG_BLOCK, &signals, NULL);
+
+	context.SignalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+
+	if (context.SignalFd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	status = HostLoopAdd(context.SignalFd, EPOLLIN, Rmi4dOnSignal, &context);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = HostLoopAdd(context.Attention.Fd, EPOLLIN, Rmi4dOnAttention, &context);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	//
+	// Like ServiceInterruptsAfterD0Entry, the line may have been asserted
+	// before it was being watched
+	//
+	if (context.Attention.Ops->Asserted(&context.Attention))
+	{
+		Rmi4dServiceInterrupts(&context);
+	}
+
+	TchMarkStartPhase(context.FxDevice, TchStartPhaseD0Entry);
+
+	if (options.F54ReportType != 0)
+	{
+		status = HostF54CaptureStart(
+			controller,
+			options.F54ReportType,
+			options.F54Slots,
+			&capture);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	status = HostLoopRun();
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	exitCode = EXIT_SUCCESS;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REPORTING,
+		"Serviced %u interrupts with %u contact slots, %llu ns each",
+		context.ServiceCount,
+		(ULONG)controller->SlotCapacity,
+		(unsigned long long)((context.ServiceCount != 0) ?
+			context.ServiceTime * 100 / context.ServiceCount : 0));
+
+	if (capture != NULL)
+	{
+		status = HostF54CaptureStop(controller, capture);
+		capture = NULL;
+
+		if (!NT_SUCCESS(status))
+		{
+			exitCode = EXIT_FAILURE;
+		}
+	}
+
+	if (options.Simulate &&
+		options.Sink == Rmi4dSinkMemory &&
+		HostMemorySinkGetCount(&context.Sink) == 0)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REPORTING,
+			"The simulated gesture produced no reports");
+
+		exitCode = EXIT_FAILURE;
+	}
+
+exit:
+
+	if (capture != NULL)
+	{
+		(VOID)HostF54CaptureStop(controller, capture);
+	}
+
+	if (context.Attention.Fd >= 0)
+	{
+		HostLoopRemove(context.Attention.Fd);
+	}
+
+	if (context.SignalFd >= 0)
+	{
+		HostLoopRemove(context.SignalFd);
+		close(context.SignalFd);
+	}
+
+	if (context.DevContext != NULL)
+	{
+		if (started)
+		{
+			TchStopDevice(
+				context.DevContext->TouchContext,
+				&context.DevContext->SpbContext);
+
+			Rmi4dTraceStartTimeline(context.DevContext);
+		}
+
+		if (context.DevContext->TouchContext != NULL)
+		{
+			TchFreeContext(context.DevContext->TouchContext);
+		}
+
+		if (context.Sink.Ops != NULL)
+		{
+			context.Sink.Ops->Close(&context.Sink);
+		}
+
+		if (context.Attention.Ops != NULL)
+		{
+			context.Attention.Ops->Close(&context.Attention);
+		}
+
+		if (options.Simulate)
+		{
+			HostSimClose(&context.DevContext->SpbContext);
+		}
+		else
+		{
+			HostI2cDevClose(&context.DevContext->SpbContext);
+		}
+	}
+
+	WdfObjectDelete(context.FxDevice);
+	HostLoopDeinitialize();
+	HostRegistryClear();
+
+	return exitCode;
+}
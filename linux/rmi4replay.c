@@ -0,0 +1,625 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		rmi4replay.c
+
+	Abstract:
+
+		Replays a captured contact trace through the core's contact filter
+		and predictor and measures how far the reported positions are from
+		where each contact actually was one prediction horizon later, how
+		much they move from one frame to the next, and what the two stages
+		cost per sample.
+
+		Traces use the gesture script format: one frame per line, each a
+		list of slot:x:y contacts in sensor units. A line may start with @
+		and the scan time of the frame in ms, lines without one follow the
+		previous frame by the frame interval.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "contactfilter.h"
+#include "contactpredictor.h"
+#include "debug.h"
+
+#define REPLAY_MAX_SLOTS        RMI4_F11_MAX_FINGERS
+#define REPLAY_DEFAULT_INTERVAL 10.0
+#define REPLAY_DEFAULT_HORIZON  12
+
+//
+// The trace is played this many more times to time the stages
+//
+#define REPLAY_BENCHMARK_PASSES 200
+
+typedef struct _REPLAY_FRAME
+{
+	ULONG Time;
+	BOOLEAN Present[REPLAY_MAX_SLOTS];
+	USHORT X[REPLAY_MAX_SLOTS];
+	USHORT Y[REPLAY_MAX_SLOTS];
+} REPLAY_FRAME;
+
+typedef struct _REPLAY_ERROR
+{
+	ULONG Count;
+	double Sum;
+	double SumSquares;
+	double Max;
+} REPLAY_ERROR;
+
+typedef struct _REPLAY_STATE
+{
+	RMI4_FILTER_STATE Filter[REPLAY_MAX_SLOTS];
+	RMI4_PREDICTOR_STATE Predictor[REPLAY_MAX_SLOTS];
+	BOOLEAN Tracked[REPLAY_MAX_SLOTS];
+	USHORT ReportedX[REPLAY_MAX_SLOTS];
+	USHORT ReportedY[REPLAY_MAX_SLOTS];
+	USHORT PredictedX[REPLAY_MAX_SLOTS];
+	USHORT PredictedY[REPLAY_MAX_SLOTS];
+} REPLAY_STATE;
+
+typedef struct _REPLAY_OPTIONS
+{
+	PCSTR TracePath;
+	double Interval;
+	BOOLEAN Filter;
+	RMI4_FILTER_SETTINGS FilterSettings;
+	RMI4_PREDICTOR_SETTINGS PredictorSettings;
+} REPLAY_OPTIONS;
+
+static NTSTATUS
+ReplayLoadTrace(
+	IN PCSTR Path,
+	IN double Interval,
+	OUT REPLAY_FRAME** Frames,
+	OUT PULONG FrameCount
+)
+/*++
+
+  Routine Description:
+
+	Loads a trace into an array of frames with scan times in 100us
+	units, the unit the core works in
+
+--*/
+{
+	CHAR line[512];
+	REPLAY_FRAME* frames = NULL;
+	REPLAY_FRAME* grown;
+	REPLAY_FRAME* frame;
+	ULONG count = 0;
+	ULONG capacity = 0;
+	ULONG lineNumber = 0;
+	double time = 0.0;
+	double stamp;
+	unsigned int slot;
+	unsigned int x;
+	unsigned int y;
+	int consumed;
+	PSTR cursor;
+	FILE* file;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	file = fopen(Path, "r");
+
+	if (file == NULL)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lineNumber++;
+
+		if (line[0] == '#' || line[0] == '!')
+		{
+			continue;
+		}
+
+		if (count == capacity)
+		{
+			capacity = max(capacity * 2, 256);
+			grown = (REPLAY_FRAME*)realloc(frames, capacity * sizeof(REPLAY_FRAME));
+
+			if (grown == NULL)
+			{
+				status = STATUS_INSUFFICIENT_RESOURCES;
+				break;
+			}
+
+			frames = grown;
+		}
+
+		frame = &frames[count];
+		RtlZeroMemory(frame, sizeof(REPLAY_FRAME));
+
+		consumed = 0;
+		cursor = line;
+
+		if (sscanf(line, " @%lf%n", &stamp, &consumed) == 1)
+		{
+			time = stamp;
+			cursor += consumed;
+		}
+		else if (count != 0)
+		{
+			time += Interval;
+		}
+
+		frame->Time = (ULONG)(time * RMI4_PREDICTOR_TICKS_PER_MS + 0.5);
+
+		for (;
+			sscanf(cursor, " %u:%u:%u%n", &slot, &x, &y, &consumed) == 3;
+			cursor += consumed)
+		{
+			if (slot >= REPLAY_MAX_SLOTS || x > MAXUSHORT || y > MAXUSHORT)
+			{
+				status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+
+			frame->Present[slot] = TRUE;
+			frame->X[slot] = (USHORT)x;
+			frame->Y[slot] = (USHORT)y;
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Invalid trace line %s:%u - STATUS:%X",
+				Path,
+				lineNumber,
+				status);
+
+			break;
+		}
+
+		count++;
+	}
+
+	fclose(file);
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		free(frames);
+		frames = NULL;
+		count = 0;
+	}
+
+	*Frames = frames;
+	*FrameCount = count;
+
+	return status;
+}
+
+static BOOLEAN
+ReplayPositionAt(
+	IN const REPLAY_FRAME* Frames,
+	IN ULONG FrameCount,
+	IN ULONG First,
+	IN ULONG Slot,
+	IN ULONG Time,
+	OUT double* X,
+	OUT double* Y
+)
+/*++
+
+  Routine Description:
+
+	Finds where the contact in Slot of frame First was at Time, by
+	linear interpolation between the frames around it. Fails when the
+	contact lifts or the trace ends before Time.
+
+--*/
+{
+	ULONG j;
+	double t;
+
+	for (j = First + 1; j < FrameCount && Frames[j].Present[Slot]; j++)
+	{
+		if ((LONG)(Frames[j].Time - Time) >= 0)
+		{
+			t = (double)(Time - Frames[j - 1].Time) /
+				(double)max(Frames[j].Time - Frames[j - 1].Time, 1);
+
+			*X = Frames[j - 1].X[Slot] + t * ((double)Frames[j].X[Slot] - Frames[j - 1].X[Slot]);
+			*Y = Frames[j - 1].Y[Slot] + t * ((double)Frames[j].Y[Slot] - Frames[j - 1].Y[Slot]);
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static VOID
+ReplayAddError(
+	IN OUT REPLAY_ERROR* Error,
+	IN double X,
+	IN double Y,
+	IN double TruthX,
+	IN double TruthY
+)
+{
+	double distance = hypot(X - TruthX, Y - TruthY);
+
+	Error->Count++;
+	Error->Sum += distance;
+	Error->SumSquares += distance * distance;
+	Error->Max = fmax(Error->Max, distance);
+}
+
+static VOID
+ReplayPrintError(
+	IN PCSTR Name,
+	IN const REPLAY_ERROR* Error
+)
+{
+	ULONG count = max(Error->Count, 1);
+
+	printf(
+		"%-10s %10.2f %10.2f %10.2f\n",
+		Name,
+		Error->Sum / count,
+		sqrt(Error->SumSquares / count),
+		Error->Max);
+}
+
+static VOID
+ReplayFrame(
+	IN const REPLAY_OPTIONS* Options,
+	IN const RMI4_FILTER_PARAMETERS* FilterParameters,
+	IN const RMI4_PREDICTOR_PARAMETERS* PredictorParameters,
+	IN const REPLAY_FRAME* Frame,
+	IN OUT REPLAY_STATE* State
+)
+/*++
+
+  Routine Description:
+
+	Runs the contacts of a frame through the same stages as
+	RmiGetTouchesFromController, leaving the filtered and the predicted
+	position of each contact in State
+
+--*/
+{
+	USHORT x;
+	USHORT y;
+	ULONG s;
+
+	for (s = 0; s < REPLAY_MAX_SLOTS; s++)
+	{
+		if (!Frame->Present[s])
+		{
+			State->Tracked[s] = FALSE;
+			State->Predictor[s].Samples = 0;
+			continue;
+		}
+
+		x = Frame->X[s];
+		y = Frame->Y[s];
+
+		if (!State->Tracked[s])
+		{
+			RmiFilterStart(&State->Filter[s], x, y, Frame->Time);
+			State->Tracked[s] = TRUE;
+		}
+		else if (Options->Filter)
+		{
+			RmiFilterSample(FilterParameters, &State->Filter[s], &x, &y, Frame->Time);
+		}
+
+		State->ReportedX[s] = x;
+		State->ReportedY[s] = y;
+
+		RmiPredictorSample(PredictorParameters, &State->Predictor[s], &x, &y, Frame->Time);
+
+		State->PredictedX[s] = x;
+		State->PredictedY[s] = y;
+	}
+}
+
+static VOID
+ReplayUsage(
+	IN PCSTR Program
+)
+{
+	fprintf(
+		stderr,
+		"usage: %s [options] TRACE\n"
+		"  --interval MS         frame period of lines without a time (default 10)\n"
+		"  --horizon MS          prediction horizon (default 12)\n"
+		"  --max-distance N      ContactPredictionMaxDistance\n"
+		"  --min-speed N         ContactPredictionMinSpeed\n"
+		"  --min-cutoff MHZ      ContactFilterMinCutoff\n"
+		"  --beta N              ContactFilterBeta\n"
+		"  --derivative-cutoff MHZ  ContactFilterDerivativeCutoff\n"
+		"  --no-filter           predict from the trace positions\n"
+		"  -v                    verbose tracing\n",
+		Program);
+}
+
+static NTSTATUS
+ReplayParseOptions(
+	IN int argc,
+	IN char** argv,
+	OUT REPLAY_OPTIONS* Options
+)
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	int i;
+
+	RtlZeroMemory(Options, sizeof(REPLAY_OPTIONS));
+	Options->Interval = REPLAY_DEFAULT_INTERVAL;
+	Options->Filter = TRUE;
+	Options->FilterSettings.Enable = 1;
+	Options->FilterSettings.MinCutoff = RMI4_FILTER_DEFAULT_MIN_CUTOFF;
+	Options->FilterSettings.Beta = RMI4_FILTER_DEFAULT_BETA;
+	Options->FilterSettings.DerivativeCutoff = RMI4_FILTER_DEFAULT_DERIVATIVE_CUTOFF;
+	Options->PredictorSettings.Horizon = REPLAY_DEFAULT_HORIZON;
+	Options->PredictorSettings.MaxDistance = RMI4_PREDICTOR_DEFAULT_MAX_DISTANCE;
+	Options->PredictorSettings.MinSpeed = RMI4_PREDICTOR_DEFAULT_MIN_SPEED;
+
+	for (i = 1; i < argc && NT_SUCCESS(status); i++)
+	{
+		PCSTR option = argv[i];
+		PCSTR value = (i + 1 < argc) ? argv[i + 1] : NULL;
+
+		if (strcmp(option, "--no-filter") == 0)
+		{
+			Options->Filter = FALSE;
+			continue;
+		}
+		else if (strcmp(option, "-v") == 0)
+		{
+			HostSetVerbose(TRUE);
+			continue;
+		}
+		else if (option[0] != '-')
+		{
+			if (Options->TracePath != NULL)
+			{
+				status = STATUS_INVALID_PARAMETER;
+			}
+
+			Options->TracePath = option;
+			continue;
+		}
+
+		//
+		// The remaining options take a value
+		//
+		if (value == NULL)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			break;
+		}
+
+		i++;
+
+		if (strcmp(option, "--interval") == 0)
+		{
+			Options->Interval = strtod(value, NULL);
+		}
+		else if (strcmp(option, "--horizon") == 0)
+		{
+			Options->PredictorSettings.Horizon = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--max-distance") == 0)
+		{
+			Options->PredictorSettings.MaxDistance = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--min-speed") == 0)
+		{
+			Options->PredictorSettings.MinSpeed = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--min-cutoff") == 0)
+		{
+			Options->FilterSettings.MinCutoff = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--beta") == 0)
+		{
+			Options->FilterSettings.Beta = strtoul(value, NULL, 0);
+		}
+		else if (strcmp(option, "--derivative-cutoff") == 0)
+		{
+			Options->FilterSettings.DerivativeCutoff = strtoul(value, NULL, 0);
+		}
+		else
+		{
+			status = STATUS_INVALID_PARAMETER;
+		}
+	}
+
+	if (NT_SUCCESS(status) && Options->TracePath == NULL)
+	{
+		status = STATUS_INVALID_PARAMETER;
+	}
+
+	return status;
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	REPLAY_OPTIONS options;
+	REPLAY_FRAME* frames = NULL;
+	ULONG frameCount = 0;
+	RMI4_FILTER_PARAMETERS filterParameters;
+	RMI4_PREDICTOR_PARAMETERS predictorParameters;
+	REPLAY_STATE state;
+	REPLAY_ERROR traceError;
+	REPLAY_ERROR reportedError;
+	REPLAY_ERROR predictedError;
+	REPLAY_ERROR traceJitter;
+	REPLAY_ERROR reportedJitter;
+	const REPLAY_FRAME* frame;
+	const REPLAY_FRAME* last;
+	struct timespec begin;
+	struct timespec end;
+	double elapsed;
+	double truthX;
+	double truthY;
+	USHORT lastX[REPLAY_MAX_SLOTS];
+	USHORT lastY[REPLAY_MAX_SLOTS];
+	BOOLEAN down[REPLAY_MAX_SLOTS];
+	ULONG64 samples = 0;
+	ULONG pass;
+	ULONG k;
+	ULONG s;
+	NTSTATUS status;
+
+	status = ReplayParseOptions(argc, argv, &options);
+
+	if (!NT_SUCCESS(status))
+	{
+		ReplayUsage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	status = ReplayLoadTrace(
+		options.TracePath,
+		options.Interval,
+		&frames,
+		&frameCount);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not load trace %s - STATUS:%X",
+			options.TracePath,
+			status);
+
+		return EXIT_FAILURE;
+	}
+
+	RmiFilterCompile(&options.FilterSettings, &filterParameters);
+	RmiPredictorCompile(&options.PredictorSettings, &predictorParameters);
+
+	RtlZeroMemory(&state, sizeof(state));
+	RtlZeroMemory(down, sizeof(down));
+	RtlZeroMemory(&traceError, sizeof(traceError));
+	RtlZeroMemory(&reportedError, sizeof(reportedError));
+	RtlZeroMemory(&predictedError, sizeof(predictedError));
+	RtlZeroMemory(&traceJitter, sizeof(traceJitter));
+	RtlZeroMemory(&reportedJitter, sizeof(reportedJitter));
+
+	//
+	// Each output is compared against the trace one horizon later, and
+	// against the output of the previous frame for the same contact
+	//
+	for (k = 0; k < frameCount; k++)
+	{
+		frame = &frames[k];
+		last = &frames[(k != 0) ? k - 1 : 0];
+
+		ReplayFrame(&options, &filterParameters, &predictorParameters, frame, &state);
+
+		for (s = 0; s < REPLAY_MAX_SLOTS; s++)
+		{
+			if (!frame->Present[s])
+			{
+				down[s] = FALSE;
+				continue;
+			}
+
+			samples++;
+
+			if (down[s])
+			{
+				ReplayAddError(&traceJitter, frame->X[s], frame->Y[s], last->X[s], last->Y[s]);
+				ReplayAddError(&reportedJitter, state.ReportedX[s], state.ReportedY[s], lastX[s], lastY[s]);
+			}
+
+			down[s] = TRUE;
+			lastX[s] = state.ReportedX[s];
+			lastY[s] = state.ReportedY[s];
+
+			if (!ReplayPositionAt(
+					frames,
+					frameCount,
+					k,
+					s,
+					frame->Time + predictorParameters.Horizon,
+					&truthX,
+					&truthY))
+			{
+				continue;
+			}
+
+			ReplayAddError(&traceError, frame->X[s], frame->Y[s], truthX, truthY);
+			ReplayAddError(&reportedError, state.ReportedX[s], state.ReportedY[s], truthX, truthY);
+			ReplayAddError(&predictedError, state.PredictedX[s], state.PredictedY[s], truthX, truthY);
+		}
+	}
+
+	//
+	// Time the stages alone over more passes of the trace
+	//
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (pass = 0; pass < REPLAY_BENCHMARK_PASSES; pass++)
+	{
+		RtlZeroMemory(&state, sizeof(state));
+
+		for (k = 0; k < frameCount; k++)
+		{
+			ReplayFrame(&options, &filterParameters, &predictorParameters, &frames[k], &state);
+		}
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	elapsed = (end.tv_sec - begin.tv_sec) * 1e9 + (end.tv_nsec - begin.tv_nsec);
+
+	printf(
+		"%u frames, %u samples, horizon %u ms, filter %s\n",
+		frameCount,
+		predictedError.Count,
+		predictorParameters.Horizon / RMI4_PREDICTOR_TICKS_PER_MS,
+		options.Filter ? "on" : "off");
+
+	printf("%-10s %10s %10s %10s\n", "error", "mean", "rms", "max");
+	ReplayPrintError("trace", &traceError);
+	ReplayPrintError("reported", &reportedError);
+	ReplayPrintError("predicted", &predictedError);
+
+	printf("%-10s %10s %10s %10s\n", "jitter", "mean", "rms", "max");
+	ReplayPrintError("trace", &traceJitter);
+	ReplayPrintError("reported", &reportedJitter);
+
+	printf(
+		"cost %.1f ns per sample\n",
+		elapsed / (double)max(samples * REPLAY_BENCHMARK_PASSES, 1));
+
+	free(frames);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,114 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		rmi4test.c
+
+	Abstract:
+
+		Runs the unit check suites, all of them or the ones named on the
+		command line, and exits with 1 when a check failed.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmitest.h"
+
+typedef struct _TEST_ENTRY
+{
+	PCSTR Name;
+	TEST_SUITE* Suite;
+} TEST_ENTRY;
+
+static const TEST_ENTRY gSuites[] =
+{
+	{ "backlight", TestBacklight },
+	{ "bitops", TestBitops },
+	{ "bitops-benchmark", TestBitopsBenchmark },
+	{ "f12", TestF12 },
+	{ "luxtable", TestLuxTable },
+	{ "resolutions", TestResolutions },
+	{ "transport", TestTransport },
+};
+
+static ULONG gFailures;
+
+VOID
+TestFail(
+	IN PCSTR File,
+	IN int Line,
+	IN PCSTR Expression
+)
+{
+	fprintf(stderr, "%s:%d: check failed: %s\n", File, Line, Expression);
+	gFailures++;
+}
+
+static BOOLEAN
+TestSelected(
+	IN int argc,
+	IN char** argv,
+	IN PCSTR Name
+)
+{
+	int i;
+
+	if (argc < 2)
+	{
+		return TRUE;
+	}
+
+	for (i = 1; i < argc; i++)
+	{
+		if (strcmp(argv[i], Name) == 0)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+int
+main(
+	int argc,
+	char** argv
+)
+{
+	ULONG failures;
+	ULONG failed = 0;
+	ULONG i;
+
+	for (i = 0; i < ARRAYSIZE(gSuites); i++)
+	{
+		if (!TestSelected(argc, argv, gSuites[i].Name))
+		{
+			continue;
+		}
+
+		failures = gFailures;
+		gSuites[i].Suite();
+
+		if (gFailures == failures)
+		{
+			printf("PASS %s\n", gSuites[i].Name);
+		}
+		else
+		{
+			printf("FAIL %s, %u checks\n", gSuites[i].Name, gFailures - failures);
+			failed++;
+		}
+	}
+
+	return (failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,48 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		rmitest.h
+
+	Abstract:
+
+		Unit checks of core routines that run on the host on their own,
+		without the simulated controller. Each suite is a routine that
+		reports failed checks through TEST_CHECK and carries on.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "host.h"
+
+VOID
+TestFail(
+	IN PCSTR File,
+	IN int Line,
+	IN PCSTR Expression
+);
+
+#define TEST_CHECK(Expression) \
+	((Expression) ? (VOID)0 : TestFail(__FILE__, __LINE__, #Expression))
+
+typedef VOID
+TEST_SUITE(
+	VOID
+);
+
+TEST_SUITE TestBacklight;
+TEST_SUITE TestBitops;
+TEST_SUITE TestBitopsBenchmark;
+TEST_SUITE TestF12;
+TEST_SUITE TestLuxTable;
+TEST_SUITE TestResolutions;
+TEST_SUITE TestTransport;
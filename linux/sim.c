@@ -0,0 +1,1847 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		sim.c
+
+	Abstract:
+
+		Simulated RMI4 controller with an F01, an F11 or F12, an F54 and
+		an F34 function on page 0. It answers register accesses like the
+		transports do and plays a gesture one frame per sample period,
+		raising attention for each frame once the previous one has been
+		read. F54 captures a patterned report whenever GetReport is
+		requested and raises its interrupt once the report is ready. F34
+		runs a V5 bootloader over a flash holding a patterned firmware,
+		which the controller only boots again once it is intact.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "F01.h"
+#include "F11.h"
+#include "F12.h"
+#include "F34.h"
+#include "F54.h"
+#include "debug.h"
+
+//
+// Register map of page 0. The PDT grows down from 0xE9 as on hardware.
+//
+#define SIM_F11_QUERY_BASE      0x00
+#define SIM_F11_CONTROL_BASE    0x08
+#define SIM_F01_QUERY_BASE      0x50
+#define SIM_F01_CONTROL_BASE    0x70
+#define SIM_F01_COMMAND_BASE    0x78
+#define SIM_F01_DATA_BASE       0x7A
+#define SIM_F11_DATA_BASE       0x80
+#define SIM_F54_QUERY_BASE      0xC0
+#define SIM_F54_COMMAND_BASE    0xC6
+#define SIM_F54_DATA_BASE       0xC7
+
+//
+// F12 takes the place of F11. Its register descriptors and its data are
+// packet registers, each at one address and read whole from there.
+//
+#define SIM_F12_QUERY_BASE      0x00
+#define SIM_F12_CONTROL_BASE    0x10
+#define SIM_F12_DATA_BASE       0x80
+#define SIM_F12_DEFAULT_OBJECTS 10
+
+//
+// F12 is not programmed with a sensor extent, it reports in the touch
+// extent the driver takes by default
+//
+#define SIM_F12_SENSOR_MAX_X    800
+#define SIM_F12_SENSOR_MAX_Y    1280
+
+//
+// F1A follows F54 in the PDT when buttons are simulated, so it takes
+// the interrupt source after it
+//
+#define SIM_F1A_QUERY_BASE      0x30
+#define SIM_F1A_CONTROL_BASE    0x32
+#define SIM_F1A_DATA_BASE       0x48
+#define SIM_F1A_BUTTONS         3
+
+//
+// F34 comes last in the PDT and takes the interrupt source after the
+// other functions. Its blocks are 8 bytes so that the block number,
+// the block and the command register fit between the F11 data and
+// F54. The bootloader keeps the other functions in the PDT.
+//
+#define SIM_F34_QUERY_BASE      0x49
+#define SIM_F34_DATA_BASE       0xB5
+#define SIM_F34_BLOCK_SIZE      8
+#define SIM_F34_FIRMWARE_BLOCKS 512
+#define SIM_F34_CONFIG_BLOCKS   16
+#define SIM_F34_FIRMWARE_BYTES  (SIM_F34_FIRMWARE_BLOCKS * SIM_F34_BLOCK_SIZE)
+#define SIM_F34_CONFIG_BYTES    (SIM_F34_CONFIG_BLOCKS * SIM_F34_BLOCK_SIZE)
+#define SIM_F34_BOOTLOADER_ID0  '5'
+#define SIM_F34_BOOTLOADER_ID1  '0'
+
+#define SIM_F01_IRQ             0x01
+#define SIM_TOUCH_IRQ           0x02
+#define SIM_F54_IRQ             0x04
+#define SIM_BUTTON_IRQ          0x08
+
+#define SIM_F11_STATUS_BYTES    ((RMI4_F11_MAX_FINGERS + 3) / 4)
+#define SIM_F01_DEVICE_CONTROL  (SIM_F01_CONTROL_BASE + FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS, DeviceControl))
+#define SIM_F01_IRQ_ENABLE      (SIM_F01_CONTROL_BASE + FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS, InterruptEnable))
+#define SIM_IRQ_STATUS_ADDRESS  (SIM_F01_DATA_BASE + FIELD_OFFSET(RMI4_F01_DATA_REGISTERS, InterruptStatus))
+#define SIM_F54_FIFO_ADDRESS    (SIM_F54_DATA_BASE + RMI4_F54_DATA_FIFO_INDEX)
+#define SIM_F54_REPORT_ADDRESS  (SIM_F54_DATA_BASE + RMI4_F54_DATA_REPORT_DATA)
+#define SIM_F34_BLOCK_ADDRESS   (SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_DATA)
+#define SIM_F34_COMMAND_ADDRESS (SIM_F34_BLOCK_ADDRESS + SIM_F34_BLOCK_SIZE)
+
+//
+// F54 sensor of 16 RX by 28 TX electrodes, so that a 16 bit image takes
+// several bursts. A requested report completes SIM_F54_CAPTURE_US after
+// the request, as long as the controller is operating.
+//
+#define SIM_F54_RX_COUNT        16
+#define SIM_F54_TX_COUNT        28
+#define SIM_F54_REPORT_BYTES    (SIM_F54_RX_COUNT * SIM_F54_TX_COUNT * sizeof(USHORT))
+#define SIM_F54_CAPTURE_US      2000
+
+//
+// One frame per 10ms, the report rate of the controllers this driver
+// ships with
+//
+#define SIM_FRAME_PERIOD_MS     10
+
+#define SIM_MAX_FRAMES          4096
+#define SIM_MAX_CONTACTS        HOST_SIM_MAX_OBJECTS
+
+//
+// The F12 query descriptors take three packet registers each, the data
+// one more
+//
+#define SIM_MAX_PACKETS         (RMI_REG_DESC_COUNT * 3 + 1)
+#define SIM_PACKET_BYTES        (HOST_SIM_MAX_OBJECTS * F12_DATA1_BYTES_PER_OBJ)
+
+//
+// Bus time is accounted as on a 400 kHz I2C bus: 9 clocks per byte,
+// the address and register bytes of every transfer, a repeated start
+// and address for reads and the start and stop conditions
+//
+#define SIM_BUS_KHZ             400
+#define SIM_BUS_BYTE_CLOCKS     9
+#define SIM_BUS_WRITE_CLOCKS    (2 * SIM_BUS_BYTE_CLOCKS + 2)
+#define SIM_BUS_READ_CLOCKS     (3 * SIM_BUS_BYTE_CLOCKS + 3)
+
+typedef struct _SIM_CONTACT
+{
+	UCHAR Slot;
+	ULONG X;
+	ULONG Y;
+} SIM_CONTACT;
+
+typedef enum _SIM_MONITOR
+{
+	SimMonitorUnchanged = 0,
+	SimMonitorOff,
+	SimMonitorOn
+} SIM_MONITOR;
+
+typedef struct _SIM_FRAME
+{
+	ULONG64 Time;
+
+	//
+	// Name=Value settings published with a configuration reload when
+	// the frame is posted, NULL for none
+	//
+	PSTR Reload;
+
+	//
+	// Monitor state change notified when the frame is posted, and
+	// whether the controller fails F01 device control writes made
+	// while the driver handles it
+	//
+	SIM_MONITOR Monitor;
+	BOOLEAN FailSleep;
+
+	ULONG Count;
+	SIM_CONTACT Contacts[SIM_MAX_CONTACTS];
+
+	//
+	// F1A data register, bit N set while button N is held
+	//
+	UCHAR Buttons;
+} SIM_FRAME;
+
+typedef struct _SIM_PACKET
+{
+	UCHAR Address;
+	ULONG Size;
+	UCHAR Data[SIM_PACKET_BYTES];
+} SIM_PACKET;
+
+typedef struct _SIM_CONTEXT
+{
+	UCHAR Registers[256];
+	UCHAR Page;
+
+	//
+	// 2D sensor function and the slots it reports
+	//
+	HOST_SIM_TOUCH Touch;
+	ULONG Slots;
+
+	//
+	// Whether F1A is present, a frame holding other buttons than the
+	// one before it raises its interrupt along with the touch one
+	//
+	BOOLEAN Buttons;
+
+	SIM_PACKET Packets[SIM_MAX_PACKETS];
+	ULONG PacketCount;
+
+	//
+	// Reporting mode last written to F12 Ctrl20
+	//
+	UCHAR F12ReportingMode;
+
+	//
+	// F01 sleep mode and interrupt enable last traced. A sleeping
+	// controller does not scan, frames played while it sleeps are lost.
+	//
+	UCHAR SleepMode;
+	UCHAR InterruptEnable;
+	BOOLEAN FailSleep;
+
+	int AttentionFd;
+	int TimerFd;
+	int F54TimerFd;
+
+	SIM_FRAME* Frames;
+	ULONG FrameCount;
+	ULONG NextFrame;
+
+	//
+	// Built-in gesture coordinates are per mille of the sensor extent
+	// the driver programmed, script coordinates are sensor units
+	//
+	BOOLEAN Scaled;
+
+	//
+	// Report captured by the last completed GetReport
+	//
+	UCHAR F54Report[SIM_F54_REPORT_BYTES];
+	ULONG F54Captures;
+
+	//
+	// F34 flash, the firmware area followed by the configuration area,
+	// whether the bootloader has flash programming enabled and the areas
+	// erased since the controller last booted. The write of firmware
+	// block F34FailBlock, counting from 1, fails once.
+	//
+	UCHAR F34Flash[SIM_F34_FIRMWARE_BYTES + SIM_F34_CONFIG_BYTES];
+	BOOLEAN F34Programming;
+	BOOLEAN F34FirmwareErased;
+	BOOLEAN F34ConfigErased;
+	ULONG F34FailBlock;
+
+	ULONG Transfers;
+	ULONG64 BusClocks;
+} SIM_CONTEXT;
+
+UCHAR
+HostSimF54Byte(
+	IN ULONG Capture,
+	IN ULONG Offset
+)
+/*++
+
+  Routine Description:
+
+	Returns a byte of the F54 report of the given capture. The report
+	starts with the capture number, the remaining bytes depend on both
+	the capture and their offset, so a reader can tell a report mixing
+	captures or bursts read at the wrong offset.
+
+--*/
+{
+	if (Offset < sizeof(ULONG))
+	{
+		return (UCHAR)(Capture >> (Offset * 8));
+	}
+
+	return (UCHAR)(Capture * 7 + Offset * 13 + (Offset >> 8));
+}
+
+static VOID
+HostSimOnF54Timer(
+	IN PVOID Context,
+	IN ULONG Events
+)
+/*++
+
+  Routine Description:
+
+	Completes a pending GetReport and raises the F54 interrupt. The
+	report type is not looked at, every type captures the same pattern.
+	A controller that went to sleep while capturing drops the report.
+
+--*/
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)Context;
+	uint64_t expirations;
+	uint64_t signal = 1;
+	ULONG i;
+
+	UNREFERENCED_PARAMETER(Events);
+
+	if (read(sim->F54TimerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+	{
+		return;
+	}
+
+	if (!(sim->Registers[SIM_F54_COMMAND_BASE] & RMI4_F54_COMMAND_GET_REPORT) ||
+		sim->SleepMode != RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_OPERATING)
+	{
+		return;
+	}
+
+	sim->F54Captures++;
+
+	for (i = 0; i < SIM_F54_REPORT_BYTES; i++)
+	{
+		sim->F54Report[i] = HostSimF54Byte(sim->F54Captures, i);
+	}
+
+	sim->Registers[SIM_F54_COMMAND_BASE] &= ~RMI4_F54_COMMAND_GET_REPORT;
+	sim->Registers[SIM_IRQ_STATUS_ADDRESS] |= SIM_F54_IRQ;
+
+	if (write(sim->AttentionFd, &signal, sizeof(signal)) != sizeof(signal))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INTERRUPT,
+			"Could not signal simulated attention");
+	}
+}
+
+static UCHAR
+HostSimF34Byte(
+	IN ULONG Offset
+)
+/*++
+
+  Routine Description:
+
+	Returns a byte of the firmware the simulated flash holds, the
+	configuration area continuing the firmware area's offsets
+
+--*/
+{
+	return (UCHAR)(Offset * 31 + (Offset >> 8) + 0x5A);
+}
+
+static VOID
+HostSimF34Command(
+	IN SIM_CONTEXT* Sim
+)
+/*++
+
+  Routine Description:
+
+	Runs the flash command just written. Enabling flash programming and
+	erasing take the bootloader ID in the block data, block commands
+	need flash programming enabled and auto increment the block number.
+	The command register is left idle with the result in its status
+	bits and the program enabled flag.
+
+--*/
+{
+	PUCHAR block = &Sim->Registers[SIM_F34_BLOCK_ADDRESS];
+	RMI4_F01_DATA_REGISTERS* f01Data =
+		(RMI4_F01_DATA_REGISTERS*)&Sim->Registers[SIM_F01_DATA_BASE];
+	BOOLEAN idMatches;
+	UCHAR command;
+	UCHAR result = 0;
+	PUCHAR area = NULL;
+	ULONG areaBlocks = 0;
+	ULONG blockNumber;
+
+	command = Sim->Registers[SIM_F34_COMMAND_ADDRESS] & RMI4_F34_COMMAND_MASK;
+	blockNumber = Sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER] |
+		(Sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER + 1] << 8);
+	idMatches = (block[0] == SIM_F34_BOOTLOADER_ID0 && block[1] == SIM_F34_BOOTLOADER_ID1);
+
+	switch (command)
+	{
+	case RMI4_F34_COMMAND_WRITE_FW_BLOCK:
+		area = Sim->F34Flash;
+		areaBlocks = SIM_F34_FIRMWARE_BLOCKS;
+		break;
+	case RMI4_F34_COMMAND_WRITE_CONFIG_BLOCK:
+	case RMI4_F34_COMMAND_READ_CONFIG_BLOCK:
+		area = Sim->F34Flash + SIM_F34_FIRMWARE_BYTES;
+		areaBlocks = SIM_F34_CONFIG_BLOCKS;
+		break;
+	default:
+		break;
+	}
+
+	switch (command)
+	{
+	case RMI4_F34_COMMAND_ENABLE_FLASH_PROG:
+		if (!idMatches)
+		{
+			result = 1;
+			break;
+		}
+
+		if (!Sim->F34Programming)
+		{
+			Trace(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_FLAG_INIT,
+				"Simulated F34 flash programming enabled");
+		}
+
+		Sim->F34Programming = TRUE;
+		f01Data->DeviceStatus.FlashProg = 1;
+		break;
+	case RMI4_F34_COMMAND_ERASE_ALL:
+	case RMI4_F34_COMMAND_ERASE_CONFIG:
+		if (!Sim->F34Programming || !idMatches)
+		{
+			result = 1;
+			break;
+		}
+
+		memset(Sim->F34Flash + SIM_F34_FIRMWARE_BYTES, 0xFF, SIM_F34_CONFIG_BYTES);
+		Sim->F34ConfigErased = TRUE;
+
+		if (command == RMI4_F34_COMMAND_ERASE_ALL)
+		{
+			memset(Sim->F34Flash, 0xFF, SIM_F34_FIRMWARE_BYTES);
+			Sim->F34FirmwareErased = TRUE;
+		}
+		break;
+	case RMI4_F34_COMMAND_WRITE_FW_BLOCK:
+	case RMI4_F34_COMMAND_WRITE_CONFIG_BLOCK:
+	case RMI4_F34_COMMAND_READ_CONFIG_BLOCK:
+		if (!Sim->F34Programming || blockNumber >= areaBlocks)
+		{
+			result = 1;
+			break;
+		}
+
+		if (command == RMI4_F34_COMMAND_READ_CONFIG_BLOCK)
+		{
+			RtlCopyMemory(block, area + blockNumber * SIM_F34_BLOCK_SIZE, SIM_F34_BLOCK_SIZE);
+		}
+		else
+		{
+			RtlCopyMemory(area + blockNumber * SIM_F34_BLOCK_SIZE, block, SIM_F34_BLOCK_SIZE);
+		}
+
+		blockNumber++;
+		Sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER] = (UCHAR)blockNumber;
+		Sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER + 1] = (UCHAR)(blockNumber >> 8);
+		break;
+	default:
+		result = 1;
+		break;
+	}
+
+	Sim->Registers[SIM_F34_COMMAND_ADDRESS] = (UCHAR)(result << 4) |
+		(Sim->F34Programming ? RMI4_F34_PROGRAM_ENABLED : 0);
+}
+
+static BOOLEAN
+HostSimF34AreaIntact(
+	IN SIM_CONTEXT* Sim,
+	IN ULONG Offset,
+	IN ULONG Length
+)
+{
+	ULONG i;
+
+	for (i = Offset; i < Offset + Length; i++)
+	{
+		if (Sim->F34Flash[i] != HostSimF34Byte(i))
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static VOID
+HostSimReset(
+	IN SIM_CONTEXT* Sim
+)
+/*++
+
+  Routine Description:
+
+	Handles an F01 reset. Out of the bootloader it changes nothing. In
+	it the controller checks the areas erased since it last booted and
+	only leaves the bootloader if they hold the firmware again,
+	otherwise it reports the CRC failure through the F01 device status.
+
+--*/
+{
+	RMI4_F01_DATA_REGISTERS* f01Data =
+		(RMI4_F01_DATA_REGISTERS*)&Sim->Registers[SIM_F01_DATA_BASE];
+
+	Sim->Registers[SIM_F01_COMMAND_BASE] = 0;
+
+	if (!Sim->F34Programming)
+	{
+		return;
+	}
+
+	if (Sim->F34FirmwareErased &&
+		!HostSimF34AreaIntact(Sim, 0, SIM_F34_FIRMWARE_BYTES))
+	{
+		f01Data->DeviceStatus.Status = RMI4_F01_DATA_STATUS_FW_CRC_FAILURE;
+	}
+	else if (Sim->F34ConfigErased &&
+		!HostSimF34AreaIntact(Sim, SIM_F34_FIRMWARE_BYTES, SIM_F34_CONFIG_BYTES))
+	{
+		f01Data->DeviceStatus.Status = RMI4_F01_DATA_STATUS_CONFIG_CRC_FAILURE;
+	}
+	else
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Simulated controller booted, firmware %s, configuration %s",
+			Sim->F34FirmwareErased ? "flashed" : "kept",
+			Sim->F34ConfigErased ? "flashed" : "kept");
+
+		Sim->F34Programming = FALSE;
+		Sim->F34FirmwareErased = FALSE;
+		Sim->F34ConfigErased = FALSE;
+		Sim->Registers[SIM_F34_COMMAND_ADDRESS] = 0;
+		f01Data->DeviceStatus.All = 0;
+		return;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Simulated controller stays in the bootloader, device status %u",
+		f01Data->DeviceStatus.Status);
+}
+
+static SIM_PACKET*
+HostSimGetPacket(
+	IN SIM_CONTEXT* Sim,
+	IN ULONG Address
+)
+{
+	ULONG i;
+
+	for (i = 0; i < Sim->PacketCount; i++)
+	{
+		if (Sim->Packets[i].Address == Address)
+		{
+			return &Sim->Packets[i];
+		}
+	}
+
+	return NULL;
+}
+
+static SIM_PACKET*
+HostSimAddPacket(
+	IN SIM_CONTEXT* Sim,
+	IN UCHAR Address,
+	IN const VOID* Data,
+	IN ULONG Size
+)
+{
+	SIM_PACKET* packet;
+
+	NT_ASSERT(Sim->PacketCount < SIM_MAX_PACKETS && Size <= SIM_PACKET_BYTES);
+
+	packet = &Sim->Packets[Sim->PacketCount++];
+	packet->Address = Address;
+	packet->Size = Size;
+
+	if (Data != NULL)
+	{
+		RtlCopyMemory(packet->Data, Data, Size);
+	}
+
+	return packet;
+}
+
+static SPB_TRANSPORT_READ HostSimRead;
+static SPB_TRANSPORT_WRITE HostSimWrite;
+
+const SPB_TRANSPORT HostSimTransport =
+{
+	"simulator",
+	256,
+	HostSimRead,
+	HostSimWrite,
+	SpbSetPageRegister
+};
+
+static
+NTSTATUS
+HostSimRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	Reads registers. Pages other than 0 are empty, reading the F01
+	interrupt status clears it and releases attention. A read of a
+	packet register returns the packet. Reads of the F54 report data
+	register return the captured report from the FIFO index on, and
+	advance the index.
+
+--*/
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)SpbContext->TransportContext;
+	SIM_PACKET* packet;
+	ULONG offset = Address & 0xFF;
+	ULONG available;
+	ULONG fifoIndex;
+
+	RtlZeroMemory(Data, Length);
+
+	sim->Transfers++;
+	sim->BusClocks += SIM_BUS_READ_CLOCKS + (ULONG64)Length * SIM_BUS_BYTE_CLOCKS;
+
+	if ((Address >> 8) != 0)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	packet = HostSimGetPacket(sim, offset);
+
+	if (packet != NULL)
+	{
+		RtlCopyMemory(Data, packet->Data, min(Length, packet->Size));
+		return STATUS_SUCCESS;
+	}
+
+	if (offset == SIM_F54_REPORT_ADDRESS)
+	{
+		fifoIndex = sim->Registers[SIM_F54_FIFO_ADDRESS] |
+			(sim->Registers[SIM_F54_FIFO_ADDRESS + 1] << 8);
+
+		if (fifoIndex < SIM_F54_REPORT_BYTES)
+		{
+			RtlCopyMemory(
+				Data,
+				&sim->F54Report[fifoIndex],
+				min(Length, SIM_F54_REPORT_BYTES - fifoIndex));
+		}
+
+		fifoIndex = min(fifoIndex + Length, 0xFFFF);
+		sim->Registers[SIM_F54_FIFO_ADDRESS] = (UCHAR)fifoIndex;
+		sim->Registers[SIM_F54_FIFO_ADDRESS + 1] = (UCHAR)(fifoIndex >> 8);
+
+		return STATUS_SUCCESS;
+	}
+
+	available = min(Length, 256 - offset);
+	RtlCopyMemory(Data, &sim->Registers[offset], available);
+
+	if (offset <= SIM_IRQ_STATUS_ADDRESS && offset + available > SIM_IRQ_STATUS_ADDRESS)
+	{
+		sim->Registers[SIM_IRQ_STATUS_ADDRESS] = 0;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static
+NTSTATUS
+HostSimWrite(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	Writes registers. The page select register is present on every
+	page, other writes only land on page 0. Changes of the F12
+	reporting mode and of the F01 sleep mode and interrupt enable are
+	traced with the frame they were made on. Setting F54 GetReport
+	starts a capture, F34 commands and F01 resets run as they are
+	written.
+
+--*/
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)SpbContext->TransportContext;
+	struct itimerspec capture;
+	ULONG offset = Address & 0xFF;
+	BOOLEAN covers;
+
+	sim->Transfers++;
+	sim->BusClocks += SIM_BUS_WRITE_CLOCKS + (ULONG64)Length * SIM_BUS_BYTE_CLOCKS;
+
+	if (offset == RMI4_PAGE_SELECT_ADDRESS && Length == 1)
+	{
+		sim->Page = *(PUCHAR)Data;
+		return STATUS_SUCCESS;
+	}
+
+	if ((Address >> 8) != 0)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	if (sim->FailSleep && offset == SIM_F01_DEVICE_CONTROL)
+	{
+		return STATUS_IO_TIMEOUT;
+	}
+
+	covers = (offset <= SIM_F34_COMMAND_ADDRESS && offset + Length > SIM_F34_COMMAND_ADDRESS);
+
+	if (covers &&
+		sim->F34FailBlock != 0 &&
+		((PUCHAR)Data)[SIM_F34_COMMAND_ADDRESS - offset] == RMI4_F34_COMMAND_WRITE_FW_BLOCK &&
+		(sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER] |
+			(sim->Registers[SIM_F34_DATA_BASE + RMI4_F34_DATA_BLOCK_NUMBER + 1] << 8)) ==
+			sim->F34FailBlock - 1)
+	{
+		sim->F34FailBlock = 0;
+		return STATUS_IO_TIMEOUT;
+	}
+
+	RtlCopyMemory(&sim->Registers[offset], Data, min(Length, 256 - offset));
+
+	if (covers && (sim->Registers[SIM_F34_COMMAND_ADDRESS] & RMI4_F34_COMMAND_MASK))
+	{
+		HostSimF34Command(sim);
+	}
+
+	if (offset <= SIM_F01_COMMAND_BASE && offset + Length > SIM_F01_COMMAND_BASE &&
+		(sim->Registers[SIM_F01_COMMAND_BASE] & 0x01))
+	{
+		HostSimReset(sim);
+	}
+
+	if ((sim->Registers[SIM_F01_DEVICE_CONTROL] & 0x03) != sim->SleepMode ||
+		sim->Registers[SIM_F01_IRQ_ENABLE] != sim->InterruptEnable)
+	{
+		sim->SleepMode = sim->Registers[SIM_F01_DEVICE_CONTROL] & 0x03;
+		sim->InterruptEnable = sim->Registers[SIM_F01_IRQ_ENABLE];
+
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_POWER,
+			"Simulated F01 sleep mode %u interrupt enable 0x%02X at frame %u",
+			sim->SleepMode,
+			sim->InterruptEnable,
+			sim->NextFrame);
+	}
+
+	if (offset == SIM_F54_COMMAND_BASE &&
+		(sim->Registers[SIM_F54_COMMAND_BASE] & RMI4_F54_COMMAND_GET_REPORT))
+	{
+		capture.it_value.tv_sec = 0;
+		capture.it_value.tv_nsec = SIM_F54_CAPTURE_US * 1000L;
+		capture.it_interval.tv_sec = 0;
+		capture.it_interval.tv_nsec = 0;
+		timerfd_settime(sim->F54TimerFd, 0, &capture, NULL);
+	}
+
+	if (sim->Touch == HostSimTouchF12 &&
+		offset == SIM_F12_CONTROL_BASE &&
+		(sim->Registers[offset] & RMI_F12_REPORTING_MODE_MASK) != sim->F12ReportingMode)
+	{
+		sim->F12ReportingMode = sim->Registers[offset] & RMI_F12_REPORTING_MODE_MASK;
+
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_REPORTING,
+			"Simulated F12 reporting mode %u at frame %u",
+			sim->F12ReportingMode,
+			sim->NextFrame);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static VOID
+HostSimBuildF12(
+	IN SIM_CONTEXT* Sim,
+	OUT RMI4_FUNCTION_DESCRIPTOR* Descriptor
+)
+/*++
+
+  Routine Description:
+
+	Builds an F12 function with register descriptors: no query
+	registers, Ctrl20 as its only control register and Data1 holding
+	one 8 byte subpacket per object
+
+--*/
+{
+	static const UCHAR queryPresence[] = { 1 };
+	static const UCHAR controlPresence[] = { 2, 0, 0, 1 << (F12_2D_CTRL20 - 16) };
+	static const UCHAR controlStruct[] = { F12_2D_CTRL20_SIZE, 0 };
+	UCHAR dataPresence[] = { 0, 1 << 1 };
+	UCHAR dataStruct[3 + (HOST_SIM_MAX_OBJECTS + 6) / 7];
+	UCHAR size;
+	ULONG dataBytes;
+	ULONG length = 0;
+	ULONG i;
+
+	RtlZeroMemory(Descriptor, sizeof(RMI4_FUNCTION_DESCRIPTOR));
+	Descriptor->QueryBase = SIM_F12_QUERY_BASE;
+	Descriptor->ControlBase = SIM_F12_CONTROL_BASE;
+	Descriptor->DataBase = SIM_F12_DATA_BASE;
+	Descriptor->VersionIrq.IrqCount = 1;
+	Descriptor->Number = RMI4_F12_2D_TOUCHPAD_SENSOR;
+
+	//
+	// General info announcing register descriptors
+	//
+	Sim->Registers[SIM_F12_QUERY_BASE] = 0x01;
+
+	//
+	// Data1 sizes above a byte take the 16 bit form, the subpacket
+	// presence chain has 7 bits per byte
+	//
+	dataBytes = Sim->Slots * F12_DATA1_BYTES_PER_OBJ;
+
+	if (dataBytes <= MAXUCHAR)
+	{
+		dataStruct[length++] = (UCHAR)dataBytes;
+	}
+	else
+	{
+		dataStruct[length++] = 0;
+		dataStruct[length++] = (UCHAR)dataBytes;
+		dataStruct[length++] = (UCHAR)(dataBytes >> 8);
+	}
+
+	for (i = 0; i < Sim->Slots; i += 7)
+	{
+		dataStruct[length++] = (UCHAR)(((1 << min(Sim->Slots - i, 7)) - 1) |
+			((i + 7 < Sim->Slots) ? 0x80 : 0));
+	}
+
+	dataPresence[0] = (UCHAR)length;
+
+	size = sizeof(queryPresence);
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 1, &size, sizeof(size));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 2, queryPresence, sizeof(queryPresence));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 3, NULL, 0);
+
+	size = sizeof(controlPresence);
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 4, &size, sizeof(size));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 5, controlPresence, sizeof(controlPresence));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 6, controlStruct, sizeof(controlStruct));
+
+	size = sizeof(dataPresence);
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 7, &size, sizeof(size));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 8, dataPresence, sizeof(dataPresence));
+	HostSimAddPacket(Sim, SIM_F12_QUERY_BASE + 9, dataStruct, length);
+
+	HostSimAddPacket(Sim, SIM_F12_DATA_BASE, NULL, dataBytes);
+}
+
+static PCSTR
+HostSimProductId(
+	IN HOST_SIM_TOUCH Touch
+)
+{
+	return (Touch == HostSimTouchF12) ? "SIM-F12" : "SIM-F11";
+}
+
+static VOID
+HostSimBuildRegisters(
+	IN SIM_CONTEXT* Sim,
+	IN UCHAR FirmwareBuild
+)
+{
+	RMI4_FUNCTION_DESCRIPTOR descriptor;
+	RMI4_F01_QUERY_REGISTERS* f01Query;
+	RMI4_F11_QUERY1_REGISTERS* f11Query;
+	RMI4_F54_QUERY_REGISTERS* f54Query;
+	RMI4_F1A_QUERY_REGISTERS* f1aQuery;
+	RMI4_F34_QUERY_REGISTERS* f34Query;
+	PCSTR productId = HostSimProductId(Sim->Touch);
+	ULONG i;
+
+	//
+	// F01 device control
+	//
+	RtlZeroMemory(&descriptor, sizeof(descriptor));
+	descriptor.QueryBase = SIM_F01_QUERY_BASE;
+	descriptor.CommandBase = SIM_F01_COMMAND_BASE;
+	descriptor.ControlBase = SIM_F01_CONTROL_BASE;
+	descriptor.DataBase = SIM_F01_DATA_BASE;
+	descriptor.VersionIrq.IrqCount = 1;
+	descriptor.Number = RMI4_F01_RMI_DEVICE_CONTROL;
+	RtlCopyMemory(&Sim->Registers[RMI4_FIRST_FUNCTION_ADDRESS], &descriptor, sizeof(descriptor));
+
+	f01Query = (RMI4_F01_QUERY_REGISTERS*)&Sim->Registers[SIM_F01_QUERY_BASE];
+	f01Query->ManufacturerID = 1;
+	RtlCopyMemory(&f01Query->ProductID1, productId, strlen(productId));
+
+	//
+	// The simulated part keeps its firmware build in the last product ID
+	// byte, past the product ID string
+	//
+	f01Query->ProductID10 = FirmwareBuild;
+
+	if (Sim->Touch == HostSimTouchF12)
+	{
+		HostSimBuildF12(Sim, &descriptor);
+	}
+	else
+	{
+		//
+		// F11 2D sensor with ten fingers
+		//
+		RtlZeroMemory(&descriptor, sizeof(descriptor));
+		descriptor.QueryBase = SIM_F11_QUERY_BASE;
+		descriptor.ControlBase = SIM_F11_CONTROL_BASE;
+		descriptor.DataBase = SIM_F11_DATA_BASE;
+		descriptor.VersionIrq.IrqCount = 1;
+		descriptor.Number = RMI4_F11_2D_TOUCHPAD_SENSOR;
+
+		f11Query = (RMI4_F11_QUERY1_REGISTERS*)
+			&Sim->Registers[SIM_F11_QUERY_BASE + sizeof(RMI4_F11_QUERY0_REGISTERS)];
+		f11Query->NumberOfFingers = 5;
+		f11Query->HasAbsolute = 1;
+	}
+
+	RtlCopyMemory(
+		&Sim->Registers[RMI4_FIRST_FUNCTION_ADDRESS - sizeof(descriptor)],
+		&descriptor,
+		sizeof(descriptor));
+
+	//
+	// F54 test reporting with 16 bit images and baseline
+	//
+	RtlZeroMemory(&descriptor, sizeof(descriptor));
+	descriptor.QueryBase = SIM_F54_QUERY_BASE;
+	descriptor.CommandBase = SIM_F54_COMMAND_BASE;
+	descriptor.DataBase = SIM_F54_DATA_BASE;
+	descriptor.VersionIrq.IrqCount = 1;
+	descriptor.Number = RMI4_F54_TEST_REPORTING;
+	RtlCopyMemory(
+		&Sim->Registers[RMI4_FIRST_FUNCTION_ADDRESS - 2 * sizeof(descriptor)],
+		&descriptor,
+		sizeof(descriptor));
+
+	f54Query = (RMI4_F54_QUERY_REGISTERS*)&Sim->Registers[SIM_F54_QUERY_BASE];
+	f54Query->NumRxElectrodes = SIM_F54_RX_COUNT;
+	f54Query->NumTxElectrodes = SIM_F54_TX_COUNT;
+	f54Query->HasImage16 = 1;
+	f54Query->HasBaseline = 1;
+
+	//
+	// F1A capacitive buttons, the terminator following the last
+	// function is left zero
+	//
+	if (Sim->Buttons)
+	{
+		RtlZeroMemory(&descriptor, sizeof(descriptor));
+		descriptor.QueryBase = SIM_F1A_QUERY_BASE;
+		descriptor.ControlBase = SIM_F1A_CONTROL_BASE;
+		descriptor.DataBase = SIM_F1A_DATA_BASE;
+		descriptor.VersionIrq.IrqCount = 1;
+		descriptor.Number = RMI4_F1A_0D_CAP_BUTTON_SENSOR;
+		RtlCopyMemory(
+			&Sim->Registers[RMI4_FIRST_FUNCTION_ADDRESS - 3 * sizeof(descriptor)],
+			&descriptor,
+			sizeof(descriptor));
+
+		f1aQuery = (RMI4_F1A_QUERY_REGISTERS*)&Sim->Registers[SIM_F1A_QUERY_BASE];
+		f1aQuery->MaxButtonCount = SIM_F1A_BUTTONS - 1;
+	}
+
+	//
+	// F34 flash memory management, the flash holds intact firmware
+	//
+	RtlZeroMemory(&descriptor, sizeof(descriptor));
+	descriptor.QueryBase = SIM_F34_QUERY_BASE;
+	descriptor.DataBase = SIM_F34_DATA_BASE;
+	descriptor.VersionIrq.IrqCount = 1;
+	descriptor.Number = RMI4_F34_FLASH_MEMORY_MANAGEMENT;
+	RtlCopyMemory(
+		&Sim->Registers[RMI4_FIRST_FUNCTION_ADDRESS - (Sim->Buttons ? 4 : 3) * sizeof(descriptor)],
+		&descriptor,
+		sizeof(descriptor));
+
+	f34Query = (RMI4_F34_QUERY_REGISTERS*)&Sim->Registers[SIM_F34_QUERY_BASE];
+	f34Query->BootloaderId[0] = SIM_F34_BOOTLOADER_ID0;
+	f34Query->BootloaderId[1] = SIM_F34_BOOTLOADER_ID1;
+	f34Query->BlockSize = SIM_F34_BLOCK_SIZE;
+	f34Query->FirmwareBlocks = SIM_F34_FIRMWARE_BLOCKS;
+	f34Query->ConfigBlocks = SIM_F34_CONFIG_BLOCKS;
+
+	for (i = 0; i < sizeof(Sim->F34Flash); i++)
+	{
+		Sim->F34Flash[i] = HostSimF34Byte(i);
+	}
+}
+
+static ULONG
+HostSimSensorMax(
+	IN ULONG Lo,
+	IN ULONG Hi
+)
+{
+	ULONG value;
+
+	value = Lo | ((Hi & 0xF) << 8);
+
+	return (value != 0) ? value : 0xFFF;
+}
+
+static VOID
+HostSimApplyFrame(
+	IN SIM_CONTEXT* Sim,
+	IN const SIM_FRAME* Frame
+)
+/*++
+
+  Routine Description:
+
+	Loads a frame into the F11 or F12 data registers. Slots absent from
+	the frame report not present, which is how a lift is signalled.
+
+--*/
+{
+	RMI4_F11_CTRL_REGISTERS* control;
+	RMI4_F11_DATA_POSITION* position;
+	SIM_PACKET* packet = NULL;
+	PUCHAR object;
+	ULONG fingerStatus = 0;
+	ULONG maxX;
+	ULONG maxY;
+	ULONG x;
+	ULONG y;
+	ULONG i;
+
+	//
+	// Scale to the sensor extent the driver programmed
+	//
+	if (Sim->Touch == HostSimTouchF12)
+	{
+		packet = HostSimGetPacket(Sim, SIM_F12_DATA_BASE);
+		RtlZeroMemory(packet->Data, packet->Size);
+		maxX = SIM_F12_SENSOR_MAX_X;
+		maxY = SIM_F12_SENSOR_MAX_Y;
+	}
+	else
+	{
+		control = (RMI4_F11_CTRL_REGISTERS*)&Sim->Registers[SIM_F11_CONTROL_BASE];
+		maxX = HostSimSensorMax(control->SensorMaxXPosLo, control->SensorMaxXPosHi);
+		maxY = HostSimSensorMax(control->SensorMaxYPosLo, control->SensorMaxYPosHi);
+	}
+
+	for (i = 0; i < Frame->Count; i++)
+	{
+		x = Frame->Contacts[i].X;
+		y = Frame->Contacts[i].Y;
+
+		if (Sim->Scaled)
+		{
+			x = x * maxX / 1000;
+			y = y * maxY / 1000;
+		}
+
+		x = min(x, 0xFFF);
+		y = min(y, 0xFFF);
+
+		if (packet != NULL)
+		{
+			object = &packet->Data[Frame->Contacts[i].Slot * F12_DATA1_BYTES_PER_OBJ];
+			object[0] = RMI_F12_OBJECT_FINGER;
+			object[1] = (UCHAR)x;
+			object[2] = (UCHAR)(x >> 8);
+			object[3] = (UCHAR)y;
+			object[4] = (UCHAR)(y >> 8);
+			object[5] = 0x40;
+			object[6] = 4;
+			object[7] = 4;
+			continue;
+		}
+
+		position = (RMI4_F11_DATA_POSITION*)&Sim->Registers[
+			SIM_F11_DATA_BASE + SIM_F11_STATUS_BYTES +
+			Frame->Contacts[i].Slot * sizeof(RMI4_F11_DATA_POSITION)];
+
+		position->XPosHi = (BYTE)(x >> 4);
+		position->YPosHi = (BYTE)(y >> 4);
+		position->XPosLo = x & 0xF;
+		position->YPosLo = y & 0xF;
+		position->XWidth = 4;
+		position->YWidth = 4;
+		position->ZAmplitude = 0x40;
+
+		fingerStatus |= RMI4_FINGER_STATE_PRESENT_WITH_ACCURATE_POS << (Frame->Contacts[i].Slot * 2);
+	}
+
+	if (packet != NULL)
+	{
+		return;
+	}
+
+	for (i = 0; i < SIM_F11_STATUS_BYTES; i++)
+	{
+		Sim->Registers[SIM_F11_DATA_BASE + i] = (UCHAR)(fingerStatus >> (i * 8));
+	}
+}
+
+static VOID
+HostSimReload(
+	IN PCSTR Settings
+)
+/*++
+
+  Routine Description:
+
+	Stores the settings of a script reload line and raises SIGHUP, so
+	the daemon publishes them before the interrupt of the frame posted
+	along with them is serviced.
+
+--*/
+{
+	CHAR settings[512];
+	PSTR setting;
+	PSTR separator;
+	PSTR state;
+
+	strncpy(settings, Settings, sizeof(settings) - 1);
+	settings[sizeof(settings) - 1] = '\0';
+
+	for (setting = strtok_r(settings, " \t\r\n", &state);
+		setting != NULL;
+		setting = strtok_r(NULL, " \t\r\n", &state))
+	{
+		separator = strchr(setting, '=');
+
+		if (separator == NULL)
+		{
+			continue;
+		}
+
+		*separator = '\0';
+		(VOID)HostRegistrySetValue(setting, separator + 1);
+	}
+
+	raise(SIGHUP);
+}
+
+static VOID
+HostSimOnFrameTimer(
+	IN PVOID Context,
+	IN ULONG Events
+)
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)Context;
+	uint64_t expirations;
+	uint64_t signal = 1;
+
+	UNREFERENCED_PARAMETER(Events);
+
+	if (read(sim->TimerFd, &expirations, sizeof(expirations)) != sizeof(expirations))
+	{
+		return;
+	}
+
+	//
+	// Hold the next frame until the driver has read the current one, a
+	// completed F54 report is read along with it
+	//
+	if (sim->Registers[SIM_IRQ_STATUS_ADDRESS] & ~SIM_F54_IRQ)
+	{
+		return;
+	}
+
+	if (sim->NextFrame == sim->FrameCount)
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"Simulated gesture complete after %u frames",
+			sim->FrameCount);
+
+		HostLoopStop();
+		return;
+	}
+
+	HostClockSetFrameTime(sim->Frames[sim->NextFrame].Time);
+
+	if (sim->Frames[sim->NextFrame].Reload != NULL)
+	{
+		HostSimReload(sim->Frames[sim->NextFrame].Reload);
+	}
+
+	if (sim->Frames[sim->NextFrame].Monitor != SimMonitorUnchanged)
+	{
+		sim->FailSleep = sim->Frames[sim->NextFrame].FailSleep;
+
+		HostSetMonitorState(
+			(sim->Frames[sim->NextFrame].Monitor == SimMonitorOn) ? TRUE : FALSE);
+
+		sim->FailSleep = FALSE;
+	}
+
+	if (sim->SleepMode != RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_OPERATING)
+	{
+		sim->NextFrame++;
+		return;
+	}
+
+	if (sim->Buttons &&
+		sim->Frames[sim->NextFrame].Buttons != sim->Registers[SIM_F1A_DATA_BASE])
+	{
+		sim->Registers[SIM_F1A_DATA_BASE] = sim->Frames[sim->NextFrame].Buttons;
+		sim->Registers[SIM_IRQ_STATUS_ADDRESS] |= SIM_BUTTON_IRQ;
+	}
+
+	HostSimApplyFrame(sim, &sim->Frames[sim->NextFrame++]);
+
+	sim->Registers[SIM_IRQ_STATUS_ADDRESS] |= SIM_TOUCH_IRQ;
+
+	if (write(sim->AttentionFd, &signal, sizeof(signal)) != sizeof(signal))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INTERRUPT,
+			"Could not signal simulated attention");
+	}
+}
+
+static NTSTATUS
+HostSimAddFrame(
+	IN SIM_CONTEXT* Sim,
+	IN const SIM_FRAME* Frame
+)
+/*++
+
+  Routine Description:
+
+	Appends a frame. A frame without a time is played one frame period
+	after the previous one.
+
+--*/
+{
+	SIM_FRAME* frame;
+
+	if (Sim->FrameCount == SIM_MAX_FRAMES)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	frame = &Sim->Frames[Sim->FrameCount];
+	*frame = *Frame;
+
+	if (frame->Time == 0)
+	{
+		frame->Time = SIM_FRAME_PERIOD_MS * 10000ULL;
+
+		if (Sim->FrameCount != 0)
+		{
+			frame->Time += Sim->Frames[Sim->FrameCount - 1].Time;
+		}
+	}
+
+	Sim->FrameCount++;
+
+	return STATUS_SUCCESS;
+}
+
+static VOID
+HostSimBuildGesture(
+	IN SIM_CONTEXT* Sim
+)
+/*++
+
+  Routine Description:
+
+	Built-in gesture: one finger swipes across the sensor, a second
+	finger joins and moves down while the first holds, then both lift
+
+--*/
+{
+	SIM_FRAME frame;
+	ULONG i;
+
+	Sim->Scaled = TRUE;
+
+	for (i = 0; i < 20; i++)
+	{
+		RtlZeroMemory(&frame, sizeof(frame));
+		frame.Count = 1;
+		frame.Contacts[0].Slot = 0;
+		frame.Contacts[0].X = 200 + i * 30;
+		frame.Contacts[0].Y = 500;
+		HostSimAddFrame(Sim, &frame);
+	}
+
+	for (i = 0; i < 10; i++)
+	{
+		RtlZeroMemory(&frame, sizeof(frame));
+		frame.Count = 2;
+		frame.Contacts[0].Slot = 0;
+		frame.Contacts[0].X = 800;
+		frame.Contacts[0].Y = 500;
+		frame.Contacts[1].Slot = 1;
+		frame.Contacts[1].X = 500;
+		frame.Contacts[1].Y = 200 + i * 60;
+		HostSimAddFrame(Sim, &frame);
+	}
+
+	RtlZeroMemory(&frame, sizeof(frame));
+	HostSimAddFrame(Sim, &frame);
+}
+
+static NTSTATUS
+HostSimLoadScript(
+	IN SIM_CONTEXT* Sim,
+	IN PCSTR Path
+)
+/*++
+
+  Routine Description:
+
+	Loads one frame per line, each a list of slot:x:y contacts in
+	sensor units, followed by bN for every F1A button N held during the
+	frame. An empty line is a frame without contacts, lines starting
+	with '#' are skipped. A line may start with @ and the scan
+	time of the frame in ms, as in traces replayed by rmi4replay, which
+	sets the frame clock for that frame. Frames are still played
+	SIM_FRAME_PERIOD_MS apart. A line starting with '!' lists Name=Value
+	settings reloaded while the interrupt of the next frame is pending.
+	A line "%off" or "%on" turns the monitor off or on before the next
+	frame is played, "%off fail" also makes the controller fail the F01
+	device control writes made for it.
+
+--*/
+{
+	CHAR line[512];
+	SIM_FRAME frame;
+	ULONG lineNumber = 0;
+	unsigned int slot;
+	unsigned int x;
+	unsigned int y;
+	unsigned int button;
+	double time;
+	int consumed;
+	PSTR cursor;
+	PSTR reload = NULL;
+	SIM_MONITOR monitor = SimMonitorUnchanged;
+	BOOLEAN failSleep = FALSE;
+	CHAR state[8];
+	CHAR option[8];
+	int words;
+	FILE* file;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	file = fopen(Path, "r");
+
+	if (file == NULL)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	while (fgets(line, sizeof(line), file) != NULL)
+	{
+		lineNumber++;
+
+		if (line[0] == '#')
+		{
+			continue;
+		}
+
+		if (line[0] == '!')
+		{
+			free(reload);
+			reload = strdup(line + 1);
+
+			if (reload == NULL)
+			{
+				status = STATUS_INSUFFICIENT_RESOURCES;
+				break;
+			}
+
+			continue;
+		}
+
+		if (line[0] == '%')
+		{
+			words = sscanf(line + 1, "%7s %7s", state, option);
+
+			if (words >= 1 && strcmp(state, "off") == 0)
+			{
+				monitor = SimMonitorOff;
+			}
+			else if (words >= 1 && strcmp(state, "on") == 0)
+			{
+				monitor = SimMonitorOn;
+			}
+			else
+			{
+				status = STATUS_INVALID_PARAMETER;
+			}
+
+			failSleep = (monitor == SimMonitorOff && words == 2 && strcmp(option, "fail") == 0) ?
+				TRUE : FALSE;
+
+			if (NT_SUCCESS(status))
+			{
+				continue;
+			}
+		}
+
+		RtlZeroMemory(&frame, sizeof(frame));
+		frame.Reload = reload;
+		frame.Monitor = monitor;
+		frame.FailSleep = failSleep;
+
+		consumed = 0;
+
+		if (sscanf(line, " @%lf%n", &time, &consumed) == 1 && time > 0)
+		{
+			frame.Time = (ULONG64)(time * 10000);
+		}
+
+		for (cursor = line + consumed;
+			sscanf(cursor, " %u:%u:%u%n", &slot, &x, &y, &consumed) == 3;
+			cursor += consumed)
+		{
+			if (slot >= Sim->Slots || frame.Count == Sim->Slots)
+			{
+				status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+
+			frame.Contacts[frame.Count].Slot = (UCHAR)slot;
+			frame.Contacts[frame.Count].X = x;
+			frame.Contacts[frame.Count].Y = y;
+			frame.Count++;
+		}
+
+		for (;
+			NT_SUCCESS(status) && sscanf(cursor, " b%u%n", &button, &consumed) == 1;
+			cursor += consumed)
+		{
+			if (!Sim->Buttons || button >= SIM_F1A_BUTTONS)
+			{
+				status = STATUS_INVALID_PARAMETER;
+				break;
+			}
+
+			frame.Buttons |= (UCHAR)(1 << button);
+		}
+
+		if (NT_SUCCESS(status))
+		{
+			status = HostSimAddFrame(Sim, &frame);
+		}
+
+		if (NT_SUCCESS(status))
+		{
+			reload = NULL;
+			monitor = SimMonitorUnchanged;
+			failSleep = FALSE;
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Invalid gesture script line %s:%u - STATUS:%X",
+				Path,
+				lineNumber,
+				status);
+
+			break;
+		}
+	}
+
+	free(reload);
+	fclose(file);
+
+exit:
+
+	return status;
+}
+
+static VOID
+HostSimAcknowledge(
+	IN HOST_ATTENTION* Attention
+)
+{
+	uint64_t count;
+
+	if (read(Attention->Fd, &count, sizeof(count)) != sizeof(count))
+	{
+		return;
+	}
+}
+
+static BOOLEAN
+HostSimAsserted(
+	IN HOST_ATTENTION* Attention
+)
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)Attention->Context;
+
+	return (sim->Registers[SIM_IRQ_STATUS_ADDRESS] != 0) ? TRUE : FALSE;
+}
+
+static VOID
+HostSimCloseAttention(
+	IN HOST_ATTENTION* Attention
+)
+{
+	//
+	// The eventfd belongs to the simulator, HostSimClose releases it
+	//
+	Attention->Fd = -1;
+}
+
+static const HOST_ATTENTION_OPS HostSimAttentionOps =
+{
+	HostSimAcknowledge,
+	HostSimAsserted,
+	HostSimCloseAttention
+};
+
+NTSTATUS
+HostSimOpen(
+	IN const HOST_SIM_OPTIONS* Options,
+	OUT SPB_CONTEXT* SpbContext,
+	OUT HOST_ATTENTION* Attention
+)
+/*++
+
+  Routine Description:
+
+	Creates the simulated controller and starts playing frames
+
+  Arguments:
+
+	Options - functions of the controller, the bus it is reached over
+		and the gesture it plays
+	SpbContext - receives the transport for the bus
+	Attention  - receives the simulated attention line
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	struct itimerspec period;
+	SIM_CONTEXT* sim;
+	NTSTATUS status;
+
+	RtlZeroMemory(SpbContext, sizeof(SPB_CONTEXT));
+	Attention->Fd = -1;
+	Attention->Ops = &HostSimAttentionOps;
+
+	sim = (SIM_CONTEXT*)calloc(1, sizeof(SIM_CONTEXT));
+
+	if (sim == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	sim->AttentionFd = -1;
+	sim->TimerFd = -1;
+	sim->F54TimerFd = -1;
+	SpbContext->Transport = &HostSimTransport;
+	SpbContext->TransportContext = sim;
+	Attention->Context = sim;
+
+	sim->Frames = (SIM_FRAME*)calloc(SIM_MAX_FRAMES, sizeof(SIM_FRAME));
+
+	if (sim->Frames == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	sim->Touch = Options->Touch;
+	sim->Buttons = Options->Buttons;
+	sim->F34FailBlock = Options->F34FailBlock;
+
+	if (sim->Touch == HostSimTouchF12)
+	{
+		sim->Slots = (Options->Objects != 0) ? Options->Objects : SIM_F12_DEFAULT_OBJECTS;
+
+		if (sim->Slots > HOST_SIM_MAX_OBJECTS)
+		{
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+	}
+	else
+	{
+		sim->Slots = RMI4_F11_MAX_FINGERS;
+	}
+
+	HostSimBuildRegisters(sim, (UCHAR)Options->FirmwareBuild);
+
+	if (Options->ScriptPath != NULL)
+	{
+		status = HostSimLoadScript(sim, Options->ScriptPath);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+	else
+	{
+		HostSimBuildGesture(sim);
+	}
+
+	status = WdfWaitLockCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&SpbContext->SpbLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (Options->Bus != HostSimBusDirect)
+	{
+		status = HostSimBusAttach(Options->Bus, SpbContext);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	sim->AttentionFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	sim->TimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	sim->F54TimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (sim->AttentionFd < 0 || sim->TimerFd < 0 || sim->F54TimerFd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	Attention->Fd = sim->AttentionFd;
+
+	status = HostLoopAdd(sim->TimerFd, EPOLLIN, HostSimOnFrameTimer, sim);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = HostLoopAdd(sim->F54TimerFd, EPOLLIN, HostSimOnF54Timer, sim);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	period.it_value.tv_sec = 0;
+	period.it_value.tv_nsec = SIM_FRAME_PERIOD_MS * 1000000L;
+	period.it_interval = period.it_value;
+	timerfd_settime(sim->TimerFd, 0, &period, NULL);
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not start the simulated controller - STATUS:%X",
+			status);
+
+		HostSimClose(SpbContext);
+		Attention->Fd = -1;
+	}
+
+	return status;
+}
+
+VOID
+HostSimClose(
+	IN SPB_CONTEXT* SpbContext
+)
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)SpbContext->TransportContext;
+	ULONG i;
+
+	HostSimBusDetach(SpbContext);
+
+	if (SpbContext->SpbLock != NULL)
+	{
+		WdfObjectDelete(SpbContext->SpbLock);
+		SpbContext->SpbLock = NULL;
+	}
+
+	if (sim == NULL)
+	{
+		return;
+	}
+
+	if (sim->TimerFd >= 0)
+	{
+		HostLoopRemove(sim->TimerFd);
+		close(sim->TimerFd);
+	}
+
+	if (sim->F54TimerFd >= 0)
+	{
+		HostLoopRemove(sim->F54TimerFd);
+		close(sim->F54TimerFd);
+	}
+
+	if (sim->AttentionFd >= 0)
+	{
+		close(sim->AttentionFd);
+	}
+
+	if (sim->Frames != NULL)
+	{
+		for (i = 0; i < sim->FrameCount; i++)
+		{
+			free(sim->Frames[i].Reload);
+		}
+	}
+
+	free(sim->Frames);
+	free(sim);
+	SpbContext->TransportContext = NULL;
+}
+
+VOID
+HostSimGetBusStatistics(
+	IN SPB_CONTEXT* SpbContext,
+	OUT PULONG Transfers,
+	OUT PULONG64 BusTime
+)
+/*++
+
+  Routine Description:
+
+	Returns the transfers made so far and the time, in microseconds,
+	they would have kept a 400 kHz I2C bus busy
+
+--*/
+{
+	SIM_CONTEXT* sim = (SIM_CONTEXT*)SpbContext->TransportContext;
+
+	*Transfers = sim->Transfers;
+	*BusTime = sim->BusClocks * 1000 / SIM_BUS_KHZ;
+}
+
+NTSTATUS
+HostSimWriteF34Image(
+	IN HOST_SIM_TOUCH Touch,
+	IN PCSTR Path
+)
+/*++
+
+  Routine Description:
+
+	Writes a firmware image for the simulated controller: a V5 header
+	naming its product, then the firmware and configuration its flash
+	holds, with the Fletcher-32 checksum of the image past the checksum
+	field in the header
+
+--*/
+{
+	PUCHAR image;
+	RMI4_F34_IMAGE_HEADER* header;
+	PCSTR productId = HostSimProductId(Touch);
+	ULONG bytes = RMI4_F34_IMAGE_HEADER_SIZE + SIM_F34_FIRMWARE_BYTES + SIM_F34_CONFIG_BYTES;
+	ULONG sum1 = 0xFFFF;
+	ULONG sum2 = 0xFFFF;
+	ULONG i;
+	FILE* file;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	image = (PUCHAR)calloc(1, bytes);
+
+	if (image == NULL)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	header = (RMI4_F34_IMAGE_HEADER*)image;
+	header->BootloaderVersion = RMI4_F34_IMAGE_BOOTLOADER_V5;
+	header->FirmwareSize = SIM_F34_FIRMWARE_BYTES;
+	header->ConfigSize = SIM_F34_CONFIG_BYTES;
+	RtlCopyMemory(header->ProductId, productId, strlen(productId));
+
+	for (i = 0; i < SIM_F34_FIRMWARE_BYTES + SIM_F34_CONFIG_BYTES; i++)
+	{
+		image[RMI4_F34_IMAGE_HEADER_SIZE + i] = HostSimF34Byte(i);
+	}
+
+	for (i = sizeof(header->Checksum); i < bytes; i += sizeof(USHORT))
+	{
+		sum1 += image[i] | (image[i + 1] << 8);
+		sum2 += sum1;
+		sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+		sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+	}
+
+	header->Checksum = (sum2 << 16) | sum1;
+
+	file = fopen(Path, "wb");
+
+	if (file == NULL)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	if (fwrite(image, 1, bytes, file) != bytes)
+	{
+		status = STATUS_UNSUCCESSFUL;
+	}
+
+	fclose(file);
+
+exit:
+	free(image);
+
+	return status;
+}
@@ -0,0 +1,436 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		simbus.c
+
+	Abstract:
+
+		SPB target in front of the simulated controller. It decodes the
+		I2C or RMI-SPI transfers the driver's own transports send into
+		register accesses of the simulator, so SpbI2cTransport and
+		SpbSpiTransport run unmodified against it. Faults can be injected
+		into single transfers to exercise the transports' error paths.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdlib.h>
+#include <spb.h>
+#include "host.h"
+#include "rmiinternal.h"
+#include "debug.h"
+
+#define SIM_SPI_READ            0x80
+#define SIM_SPI_HEADER_SIZE     2
+
+typedef struct _SIM_BUS
+{
+	//
+	// The simulator, reached through its own transport
+	//
+	SPB_CONTEXT* SpbContext;
+
+	//
+	// I2C device state: the page latched by the last page select
+	// write and the register the address pointer was last set to
+	//
+	UCHAR Page;
+	UCHAR Pointer;
+
+	//
+	// Transfers to go before the injected fault hits, 0 for none
+	//
+	ULONG FaultCountdown;
+	HOST_SIM_BUS_FAULT Fault;
+} SIM_BUS;
+
+static HOST_SIM_BUS_FAULT
+HostSimBusTakeFault(
+	IN SIM_BUS* Bus
+)
+/*++
+
+  Routine Description:
+
+	Counts a transfer and returns the fault it is to suffer
+
+--*/
+{
+	if (Bus->FaultCountdown == 0 || --Bus->FaultCountdown != 0)
+	{
+		return HostSimBusFaultNone;
+	}
+
+	return Bus->Fault;
+}
+
+static NTSTATUS
+HostSimBusI2cWrite(
+	IN PVOID Context,
+	IN PVOID Buffer,
+	IN ULONG Length,
+	OUT PULONG_PTR BytesWritten
+)
+/*++
+
+  Routine Description:
+
+	An I2C write sets the address pointer from its first byte, the
+	remaining bytes are written from there. A write of the page select
+	register latches the page later addresses fall on.
+
+--*/
+{
+	SIM_BUS* bus = (SIM_BUS*)Context;
+	PUCHAR data = (PUCHAR)Buffer;
+	HOST_SIM_BUS_FAULT fault = HostSimBusTakeFault(bus);
+	NTSTATUS status;
+
+	if (Length == 0)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (fault == HostSimBusFaultError)
+	{
+		return STATUS_IO_TIMEOUT;
+	}
+
+	if (fault == HostSimBusFaultShort)
+	{
+		Length = (Length + 1) / 2;
+	}
+
+	bus->Pointer = data[0];
+	status = STATUS_SUCCESS;
+
+	if (Length > 1)
+	{
+		if (bus->Pointer == RMI4_PAGE_SELECT_ADDRESS && Length == 2)
+		{
+			bus->Page = data[1];
+		}
+
+		status = HostSimTransport.Write(
+			bus->SpbContext,
+			(USHORT)((bus->Page << 8) | bus->Pointer),
+			&data[1],
+			Length - 1);
+	}
+
+	*BytesWritten = Length;
+
+	return status;
+}
+
+static NTSTATUS
+HostSimBusI2cRead(
+	IN PVOID Context,
+	IN PVOID Buffer,
+	IN ULONG Length,
+	OUT PULONG_PTR BytesRead
+)
+/*++
+
+  Routine Description:
+
+	An I2C read returns registers from the address pointer on
+
+--*/
+{
+	SIM_BUS* bus = (SIM_BUS*)Context;
+	HOST_SIM_BUS_FAULT fault = HostSimBusTakeFault(bus);
+	NTSTATUS status;
+
+	if (fault == HostSimBusFaultError)
+	{
+		return STATUS_IO_TIMEOUT;
+	}
+
+	if (fault == HostSimBusFaultShort)
+	{
+		Length /= 2;
+	}
+
+	status = HostSimTransport.Read(
+		bus->SpbContext,
+		(USHORT)((bus->Page << 8) | bus->Pointer),
+		Buffer,
+		Length);
+
+	*BytesRead = Length;
+
+	return status;
+}
+
+static NTSTATUS
+HostSimBusSpiWrite(
+	IN PVOID Context,
+	IN PVOID Buffer,
+	IN ULONG Length,
+	OUT PULONG_PTR BytesWritten
+)
+/*++
+
+  Routine Description:
+
+	An RMI-SPI write is a two byte header holding the 16 bit address,
+	the read bit clear, followed by the data
+
+--*/
+{
+	SIM_BUS* bus = (SIM_BUS*)Context;
+	PUCHAR data = (PUCHAR)Buffer;
+	HOST_SIM_BUS_FAULT fault = HostSimBusTakeFault(bus);
+
+	if (Length <= SIM_SPI_HEADER_SIZE || (data[0] & SIM_SPI_READ) != 0)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	if (fault == HostSimBusFaultError)
+	{
+		return STATUS_IO_TIMEOUT;
+	}
+
+	if (fault == HostSimBusFaultShort)
+	{
+		Length = SIM_SPI_HEADER_SIZE + (Length - SIM_SPI_HEADER_SIZE) / 2;
+	}
+
+	*BytesWritten = Length;
+
+	return HostSimTransport.Write(
+		bus->SpbContext,
+		(USHORT)((data[0] << 8) | data[1]),
+		&data[SIM_SPI_HEADER_SIZE],
+		Length - SIM_SPI_HEADER_SIZE);
+}
+
+static NTSTATUS
+HostSimBusSpiIoctl(
+	IN PVOID Context,
+	IN ULONG IoctlCode,
+	IN PVOID Input,
+	IN ULONG InputLength,
+	OUT PULONG_PTR BytesReturned
+)
+/*++
+
+  Routine Description:
+
+	An RMI-SPI read is one sequence: the two byte header with the read
+	bit set, then the data read with chip select still asserted. Any
+	other sequence is a protocol error.
+
+--*/
+{
+	SIM_BUS* bus = (SIM_BUS*)Context;
+	PSPB_TRANSFER_LIST list = (PSPB_TRANSFER_LIST)Input;
+	PSPB_TRANSFER_LIST_ENTRY header;
+	PSPB_TRANSFER_LIST_ENTRY data;
+	HOST_SIM_BUS_FAULT fault;
+	PUCHAR address;
+	ULONG length;
+	NTSTATUS status;
+
+	if (IoctlCode != IOCTL_SPB_EXECUTE_SEQUENCE ||
+		InputLength < FIELD_OFFSET(SPB_TRANSFER_LIST, Transfers) +
+			2 * sizeof(SPB_TRANSFER_LIST_ENTRY) ||
+		list->TransferCount != 2)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	header = &list->Transfers[0];
+	data = &list->Transfers[1];
+	address = (PUCHAR)header->Buffer.Simple.Buffer;
+
+	if (header->Direction != SpbTransferDirectionToDevice ||
+		header->Buffer.Format != SpbTransferBufferFormatSimple ||
+		header->Buffer.Simple.BufferCb != SIM_SPI_HEADER_SIZE ||
+		(address[0] & SIM_SPI_READ) == 0 ||
+		data->Direction != SpbTransferDirectionFromDevice ||
+		data->Buffer.Format != SpbTransferBufferFormatSimple)
+	{
+		return STATUS_INVALID_PARAMETER;
+	}
+
+	fault = HostSimBusTakeFault(bus);
+
+	if (fault == HostSimBusFaultError)
+	{
+		return STATUS_IO_TIMEOUT;
+	}
+
+	length = data->Buffer.Simple.BufferCb;
+
+	if (fault == HostSimBusFaultShort)
+	{
+		length /= 2;
+	}
+
+	status = HostSimTransport.Read(
+		bus->SpbContext,
+		(USHORT)(((address[0] & ~SIM_SPI_READ) << 8) | address[1]),
+		data->Buffer.Simple.Buffer,
+		length);
+
+	*BytesReturned = SIM_SPI_HEADER_SIZE + length;
+
+	return status;
+}
+
+static const HOST_IO_TARGET_OPS HostSimBusI2cOps =
+{
+	HostSimBusI2cRead,
+	HostSimBusI2cWrite,
+	NULL
+};
+
+static const HOST_IO_TARGET_OPS HostSimBusSpiOps =
+{
+	NULL,
+	HostSimBusSpiWrite,
+	HostSimBusSpiIoctl
+};
+
+NTSTATUS
+HostSimBusAttach(
+	IN HOST_SIM_BUS Bus,
+	IN OUT SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Puts the SPB target of Bus between the driver's transport for that
+	bus and the simulator transport SpbContext was opened with
+
+  Arguments:
+
+	Bus - bus to simulate
+	SpbContext - simulator transport, receives the driver's transport,
+		the target and the default transfer buffers
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	SIM_BUS* bus;
+	NTSTATUS status;
+
+	bus = (SIM_BUS*)calloc(1, sizeof(SIM_BUS));
+
+	if (bus == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	bus->SpbContext = SpbContext;
+
+	status = HostIoTargetCreate(
+		(Bus == HostSimBusSpi) ? &HostSimBusSpiOps : &HostSimBusI2cOps,
+		bus,
+		&SpbContext->SpbIoTarget);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	bus = NULL;
+
+	status = WdfMemoryCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		NonPagedPool,
+		TOUCH_POOL_TAG,
+		DEFAULT_SPB_BUFFER_SIZE,
+		&SpbContext->WriteMemory,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfMemoryCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		NonPagedPool,
+		TOUCH_POOL_TAG,
+		DEFAULT_SPB_BUFFER_SIZE,
+		&SpbContext->ReadMemory,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	SpbContext->Transport = (Bus == HostSimBusSpi) ? &SpbSpiTransport : &SpbI2cTransport;
+
+exit:
+
+	free(bus);
+
+	return status;
+}
+
+VOID
+HostSimBusDetach(
+	IN OUT SPB_CONTEXT* SpbContext
+)
+{
+	if (SpbContext->ReadMemory != NULL)
+	{
+		WdfObjectDelete(SpbContext->ReadMemory);
+		SpbContext->ReadMemory = NULL;
+	}
+
+	if (SpbContext->WriteMemory != NULL)
+	{
+		WdfObjectDelete(SpbContext->WriteMemory);
+		SpbContext->WriteMemory = NULL;
+	}
+
+	if (SpbContext->SpbIoTarget != NULL)
+	{
+		free(HostIoTargetGetContext(SpbContext->SpbIoTarget));
+		WdfObjectDelete(SpbContext->SpbIoTarget);
+		SpbContext->SpbIoTarget = NULL;
+	}
+
+	SpbContext->Transport = &HostSimTransport;
+}
+
+VOID
+HostSimBusInjectFault(
+	IN SPB_CONTEXT* SpbContext,
+	IN ULONG Transfer,
+	IN HOST_SIM_BUS_FAULT Fault
+)
+/*++
+
+  Routine Description:
+
+	Makes the Transfer-th bus transfer from now suffer Fault, 1 being
+	the next one. Only one fault is pending at a time.
+
+--*/
+{
+	SIM_BUS* bus = (SIM_BUS*)HostIoTargetGetContext(SpbContext->SpbIoTarget);
+
+	bus->FaultCountdown = Transfer;
+	bus->Fault = Fault;
+}
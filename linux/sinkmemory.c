@@ -0,0 +1,193 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		sinkmemory.c
+
+	Abstract:
+
+		Report sink keeping every report in memory, optionally printed
+		one line per report when the sink is closed. Used to exercise the
+		core against the simulator without an input subsystem.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host.h"
+#include "hid.h"
+#include "debug.h"
+
+typedef struct _MEMORY_SINK_CONTEXT
+{
+	HID_INPUT_REPORT* Reports;
+	ULONG Count;
+	ULONG Capacity;
+	BOOLEAN Dump;
+} MEMORY_SINK_CONTEXT;
+
+static NTSTATUS
+MemorySinkReport(
+	IN HOST_SINK* Sink,
+	IN const HID_INPUT_REPORT* Report
+)
+{
+	MEMORY_SINK_CONTEXT* context = (MEMORY_SINK_CONTEXT*)Sink->Context;
+	HID_INPUT_REPORT* reports;
+	ULONG capacity;
+
+	if (context->Count == context->Capacity)
+	{
+		capacity = max(context->Capacity * 2, 64);
+		reports = (HID_INPUT_REPORT*)realloc(
+			context->Reports,
+			capacity * sizeof(HID_INPUT_REPORT));
+
+		if (reports == NULL)
+		{
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		context->Reports = reports;
+		context->Capacity = capacity;
+	}
+
+	context->Reports[context->Count++] = *Report;
+
+	return STATUS_SUCCESS;
+}
+
+static VOID
+MemorySinkDump(
+	IN MEMORY_SINK_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Prints the reports, each with the contacts or keys it carries. In
+	hybrid mode the first report of a frame gives the contact count and
+	the ones following it carry the rest.
+
+--*/
+{
+	const HID_INPUT_REPORT* report;
+	const HID_CONTACT_POINT* contact;
+	ULONG remaining = 0;
+	ULONG carried;
+	ULONG i;
+	ULONG j;
+
+	for (i = 0; i < Context->Count; i++)
+	{
+		report = &Context->Reports[i];
+
+		if (report->ReportID != REPORTID_MTOUCH)
+		{
+			printf("report %u id %u keys 0x%02X\n", i, report->ReportID, report->KeyReport.bKeys);
+			continue;
+		}
+
+		if (report->TouchReport.InputReport.ActualCount != 0)
+		{
+			remaining = report->TouchReport.InputReport.ActualCount;
+		}
+
+		carried = min(remaining, SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT);
+		remaining -= carried;
+
+		printf(
+			"report %u touch count %u scan %u",
+			i,
+			report->TouchReport.InputReport.ActualCount,
+			report->TouchReport.InputReport.ScanTime);
+
+		for (j = 0; j < carried; j++)
+		{
+			contact = &report->TouchReport.InputReport.Contacts[j];
+
+			printf(
+				" [id %u tip %u x %u y %u]",
+				contact->ContactId,
+				contact->bStatus & FINGER_STATUS,
+				contact->wXData,
+				contact->wYData);
+		}
+
+		printf("\n");
+	}
+}
+
+static VOID
+MemorySinkClose(
+	IN HOST_SINK* Sink
+)
+{
+	MEMORY_SINK_CONTEXT* context = (MEMORY_SINK_CONTEXT*)Sink->Context;
+
+	if (context == NULL)
+	{
+		return;
+	}
+
+	if (context->Dump)
+	{
+		MemorySinkDump(context);
+	}
+
+	free(context->Reports);
+	free(context);
+	Sink->Context = NULL;
+}
+
+static const HOST_SINK_OPS MemorySinkOps =
+{
+	"memory",
+	MemorySinkReport,
+	MemorySinkClose
+};
+
+NTSTATUS
+HostMemorySinkOpen(
+	IN const HOST_SINK_PROPERTIES* Properties,
+	IN BOOLEAN Dump,
+	OUT HOST_SINK* Sink
+)
+{
+	MEMORY_SINK_CONTEXT* context;
+
+	UNREFERENCED_PARAMETER(Properties);
+
+	Sink->Ops = &MemorySinkOps;
+	Sink->Context = NULL;
+
+	context = (MEMORY_SINK_CONTEXT*)calloc(1, sizeof(MEMORY_SINK_CONTEXT));
+
+	if (context == NULL)
+	{
+		return STATUS_INSUFFICIENT_RESOURCES;
+	}
+
+	context->Dump = Dump;
+	Sink->Context = context;
+
+	return STATUS_SUCCESS;
+}
+
+ULONG
+HostMemorySinkGetCount(
+	IN HOST_SINK* Sink
+)
+{
+	NT_ASSERT(Sink->Ops == &MemorySinkOps);
+
+	return ((MEMORY_SINK_CONTEXT*)Sink->Context)->Count;
+}
@@ -0,0 +1,315 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		sinkuinput.c
+
+	Abstract:
+
+		Report sink creating a uinput touchscreen. Touch reports are
+		translated to the multi-touch slot protocol: a HID frame spans
+		one report per SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT
+		contacts, the first carrying the frame's contact count, and is
+		emitted as one input frame.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/uinput.h>
+#include "host.h"
+#include "hid.h"
+#include "debug.h"
+
+typedef struct _UINPUT_SINK_CONTEXT
+{
+	int Fd;
+	ULONG MaxContacts;
+
+	//
+	// Contacts still expected for the frame being assembled
+	//
+	ULONG Pending;
+
+	int NextTrackingId;
+	int* TrackingIds;
+} UINPUT_SINK_CONTEXT;
+
+static VOID
+UinputEmit(
+	IN UINPUT_SINK_CONTEXT* Context,
+	IN USHORT Type,
+	IN USHORT Code,
+	IN int Value
+)
+{
+	struct input_event event;
+
+	RtlZeroMemory(&event, sizeof(event));
+	event.type = Type;
+	event.code = Code;
+	event.value = Value;
+
+	if (write(Context->Fd, &event, sizeof(event)) != sizeof(event))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REPORTING,
+			"Could not write input event - errno %d",
+			errno);
+	}
+}
+
+static NTSTATUS
+UinputSinkReport(
+	IN HOST_SINK* Sink,
+	IN const HID_INPUT_REPORT* Report
+)
+{
+	UINPUT_SINK_CONTEXT* context = (UINPUT_SINK_CONTEXT*)Sink->Context;
+	const HID_CONTACT_POINT* contact;
+	BOOLEAN touching;
+	ULONG count;
+	ULONG i;
+	ULONG j;
+
+	//
+	// Key and mouse collections are not exposed by this device
+	//
+	if (Report->ReportID != REPORTID_MTOUCH)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	if (Report->TouchReport.InputReport.ActualCount != 0)
+	{
+		context->Pending = Report->TouchReport.InputReport.ActualCount;
+	}
+
+	count = min(context->Pending, SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT);
+
+	for (i = 0; i < count; i++)
+	{
+		contact = &Report->TouchReport.InputReport.Contacts[i];
+
+		if (contact->ContactId >= context->MaxContacts)
+		{
+			continue;
+		}
+
+		UinputEmit(context, EV_ABS, ABS_MT_SLOT, contact->ContactId);
+
+		if (contact->bStatus & FINGER_STATUS)
+		{
+			if (context->TrackingIds[contact->ContactId] < 0)
+			{
+				context->TrackingIds[contact->ContactId] = context->NextTrackingId;
+				context->NextTrackingId = (context->NextTrackingId + 1) & 0xFFFF;
+
+				UinputEmit(
+					context,
+					EV_ABS,
+					ABS_MT_TRACKING_ID,
+					context->TrackingIds[contact->ContactId]);
+			}
+
+			UinputEmit(context, EV_ABS, ABS_MT_POSITION_X, contact->wXData);
+			UinputEmit(context, EV_ABS, ABS_MT_POSITION_Y, contact->wYData);
+		}
+		else if (context->TrackingIds[contact->ContactId] >= 0)
+		{
+			context->TrackingIds[contact->ContactId] = -1;
+			UinputEmit(context, EV_ABS, ABS_MT_TRACKING_ID, -1);
+		}
+	}
+
+	context->Pending -= count;
+
+	if (context->Pending == 0)
+	{
+		touching = FALSE;
+
+		for (j = 0; j < context->MaxContacts; j++)
+		{
+			if (context->TrackingIds[j] >= 0)
+			{
+				touching = TRUE;
+				break;
+			}
+		}
+
+		UinputEmit(context, EV_KEY, BTN_TOUCH, touching ? 1 : 0);
+		UinputEmit(context, EV_SYN, SYN_REPORT, 0);
+	}
+
+	return STATUS_SUCCESS;
+}
+
+static VOID
+UinputSinkClose(
+	IN HOST_SINK* Sink
+)
+{
+	UINPUT_SINK_CONTEXT* context = (UINPUT_SINK_CONTEXT*)Sink->Context;
+
+	if (context == NULL)
+	{
+		return;
+	}
+
+	if (context->Fd >= 0)
+	{
+		ioctl(context->Fd, UI_DEV_DESTROY);
+		close(context->Fd);
+	}
+
+	free(context->TrackingIds);
+	free(context);
+	Sink->Context = NULL;
+}
+
+static const HOST_SINK_OPS UinputSinkOps =
+{
+	"uinput",
+	UinputSinkReport,
+	UinputSinkClose
+};
+
+static int
+UinputSetAbs(
+	IN int Fd,
+	IN USHORT Code,
+	IN int Maximum
+)
+{
+	struct uinput_abs_setup abs;
+
+	RtlZeroMemory(&abs, sizeof(abs));
+	abs.code = Code;
+	abs.absinfo.maximum = Maximum;
+
+	if (ioctl(Fd, UI_SET_ABSBIT, Code) < 0)
+	{
+		return -1;
+	}
+
+	return ioctl(Fd, UI_ABS_SETUP, &abs);
+}
+
+NTSTATUS
+HostUinputSinkOpen(
+	IN PCSTR Path,
+	IN const HOST_SINK_PROPERTIES* Properties,
+	OUT HOST_SINK* Sink
+)
+/*++
+
+  Routine Description:
+
+	Creates a direct touch input device through uinput
+
+  Arguments:
+
+	Path       - uinput device, normally /dev/uinput
+	Properties - coordinate extents and contact count
+	Sink       - receives the sink
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	UINPUT_SINK_CONTEXT* context;
+	struct uinput_setup setup;
+	NTSTATUS status;
+	ULONG i;
+
+	Sink->Ops = &UinputSinkOps;
+	Sink->Context = NULL;
+
+	context = (UINPUT_SINK_CONTEXT*)calloc(1, sizeof(UINPUT_SINK_CONTEXT));
+
+	if (context == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	Sink->Context = context;
+	context->MaxContacts = max(Properties->MaxContacts, 1);
+	context->TrackingIds = (int*)malloc(context->MaxContacts * sizeof(int));
+	context->Fd = open(Path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+
+	if (context->TrackingIds == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	for (i = 0; i < context->MaxContacts; i++)
+	{
+		context->TrackingIds[i] = -1;
+	}
+
+	if (context->Fd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	if (ioctl(context->Fd, UI_SET_EVBIT, EV_KEY) < 0 ||
+		ioctl(context->Fd, UI_SET_KEYBIT, BTN_TOUCH) < 0 ||
+		ioctl(context->Fd, UI_SET_EVBIT, EV_ABS) < 0 ||
+		ioctl(context->Fd, UI_SET_PROPBIT, INPUT_PROP_DIRECT) < 0 ||
+		UinputSetAbs(context->Fd, ABS_MT_SLOT, (int)context->MaxContacts - 1) < 0 ||
+		UinputSetAbs(context->Fd, ABS_MT_TRACKING_ID, 0xFFFF) < 0 ||
+		UinputSetAbs(context->Fd, ABS_MT_POSITION_X, (int)max(Properties->Width, 1) - 1) < 0 ||
+		UinputSetAbs(context->Fd, ABS_MT_POSITION_Y, (int)max(Properties->Height, 1) - 1) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	RtlZeroMemory(&setup, sizeof(setup));
+	setup.id.bustype = BUS_I2C;
+	setup.id.vendor = 0x06CB;
+	strncpy(setup.name, "Synaptics RMI4 Touch Screen", UINPUT_MAX_NAME_SIZE - 1);
+
+	if (ioctl(context->Fd, UI_DEV_SETUP, &setup) < 0 ||
+		ioctl(context->Fd, UI_DEV_CREATE) < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	status = STATUS_SUCCESS;
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not create uinput device on %s - STATUS:%X",
+			Path,
+			status);
+
+		UinputSinkClose(Sink);
+	}
+
+	return status;
+}
@@ -0,0 +1,866 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testbacklight.c
+
+	Abstract:
+
+		Checks the capacitive button backlight against a light sensor and
+		LEDs served by the checks themselves. Sensor reads stay pending
+		until a check publishes a sample or fails them, so the streaming
+		read, its retry after an error, the lux hysteresis band and the
+		minimum interval between intensity changes are all driven step by
+		step. The LEDs record every update they receive and can hold
+		updates pending, so the fade engine is checked tick by tick.
+		Time is moved forward with the host clock rather than waited out.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include "rmitest.h"
+#include "rmiinternal.h"
+
+#define TEST_ALS_NAME L"\\??\\TestAmbientLight"
+#define TEST_HWN_NAME L"\\??\\TestNotificationLed"
+
+#define TEST_HUNDRED_NS_PER_MS 10000ULL
+
+//
+// Light sensor. One read is held at a time, as the sensor class
+// extension holds it for a sampling interval.
+//
+typedef struct _TEST_ALS
+{
+	BOOLEAN Started;
+	ULONG IntervalUs;
+	WDFREQUEST Read;
+	ULONG Reads;
+	ULONG Cancels;
+} TEST_ALS;
+
+//
+// LEDs, the intensity of the first LED in the last update. Asynchronous
+// updates are held pending while Hold is set.
+//
+typedef struct _TEST_HWN
+{
+	ULONG Updates;
+	ULONG Sent;
+	ULONG Intensity;
+	ULONG OffOnBlink;
+	BOOLEAN Hold;
+	WDFREQUEST Held;
+} TEST_HWN;
+
+static TEST_ALS gAls;
+static TEST_HWN gHwn;
+
+static NTSTATUS
+TestAlsIoctl(
+	IN PVOID Context,
+	IN ULONG IoctlCode,
+	IN PVOID Input,
+	IN ULONG InputLength,
+	OUT PULONG_PTR BytesReturned
+)
+{
+	TEST_ALS* als = (TEST_ALS*)Context;
+	SENSOR_NOTIFICATION* configuration;
+
+	*BytesReturned = 0;
+
+	switch (IoctlCode)
+	{
+	case IOCTL_SENSOR_CLX_NOTIFICATION_CONFIGURE:
+		if (InputLength < sizeof(SENSOR_NOTIFICATION))
+		{
+			return STATUS_BUFFER_TOO_SMALL;
+		}
+
+		configuration = (SENSOR_NOTIFICATION*)Input;
+		als->IntervalUs = configuration->IntervalUs;
+		return STATUS_SUCCESS;
+
+	case IOCTL_SENSOR_CLX_NOTIFICATION_START:
+		als->Started = TRUE;
+		return STATUS_SUCCESS;
+
+	case IOCTL_SENSOR_CLX_NOTIFICATION_STOP:
+		als->Started = FALSE;
+		return STATUS_SUCCESS;
+
+	default:
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+}
+
+static NTSTATUS
+TestAlsSend(
+	IN PVOID Context,
+	IN WDFREQUEST Request
+)
+{
+	TEST_ALS* als = (TEST_ALS*)Context;
+	WDF_REQUEST_TYPE type;
+	ULONG ioctlCode;
+	PVOID buffer;
+	ULONG length;
+
+	HostRequestGetParameters(Request, &type, &ioctlCode, &buffer, &length);
+
+	if (type != WdfRequestTypeRead || length < sizeof(ALS_DATA) || als->Read != NULL)
+	{
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	als->Read = Request;
+	als->Reads++;
+
+	return STATUS_PENDING;
+}
+
+static VOID
+TestAlsCancel(
+	IN PVOID Context,
+	IN WDFREQUEST Request
+)
+{
+	TEST_ALS* als = (TEST_ALS*)Context;
+
+	if (als->Read == Request)
+	{
+		als->Read = NULL;
+		als->Cancels++;
+	}
+}
+
+static const HOST_IO_TARGET_OPS gAlsOps =
+{
+	NULL,
+	NULL,
+	TestAlsIoctl,
+	TestAlsSend,
+	TestAlsCancel
+};
+
+static NTSTATUS
+TestHwnIoctl(
+	IN PVOID Context,
+	IN ULONG IoctlCode,
+	IN PVOID Input,
+	IN ULONG InputLength,
+	OUT PULONG_PTR BytesReturned
+)
+{
+	TEST_HWN* hwn = (TEST_HWN*)Context;
+	HWN_HEADER* header = (HWN_HEADER*)Input;
+
+	*BytesReturned = 0;
+
+	if (IoctlCode != IOCTL_HWN_SET_STATE)
+	{
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	if (InputLength < HWN_HEADER_SIZE + sizeof(HWN_SETTINGS) ||
+		header->HwNPayloadSize != InputLength)
+	{
+		return STATUS_INVALID_BUFFER_SIZE;
+	}
+
+	hwn->Updates++;
+	hwn->Intensity = header->HwNSettingsInfo[0].HwNSettings[HWN_INTENSITY];
+	hwn->OffOnBlink = header->HwNSettingsInfo[0].OffOnBlink;
+
+	return STATUS_SUCCESS;
+}
+
+static NTSTATUS
+TestHwnSend(
+	IN PVOID Context,
+	IN WDFREQUEST Request
+)
+{
+	TEST_HWN* hwn = (TEST_HWN*)Context;
+	WDF_REQUEST_TYPE type;
+	ULONG ioctlCode;
+	PVOID buffer;
+	ULONG length;
+	ULONG_PTR bytesReturned;
+
+	HostRequestGetParameters(Request, &type, &ioctlCode, &buffer, &length);
+
+	if (type != WdfRequestTypeDeviceControl || hwn->Held != NULL)
+	{
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	hwn->Sent++;
+
+	if (hwn->Hold)
+	{
+		hwn->Held = Request;
+		return STATUS_PENDING;
+	}
+
+	return TestHwnIoctl(Context, ioctlCode, buffer, length, &bytesReturned);
+}
+
+static VOID
+TestHwnCancel(
+	IN PVOID Context,
+	IN WDFREQUEST Request
+)
+{
+	TEST_HWN* hwn = (TEST_HWN*)Context;
+
+	if (hwn->Held == Request)
+	{
+		hwn->Held = NULL;
+	}
+}
+
+static const HOST_IO_TARGET_OPS gHwnOps =
+{
+	NULL,
+	NULL,
+	TestHwnIoctl,
+	TestHwnSend,
+	TestHwnCancel
+};
+
+static VOID
+TestHwnRelease(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Applies and completes the held update
+
+--*/
+{
+	WDFREQUEST request = gHwn.Held;
+	WDF_REQUEST_TYPE type;
+	ULONG ioctlCode;
+	PVOID buffer;
+	ULONG length;
+	ULONG_PTR bytesReturned;
+	NTSTATUS status;
+
+	if (request == NULL)
+	{
+		TestFail(__FILE__, __LINE__, "update held");
+		return;
+	}
+
+	gHwn.Held = NULL;
+
+	HostRequestGetParameters(request, &type, &ioctlCode, &buffer, &length);
+	status = TestHwnIoctl(&gHwn, ioctlCode, buffer, length, &bytesReturned);
+	HostRequestComplete(request, status, 0);
+}
+
+static VOID
+TestAlsComplete(
+	IN BKL_CONTEXT* Context,
+	IN NTSTATUS Status,
+	IN ULONG Sample
+)
+/*++
+
+  Routine Description:
+
+	Completes the pending read with Sample, or fails it with Status,
+	and runs the work item the completion queues
+
+--*/
+{
+	WDFREQUEST read = gAls.Read;
+	WDF_REQUEST_TYPE type;
+	ULONG ioctlCode;
+	ALS_DATA* data;
+	ULONG length;
+
+	if (read == NULL)
+	{
+		TestFail(__FILE__, __LINE__, "read pending");
+		return;
+	}
+
+	gAls.Read = NULL;
+
+	HostRequestGetParameters(read, &type, &ioctlCode, (PVOID*)&data, &length);
+
+	if (NT_SUCCESS(Status))
+	{
+		RtlZeroMemory(data, sizeof(ALS_DATA));
+		data->Header.Size = sizeof(ALS_DATA);
+		data->Header.DataType = SENSOR_DATA_AMBIENT_LIGHT;
+		data->Sample = Sample;
+	}
+
+	HostRequestComplete(read, Status, NT_SUCCESS(Status) ? sizeof(ALS_DATA) : 0);
+
+	WdfWorkItemFlush(Context->TchBklPollAlsWorkItem);
+}
+
+static VOID
+TestAlsPublish(
+	IN BKL_CONTEXT* Context,
+	IN ULONG Sample
+)
+{
+	TestAlsComplete(Context, STATUS_SUCCESS, Sample);
+}
+
+static VOID
+TestBacklightAdvance(
+	IN ULONG Milliseconds
+)
+{
+	HostClockAdvance(Milliseconds * TEST_HUNDRED_NS_PER_MS);
+}
+
+static VOID
+TestBacklightStart(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Enabling the backlight configures and starts the sensor, lights
+	the LEDs at the default intensity and sends the first read
+
+--*/
+{
+	TEST_CHECK(gAls.Started);
+	TEST_CHECK(gAls.IntervalUs == BKL_ALS_SAMPLING_INTERVAL);
+	TEST_CHECK(gAls.Read != NULL);
+	TEST_CHECK(gAls.Reads == 1);
+	TEST_CHECK(Context->TchBklPollAls);
+	TEST_CHECK(Context->TargetBklIntensity == BKL_DEFAULT_INTENSITY);
+	TEST_CHECK(gHwn.Updates == 1);
+	TEST_CHECK(gHwn.Intensity == BKL_DEFAULT_INTENSITY);
+	TEST_CHECK(gHwn.OffOnBlink == HWN_ON);
+}
+
+static VOID
+TestBacklightRead(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Each completed read is mapped through the lux table and followed by
+	the next read. The first sample is applied whatever the last update.
+
+--*/
+{
+	TestAlsPublish(Context, 150000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 1);
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+	TEST_CHECK(gHwn.Intensity == 10);
+	TEST_CHECK(gAls.Read != NULL);
+	TEST_CHECK(gAls.Reads == 2);
+}
+
+static VOID
+TestBacklightRetry(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	A read the sensor fails is retried from the retry timer rather than
+	right away, and so is one that cannot be sent at all
+
+--*/
+{
+	ULONG reads = gAls.Reads;
+
+	TestAlsComplete(Context, STATUS_DEVICE_NOT_READY, 0);
+
+	TEST_CHECK(Context->AlsStatus == STATUS_DEVICE_NOT_READY);
+	TEST_CHECK(gAls.Read == NULL);
+	TEST_CHECK(gAls.Reads == reads);
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+
+	TEST_CHECK(HostTimerFire(Context->AlsRetryTimer));
+	TEST_CHECK(gAls.Read != NULL);
+	TEST_CHECK(gAls.Reads == reads + 1);
+
+	//
+	// Stopping the target cancels the read, the cancelled read is
+	// retried too
+	//
+	WdfIoTargetStop(Context->AlsIoTarget, WdfIoTargetCancelSentIo);
+	WdfWorkItemFlush(Context->TchBklPollAlsWorkItem);
+
+	TEST_CHECK(gAls.Cancels == 1);
+	TEST_CHECK(Context->AlsStatus == STATUS_CANCELLED);
+
+	//
+	// The retry cannot be sent to the stopped target and arms the timer
+	// again
+	//
+	TEST_CHECK(HostTimerFire(Context->AlsRetryTimer));
+	TEST_CHECK(Context->AlsStatus == STATUS_INVALID_DEVICE_STATE);
+	TEST_CHECK(!Context->AlsReadPending);
+	TEST_CHECK(gAls.Reads == reads + 1);
+
+	WdfIoTargetStart(Context->AlsIoTarget);
+
+	TEST_CHECK(HostTimerFire(Context->AlsRetryTimer));
+	TEST_CHECK(gAls.Read != NULL);
+	TEST_CHECK(gAls.Reads == reads + 2);
+	TEST_CHECK(!HostTimerFire(Context->AlsRetryTimer));
+}
+
+static VOID
+TestBacklightHysteresis(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	A reading within BKL_LUX_HYSTERESIS_PERCENT of the current band
+	keeps its level, one further out moves to the level it falls in
+
+--*/
+{
+	TestBacklightAdvance(BKL_MIN_UPDATE_INTERVAL);
+
+	//
+	// Level 1 runs from 100000 to 200000 millilux, its band to 220000
+	//
+	TestAlsPublish(Context, 215000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 1);
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+
+	TestAlsPublish(Context, 95000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 1);
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+
+	TestAlsPublish(Context, 225000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 2);
+	TEST_CHECK(Context->TargetBklIntensity == 25);
+	TEST_CHECK(gHwn.Intensity == 25);
+}
+
+static VOID
+TestBacklightInterval(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	A reading outside the band is held until BKL_MIN_UPDATE_INTERVAL
+	has passed since the last intensity change
+
+--*/
+{
+	ULONG updates = gHwn.Updates;
+
+	TestAlsPublish(Context, 50000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 2);
+	TEST_CHECK(Context->TargetBklIntensity == 25);
+
+	TestBacklightAdvance(BKL_MIN_UPDATE_INTERVAL - 1);
+	TestAlsPublish(Context, 50000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 25);
+	TEST_CHECK(gHwn.Updates == updates);
+
+	TestBacklightAdvance(1);
+	TestAlsPublish(Context, 50000);
+
+	TEST_CHECK(Context->AlsLuxLevel == 0);
+	TEST_CHECK(Context->TargetBklIntensity == 5);
+	TEST_CHECK(gHwn.Intensity == 5);
+	TEST_CHECK(gHwn.Updates == updates + 1);
+
+	//
+	// Level 0 runs up to 100000 millilux, its band to 110000
+	//
+	TestBacklightAdvance(BKL_MIN_UPDATE_INTERVAL);
+	TestAlsPublish(Context, 105000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 5);
+
+	TestAlsPublish(Context, 120000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+}
+
+static VOID
+TestBacklightOff(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Turning the monitor off cancels the read and stops the sensor, and
+	the cancelled read is not followed by another
+
+--*/
+{
+	ULONG reads = gAls.Reads;
+	ULONG state = MONITOR_IS_OFF;
+
+	TchOnMonitorStateChange(&GUID_MONITOR_POWER_ON, &state, sizeof(state), Context);
+	WdfWorkItemFlush(Context->TchBklPollAlsWorkItem);
+
+	TEST_CHECK(!Context->TchBklPollAls);
+	TEST_CHECK(!gAls.Started);
+	TEST_CHECK(gAls.Read == NULL);
+	TEST_CHECK(gAls.Cancels == 2);
+	TEST_CHECK(gAls.Reads == reads);
+	TEST_CHECK(!HostTimerFire(Context->AlsRetryTimer));
+	TEST_CHECK(gHwn.Intensity == 0);
+	TEST_CHECK(gHwn.OffOnBlink == HWN_OFF);
+
+	state = MONITOR_IS_ON;
+
+	TchOnMonitorStateChange(&GUID_MONITOR_POWER_ON, &state, sizeof(state), Context);
+
+	TEST_CHECK(gAls.Started);
+	TEST_CHECK(gAls.Read != NULL);
+	TEST_CHECK(gAls.Reads == reads + 1);
+	TEST_CHECK(Context->TargetBklIntensity == BKL_DEFAULT_INTENSITY);
+}
+
+static ULONG
+TestBacklightFadeTo(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Ticks the fade engine until it stops re-arming its timer. Every tick
+	sends at most one update, and each update moves the LEDs towards the
+	target without overshooting it.
+
+  Return Value:
+
+	Number of ticks taken
+
+--*/
+{
+	ULONG from = gHwn.Intensity;
+	ULONG target = Context->TargetBklIntensity;
+	ULONG ticks = 0;
+	ULONG updates;
+	ULONG last;
+
+	for (;;)
+	{
+		TestBacklightAdvance(BKL_FADE_TICK);
+
+		updates = gHwn.Updates;
+		last = gHwn.Intensity;
+
+		if (!HostTimerFire(Context->FadeTimer))
+		{
+			break;
+		}
+
+		ticks++;
+
+		TEST_CHECK(gHwn.Updates - updates <= 1);
+
+		if (target >= from)
+		{
+			TEST_CHECK(gHwn.Intensity >= last && gHwn.Intensity <= target);
+		}
+		else
+		{
+			TEST_CHECK(gHwn.Intensity <= last && gHwn.Intensity >= target);
+		}
+
+		if (ticks > Context->FadeTime / BKL_FADE_TICK + 2)
+		{
+			TestFail(__FILE__, __LINE__, "fade ends within FadeTime");
+			break;
+		}
+	}
+
+	TEST_CHECK(gHwn.Intensity == target);
+	TEST_CHECK(Context->CurrentBklIntensity == target);
+
+	return ticks;
+}
+
+static VOID
+TestBacklightFade(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Intensity changes fade over FadeTime with one IOCTL_HWN_SET_STATE
+	per tick, and the fade timer is left idle once the target is reached
+
+--*/
+{
+	ULONG updates;
+	ULONG ticks;
+
+	//
+	// Enabling fades up to the default intensity
+	//
+	ticks = TestBacklightFadeTo(Context);
+
+	TEST_CHECK(ticks > 1);
+	TEST_CHECK(gHwn.Updates > 1);
+	TEST_CHECK(gHwn.Updates <= ticks + 1);
+	TEST_CHECK(gHwn.Intensity == BKL_DEFAULT_INTENSITY);
+
+	//
+	// Idle, nothing ticks until the target changes
+	//
+	updates = gHwn.Updates;
+	TestBacklightAdvance(Context->FadeTime);
+
+	TEST_CHECK(!HostTimerFire(Context->FadeTimer));
+	TEST_CHECK(gHwn.Updates == updates);
+
+	TestAlsPublish(Context, 250000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 25);
+	TEST_CHECK(gHwn.Intensity < 25);
+
+	TestBacklightFadeTo(Context);
+
+	TEST_CHECK(gHwn.Updates > updates + 1);
+	TEST_CHECK(!HostTimerFire(Context->FadeTimer));
+}
+
+static VOID
+TestBacklightFadePending(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	While an update is still pending the fade engine keeps ticking
+	without sending another, and resumes once the update completes
+
+--*/
+{
+	ULONG sent;
+
+	TestBacklightAdvance(BKL_MIN_UPDATE_INTERVAL);
+	TestAlsPublish(Context, 50000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 5);
+
+	gHwn.Hold = TRUE;
+	sent = gHwn.Sent;
+
+	//
+	// The first tick that moves the LEDs holds its update
+	//
+	while (gHwn.Held == NULL)
+	{
+		TestBacklightAdvance(BKL_FADE_TICK);
+
+		if (!HostTimerFire(Context->FadeTimer))
+		{
+			TestFail(__FILE__, __LINE__, "fade timer armed");
+			return;
+		}
+	}
+
+	TEST_CHECK(Context->HwnRequestPending != 0);
+	TEST_CHECK(gHwn.Sent == sent + 1);
+
+	//
+	// Past FadeTime the target would be applied, but the buffer is
+	// still owned by the held update
+	//
+	TestBacklightAdvance(Context->FadeTime);
+
+	TEST_CHECK(HostTimerFire(Context->FadeTimer));
+	TEST_CHECK(HostTimerFire(Context->FadeTimer));
+	TEST_CHECK(gHwn.Sent == sent + 1);
+	TEST_CHECK(Context->CurrentBklIntensity != 5);
+
+	gHwn.Hold = FALSE;
+	TestHwnRelease();
+
+	TEST_CHECK(Context->HwnRequestPending == 0);
+
+	TEST_CHECK(HostTimerFire(Context->FadeTimer));
+	TEST_CHECK(gHwn.Sent == sent + 2);
+	TEST_CHECK(gHwn.Intensity == 5);
+	TEST_CHECK(!HostTimerFire(Context->FadeTimer));
+}
+
+static VOID
+TestBacklightFlushFade(
+	IN BKL_CONTEXT* Context
+)
+/*++
+
+  Routine Description:
+
+	Flushing a fade cancels the held update and applies the target in
+	a single synchronous update, with nothing left to tick
+
+--*/
+{
+	ULONG updates;
+
+	TestBacklightAdvance(BKL_MIN_UPDATE_INTERVAL);
+	TestAlsPublish(Context, 150000);
+
+	TEST_CHECK(Context->TargetBklIntensity == 10);
+
+	gHwn.Hold = TRUE;
+
+	while (gHwn.Held == NULL)
+	{
+		TestBacklightAdvance(BKL_FADE_TICK);
+
+		if (!HostTimerFire(Context->FadeTimer))
+		{
+			TestFail(__FILE__, __LINE__, "fade timer armed");
+			return;
+		}
+	}
+
+	updates = gHwn.Updates;
+
+	TchBklFlushFade(Context);
+
+	TEST_CHECK(gHwn.Held == NULL);
+	TEST_CHECK(Context->HwnRequestPending == 0);
+	TEST_CHECK(gHwn.Updates == updates + 1);
+	TEST_CHECK(gHwn.Intensity == 10);
+	TEST_CHECK(Context->CurrentBklIntensity == 10);
+	TEST_CHECK(!HostTimerFire(Context->FadeTimer));
+
+	gHwn.Hold = FALSE;
+}
+
+VOID
+TestBacklight(
+	VOID
+)
+{
+	BKL_LUX_TABLE_ENTRY luxTable[BKL_MAX_LEVELS];
+	BKL_CONTEXT* context;
+	WDFDEVICE device;
+	ULONG luxLevels;
+
+	RtlZeroMemory(&gAls, sizeof(gAls));
+	RtlZeroMemory(&gHwn, sizeof(gHwn));
+
+	if (HostLoopInitialize() != STATUS_SUCCESS)
+	{
+		TestFail(__FILE__, __LINE__, "HostLoopInitialize");
+		return;
+	}
+
+	//
+	// One LED, moved to each new intensity in a single update
+	//
+	HostRegistryClear();
+	HostRegistrySetValue("LedCount", "1");
+	HostRegistrySetValue("LedIndexList", "3");
+	HostRegistrySetValue("FadeTime", "0");
+
+	TEST_CHECK(HostDeviceCreate(WDF_NO_OBJECT_ATTRIBUTES, &device) == STATUS_SUCCESS);
+	TEST_CHECK(HostRegisterDeviceInterface(
+		&SENSOR_TYPE_AMBIENT_LIGHT,
+		TEST_ALS_NAME,
+		&gAlsOps,
+		&gAls) == STATUS_SUCCESS);
+	TEST_CHECK(HostRegisterDeviceInterface(
+		&HWN_DEVINTERFACE_NLED,
+		TEST_HWN_NAME,
+		&gHwnOps,
+		&gHwn) == STATUS_SUCCESS);
+
+	//
+	// No table is configured, the default one is used
+	//
+	TchBklLoadLuxTable(luxTable, &luxLevels);
+
+	TEST_CHECK(luxLevels == BKL_NUM_LEVELS_DEFAULT);
+
+	context = TchBklInitialize(device, luxTable, luxLevels);
+
+	TEST_CHECK(context != NULL);
+
+	if (context != NULL)
+	{
+		TestBacklightStart(context);
+		TestBacklightRead(context);
+		TestBacklightRetry(context);
+		TestBacklightHysteresis(context);
+		TestBacklightInterval(context);
+		TestBacklightOff(context);
+
+		TchBklDeinitialize(context);
+
+		TEST_CHECK(!gAls.Started);
+		TEST_CHECK(gAls.Read == NULL);
+	}
+
+	//
+	// The same LED faded over the default FadeTime
+	//
+	RtlZeroMemory(&gAls, sizeof(gAls));
+	RtlZeroMemory(&gHwn, sizeof(gHwn));
+
+	HostRegistrySetValue("FadeTime", "250");
+
+	context = TchBklInitialize(device, luxTable, luxLevels);
+
+	TEST_CHECK(context != NULL);
+
+	if (context != NULL)
+	{
+		TEST_CHECK(context->FadeTime == 250);
+
+		TestBacklightFade(context);
+		TestBacklightFadePending(context);
+		TestBacklightFlushFade(context);
+
+		TchBklDeinitialize(context);
+
+		TEST_CHECK(gHwn.Held == NULL);
+	}
+
+	HostUnregisterDeviceInterface(TEST_HWN_NAME);
+	HostUnregisterDeviceInterface(TEST_ALS_NAME);
+	WdfObjectDelete(device);
+	HostRegistryClear();
+	HostLoopDeinitialize();
+}
@@ -0,0 +1,619 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testbitops.c
+
+	Abstract:
+
+		Checks the bitmap helpers against a bit by bit reference, on maps
+		of every size up to four words and ranges that start and end on
+		and around word boundaries. Bits past the size of a map are set
+		on purpose, the helpers must not look at them.
+
+		The helpers are also checked against the ones they replaced, the
+		Linux port with hweight32 and a shift cascade __ffs, reproduced
+		here as the driver built them, with 32-bit longs. A separate
+		suite times both on the maps the driver uses, for information
+		only.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include <time.h>
+#include "rmitest.h"
+#include "bitops.h"
+
+#define TEST_BITOPS_MAX_BITS    (4 * BITS_PER_BITMAP_WORD)
+#define TEST_BITOPS_WORDS       (BITS_TO_WORDS(TEST_BITOPS_MAX_BITS) + 1)
+
+#define TEST_BITOPS_BENCHMARK_ROUNDS  2000000
+#define TEST_BITOPS_BENCHMARK_FINGERS 10
+
+#define TEST_OLD_BITS_PER_LONG  32
+
+static ULONG gSeed = 1;
+
+static BITMAP_WORD
+TestBitopsRandom(
+	VOID
+)
+{
+	gSeed = gSeed * 1103515245 + 12345;
+	return (gSeed >> 16) | (gSeed << 16);
+}
+
+static VOID
+TestBitopsFill(
+	OUT BITMAP_WORD* Map,
+	IN ULONG Density
+)
+/*++
+
+  Routine Description:
+
+	Fills a map with random bits, one in Density set, 0 for none
+
+--*/
+{
+	ULONG i;
+
+	for (i = 0; i < TEST_BITOPS_WORDS * BITS_PER_BITMAP_WORD; i++)
+	{
+		if (Density != 0 && TestBitopsRandom() % Density == 0)
+		{
+			__set_bit(i, Map);
+		}
+		else
+		{
+			__clear_bit(i, Map);
+		}
+	}
+}
+
+static ULONG
+TestBitopsNext(
+	IN const BITMAP_WORD* Map,
+	IN ULONG Size,
+	IN ULONG Offset
+)
+{
+	for (; Offset < Size; Offset++)
+	{
+		if (test_bit(Offset, Map))
+		{
+			break;
+		}
+	}
+
+	return min(Offset, Size);
+}
+
+static VOID
+TestBitopsWord(
+	VOID
+)
+{
+	ULONG i;
+
+	TEST_CHECK(bitmap_word_weight(0) == 0);
+	TEST_CHECK(bitmap_word_weight(BITMAP_WORD_MAX) == BITS_PER_BITMAP_WORD);
+	TEST_CHECK(bitmap_word_weight(0x80000001) == 2);
+
+	for (i = 0; i < BITS_PER_BITMAP_WORD; i++)
+	{
+		TEST_CHECK(bitmap_word_ffs(BIT(i)) == i);
+		TEST_CHECK(bitmap_word_ffs(BITMAP_WORD_MAX << i) == i);
+		TEST_CHECK(bitmap_word_weight(BIT(i)) == 1);
+		TEST_CHECK(bitmap_word_weight(BITMAP_WORD_MAX << i) == BITS_PER_BITMAP_WORD - i);
+	}
+
+	//
+	// The masks of a range ending or starting on a word boundary
+	//
+	TEST_CHECK(BITMAP_FIRST_WORD_MASK(0) == BITMAP_WORD_MAX);
+	TEST_CHECK(BITMAP_FIRST_WORD_MASK(BITS_PER_BITMAP_WORD) == BITMAP_WORD_MAX);
+	TEST_CHECK(BITMAP_FIRST_WORD_MASK(31) == BIT(31));
+	TEST_CHECK(BITMAP_LAST_WORD_MASK(BITS_PER_BITMAP_WORD) == BITMAP_WORD_MAX);
+	TEST_CHECK(BITMAP_LAST_WORD_MASK(1) == 1);
+	TEST_CHECK(BITMAP_LAST_WORD_MASK(33) == 1);
+	TEST_CHECK(BITS_TO_WORDS(0) == 0);
+	TEST_CHECK(BITS_TO_WORDS(32) == 1);
+	TEST_CHECK(BITS_TO_WORDS(33) == 2);
+}
+
+static VOID
+TestBitopsSet(
+	VOID
+)
+{
+	BITMAP_WORD map[TEST_BITOPS_WORDS];
+	ULONG start;
+	ULONG length;
+	ULONG i;
+	BOOLEAN same;
+
+	for (start = 0; start <= TEST_BITOPS_MAX_BITS; start++)
+	{
+		for (length = 0; start + length <= TEST_BITOPS_MAX_BITS; length++)
+		{
+			RtlZeroMemory(map, sizeof(map));
+			bitmap_set(map, start, length);
+
+			same = TRUE;
+
+			for (i = 0; i < TEST_BITOPS_WORDS * BITS_PER_BITMAP_WORD; i++)
+			{
+				if (test_bit(i, map) != (i >= start && i < start + length))
+				{
+					same = FALSE;
+				}
+			}
+
+			TEST_CHECK(same);
+		}
+	}
+}
+
+static VOID
+TestBitopsMaps(
+	VOID
+)
+{
+	BITMAP_WORD map[TEST_BITOPS_WORDS];
+	BITMAP_WORD other[TEST_BITOPS_WORDS];
+	static const ULONG densities[] = { 0, 1, 2, 7, 40 };
+	ULONG density;
+	ULONG size;
+	ULONG weight;
+	ULONG offset;
+	ULONG round;
+	ULONG bit;
+	ULONG i;
+	BOOLEAN empty;
+
+	for (round = 0; round < 20; round++)
+	{
+		for (density = 0; density < ARRAYSIZE(densities); density++)
+		{
+			TestBitopsFill(map, densities[density]);
+
+			for (size = 1; size <= TEST_BITOPS_MAX_BITS; size++)
+			{
+				weight = 0;
+				empty = TRUE;
+
+				for (i = 0; i < size; i++)
+				{
+					if (test_bit(i, map))
+					{
+						weight++;
+						empty = FALSE;
+					}
+				}
+
+				TEST_CHECK(bitmap_weight(map, size) == weight);
+				TEST_CHECK(bitmap_empty(map, size) == empty);
+				TEST_CHECK(find_first_bit(map, size) == TestBitopsNext(map, size, 0));
+
+				for (offset = 0; offset <= size + 1; offset++)
+				{
+					TEST_CHECK(find_next_bit(map, size, offset) == TestBitopsNext(map, size, offset));
+				}
+
+				//
+				// A difference past the size does not count, one inside does
+				//
+				RtlCopyMemory(other, map, sizeof(map));
+				other[TEST_BITOPS_WORDS - 1] ^= BITMAP_WORD_MAX;
+
+				for (bit = size; bit < TEST_BITOPS_WORDS * BITS_PER_BITMAP_WORD; bit += 13)
+				{
+					other[BIT_WORD(bit)] ^= BIT_MASK(bit);
+				}
+
+				TEST_CHECK(bitmap_equal(map, other, size));
+
+				bit = TestBitopsRandom() % size;
+				other[BIT_WORD(bit)] ^= BIT_MASK(bit);
+				TEST_CHECK(!bitmap_equal(map, other, size));
+			}
+		}
+	}
+
+	//
+	// Iterating a full map visits every bit once, up to the last one
+	//
+	RtlZeroMemory(map, sizeof(map));
+	bitmap_set(map, 0, TEST_BITOPS_MAX_BITS);
+	i = 0;
+
+	for (bit = find_first_bit(map, TEST_BITOPS_MAX_BITS);
+		bit < TEST_BITOPS_MAX_BITS;
+		bit = find_next_bit(map, TEST_BITOPS_MAX_BITS, bit + 1))
+	{
+		TEST_CHECK(bit == i);
+		i++;
+	}
+
+	TEST_CHECK(i == TEST_BITOPS_MAX_BITS);
+
+	//
+	// A single bit on each side of a word boundary
+	//
+	for (bit = BITS_PER_BITMAP_WORD - 1; bit <= BITS_PER_BITMAP_WORD; bit++)
+	{
+		RtlZeroMemory(map, sizeof(map));
+		__set_bit(bit, map);
+
+		TEST_CHECK(find_first_bit(map, TEST_BITOPS_MAX_BITS) == bit);
+		TEST_CHECK(find_next_bit(map, TEST_BITOPS_MAX_BITS, bit) == bit);
+		TEST_CHECK(find_next_bit(map, TEST_BITOPS_MAX_BITS, bit + 1) == TEST_BITOPS_MAX_BITS);
+		TEST_CHECK(find_first_bit(map, bit) == bit);
+		TEST_CHECK(bitmap_weight(map, bit) == 0);
+		TEST_CHECK(bitmap_weight(map, bit + 1) == 1);
+
+		__clear_bit(bit, map);
+		TEST_CHECK(bitmap_empty(map, TEST_BITOPS_MAX_BITS));
+	}
+}
+
+//
+// The helpers before BITMAP_WORD, long being 32 bits wide on Windows
+//
+
+static ULONG
+TestOldHweight32(
+	IN ULONG w
+)
+{
+	ULONG res = w - ((w >> 1) & 0x55555555);
+	res = (res & 0x33333333) + ((res >> 2) & 0x33333333);
+	res = (res + (res >> 4)) & 0x0F0F0F0F;
+	res = res + (res >> 8);
+	return (res + (res >> 16)) & 0x000000FF;
+}
+
+static ULONG
+TestOldFfs(
+	IN ULONG word
+)
+{
+	ULONG num = 0;
+
+	if ((word & 0xffff) == 0)
+	{
+		num += 16;
+		word >>= 16;
+	}
+	if ((word & 0xff) == 0)
+	{
+		num += 8;
+		word >>= 8;
+	}
+	if ((word & 0xf) == 0)
+	{
+		num += 4;
+		word >>= 4;
+	}
+	if ((word & 0x3) == 0)
+	{
+		num += 2;
+		word >>= 2;
+	}
+	if ((word & 0x1) == 0)
+		num += 1;
+	return num;
+}
+
+static VOID
+TestOldBitmapSet(
+	IN ULONG* map,
+	IN ULONG start,
+	IN int len
+)
+{
+	ULONG* p = map + start / TEST_OLD_BITS_PER_LONG;
+	const ULONG size = start + len;
+	int bits_to_set = TEST_OLD_BITS_PER_LONG - (start % TEST_OLD_BITS_PER_LONG);
+	ULONG mask_to_set = BITMAP_FIRST_WORD_MASK(start);
+
+	while (len - bits_to_set >= 0)
+	{
+		*p |= mask_to_set;
+		len -= bits_to_set;
+		bits_to_set = TEST_OLD_BITS_PER_LONG;
+		mask_to_set = ~0U;
+		p++;
+	}
+
+	if (len)
+	{
+		mask_to_set &= BITMAP_LAST_WORD_MASK(size);
+		*p |= mask_to_set;
+	}
+}
+
+static int
+TestOldBitmapWeight(
+	IN const ULONG* bitmap,
+	IN ULONG bits
+)
+{
+	ULONG k, lim = bits / TEST_OLD_BITS_PER_LONG;
+	int w = 0;
+
+	for (k = 0; k < lim; k++)
+		w += TestOldHweight32(bitmap[k]);
+
+	if (bits % TEST_OLD_BITS_PER_LONG)
+		w += TestOldHweight32(bitmap[k] & BITMAP_LAST_WORD_MASK(bits));
+
+	return w;
+}
+
+static ULONG
+TestOldFindFirstBit(
+	IN const ULONG* addr,
+	IN ULONG size
+)
+{
+	ULONG idx;
+
+	for (idx = 0; idx * TEST_OLD_BITS_PER_LONG < size; idx++)
+	{
+		if (addr[idx])
+			return min(idx * TEST_OLD_BITS_PER_LONG + TestOldFfs(addr[idx]), size);
+	}
+
+	return size;
+}
+
+static ULONG
+TestOldFindNextBit(
+	IN const ULONG* addr,
+	IN ULONG nbits,
+	IN ULONG start
+)
+{
+	ULONG tmp;
+
+	if (start >= nbits) return nbits;
+
+	tmp = addr[start / TEST_OLD_BITS_PER_LONG];
+
+	/* Handle 1st word. */
+	tmp &= BITMAP_FIRST_WORD_MASK(start);
+	start = start & ~(TEST_OLD_BITS_PER_LONG - 1);
+
+	while (!tmp)
+	{
+		start += TEST_OLD_BITS_PER_LONG;
+		if (start >= nbits)
+			return nbits;
+
+		tmp = addr[start / TEST_OLD_BITS_PER_LONG];
+	}
+
+	return min(start + TestOldFfs(tmp), nbits);
+}
+
+static VOID
+TestBitopsOld(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	The new helpers return what the old ones did on the same maps,
+	bits past the size included
+
+--*/
+{
+	BITMAP_WORD map[TEST_BITOPS_WORDS];
+	ULONG oldMap[TEST_BITOPS_WORDS];
+	static const ULONG densities[] = { 0, 1, 3, 40 };
+	ULONG density;
+	ULONG start;
+	ULONG length;
+	ULONG size;
+	ULONG offset;
+	ULONG round;
+	BOOLEAN same;
+
+	C_ASSERT(sizeof(BITMAP_WORD) == sizeof(ULONG));
+
+	for (start = 0; start <= TEST_BITOPS_MAX_BITS; start++)
+	{
+		for (length = 0; start + length <= TEST_BITOPS_MAX_BITS; length++)
+		{
+			RtlZeroMemory(map, sizeof(map));
+			RtlZeroMemory(oldMap, sizeof(oldMap));
+			bitmap_set(map, start, length);
+			TestOldBitmapSet(oldMap, start, (int)length);
+
+			TEST_CHECK(RtlEqualMemory(map, oldMap, sizeof(map)));
+		}
+	}
+
+	for (round = 0; round < 20; round++)
+	{
+		for (density = 0; density < ARRAYSIZE(densities); density++)
+		{
+			TestBitopsFill(map, densities[density]);
+			RtlCopyMemory(oldMap, map, sizeof(map));
+
+			for (size = 1; size <= TEST_BITOPS_MAX_BITS; size++)
+			{
+				TEST_CHECK(bitmap_weight(map, size) == (ULONG)TestOldBitmapWeight(oldMap, size));
+				TEST_CHECK(find_first_bit(map, size) == TestOldFindFirstBit(oldMap, size));
+
+				same = TRUE;
+
+				for (offset = 0; offset <= size + 1; offset++)
+				{
+					if (find_next_bit(map, size, offset) != TestOldFindNextBit(oldMap, size, offset))
+					{
+						same = FALSE;
+					}
+				}
+
+				TEST_CHECK(same);
+			}
+		}
+	}
+}
+
+VOID
+TestBitops(
+	VOID
+)
+{
+	TestBitopsWord();
+	TestBitopsSet();
+	TestBitopsMaps();
+	TestBitopsOld();
+}
+
+static volatile ULONG gBitopsSink;
+
+static double
+TestBitopsElapsed(
+	IN const struct timespec* Begin
+)
+{
+	struct timespec end;
+
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (end.tv_sec - Begin->tv_sec) * 1e9 + (end.tv_nsec - Begin->tv_nsec);
+}
+
+static VOID
+TestBitopsReport(
+	IN PCSTR Name,
+	IN double OldNs,
+	IN double NewNs
+)
+{
+	printf(
+		"bitops %-18s old %6.2f ns  new %6.2f ns\n",
+		Name,
+		OldNs / TEST_BITOPS_BENCHMARK_ROUNDS,
+		NewNs / TEST_BITOPS_BENCHMARK_ROUNDS);
+}
+
+VOID
+TestBitopsBenchmark(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Times the old and new helpers on the maps the driver uses: the
+	finger masks of a ten finger controller, walked bit by bit each
+	frame, and the four-word F12 descriptor maps, counted and
+	filled when a descriptor is parsed. The rounds cycle through
+	sixteen random maps so nothing is hoisted out of the loops. The times are reported only,
+	they depend on the machine and are not checked.
+
+--*/
+{
+	BITMAP_WORD maps[16][TEST_BITOPS_WORDS];
+	struct timespec begin;
+	double oldNs;
+	double newNs;
+	ULONG sum;
+	ULONG bit;
+	ULONG i;
+
+	for (i = 0; i < ARRAYSIZE(maps); i++)
+	{
+		TestBitopsFill(maps[i], 3);
+	}
+
+	sum = 0;
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		const ULONG* map = (const ULONG*)maps[i % ARRAYSIZE(maps)];
+
+		for (bit = TestOldFindFirstBit(map, TEST_BITOPS_BENCHMARK_FINGERS);
+			bit < TEST_BITOPS_BENCHMARK_FINGERS;
+			bit = TestOldFindNextBit(map, TEST_BITOPS_BENCHMARK_FINGERS, bit + 1))
+		{
+			sum += bit;
+		}
+	}
+
+	oldNs = TestBitopsElapsed(&begin);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		const BITMAP_WORD* map = maps[i % ARRAYSIZE(maps)];
+
+		for (bit = find_first_bit(map, TEST_BITOPS_BENCHMARK_FINGERS);
+			bit < TEST_BITOPS_BENCHMARK_FINGERS;
+			bit = find_next_bit(map, TEST_BITOPS_BENCHMARK_FINGERS, bit + 1))
+		{
+			sum -= bit;
+		}
+	}
+
+	newNs = TestBitopsElapsed(&begin);
+	TestBitopsReport("finger walk", oldNs, newNs);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		sum += TestOldBitmapWeight((const ULONG*)maps[i % ARRAYSIZE(maps)], TEST_BITOPS_MAX_BITS - 5);
+	}
+
+	oldNs = TestBitopsElapsed(&begin);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		sum -= bitmap_weight(maps[i % ARRAYSIZE(maps)], TEST_BITOPS_MAX_BITS - 5);
+	}
+
+	newNs = TestBitopsElapsed(&begin);
+	TestBitopsReport("descriptor weight", oldNs, newNs);
+
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		TestOldBitmapSet((ULONG*)maps[i % ARRAYSIZE(maps)], i % 32, 80);
+	}
+
+	oldNs = TestBitopsElapsed(&begin);
+	clock_gettime(CLOCK_MONOTONIC, &begin);
+
+	for (i = 0; i < TEST_BITOPS_BENCHMARK_ROUNDS; i++)
+	{
+		bitmap_set(maps[i % ARRAYSIZE(maps)], i % 32, 80);
+	}
+
+	newNs = TestBitopsElapsed(&begin);
+	TestBitopsReport("descriptor set", oldNs, newNs);
+
+	//
+	// Both walks visit the same bits, the sums cancel out
+	//
+	TEST_CHECK(sum == 0);
+	gBitopsSink = sum;
+}
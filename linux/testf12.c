@@ -0,0 +1,406 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testf12.c
+
+	Abstract:
+
+		Checks the parsing of the F12 register descriptors and the arena
+		they are built in. Descriptors are handed to the driver as a
+		cached controller topology, so no controller is needed. Items
+		and subpacket maps must land inside an arena of exactly the
+		measured size, and a truncated or oversized structure must be
+		rejected without leaving anything behind.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include "rmitest.h"
+#include "rmiinternal.h"
+#include "Function12.h"
+
+static RMI4_CONTROLLER_CONTEXT gContext;
+static RMI4_CONTROLLER_SETUP gSetup;
+static ULONG gStructBytes;
+
+static VOID
+TestF12Reset(
+	VOID
+)
+{
+	gContext.Setup = &gSetup;
+	RmiFreeRegisterDescriptors(&gContext);
+	RtlZeroMemory(&gSetup, sizeof(gSetup));
+	gSetup.Topology.F12Valid = TRUE;
+	gStructBytes = 0;
+}
+
+static VOID
+TestF12Set(
+	IN ULONG Index,
+	IN const UCHAR* Presence,
+	IN UCHAR PresenceSize,
+	IN const UCHAR* Struct,
+	IN USHORT StructSize
+)
+/*++
+
+  Routine Description:
+
+	Records one descriptor in the cached topology, structures are
+	packed one after the other in descriptor order like the driver
+	records them
+
+--*/
+{
+	RMI4_TOPOLOGY* topology = &gSetup.Topology;
+
+	RtlCopyMemory(topology->F12Presence[Index], Presence, min(PresenceSize, RMI_REG_DESC_PRESENCE_MAX));
+	topology->F12PresenceSize[Index] = PresenceSize;
+	topology->F12StructSize[Index] = StructSize;
+
+	if (Struct != NULL)
+	{
+		RtlCopyMemory(&topology->F12Structs[gStructBytes], Struct, StructSize);
+		gStructBytes += StructSize;
+	}
+}
+
+static NTSTATUS
+TestF12Load(
+	VOID
+)
+{
+	RmiFreeRegisterDescriptors(&gContext);
+	return RmiLoadRegisterDescriptors(&gContext, NULL, 0);
+}
+
+static BOOLEAN
+TestF12InArena(
+	IN const VOID* Block,
+	IN SIZE_T Bytes
+)
+{
+	const RMI_DESC_ARENA* arena = &gSetup.F12DescArena;
+	const UCHAR* block = Block;
+
+	return block >= arena->Base &&
+		block + Bytes <= arena->Base + arena->Size;
+}
+
+static VOID
+TestF12CheckArena(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Checks every item and subpacket map lies inside the arena and that
+	the arena is exactly as large as what was carved out of it
+
+--*/
+{
+	PRMI_REGISTER_DESCRIPTOR descriptors[RMI_REG_DESC_COUNT];
+	PRMI_REGISTER_DESC_ITEM item;
+	SIZE_T expected = 0;
+	SIZE_T bytes;
+	ULONG i;
+	ULONG j;
+
+	descriptors[0] = &gSetup.QueryRegDesc;
+	descriptors[1] = &gSetup.ControlRegDesc;
+	descriptors[2] = &gSetup.DataRegDesc;
+
+	for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+	{
+		if (descriptors[i]->NumRegisters == 0)
+		{
+			continue;
+		}
+
+		bytes = descriptors[i]->NumRegisters * sizeof(RMI_REGISTER_DESC_ITEM);
+		TEST_CHECK(TestF12InArena(descriptors[i]->Registers, bytes));
+		expected += ALIGN_UP_BY(bytes, sizeof(PVOID));
+
+		for (j = 0; j < descriptors[i]->NumRegisters; j++)
+		{
+			item = &descriptors[i]->Registers[j];
+			bytes = BITS_TO_WORDS(item->SubPacketBits) * sizeof(BITMAP_WORD);
+			TEST_CHECK(TestF12InArena(item->SubPacketMap, bytes));
+			TEST_CHECK(item->NumSubPackets == bitmap_weight(item->SubPacketMap, item->SubPacketBits));
+			expected += ALIGN_UP_BY(bytes, sizeof(PVOID));
+		}
+	}
+
+	TEST_CHECK(gSetup.F12DescArena.Size == expected);
+	TEST_CHECK(gSetup.F12DescArena.Used == gSetup.F12DescArena.Size);
+}
+
+static VOID
+TestF12CheckEmpty(
+	VOID
+)
+{
+	TEST_CHECK(gSetup.F12DescArena.Base == NULL);
+	TEST_CHECK(gSetup.QueryRegDesc.NumRegisters == 0);
+	TEST_CHECK(gSetup.QueryRegDesc.Registers == NULL);
+	TEST_CHECK(gSetup.ControlRegDesc.NumRegisters == 0);
+	TEST_CHECK(gSetup.ControlRegDesc.Registers == NULL);
+	TEST_CHECK(gSetup.DataRegDesc.NumRegisters == 0);
+	TEST_CHECK(gSetup.DataRegDesc.Registers == NULL);
+}
+
+//
+// Query registers 0 and 1, one byte structure size
+//
+static const UCHAR gQueryPresence[] = { 4, 0x03 };
+static const UCHAR gQueryStruct[] = { 1, 0x00, 2, 0x05 };
+
+//
+// Control registers 0 and 7, two byte structure size. Register 0 has a
+// 16 bit size and two subpacket bytes, register 7 a 32 bit size
+//
+static const UCHAR gControlPresence[] = { 0, 13, 0, 0x81 };
+static const UCHAR gControlStruct[] =
+{
+	0, 0x34, 0x12, 0x83, 0x01,
+	0, 0, 0, 0x78, 0x56, 0x34, 0x12, 0x7f,
+};
+
+//
+// Data register 16, at the end of a wider presence map
+//
+static const UCHAR gDataPresence[] = { 2, 0, 0, 0x01 };
+static const UCHAR gDataStruct[] = { 10, 0x02 };
+
+static const UCHAR gNoPresence[] = { 1 };
+
+static VOID
+TestF12Good(
+	VOID
+)
+{
+	PRMI_REGISTER_DESCRIPTOR query = &gSetup.QueryRegDesc;
+	PRMI_REGISTER_DESCRIPTOR control = &gSetup.ControlRegDesc;
+	PRMI_REGISTER_DESCRIPTOR data = &gSetup.DataRegDesc;
+	PRMI_REGISTER_DESC_ITEM item;
+
+	TestF12Reset();
+	TestF12Set(0, gQueryPresence, sizeof(gQueryPresence), gQueryStruct, sizeof(gQueryStruct));
+	TestF12Set(1, gControlPresence, sizeof(gControlPresence), gControlStruct, sizeof(gControlStruct));
+	TestF12Set(2, gDataPresence, sizeof(gDataPresence), gDataStruct, sizeof(gDataStruct));
+
+	TEST_CHECK(TestF12Load() == STATUS_SUCCESS);
+	TestF12CheckArena();
+
+	TEST_CHECK(query->NumRegisters == 2);
+	TEST_CHECK(query->Registers[0].Register == 0);
+	TEST_CHECK(query->Registers[0].RegisterSize == 1);
+	TEST_CHECK(query->Registers[0].NumSubPackets == 0);
+	TEST_CHECK(query->Registers[1].Register == 1);
+	TEST_CHECK(query->Registers[1].RegisterSize == 2);
+	TEST_CHECK(query->Registers[1].SubPacketBits == 7);
+	TEST_CHECK(query->Registers[1].NumSubPackets == 2);
+	TEST_CHECK(test_bit(0, query->Registers[1].SubPacketMap));
+	TEST_CHECK(test_bit(2, query->Registers[1].SubPacketMap));
+
+	TEST_CHECK(control->NumRegisters == 2);
+	TEST_CHECK(control->Registers[0].RegisterSize == 0x1234);
+	TEST_CHECK(control->Registers[0].SubPacketBits == 14);
+	TEST_CHECK(control->Registers[0].NumSubPackets == 3);
+	TEST_CHECK(test_bit(7, control->Registers[0].SubPacketMap));
+
+	item = RmiGetRegisterDescItem(control, 7);
+	TEST_CHECK(item != NULL && item->RegisterSize == 0x12345678);
+	TEST_CHECK(item != NULL && item->NumSubPackets == 7);
+
+	TEST_CHECK(data->NumRegisters == 1);
+	TEST_CHECK(data->Registers[0].Register == 16);
+	TEST_CHECK(data->Registers[0].RegisterSize == 10);
+	TEST_CHECK(data->Registers[0].NumSubPackets == 1);
+
+	//
+	// Lookups of registers that are not present
+	//
+	TEST_CHECK(RmiGetRegisterDescItem(query, 2) == NULL);
+	TEST_CHECK(RmiGetRegisterIndex(query, 2) == query->NumRegisters);
+	TEST_CHECK(RmiGetRegisterIndex(control, 7) == 1);
+	TEST_CHECK(RmiRegisterDescriptorCalcSize(query) == 3);
+	TEST_CHECK(RmiRegisterDescriptorCalcRegOffset(query, 1) == 1);
+	TEST_CHECK(RmiRegisterDescriptorCalcRegOffset(data, 16) == 0);
+
+	RmiFreeRegisterDescriptors(&gContext);
+	TestF12CheckEmpty();
+	TEST_CHECK(RmiGetRegisterDescItem(data, 16) == NULL);
+	TEST_CHECK(RmiRegisterDescriptorCalcSize(data) == 0);
+}
+
+static VOID
+TestF12Full(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Every presence bit set, with the register structures filling the
+	topology exactly, and the longest subpacket chain allowed
+
+--*/
+{
+	static UCHAR presence[RMI_REG_DESC_PRESENCE_MAX];
+	static UCHAR structure[RMI4_TOPOLOGY_F12_BYTES];
+	static UCHAR chain[2 + RMI_REG_DESC_SUBPACKET_BITS / 7];
+	PRMI_REGISTER_DESCRIPTOR data = &gSetup.DataRegDesc;
+	ULONG i;
+
+	presence[0] = 0;
+	presence[1] = (UCHAR)(sizeof(structure) & 0xff);
+	presence[2] = (UCHAR)(sizeof(structure) >> 8);
+	RtlFillMemory(&presence[3], sizeof(presence) - 3, 0xff);
+
+	for (i = 0; i < sizeof(structure); i += 2)
+	{
+		structure[i] = 1;
+		structure[i + 1] = 0;
+	}
+
+	TestF12Reset();
+	TestF12Set(0, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	TestF12Set(1, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	TestF12Set(2, presence, sizeof(presence), structure, sizeof(structure));
+
+	TEST_CHECK(TestF12Load() == STATUS_SUCCESS);
+	TestF12CheckArena();
+	TEST_CHECK(gSetup.QueryRegDesc.NumRegisters == 0);
+	TEST_CHECK(data->NumRegisters == RMI_REG_DESC_PRESENSE_BITS);
+	TEST_CHECK(data->Registers[RMI_REG_DESC_PRESENSE_BITS - 1].Register == RMI_REG_DESC_PRESENSE_BITS - 1);
+	TEST_CHECK(RmiRegisterDescriptorCalcSize(data) == RMI_REG_DESC_PRESENSE_BITS);
+
+	//
+	// A subpacket chain of RMI_REG_DESC_SUBPACKET_BITS / 7 bytes fits
+	//
+	chain[0] = 1;
+	RtlFillMemory(&chain[1], sizeof(chain) - 2, 0xff);
+	chain[sizeof(chain) - 2] = 0x7f;
+
+	TestF12Reset();
+	TestF12Set(0, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	TestF12Set(1, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	presence[0] = sizeof(chain) - 1;
+	presence[1] = 0x01;
+	TestF12Set(2, presence, 2, chain, sizeof(chain) - 1);
+
+	TEST_CHECK(TestF12Load() == STATUS_SUCCESS);
+	TestF12CheckArena();
+	TEST_CHECK(data->NumRegisters == 1);
+	TEST_CHECK(data->Registers[0].SubPacketBits == (RMI_REG_DESC_SUBPACKET_BITS / 7) * 7);
+	TEST_CHECK(data->Registers[0].NumSubPackets == data->Registers[0].SubPacketBits);
+
+	//
+	// One more byte in the chain does not
+	//
+	chain[sizeof(chain) - 2] = 0xff;
+	chain[sizeof(chain) - 1] = 0x01;
+
+	TestF12Reset();
+	TestF12Set(0, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	TestF12Set(1, gNoPresence, sizeof(gNoPresence), NULL, 0);
+	presence[0] = sizeof(chain);
+	TestF12Set(2, presence, 2, chain, sizeof(chain));
+
+	TEST_CHECK(TestF12Load() == STATUS_INVALID_DEVICE_STATE);
+	TestF12CheckEmpty();
+}
+
+typedef struct _TEST_F12_BAD
+{
+	UCHAR PresenceSize;
+	UCHAR Presence[6];
+	USHORT StructSize;
+	UCHAR Struct[8];
+	NTSTATUS Status;
+} TEST_F12_BAD;
+
+//
+// Control descriptors that must be rejected, the query and data
+// descriptors around them are good
+//
+static const TEST_F12_BAD gBad[] =
+{
+	// Presence register of no size, or larger than allowed
+	{ 0, { 2, 0x01 }, 2, { 1, 0 }, STATUS_INVALID_PARAMETER },
+	{ RMI_REG_DESC_PRESENCE_MAX + 1, { 2, 0x01 }, 2, { 1, 0 }, STATUS_INVALID_PARAMETER },
+	// Registers present in an empty structure
+	{ 4, { 0, 0, 0, 0x01 }, 0, { 0 }, STATUS_INVALID_DEVICE_STATE },
+	// Structure ends before the size of a register
+	{ 2, { 1, 0x03 }, 1, { 1 }, STATUS_INVALID_DEVICE_STATE },
+	// Structure ends in a 16 bit size
+	{ 2, { 2, 0x01 }, 2, { 0, 0x34 }, STATUS_INVALID_DEVICE_STATE },
+	// Structure ends in a 32 bit size
+	{ 2, { 5, 0x01 }, 5, { 0, 0, 0, 0x78, 0x56 }, STATUS_INVALID_DEVICE_STATE },
+	// Subpacket chain runs off the end
+	{ 2, { 3, 0x01 }, 3, { 1, 0x80, 0x80 }, STATUS_INVALID_DEVICE_STATE },
+	// More registers present than described
+	{ 2, { 4, 0xff }, 4, { 1, 0, 1, 0 }, STATUS_INVALID_DEVICE_STATE },
+	// Structure size differs from the one recorded
+	{ 2, { 4, 0x01 }, 2, { 1, 0 }, STATUS_REVISION_MISMATCH },
+	// Structure larger than the topology holds
+	{ 4, { 0, 0x00, 0x02, 0x01 }, 0x200, { 1, 0 }, STATUS_REVISION_MISMATCH },
+};
+
+static VOID
+TestF12Bad(
+	VOID
+)
+{
+	const TEST_F12_BAD* bad;
+	NTSTATUS status;
+	ULONG i;
+
+	for (i = 0; i < ARRAYSIZE(gBad); i++)
+	{
+		bad = &gBad[i];
+
+		TestF12Reset();
+		TestF12Set(0, gQueryPresence, sizeof(gQueryPresence), gQueryStruct, sizeof(gQueryStruct));
+		TestF12Set(
+			1,
+			bad->Presence,
+			bad->PresenceSize,
+			bad->Struct,
+			min(bad->StructSize, sizeof(bad->Struct)));
+		gSetup.Topology.F12StructSize[1] = bad->StructSize;
+		TestF12Set(2, gDataPresence, sizeof(gDataPresence), gDataStruct, sizeof(gDataStruct));
+
+		status = TestF12Load();
+
+		if (status != bad->Status)
+		{
+			fprintf(stderr, "control descriptor %u: status %X, expected %X\n", i, status, bad->Status);
+			TestFail(__FILE__, __LINE__, "status == bad->Status");
+		}
+
+		TestF12CheckEmpty();
+	}
+}
+
+VOID
+TestF12(
+	VOID
+)
+{
+	TestF12Good();
+	TestF12Full();
+	TestF12Bad();
+}
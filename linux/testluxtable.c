@@ -0,0 +1,308 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testluxtable.c
+
+	Abstract:
+
+		Checks the validation of OEM lux tables, both handed in directly
+		and read from the registry, and the mapping of light sensor
+		readings to backlight intensities through a validated table, with
+		and without interpolation between levels.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include "rmitest.h"
+#include "rmiinternal.h"
+
+typedef struct _TEST_LUX_LEVEL
+{
+	ULONG Max;
+	ULONG Intensity;
+} TEST_LUX_LEVEL;
+
+static NTSTATUS
+TestLuxTableValidate(
+	IN const TEST_LUX_LEVEL* Levels,
+	IN ULONG Count,
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable
+)
+/*++
+
+  Routine Description:
+
+	Builds a table the way the registry reader does, filling only the
+	upper bounds and intensities, and validates it
+
+--*/
+{
+	ULONG i;
+
+	RtlZeroMemory(LuxTable, BKL_MAX_LEVELS * sizeof(BKL_LUX_TABLE_ENTRY));
+
+	for (i = 0; i < Count; i++)
+	{
+		LuxTable[i].Max = Levels[i].Max;
+		LuxTable[i].Intensity = Levels[i].Intensity;
+	}
+
+	return TchBklValidateLuxTable(LuxTable, Count);
+}
+
+static VOID
+TestLuxTableSorted(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Unsorted tables are sorted on their upper bounds, the ranges made
+	contiguous from 0 and the last one left open-ended
+
+--*/
+{
+	static const TEST_LUX_LEVEL levels[] =
+	{
+		{ 500, 30 },
+		{ 100, 10 },
+		{ 300, 20 },
+	};
+
+	BKL_LUX_TABLE_ENTRY table[BKL_MAX_LEVELS];
+
+	TEST_CHECK(TestLuxTableValidate(levels, ARRAYSIZE(levels), table) == STATUS_SUCCESS);
+
+	TEST_CHECK(table[0].Min == 0 && table[0].Max == 100 && table[0].Intensity == 10);
+	TEST_CHECK(table[1].Min == 100 && table[1].Max == 300 && table[1].Intensity == 20);
+	TEST_CHECK(table[2].Min == 300 && table[2].Max == MAXULONG && table[2].Intensity == 30);
+
+	//
+	// A single level covers every reading
+	//
+	TEST_CHECK(TestLuxTableValidate(levels, 1, table) == STATUS_SUCCESS);
+	TEST_CHECK(table[0].Min == 0 && table[0].Max == MAXULONG);
+}
+
+static VOID
+TestLuxTableInvalid(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Duplicated or empty ranges and intensities above BKL_MAX_INTENSITY
+	are rejected, wherever they are in the table
+
+--*/
+{
+	static const TEST_LUX_LEVEL duplicate[] =
+	{
+		{ 300, 20 },
+		{ 100, 10 },
+		{ 300, 30 },
+	};
+
+	static const TEST_LUX_LEVEL zeroMax[] =
+	{
+		{ 100, 10 },
+		{ 0, 5 },
+	};
+
+	static const TEST_LUX_LEVEL intensity[] =
+	{
+		{ 100, 10 },
+		{ 200, BKL_MAX_INTENSITY + 1 },
+	};
+
+	static const TEST_LUX_LEVEL maxIntensity[] =
+	{
+		{ 100, 0 },
+		{ 200, BKL_MAX_INTENSITY },
+	};
+
+	BKL_LUX_TABLE_ENTRY table[BKL_MAX_LEVELS];
+
+	TEST_CHECK(TestLuxTableValidate(duplicate, ARRAYSIZE(duplicate), table) ==
+		STATUS_INVALID_PARAMETER);
+	TEST_CHECK(TestLuxTableValidate(zeroMax, ARRAYSIZE(zeroMax), table) ==
+		STATUS_INVALID_PARAMETER);
+	TEST_CHECK(TestLuxTableValidate(intensity, ARRAYSIZE(intensity), table) ==
+		STATUS_INVALID_PARAMETER);
+	TEST_CHECK(TestLuxTableValidate(maxIntensity, ARRAYSIZE(maxIntensity), table) ==
+		STATUS_SUCCESS);
+}
+
+static BOOLEAN
+TestLuxTableIsDefault(
+	IN const BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+)
+{
+	BKL_LUX_TABLE_ENTRY table[BKL_MAX_LEVELS];
+	ULONG levels;
+
+	TchBklGetDefaultLuxIntensityMap(table, &levels);
+
+	return LuxLevels == levels &&
+		RtlEqualMemory(LuxTable, table, levels * sizeof(BKL_LUX_TABLE_ENTRY));
+}
+
+static VOID
+TestLuxTableLoad(
+	IN PCSTR Ranges,
+	IN PCSTR Intensities,
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
+)
+{
+	HostRegistryClear();
+	HostRegistrySetValue("MilliLuxRanges", Ranges);
+	HostRegistrySetValue("IntensityMappings0", Intensities);
+
+	TchBklLoadLuxTable(LuxTable, LuxLevels);
+}
+
+static VOID
+TestLuxTableRegistry(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	A valid table in the registry is used as validated, an invalid one
+	falls back to the default table
+
+--*/
+{
+	BKL_LUX_TABLE_ENTRY table[BKL_MAX_LEVELS];
+	ULONG levels;
+
+	TestLuxTableLoad("50000;10000;25000", "30;10;20", table, &levels);
+
+	TEST_CHECK(levels == 3);
+	TEST_CHECK(table[0].Max == 10000 && table[0].Intensity == 10);
+	TEST_CHECK(table[1].Min == 10000 && table[1].Intensity == 20);
+	TEST_CHECK(table[2].Max == MAXULONG && table[2].Intensity == 30);
+
+	//
+	// Fewer intensities than ranges
+	//
+	TestLuxTableLoad("10000;20000", "10", table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+
+	TestLuxTableLoad("10000;10000", "10;20", table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+
+	TestLuxTableLoad("0;20000", "10;20", table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+
+	TestLuxTableLoad("10000;20000", "10;101", table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+
+	TestLuxTableLoad("10000;bright", "10;20", table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+
+	HostRegistryClear();
+	TchBklLoadLuxTable(table, &levels);
+	TEST_CHECK(TestLuxTableIsDefault(table, levels));
+}
+
+static ULONG
+TestLuxTableIntensity(
+	IN BKL_CONTEXT* Context,
+	IN ULONG LuxValue
+)
+{
+	return TchBklGetIntensity(
+		Context,
+		TchBklGetLuxLevel(Context, LuxValue),
+		LuxValue);
+}
+
+static VOID
+TestLuxTableMapping(
+	VOID
+)
+/*++
+
+  Routine Description:
+
+	Maps readings at and around the level boundaries of the default
+	table. Without interpolation each level has its own intensity, with
+	it the intensity ramps towards the next level's, and the last level
+	stays flat to MAXULONG.
+
+--*/
+{
+	BKL_CONTEXT context;
+
+	RtlZeroMemory(&context, sizeof(context));
+	TchBklGetDefaultLuxIntensityMap(context.BklLuxTable, &context.BklNumLevels);
+
+	TEST_CHECK(TchBklGetLuxLevel(&context, 0) == 0);
+	TEST_CHECK(TchBklGetLuxLevel(&context, 99999) == 0);
+	TEST_CHECK(TchBklGetLuxLevel(&context, 100000) == 1);
+	TEST_CHECK(TchBklGetLuxLevel(&context, 399999) == 2);
+	TEST_CHECK(TchBklGetLuxLevel(&context, 400000) == 3);
+	TEST_CHECK(TchBklGetLuxLevel(&context, MAXULONG) == 3);
+
+	TEST_CHECK(TestLuxTableIntensity(&context, 0) == 5);
+	TEST_CHECK(TestLuxTableIntensity(&context, 99999) == 5);
+	TEST_CHECK(TestLuxTableIntensity(&context, 100000) == 10);
+	TEST_CHECK(TestLuxTableIntensity(&context, 399999) == 25);
+	TEST_CHECK(TestLuxTableIntensity(&context, MAXULONG) == 0);
+
+	context.BklInterpolate = TRUE;
+
+	//
+	// Each level starts at its own intensity and approaches the next
+	//
+	TEST_CHECK(TestLuxTableIntensity(&context, 0) == 5);
+	TEST_CHECK(TestLuxTableIntensity(&context, 50000) == 7);
+	TEST_CHECK(TestLuxTableIntensity(&context, 99999) == 9);
+	TEST_CHECK(TestLuxTableIntensity(&context, 100000) == 10);
+	TEST_CHECK(TestLuxTableIntensity(&context, 150000) == 17);
+	TEST_CHECK(TestLuxTableIntensity(&context, 200000) == 25);
+
+	//
+	// Ramping down towards an off level
+	//
+	TEST_CHECK(TestLuxTableIntensity(&context, 300000) == 13);
+	TEST_CHECK(TestLuxTableIntensity(&context, 399999) == 1);
+	TEST_CHECK(TestLuxTableIntensity(&context, 400000) == 0);
+	TEST_CHECK(TestLuxTableIntensity(&context, MAXULONG) == 0);
+
+	//
+	// A single level has nothing to ramp towards
+	//
+	context.BklNumLevels = 1;
+	context.BklLuxTable[0].Max = MAXULONG;
+
+	TEST_CHECK(TestLuxTableIntensity(&context, 0) == 5);
+	TEST_CHECK(TestLuxTableIntensity(&context, MAXULONG) == 5);
+}
+
+VOID
+TestLuxTable(
+	VOID
+)
+{
+	TestLuxTableSorted();
+	TestLuxTableInvalid();
+	TestLuxTableRegistry();
+	TestLuxTableMapping();
+
+	HostRegistryClear();
+}
@@ -0,0 +1,290 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testresolutions.c
+
+	Abstract:
+
+		Checks how screen properties are read from the registry and
+		derived, and the coordinate translation they drive. Two devices
+		read the same shared values with different values of their own,
+		and must each end up with their own properties.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include <string.h>
+#include "rmitest.h"
+#include "resolutions.h"
+
+typedef struct _TEST_POINT
+{
+	USHORT X;
+	USHORT Y;
+	USHORT ExpectedX;
+	USHORT ExpectedY;
+} TEST_POINT;
+
+static BOOLEAN
+TestResolutionsTranslate(
+	IN TOUCH_SCREEN_PROPERTIES* Props,
+	IN const TEST_POINT* Points,
+	IN ULONG Count
+)
+{
+	BOOLEAN same = TRUE;
+	USHORT x;
+	USHORT y;
+	ULONG i;
+
+	for (i = 0; i < Count; i++)
+	{
+		x = Points[i].X;
+		y = Points[i].Y;
+		TchTranslateToDisplayCoordinates(&x, &y, Props);
+
+		if (x != Points[i].ExpectedX || y != Points[i].ExpectedY)
+		{
+			fprintf(
+				stderr,
+				"(%u,%u) translated to (%u,%u), expected (%u,%u)\n",
+				Points[i].X,
+				Points[i].Y,
+				x,
+				y,
+				Points[i].ExpectedX,
+				Points[i].ExpectedY);
+
+			same = FALSE;
+		}
+	}
+
+	return same;
+}
+
+static VOID
+TestResolutionsDefaults(
+	IN WDFDEVICE Device
+)
+/*++
+
+  Routine Description:
+
+	Without settings the touch and display areas are the default
+	800x1280 and coordinates pass through unchanged
+
+--*/
+{
+	static const TEST_POINT points[] =
+	{
+		{ 0, 0, 0, 0 },
+		{ 400, 640, 400, 640 },
+		{ 799, 1279, 799, 1279 },
+		{ 4000, 4000, 799, 1279 },
+	};
+	TOUCH_SCREEN_PROPERTIES props;
+
+	HostRegistryClear();
+
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_SUCCESS);
+	TEST_CHECK(props.TouchPhysicalWidth == 800 && props.TouchPhysicalHeight == 1280);
+	TEST_CHECK(props.DisplayViewableWidth == 800 && props.DisplayViewableHeight == 1280);
+	TEST_CHECK(props.TouchAdjustedWidth == 800 && props.TouchAdjustedHeight == 1280);
+	TEST_CHECK(props.DisplayAdjustedWidth == 800 && props.DisplayAdjustedHeight == 1280);
+	TEST_CHECK(props.DisplayAdjustedButtonHeight == 0);
+	TEST_CHECK(TestResolutionsTranslate(&props, points, ARRAYSIZE(points)));
+}
+
+static VOID
+TestResolutionsBorders(
+	IN WDFDEVICE Device
+)
+/*++
+
+  Routine Description:
+
+	A touch sensor of twice the display resolution, with a pillar box
+	on the touch side and a capacitive button strip below the display
+
+--*/
+{
+	static const TEST_POINT points[] =
+	{
+		{ 0, 0, 0, 0 },
+		{ 100, 0, 0, 0 },
+		{ 900, 1280, 400, 640 },
+		{ 1900, 2560, 799, 1280 },
+		{ 1999, 2719, 799, 1359 },
+	};
+	TOUCH_SCREEN_PROPERTIES props;
+
+	HostRegistryClear();
+	HostRegistrySetValue("TouchPhysicalWidth", "2000");
+	HostRegistrySetValue("TouchPhysicalHeight", "2720");
+	HostRegistrySetValue("TouchPillarBoxWidthLeft", "100");
+	HostRegistrySetValue("TouchPillarBoxWidthRight", "300");
+	HostRegistrySetValue("TouchPhysicalButtonHeight", "160");
+	HostRegistrySetValue("DisplayPhysicalWidth", "800");
+	HostRegistrySetValue("DisplayPhysicalHeight", "1280");
+
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_SUCCESS);
+	TEST_CHECK(props.TouchAdjustedWidth == 1600);
+	TEST_CHECK(props.TouchAdjustedHeight == 2720);
+	TEST_CHECK(props.DisplayAdjustedButtonHeight == 80);
+	TEST_CHECK(props.DisplayAdjustedHeight == 1360);
+	TEST_CHECK(TestResolutionsTranslate(&props, points, ARRAYSIZE(points)));
+}
+
+static VOID
+TestResolutionsInvalid(
+	IN WDFDEVICE Device
+)
+/*++
+
+  Routine Description:
+
+	Borders wider than the sensor are dropped, settings that leave no
+	area to scale over are rejected, and a value that is not a number
+	leaves the defaults in place
+
+--*/
+{
+	TOUCH_SCREEN_PROPERTIES props;
+
+	HostRegistryClear();
+	HostRegistrySetValue("TouchPillarBoxWidthLeft", "500");
+	HostRegistrySetValue("TouchPillarBoxWidthRight", "300");
+	HostRegistrySetValue("TouchLetterBoxHeightTop", "1280");
+
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_SUCCESS);
+	TEST_CHECK(props.TouchPillarBoxWidthLeft == 0 && props.TouchPillarBoxWidthRight == 0);
+	TEST_CHECK(props.TouchLetterBoxHeightTop == 0);
+	TEST_CHECK(props.TouchAdjustedWidth == 800 && props.TouchAdjustedHeight == 1280);
+
+	HostRegistryClear();
+	HostRegistrySetValue("TouchPhysicalButtonHeight", "1280");
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_INVALID_PARAMETER);
+
+	HostRegistryClear();
+	HostRegistrySetValue("DisplayLetterBoxHeightTop", "640");
+	HostRegistrySetValue("DisplayLetterBoxHeightBottom", "640");
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_INVALID_PARAMETER);
+
+	HostRegistryClear();
+	HostRegistrySetValue("DisplayPillarBoxWidthLeft", "800");
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_INVALID_PARAMETER);
+
+	HostRegistryClear();
+	HostRegistrySetValue("TouchPhysicalWidth", "0");
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_INVALID_PARAMETER);
+
+	HostRegistryClear();
+	HostRegistrySetValue("TouchSwapAxes", "yes");
+	TEST_CHECK(TchGetScreenProperties(Device, &props) == STATUS_SUCCESS);
+	TEST_CHECK(props.TouchSwapAxes == 0);
+	TEST_CHECK(props.DisplayPhysicalWidth == 800 && props.DisplayPhysicalHeight == 1280);
+}
+
+static VOID
+TestResolutionsDevices(
+	IN WDFDEVICE First,
+	IN WDFDEVICE Second
+)
+/*++
+
+  Routine Description:
+
+	Both devices share a display size. The first overrides it with a
+	landscape panel, the second swaps and inverts its axes. Each must
+	read its own values on top of the shared ones, in either order.
+
+--*/
+{
+	static const TEST_POINT firstPoints[] =
+	{
+		{ 0, 0, 0, 0 },
+		{ 1920, 1080, 1919, 1079 },
+		{ 960, 540, 960, 540 },
+	};
+	static const TEST_POINT secondPoints[] =
+	{
+		{ 0, 0, 799, 0 },
+		{ 1279, 799, 0, 1279 },
+		{ 640, 200, 599, 640 },
+	};
+	TOUCH_SCREEN_PROPERTIES first;
+	TOUCH_SCREEN_PROPERTIES second;
+	TOUCH_SCREEN_PROPERTIES again;
+	TOUCH_SCREEN_PROPERTIES shared;
+	WDFDEVICE other;
+
+	HostRegistryClear();
+	HostRegistrySetValue("DisplayPhysicalWidth", "800");
+	HostRegistrySetValue("DisplayPhysicalHeight", "1280");
+	HostRegistrySetValue("TouchPhysicalWidth", "800");
+	HostRegistrySetValue("TouchPhysicalHeight", "1280");
+
+	HostRegistrySetDeviceValue(First, "DisplayPhysicalWidth", "1920");
+	HostRegistrySetDeviceValue(First, "DisplayPhysicalHeight", "1080");
+	HostRegistrySetDeviceValue(First, "TouchPhysicalWidth", "1920");
+	HostRegistrySetDeviceValue(First, "TouchPhysicalHeight", "1080");
+
+	HostRegistrySetDeviceValue(Second, "TouchSwapAxes", "1");
+	HostRegistrySetDeviceValue(Second, "TouchInvertXAxis", "1");
+
+	TEST_CHECK(TchGetScreenProperties(First, &first) == STATUS_SUCCESS);
+	TEST_CHECK(TchGetScreenProperties(Second, &second) == STATUS_SUCCESS);
+	TEST_CHECK(TchGetScreenProperties(First, &again) == STATUS_SUCCESS);
+
+	TEST_CHECK(first.DisplayViewableWidth == 1920 && first.DisplayViewableHeight == 1080);
+	TEST_CHECK(first.TouchSwapAxes == 0 && first.TouchInvertXAxis == 0);
+	TEST_CHECK(second.DisplayViewableWidth == 800 && second.DisplayViewableHeight == 1280);
+	TEST_CHECK(second.TouchSwapAxes == 1 && second.TouchInvertXAxis == 1);
+	TEST_CHECK(memcmp(&first, &again, sizeof(first)) == 0);
+
+	TEST_CHECK(TestResolutionsTranslate(&first, firstPoints, ARRAYSIZE(firstPoints)));
+	TEST_CHECK(TestResolutionsTranslate(&second, secondPoints, ARRAYSIZE(secondPoints)));
+
+	//
+	// A device with no values of its own reads the shared ones
+	//
+	TEST_CHECK(HostDeviceCreate(WDF_NO_OBJECT_ATTRIBUTES, &other) == STATUS_SUCCESS);
+	TEST_CHECK(TchGetScreenProperties(other, &shared) == STATUS_SUCCESS);
+	TEST_CHECK(shared.DisplayViewableWidth == 800 && shared.TouchSwapAxes == 0);
+	WdfObjectDelete(other);
+
+	HostRegistryClear();
+}
+
+VOID
+TestResolutions(
+	VOID
+)
+{
+	WDFDEVICE first;
+	WDFDEVICE second;
+
+	if (HostDeviceCreate(WDF_NO_OBJECT_ATTRIBUTES, &first) != STATUS_SUCCESS ||
+		HostDeviceCreate(WDF_NO_OBJECT_ATTRIBUTES, &second) != STATUS_SUCCESS)
+	{
+		TestFail(__FILE__, __LINE__, "HostDeviceCreate");
+		return;
+	}
+
+	TestResolutionsDefaults(first);
+	TestResolutionsBorders(first);
+	TestResolutionsInvalid(first);
+	TestResolutionsDevices(first, second);
+
+	WdfObjectDelete(second);
+	WdfObjectDelete(first);
+}
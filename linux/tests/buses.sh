@@ -0,0 +1,39 @@
+#!/bin/sh
+#
+# Plays the multitouch case with the simulated controller reached through
+# the driver's I2C and SPI transports instead of directly. The reports
+# must be the ones expected of the direct run, and an F54 capture over
+# SPI, whose reports take bursts past the default transfer buffers, must
+# read whole frames with no error counted by the driver.
+#
+
+failed=0
+
+for bus in i2c spi; do
+	out=obj/tests/transport-$bus.out
+
+	if ! ./rmi4d --simulate --sink=memory --dump --bus $bus \
+		$(cat tests/multitouch.args) > "$out"; then
+		echo "$bus: rmi4d failed"
+		failed=1
+	elif ! diff -u tests/multitouch.expected "$out"; then
+		echo "$bus: reports differ"
+		failed=1
+	else
+		echo "$bus: reports match"
+	fi
+done
+
+out=$(./rmi4d --simulate --sink=memory -v --bus spi --f54 3 \
+	--script tests/multitouch.script 2>&1) || failed=1
+echo "$out" | grep "F54 frames"
+
+set -- $(echo "$out" | sed -n \
+	's/.*F54 frames read \([0-9]*\), missed [0-9]*, torn [0-9]*, corrupt \([0-9]*\), errors \([0-9]*\).*/\1 \2 \3/p')
+
+if [ $# -ne 3 ] || [ "$1" -eq 0 ] || [ "$2" -ne 0 ] || [ "$3" -ne 0 ]; then
+	echo "spi: F54 capture failed"
+	failed=1
+fi
+
+exit $failed
@@ -0,0 +1,41 @@
+#!/bin/sh
+#
+# Presses the simulated F1A buttons. F1A data bit 2 is button 0, tapped
+# for consumer Search, bit 1 is button 1, tapped for the Start key, and
+# bit 0 is button 2, tapped for consumer Back and held for ALT+TAB. The
+# hold time and repeat interval of button 2 are shortened so its long
+# press, two repeats and the release of the latched ALT fit in the
+# 450 ms it is held, 50 ms away from the next repeat.
+#
+
+script=obj/tests/buttons.script
+rm -f "$script"
+
+# press BIT FRAMES: BIT held for FRAMES frames, then released
+press() {
+	for frame in $(seq "$2"); do
+		echo "b$1" >> "$script"
+	done
+
+	echo >> "$script"
+}
+
+press 2 3       # Search tap
+press 1 3       # Start tap
+press 0 3       # Back tap, released before the hold time
+press 0 45      # ALT+TAB at 200 ms, repeated at 300 and 400 ms
+
+expected="5:01 5:00 4:01 4:00 5:02 5:00 4:06 4:04 4:06 4:04 4:06 4:04 4:00"
+
+out=$(./rmi4d --simulate --buttons --sink=memory --dump \
+	--set Button2HoldTime=200 --set Button2Repeat=100 --script "$script") ||
+	exit 1
+
+keys=$(echo "$out" |
+	sed -n 's/^report [0-9]* id \([0-9]*\) keys 0x\([0-9A-F]*\)$/\1:\2/p' |
+	tr '\n' ' ' | sed 's/ $//')
+
+echo "keys:     $keys"
+echo "expected: $expected"
+
+[ "$keys" = "$expected" ]
@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Turns the simulated monitor off and on through the monitor power
+# callback. Screen-off disables the touch and F54 interrupt sources and
+# puts the controller to sleep, so the frames played until the monitor is back
+# on are lost, and screen-on restores both. A screen-off whose sleep
+# write fails enables the touch source again and leaves the display
+# state on: touch keeps being reported and the next monitor on is not
+# a transition.
+#
+
+script=obj/tests/display.script
+
+cat > "$script" <<'END'
+0:100:100
+0:110:100
+0:120:100
+%off
+0:130:100
+0:140:100
+%on
+0:150:100
+0:160:100
+
+%off fail
+0:170:100
+0:180:100
+
+%on
+0:190:100
+
+END
+
+expected="0/0x07@0 0/0x01@3 1/0x01@3 0/0x07@5 0/0x01@8 0/0x07@8"
+
+./rmi4d --simulate --sink=memory --dump -v --set ContactFilterEnable=0 \
+	--script "$script" > obj/tests/display.out 2> obj/tests/display.trace ||
+	{ cat obj/tests/display.trace; exit 1; }
+
+states=$(sed -n \
+	's/.*Simulated F01 sleep mode \([0-9]*\) interrupt enable \(0x[0-9A-F]*\) at frame \([0-9]*\).*/\1\/\2@\3/p' \
+	obj/tests/display.trace | tr '\n' ' ' | sed 's/ $//')
+transitions=$(sed -n 's/.*Screen-\([a-z]*\) transition took.*/\1/p' \
+	obj/tests/display.trace | tr '\n' ' ' | sed 's/ $//')
+
+echo "F01 states:  $states"
+echo "expected:    $expected"
+echo "transitions: $transitions"
+cat obj/tests/display.out
+
+failed=0
+
+[ "$states" = "$expected" ] || failed=1
+[ "$transitions" = "off on" ] || failed=1
+
+# Frames 4 and 5 are played while asleep, frames 11 and 12 after the
+# failed screen-off are reported
+grep -q "scan [45]00 \[id 0 tip 1" obj/tests/display.out && failed=1
+grep -q "scan 1000 \[id 0 tip 1 x 180 y 100\]" obj/tests/display.out || failed=1
+
+exit $failed
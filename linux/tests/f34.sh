@@ -0,0 +1,90 @@
+#!/bin/sh
+#
+# Flashes the simulated controller with an image written by the
+# simulator itself, both firmware and configuration and the
+# configuration alone, and restarts it. An update that fails at the
+# 100th firmware block must resume from there and complete, but not
+# from a copy whose payload no longer matches its checksum. Images with
+# a wrong checksum, for another product or for another bootloader must
+# be rejected before the controller enters the bootloader. The rate is
+# traced for information only, it depends on the host.
+#
+
+image=obj/tests/f34.img
+bad=obj/tests/f34-bad.img
+script=obj/tests/f34.script
+
+printf '0:400:400\n\n' > "$script"
+
+./rmi4d --simulate --write-f34-image "$image" || exit 1
+
+capture() {
+	./rmi4d --simulate --sink=memory -v --script "$script" "$@" 2>&1 ||
+		echo "exit failed"
+}
+
+check() {
+	out=$(capture "$@")
+	echo "$out" | grep "F34\|Simulated controller\|Resuming\|Image\|exit failed"
+	! echo "$out" | grep -q "exit failed"
+}
+
+expect() {
+	echo "$out" | grep -q "$1"
+}
+
+#
+# Copies the image with the bytes at Offset replaced and, unless told
+# not to, a Fletcher-32 checksum over the edited payload, so that only
+# the edit itself can reject it
+#
+edit() {
+	cp "$image" "$bad"
+	printf "$2" | dd of="$bad" bs=1 seek=$1 conv=notrunc 2>/dev/null
+	[ "$3" = "keep" ] && return
+
+	sum=$(od -An -v -tu2 -j4 "$bad" | awk '
+		BEGIN { s1 = 65535; s2 = 65535 }
+		{
+			for (i = 1; i <= NF; i++) {
+				s1 += $i; s2 += s1
+				s1 = s1 % 65536 + int(s1 / 65536)
+				s2 = s2 % 65536 + int(s2 / 65536)
+			}
+		}
+		END {
+			printf "\\%03o\\%03o\\%03o\\%03o", s1 % 256, int(s1 / 256),
+				s2 % 256, int(s2 / 256)
+		}')
+
+	printf "$sum" | dd of="$bad" bs=1 seek=0 conv=notrunc 2>/dev/null
+}
+
+rejected() {
+	out=$(capture --f34 "$bad")
+	echo "$out" | grep "Image\|exit failed"
+	expect "$1" &&
+		expect "exit failed" &&
+		! expect "Simulated F34 flash programming enabled"
+}
+
+check --f34 "$image" &&
+	expect "F34 update done, 4224 bytes written" &&
+	expect "firmware flashed, configuration flashed" &&
+	check --f34 "$image" --f34-config-only &&
+	expect "F34 update done, 128 bytes written" &&
+	expect "firmware kept, configuration flashed" &&
+	check --f34 "$image" --f34-fail-block 100 --f34-resume "$image" &&
+	expect "F34 update failed in state 3" &&
+	expect "Resuming F34 update in state 3 at block 99" &&
+	expect "F34 update done, 4224 bytes written" &&
+	edit 300 '\377' keep &&
+	! check --f34 "$image" --f34-fail-block 100 --f34-resume "$bad" &&
+	expect "Image checksum is" &&
+	rejected "Image checksum is" &&
+	edit 4 '' &&
+	cmp -s "$image" "$bad" &&
+	edit 16 'S3202\000' &&
+	rejected "Image is for product S3202" &&
+	edit 7 '\006' &&
+	rejected "Image is for bootloader V6"
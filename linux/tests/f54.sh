@@ -0,0 +1,51 @@
+#!/bin/sh
+#
+# Streams F54 reports from the simulated controller while it plays a two
+# second gesture, into a ring of four slots and into one of two, which
+# wraps every other frame. Every frame the reader takes must be one
+# whole report of the simulator, with no error counted by the driver,
+# and the stream must keep up with at least 100 frames per second. The
+# stream is parked while the monitor is off and the controller sleeps,
+# so that half second counts no timed out report. A report type the
+# controller does not support must not start.
+#
+
+script=obj/tests/f54.script
+offscript=obj/tests/f54-off.script
+rm -f "$script" "$offscript"
+
+for frame in $(seq 200); do
+	echo "0:400:$((400 + frame))" >> "$script"
+	[ $frame -eq 50 ] && echo "%off" >> "$offscript"
+	[ $frame -eq 100 ] && echo "%on" >> "$offscript"
+	echo "0:400:$((400 + frame))" >> "$offscript"
+done
+
+echo >> "$script"
+echo >> "$offscript"
+
+capture() {
+	./rmi4d --simulate --sink=memory -v --script "$script" "$@" 2>&1 ||
+		echo "exit failed"
+}
+
+check() {
+	out=$(capture "$@")
+	echo "$out" | grep "F54\|exit failed"
+
+	set -- $(echo "$out" | sed -n \
+		's/.*F54 captured \([0-9]*\) frames.* \([0-9]*\) per second.*/\1 \2/p;
+		s/.*F54 frames read \([0-9]*\), missed \([0-9]*\), torn \([0-9]*\), corrupt \([0-9]*\), errors \([0-9]*\).*/\1 \2 \3 \4 \5/p')
+
+	[ $# -eq 7 ] &&
+		! echo "$out" | grep -q "exit failed" &&
+		[ "$2" -ge 100 ] &&
+		[ "$3" -ge $(($1 / 2)) ] &&
+		[ "$6" -eq 0 ] &&
+		[ "$7" -eq 0 ]
+}
+
+check --f54 3 &&
+	check --f54 9 --f54-slots 2 &&
+	script="$offscript" check --f54 3 &&
+	capture --f54 1 | grep -q "exit failed"
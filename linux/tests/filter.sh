@@ -0,0 +1,69 @@
+#!/bin/sh
+#
+# Replays two generated traces through the contact filter with rmi4replay
+# and checks its quality and cost against fixed bounds:
+#
+#   still  a resting contact with up to 3 units of noise on each axis, the
+#          reported positions must move a quarter as much as the trace
+#   swipe  a contact moving 10 units per frame, the reported positions
+#          must lag less than 2 frames of motion on average and 4 at most
+#
+# The time the filter and predictor take per sample is reported for
+# information only, it depends on the host and a sample this small is
+# too noisy to bound.
+#
+
+still=obj/tests/still.trace
+swipe=obj/tests/swipe.trace
+
+#
+# A small LCG keeps the noise the same with every awk
+#
+awk 'BEGIN {
+	seed = 1
+	for (i = 0; i < 200; i++) {
+		seed = (seed * 75 + 74) % 65537; dx = seed % 7 - 3
+		seed = (seed * 75 + 74) % 65537; dy = seed % 7 - 3
+		printf "0:%d:%d\n", 400 + dx, 600 + dy
+	}
+}' > "$still"
+
+awk 'BEGIN { for (i = 0; i < 60; i++) printf "0:%d:600\n", 100 + 10 * i }' > "$swipe"
+
+# value TABLE ROW COLUMN: a mean, rms or max column (2, 3, 4) of a row
+# of the error or jitter table
+value() {
+	awk -v table="$1" -v row="$2" -v column="$3" '
+		$1 == "error" || $1 == "jitter" { current = $1 }
+		current == table && $1 == row { print $column; exit }'
+}
+
+# check DESCRIPTION A OP B, OP one of < and <=
+check() {
+	if awk -v a="$2" -v b="$4" -v op="$3" 'BEGIN { exit !(op == "<" ? a < b : a <= b) }'; then
+		echo "ok   $1: $2 $3 $4"
+	else
+		echo "FAIL $1: $2 $3 $4"
+		failed=1
+	fi
+}
+
+failed=0
+
+./rmi4replay --horizon 0 "$still" > obj/tests/still.out || exit 1
+./rmi4replay --horizon 0 "$swipe" > obj/tests/swipe.out || exit 1
+cat obj/tests/still.out obj/tests/swipe.out
+
+traceJitter=$(value jitter trace 3 < obj/tests/still.out)
+reportedJitter=$(value jitter reported 3 < obj/tests/still.out)
+check "still jitter rms" "$reportedJitter" "<=" "$(awk -v j="$traceJitter" 'BEGIN { print j / 4 }')"
+
+check "swipe lag mean" "$(value error reported 2 < obj/tests/swipe.out)" "<" 20
+check "swipe lag max" "$(value error reported 4 < obj/tests/swipe.out)" "<" 40
+
+for out in obj/tests/still.out obj/tests/swipe.out; do
+	echo "info $(basename "$out" .out) cost:" \
+		"$(sed -n 's/^cost \([0-9.]*\) ns per sample/\1/p' "$out") ns per sample"
+done
+
+exit $failed
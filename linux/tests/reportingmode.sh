@@ -0,0 +1,54 @@
+#!/bin/sh
+#
+# Plays a contact through the simulated F12 and checks the reporting
+# mode the driver switches Ctrl20 to. A contact held within the still
+# threshold for 30 frames enters reduced reporting. Once there, jitter
+# and motion up to the exit threshold keep it there, and a larger step
+# returns it to continuous reporting. In continuous reporting, motion
+# between the two thresholds never counts as still. A contact arriving
+# or lifting also returns it to continuous reporting.
+#
+
+script=obj/tests/reportingmode.script
+rm -f "$script"
+
+# frames COUNT X-STEP [SECOND]: COUNT frames of contact 0 moving X-STEP
+# per frame from its last position, with contact 1 held when SECOND is
+# set. A negative X-STEP alternates, which is jitter.
+x=400
+frames() {
+	for frame in $(seq "$1"); do
+		if [ "$2" -lt 0 ]; then
+			x=$((x + (frame % 2 * 2 - 1) * $2))
+		else
+			x=$((x + $2))
+		fi
+
+		echo "0:$x:600${3:+ 1:200:300}" >> "$script"
+	done
+}
+
+frames 40 0          # 1-40     still, reduced from frame 31
+frames 10 -3         # 41-50    jitter within the still threshold
+frames 5 8           # 51-55    motion within the exit threshold
+frames 1 20          # 56       motion past it, continuous
+frames 40 8          # 57-96    motion past the still threshold
+frames 34 0          # 97-130   still, reduced from frame 126
+frames 1 0 second    # 131      second contact, continuous
+frames 34 0 second   # 132-165  still, reduced from frame 161
+frames 1 0           # 166      second contact lifts, continuous
+echo >> "$script"    # 167      both lifted
+
+expected="1@31 0@56 1@126 0@131 1@161 0@166"
+
+out=$(./rmi4d --simulate --touch f12 --sink=memory -v --script "$script" 2>&1) ||
+	{ echo "$out"; exit 1; }
+
+modes=$(echo "$out" |
+	sed -n 's/.*Simulated F12 reporting mode \([0-9]*\) at frame \([0-9]*\).*/\1@\2/p' |
+	tr '\n' ' ' | sed 's/ $//')
+
+echo "reporting modes: $modes"
+echo "expected:        $expected"
+
+[ "$modes" = "$expected" ]
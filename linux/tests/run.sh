@@ -0,0 +1,75 @@
+#!/bin/sh
+#
+# Runs the host checks: the unit checks in rmi4test when it is built,
+# every other script in tests/, then every simulator case. A script
+# passes when it exits with 0. A case is NAME.args, the rmi4d options
+# it runs with, and NAME.expected, the reports the memory sink must
+# dump. Paths are relative to the linux directory.
+#
+#   tests/run.sh [--update] [NAME...]
+#
+# --update rewrites the expected reports of the cases run instead of
+# comparing against them.
+#
+
+cd "$(dirname "$0")/.." || exit 1
+
+update=0
+all=0
+
+if [ "$1" = "--update" ]; then
+	update=1
+	shift
+fi
+
+if [ $# -eq 0 ]; then
+	all=1
+	set -- $(for args in tests/*.args; do basename "$args" .args; done)
+fi
+
+mkdir -p obj/tests
+failed=0
+
+if [ $update -eq 0 ] && [ $all -eq 1 ]; then
+	if [ -x ./rmi4test ] && ! ./rmi4test; then
+		failed=1
+	fi
+
+	for check in tests/*.sh; do
+		name=$(basename "$check" .sh)
+
+		if [ "$name" = run ]; then
+			continue
+		fi
+
+		if "$check" > "obj/tests/$name.log" 2>&1; then
+			echo "PASS $name"
+		else
+			echo "FAIL $name, see obj/tests/$name.log"
+			failed=1
+		fi
+	done
+fi
+
+for name in "$@"; do
+	out="obj/tests/$name.out"
+
+	if ! ./rmi4d --simulate --sink=memory --dump $(cat "tests/$name.args") \
+		> "$out" 2> "obj/tests/$name.log"; then
+		echo "FAIL $name: rmi4d failed, see obj/tests/$name.log"
+		failed=1
+		continue
+	fi
+
+	if [ $update -eq 1 ]; then
+		cp "$out" "tests/$name.expected"
+		echo "UPDATED $name"
+	elif diff -u "tests/$name.expected" "$out" > "obj/tests/$name.diff"; then
+		echo "PASS $name"
+	else
+		echo "FAIL $name: reports differ, see obj/tests/$name.diff"
+		failed=1
+	fi
+done
+
+exit $failed
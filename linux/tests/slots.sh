@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Plays 200 frames of moving contacts on simulated F12 controllers
+# reporting 10, 16 and 32 objects, once with every object down and
+# once with two. The driver must size its contact slots from the F12
+# data register, report every contact down on the last frame and lift
+# them all. The time it takes to service an interrupt is traced for
+# each run, for information only: it depends on the host, and with two
+# contacts it should not grow with the slot count.
+#
+
+failed=0
+
+# run OBJECTS CONTACTS
+run() {
+	name=slots-$1-$2
+	script=obj/tests/$name.script
+	out=obj/tests/$name.out
+	trace=obj/tests/$name.trace
+
+	awk -v contacts=$2 'BEGIN {
+		for (frame = 0; frame < 200; frame++) {
+			line = ""
+			for (id = 0; id < contacts; id++)
+				line = line sprintf("%s%d:%d:%d", id ? " " : "", id,
+					40 + 24 * id, 100 + 4 * frame)
+			print line
+		}
+		print ""
+	}' > "$script"
+
+	if ! ./rmi4d --simulate --sink=memory --dump -v --touch f12 \
+		--objects $1 --set ContactFilterEnable=0 \
+		--script "$script" > "$out" 2> "$trace"; then
+		echo "$name: rmi4d failed"
+		failed=1
+		return
+	fi
+
+	echo "$name: $(sed -n 's/.*ST: \(Serviced .*\)/\1/p' "$trace")"
+
+	grep -q "Serviced [0-9]* interrupts with $1 contact slots" "$trace" &&
+		grep -q "touch count $2 scan [0-9]* \[id [0-9]* tip 1 .* y 896\]" "$out" &&
+		[ "$(grep -o "tip 0" "$out" | wc -l)" -eq $2 ] ||
+		{ echo "$name: slots not scaled"; failed=1; }
+}
+
+for objects in 10 16 32; do
+	run $objects $objects
+	run $objects 2
+done
+
+exit $failed
@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Checks the start timeline of a cold start, which discovers and
+# persists the topology, and of a start on the persisted topology. Every
+# phase the host goes through must be recorded, in order, and the
+# deferred phases must only run once the device has entered D0, so that
+# backlight bring-up and the registry write stay off the start path.
+#
+
+state=obj/tests/start.state
+rm -f "$state"
+
+# Phases in the order they complete. The report descriptor phase
+# belongs to the HID miniport, which the host does not go through.
+phases="prepare_hardware transport settings topology configured D0_entry
+	work_item backlight display_callback complete"
+
+timeline() {
+	./rmi4d --simulate --sink=memory -v --state "$state" 2>&1 |
+		sed -n 's/.*Start phase //p' |
+		awk '{ name = $1; for (i = 2; i < NF - 1; i++) name = name "_" $i;
+			print name "=" $(NF - 1) }'
+}
+
+check() {
+	echo "$1:"
+	echo "$2" | sed 's/^/  /'
+
+	last=0
+	for phase in $phases; do
+		time=$(echo "$2" | sed -n "s/^$phase=//p")
+
+		if [ -z "$time" ]; then
+			echo "$1: no $phase phase"
+			return 1
+		fi
+
+		if [ "$time" -lt "$last" ]; then
+			echo "$1: $phase at $time us, before the previous phase"
+			return 1
+		fi
+
+		last=$time
+	done
+
+	if [ $(echo "$2" | wc -l) -ne $(echo $phases | wc -w) ]; then
+		echo "$1: unexpected phases"
+		return 1
+	fi
+}
+
+check cold "$(timeline)" &&
+	check persisted "$(timeline)"
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# Starts the simulated controller three times on one state file: cold,
+# with the topology the first start persisted, and after a reflash that
+# only changes the firmware build. The cached start must skip discovery
+# and cost fewer bus transfers and less bus time than the cold one, the
+# reflashed one must discover the functions again.
+#
+
+state=obj/tests/topology.state
+rm -f "$state"
+
+start() {
+	./rmi4d --simulate --sink=memory -v --state "$state" "$@" 2>&1 |
+		sed -n 's/.*Controller started in [0-9]* us, topology \([a-z]*\).*/topology \1/p;
+			s/.*Start made \([0-9]*\) bus transfers, \([0-9]*\) us.*/bus \1 \2/p'
+}
+
+cold=$(start)
+cached=$(start)
+reflashed=$(start --firmware-build 2)
+
+echo "cold:      $(echo $cold)"
+echo "cached:    $(echo $cached)"
+echo "reflashed: $(echo $reflashed)"
+
+set -- $cold
+coldTopology=$2 coldTransfers=$4 coldTime=$5
+set -- $cached
+cachedTopology=$2 cachedTransfers=$4 cachedTime=$5
+set -- $reflashed
+reflashedTopology=$2
+
+[ "$coldTopology" = discovered ] &&
+	[ "$cachedTopology" = persisted ] &&
+	[ "$reflashedTopology" = discovered ] &&
+	[ "$cachedTransfers" -lt "$coldTransfers" ] &&
+	[ "$cachedTime" -lt "$coldTime" ]
@@ -0,0 +1,347 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		testtransport.c
+
+	Abstract:
+
+		Checks the I2C and RMI-SPI transports against the simulator. The
+		registers read over each bus must match those the simulator
+		returns directly, paging must land on the page asked for, and a
+		transfer that fails or moves only part of its data must fail the
+		access without leaving the transport and the controller on
+		different pages, so that the caller can try again.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <stdio.h>
+#include <string.h>
+#include "rmitest.h"
+#include "rmiinternal.h"
+
+//
+// Registers a test may overwrite, the F11 control registers
+//
+#define TEST_TRANSPORT_WRITE_ADDRESS   0x08
+
+typedef struct _TEST_TRANSPORT_BUS
+{
+	PCSTR Name;
+	HOST_SIM_BUS Bus;
+	const SPB_TRANSPORT* Transport;
+
+	//
+	// Bus transfers one register read takes, an I2C read first sets
+	// the address pointer
+	//
+	ULONG TransfersPerRead;
+} TEST_TRANSPORT_BUS;
+
+static const TEST_TRANSPORT_BUS gBuses[] =
+{
+	{ "I2C", HostSimBusI2c, &SpbI2cTransport, 2 },
+	{ "SPI", HostSimBusSpi, &SpbSpiTransport, 1 },
+};
+
+static BOOLEAN
+TestTransportReadsPage(
+	IN SPB_CONTEXT* SpbContext,
+	IN const RMI4_FUNCTION_DESCRIPTOR* PageZero
+)
+/*++
+
+  Routine Description:
+
+	Tells whether the PDT entry read through SpbContext is the one of
+	page 0. Other pages of the simulator read as zeros.
+
+--*/
+{
+	RMI4_FUNCTION_DESCRIPTOR descriptor;
+
+	if (!NT_SUCCESS(SpbReadDataSynchronously(
+		SpbContext,
+		RMI4_FIRST_FUNCTION_ADDRESS,
+		&descriptor,
+		sizeof(descriptor))))
+	{
+		return FALSE;
+	}
+
+	return memcmp(&descriptor, PageZero, sizeof(descriptor)) == 0;
+}
+
+static VOID
+TestTransportAccess(
+	IN const TEST_TRANSPORT_BUS* Bus,
+	IN SPB_CONTEXT* Direct,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Reads, writes and pages through the transport with no fault
+
+--*/
+{
+	static const UCHAR pattern[] = { 0x11, 0x22, 0x33, 0x44 };
+	RMI4_FUNCTION_DESCRIPTOR expected;
+	RMI4_FUNCTION_DESCRIPTOR descriptor;
+	UCHAR directPage[256];
+	UCHAR page[256];
+	UCHAR block[DEFAULT_SPB_BUFFER_SIZE + 16];
+	ULONG transfers;
+	ULONG64 busTime;
+	ULONG i;
+
+	TEST_CHECK(SpbContext->Transport == Bus->Transport);
+	TEST_CHECK(SpbGetMaxTransferSize(SpbContext) == MAXUSHORT);
+
+	//
+	// A read within the default buffers and one into the caller's
+	// buffer, compared with the simulator's own registers
+	//
+	TEST_CHECK(SpbReadDataSynchronously(
+		Direct,
+		RMI4_FIRST_FUNCTION_ADDRESS,
+		&expected,
+		sizeof(expected)) == STATUS_SUCCESS);
+	TEST_CHECK(expected.Number != 0);
+	TEST_CHECK(SpbReadDataSynchronously(
+		SpbContext,
+		RMI4_FIRST_FUNCTION_ADDRESS,
+		&descriptor,
+		sizeof(descriptor)) == STATUS_SUCCESS);
+	TEST_CHECK(memcmp(&descriptor, &expected, sizeof(expected)) == 0);
+
+	TEST_CHECK(SpbReadDataSynchronously(Direct, 0, directPage, sizeof(directPage)) == STATUS_SUCCESS);
+	TEST_CHECK(SpbReadDataSynchronously(SpbContext, 0, page, sizeof(page)) == STATUS_SUCCESS);
+	TEST_CHECK(memcmp(page, directPage, sizeof(page)) == 0);
+
+	//
+	// Writes within the default buffer and past it
+	//
+	TEST_CHECK(SpbWriteDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		(PVOID)pattern,
+		sizeof(pattern)) == STATUS_SUCCESS);
+	TEST_CHECK(SpbReadDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		page,
+		sizeof(pattern)) == STATUS_SUCCESS);
+	TEST_CHECK(memcmp(page, pattern, sizeof(pattern)) == 0);
+
+	for (i = 0; i < sizeof(block); i++)
+	{
+		block[i] = (UCHAR)(i * 3 + 1);
+	}
+
+	TEST_CHECK(SpbWriteDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		block,
+		sizeof(block)) == STATUS_SUCCESS);
+	TEST_CHECK(SpbReadDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		page,
+		sizeof(block)) == STATUS_SUCCESS);
+	TEST_CHECK(memcmp(page, block, sizeof(block)) == 0);
+
+	//
+	// Page 1 is empty and drops writes, page 0 reads the same again
+	// once mapped back
+	//
+	TEST_CHECK(SpbSetPage(SpbContext, 1) == STATUS_SUCCESS);
+	TEST_CHECK(SpbContext->Page == 1);
+	TEST_CHECK(SpbReadDataSynchronously(
+		SpbContext,
+		RMI4_FIRST_FUNCTION_ADDRESS,
+		&descriptor,
+		sizeof(descriptor)) == STATUS_SUCCESS);
+	TEST_CHECK(descriptor.Number == 0);
+	TEST_CHECK(SpbWriteDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		(PVOID)pattern,
+		sizeof(pattern)) == STATUS_SUCCESS);
+	TEST_CHECK(SpbSetPage(SpbContext, 0) == STATUS_SUCCESS);
+	TEST_CHECK(TestTransportReadsPage(SpbContext, &expected));
+	TEST_CHECK(SpbReadDataSynchronously(
+		SpbContext,
+		TEST_TRANSPORT_WRITE_ADDRESS,
+		page,
+		sizeof(block)) == STATUS_SUCCESS);
+	TEST_CHECK(memcmp(page, block, sizeof(block)) == 0);
+
+	//
+	// Bursts larger than the transport moves are refused before they
+	// reach the bus
+	//
+	HostSimGetBusStatistics(SpbContext, &transfers, &busTime);
+	TEST_CHECK(SpbReadDataSynchronously(SpbContext, 0, page, MAXUSHORT + 1) == STATUS_INVALID_BUFFER_SIZE);
+	TEST_CHECK(SpbWriteDataSynchronously(SpbContext, 0, page, MAXUSHORT + 1) == STATUS_INVALID_BUFFER_SIZE);
+	HostSimGetBusStatistics(SpbContext, &i, &busTime);
+	TEST_CHECK(i == transfers);
+}
+
+static VOID
+TestTransportFaults(
+	IN const TEST_TRANSPORT_BUS* Bus,
+	IN SPB_CONTEXT* Direct,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Fails or cuts short single transfers. Each access must fail and
+	the same access made again must succeed.
+
+--*/
+{
+	static const UCHAR pattern[] = { 0x55, 0x66, 0x77, 0x88 };
+	static const HOST_SIM_BUS_FAULT faults[] = { HostSimBusFaultError, HostSimBusFaultShort };
+	RMI4_FUNCTION_DESCRIPTOR expected;
+	UCHAR page[256];
+	UCHAR reference[256];
+	ULONG transfer;
+	ULONG i;
+
+	TEST_CHECK(SpbReadDataSynchronously(
+		Direct,
+		RMI4_FIRST_FUNCTION_ADDRESS,
+		&expected,
+		sizeof(expected)) == STATUS_SUCCESS);
+
+	for (i = 0; i < ARRAYSIZE(faults); i++)
+	{
+		//
+		// Earlier writes only reached the registers behind the bus,
+		// compare against a read through it
+		//
+		TEST_CHECK(SpbReadDataSynchronously(SpbContext, 0, reference, sizeof(reference)) == STATUS_SUCCESS);
+
+		//
+		// Every transfer of a small read and of a large one
+		//
+		for (transfer = 1; transfer <= Bus->TransfersPerRead; transfer++)
+		{
+			if (faults[i] == HostSimBusFaultShort && transfer < Bus->TransfersPerRead)
+			{
+				//
+				// A one byte address pointer write cannot be cut short
+				//
+				continue;
+			}
+
+			HostSimBusInjectFault(SpbContext, transfer, faults[i]);
+			TEST_CHECK(!TestTransportReadsPage(SpbContext, &expected));
+			TEST_CHECK(TestTransportReadsPage(SpbContext, &expected));
+
+			HostSimBusInjectFault(SpbContext, transfer, faults[i]);
+			TEST_CHECK(!NT_SUCCESS(SpbReadDataSynchronously(SpbContext, 0, page, sizeof(page))));
+			TEST_CHECK(SpbReadDataSynchronously(SpbContext, 0, page, sizeof(page)) == STATUS_SUCCESS);
+			TEST_CHECK(memcmp(page, reference, sizeof(page)) == 0);
+		}
+
+		//
+		// A write
+		//
+		HostSimBusInjectFault(SpbContext, 1, faults[i]);
+		TEST_CHECK(!NT_SUCCESS(SpbWriteDataSynchronously(
+			SpbContext,
+			TEST_TRANSPORT_WRITE_ADDRESS,
+			(PVOID)pattern,
+			sizeof(pattern))));
+		TEST_CHECK(SpbWriteDataSynchronously(
+			SpbContext,
+			TEST_TRANSPORT_WRITE_ADDRESS,
+			(PVOID)pattern,
+			sizeof(pattern)) == STATUS_SUCCESS);
+		TEST_CHECK(SpbReadDataSynchronously(
+			SpbContext,
+			TEST_TRANSPORT_WRITE_ADDRESS,
+			page,
+			sizeof(pattern)) == STATUS_SUCCESS);
+		TEST_CHECK(memcmp(page, pattern, sizeof(pattern)) == 0);
+
+		//
+		// A page select that did not reach the controller must leave
+		// the transport on the page the controller is still on, and
+		// selecting the page again must map it in
+		//
+		HostSimBusInjectFault(SpbContext, 1, faults[i]);
+		TEST_CHECK(!NT_SUCCESS(SpbSetPage(SpbContext, 1)));
+		TEST_CHECK(SpbContext->Page == 0);
+		TEST_CHECK(TestTransportReadsPage(SpbContext, &expected));
+
+		TEST_CHECK(SpbSetPage(SpbContext, 1) == STATUS_SUCCESS);
+		TEST_CHECK(SpbContext->Page == 1);
+		TEST_CHECK(!TestTransportReadsPage(SpbContext, &expected));
+		TEST_CHECK(SpbSetPage(SpbContext, 0) == STATUS_SUCCESS);
+		TEST_CHECK(TestTransportReadsPage(SpbContext, &expected));
+	}
+}
+
+VOID
+TestTransport(
+	VOID
+)
+{
+	HOST_SIM_OPTIONS options;
+	HOST_ATTENTION directAttention;
+	HOST_ATTENTION attention;
+	SPB_CONTEXT direct;
+	SPB_CONTEXT spbContext;
+	ULONG i;
+
+	if (HostLoopInitialize() != STATUS_SUCCESS)
+	{
+		TestFail(__FILE__, __LINE__, "HostLoopInitialize");
+		return;
+	}
+
+	for (i = 0; i < ARRAYSIZE(gBuses); i++)
+	{
+		RtlZeroMemory(&options, sizeof(options));
+
+		if (HostSimOpen(&options, &direct, &directAttention) != STATUS_SUCCESS)
+		{
+			TestFail(__FILE__, __LINE__, "HostSimOpen");
+			break;
+		}
+
+		options.Bus = gBuses[i].Bus;
+
+		if (HostSimOpen(&options, &spbContext, &attention) != STATUS_SUCCESS)
+		{
+			TestFail(__FILE__, __LINE__, gBuses[i].Name);
+			directAttention.Ops->Close(&directAttention);
+			HostSimClose(&direct);
+			break;
+		}
+
+		TestTransportAccess(&gBuses[i], &direct, &spbContext);
+		TestTransportFaults(&gBuses[i], &direct, &spbContext);
+
+		attention.Ops->Close(&attention);
+		HostSimClose(&spbContext);
+		directAttention.Ops->Close(&directAttention);
+		HostSimClose(&direct);
+	}
+
+	HostLoopDeinitialize();
+}
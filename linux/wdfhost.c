@@ -0,0 +1,1883 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		wdfhost.c
+
+	Abstract:
+
+		Framework objects for the host: devices, queues, wait locks,
+		timers, work items, memory, collections, strings, I/O targets
+		served by the host and the requests sent to them.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include "wdfhost.h"
+#include "debug.h"
+
+typedef struct _HOST_QUEUE
+{
+	HOST_OBJECT Header;
+	HOST_SINK* Sink;
+} HOST_QUEUE;
+
+typedef struct _HOST_WAITLOCK
+{
+	HOST_OBJECT Header;
+	pthread_mutex_t Mutex;
+} HOST_WAITLOCK;
+
+typedef struct _HOST_TIMER
+{
+	HOST_OBJECT Header;
+	int Fd;
+	PFN_WDF_TIMER EvtTimerFunc;
+	ULONG Period;
+	BOOLEAN Armed;
+} HOST_TIMER;
+
+typedef struct _HOST_WORKITEM
+{
+	HOST_OBJECT Header;
+	int Fd;
+	PFN_WDF_WORKITEM EvtWorkItemFunc;
+	BOOLEAN Queued;
+} HOST_WORKITEM;
+
+typedef struct _HOST_MEMORY
+{
+	HOST_OBJECT Header;
+	PVOID Buffer;
+	SIZE_T Size;
+} HOST_MEMORY;
+
+typedef struct _HOST_COLLECTION
+{
+	HOST_OBJECT Header;
+	WDFOBJECT* Items;
+	ULONG Count;
+	ULONG Capacity;
+} HOST_COLLECTION;
+
+typedef struct _HOST_STRING
+{
+	HOST_OBJECT Header;
+	UNICODE_STRING String;
+} HOST_STRING;
+
+typedef struct _HOST_REQUEST HOST_REQUEST;
+
+typedef struct _HOST_IO_TARGET
+{
+	HOST_OBJECT Header;
+	const HOST_IO_TARGET_OPS* Ops;
+	PVOID Context;
+
+	//
+	// A stopped target fails requests sent without
+	// WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE
+	//
+	BOOLEAN Stopped;
+	HOST_REQUEST* FirstPending;
+} HOST_IO_TARGET;
+
+struct _HOST_REQUEST
+{
+	HOST_OBJECT Header;
+	WDF_REQUEST_TYPE Type;
+	ULONG IoctlCode;
+	WDFMEMORY Memory;
+	PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine;
+	WDFCONTEXT CompletionContext;
+	NTSTATUS Status;
+
+	//
+	// Target the request is pending on, linked in its pending list
+	//
+	HOST_IO_TARGET* Target;
+	HOST_REQUEST* NextPending;
+};
+
+//
+// Difference between the 1601 based system time of absolute due times
+// and the Unix epoch, in 100ns units
+//
+#define HOST_EPOCH_DELTA 116444736000000000LL
+
+NTSTATUS
+HostObjectAllocate(
+	IN HOST_OBJECT_TYPE Type,
+	IN SIZE_T Size,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN WDFOBJECT DefaultParent,
+	IN HOST_OBJECT_DESTROY* Destroy,
+	OUT HOST_OBJECT** Object
+)
+/*++
+
+  Routine Description:
+
+	Allocates an object of Size bytes with the typed context and
+	parent named by Attributes
+
+  Arguments:
+
+	Type          - The object type
+	Size          - Size of the type's structure, starting with HOST_OBJECT
+	Attributes    - Optional object attributes
+	DefaultParent - Parent used when Attributes does not name one
+	Destroy       - Optional routine releasing the type's resources
+	Object        - Receives the object
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	HOST_OBJECT* object;
+	HOST_OBJECT* parent;
+	SIZE_T contextSize;
+	NTSTATUS status;
+
+	object = (HOST_OBJECT*)calloc(1, Size);
+
+	if (object == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	object->Type = Type;
+	object->Destroy = Destroy;
+	parent = DefaultParent;
+
+	if (Attributes != NULL)
+	{
+		object->EvtCleanupCallback = Attributes->EvtCleanupCallback;
+		object->EvtDestroyCallback = Attributes->EvtDestroyCallback;
+
+		if (Attributes->ParentObject != NULL)
+		{
+			parent = Attributes->ParentObject;
+		}
+
+		if (Attributes->ContextTypeInfo != NULL)
+		{
+			contextSize = max(
+				Attributes->ContextSizeOverride,
+				Attributes->ContextTypeInfo->ContextSize);
+
+			object->Context = calloc(1, contextSize);
+
+			if (object->Context == NULL)
+			{
+				free(object);
+				object = NULL;
+				status = STATUS_INSUFFICIENT_RESOURCES;
+				goto exit;
+			}
+		}
+	}
+
+	if (parent != NULL)
+	{
+		object->Parent = parent;
+		object->NextSibling = parent->FirstChild;
+		parent->FirstChild = object;
+	}
+
+	status = STATUS_SUCCESS;
+
+exit:
+
+	*Object = object;
+
+	return status;
+}
+
+PVOID
+WdfObjectGetTypedContextWorker(
+	IN WDFOBJECT Handle,
+	IN const WDF_OBJECT_CONTEXT_TYPE_INFO* TypeInfo
+)
+{
+	UNREFERENCED_PARAMETER(TypeInfo);
+
+	return Handle->Context;
+}
+
+NTSTATUS
+WdfObjectCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFOBJECT* Object
+)
+{
+	return HostObjectAllocate(
+		HostObjectGeneric,
+		sizeof(HOST_OBJECT),
+		Attributes,
+		NULL,
+		NULL,
+		Object);
+}
+
+VOID
+WdfObjectDelete(
+	IN WDFOBJECT Object
+)
+/*++
+
+  Routine Description:
+
+	Deletes an object after its children, running the cleanup and
+	destroy callbacks and the type's own release routine
+
+--*/
+{
+	HOST_OBJECT** link;
+
+	if (Object == NULL)
+	{
+		return;
+	}
+
+	while (Object->FirstChild != NULL)
+	{
+		WdfObjectDelete(Object->FirstChild);
+	}
+
+	if (Object->EvtCleanupCallback != NULL)
+	{
+		Object->EvtCleanupCallback(Object);
+	}
+
+	if (Object->Destroy != NULL)
+	{
+		Object->Destroy(Object);
+	}
+
+	if (Object->EvtDestroyCallback != NULL)
+	{
+		Object->EvtDestroyCallback(Object);
+	}
+
+	if (Object->Parent != NULL)
+	{
+		for (link = &Object->Parent->FirstChild;
+			*link != NULL;
+			link = &(*link)->NextSibling)
+		{
+			if (*link == Object)
+			{
+				*link = Object->NextSibling;
+				break;
+			}
+		}
+	}
+
+	free(Object->Context);
+	free(Object);
+}
+
+WDFDRIVER
+WdfGetDriver(
+	VOID
+)
+{
+	return NULL;
+}
+
+PDRIVER_OBJECT
+WdfDriverWdmGetDriverObject(
+	IN WDFDRIVER Driver
+)
+{
+	UNREFERENCED_PARAMETER(Driver);
+
+	return NULL;
+}
+
+NTSTATUS
+HostDeviceCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFDEVICE* Device
+)
+{
+	return HostObjectAllocate(
+		HostObjectDevice,
+		sizeof(HOST_OBJECT),
+		Attributes,
+		NULL,
+		NULL,
+		Device);
+}
+
+PDEVICE_OBJECT
+WdfDeviceWdmGetDeviceObject(
+	IN WDFDEVICE Device
+)
+{
+	UNREFERENCED_PARAMETER(Device);
+
+	return NULL;
+}
+
+NTSTATUS
+HostQueueCreate(
+	IN WDFDEVICE Device,
+	IN HOST_SINK* Sink,
+	OUT WDFQUEUE* Queue
+)
+/*++
+
+  Routine Description:
+
+	Creates the queue HID reports are sent to. Instead of completing
+	HIDClass read requests the queue hands reports to a sink.
+
+--*/
+{
+	HOST_OBJECT* object;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectQueue,
+		sizeof(HOST_QUEUE),
+		WDF_NO_OBJECT_ATTRIBUTES,
+		Device,
+		NULL,
+		&object);
+
+	if (NT_SUCCESS(status))
+	{
+		((HOST_QUEUE*)object)->Sink = Sink;
+	}
+
+	*Queue = object;
+
+	return status;
+}
+
+HOST_SINK*
+HostQueueGetSink(
+	IN WDFQUEUE Queue
+)
+{
+	NT_ASSERT(Queue->Type == HostObjectQueue);
+
+	return ((HOST_QUEUE*)Queue)->Sink;
+}
+
+static VOID
+HostWaitLockDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	pthread_mutex_destroy(&((HOST_WAITLOCK*)Object)->Mutex);
+}
+
+NTSTATUS
+WdfWaitLockCreate(
+	IN PWDF_OBJECT_ATTRIBUTES LockAttributes,
+	OUT WDFWAITLOCK* Lock
+)
+{
+	HOST_OBJECT* object;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectWaitLock,
+		sizeof(HOST_WAITLOCK),
+		LockAttributes,
+		NULL,
+		NULL,
+		&object);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	//
+	// Wait locks are not recursive, error checking catches a thread
+	// acquiring one twice
+	//
+	{
+		pthread_mutexattr_t attributes;
+
+		pthread_mutexattr_init(&attributes);
+		pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_ERRORCHECK);
+		pthread_mutex_init(&((HOST_WAITLOCK*)object)->Mutex, &attributes);
+		pthread_mutexattr_destroy(&attributes);
+	}
+
+	object->Destroy = HostWaitLockDestroy;
+
+exit:
+
+	*Lock = object;
+
+	return status;
+}
+
+NTSTATUS
+WdfWaitLockAcquire(
+	IN WDFWAITLOCK Lock,
+	IN PLONGLONG Timeout
+)
+/*++
+
+  Routine Description:
+
+	Acquires a wait lock. A NULL timeout waits forever, a zero timeout
+	only tries, a negative one waits at most that many 100ns units.
+
+--*/
+{
+	pthread_mutex_t* mutex = &((HOST_WAITLOCK*)Lock)->Mutex;
+	struct timespec deadline;
+	LONGLONG ticks;
+	int error;
+
+	if (Timeout == NULL)
+	{
+		error = pthread_mutex_lock(mutex);
+	}
+	else if (*Timeout == 0)
+	{
+		error = pthread_mutex_trylock(mutex);
+	}
+	else
+	{
+		ticks = (*Timeout < 0) ? -*Timeout : 0;
+
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_sec += (time_t)(ticks / 10000000LL);
+		deadline.tv_nsec += (long)((ticks % 10000000LL) * 100);
+
+		if (deadline.tv_nsec >= 1000000000L)
+		{
+			deadline.tv_sec++;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		error = pthread_mutex_timedlock(mutex, &deadline);
+	}
+
+	if (error == EBUSY || error == ETIMEDOUT)
+	{
+		return STATUS_TIMEOUT;
+	}
+
+	NT_ASSERT(error == 0);
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfWaitLockRelease(
+	IN WDFWAITLOCK Lock
+)
+{
+	int error;
+
+	error = pthread_mutex_unlock(&((HOST_WAITLOCK*)Lock)->Mutex);
+
+	NT_ASSERT(error == 0);
+	UNREFERENCED_PARAMETER(error);
+}
+
+static VOID
+HostTimerFired(
+	IN PVOID Context,
+	IN ULONG Events
+)
+{
+	HOST_TIMER* timer = (HOST_TIMER*)Context;
+	uint64_t expirations;
+
+	UNREFERENCED_PARAMETER(Events);
+
+	if (read(timer->Fd, &expirations, sizeof(expirations)) != sizeof(expirations))
+	{
+		return;
+	}
+
+	if (timer->Period == 0)
+	{
+		timer->Armed = FALSE;
+	}
+
+	timer->EvtTimerFunc(&timer->Header);
+}
+
+static VOID
+HostTimerDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	HOST_TIMER* timer = (HOST_TIMER*)Object;
+
+	if (timer->Fd >= 0)
+	{
+		HostLoopRemove(timer->Fd);
+		close(timer->Fd);
+	}
+}
+
+NTSTATUS
+WdfTimerCreate(
+	IN PWDF_TIMER_CONFIG Config,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFTIMER* Timer
+)
+/*++
+
+  Routine Description:
+
+	Creates a timer backed by a timerfd. The callback runs on the
+	event loop, which is also where the core's other callbacks run,
+	so timers are always serialized with interrupt servicing.
+
+--*/
+{
+	HOST_OBJECT* object;
+	HOST_TIMER* timer;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectTimer,
+		sizeof(HOST_TIMER),
+		Attributes,
+		NULL,
+		NULL,
+		&object);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	timer = (HOST_TIMER*)object;
+	timer->EvtTimerFunc = Config->EvtTimerFunc;
+	timer->Period = Config->Period;
+	timer->Fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+	if (timer->Fd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	object->Destroy = HostTimerDestroy;
+
+	status = HostLoopAdd(timer->Fd, EPOLLIN, HostTimerFired, timer);
+
+exit:
+
+	if (!NT_SUCCESS(status) && object != NULL)
+	{
+		WdfObjectDelete(object);
+		object = NULL;
+	}
+
+	*Timer = object;
+
+	return status;
+}
+
+BOOLEAN
+WdfTimerStart(
+	IN WDFTIMER Timer,
+	IN LONGLONG DueTime
+)
+/*++
+
+  Routine Description:
+
+	Arms the timer. DueTime is relative when negative and an absolute
+	system time otherwise, both in 100ns units.
+
+  Return Value:
+
+	TRUE if the timer was already armed
+
+--*/
+{
+	HOST_TIMER* timer = (HOST_TIMER*)Timer;
+	struct itimerspec spec;
+	struct timespec now;
+	BOOLEAN wasArmed;
+	LONGLONG ticks;
+
+	if (DueTime < 0)
+	{
+		ticks = -DueTime;
+	}
+	else
+	{
+		clock_gettime(CLOCK_REALTIME, &now);
+		ticks = DueTime - HOST_EPOCH_DELTA -
+			(((LONGLONG)now.tv_sec * 10000000LL) + (now.tv_nsec / 100));
+	}
+
+	//
+	// A zero it_value disarms a timerfd, expire as soon as possible instead
+	//
+	RtlZeroMemory(&spec, sizeof(spec));
+	spec.it_value.tv_sec = (time_t)(max(ticks, 0) / 10000000LL);
+	spec.it_value.tv_nsec = (long)((max(ticks, 0) % 10000000LL) * 100);
+
+	if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+	{
+		spec.it_value.tv_nsec = 1;
+	}
+
+	spec.it_interval.tv_sec = timer->Period / 1000;
+	spec.it_interval.tv_nsec = (long)(timer->Period % 1000) * 1000000L;
+
+	wasArmed = timer->Armed;
+	timer->Armed = TRUE;
+
+	timerfd_settime(timer->Fd, 0, &spec, NULL);
+
+	return wasArmed;
+}
+
+BOOLEAN
+WdfTimerStop(
+	IN WDFTIMER Timer,
+	IN BOOLEAN Wait
+)
+/*++
+
+  Routine Description:
+
+	Disarms the timer. The callback only runs on the event loop, so
+	there is never one in flight to wait for.
+
+  Return Value:
+
+	TRUE if the timer was armed
+
+--*/
+{
+	HOST_TIMER* timer = (HOST_TIMER*)Timer;
+	struct itimerspec spec;
+	BOOLEAN wasArmed;
+
+	UNREFERENCED_PARAMETER(Wait);
+
+	RtlZeroMemory(&spec, sizeof(spec));
+	timerfd_settime(timer->Fd, 0, &spec, NULL);
+
+	wasArmed = timer->Armed;
+	timer->Armed = FALSE;
+
+	return wasArmed;
+}
+
+BOOLEAN
+HostTimerFire(
+	IN WDFTIMER Timer
+)
+/*++
+
+  Routine Description:
+
+	Expires an armed timer right away, running its callback on the
+	calling thread
+
+  Return Value:
+
+	TRUE if the timer was armed
+
+--*/
+{
+	HOST_TIMER* timer = (HOST_TIMER*)Timer;
+	struct itimerspec spec;
+
+	if (!timer->Armed)
+	{
+		return FALSE;
+	}
+
+	if (timer->Period == 0)
+	{
+		RtlZeroMemory(&spec, sizeof(spec));
+		timerfd_settime(timer->Fd, 0, &spec, NULL);
+		timer->Armed = FALSE;
+	}
+
+	timer->EvtTimerFunc(&timer->Header);
+
+	return TRUE;
+}
+
+WDFOBJECT
+WdfTimerGetParentObject(
+	IN WDFTIMER Timer
+)
+{
+	return Timer->Parent;
+}
+
+static VOID
+HostWorkItemRun(
+	IN HOST_WORKITEM* WorkItem
+)
+{
+	uint64_t count;
+
+	if (!WorkItem->Queued)
+	{
+		return;
+	}
+
+	if (read(WorkItem->Fd, &count, sizeof(count)) != sizeof(count))
+	{
+		return;
+	}
+
+	WorkItem->Queued = FALSE;
+	WorkItem->EvtWorkItemFunc(&WorkItem->Header);
+}
+
+static VOID
+HostWorkItemFired(
+	IN PVOID Context,
+	IN ULONG Events
+)
+{
+	UNREFERENCED_PARAMETER(Events);
+
+	HostWorkItemRun((HOST_WORKITEM*)Context);
+}
+
+static VOID
+HostWorkItemDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	HOST_WORKITEM* workItem = (HOST_WORKITEM*)Object;
+
+	if (workItem->Fd >= 0)
+	{
+		HostLoopRemove(workItem->Fd);
+		close(workItem->Fd);
+	}
+}
+
+NTSTATUS
+WdfWorkItemCreate(
+	IN PWDF_WORKITEM_CONFIG Config,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	OUT WDFWORKITEM* WorkItem
+)
+/*++
+
+  Routine Description:
+
+	Creates a work item backed by an eventfd. Like timers, the callback
+	runs on the event loop once control returns to it, so it is
+	serialized with interrupt servicing rather than concurrent with it.
+
+--*/
+{
+	HOST_OBJECT* object;
+	HOST_WORKITEM* workItem;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectWorkItem,
+		sizeof(HOST_WORKITEM),
+		Attributes,
+		NULL,
+		NULL,
+		&object);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	workItem = (HOST_WORKITEM*)object;
+	workItem->EvtWorkItemFunc = Config->EvtWorkItemFunc;
+	workItem->Fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+	if (workItem->Fd < 0)
+	{
+		status = HostStatusFromErrno(errno);
+		goto exit;
+	}
+
+	object->Destroy = HostWorkItemDestroy;
+
+	status = HostLoopAdd(workItem->Fd, EPOLLIN, HostWorkItemFired, workItem);
+
+exit:
+
+	if (!NT_SUCCESS(status) && object != NULL)
+	{
+		WdfObjectDelete(object);
+		object = NULL;
+	}
+
+	*WorkItem = object;
+
+	return status;
+}
+
+VOID
+WdfWorkItemEnqueue(
+	IN WDFWORKITEM WorkItem
+)
+/*++
+
+  Routine Description:
+
+	Queues the work item. Queuing an item that has not run yet has no
+	effect, as with the framework.
+
+--*/
+{
+	HOST_WORKITEM* workItem = (HOST_WORKITEM*)WorkItem;
+	uint64_t count = 1;
+
+	if (workItem->Queued)
+	{
+		return;
+	}
+
+	if (write(workItem->Fd, &count, sizeof(count)) == sizeof(count))
+	{
+		workItem->Queued = TRUE;
+	}
+}
+
+VOID
+WdfWorkItemFlush(
+	IN WDFWORKITEM WorkItem
+)
+/*++
+
+  Routine Description:
+
+	Runs a queued work item to completion on the calling thread. The
+	callback only runs on the event loop, so one is never in flight.
+
+--*/
+{
+	HostWorkItemRun((HOST_WORKITEM*)WorkItem);
+}
+
+WDFOBJECT
+WdfWorkItemGetParentObject(
+	IN WDFWORKITEM WorkItem
+)
+{
+	return WorkItem->Parent;
+}
+
+static VOID
+HostMemoryDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	free(((HOST_MEMORY*)Object)->Buffer);
+}
+
+NTSTATUS
+WdfMemoryCreate(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN POOL_TYPE PoolType,
+	IN ULONG PoolTag,
+	IN SIZE_T BufferSize,
+	OUT WDFMEMORY* Memory,
+	OUT PVOID* Buffer
+)
+{
+	HOST_OBJECT* object;
+	HOST_MEMORY* memory;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(PoolType);
+	UNREFERENCED_PARAMETER(PoolTag);
+
+	status = HostObjectAllocate(
+		HostObjectMemory,
+		sizeof(HOST_MEMORY),
+		Attributes,
+		NULL,
+		HostMemoryDestroy,
+		&object);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	memory = (HOST_MEMORY*)object;
+	memory->Buffer = calloc(1, max(BufferSize, 1));
+	memory->Size = BufferSize;
+
+	if (memory->Buffer == NULL)
+	{
+		WdfObjectDelete(object);
+		object = NULL;
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	if (Buffer != NULL)
+	{
+		*Buffer = memory->Buffer;
+	}
+
+exit:
+
+	*Memory = object;
+
+	return status;
+}
+
+NTSTATUS
+WdfMemoryCreatePreallocated(
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN PVOID Buffer,
+	IN SIZE_T BufferSize,
+	OUT WDFMEMORY* Memory
+)
+/*++
+
+  Routine Description:
+
+	Wraps a buffer owned by the caller, which outlives the object
+
+--*/
+{
+	HOST_OBJECT* object;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectMemory,
+		sizeof(HOST_MEMORY),
+		Attributes,
+		NULL,
+		NULL,
+		&object);
+
+	if (NT_SUCCESS(status))
+	{
+		((HOST_MEMORY*)object)->Buffer = Buffer;
+		((HOST_MEMORY*)object)->Size = BufferSize;
+	}
+
+	*Memory = object;
+
+	return status;
+}
+
+PVOID
+WdfMemoryGetBuffer(
+	IN WDFMEMORY Memory,
+	OUT SIZE_T* BufferSize
+)
+{
+	HOST_MEMORY* memory = (HOST_MEMORY*)Memory;
+
+	if (BufferSize != NULL)
+	{
+		*BufferSize = memory->Size;
+	}
+
+	return memory->Buffer;
+}
+
+static VOID
+HostCollectionDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	free(((HOST_COLLECTION*)Object)->Items);
+}
+
+NTSTATUS
+WdfCollectionCreate(
+	IN PWDF_OBJECT_ATTRIBUTES CollectionAttributes,
+	OUT WDFCOLLECTION* Collection
+)
+{
+	return HostObjectAllocate(
+		HostObjectCollection,
+		sizeof(HOST_COLLECTION),
+		CollectionAttributes,
+		NULL,
+		HostCollectionDestroy,
+		Collection);
+}
+
+NTSTATUS
+HostCollectionAdd(
+	IN WDFCOLLECTION Collection,
+	IN WDFOBJECT Item
+)
+{
+	HOST_COLLECTION* collection = (HOST_COLLECTION*)Collection;
+	WDFOBJECT* items;
+	ULONG capacity;
+
+	if (collection->Count == collection->Capacity)
+	{
+		capacity = max(collection->Capacity * 2, 4);
+		items = (WDFOBJECT*)realloc(collection->Items, capacity * sizeof(WDFOBJECT));
+
+		if (items == NULL)
+		{
+			return STATUS_INSUFFICIENT_RESOURCES;
+		}
+
+		collection->Items = items;
+		collection->Capacity = capacity;
+	}
+
+	collection->Items[collection->Count++] = Item;
+
+	return STATUS_SUCCESS;
+}
+
+ULONG
+WdfCollectionGetCount(
+	IN WDFCOLLECTION Collection
+)
+{
+	return ((HOST_COLLECTION*)Collection)->Count;
+}
+
+WDFOBJECT
+WdfCollectionGetItem(
+	IN WDFCOLLECTION Collection,
+	IN ULONG Index
+)
+{
+	HOST_COLLECTION* collection = (HOST_COLLECTION*)Collection;
+
+	return (Index < collection->Count) ? collection->Items[Index] : NULL;
+}
+
+static VOID
+HostStringDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	free(((HOST_STRING*)Object)->String.Buffer);
+}
+
+NTSTATUS
+HostStringCreate(
+	IN PCSTR Value,
+	IN SIZE_T Length,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN WDFOBJECT DefaultParent,
+	OUT WDFSTRING* String
+)
+/*++
+
+  Routine Description:
+
+	Creates a string object from Length ASCII characters of Value
+
+--*/
+{
+	HOST_OBJECT* object;
+	HOST_STRING* string;
+	NTSTATUS status;
+	SIZE_T i;
+
+	if (Length >= MAXUSHORT / sizeof(WCHAR))
+	{
+		status = STATUS_INVALID_PARAMETER;
+		object = NULL;
+		goto exit;
+	}
+
+	status = HostObjectAllocate(
+		HostObjectString,
+		sizeof(HOST_STRING),
+		Attributes,
+		DefaultParent,
+		HostStringDestroy,
+		&object);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	string = (HOST_STRING*)object;
+	string->String.Buffer = (PWSTR)calloc(Length + 1, sizeof(WCHAR));
+
+	if (string->String.Buffer == NULL)
+	{
+		WdfObjectDelete(object);
+		object = NULL;
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	for (i = 0; i < Length; i++)
+	{
+		string->String.Buffer[i] = (WCHAR)(UCHAR)Value[i];
+	}
+
+	string->String.Length = (USHORT)(Length * sizeof(WCHAR));
+	string->String.MaximumLength = (USHORT)((Length + 1) * sizeof(WCHAR));
+
+exit:
+
+	*String = object;
+
+	return status;
+}
+
+VOID
+WdfStringGetUnicodeString(
+	IN WDFSTRING String,
+	OUT PUNICODE_STRING UnicodeString
+)
+{
+	*UnicodeString = ((HOST_STRING*)String)->String;
+}
+
+NTSTATUS
+WdfIoTargetCreate(
+	IN WDFDEVICE Device,
+	IN PWDF_OBJECT_ATTRIBUTES IoTargetAttributes,
+	OUT WDFIOTARGET* IoTarget
+)
+/*++
+
+  Routine Description:
+
+	Creates a target that is not open yet, requests sent to it fail
+	until WdfIoTargetOpen binds it to a device interface
+
+--*/
+{
+	return HostObjectAllocate(
+		HostObjectIoTarget,
+		sizeof(HOST_IO_TARGET),
+		IoTargetAttributes,
+		Device,
+		NULL,
+		IoTarget);
+}
+
+NTSTATUS
+WdfIoTargetOpen(
+	IN WDFIOTARGET IoTarget,
+	IN PWDF_IO_TARGET_OPEN_PARAMS OpenParams
+)
+/*++
+
+  Routine Description:
+
+	Opens the device interface registered under the name the target is
+	opened by, see HostRegisterDeviceInterface
+
+--*/
+{
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)IoTarget;
+
+	if (OpenParams->Type != WdfIoTargetOpenByName)
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	if (!HostFindDeviceInterface(
+		OpenParams->TargetDeviceName,
+		&target->Ops,
+		&target->Context))
+	{
+		return STATUS_OBJECT_NAME_NOT_FOUND;
+	}
+
+	target->Stopped = FALSE;
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoTargetStart(
+	IN WDFIOTARGET IoTarget
+)
+{
+	((HOST_IO_TARGET*)IoTarget)->Stopped = FALSE;
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfIoTargetStop(
+	IN WDFIOTARGET IoTarget,
+	IN WDF_IO_TARGET_SENT_IO_ACTION Action
+)
+/*++
+
+  Routine Description:
+
+	Stops the target. Requests are only completed on the loop thread,
+	which is the one waiting here, so those still pending are cancelled
+	whatever the action asks for.
+
+--*/
+{
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)IoTarget;
+
+	UNREFERENCED_PARAMETER(Action);
+
+	target->Stopped = TRUE;
+
+	while (target->FirstPending != NULL)
+	{
+		WdfRequestCancelSentRequest(&target->FirstPending->Header);
+	}
+}
+
+static NTSTATUS
+HostMemoryDescriptorGetBuffer(
+	IN PWDF_MEMORY_DESCRIPTOR Descriptor,
+	OUT PVOID* Buffer,
+	OUT PULONG Length
+)
+/*++
+
+  Routine Description:
+
+	Resolves the buffer a request moves data from or into
+
+--*/
+{
+	SIZE_T size;
+	PUCHAR buffer;
+
+	*Buffer = NULL;
+	*Length = 0;
+
+	if (Descriptor == NULL)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	switch (Descriptor->Type)
+	{
+	case WdfMemoryDescriptorTypeBuffer:
+		*Buffer = Descriptor->u.BufferType.Buffer;
+		*Length = Descriptor->u.BufferType.Length;
+		return STATUS_SUCCESS;
+
+	case WdfMemoryDescriptorTypeHandle:
+		buffer = (PUCHAR)WdfMemoryGetBuffer(Descriptor->u.HandleType.Memory, &size);
+
+		if (Descriptor->u.HandleType.Offsets != NULL)
+		{
+			if (Descriptor->u.HandleType.Offsets->BufferOffset +
+				Descriptor->u.HandleType.Offsets->BufferLength > size)
+			{
+				return STATUS_INVALID_PARAMETER;
+			}
+
+			buffer += Descriptor->u.HandleType.Offsets->BufferOffset;
+			size = Descriptor->u.HandleType.Offsets->BufferLength;
+		}
+
+		*Buffer = buffer;
+		*Length = (ULONG)size;
+		return STATUS_SUCCESS;
+
+	default:
+		return STATUS_NOT_SUPPORTED;
+	}
+}
+
+NTSTATUS
+HostIoTargetCreate(
+	IN const HOST_IO_TARGET_OPS* Ops,
+	IN PVOID Context,
+	OUT WDFIOTARGET* IoTarget
+)
+/*++
+
+  Routine Description:
+
+	Creates an I/O target whose requests are served by Ops. The target
+	has no parent and is deleted with WdfObjectDelete.
+
+--*/
+{
+	HOST_OBJECT* object;
+	NTSTATUS status;
+
+	status = HostObjectAllocate(
+		HostObjectIoTarget,
+		sizeof(HOST_IO_TARGET),
+		WDF_NO_OBJECT_ATTRIBUTES,
+		NULL,
+		NULL,
+		&object);
+
+	if (NT_SUCCESS(status))
+	{
+		((HOST_IO_TARGET*)object)->Ops = Ops;
+		((HOST_IO_TARGET*)object)->Context = Context;
+	}
+
+	*IoTarget = object;
+
+	return status;
+}
+
+PVOID
+HostIoTargetGetContext(
+	IN WDFIOTARGET IoTarget
+)
+{
+	return ((HOST_IO_TARGET*)IoTarget)->Context;
+}
+
+NTSTATUS
+WdfIoTargetSendWriteSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	IN PLONGLONG DeviceOffset,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesWritten
+)
+{
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)IoTarget;
+	ULONG_PTR bytesWritten = 0;
+	PVOID buffer;
+	ULONG length;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(DeviceOffset);
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (target == NULL || target->Ops == NULL || target->Ops->Write == NULL)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	status = HostMemoryDescriptorGetBuffer(InputBuffer, &buffer, &length);
+
+	if (NT_SUCCESS(status))
+	{
+		status = target->Ops->Write(target->Context, buffer, length, &bytesWritten);
+	}
+
+exit:
+
+	if (BytesWritten != NULL)
+	{
+		*BytesWritten = bytesWritten;
+	}
+
+	return status;
+}
+
+NTSTATUS
+WdfIoTargetSendReadSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	IN PLONGLONG DeviceOffset,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesRead
+)
+{
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)IoTarget;
+	ULONG_PTR bytesRead = 0;
+	PVOID buffer;
+	ULONG length;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(DeviceOffset);
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (target == NULL || target->Ops == NULL || target->Ops->Read == NULL)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	status = HostMemoryDescriptorGetBuffer(OutputBuffer, &buffer, &length);
+
+	if (NT_SUCCESS(status))
+	{
+		status = target->Ops->Read(target->Context, buffer, length, &bytesRead);
+	}
+
+exit:
+
+	if (BytesRead != NULL)
+	{
+		*BytesRead = bytesRead;
+	}
+
+	return status;
+}
+
+NTSTATUS
+WdfIoTargetSendIoctlSynchronously(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN ULONG IoctlCode,
+	IN PWDF_MEMORY_DESCRIPTOR InputBuffer,
+	IN PWDF_MEMORY_DESCRIPTOR OutputBuffer,
+	IN PWDF_REQUEST_SEND_OPTIONS RequestOptions,
+	OUT PULONG_PTR BytesReturned
+)
+/*++
+
+  Routine Description:
+
+	Sends an IOCTL with an input buffer only, the sequences of
+	IOCTL_SPB_EXECUTE_SEQUENCE carry their own data buffers
+
+--*/
+{
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)IoTarget;
+	ULONG_PTR bytesReturned = 0;
+	PVOID buffer;
+	ULONG length;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(RequestOptions);
+
+	if (target == NULL || target->Ops == NULL || target->Ops->Ioctl == NULL ||
+		OutputBuffer != NULL)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	status = HostMemoryDescriptorGetBuffer(InputBuffer, &buffer, &length);
+
+	if (NT_SUCCESS(status))
+	{
+		status = target->Ops->Ioctl(
+			target->Context,
+			IoctlCode,
+			buffer,
+			length,
+			&bytesReturned);
+	}
+
+exit:
+
+	if (BytesReturned != NULL)
+	{
+		*BytesReturned = bytesReturned;
+	}
+
+	return status;
+}
+
+static VOID
+HostRequestUnlink(
+	IN HOST_REQUEST* Request
+)
+{
+	HOST_REQUEST** link;
+
+	if (Request->Target == NULL)
+	{
+		return;
+	}
+
+	for (link = &Request->Target->FirstPending;
+		*link != NULL;
+		link = &(*link)->NextPending)
+	{
+		if (*link == Request)
+		{
+			*link = Request->NextPending;
+			break;
+		}
+	}
+
+	Request->Target = NULL;
+	Request->NextPending = NULL;
+}
+
+static VOID
+HostRequestDestroy(
+	IN HOST_OBJECT* Object
+)
+{
+	HostRequestUnlink((HOST_REQUEST*)Object);
+}
+
+NTSTATUS
+WdfRequestCreate(
+	IN PWDF_OBJECT_ATTRIBUTES RequestAttributes,
+	IN WDFIOTARGET IoTarget,
+	OUT WDFREQUEST* Request
+)
+{
+	UNREFERENCED_PARAMETER(IoTarget);
+
+	return HostObjectAllocate(
+		HostObjectRequest,
+		sizeof(HOST_REQUEST),
+		RequestAttributes,
+		NULL,
+		HostRequestDestroy,
+		Request);
+}
+
+NTSTATUS
+WdfRequestReuse(
+	IN WDFREQUEST Request,
+	IN PWDF_REQUEST_REUSE_PARAMS ReuseParams
+)
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+
+	if (request->Target != NULL)
+	{
+		return STATUS_INVALID_DEVICE_REQUEST;
+	}
+
+	request->Type = WdfRequestTypeCreate;
+	request->IoctlCode = 0;
+	request->Memory = NULL;
+	request->CompletionRoutine = NULL;
+	request->CompletionContext = NULL;
+	request->Status = ReuseParams->Status;
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoTargetFormatRequestForRead(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN WDFMEMORY OutputBuffer,
+	IN PWDFMEMORY_OFFSET OutputBufferOffset,
+	IN PLONGLONG DeviceOffset
+)
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+
+	UNREFERENCED_PARAMETER(IoTarget);
+	UNREFERENCED_PARAMETER(DeviceOffset);
+
+	if (OutputBufferOffset != NULL)
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	request->Type = WdfRequestTypeRead;
+	request->Memory = OutputBuffer;
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+WdfIoTargetFormatRequestForIoctl(
+	IN WDFIOTARGET IoTarget,
+	IN WDFREQUEST Request,
+	IN ULONG IoctlCode,
+	IN WDFMEMORY InputBuffer,
+	IN PWDFMEMORY_OFFSET InputBufferOffset,
+	IN WDFMEMORY OutputBuffer,
+	IN PWDFMEMORY_OFFSET OutputBufferOffset
+)
+/*++
+
+  Routine Description:
+
+	Formats an IOCTL with an input buffer only, like the synchronous
+	IOCTLs of the host
+
+--*/
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+
+	UNREFERENCED_PARAMETER(IoTarget);
+
+	if (InputBufferOffset != NULL ||
+		OutputBuffer != NULL ||
+		OutputBufferOffset != NULL)
+	{
+		return STATUS_NOT_SUPPORTED;
+	}
+
+	request->Type = WdfRequestTypeDeviceControl;
+	request->IoctlCode = IoctlCode;
+	request->Memory = InputBuffer;
+
+	return STATUS_SUCCESS;
+}
+
+VOID
+WdfRequestSetCompletionRoutine(
+	IN WDFREQUEST Request,
+	IN PFN_WDF_REQUEST_COMPLETION_ROUTINE CompletionRoutine,
+	IN WDFCONTEXT CompletionContext
+)
+{
+	((HOST_REQUEST*)Request)->CompletionRoutine = CompletionRoutine;
+	((HOST_REQUEST*)Request)->CompletionContext = CompletionContext;
+}
+
+VOID
+HostRequestGetParameters(
+	IN WDFREQUEST Request,
+	OUT WDF_REQUEST_TYPE* Type,
+	OUT PULONG IoctlCode,
+	OUT PVOID* Buffer,
+	OUT PULONG Length
+)
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+	SIZE_T size = 0;
+
+	*Type = request->Type;
+	*IoctlCode = request->IoctlCode;
+	*Buffer = (request->Memory != NULL) ?
+		WdfMemoryGetBuffer(request->Memory, &size) :
+		NULL;
+	*Length = (ULONG)size;
+}
+
+VOID
+HostRequestComplete(
+	IN WDFREQUEST Request,
+	IN NTSTATUS Status,
+	IN ULONG_PTR Information
+)
+/*++
+
+  Routine Description:
+
+	Completes a pending request, running its completion routine on the
+	calling thread
+
+--*/
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+	WDF_REQUEST_COMPLETION_PARAMS params;
+	HOST_IO_TARGET* target = request->Target;
+
+	NT_ASSERT(target != NULL);
+
+	HostRequestUnlink(request);
+	request->Status = Status;
+
+	if (request->CompletionRoutine != NULL)
+	{
+		RtlZeroMemory(&params, sizeof(params));
+		params.Size = sizeof(params);
+		params.Type = request->Type;
+		params.IoStatus.Status = Status;
+		params.IoStatus.Information = Information;
+
+		request->CompletionRoutine(
+			Request,
+			&target->Header,
+			&params,
+			request->CompletionContext);
+	}
+}
+
+static NTSTATUS
+HostRequestServe(
+	IN HOST_REQUEST* Request,
+	OUT PULONG_PTR Information
+)
+/*++
+
+  Routine Description:
+
+	Serves a request through the target's synchronous ops, for targets
+	that do not take requests themselves
+
+--*/
+{
+	HOST_IO_TARGET* target = Request->Target;
+	WDF_MEMORY_DESCRIPTOR memory;
+	PVOID buffer;
+	ULONG length;
+
+	*Information = 0;
+
+	if (Request->Memory != NULL)
+	{
+		WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(&memory, Request->Memory, NULL);
+		HostMemoryDescriptorGetBuffer(&memory, &buffer, &length);
+	}
+	else
+	{
+		buffer = NULL;
+		length = 0;
+	}
+
+	switch (Request->Type)
+	{
+	case WdfRequestTypeRead:
+		if (target->Ops->Read != NULL)
+		{
+			return target->Ops->Read(target->Context, buffer, length, Information);
+		}
+		break;
+
+	case WdfRequestTypeDeviceControl:
+		if (target->Ops->Ioctl != NULL)
+		{
+			return target->Ops->Ioctl(
+				target->Context,
+				Request->IoctlCode,
+				buffer,
+				length,
+				Information);
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	return STATUS_NOT_SUPPORTED;
+}
+
+BOOLEAN
+WdfRequestSend(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_SEND_OPTIONS Options
+)
+/*++
+
+  Routine Description:
+
+	Sends a formatted request. A request the target does not keep
+	pending is completed before this returns, as when a lower driver
+	completes an IRP in its dispatch routine.
+
+  Return Value:
+
+	FALSE if the request could not be sent, its status tells why
+
+--*/
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+	HOST_IO_TARGET* target = (HOST_IO_TARGET*)Target;
+	ULONG_PTR information = 0;
+	NTSTATUS status;
+
+	if (target->Ops == NULL ||
+		(target->Stopped &&
+			(Options == NULL ||
+				(Options->Flags & WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE) == 0)))
+	{
+		request->Status = STATUS_INVALID_DEVICE_STATE;
+		return FALSE;
+	}
+
+	NT_ASSERT(request->Target == NULL);
+
+	request->Target = target;
+	request->NextPending = target->FirstPending;
+	target->FirstPending = request;
+	request->Status = STATUS_PENDING;
+
+	if (target->Ops->Send != NULL)
+	{
+		status = target->Ops->Send(target->Context, Request);
+	}
+	else
+	{
+		status = HostRequestServe(request, &information);
+	}
+
+	if (status != STATUS_PENDING)
+	{
+		HostRequestComplete(Request, status, information);
+	}
+
+	return TRUE;
+}
+
+NTSTATUS
+WdfRequestGetStatus(
+	IN WDFREQUEST Request
+)
+{
+	return ((HOST_REQUEST*)Request)->Status;
+}
+
+BOOLEAN
+WdfRequestCancelSentRequest(
+	IN WDFREQUEST Request
+)
+/*++
+
+  Routine Description:
+
+	Cancels a pending request. Targets without a Cancel op complete it
+	with STATUS_CANCELLED right away.
+
+  Return Value:
+
+	TRUE if the request was pending
+
+--*/
+{
+	HOST_REQUEST* request = (HOST_REQUEST*)Request;
+	HOST_IO_TARGET* target = request->Target;
+
+	if (target == NULL)
+	{
+		return FALSE;
+	}
+
+	if (target->Ops->Cancel != NULL)
+	{
+		target->Ops->Cancel(target->Context, Request);
+	}
+
+	//
+	// A target may leave a cancelled request pending, it is no longer
+	// its to complete
+	//
+	if (request->Target != NULL)
+	{
+		HostRequestComplete(Request, STATUS_CANCELLED, 0);
+	}
+
+	return TRUE;
+}
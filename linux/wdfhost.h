@@ -0,0 +1,89 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		wdfhost.h
+
+	Abstract:
+
+		Object model behind the framework handles of compat/wdf.h. Each
+		object type embeds HOST_OBJECT as its first member.
+
+	Environment:
+
+		Linux user mode
+
+	Revision History:
+
+--*/
+
+#pragma once
+
+#include "host.h"
+
+typedef enum _HOST_OBJECT_TYPE
+{
+	HostObjectGeneric = 0,
+	HostObjectDevice,
+	HostObjectQueue,
+	HostObjectWaitLock,
+	HostObjectTimer,
+	HostObjectWorkItem,
+	HostObjectMemory,
+	HostObjectCollection,
+	HostObjectString,
+	HostObjectKey,
+	HostObjectIoTarget,
+	HostObjectRequest
+} HOST_OBJECT_TYPE;
+
+typedef struct _HOST_OBJECT HOST_OBJECT;
+
+typedef VOID
+HOST_OBJECT_DESTROY(
+	IN HOST_OBJECT* Object
+);
+
+struct _HOST_OBJECT
+{
+	HOST_OBJECT_TYPE Type;
+
+	//
+	// Children are deleted before their parent
+	//
+	HOST_OBJECT* Parent;
+	HOST_OBJECT* FirstChild;
+	HOST_OBJECT* NextSibling;
+
+	PVOID Context;
+	EVT_WDF_OBJECT_CONTEXT_CLEANUP* EvtCleanupCallback;
+	EVT_WDF_OBJECT_CONTEXT_DESTROY* EvtDestroyCallback;
+	HOST_OBJECT_DESTROY* Destroy;
+};
+
+NTSTATUS
+HostObjectAllocate(
+	IN HOST_OBJECT_TYPE Type,
+	IN SIZE_T Size,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN WDFOBJECT DefaultParent,
+	IN HOST_OBJECT_DESTROY* Destroy,
+	OUT HOST_OBJECT** Object
+);
+
+NTSTATUS
+HostCollectionAdd(
+	IN WDFCOLLECTION Collection,
+	IN WDFOBJECT Item
+);
+
+NTSTATUS
+HostStringCreate(
+	IN PCSTR Value,
+	IN SIZE_T Length,
+	IN PWDF_OBJECT_ATTRIBUTES Attributes,
+	IN WDFOBJECT DefaultParent,
+	OUT WDFSTRING* String
+);
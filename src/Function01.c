@@ -48,9 +48,13 @@ RmiConfigureFunction01(
 		goto exit;
 	}
 
-	RmiConvertF01ToPhysical(
-		&ControllerContext->Config.DeviceSettings,
-		&controlF01);
+	controlF01 = ControllerContext->Config->F01Ctrl;
+
+	//
+	// F01 device status changes are handled on every interrupt
+	//
+	ControllerContext->DeviceIrqMask = ControllerContext->FunctionIrqMask[index];
+	controlF01.InterruptEnable = (BYTE)RmiGetInterruptEnableMask(ControllerContext);
 
 	//
 	// Write settings to controller
@@ -72,6 +76,8 @@ RmiConfigureFunction01(
 		goto exit;
 	}
 
+	ControllerContext->InterruptEnableMask = controlF01.InterruptEnable;
+
 	//
 	// Note whether the device configuration settings initialized the
 	// controller in an operating state, to prevent a double-start from 
@@ -91,6 +97,148 @@ exit:
 	return status;
 }
 
+ULONG
+RmiGetInterruptEnableMask(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+  Routine Description:
+
+	Computes the F01 interrupt enable mask from the interrupt sources
+	of the functions the driver services. The configured InterruptEnable
+	value may add sources on top of these.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+  Return Value:
+
+	The interrupt enable mask
+
+--*/
+{
+	ULONG mask;
+
+	mask = ControllerContext->DeviceIrqMask |
+		ControllerContext->TouchIrqMask |
+		ControllerContext->ButtonIrqMask |
+		ControllerContext->TestIrqMask |
+		ControllerContext->Config->F01Ctrl.InterruptEnable;
+
+	if (ControllerContext->DisplayOff)
+	{
+		mask &= ~(ControllerContext->ButtonIrqMask |
+			ControllerContext->TouchIrqMask |
+			ControllerContext->TestIrqMask);
+	}
+
+	//
+	// Function sources were bounded to the register when the functions
+	// were discovered, and the configured value is a register image
+	//
+	NT_ASSERT(mask < (1UL << RMI4_MAX_INTERRUPT_SOURCES));
+
+	return mask;
+}
+
+NTSTATUS
+RmiSetInterruptEnable(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Programs the F01 interrupt enable register when the computed mask
+	differs from the one last written. Called with the controller lock
+	held whenever the set of serviced sources changes at runtime.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+	SpbContext - A pointer to the current i2c context
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	int index;
+	NTSTATUS status = STATUS_SUCCESS;
+	BYTE interruptEnable;
+
+	interruptEnable = (BYTE)RmiGetInterruptEnableMask(ControllerContext);
+
+	if (interruptEnable == ControllerContext->InterruptEnableMask)
+	{
+		goto exit;
+	}
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F01_RMI_DEVICE_CONTROL);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unexpected - RMI Function 01 missing");
+
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not change register page");
+
+		goto exit;
+	}
+
+	status = SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].ControlBase +
+		FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS, InterruptEnable),
+		&interruptEnable,
+		sizeof(interruptEnable)
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error writing RMI F01 interrupt enable - STATUS:%X",
+			status);
+		goto exit;
+	}
+
+	ControllerContext->InterruptEnableMask = interruptEnable;
+
+	//
+	// Drop anything still pending from sources just disabled
+	//
+	ControllerContext->InterruptStatus &= interruptEnable;
+
+exit:
+	return status;
+}
+
 VOID
 RmiConvertF01ToPhysical(
 	IN RMI4_F01_CTRL_REGISTERS_LOGICAL* Logical,
@@ -23,7 +23,7 @@ GetTouchesFromF11(
 	ULONG highestSlot;
 
 	ULONG FingerStatusRegister;
-	RMI4_F11_DATA_POSITION FingerPosRegisters[RMI4_MAX_TOUCHES];
+	RMI4_F11_DATA_POSITION FingerPosRegisters[RMI4_F11_MAX_FINGERS];
 
 	//
 	// Locate RMI data base address of 2D touch function
@@ -88,7 +88,7 @@ GetTouchesFromF11(
 		//
 		// Find the highest slot we know has finger data
 		//
-		if (ControllerContext->FingerCache.FingerSlotValid & (1 << i))
+		if (test_bit(i, ControllerContext->FingerCache.FingerSlotValid))
 		{
 			highestSlot = i;
 		}
@@ -178,7 +178,7 @@ Return Value:
 		// Sweep for a slot that needs to be cleaned
 		//
 
-		if (!(Cache->FingerSlotDirty & (1 << i)))
+		if (!test_bit(i, Cache->FingerSlotDirty))
 		{
 			continue;
 		}
@@ -212,7 +212,7 @@ Return Value:
 		//
 		// Finished, clobber the dirty bit
 		//
-		Cache->FingerSlotDirty &= ~(1 << i);
+		__clear_bit(i, Cache->FingerSlotDirty);
 	}
 
 	//
@@ -224,16 +224,16 @@ Return Value:
 		// Take actions when a new contact is first reported as down
 		//
 		if ((UnpackFingerState(FingerStatusRegister, i) != RMI4_FINGER_STATE_NOT_PRESENT) &&
-			((Cache->FingerSlotValid & (1 << i)) == 0))
+			!test_bit(i, Cache->FingerSlotValid))
 		{
-			Cache->FingerSlotValid |= (1 << i);
-			Cache->FingerDownOrder[Cache->FingerDownCount++] = i;
+			__set_bit(i, Cache->FingerSlotValid);
+			Cache->FingerDownOrder[Cache->FingerDownCount++] = (UCHAR)i;
 		}
 
 		//
 		// Ignore slots with no new information
 		//
-		if (!(Cache->FingerSlotValid & (1 << i)))
+		if (!test_bit(i, Cache->FingerSlotValid))
 		{
 			continue;
 		}
@@ -242,10 +242,10 @@ Return Value:
 		// Update local cache with new information from the controller
 		//
 		Cache->FingerSlot[i].fingerStatus = (UCHAR)UnpackFingerState(FingerStatusRegister, i);
-		Cache->FingerSlot[i].x = (FingerPosRegisters[i].XPosLo & 0xF) |
-			((FingerPosRegisters[i].XPosHi & 0xFF) << 4);
-		Cache->FingerSlot[i].y = (FingerPosRegisters[i].YPosLo & 0xF) |
-			((FingerPosRegisters[i].YPosHi & 0xFF) << 4);
+		Cache->FingerSlot[i].x = (USHORT)((FingerPosRegisters[i].XPosLo & 0xF) |
+			((FingerPosRegisters[i].XPosHi & 0xFF) << 4));
+		Cache->FingerSlot[i].y = (USHORT)((FingerPosRegisters[i].YPosLo & 0xF) |
+			((FingerPosRegisters[i].YPosHi & 0xFF) << 4));
 
 		//
 		// If a finger lifted, note the slot is now inactive so that any
@@ -253,8 +253,8 @@ Return Value:
 		//
 		if (Cache->FingerSlot[i].fingerStatus == RMI4_FINGER_STATE_NOT_PRESENT)
 		{
-			Cache->FingerSlotDirty |= (1 << i);
-			Cache->FingerSlotValid &= ~(1 << i);
+			__set_bit(i, Cache->FingerSlotDirty);
+			__clear_bit(i, Cache->FingerSlotValid);
 		}
 	}
 
@@ -274,7 +274,6 @@ RmiConfigureFunction11(
 	NTSTATUS status;
 	int index;
 
-	RMI4_F11_CTRL_REGISTERS controlF11 = { 0 };
 	RMI4_F11_QUERY1_REGISTERS query1_F11;
 
 	//
@@ -311,7 +310,7 @@ RmiConfigureFunction11(
 		goto exit;
 	}
 
-	ControllerContext->MaxFingers = RMI4_MAX_TOUCHES;
+	ControllerContext->MaxFingers = RMI4_F11_MAX_FINGERS;
 
 	//
 	// Reading first sensor query only!
@@ -339,7 +338,7 @@ RmiConfigureFunction11(
 	}
 	else if (query1_F11.NumberOfFingers == 5)
 	{
-		ControllerContext->MaxFingers = 10;
+		ControllerContext->MaxFingers = RMI4_F11_MAX_FINGERS;
 	}
 	else
 	{
@@ -355,9 +354,84 @@ RmiConfigureFunction11(
 	//end query
 
 
-	RmiConvertF11ToPhysical(
-		&ControllerContext->Config.TouchSettings,
-		&controlF11);
+	status = RmiSetFunction11Control(ControllerContext, SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	//
+	// Touch data is serviced through the function's own interrupt sources
+	//
+	ControllerContext->TouchIrqMask = ControllerContext->FunctionIrqMask[index];
+
+exit:
+	return status;
+}
+
+NTSTATUS
+RmiSetFunction11Control(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Writes the F11 control register image of the published configuration
+	to the controller. Contact state and the finger cache are left alone.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller
+	context
+
+	SpbContext - A pointer to the current i2c context
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS status;
+	int index;
+
+	RMI4_F11_CTRL_REGISTERS controlF11;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F11_2D_TOUCHPAD_SENSOR);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unexpected - RMI Function 11 missing");
+
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not change register page");
+
+		goto exit;
+	}
+
+	controlF11 = ControllerContext->Config->F11Ctrl;
 
 	//
 	// Write settings to controller
@@ -379,9 +453,6 @@ RmiConfigureFunction11(
 		goto exit;
 	}
 
-	//setup interupt
-	ControllerContext->Config.DeviceSettings.InterruptEnable |= 0x1 << index;
-
 exit:
 	return status;
 }
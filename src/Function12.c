@@ -9,16 +9,14 @@ GetTouchesFromF12(
 	IN SPB_CONTEXT* SpbContext
 )
 {
+	RMI4_FINGER_CACHE* Cache = &ControllerContext->FingerCache;
 	NTSTATUS status;
 
-	int index, i, x, y, fingers;
+	int index, i;
 
 	BYTE* data1;
 	BYTE* controllerData;
 
-	ULONG FingerStatusRegister = { 0 };
-	RMI4_F12_DATA_POSITION FingerPosRegisters[RMI4_MAX_TOUCHES];
-
 	//
 	// Locate RMI data base address of 2D touch function
 	//
@@ -87,31 +85,30 @@ GetTouchesFromF12(
 	}
 
 	data1 = &controllerData[ControllerContext->Data1Offset];
-	fingers = 0;
 
 	if (data1 != NULL)
 	{
-		for (i = 0; i < ControllerContext->MaxFingers; i++)
+		//
+		// Only objects reported present are decoded, positions of absent
+		// slots are never looked at
+		//
+		bitmap_zero(Cache->FrameValid, ControllerContext->MaxFingers);
+
+		for (i = 0; i < ControllerContext->MaxFingers; i++, data1 += F12_DATA1_BYTES_PER_OBJ)
 		{
 			switch (data1[0])
 			{
 			case RMI_F12_OBJECT_FINGER:
 			case RMI_F12_OBJECT_STYLUS:
-				FingerStatusRegister |= RMI4_FINGER_STATE_PRESENT_WITH_ACCURATE_POS << i;
-				fingers++;
 				break;
 			default:
-				//fingerStatus[i] = RMI4_FINGER_STATE_NOT_PRESENT;
-				break;
+				continue;
 			}
 
-			x = (data1[2] << 8) | data1[1];
-			y = (data1[4] << 8) | data1[3];
-
-			FingerPosRegisters[i].X = x;
-			FingerPosRegisters[i].Y = y;
-
-			data1 += F12_DATA1_BYTES_PER_OBJ;
+			__set_bit(i, Cache->FrameValid);
+			Cache->Frame[i].fingerStatus = RMI4_FINGER_STATE_PRESENT_WITH_ACCURATE_POS;
+			Cache->Frame[i].x = (USHORT)((data1[2] << 8) | data1[1]);
+			Cache->Frame[i].y = (USHORT)((data1[4] << 8) | data1[3]);
 		}
 	}
 	else
@@ -125,7 +122,13 @@ GetTouchesFromF12(
 		goto free_buffer;
 	}
 
-	UpdateLocalFingerCacheF12(FingerStatusRegister, FingerPosRegisters, ControllerContext);
+	//
+	// Decide on reporting mode before the cache takes the new positions,
+	// motion is measured against the previous frame
+	//
+	RmiUpdateReportingMode(ControllerContext, SpbContext);
+
+	UpdateLocalFingerCacheF12(ControllerContext);
 
 free_buffer:
 	ExFreePoolWithTag(
@@ -139,24 +142,23 @@ exit:
 
 VOID
 UpdateLocalFingerCacheF12(
-	IN ULONG FingerStatusRegister,
-	IN RMI4_F12_DATA_POSITION* FingerPosRegisters,
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
 )
 /*++
 
 Routine Description:
 
-	This routine takes raw data reported by the Synaptics hardware and
-	parses it to update a local cache of finger states. This routine manages
+	This routine takes the frame decoded from the Synaptics hardware and
+	updates a local cache of finger states. This routine manages
 	removing lifted touches from the cache, and manages a map between the
 	order of reported touches in hardware, and the order the driver should
-	use in reporting.
+	use in reporting. Slots are visited through the bitmaps, so the cost
+	follows the number of contacts rather than the slot capacity.
 
 Arguments:
 
-	Data - A pointer to the new data returned from hardware
-	Cache - A data structure holding various current finger state info
+	ControllerContext - Touch controller context, the frame is read from
+		and the cache updated in its finger cache
 
 Return Value:
 
@@ -164,7 +166,8 @@ Return Value:
 
 --*/
 {
-	int i, j;
+	ULONG i, j;
+	ULONG fingers = ControllerContext->MaxFingers;
 	RMI4_FINGER_CACHE* Cache = &ControllerContext->FingerCache;
 
 	//
@@ -172,22 +175,16 @@ Return Value:
 	// must clean out the slot and old touch info. There may be new
 	// finger data using the slot.
 	//
-	for (i = 0; i < ControllerContext->MaxFingers; i++)
+	for (i = find_first_bit(Cache->FingerSlotDirty, fingers);
+		i < fingers;
+		i = find_next_bit(Cache->FingerSlotDirty, fingers, i + 1))
 	{
-		//
-		// Sweep for a slot that needs to be cleaned
-		//
-		if (!(Cache->FingerSlotDirty & (1 << i)))
-		{
-			continue;
-		}
-
 		NT_ASSERT(Cache->FingerDownCount > 0);
 
 		//
 		// Find the slot in the reporting list 
 		//
-		for (j = 0; j < ControllerContext->MaxFingers; j++)
+		for (j = 0; j < Cache->FingerDownCount; j++)
 		{
 			if (Cache->FingerDownOrder[j] == i)
 			{
@@ -195,69 +192,67 @@ Return Value:
 			}
 		}
 
-		NT_ASSERT(j != ControllerContext->MaxFingers);
+		NT_ASSERT(j != Cache->FingerDownCount);
 
 		//
 		// Remove the slot. If the finger lifted was the last in the list,
 		// we just decrement the list total by one. If it was not last, we
 		// shift the trailing list items up by one.
 		//
-		for (; (j < Cache->FingerDownCount - 1) && (j < ControllerContext->MaxFingers - 1); j++)
+		if (j < Cache->FingerDownCount)
 		{
-			Cache->FingerDownOrder[j] = Cache->FingerDownOrder[j + 1];
+			for (; j + 1 < Cache->FingerDownCount; j++)
+			{
+				Cache->FingerDownOrder[j] = Cache->FingerDownOrder[j + 1];
+			}
+			Cache->FingerDownCount--;
 		}
-		Cache->FingerDownCount--;
 
 		//
 		// Finished, clobber the dirty bit
 		//
-		Cache->FingerSlotDirty &= ~(1 << i);
+		__clear_bit(i, Cache->FingerSlotDirty);
 	}
 
 	//
-	// Cache the new set of finger data reported by hardware
+	// If a finger lifted, note the slot is now inactive so that any
+	// cached data is cleaned out before we read hardware again. The last
+	// cached position is reported with the lift.
 	//
-	for (i = 0; i < ControllerContext->MaxFingers; i++)
+	for (i = find_first_bit(Cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(Cache->FingerSlotValid, fingers, i + 1))
 	{
-		//
-		// Take actions when a new contact is first reported as down
-		//
-		if ((((FingerStatusRegister >> i) & 0x1) != RMI4_FINGER_STATE_NOT_PRESENT) &&
-			((Cache->FingerSlotValid & (1 << i)) == 0) &&
-			(Cache->FingerDownCount < ControllerContext->MaxFingers))
+		if (!test_bit(i, Cache->FrameValid))
 		{
-			Cache->FingerSlotValid |= (1 << i);
-			Cache->FingerDownOrder[Cache->FingerDownCount++] = i;
+			Cache->FingerSlot[i].fingerStatus = RMI4_FINGER_STATE_NOT_PRESENT;
+			__set_bit(i, Cache->FingerSlotDirty);
+			__clear_bit(i, Cache->FingerSlotValid);
 		}
+	}
 
+	//
+	// Cache the new set of finger data reported by hardware
+	//
+	for (i = find_first_bit(Cache->FrameValid, fingers);
+		i < fingers;
+		i = find_next_bit(Cache->FrameValid, fingers, i + 1))
+	{
 		//
-		// Ignore slots with no new information
+		// Take actions when a new contact is first reported as down
 		//
-		if (!(Cache->FingerSlotValid & (1 << i)))
+		if (!test_bit(i, Cache->FingerSlotValid))
 		{
-			continue;
-		}
+			if (Cache->FingerDownCount >= fingers)
+			{
+				continue;
+			}
 
-		//
-		// When finger is down, update local cache with new information from
-		// the controller. When finger is up, we'll use last cached value
-		//
-		Cache->FingerSlot[i].fingerStatus = (UCHAR)((FingerStatusRegister >> i) & 0x1);
-		if (Cache->FingerSlot[i].fingerStatus)
-		{
-			Cache->FingerSlot[i].x = FingerPosRegisters[i].X;
-			Cache->FingerSlot[i].y = FingerPosRegisters[i].Y;
+			__set_bit(i, Cache->FingerSlotValid);
+			Cache->FingerDownOrder[Cache->FingerDownCount++] = (UCHAR)i;
 		}
 
-		//
-		// If a finger lifted, note the slot is now inactive so that any
-		// cached data is cleaned out before we read hardware again.
-		//
-		if (Cache->FingerSlot[i].fingerStatus == RMI4_FINGER_STATE_NOT_PRESENT)
-		{
-			Cache->FingerSlotDirty |= (1 << i);
-			Cache->FingerSlotValid &= ~(1 << i);
-		}
+		Cache->FingerSlot[i] = Cache->Frame[i];
 	}
 
 	//
@@ -297,10 +292,10 @@ RmiSetReportingMode(
 
 --*/
 {
-	UCHAR reportingControl[3];
+	UCHAR reportingControl[F12_2D_CTRL20_SIZE];
 	int index;
 	NTSTATUS status;
-	UINT8 indexCtrl20;
+	USHORT indexCtrl20;
 
 	//
 	// Find RMI F12 function
@@ -336,62 +331,88 @@ RmiSetReportingMode(
 		goto exit;
 	}
 
-	indexCtrl20 = RmiGetRegisterIndex(&ControllerContext->ControlRegDesc, F12_2D_CTRL20);
-
-	if (indexCtrl20 == ControllerContext->ControlRegDesc.NumRegisters)
+	//
+	// Ctrl20 is read from the controller once per configuration, later
+	// mode changes are applied to the shadow copy and only written
+	//
+	if (!ControllerContext->F12Ctrl20Valid)
 	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Cannot find F12_2D_Ctrl20 offset");
+		indexCtrl20 = RmiGetRegisterIndex(&ControllerContext->Setup->ControlRegDesc, F12_2D_CTRL20);
 
-		status = STATUS_INVALID_DEVICE_STATE;
-		goto exit;
-	}
+		if (indexCtrl20 == ControllerContext->Setup->ControlRegDesc.NumRegisters)
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Cannot find F12_2D_Ctrl20 offset");
 
-	if (ControllerContext->ControlRegDesc.Registers[indexCtrl20].RegisterSize != sizeof(reportingControl))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Unexpected F12_2D_Ctrl20 register size, size=%lu, expected=%lu",
-			ControllerContext->ControlRegDesc.Registers[indexCtrl20].RegisterSize,
-			sizeof(reportingControl)
-		);
+			status = STATUS_INVALID_DEVICE_STATE;
+			goto exit;
+		}
 
-		status = STATUS_INVALID_DEVICE_STATE;
-		goto exit;
-	}
+		if (ControllerContext->Setup->ControlRegDesc.Registers[indexCtrl20].RegisterSize != sizeof(reportingControl))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Unexpected F12_2D_Ctrl20 register size, size=%lu, expected=%lu",
+				ControllerContext->Setup->ControlRegDesc.Registers[indexCtrl20].RegisterSize,
+				sizeof(reportingControl)
+			);
+
+			status = STATUS_INVALID_DEVICE_STATE;
+			goto exit;
+		}
 
-	//
-	// Read Device Control register
-	//
-	status = SpbReadDataSynchronously(
-		SpbContext,
-		ControllerContext->Descriptors[index].ControlBase + indexCtrl20,
-		&reportingControl,
-		sizeof(reportingControl)
-	);
+		//
+		// Control registers are packed, the address of Ctrl20 is the sum
+		// of the sizes of every control register present before it
+		//
+		ControllerContext->F12Ctrl20Address = (UCHAR)(
+			ControllerContext->Descriptors[index].ControlBase +
+			RmiRegisterDescriptorCalcRegOffset(
+				&ControllerContext->Setup->ControlRegDesc,
+				F12_2D_CTRL20));
 
-	if (!NT_SUCCESS(status))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Could not read F12_2D_Ctrl20 register - Status=%X",
-			status);
+		//
+		// Read Device Control register
+		//
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			ControllerContext->F12Ctrl20Address,
+			ControllerContext->F12Ctrl20Shadow,
+			sizeof(ControllerContext->F12Ctrl20Shadow)
+		);
 
-		goto exit;
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Could not read F12_2D_Ctrl20 register - Status=%X",
+				status);
+
+			goto exit;
+		}
+
+		ControllerContext->F12Ctrl20Valid = TRUE;
+		ControllerContext->F12ReportingMode =
+			ControllerContext->F12Ctrl20Shadow[0] & RMI_F12_REPORTING_MODE_MASK;
 	}
 
 	if (OldMode)
 	{
-		*OldMode = reportingControl[0] & RMI_F12_REPORTING_MODE_MASK;
+		*OldMode = ControllerContext->F12Ctrl20Shadow[0] & RMI_F12_REPORTING_MODE_MASK;
 	}
 
 	//
 	// Assign new value
 	//
+	RtlCopyMemory(
+		reportingControl,
+		ControllerContext->F12Ctrl20Shadow,
+		sizeof(reportingControl));
+
 	reportingControl[0] &= ~RMI_F12_REPORTING_MODE_MASK;
 	reportingControl[0] |= NewMode & RMI_F12_REPORTING_MODE_MASK;
 
@@ -400,7 +421,7 @@ RmiSetReportingMode(
 	//
 	status = SpbWriteDataSynchronously(
 		SpbContext,
-		ControllerContext->Descriptors[index].ControlBase + indexCtrl20,
+		ControllerContext->F12Ctrl20Address,
 		&reportingControl,
 		sizeof(reportingControl)
 	);
@@ -416,6 +437,141 @@ RmiSetReportingMode(
 		goto exit;
 	}
 
+	RtlCopyMemory(
+		ControllerContext->F12Ctrl20Shadow,
+		reportingControl,
+		sizeof(reportingControl));
+
+	ControllerContext->F12ReportingMode = NewMode & RMI_F12_REPORTING_MODE_MASK;
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+RmiUpdateReportingMode(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+	Routine Description:
+
+		Switches the F12 reporting mode based on contact motion. While every
+		contact stays still the controller is moved to reduced reporting so
+		it stops interrupting on each scan. Motion beyond the exit threshold
+		or a contact arriving or lifting returns it to continuous reporting.
+
+	Arguments:
+
+		ControllerContext - Touch controller context
+
+		SpbContext - A pointer to the current i2c context
+
+	Return Value:
+
+		NTSTATUS indicating success or failure
+
+	Notes:
+
+		Compares the frame decoded in FingerCache.Frame, before it is merged
+		into the finger slots, against the positions last reported.
+
+--*/
+{
+	RMI4_FINGER_CACHE* Cache = &ControllerContext->FingerCache;
+	NTSTATUS status = STATUS_SUCCESS;
+	BYTE fingers = ControllerContext->MaxFingers;
+	UCHAR newMode;
+	int motion = 0;
+	int delta;
+	int i;
+
+	//
+	// Controllers without a usable Ctrl20 stay in whatever mode they have
+	//
+	if (!ControllerContext->F12Ctrl20Valid)
+	{
+		goto exit;
+	}
+
+	if (bitmap_empty(Cache->FrameValid, fingers) ||
+		!bitmap_equal(Cache->FrameValid, Cache->FingerSlotValid, fingers))
+	{
+		//
+		// Contact count changed, report every scan again
+		//
+		ControllerContext->F12StillFrames = 0;
+		newMode = RMI_F12_REPORTING_MODE_CONTINUOUS;
+	}
+	else
+	{
+		for (i = find_first_bit(Cache->FrameValid, fingers);
+			i < fingers;
+			i = find_next_bit(Cache->FrameValid, fingers, i + 1))
+		{
+			delta = Cache->Frame[i].x - Cache->FingerSlot[i].x;
+			if (delta < 0) delta = -delta;
+			if (delta > motion) motion = delta;
+
+			delta = Cache->Frame[i].y - Cache->FingerSlot[i].y;
+			if (delta < 0) delta = -delta;
+			if (delta > motion) motion = delta;
+		}
+
+		if (motion > RMI_F12_STILL_THRESHOLD)
+		{
+			ControllerContext->F12StillFrames = 0;
+		}
+		else if (ControllerContext->F12StillFrames < RMI_F12_REDUCED_ENTER_FRAMES)
+		{
+			ControllerContext->F12StillFrames++;
+		}
+
+		if (ControllerContext->F12ReportingMode == RMI_F12_REPORTING_MODE_REDUCED)
+		{
+			newMode = (motion > RMI_F12_MOTION_EXIT_THRESHOLD) ?
+				RMI_F12_REPORTING_MODE_CONTINUOUS :
+				RMI_F12_REPORTING_MODE_REDUCED;
+		}
+		else
+		{
+			newMode = (ControllerContext->F12StillFrames >= RMI_F12_REDUCED_ENTER_FRAMES) ?
+				RMI_F12_REPORTING_MODE_REDUCED :
+				RMI_F12_REPORTING_MODE_CONTINUOUS;
+		}
+	}
+
+	if (newMode == ControllerContext->F12ReportingMode)
+	{
+		goto exit;
+	}
+
+	status = RmiSetReportingMode(
+		ControllerContext,
+		SpbContext,
+		newMode,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REPORTING,
+			"Could not switch F12 reporting mode to %d - Status=%X",
+			newMode,
+			status);
+
+		goto exit;
+	}
+
+	Trace(
+		TRACE_LEVEL_VERBOSE,
+		TRACE_FLAG_REPORTING,
+		"F12 reporting mode is now %d",
+		newMode);
+
 exit:
 
 	return status;
@@ -469,23 +625,41 @@ RmiConfigureFunction12(
 		goto exit;
 	}
 
+	//
+	// Register layout may differ after a reset, drop the Ctrl20 shadow
+	//
+	ControllerContext->F12Ctrl20Valid = FALSE;
+	ControllerContext->F12StillFrames = 0;
+
 	// Retrieve base address for queries
 	queryF12Addr = ControllerContext->Descriptors[index].QueryBase;
-	status = SpbReadDataSynchronously(
-		SpbContext,
-		queryF12Addr,
-		&buf,
-		sizeof(char)
-	);
 
-	if (!NT_SUCCESS(status))
+	//
+	// Descriptors held by the controller topology were only recorded
+	// because the general info register announced them
+	//
+	if (ControllerContext->Setup->Topology.F12Valid)
 	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Failed to read general info register - Status=%X",
-			status);
-		goto exit;
+		buf = BIT(0);
+	}
+	else
+	{
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			queryF12Addr,
+			&buf,
+			sizeof(char)
+		);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Failed to read general info register - Status=%X",
+				status);
+			goto exit;
+		}
 	}
 
 	++queryF12Addr;
@@ -504,61 +678,29 @@ RmiConfigureFunction12(
 
 	//ControllerContext->HasDribble = !!(buf & BIT(3));
 
-	status = RmiReadRegisterDescriptor(
-		SpbContext,
-		queryF12Addr,
-		&ControllerContext->QueryRegDesc
-	);
-
-	if(!NT_SUCCESS(status))
-	{
-
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Failed to read the Query Register Descriptor - Status=%X",
-			status);
-		goto exit;
-	}
-	queryF12Addr += 3;
-
-	status = RmiReadRegisterDescriptor(
-		SpbContext,
-		queryF12Addr,
-		&ControllerContext->ControlRegDesc
-	);
-
-	if (!NT_SUCCESS(status))
-	{
-
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Failed to read the Control Register Descriptor - Status=%X",
-			status);
-		goto exit;
-	}
-	queryF12Addr += 3;
+	//
+	// Descriptors of a previous configuration are stale after a reset
+	//
+	RmiFreeRegisterDescriptors(ControllerContext);
 
-	status = RmiReadRegisterDescriptor(
+	status = RmiLoadRegisterDescriptors(
+		ControllerContext,
 		SpbContext,
-		queryF12Addr,
-		&ControllerContext->DataRegDesc
+		queryF12Addr
 	);
 
 	if (!NT_SUCCESS(status))
 	{
-
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_INIT,
-			"Failed to read the Data Register Descriptor - Status=%X",
+			"Failed to load the F12 register descriptors - Status=%X",
 			status);
 		goto exit;
 	}
-	queryF12Addr += 3;
+	queryF12Addr += RMI_REG_DESC_COUNT * 3;
 	ControllerContext->PacketSize = RmiRegisterDescriptorCalcSize(
-		&ControllerContext->DataRegDesc
+		&ControllerContext->Setup->DataRegDesc
 	);
 
 	// Skip rmi_f12_read_sensor_tuning for the prototype.
@@ -570,25 +712,20 @@ RmiConfigureFunction12(
 	* attention report check to see if the device is receiving data from
 	* HID attention reports.
 	*/
-	item = RmiGetRegisterDescItem(&ControllerContext->DataRegDesc, 0);
+	item = RmiGetRegisterDescItem(&ControllerContext->Setup->DataRegDesc, 0);
 	if (item) data_offset += (USHORT)item->RegisterSize;
 
-	item = RmiGetRegisterDescItem(&ControllerContext->DataRegDesc, 1);
+	item = RmiGetRegisterDescItem(&ControllerContext->Setup->DataRegDesc, 1);
 	if (item != NULL)
 	{
 		ControllerContext->Data1Offset = data_offset;
-		ControllerContext->MaxFingers = item->NumSubPackets;
-		if ((ControllerContext->MaxFingers * F12_DATA1_BYTES_PER_OBJ) >
-			(BYTE)(ControllerContext->PacketSize - ControllerContext->Data1Offset))
-		{
-			ControllerContext->MaxFingers =
-				(BYTE)(ControllerContext->PacketSize - ControllerContext->Data1Offset) /
-				F12_DATA1_BYTES_PER_OBJ;
-		}
-
-		if (ControllerContext->MaxFingers > RMI4_MAX_TOUCHES)
+		ControllerContext->MaxFingers = (BYTE)min(item->NumSubPackets, RMI4_MAX_TOUCHES);
+		if ((ULONG)(ControllerContext->MaxFingers * F12_DATA1_BYTES_PER_OBJ) >
+			(ULONG)(ControllerContext->PacketSize - ControllerContext->Data1Offset))
 		{
-			ControllerContext->MaxFingers = RMI4_MAX_TOUCHES;
+			ControllerContext->MaxFingers = (BYTE)(
+				(ControllerContext->PacketSize - ControllerContext->Data1Offset) /
+				F12_DATA1_BYTES_PER_OBJ);
 		}
 	}
 	else
@@ -606,108 +743,220 @@ RmiConfigureFunction12(
 		RMI_F12_REPORTING_MODE_CONTINUOUS,
 		NULL);
 
-	//setup interupt
-	ControllerContext->Config.DeviceSettings.InterruptEnable |= 0x1 << index;
+	//
+	// Touch data is serviced through the function's own interrupt sources
+	//
+	ControllerContext->TouchIrqMask = ControllerContext->FunctionIrqMask[index];
 
 exit:
 	return status;
 }
 
-NTSTATUS
-RmiReadRegisterDescriptor(
-	IN SPB_CONTEXT* Context,
-	IN UCHAR Address,
-	IN PRMI_REGISTER_DESCRIPTOR Rdesc
+static PVOID
+RmiDescArenaAlloc(
+	IN OUT RMI_DESC_ARENA* Arena,
+	IN SIZE_T Bytes
 )
-{
-	NTSTATUS Status;
+/*++
 
-	BYTE size_presence_reg;
-	BYTE buf[35];
-	int presense_offset = 1;
-	BYTE* struct_buf;
-	int reg;
-	int offset = 0;
-	int map_offset = 0;
-	int i;
-	int b;
+Routine Description:
 
-	Status = SpbReadDataSynchronously(
-		Context,
-		Address,
-		&size_presence_reg,
-		sizeof(BYTE)
-	);
+	Carves Bytes out of the descriptor arena. While the arena has no
+	backing allocation it only accounts for the request, which is how
+	the measuring pass sizes the arena.
 
-	if (!NT_SUCCESS(Status)) goto i2c_read_fail;
+Arguments:
 
-	++Address;
+	Arena - The descriptor arena
+	Bytes - Number of bytes requested
+
+Return Value:
 
-	if (size_presence_reg < 0 || size_presence_reg > 35)
+	Pointer into the arena, NULL when measuring or when exhausted
+
+--*/
+{
+	PVOID block = NULL;
+
+	Bytes = ALIGN_UP_BY(Bytes, sizeof(PVOID));
+
+	if (Arena->Base != NULL && Arena->Used + Bytes <= Arena->Size)
 	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"size_presence_reg has invalid size, either less than 0 or larger than 35");
-		Status = STATUS_INVALID_PARAMETER;
-		goto exit;
+		block = Arena->Base + Arena->Used;
 	}
 
-	memset(buf, 0, sizeof(buf));
+	Arena->Used += Bytes;
+	return block;
+}
 
-	/*
-	* The presence register contains the size of the register structure
-	* and a bitmap which identified which packet registers are present
-	* for this particular register type (ie query, control, or data).
-	*/
-	Status = SpbReadDataSynchronously(
-		Context,
-		Address,
-		buf,
-		size_presence_reg
-	);
-	if (!NT_SUCCESS(Status)) goto i2c_read_fail;
-	++Address;
+static NTSTATUS
+RmiDecodeRegisterPresence(
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	IN const BYTE* Presence,
+	IN BYTE PresenceSize
+)
+/*++
+
+Routine Description:
+
+	Decodes the presence register of a register descriptor, which holds
+	the size of the register structure and a bitmap of the packet
+	registers present for this register type (ie query, control, or
+	data).
+
+Arguments:
+
+	Rdesc - Descriptor to fill in
+	Presence - Presence register as read from the controller
+	PresenceSize - Size of the presence register
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	int presense_offset = 1;
+	ULONG map_offset = 0;
+	int i;
+	int b;
+
+	RtlZeroMemory(Rdesc, sizeof(RMI_REGISTER_DESCRIPTOR));
+
+	if (PresenceSize == 0 || PresenceSize > RMI_REG_DESC_PRESENCE_MAX)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"size_presence_reg has invalid size %d",
+			PresenceSize);
+		return STATUS_INVALID_PARAMETER;
+	}
 
-	if (buf[0] == 0)
+	if (Presence[0] == 0)
 	{
 		presense_offset = 3;
-		Rdesc->StructSize = buf[1] | (buf[2] << 8);
+		Rdesc->StructSize = Presence[1] | (Presence[2] << 8);
 	}
 	else
 	{
-		Rdesc->StructSize = buf[0];
+		Rdesc->StructSize = Presence[0];
 	}
 
-	for (i = presense_offset; i < size_presence_reg; i++)
+	for (i = presense_offset; i < PresenceSize; i++)
 	{
-		for (b = 0; b < 8; b++)
+		for (b = 0; b < 8 && map_offset < RMI_REG_DESC_PRESENSE_BITS; b++)
 		{
-			if (buf[i] & (0x1 << b))
+			if (Presence[i] & (0x1 << b))
 			{
-				bitmap_set(Rdesc->PresenceMap, map_offset, 1);
+				__set_bit(map_offset, Rdesc->PresenceMap);
 			}
 			++map_offset;
 		}
 	}
 
-	Rdesc->NumRegisters = (UINT8)bitmap_weight(Rdesc->PresenceMap, RMI_REG_DESC_PRESENSE_BITS);
-	Rdesc->Registers = ExAllocatePoolWithTag(
-		NonPagedPoolNx,
-		Rdesc->NumRegisters * sizeof(RMI_REGISTER_DESC_ITEM),
-		TOUCH_POOL_TAG_F12
+	Rdesc->NumRegisters = (USHORT)bitmap_weight(Rdesc->PresenceMap, RMI_REG_DESC_PRESENSE_BITS);
+
+	if (Rdesc->NumRegisters != 0 && Rdesc->StructSize == 0)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Register structure is empty but %d registers are present",
+			Rdesc->NumRegisters);
+		return STATUS_INVALID_DEVICE_STATE;
+	}
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+RmiReadRegisterDescriptor(
+	IN SPB_CONTEXT* Context,
+	IN UCHAR Address,
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	OUT BYTE* Presence,
+	OUT BYTE* PresenceSize,
+	OUT BYTE** StructBuf
+)
+/*++
+
+Routine Description:
+
+	Reads the presence register and the register structure of one
+	register descriptor. Items are not built here, the structure is
+	returned to the caller to be parsed into the function's arena.
+
+Arguments:
+
+	Context - A pointer to the current i2c context
+	Address - Address of the descriptor's presence register size
+	Rdesc - Descriptor to fill in
+	Presence - Receives the presence register, RMI_REG_DESC_PRESENCE_MAX
+		bytes
+	PresenceSize - Receives the size of the presence register
+	StructBuf - Receives the register structure, the caller frees it
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS Status;
+
+	BYTE size_presence_reg;
+	BYTE* struct_buf = NULL;
+
+	RtlZeroMemory(Rdesc, sizeof(RMI_REGISTER_DESCRIPTOR));
+	*PresenceSize = 0;
+	*StructBuf = NULL;
+
+	Status = SpbReadDataSynchronously(
+		Context,
+		Address,
+		&size_presence_reg,
+		sizeof(BYTE)
 	);
 
-	if (Rdesc->Registers == NULL)
+	if (!NT_SUCCESS(Status)) goto i2c_read_fail;
+
+	++Address;
+
+	if (size_presence_reg == 0 || size_presence_reg > RMI_REG_DESC_PRESENCE_MAX)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"size_presence_reg has invalid size %d",
+			size_presence_reg);
+		Status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	memset(Presence, 0, RMI_REG_DESC_PRESENCE_MAX);
+
+	Status = SpbReadDataSynchronously(
+		Context,
+		Address,
+		Presence,
+		size_presence_reg
+	);
+	if (!NT_SUCCESS(Status)) goto i2c_read_fail;
+	++Address;
+
+	*PresenceSize = size_presence_reg;
+
+	Status = RmiDecodeRegisterPresence(Rdesc, Presence, size_presence_reg);
+
+	if (!NT_SUCCESS(Status) || Rdesc->NumRegisters == 0)
 	{
-		Status = STATUS_INSUFFICIENT_RESOURCES;
 		goto exit;
 	}
 
 	/*
 	* Allocate a temporary buffer to hold the register structure.
-	* I'm not using devm_kzalloc here since it will not be retained
-	* after exiting this function
+	* It is only needed until the descriptor has been parsed.
 	*/
 	struct_buf = ExAllocatePoolWithTag(
 		NonPagedPoolNx,
@@ -734,85 +983,443 @@ RmiReadRegisterDescriptor(
 		Rdesc->StructSize
 	);
 
-	if (!NT_SUCCESS(Status)) goto free_buffer;
+	if (!NT_SUCCESS(Status))
+	{
+		ExFreePoolWithTag(
+			struct_buf,
+			TOUCH_POOL_TAG_F12
+		);
+		goto i2c_read_fail;
+	}
+
+	*StructBuf = struct_buf;
+
+exit:
+	return Status;
+
+i2c_read_fail:
+	Trace(
+		TRACE_LEVEL_ERROR,
+		TRACE_FLAG_INIT,
+		"Failed to read register descriptor - Status=%X",
+		Status);
+	goto exit;
+}
+
+static NTSTATUS
+RmiParseRegisterDescriptor(
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	IN const BYTE* StructBuf,
+	IN OUT RMI_DESC_ARENA* Arena
+)
+/*++
+
+Routine Description:
+
+	Walks the register structure of a descriptor. Every read from the
+	structure is bounds checked against StructSize. When the arena is
+	backed the items and subpacket maps are built, otherwise only their
+	size is accounted for.
+
+Arguments:
+
+	Rdesc - Descriptor whose presence map has been read
+	StructBuf - Register structure read by RmiReadRegisterDescriptor
+	Arena - Arena the items and maps are carved from
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	PRMI_REGISTER_DESC_ITEM items;
+	PRMI_REGISTER_DESC_ITEM item;
+	BITMAP_WORD* map;
+	ULONG offset = 0;
+	ULONG start;
+	ULONG bits;
+	ULONG reg_size;
+	ULONG reg;
+	ULONG b;
+	USHORT i;
+
+	if (Rdesc->NumRegisters == 0)
+	{
+		return STATUS_SUCCESS;
+	}
+
+	items = RmiDescArenaAlloc(
+		Arena,
+		Rdesc->NumRegisters * sizeof(RMI_REGISTER_DESC_ITEM));
+
+	if (Arena->Base != NULL && items == NULL)
+	{
+		return STATUS_BUFFER_OVERFLOW;
+	}
 
 	reg = find_first_bit(Rdesc->PresenceMap, RMI_REG_DESC_PRESENSE_BITS);
 	for (i = 0; i < Rdesc->NumRegisters; i++)
 	{
-		PRMI_REGISTER_DESC_ITEM item = &Rdesc->Registers[i];
-		int reg_size = struct_buf[offset];
+		if (offset + 1 > Rdesc->StructSize)
+		{
+			goto malformed;
+		}
 
+		reg_size = StructBuf[offset];
 		++offset;
+
 		if (reg_size == 0)
 		{
-			reg_size = struct_buf[offset] |
-				(struct_buf[offset + 1] << 8);
+			if (offset + 2 > Rdesc->StructSize)
+			{
+				goto malformed;
+			}
+
+			reg_size = StructBuf[offset] |
+				(StructBuf[offset + 1] << 8);
 			offset += 2;
 		}
 
 		if (reg_size == 0)
 		{
-			reg_size = struct_buf[offset] |
-				(struct_buf[offset + 1] << 8) |
-				(struct_buf[offset + 2] << 16) |
-				(struct_buf[offset + 3] << 24);
+			if (offset + 4 > Rdesc->StructSize)
+			{
+				goto malformed;
+			}
+
+			reg_size = StructBuf[offset] |
+				(StructBuf[offset + 1] << 8) |
+				(StructBuf[offset + 2] << 16) |
+				((ULONG)StructBuf[offset + 3] << 24);
 			offset += 4;
 		}
 
-		item->Register = (USHORT)reg;
-		item->RegisterSize = reg_size;
-
-		map_offset = 0;
+		//
+		// Subpacket presence is a chain of bytes with 7 bits each,
+		// the top bit flags that another byte follows
+		//
+		start = offset;
 
 		do
 		{
-			for (b = 0; b < 7; b++)
+			if (offset >= Rdesc->StructSize)
 			{
-				if (struct_buf[offset] & (0x1 << b))
+				goto malformed;
+			}
+		} while (StructBuf[offset++] & 0x80);
+
+		bits = (offset - start) * 7;
+
+		if (bits > RMI_REG_DESC_SUBPACKET_BITS)
+		{
+			goto malformed;
+		}
+
+		map = RmiDescArenaAlloc(
+			Arena,
+			BITS_TO_WORDS(bits) * sizeof(BITMAP_WORD));
+
+		if (Arena->Base != NULL)
+		{
+			if (map == NULL)
+			{
+				return STATUS_BUFFER_OVERFLOW;
+			}
+
+			bitmap_zero(map, bits);
+
+			for (b = 0; b < bits; b++)
+			{
+				if (StructBuf[start + b / 7] & (0x1 << (b % 7)))
 				{
-					bitmap_set(item->SubPacketMap, map_offset, 1);
+					__set_bit(b, map);
 				}
-				++map_offset;
 			}
-		} while (struct_buf[offset++] & 0x80);
-
-		item->NumSubPackets = (BYTE)bitmap_weight(item->SubPacketMap, RMI_REG_DESC_SUBPACKET_BITS);
 
-		Trace(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_FLAG_INIT,
-			"%s: reg: %d reg size: %ld subpackets: %d num reg: %d",
-			__func__,
-			item->Register, item->RegisterSize, item->NumSubPackets, Rdesc->NumRegisters
-		);
+			item = &items[i];
+			item->Register = (USHORT)reg;
+			item->RegisterSize = reg_size;
+			item->SubPacketBits = (USHORT)bits;
+			item->SubPacketMap = map;
+			item->NumSubPackets = (USHORT)bitmap_weight(map, bits);
+
+			Trace(
+				TRACE_LEVEL_INFORMATION,
+				TRACE_FLAG_INIT,
+				"%s: reg: %d reg size: %ld subpackets: %d num reg: %d",
+				__func__,
+				item->Register, item->RegisterSize, item->NumSubPackets, Rdesc->NumRegisters
+			);
+		}
 
 		reg = find_next_bit(Rdesc->PresenceMap, RMI_REG_DESC_PRESENSE_BITS, reg + 1);
 	}
 
-free_buffer:
-	ExFreePoolWithTag(
-		struct_buf,
-		TOUCH_POOL_TAG_F12
-	);
+	if (Arena->Base != NULL)
+	{
+		Rdesc->Registers = items;
+	}
 
-exit:
-	return Status;
+	return STATUS_SUCCESS;
 
-i2c_read_fail:
+malformed:
 	Trace(
 		TRACE_LEVEL_ERROR,
 		TRACE_FLAG_INIT,
-		"Failed to read general info register - Status=%X",
-		Status);
-	goto exit;
+		"Register structure is truncated at offset %lu of %lu",
+		offset,
+		Rdesc->StructSize);
+
+	return STATUS_INVALID_DEVICE_STATE;
 }
 
-UINT8 RmiGetRegisterIndex(
+NTSTATUS
+RmiLoadRegisterDescriptors(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Address
+)
+/*++
+
+Routine Description:
+
+	Reads the query, control and data register descriptors of F12 and
+	builds them in a single arena. The structures are parsed twice, once
+	to size the arena and once to fill it. Descriptors already held by
+	the controller topology are not read again, those read from the
+	controller are recorded there when they fit.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	SpbContext - A pointer to the current i2c context
+	Address - Address of the query register descriptor
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	PRMI_REGISTER_DESCRIPTOR descriptors[RMI_REG_DESC_COUNT];
+	BYTE* structBuf[RMI_REG_DESC_COUNT] = { NULL };
+	RMI_DESC_ARENA arena = { 0 };
+	RMI4_TOPOLOGY* topology;
+	BOOLEAN cached;
+	ULONG structBytes = 0;
+	NTSTATUS status = STATUS_SUCCESS;
+	int i;
+
+	descriptors[0] = &ControllerContext->Setup->QueryRegDesc;
+	descriptors[1] = &ControllerContext->Setup->ControlRegDesc;
+	descriptors[2] = &ControllerContext->Setup->DataRegDesc;
+
+	topology = &ControllerContext->Setup->Topology;
+	cached = topology->F12Valid;
+
+	for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+	{
+		if (cached)
+		{
+			status = RmiDecodeRegisterPresence(
+				descriptors[i],
+				topology->F12Presence[i],
+				topology->F12PresenceSize[i]);
+
+			if (NT_SUCCESS(status) &&
+				descriptors[i]->NumRegisters != 0 &&
+				(descriptors[i]->StructSize != topology->F12StructSize[i] ||
+				structBytes + descriptors[i]->StructSize > RMI4_TOPOLOGY_F12_BYTES))
+			{
+				status = STATUS_REVISION_MISMATCH;
+			}
+
+			if (NT_SUCCESS(status) && descriptors[i]->NumRegisters != 0)
+			{
+				structBuf[i] = &topology->F12Structs[structBytes];
+				structBytes += descriptors[i]->StructSize;
+			}
+		}
+		else
+		{
+			status = RmiReadRegisterDescriptor(
+				SpbContext,
+				Address,
+				descriptors[i],
+				topology->F12Presence[i],
+				&topology->F12PresenceSize[i],
+				&structBuf[i]
+			);
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Failed to read register descriptor %d - Status=%X",
+				i,
+				status);
+			goto exit;
+		}
+		Address += 3;
+	}
+
+	//
+	// Measure, then carve the items and maps out of one allocation
+	//
+	for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+	{
+		status = RmiParseRegisterDescriptor(descriptors[i], structBuf[i], &arena);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	arena.Size = arena.Used;
+	arena.Used = 0;
+
+	if (arena.Size != 0)
+	{
+		arena.Base = ExAllocatePoolWithTag(
+			NonPagedPoolNx,
+			arena.Size,
+			TOUCH_POOL_TAG_F12
+		);
+
+		if (arena.Base == NULL)
+		{
+			status = STATUS_INSUFFICIENT_RESOURCES;
+			goto exit;
+		}
+
+		RtlZeroMemory(arena.Base, arena.Size);
+
+		for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+		{
+			status = RmiParseRegisterDescriptor(descriptors[i], structBuf[i], &arena);
+
+			if (!NT_SUCCESS(status))
+			{
+				goto exit;
+			}
+		}
+	}
+
+	ControllerContext->Setup->F12DescArena = arena;
+	arena.Base = NULL;
+
+	//
+	// Record the structures read for the controller topology, a start
+	// with the same firmware then parses them without reading them
+	//
+	if (!cached)
+	{
+		for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+		{
+			topology->F12StructSize[i] = 0;
+
+			if (structBuf[i] != NULL &&
+				structBytes + descriptors[i]->StructSize <= RMI4_TOPOLOGY_F12_BYTES)
+			{
+				RtlCopyMemory(
+					&topology->F12Structs[structBytes],
+					structBuf[i],
+					descriptors[i]->StructSize);
+
+				topology->F12StructSize[i] = (USHORT)descriptors[i]->StructSize;
+				structBytes += descriptors[i]->StructSize;
+			}
+			else if (structBuf[i] != NULL)
+			{
+				break;
+			}
+		}
+
+		topology->F12Valid = (i == RMI_REG_DESC_COUNT);
+	}
+
+exit:
+
+	for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+	{
+		if (structBuf[i] != NULL && !cached)
+		{
+			ExFreePoolWithTag(
+				structBuf[i],
+				TOUCH_POOL_TAG_F12
+			);
+		}
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		if (arena.Base != NULL)
+		{
+			ExFreePoolWithTag(
+				arena.Base,
+				TOUCH_POOL_TAG_F12
+			);
+		}
+
+		for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+		{
+			RtlZeroMemory(descriptors[i], sizeof(RMI_REGISTER_DESCRIPTOR));
+		}
+	}
+
+	return status;
+}
+
+VOID
+RmiFreeRegisterDescriptors(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Releases the F12 descriptor arena. Descriptors are left empty so
+	register lookups fail cleanly until the function is configured again.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	if (ControllerContext->Setup == NULL)
+	{
+		return;
+	}
+
+	if (ControllerContext->Setup->F12DescArena.Base != NULL)
+	{
+		ExFreePoolWithTag(
+			ControllerContext->Setup->F12DescArena.Base,
+			TOUCH_POOL_TAG_F12
+		);
+	}
+
+	RtlZeroMemory(&ControllerContext->Setup->F12DescArena, sizeof(RMI_DESC_ARENA));
+	RtlZeroMemory(&ControllerContext->Setup->QueryRegDesc, sizeof(RMI_REGISTER_DESCRIPTOR));
+	RtlZeroMemory(&ControllerContext->Setup->ControlRegDesc, sizeof(RMI_REGISTER_DESCRIPTOR));
+	RtlZeroMemory(&ControllerContext->Setup->DataRegDesc, sizeof(RMI_REGISTER_DESCRIPTOR));
+}
+
+USHORT RmiGetRegisterIndex(
 	PRMI_REGISTER_DESCRIPTOR Rdesc,
 	USHORT reg
 )
 {
-	UINT8 i;
+	USHORT i;
 
 	for (i = 0; i < Rdesc->NumRegisters; i++)
 	{
@@ -839,6 +1446,27 @@ RmiRegisterDescriptorCalcSize(
 	return size;
 }
 
+size_t
+RmiRegisterDescriptorCalcRegOffset(
+	IN PRMI_REGISTER_DESCRIPTOR Rdesc,
+	IN USHORT Reg
+)
+{
+	PRMI_REGISTER_DESC_ITEM item;
+	int i;
+	size_t offset = 0;
+
+	for (i = 0; i < Rdesc->NumRegisters; i++)
+	{
+		item = &Rdesc->Registers[i];
+		if (item->Register == Reg)
+			break;
+
+		offset += item->RegisterSize;
+	}
+	return offset;
+}
+
 const PRMI_REGISTER_DESC_ITEM RmiGetRegisterDescItem(
 	PRMI_REGISTER_DESCRIPTOR Rdesc,
 	USHORT reg
@@ -30,8 +30,10 @@ RmiConfigureFunction1A(
 		//       by default.
 		//
 
-		//setup interupts
-		ControllerContext->Config.DeviceSettings.InterruptEnable |= 0x1 << index;
+		//
+		// Buttons are serviced through the function's own interrupt sources
+		//
+		ControllerContext->ButtonIrqMask = ControllerContext->FunctionIrqMask[index];
 	}
 
 	return 0;
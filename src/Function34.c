@@ -0,0 +1,1062 @@
+#include "debug.h"
+#include "Function34.h"
+
+//F34
+
+static VOID
+RmiF34Sleep(
+	IN ULONG Milliseconds
+)
+{
+	LARGE_INTEGER interval;
+
+	interval.QuadPart = -10000LL * Milliseconds;
+	KeDelayExecutionThread(KernelMode, FALSE, &interval);
+}
+
+static NTSTATUS
+RmiF34Locate(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	OUT int* Index
+)
+/*++
+
+Routine Description:
+
+	Finds F34 in the function table, maps in its register page and
+	refreshes the flash geometry. The table changes when the controller
+	enters and leaves the bootloader, so every step looks F34 up again.
+
+--*/
+{
+	RMI4_F34_QUERY_REGISTERS* query = &ControllerContext->F34Flash.Query;
+	NTSTATUS status;
+	int index;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F34_FLASH_MEMORY_MANAGEMENT);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unexpected - RMI Function 34 missing");
+
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not change register page");
+
+		goto exit;
+	}
+
+	status = SpbReadDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].QueryBase,
+		query,
+		sizeof(RMI4_F34_QUERY_REGISTERS));
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error reading RMI F34 query registers - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	//
+	// The command register follows the block data and must stay on the
+	// register page
+	//
+	if (query->BlockSize == 0 ||
+		ControllerContext->Descriptors[index].DataBase +
+		RMI4_F34_DATA_BLOCK_DATA + query->BlockSize >= RMI4_PAGE_SELECT_ADDRESS)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unsupported F34 block size %d",
+			query->BlockSize);
+
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	*Index = index;
+
+exit:
+	return status;
+}
+
+static BYTE
+RmiF34CommandAddress(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN int Index
+)
+{
+	return ControllerContext->Descriptors[Index].DataBase +
+		RMI4_F34_DATA_BLOCK_DATA +
+		(BYTE)ControllerContext->F34Flash.Query.BlockSize;
+}
+
+static NTSTATUS
+RmiF34WaitForIdle(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN int Index,
+	IN ULONG Timeout,
+	IN BOOLEAN Sleep
+)
+/*++
+
+Routine Description:
+
+	Waits for the controller to clear the flash command and checks the
+	status it left. Block operations complete within a few bus
+	transactions and are polled back to back, long operations sleep
+	between polls.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	SpbContext - A pointer to the current i2c context
+	Index - F34 function index
+	Timeout - Time in ms the command may take
+	Sleep - TRUE to sleep between polls
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	ULONG64 deadline;
+	BYTE command;
+	NTSTATUS status;
+
+	deadline = KeQueryInterruptTime() + (ULONG64)Timeout * 10000;
+
+	for (;;)
+	{
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			RmiF34CommandAddress(ControllerContext, Index),
+			&command,
+			sizeof(command));
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		ControllerContext->F34Flash.ControllerStatus = command;
+
+		if ((command & RMI4_F34_COMMAND_MASK) == 0)
+		{
+			break;
+		}
+
+		if (KeQueryInterruptTime() > deadline)
+		{
+			status = STATUS_IO_TIMEOUT;
+			goto exit;
+		}
+
+		if (Sleep)
+		{
+			RmiF34Sleep(RMI4_F34_SLOW_POLL_INTERVAL);
+		}
+	}
+
+	if (RMI4_F34_STATUS(command) != 0)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"F34 command failed with status %d",
+			RMI4_F34_STATUS(command));
+
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+	}
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34IssueCommand(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN int Index,
+	IN PUCHAR Buffer,
+	IN BYTE Command,
+	IN ULONG Timeout
+)
+/*++
+
+Routine Description:
+
+	Issues a command guarded by the bootloader ID (enable flash, erase)
+	and waits for it. Buffer holds one block plus the command byte.
+
+--*/
+{
+	RMI4_F34_FLASH* flash = &ControllerContext->F34Flash;
+	NTSTATUS status;
+
+	RtlZeroMemory(Buffer, flash->Query.BlockSize);
+	RtlCopyMemory(Buffer, flash->Query.BootloaderId, RMI4_F34_BOOTLOADER_ID_SIZE);
+	Buffer[flash->Query.BlockSize] = Command;
+
+	status = SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[Index].DataBase + RMI4_F34_DATA_BLOCK_DATA,
+		Buffer,
+		flash->Query.BlockSize + 1);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF34WaitForIdle(
+		ControllerContext,
+		SpbContext,
+		Index,
+		Timeout,
+		TRUE);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34SetBlockNumber(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN int Index,
+	IN ULONG Block
+)
+{
+	BYTE blockNumber[2];
+
+	blockNumber[0] = (BYTE)(Block & 0xFF);
+	blockNumber[1] = (BYTE)(Block >> 8);
+
+	return SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[Index].DataBase + RMI4_F34_DATA_BLOCK_NUMBER,
+		blockNumber,
+		sizeof(blockNumber));
+}
+
+static NTSTATUS
+RmiF34EnterBootloader(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Buffer
+)
+/*++
+
+Routine Description:
+
+	Switches the controller to flash programming mode. Only F01 and F34
+	are present in the bootloader, so the function table is rebuilt.
+
+--*/
+{
+	BYTE command;
+	NTSTATUS status;
+	int index;
+
+	status = RmiF34Locate(ControllerContext, SpbContext, &index);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF34IssueCommand(
+		ControllerContext,
+		SpbContext,
+		index,
+		Buffer,
+		RMI4_F34_COMMAND_ENABLE_FLASH_PROG,
+		RMI4_F34_ENABLE_TIMEOUT);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	command = ControllerContext->F34Flash.ControllerStatus;
+
+	if (!(command & RMI4_F34_PROGRAM_ENABLED))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"F34 did not enable flash programming");
+
+		status = STATUS_DEVICE_PROTOCOL_ERROR;
+		goto exit;
+	}
+
+	status = RmiBuildFunctionsTable(ControllerContext, SpbContext);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34Erase(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Buffer
+)
+{
+	NTSTATUS status;
+	int index;
+
+	status = RmiF34Locate(ControllerContext, SpbContext, &index);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF34IssueCommand(
+		ControllerContext,
+		SpbContext,
+		index,
+		Buffer,
+		(ControllerContext->F34Flash.Flags & RMI4_F34_FLASH_CONFIG_ONLY) ?
+			RMI4_F34_COMMAND_ERASE_CONFIG :
+			RMI4_F34_COMMAND_ERASE_ALL,
+		RMI4_F34_ERASE_TIMEOUT);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34WriteBlocks(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Buffer,
+	IN PUCHAR Data,
+	IN ULONG BlockCount,
+	IN BYTE Command
+)
+/*++
+
+Routine Description:
+
+	Writes a flash area starting at the next unwritten block. Each block
+	and its write command go out in one transfer and completion is polled
+	right away instead of waiting for the F34 interrupt. The block number
+	auto increments, it is only set when an area is started or resumed.
+
+--*/
+{
+	RMI4_F34_FLASH* flash = &ControllerContext->F34Flash;
+	ULONG blockSize = flash->Query.BlockSize;
+	NTSTATUS status;
+	int index;
+
+	status = RmiF34Locate(ControllerContext, SpbContext, &index);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF34SetBlockNumber(ControllerContext, SpbContext, index, flash->NextBlock);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	for (; flash->NextBlock < BlockCount; flash->NextBlock++)
+	{
+		RtlCopyMemory(Buffer, Data + flash->NextBlock * blockSize, blockSize);
+		Buffer[blockSize] = Command;
+
+		status = SpbWriteDataSynchronously(
+			SpbContext,
+			ControllerContext->Descriptors[index].DataBase + RMI4_F34_DATA_BLOCK_DATA,
+			Buffer,
+			blockSize + 1);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		status = RmiF34WaitForIdle(
+			ControllerContext,
+			SpbContext,
+			index,
+			RMI4_F34_BLOCK_TIMEOUT,
+			FALSE);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"Error writing F34 block %lu - STATUS:%X",
+				flash->NextBlock,
+				status);
+
+			goto exit;
+		}
+
+		flash->BytesWritten += blockSize;
+	}
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34VerifyConfig(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Buffer,
+	IN PUCHAR Config
+)
+/*++
+
+Routine Description:
+
+	Reads the configuration area back and compares it with the image.
+	The block data and the command register are read in one transfer,
+	so a single read both checks completion and returns the block.
+
+--*/
+{
+	RMI4_F34_FLASH* flash = &ControllerContext->F34Flash;
+	ULONG blockSize = flash->Query.BlockSize;
+	ULONG64 deadline;
+	BYTE command;
+	NTSTATUS status;
+	int index;
+
+	status = RmiF34Locate(ControllerContext, SpbContext, &index);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF34SetBlockNumber(ControllerContext, SpbContext, index, flash->NextBlock);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	for (; flash->NextBlock < flash->Query.ConfigBlocks; flash->NextBlock++)
+	{
+		command = RMI4_F34_COMMAND_READ_CONFIG_BLOCK;
+
+		status = SpbWriteDataSynchronously(
+			SpbContext,
+			RmiF34CommandAddress(ControllerContext, index),
+			&command,
+			sizeof(command));
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		deadline = KeQueryInterruptTime() + (ULONG64)RMI4_F34_BLOCK_TIMEOUT * 10000;
+
+		do
+		{
+			status = SpbReadDataSynchronously(
+				SpbContext,
+				ControllerContext->Descriptors[index].DataBase + RMI4_F34_DATA_BLOCK_DATA,
+				Buffer,
+				blockSize + 1);
+
+			if (!NT_SUCCESS(status))
+			{
+				goto exit;
+			}
+
+			if ((Buffer[blockSize] & RMI4_F34_COMMAND_MASK) == 0)
+			{
+				break;
+			}
+
+			if (KeQueryInterruptTime() > deadline)
+			{
+				status = STATUS_IO_TIMEOUT;
+				goto exit;
+			}
+		} while (TRUE);
+
+		flash->ControllerStatus = Buffer[blockSize];
+
+		if (RMI4_F34_STATUS(Buffer[blockSize]) != 0 ||
+			RtlCompareMemory(Buffer, Config + flash->NextBlock * blockSize, blockSize) != blockSize)
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"F34 configuration block %lu does not match the image",
+				flash->NextBlock);
+
+			status = STATUS_DEVICE_DATA_ERROR;
+			goto exit;
+		}
+
+		flash->BytesVerified += blockSize;
+	}
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34Reset(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+	Resets the controller out of the bootloader and waits for it to boot
+	the new firmware. The bootloader checks the firmware and config CRCs
+	on boot, a failure is reported through the F01 device status.
+
+--*/
+{
+	RMI4_F01_DATA_REGISTERS data;
+	RMI4_F01_COMMAND_REGISTERS command;
+	ULONG64 deadline;
+	NTSTATUS status;
+	int index;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F01_RMI_DEVICE_CONTROL);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unexpected - RMI Function 01 missing");
+
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	command.Reset = 1;
+
+	status = SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].CommandBase,
+		&command,
+		sizeof(command));
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	//
+	// The controller comes back on register page 0
+	//
+	ControllerContext->CurrentPage = 0;
+	deadline = KeQueryInterruptTime() + (ULONG64)RMI4_F34_RESET_TIMEOUT * 10000;
+
+	do
+	{
+		RmiF34Sleep(RMI4_F34_RESET_DELAY);
+
+		status = RmiBuildFunctionsTable(ControllerContext, SpbContext);
+
+		if (!NT_SUCCESS(status))
+		{
+			continue;
+		}
+
+		index = RmiGetFunctionIndex(
+			ControllerContext->Descriptors,
+			ControllerContext->FunctionCount,
+			RMI4_F01_RMI_DEVICE_CONTROL);
+
+		if (index == ControllerContext->FunctionCount)
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			continue;
+		}
+
+		status = RmiChangePage(
+			ControllerContext,
+			SpbContext,
+			ControllerContext->FunctionOnPage[index]);
+
+		if (!NT_SUCCESS(status))
+		{
+			continue;
+		}
+
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			ControllerContext->Descriptors[index].DataBase,
+			&data,
+			sizeof(data));
+
+		if (NT_SUCCESS(status) &&
+			data.DeviceStatus.Status != RMI4_F01_DATA_STATUS_CRC_IN_PROGRESS)
+		{
+			break;
+		}
+	} while (KeQueryInterruptTime() < deadline);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (data.DeviceStatus.FlashProg ||
+		data.DeviceStatus.Status == RMI4_F01_DATA_STATUS_CRC_IN_PROGRESS ||
+		data.DeviceStatus.Status == RMI4_F01_DATA_STATUS_CONFIG_CRC_FAILURE ||
+		data.DeviceStatus.Status == RMI4_F01_DATA_STATUS_FW_CRC_FAILURE)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Controller did not boot the new firmware, device status %X",
+			data.DeviceStatus.All);
+
+		status = STATUS_DEVICE_DATA_ERROR;
+	}
+
+exit:
+	return status;
+}
+
+static ULONG
+RmiF34ImageChecksum(
+	IN PUCHAR Data,
+	IN ULONG Length
+)
+/*++
+
+Routine Description:
+
+	Computes the Fletcher-32 checksum of an image payload, over its
+	little-endian 16 bit words. An odd last byte is padded with zero.
+
+--*/
+{
+	ULONG sum1 = 0xFFFF;
+	ULONG sum2 = 0xFFFF;
+	ULONG word;
+	ULONG i;
+
+	for (i = 0; i < Length; i += sizeof(USHORT))
+	{
+		word = Data[i];
+
+		if (i + 1 < Length)
+		{
+			word |= (ULONG)Data[i + 1] << 8;
+		}
+
+		sum1 += word;
+		sum2 += sum1;
+		sum1 = (sum1 & 0xFFFF) + (sum1 >> 16);
+		sum2 = (sum2 & 0xFFFF) + (sum2 >> 16);
+	}
+
+	return (sum2 << 16) | sum1;
+}
+
+static NTSTATUS
+RmiF34CheckProductId(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN RMI4_F34_IMAGE_HEADER* Header
+)
+/*++
+
+Routine Description:
+
+	Checks the image was built for the product F01 reports. The image
+	names the product as a string, the controller may keep other data
+	past its terminator.
+
+--*/
+{
+	BYTE productId[RMI4_F34_PRODUCT_ID_SIZE];
+	ULONG length;
+	NTSTATUS status;
+	int index;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F01_RMI_DEVICE_CONTROL);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Unexpected - RMI Function 01 missing");
+
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = SpbReadDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].QueryBase +
+			FIELD_OFFSET(RMI4_F01_QUERY_REGISTERS, ProductID1),
+		productId,
+		sizeof(productId));
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	for (length = 0; length < RMI4_F34_PRODUCT_ID_SIZE; length++)
+	{
+		if (Header->ProductId[length] == 0)
+		{
+			break;
+		}
+	}
+
+	if (length == 0 ||
+		!RtlEqualMemory(productId, Header->ProductId, length) ||
+		(length < RMI4_F34_PRODUCT_ID_SIZE && productId[length] != 0))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Image is for product %.10s, not for controller %.10s",
+			Header->ProductId,
+			productId);
+
+		status = STATUS_INVALID_PARAMETER;
+	}
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF34CheckImage(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Image,
+	IN SIZE_T ImageBytes
+)
+/*++
+
+Routine Description:
+
+	Checks an image before anything is written to the controller: its
+	areas fit the buffer, it is for a V5 bootloader, its payload matches
+	the header checksum and it was built for this product. A resumed
+	update is checked the same way, so the checksum it is matched on
+	is one of a verified image.
+
+--*/
+{
+	RMI4_F34_IMAGE_HEADER* header;
+	ULONG checksum;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (ImageBytes < RMI4_F34_IMAGE_HEADER_SIZE)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	header = (RMI4_F34_IMAGE_HEADER*)Image;
+
+	if (header->FirmwareSize > ImageBytes - RMI4_F34_IMAGE_HEADER_SIZE ||
+		header->ConfigSize > ImageBytes - RMI4_F34_IMAGE_HEADER_SIZE - header->FirmwareSize)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	if (header->BootloaderVersion != RMI4_F34_IMAGE_BOOTLOADER_V5)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Image is for bootloader V%d, only V%d is supported",
+			header->BootloaderVersion,
+			RMI4_F34_IMAGE_BOOTLOADER_V5);
+
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	checksum = RmiF34ImageChecksum(
+		Image + sizeof(header->Checksum),
+		RMI4_F34_IMAGE_HEADER_SIZE - sizeof(header->Checksum) +
+			header->FirmwareSize + header->ConfigSize);
+
+	if (checksum != header->Checksum)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Image checksum is %08X, header says %08X",
+			checksum,
+			header->Checksum);
+
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	status = RmiF34CheckProductId(ControllerContext, SpbContext, header);
+
+exit:
+	return status;
+}
+
+NTSTATUS
+RmiF34Flash(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN PUCHAR Image,
+	IN SIZE_T ImageBytes,
+	IN ULONG Flags
+)
+/*++
+
+Routine Description:
+
+	Runs a firmware update from a Synaptics image. The image is checked
+	before the controller enters the bootloader. The update is a state
+	machine, a failed step is kept in the context and can be resumed
+	with the same image by passing RMI4_F34_FLASH_RESUME. With
+	RMI4_F34_FLASH_CONFIG_ONLY only the configuration area is erased
+	and written. Called with the controller lock held, the caller
+	restarts the controller once the update is done.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	SpbContext - A pointer to the current i2c context
+	Image - Firmware image, header included
+	ImageBytes - Size of the firmware image
+	Flags - RMI4_F34_FLASH_XXX flags
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_F34_FLASH* flash = &ControllerContext->F34Flash;
+	RMI4_F34_IMAGE_HEADER* header = (RMI4_F34_IMAGE_HEADER*)Image;
+	RMI4_F34_FLASH_STATE next;
+	PUCHAR firmware;
+	PUCHAR config;
+	PUCHAR buffer = NULL;
+	ULONG blockSize;
+	NTSTATUS status;
+	int index;
+
+	status = RmiF34CheckImage(ControllerContext, SpbContext, Image, ImageBytes);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	firmware = Image + RMI4_F34_IMAGE_HEADER_SIZE;
+	config = firmware + header->FirmwareSize;
+
+	if (Flags & RMI4_F34_FLASH_RESUME)
+	{
+		if (flash->State <= F34FlashEnterBootloader ||
+			flash->State == F34FlashDone ||
+			flash->ImageChecksum != header->Checksum ||
+			flash->Flags != (Flags & ~RMI4_F34_FLASH_RESUME))
+		{
+			status = STATUS_INVALID_DEVICE_STATE;
+			goto exit;
+		}
+	}
+	else
+	{
+		RtlZeroMemory(flash, sizeof(RMI4_F34_FLASH));
+		flash->State = F34FlashEnterBootloader;
+		flash->Flags = Flags;
+		flash->ImageChecksum = header->Checksum;
+		flash->StartTime = KeQueryInterruptTime();
+	}
+
+	//
+	// Checks the image against the flash geometry, it is the same in
+	// and out of the bootloader
+	//
+	status = RmiF34Locate(ControllerContext, SpbContext, &index);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	blockSize = flash->Query.BlockSize;
+
+	if (header->ConfigSize != (ULONG)flash->Query.ConfigBlocks * blockSize ||
+		(!(Flags & RMI4_F34_FLASH_CONFIG_ONLY) &&
+			header->FirmwareSize != (ULONG)flash->Query.FirmwareBlocks * blockSize))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Image does not match the F34 flash layout");
+
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	buffer = ExAllocatePoolWithTag(NonPagedPoolNx, blockSize + 1, TOUCH_POOL_TAG);
+
+	if (buffer == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	while (flash->State != F34FlashDone)
+	{
+		switch (flash->State)
+		{
+		case F34FlashEnterBootloader:
+			status = RmiF34EnterBootloader(ControllerContext, SpbContext, buffer);
+			next = F34FlashErase;
+			break;
+		case F34FlashErase:
+			status = RmiF34Erase(ControllerContext, SpbContext, buffer);
+			next = (flash->Flags & RMI4_F34_FLASH_CONFIG_ONLY) ?
+				F34FlashWriteConfig :
+				F34FlashWriteFirmware;
+			break;
+		case F34FlashWriteFirmware:
+			status = RmiF34WriteBlocks(
+				ControllerContext,
+				SpbContext,
+				buffer,
+				firmware,
+				flash->Query.FirmwareBlocks,
+				RMI4_F34_COMMAND_WRITE_FW_BLOCK);
+			next = F34FlashWriteConfig;
+			break;
+		case F34FlashWriteConfig:
+			status = RmiF34WriteBlocks(
+				ControllerContext,
+				SpbContext,
+				buffer,
+				config,
+				flash->Query.ConfigBlocks,
+				RMI4_F34_COMMAND_WRITE_CONFIG_BLOCK);
+			next = F34FlashVerifyConfig;
+			break;
+		case F34FlashVerifyConfig:
+			status = RmiF34VerifyConfig(ControllerContext, SpbContext, buffer, config);
+			next = F34FlashReset;
+			break;
+		case F34FlashReset:
+			status = RmiF34Reset(ControllerContext, SpbContext);
+			next = F34FlashDone;
+			break;
+		default:
+			status = STATUS_INVALID_DEVICE_STATE;
+			next = F34FlashIdle;
+			break;
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_INIT,
+				"F34 update failed in state %d - STATUS:%X",
+				flash->State,
+				status);
+
+			goto exit;
+		}
+
+		flash->State = next;
+		flash->NextBlock = 0;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F34 update done, %lu bytes written",
+		flash->BytesWritten);
+
+exit:
+	flash->LastStatus = status;
+	flash->ElapsedTime = KeQueryInterruptTime() - flash->StartTime;
+
+	if (buffer != NULL)
+	{
+		ExFreePoolWithTag(buffer, TOUCH_POOL_TAG);
+	}
+
+	return status;
+}
@@ -0,0 +1,732 @@
+#include "debug.h"
+#include "Function54.h"
+#include "internal.h"
+#include "diagnostics.h"
+
+//F54
+
+NTSTATUS
+RmiConfigureFunction54(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+	Discovers the test reporting function and reads the sensor geometry
+	used to size captured images. F54 is optional, controllers without
+	it simply do not support capacitance capture.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	SpbContext - A pointer to the current i2c context
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_F54_QUERY_REGISTERS* query;
+	NTSTATUS status = STATUS_SUCCESS;
+	int index;
+
+	ControllerContext->HasTestReporting = FALSE;
+
+	//
+	// A reset drops the selected report type, capture starts over
+	//
+	ControllerContext->F54Stream.ReportRequested = FALSE;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F54_TEST_REPORTING);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not change register page");
+
+		goto exit;
+	}
+
+	query = &ControllerContext->Setup->F54QueryRegisters;
+
+	status = SpbReadDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].QueryBase,
+		query,
+		sizeof(RMI4_F54_QUERY_REGISTERS));
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error reading RMI F54 query registers - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F54 sensor is %d RX x %d TX electrodes",
+		query->NumRxElectrodes,
+		query->NumTxElectrodes);
+
+	ControllerContext->HasTestReporting =
+		(query->NumRxElectrodes != 0) && (query->NumTxElectrodes != 0);
+
+	//
+	// Completed reports are read from the F54 interrupt
+	//
+	if (ControllerContext->HasTestReporting)
+	{
+		ControllerContext->TestIrqMask = ControllerContext->FunctionIrqMask[index];
+	}
+
+exit:
+	return status;
+}
+
+static ULONG
+RmiF54GetFrameBytes(
+	IN RMI4_F54_QUERY_REGISTERS* Query,
+	IN UCHAR ReportType
+)
+/*++
+
+Routine Description:
+
+	Returns the size of a report of the given type, or zero if the
+	controller cannot produce it.
+
+--*/
+{
+	ULONG pixels = Query->NumRxElectrodes * Query->NumTxElectrodes;
+
+	switch (ReportType)
+	{
+	case RMI4_F54_REPORT_8BIT_IMAGE:
+		return Query->HasImage8 ? pixels : 0;
+	case RMI4_F54_REPORT_16BIT_IMAGE:
+	case RMI4_F54_REPORT_RAW_16BIT_IMAGE:
+		return Query->HasImage16 ? pixels * sizeof(USHORT) : 0;
+	case RMI4_F54_REPORT_TRUE_BASELINE:
+		return Query->HasBaseline ? pixels * sizeof(USHORT) : 0;
+	case RMI4_F54_REPORT_FULL_RAW_CAP:
+	case RMI4_F54_REPORT_FULL_RAW_CAP_RX_COUPLING_COMP:
+		return pixels * sizeof(USHORT);
+	default:
+		return 0;
+	}
+}
+
+NTSTATUS
+RmiF54StartStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN UCHAR ReportType,
+	IN PVOID Ring,
+	IN SIZE_T RingBytes
+)
+/*++
+
+Routine Description:
+
+	Starts capturing reports of the given type into a ring buffer. The
+	ring must stay mapped until RmiF54StopStream is called. The first
+	report is requested from the stream timer, which only does so in D0
+	with the display on. Called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	ReportType - RMI4 F54 report type to capture
+	Ring - System address of the ring buffer
+	RingBytes - Size of the ring buffer
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+	PTOUCH_DIAG_F54_RING header;
+	ULONG frameBytes;
+	ULONG slotBytes;
+	ULONG slotOffset;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!ControllerContext->HasTestReporting || stream->PollTimer == NULL)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	if (stream->Active)
+	{
+		status = STATUS_DEVICE_BUSY;
+		goto exit;
+	}
+
+	frameBytes = RmiF54GetFrameBytes(
+		&ControllerContext->Setup->F54QueryRegisters,
+		ReportType);
+
+	if (frameBytes == 0)
+	{
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	slotOffset = (ULONG)ALIGN_UP_BY(sizeof(TOUCH_DIAG_F54_RING), TOUCH_DIAG_F54_ALIGNMENT);
+	slotBytes = (ULONG)ALIGN_UP_BY(
+		FIELD_OFFSET(TOUCH_DIAG_F54_FRAME, Data) + frameBytes,
+		TOUCH_DIAG_F54_ALIGNMENT);
+
+	//
+	// A single slot would be overwritten while the reader copies it
+	//
+	if (RingBytes < slotOffset + 2 * (SIZE_T)slotBytes)
+	{
+		status = STATUS_BUFFER_TOO_SMALL;
+		goto exit;
+	}
+
+	header = (PTOUCH_DIAG_F54_RING)Ring;
+	RtlZeroMemory(header, slotOffset);
+	header->HeaderBytes = slotOffset;
+	header->ReportType = ReportType;
+	header->RxCount = ControllerContext->Setup->F54QueryRegisters.NumRxElectrodes;
+	header->TxCount = ControllerContext->Setup->F54QueryRegisters.NumTxElectrodes;
+	header->FrameBytes = frameBytes;
+	header->SlotBytes = slotBytes;
+	header->SlotCount = (ULONG)((RingBytes - slotOffset) / slotBytes);
+
+	stream->Ring = (PUCHAR)Ring;
+	stream->FrameBytes = frameBytes;
+	stream->SlotBytes = slotBytes;
+	stream->SlotCount = header->SlotCount;
+	stream->SlotOffset = slotOffset;
+	stream->Sequence = 0;
+	stream->WatchdogSequence = 0;
+	stream->ReportType = ReportType;
+	stream->ReportRequested = FALSE;
+	stream->Active = TRUE;
+
+	WdfTimerStart(stream->PollTimer, WDF_REL_TIMEOUT_IN_MS(RMI4_F54_START_DELAY));
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"F54 capture of report type %d started, %lu slots of %lu bytes",
+		ReportType,
+		stream->SlotCount,
+		slotBytes);
+
+exit:
+	return status;
+}
+
+VOID
+RmiF54StopStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Stops the capture. Once this returns the ring is no longer touched,
+	a timer or interrupt running concurrently waits on the controller
+	lock held by the caller and finds the stream inactive.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+
+	if (!stream->Active)
+	{
+		return;
+	}
+
+	stream->Active = FALSE;
+	stream->Ring = NULL;
+
+	WdfTimerStop(stream->PollTimer, FALSE);
+}
+
+VOID
+RmiF54ParkStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Parks an active capture when the controller leaves D0 or the display
+	turns off. The ring is kept but no report is requested or read until
+	RmiF54ResumeStream, a report pending in the controller is dropped.
+	Called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+
+	if (!stream->Active)
+	{
+		return;
+	}
+
+	stream->ReportRequested = FALSE;
+
+	WdfTimerStop(stream->PollTimer, FALSE);
+}
+
+VOID
+RmiF54ResumeStream(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Restarts a parked capture once the controller is back in D0 with the
+	display on. Called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+
+	if (!stream->Active ||
+		ControllerContext->DevicePowerState != PowerDeviceD0 ||
+		ControllerContext->DisplayOff)
+	{
+		return;
+	}
+
+	stream->ReportRequested = FALSE;
+
+	WdfTimerStart(stream->PollTimer, WDF_REL_TIMEOUT_IN_MS(RMI4_F54_START_DELAY));
+}
+
+static NTSTATUS
+RmiF54ReadFrame(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	IN int Index
+)
+/*++
+
+Routine Description:
+
+	Reads a completed report into the next ring slot and publishes it.
+	The report is read in RMI4_F54_READ_CHUNK bursts, or smaller if the
+	transport cannot move that much at once, straight into the slot. The
+	FIFO index is rewritten before every burst.
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+	PTOUCH_DIAG_F54_RING header = (PTOUCH_DIAG_F54_RING)stream->Ring;
+	PTOUCH_DIAG_F54_FRAME frame;
+	BYTE dataBase = ControllerContext->Descriptors[Index].DataBase;
+	BYTE fifoIndex[2];
+	ULONG chunk = min(RMI4_F54_READ_CHUNK, SpbGetMaxTransferSize(SpbContext));
+	ULONG offset;
+	ULONG length;
+	ULONG sequence;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	frame = (PTOUCH_DIAG_F54_FRAME)(stream->Ring + stream->SlotOffset +
+		(stream->Sequence % stream->SlotCount) * stream->SlotBytes);
+
+	InterlockedExchange((volatile LONG*)&frame->Sequence, 0);
+
+	for (offset = 0; offset < stream->FrameBytes; offset += length)
+	{
+		length = min(stream->FrameBytes - offset, chunk);
+
+		fifoIndex[0] = (BYTE)(offset & 0xFF);
+		fifoIndex[1] = (BYTE)(offset >> 8);
+
+		status = SpbWriteDataSynchronously(
+			SpbContext,
+			dataBase + RMI4_F54_DATA_FIFO_INDEX,
+			fifoIndex,
+			sizeof(fifoIndex));
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			dataBase + RMI4_F54_DATA_REPORT_DATA,
+			frame->Data + offset,
+			length);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	frame->Length = stream->FrameBytes;
+	frame->Timestamp = KeQueryInterruptTime();
+
+	sequence = stream->Sequence + 1;
+	if (sequence == 0)
+	{
+		sequence = 1;
+	}
+	stream->Sequence = sequence;
+
+	InterlockedExchange((volatile LONG*)&frame->Sequence, sequence);
+	InterlockedExchange((volatile LONG*)&header->WriteSequence, sequence);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+RmiF54Service(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+	Advances the capture. A report that finished is read into the ring
+	and the next one is requested right away. Nothing is done while the
+	requested report is still being captured.
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+	BYTE command;
+	BYTE reportType;
+	NTSTATUS status;
+	int index;
+
+	index = RmiGetFunctionIndex(
+		ControllerContext->Descriptors,
+		ControllerContext->FunctionCount,
+		RMI4_F54_TEST_REPORTING);
+
+	if (index == ControllerContext->FunctionCount)
+	{
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		ControllerContext->FunctionOnPage[index]);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (stream->ReportRequested)
+	{
+		status = SpbReadDataSynchronously(
+			SpbContext,
+			ControllerContext->Descriptors[index].CommandBase,
+			&command,
+			sizeof(command));
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		//
+		// The controller clears GetReport once the report is captured
+		//
+		if (command & RMI4_F54_COMMAND_GET_REPORT)
+		{
+			goto exit;
+		}
+
+		stream->ReportRequested = FALSE;
+
+		status = RmiF54ReadFrame(ControllerContext, SpbContext, index);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	reportType = stream->ReportType;
+
+	status = SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].DataBase + RMI4_F54_DATA_REPORT_TYPE,
+		&reportType,
+		sizeof(reportType));
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	command = RMI4_F54_COMMAND_GET_REPORT;
+
+	status = SpbWriteDataSynchronously(
+		SpbContext,
+		ControllerContext->Descriptors[index].CommandBase,
+		&command,
+		sizeof(command));
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	stream->ReportRequested = TRUE;
+
+exit:
+	return status;
+}
+
+static VOID
+RmiF54CountError(
+	IN RMI4_F54_STREAM* Stream,
+	IN NTSTATUS Status
+)
+/*++
+
+Routine Description:
+
+	Counts a failed or timed out report in the ring header.
+
+--*/
+{
+	Trace(
+		TRACE_LEVEL_ERROR,
+		TRACE_FLAG_INTERRUPT,
+		"Error capturing F54 report - STATUS:%X",
+		Status);
+
+	InterlockedIncrement(
+		(volatile LONG*)&((PTOUCH_DIAG_F54_RING)Stream->Ring)->Errors);
+}
+
+VOID
+RmiF54ServiceInterrupt(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+	Reads the report that raised the F54 interrupt and requests the
+	next one. Interrupts for reports the stream no longer waits on,
+	after a stop or while parked, are ignored. Called from interrupt
+	servicing with the controller lock held.
+
+Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	SpbContext - A pointer to the current i2c context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_F54_STREAM* stream = &ControllerContext->F54Stream;
+	NTSTATUS status;
+
+	if (!stream->Active || !stream->ReportRequested)
+	{
+		return;
+	}
+
+	status = RmiF54Service(ControllerContext, SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		RmiF54CountError(stream, status);
+	}
+}
+
+VOID
+RmiF54OnPollTimer(
+	IN WDFTIMER Timer
+)
+/*++
+
+Routine Description:
+
+	Sends the first request of an active capture, then checks every
+	RMI4_F54_REPORT_TIMEOUT ms that reports are still completing and
+	requests again if none did. Outside D0 or with the display off the
+	controller is not talked to and the timer is not re-armed, the
+	capture is resumed from RmiF54ResumeStream.
+
+Arguments:
+
+	Timer - F54 poll timer, parented to the device
+
+Return Value:
+
+	None
+
+--*/
+{
+	WDFDEVICE fxDevice = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+	PDEVICE_EXTENSION devContext = GetDeviceContext(fxDevice);
+	RMI4_CONTROLLER_CONTEXT* controller;
+	RMI4_F54_STREAM* stream;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		return;
+	}
+
+	stream = &controller->F54Stream;
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	if (!stream->Active ||
+		controller->DevicePowerState != PowerDeviceD0 ||
+		controller->DisplayOff)
+	{
+		goto exit;
+	}
+
+	if (stream->ReportRequested &&
+		stream->Sequence == stream->WatchdogSequence)
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INTERRUPT,
+			"F54 report timed out, requesting again");
+
+		RmiF54CountError(stream, STATUS_IO_TIMEOUT);
+
+		stream->ReportRequested = FALSE;
+	}
+
+	if (!stream->ReportRequested)
+	{
+		status = RmiF54Service(controller, &devContext->SpbContext);
+
+		if (!NT_SUCCESS(status))
+		{
+			RmiF54CountError(stream, status);
+		}
+	}
+
+	stream->WatchdogSequence = stream->Sequence;
+
+	WdfTimerStart(stream->PollTimer, WDF_REL_TIMEOUT_IN_MS(RMI4_F54_REPORT_TIMEOUT));
+
+exit:
+	WdfWaitLockRelease(controller->ControllerLock);
+}
+
+NTSTATUS
+RmiF54Initialize(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Creates the capture stream timer once for the lifetime of the
+	context. It runs at passive level since it waits on the controller
+	lock and talks to the controller.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	WDF_TIMER_CONFIG timerConfig;
+	WDF_OBJECT_ATTRIBUTES timerAttributes;
+	NTSTATUS status;
+
+	WDF_TIMER_CONFIG_INIT(&timerConfig, RmiF54OnPollTimer);
+	timerConfig.AutomaticSerialization = FALSE;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+	timerAttributes.ParentObject = ControllerContext->FxDevice;
+	timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfTimerCreate(
+		&timerConfig,
+		&timerAttributes,
+		&ControllerContext->F54Stream.PollTimer);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not create F54 poll timer - STATUS:%X",
+			status);
+
+		ControllerContext->F54Stream.PollTimer = NULL;
+	}
+
+	return status;
+}
@@ -52,79 +52,36 @@ static BKL_LUX_TABLE_ENTRY g_DefaultLuxMap[BKL_NUM_LEVELS_DEFAULT] =
 	},
 };
 
-__inline
 VOID
-TchBklSleepMillisec(
-	IN ULONG TimeMsec
-)
-/*++
-
-Routine Description:
-
-	This helper routine puts the caller to sleep
-
-Arguments:
-
-	TimeMsec - time to sleep in millisec
-
-Return Value:
-
-	None.
-
---*/
-{
-	LARGE_INTEGER Delay = { 0 };
-
-	Delay.QuadPart = WDF_REL_TIMEOUT_IN_MS(TimeMsec);
-
-	KeDelayExecutionThread(KernelMode, FALSE, &Delay);
-}
-
-
-NTSTATUS
 TchBklGetDefaultLuxIntensityMap(
-	IN BKL_CONTEXT* BklContext
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
 )
 /*++
 
 Routine Description:
 
-	This helper routine copies the default lux table to device context.
+	This helper routine copies the default lux table.
 
 Arguments:
 
-	BklContext - Backlight control context structure
+	LuxTable - receives the table, BKL_MAX_LEVELS entries
+	LuxLevels - receives the number of levels in the table
 
 Return Value:
 
-	NTSTATUS indicating success or failure
+	None
 
 --*/
 {
-	BklContext->BklNumLevels = BKL_NUM_LEVELS_DEFAULT;
-
-	BklContext->BklLuxTable = (BKL_LUX_TABLE_ENTRY*)
-		ExAllocatePoolWithTag(
-			NonPagedPool,
-			sizeof(BKL_LUX_TABLE_ENTRY) * BklContext->BklNumLevels,
-			TOUCH_POOL_TAG);
-
-	if (BklContext->BklLuxTable == NULL)
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_OTHER,
-			"Could not allocate memory for lux table, out of memory");
+	C_ASSERT(ARRAYSIZE(g_DefaultLuxMap) == BKL_NUM_LEVELS_DEFAULT);
 
-		return STATUS_UNSUCCESSFUL;
-	}
+	*LuxLevels = BKL_NUM_LEVELS_DEFAULT;
 
 	RtlCopyMemory(
-		BklContext->BklLuxTable,
+		LuxTable,
 		g_DefaultLuxMap,
 		sizeof(g_DefaultLuxMap));
-
-	return STATUS_SUCCESS;
 }
 
 NTSTATUS
@@ -198,21 +155,112 @@ exit:
 	return status;
 }
 
+NTSTATUS
+TchBklValidateLuxTable(
+	IN OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+)
+/*++
+
+Routine Description:
+
+	This helper routine validates a lux table read from the registry and
+	puts it in the form TchBklGetLuxLevel expects: entries sorted by their
+	upper bound, each range starting where the previous one ends, and the
+	last range open-ended so every reading maps to a level.
+
+Arguments:
+
+	LuxTable - lux table to validate
+	LuxLevels - number of levels in the table
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	BKL_LUX_TABLE_ENTRY* table = LuxTable;
+	BKL_LUX_TABLE_ENTRY entry;
+	NTSTATUS status;
+	ULONG i;
+	ULONG j;
+
+	status = STATUS_SUCCESS;
+
+	for (i = 0; i < LuxLevels; i++)
+	{
+		if (table[i].Intensity > BKL_MAX_INTENSITY)
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_OTHER,
+				"Lux table intensity %d of level %d is out of range",
+				table[i].Intensity,
+				i);
+
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+	}
+
+	//
+	// Tables are short, an insertion sort on the upper bound will do
+	//
+	for (i = 1; i < LuxLevels; i++)
+	{
+		entry = table[i];
+
+		for (j = i; j > 0 && table[j - 1].Max > entry.Max; j--)
+		{
+			table[j] = table[j - 1];
+		}
+
+		table[j] = entry;
+	}
+
+	for (i = 0; i < LuxLevels; i++)
+	{
+		if (table[i].Max == 0 ||
+			(i > 0 && table[i].Max == table[i - 1].Max))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_OTHER,
+				"Lux table range %d is empty or duplicated",
+				table[i].Max);
+
+			status = STATUS_INVALID_PARAMETER;
+			goto exit;
+		}
+
+		table[i].Min = (i == 0) ? 0 : table[i - 1].Max;
+	}
+
+	table[LuxLevels - 1].Max = MAXULONG;
+
+exit:
+
+	return status;
+}
+
 NTSTATUS
 TchBklGetCustomLuxIntensityMap(
-	IN BKL_CONTEXT* BklContext
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
 )
 /*++
 
 Routine Description:
 
 	This helper routine reads and parses registry strings to build a lux table
-	as specified by an OEM, with an arbitrary number of levels. This routine
+	as specified by an OEM, with up to BKL_MAX_LEVELS levels. This routine
 	validates that sane entries are provided.
 
 Arguments:
 
-	BklContext - Backlight control context structure
+	LuxTable - receives the table, BKL_MAX_LEVELS entries
+	LuxLevels - receives the number of levels in the table
 
 Return Value:
 
@@ -229,8 +277,10 @@ Return Value:
 	WDFCOLLECTION intensityStrings;
 	WDFKEY key;
 	NTSTATUS status;
+	ULONG levels;
 	ULONG value = 0;
 
+	*LuxLevels = 0;
 	key = NULL;
 	luxRangeStrings = NULL;
 	intensityStrings = NULL;
@@ -319,14 +369,16 @@ Return Value:
 	//
 	// Validate that at least one non-null string was provided
 	//
-	BklContext->BklNumLevels = WdfCollectionGetCount(luxRangeStrings);
+	levels = WdfCollectionGetCount(luxRangeStrings);
 
-	if (BklContext->BklNumLevels == 0)
+	if (levels == 0 ||
+		levels > BKL_MAX_LEVELS)
 	{
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_OTHER,
-			"No range strings provided, registry lux table is invalid");
+			"%d range strings provided, registry lux table is invalid",
+			levels);
 
 		status = STATUS_UNSUCCESSFUL;
 		goto exit;
@@ -336,55 +388,31 @@ Return Value:
 	// Make sure the count of intensity strings matches the count of ranges
 	//
 	if (WdfCollectionGetCount(intensityStrings) !=
-		BklContext->BklNumLevels)
+		levels)
 	{
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_OTHER,
 			"Error in registry lux mapping table, expect %d levels, found %d",
-			BklContext->BklNumLevels,
+			levels,
 			WdfCollectionGetCount(intensityStrings));
 
 		status = STATUS_UNSUCCESSFUL;
 		goto exit;
 	}
 
-	//
-	// Allocate some space for the mapping table
-	//
-	BklContext->BklLuxTable = (BKL_LUX_TABLE_ENTRY*)
-		ExAllocatePoolWithTag(
-			NonPagedPool,
-			sizeof(BKL_LUX_TABLE_ENTRY) * BklContext->BklNumLevels + 1,
-			TOUCH_POOL_TAG);
-
-	if (NULL == BklContext->BklLuxTable)
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_OTHER,
-			"Could not allocate memory for lux table, out of memory");
-
-		status = STATUS_UNSUCCESSFUL;
-		goto exit;
-	}
-
 	//
 	// Walk the registry values and build the table, failing on error
-	// TODO: validate more
 	//
-
-	for (i = 0; i < BklContext->BklNumLevels; i++)
+	for (i = 0; i < levels; i++)
 	{
-		BklContext->BklLuxTable[i].Min = value;
-
 		status = TchBklGetValueFromCollection(&luxRangeStrings, i, &value);
 		if (!NT_SUCCESS(status))
 		{
 			goto exit;
 		}
 
-		BklContext->BklLuxTable[i].Max = value;
+		LuxTable[i].Max = value;
 
 		status = TchBklGetValueFromCollection(&intensityStrings, i, &value);
 
@@ -393,7 +421,14 @@ Return Value:
 			goto exit;
 		}
 
-		BklContext->BklLuxTable[i].Intensity = value;
+		LuxTable[i].Intensity = value;
+	}
+
+	status = TchBklValidateLuxTable(LuxTable, levels);
+
+	if (NT_SUCCESS(status))
+	{
+		*LuxLevels = levels;
 	}
 
 exit:
@@ -403,7 +438,7 @@ exit:
 		WdfObjectDelete(luxRangeStrings);
 	}
 
-	if (intensityStrings != NULL);
+	if (intensityStrings != NULL)
 	{
 		WdfObjectDelete(intensityStrings);
 	}
@@ -413,19 +448,89 @@ exit:
 		WdfRegistryClose(key);
 	}
 
+	return status;
+}
+
+VOID
+TchBklLoadLuxTable(
+	OUT BKL_LUX_TABLE_ENTRY* LuxTable,
+	OUT PULONG LuxLevels
+)
+/*++
+
+Routine Description:
+
+	Reads the lux table configured by the OEM, falling back to the
+	default table when none is configured or the configured one is
+	invalid. The table is read into the configuration snapshot and
+	handed to the backlight context from there.
+
+Arguments:
+
+	LuxTable - receives the table, BKL_MAX_LEVELS entries
+	LuxLevels - receives the number of levels in the table
+
+Return Value:
+
+	None
+
+--*/
+{
+	NTSTATUS status;
+
+	status = TchBklGetCustomLuxIntensityMap(LuxTable, LuxLevels);
+
 	if (!NT_SUCCESS(status))
 	{
-		if (BklContext->BklLuxTable != NULL)
-		{
-			ExFreePoolWithTag(
-				BklContext->BklLuxTable,
-				TOUCH_POOL_TAG);
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_OTHER,
+			"Warning, no platform-configured lux mapping table in registry - STATUS:%X",
+			status);
 
-			BklContext->BklLuxTable = NULL;
-		}
+		TchBklGetDefaultLuxIntensityMap(LuxTable, LuxLevels);
 	}
+}
 
-	return status;
+VOID
+TchBklSetLuxTable(
+	IN BKL_CONTEXT* BklContext,
+	IN const BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
+)
+/*++
+
+Routine Description:
+
+	Replaces the lux table of a running backlight context. The current
+	lux level is invalidated so the next light sensor reading is mapped
+	through the new table without hysteresis.
+
+Arguments:
+
+	BklContext - Backlight control context structure
+	LuxTable - validated lux table
+	LuxLevels - number of levels in the table, 1 to BKL_MAX_LEVELS
+
+Return Value:
+
+	None
+
+--*/
+{
+	NT_ASSERT(LuxLevels > 0 && LuxLevels <= BKL_MAX_LEVELS);
+
+	WdfWaitLockAcquire(BklContext->BacklightLock, NULL);
+
+	RtlCopyMemory(
+		BklContext->BklLuxTable,
+		LuxTable,
+		LuxLevels * sizeof(BKL_LUX_TABLE_ENTRY));
+
+	BklContext->BklNumLevels = LuxLevels;
+	BklContext->AlsLuxLevel = LuxLevels;
+
+	WdfWaitLockRelease(BklContext->BacklightLock);
 }
 
 NTSTATUS
@@ -454,6 +559,8 @@ Return Value:
 	DECLARE_CONST_UNICODE_STRING(bklLedIndexListValue, BKL_LED_INDEX_LIST);
 	DECLARE_CONST_UNICODE_STRING(bklSettingsPath, BKL_REGISTRY_PATH);
 	DECLARE_CONST_UNICODE_STRING(bklTimeoutValue, BKL_INACTIVITY_TIMEOUT);
+	DECLARE_CONST_UNICODE_STRING(bklFadeTimeValue, BKL_FADE_TIME);
+	DECLARE_CONST_UNICODE_STRING(bklInterpolateValue, BKL_INTERPOLATE);
 	ULONG i;
 	WDFKEY key;
 	WDFCOLLECTION ledIndexStrings;
@@ -514,6 +621,20 @@ Return Value:
 
 	BklContext->Timeout = value;
 
+	status = WdfRegistryQueryULong(
+		key,
+		&bklFadeTimeValue,
+		&value);
+
+	BklContext->FadeTime = NT_SUCCESS(status) ? value : BKL_DEFAULT_FADE_TIME;
+
+	status = WdfRegistryQueryULong(
+		key,
+		&bklInterpolateValue,
+		&value);
+
+	BklContext->BklInterpolate = (NT_SUCCESS(status) && value != 0);
+
 	status = WdfCollectionCreate(
 		WDF_NO_OBJECT_ATTRIBUTES,
 		&ledIndexStrings);
@@ -620,7 +741,7 @@ exit:
 }
 
 ULONG
-TchBklGetIntensity(
+TchBklGetLuxLevel(
 	IN BKL_CONTEXT* BklContext,
 	IN ULONG LuxValue
 )
@@ -629,7 +750,9 @@ TchBklGetIntensity(
 Routine Description:
 
 	This helper routine takes the current light sensor reading and
-	looks up the corresponding intensity in the lux table.
+	looks up the corresponding level in the lux table. The table is
+	sorted and contiguous from 0 to MAXULONG (see TchBklValidateLuxTable),
+	so a binary search on the range upper bounds always finds a level.
 
 Arguments:
 
@@ -638,203 +761,800 @@ Arguments:
 
 Return Value:
 
-	ULONG representing the percentage of backlight intensity to set
+	ULONG index of the matching lux table entry
 
 --*/
 {
-	ULONG i;
+	ULONG low = 0;
+	ULONG high = BklContext->BklNumLevels - 1;
+	ULONG middle;
 
-	for (i = 0; i < BklContext->BklNumLevels; i++)
+	while (low < high)
 	{
-		if (LuxValue < BklContext->BklLuxTable[i].Max &&
-			LuxValue >= BklContext->BklLuxTable[i].Min)
+		middle = (low + high) / 2;
+
+		if (LuxValue < BklContext->BklLuxTable[middle].Max)
+		{
+			high = middle;
+		}
+		else
 		{
-			return BklContext->BklLuxTable[i].Intensity;
+			low = middle + 1;
 		}
 	}
 
-	return 0;
+	return low;
 }
 
-VOID
-TchBklSetIntensity(
-	BKL_CONTEXT* BklContext,
-	ULONG Intensity
+ULONG
+TchBklGetIntensity(
+	IN BKL_CONTEXT* BklContext,
+	IN ULONG Level,
+	IN ULONG LuxValue
 )
 /*++
 
 Routine Description:
 
-	This helper routine sets any capacitive key backlights to the specified
-	intensity, represented as 0-100%, where 0% corresponds to OFF.
+	Returns the backlight intensity for a reading within a lux level. With
+	interpolation enabled, intensity ramps linearly from the level's own
+	intensity at its lower bound to the next level's intensity at its upper
+	bound, so crossing a level boundary does not step the backlights.
 
 Arguments:
 
 	BklContext - backlight control context structure
-	Intensity - desired intensity from 0-100 (representing percentage)
+	Level - lux table level containing LuxValue
+	LuxValue - current lux value
 
 Return Value:
 
-	NTSTATUS indicating success or failure
+	ULONG representing the percentage of backlight intensity to set
 
 --*/
 {
-	ULONG i;
-	WDF_MEMORY_DESCRIPTOR memory;
-	NTSTATUS status;
+	BKL_LUX_TABLE_ENTRY* entry = &BklContext->BklLuxTable[Level];
+	BKL_LUX_TABLE_ENTRY* next;
 
-	if (BklContext->CurrentBklIntensity == Intensity)
+	if (!BklContext->BklInterpolate ||
+		Level + 1 >= BklContext->BklNumLevels)
 	{
-		return;
+		return entry->Intensity;
 	}
 
-	for (i = 0; i < BklContext->HwnNumLeds; i++)
+	next = &BklContext->BklLuxTable[Level + 1];
+
+	return (ULONG)((LONG64)entry->Intensity +
+		((LONG64)next->Intensity - (LONG64)entry->Intensity) *
+		(LONG64)(LuxValue - entry->Min) /
+		(LONG64)(entry->Max - entry->Min));
+}
+
+NTSTATUS
+TchBklSendHwnState(
+	IN BKL_CONTEXT* BklContext
+)
+/*++
+
+Routine Description:
+
+	Sends the LED settings in HwnConfiguration to the HWN driver using the
+	preallocated request. Only one update is outstanding at a time, the
+	configuration buffer must not be modified until it completes.
+
+Arguments:
+
+	BklContext - backlight control context structure
+
+Return Value:
+
+	NTSTATUS indicating whether the update was sent
+
+--*/
+{
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+	NTSTATUS status;
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(
+		&reuseParams,
+		WDF_REQUEST_REUSE_NO_FLAGS,
+		STATUS_SUCCESS);
+
+	status = WdfRequestReuse(BklContext->HwnRequest, &reuseParams);
+
+	if (!NT_SUCCESS(status))
 	{
-		BklContext->HwnConfiguration->HwNSettingsInfo[i].HwNSettings[HWN_INTENSITY] =
-			Intensity;
-		BklContext->HwnConfiguration->HwNSettingsInfo[i].OffOnBlink =
-			(Intensity == 0) ? HWN_OFF : HWN_ON;
+		goto exit;
 	}
 
-	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-		&memory,
-		BklContext->HwnConfiguration,
-		(ULONG)BklContext->HwnConfigurationSize);
-
-	status = WdfIoTargetSendIoctlSynchronously(
+	status = WdfIoTargetFormatRequestForIoctl(
 		BklContext->HwnIoTarget,
-		NULL,
+		BklContext->HwnRequest,
 		IOCTL_HWN_SET_STATE,
-		&memory,
+		BklContext->HwnMemory,
 		NULL,
 		NULL,
 		NULL);
 
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	WdfRequestSetCompletionRoutine(
+		BklContext->HwnRequest,
+		TchBklOnHwnRequestComplete,
+		BklContext);
+
+	InterlockedExchange(&BklContext->HwnRequestPending, 1);
+
+	if (!WdfRequestSend(
+		BklContext->HwnRequest,
+		BklContext->HwnIoTarget,
+		WDF_NO_SEND_OPTIONS))
+	{
+		InterlockedExchange(&BklContext->HwnRequestPending, 0);
+		status = WdfRequestGetStatus(BklContext->HwnRequest);
+	}
+
+exit:
+
 	if (!NT_SUCCESS(status))
 	{
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_OTHER,
-			"Failed to set new HWN state intensity: %u- STATUS:%X",//ST//
-			Intensity,
+			"Failed to send HWN state update - STATUS:%X",
 			status);
 	}
 
-	BklContext->CurrentBklIntensity = Intensity;
+	return status;
 }
 
 VOID
-TchBklGetLightSensorValue(
-	IN WDFWORKITEM WorkItem
+TchBklOnHwnRequestComplete(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+	IN WDFCONTEXT Context
 )
 /*++
 
 Routine Description:
 
-	This work item polls the ambient light sensor for new readings, which
-	are used to dim/fade capacitive key backlights to a level appropriate
-	for the users eyes.
+	Completion routine for HWN state updates, releases the configuration
+	buffer for the next fade step
 
 Arguments:
 
-	WorkItem - WDFWORKITEM object
+	Request - The HWN request
+	Target - HWN I/O target
+	Params - Completion parameters
+	Context - Backlight control context
 
 Return Value:
 
-	NTSTATUS indicating success or failure
+	None
+
+--*/
+{
+	BKL_CONTEXT* context = (BKL_CONTEXT*)Context;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(Target);
+
+	if (!NT_SUCCESS(Params->IoStatus.Status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Failed to set new HWN state - STATUS:%X",
+			Params->IoStatus.Status);
+	}
+
+	InterlockedExchange(&context->HwnRequestPending, 0);
+}
+
+VOID
+TchBklWriteHwnIntensity(
+	IN BKL_CONTEXT* BklContext,
+	IN ULONG Intensity
+)
+/*++
+
+Routine Description:
+
+	Fills the intensity of every LED into the HWN configuration buffer, so
+	all LEDs move together in a single HWN update
+
+Arguments:
+
+	BklContext - backlight control context structure
+	Intensity - intensity from 0-100 (representing percentage)
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG i;
+
+	for (i = 0; i < BklContext->HwnNumLeds; i++)
+	{
+		BklContext->HwnConfiguration->HwNSettingsInfo[i].HwNSettings[HWN_INTENSITY] =
+			Intensity;
+		BklContext->HwnConfiguration->HwNSettingsInfo[i].OffOnBlink =
+			(Intensity == 0) ? HWN_OFF : HWN_ON;
+	}
+}
+
+VOID
+TchBklFadeStep(
+	IN BKL_CONTEXT* BklContext
+)
+/*++
+
+Routine Description:
+
+	Moves the backlights one step towards the target intensity. The step
+	is interpolated linearly over FadeTime from the intensity the fade
+	started at. The fade timer is re-armed only while the target has not
+	been reached, so nothing ticks once the backlights are idle. Must be
+	called with the backlight lock held.
+
+Arguments:
+
+	BklContext - backlight control context structure
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG elapsed;
+	ULONG intensity;
+
+	//
+	// Once the HWN driver is going away TchBklFlushFade applies the target
+	//
+	if (BklContext->HwnReady == FALSE)
+	{
+		return;
+	}
+
+	//
+	// The previous update still owns the configuration buffer, try again
+	// on the next tick
+	//
+	if (BklContext->HwnRequestPending != 0)
+	{
+		goto rearm;
+	}
+
+	elapsed = (ULONG)GetTickCount() - BklContext->FadeStartTime;
+
+	if (BklContext->FadeTime == 0 || elapsed >= BklContext->FadeTime)
+	{
+		intensity = BklContext->TargetBklIntensity;
+	}
+	else
+	{
+		intensity = (ULONG)((LONG)BklContext->FadeFromIntensity +
+			((LONG)BklContext->TargetBklIntensity -
+				(LONG)BklContext->FadeFromIntensity) *
+			(LONG)elapsed / (LONG)BklContext->FadeTime);
+	}
+
+	if (intensity != BklContext->CurrentBklIntensity)
+	{
+		TchBklWriteHwnIntensity(BklContext, intensity);
+
+		if (NT_SUCCESS(TchBklSendHwnState(BklContext)))
+		{
+			BklContext->CurrentBklIntensity = intensity;
+		}
+	}
+
+rearm:
+
+	if (BklContext->CurrentBklIntensity != BklContext->TargetBklIntensity)
+	{
+		WdfTimerStart(
+			BklContext->FadeTimer,
+			WDF_REL_TIMEOUT_IN_MS(BKL_FADE_TICK));
+	}
+}
+
+VOID
+TchBklOnFadeTimer(
+	IN WDFTIMER Timer
+)
+/*++
+
+Routine Description:
+
+	Fade engine tick
+
+Arguments:
+
+	Timer - Fade timer
+
+Return Value:
+
+	None
+
+--*/
+{
+	BKL_CONTEXT* context;
+
+	context = GetTouchBacklightContext(Timer)->BklContext;
+
+	WdfWaitLockAcquire(context->BacklightLock, NULL);
+
+	TchBklFadeStep(context);
+
+	WdfWaitLockRelease(context->BacklightLock);
+}
+
+VOID
+TchBklFlushFade(
+	IN BKL_CONTEXT* BklContext
+)
+/*++
+
+Routine Description:
+
+	Stops the fade engine and synchronously applies the target intensity,
+	used before the HWN target is torn down. The target is stopped so the
+	in-flight update completes and no new one can be sent.
+
+Arguments:
+
+	BklContext - backlight control context structure
+
+Return Value:
+
+	None
+
+--*/
+{
+	WDF_MEMORY_DESCRIPTOR memory;
+	WDF_REQUEST_SEND_OPTIONS options;
+	NTSTATUS status;
+
+	WdfTimerStop(BklContext->FadeTimer, TRUE);
+	WdfIoTargetStop(BklContext->HwnIoTarget, WdfIoTargetWaitForSentIoToComplete);
+
+	WdfWaitLockAcquire(BklContext->BacklightLock, NULL);
+
+	if (BklContext->CurrentBklIntensity != BklContext->TargetBklIntensity)
+	{
+		TchBklWriteHwnIntensity(BklContext, BklContext->TargetBklIntensity);
+
+		WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+			&memory,
+			BklContext->HwnConfiguration,
+			(ULONG)BklContext->HwnConfigurationSize);
+
+		WDF_REQUEST_SEND_OPTIONS_INIT(
+			&options,
+			WDF_REQUEST_SEND_OPTION_IGNORE_TARGET_STATE);
+
+		status = WdfIoTargetSendIoctlSynchronously(
+			BklContext->HwnIoTarget,
+			NULL,
+			IOCTL_HWN_SET_STATE,
+			&memory,
+			NULL,
+			&options,
+			NULL);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_OTHER,
+				"Failed to set new HWN state intensity: %u- STATUS:%X",
+				BklContext->TargetBklIntensity,
+				status);
+		}
+
+		BklContext->CurrentBklIntensity = BklContext->TargetBklIntensity;
+	}
+
+	WdfWaitLockRelease(BklContext->BacklightLock);
+}
+
+VOID
+TchBklSetIntensity(
+	BKL_CONTEXT* BklContext,
+	ULONG Intensity
+)
+/*++
+
+Routine Description:
+
+	This helper routine fades any capacitive key backlights to the specified
+	intensity, represented as 0-100%, where 0% corresponds to OFF.
+
+Arguments:
+
+	BklContext - backlight control context structure
+	Intensity - desired intensity from 0-100 (representing percentage)
+
+Return Value:
+
+	None
+
+--*/
+{
+	if (BklContext->TargetBklIntensity == Intensity)
+	{
+		return;
+	}
+
+	//
+	// A new fade starts from wherever the previous one got to
+	//
+	BklContext->FadeFromIntensity = BklContext->CurrentBklIntensity;
+	BklContext->TargetBklIntensity = Intensity;
+	BklContext->FadeStartTime = (ULONG)GetTickCount();
+
+	TchBklFadeStep(BklContext);
+}
+
+VOID
+TchBklUpdateIntensity(
+	IN BKL_CONTEXT* BklContext,
+	IN ULONG LuxValue
+)
+/*++
+
+Routine Description:
+
+	Maps a new light sensor reading to a backlight intensity. A reading
+	must leave the current lux band (or, when interpolating, move away
+	from the last applied reading) by BKL_LUX_HYSTERESIS_PERCENT before
+	the intensity changes, and intensity changes are at least
+	BKL_MIN_UPDATE_INTERVAL apart, so a flickering light source does not
+	translate into a stream of HWN requests.
+
+Arguments:
+
+	BklContext - backlight control context structure
+	LuxValue - current lux value
+
+Return Value:
+
+	None
+
+--*/
+{
+	BKL_LUX_TABLE_ENTRY* entry;
+	ULONG intensity;
+	ULONG level;
+	ULONG lower;
+	ULONG upper;
+	ULONG now;
+
+	now = (ULONG)GetTickCount();
+
+	if (BklContext->AlsLuxLevel < BklContext->BklNumLevels)
+	{
+		//
+		// Stepped tables hold a level until the reading leaves its band,
+		// interpolated tables until the reading moves away from the last
+		// reading applied
+		//
+		if (BklContext->BklInterpolate)
+		{
+			lower = BklContext->AlsLux;
+			upper = BklContext->AlsLux;
+		}
+		else
+		{
+			entry = &BklContext->BklLuxTable[BklContext->AlsLuxLevel];
+			lower = entry->Min;
+			upper = entry->Max;
+		}
+
+		lower -= (lower / 100) * BKL_LUX_HYSTERESIS_PERCENT;
+		upper += min(
+			(upper / 100) * BKL_LUX_HYSTERESIS_PERCENT,
+			MAXULONG - upper);
+
+		if (LuxValue >= lower && LuxValue <= upper)
+		{
+			return;
+		}
+
+		if (now - BklContext->LastIntensityUpdateTime < BKL_MIN_UPDATE_INTERVAL)
+		{
+			return;
+		}
+	}
+
+	level = TchBklGetLuxLevel(BklContext, LuxValue);
+	intensity = TchBklGetIntensity(BklContext, level, LuxValue);
+
+	BklContext->AlsLuxLevel = level;
+	BklContext->AlsLux = LuxValue;
+
+	if (intensity == BklContext->TargetBklIntensity)
+	{
+		return;
+	}
+
+	BklContext->LastIntensityUpdateTime = now;
+
+	TchBklSetIntensity(BklContext, intensity);
+}
+
+NTSTATUS
+TchBklStartAlsRead(
+	IN BKL_CONTEXT* BklContext
+)
+/*++
+
+Routine Description:
+
+	Sends the preallocated read request to the ALS driver. The read is
+	held by the sensor for the configured sampling interval and completes
+	to TchBklOnAlsReadComplete. Must be called with the backlight lock held.
+
+Arguments:
+
+	BklContext - backlight control context structure
+
+Return Value:
+
+	NTSTATUS indicating whether the read was sent
+
+--*/
+{
+	WDF_REQUEST_REUSE_PARAMS reuseParams;
+	NTSTATUS status;
+
+	status = STATUS_SUCCESS;
+
+	if (BklContext->AlsReadPending)
+	{
+		goto exit;
+	}
+
+	WDF_REQUEST_REUSE_PARAMS_INIT(
+		&reuseParams,
+		WDF_REQUEST_REUSE_NO_FLAGS,
+		STATUS_SUCCESS);
+
+	status = WdfRequestReuse(BklContext->AlsReadRequest, &reuseParams);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfIoTargetFormatRequestForRead(
+		BklContext->AlsIoTarget,
+		BklContext->AlsReadRequest,
+		BklContext->AlsReadMemory,
+		NULL,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	WdfRequestSetCompletionRoutine(
+		BklContext->AlsReadRequest,
+		TchBklOnAlsReadComplete,
+		BklContext);
+
+	BklContext->AlsReadPending = TRUE;
+
+	if (!WdfRequestSend(
+		BklContext->AlsReadRequest,
+		BklContext->AlsIoTarget,
+		WDF_NO_SEND_OPTIONS))
+	{
+		BklContext->AlsReadPending = FALSE;
+		status = WdfRequestGetStatus(BklContext->AlsReadRequest);
+	}
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Could not send ALS read request - STATUS:%X",
+			status);
+
+		BklContext->AlsStatus = status;
+
+		WdfTimerStart(
+			BklContext->AlsRetryTimer,
+			WDF_REL_TIMEOUT_IN_MS(BKL_ALS_RETRY_INTERVAL));
+	}
+
+	return status;
+}
+
+VOID
+TchBklOnAlsReadComplete(
+	IN WDFREQUEST Request,
+	IN WDFIOTARGET Target,
+	IN PWDF_REQUEST_COMPLETION_PARAMS Params,
+	IN WDFCONTEXT Context
+)
+/*++
+
+Routine Description:
+
+	Completion routine for ALS reads. It may run at dispatch level, so the
+	sample is processed from the ALS work item.
+
+Arguments:
+
+	Request - The ALS read request
+	Target - ALS I/O target
+	Params - Completion parameters
+	Context - Backlight control context
+
+Return Value:
+
+	None
+
+--*/
+{
+	BKL_CONTEXT* context = (BKL_CONTEXT*)Context;
+
+	UNREFERENCED_PARAMETER(Request);
+	UNREFERENCED_PARAMETER(Target);
+	UNREFERENCED_PARAMETER(Params);
+
+	WdfWorkItemEnqueue(context->TchBklPollAlsWorkItem);
+}
+
+VOID
+TchBklOnAlsRetryTimer(
+	IN WDFTIMER Timer
+)
+/*++
+
+Routine Description:
+
+	Re-issues the ALS read after the sensor reported an error
+
+Arguments:
+
+	Timer - ALS retry timer
+
+Return Value:
+
+	None
+
+--*/
+{
+	BKL_CONTEXT* context;
+	WORKITEM_CONTEXT* timerContext;
+
+	timerContext = GetTouchBacklightContext(Timer);
+	context = timerContext->BklContext;
+
+	WdfWaitLockAcquire(context->BacklightLock, NULL);
+
+	if (context->TchBklPollAls == TRUE)
+	{
+		TchBklStartAlsRead(context);
+	}
+
+	WdfWaitLockRelease(context->BacklightLock);
+}
+
+VOID
+TchBklGetLightSensorValue(
+	IN WDFWORKITEM WorkItem
+)
+/*++
+
+Routine Description:
+
+	This work item processes a completed ambient light sensor read, which
+	is used to dim/fade capacitive key backlights to a level appropriate
+	for the users eyes, and then sends the next read.
+
+Arguments:
+
+	WorkItem - WDFWORKITEM object
+
+Return Value:
+
+	None
 
 --*/
 {
 	BKL_CONTEXT* context;
-	ULONG intensity;
-	WDF_MEMORY_DESCRIPTOR memory;
 	NTSTATUS status;
 	WORKITEM_CONTEXT* workItemContext;
 
 	workItemContext = GetTouchBacklightContext(WorkItem);
 	context = workItemContext->BklContext;
 
+	WdfWaitLockAcquire(context->BacklightLock, NULL);
+
+	context->AlsReadPending = FALSE;
+	status = WdfRequestGetStatus(context->AlsReadRequest);
+
 	//
-	// Get an ALS sample. Note the read will be held for the sampling interval
-	// that we've configured, so it is not necessary to sleep/wait here. 
+	// Did we turn off the backlights while waiting?
 	//
-	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-		&memory,
-		&context->AlsData,
-		sizeof(ALS_DATA));
+	if (context->TchBklPollAls == FALSE)
+	{
+		goto exit;
+	}
 
-	while (context->TchBklPollAls == TRUE)
+	if (!NT_SUCCESS(status))
 	{
-		status = WdfIoTargetSendReadSynchronously(
-			context->AlsIoTarget,
-			NULL,
-			&memory,
-			NULL,
-			NULL,
-			NULL);
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Als driver reported error getting data - STATUS:%X",
+			status);
 
-		if (!NT_SUCCESS(status))
-		{
-			Trace(
-				TRACE_LEVEL_ERROR,
-				TRACE_FLAG_OTHER,
-				"Als driver reported error getting data - STATUS:%X",
-				status);
+		context->AlsStatus = status;
 
-			context->AlsStatus = status;
-			TchBklSleepMillisec(BKL_ALS_SAMPLING_INTERVAL);
+		WdfTimerStart(
+			context->AlsRetryTimer,
+			WDF_REL_TIMEOUT_IN_MS(BKL_ALS_RETRY_INTERVAL));
 
-			continue;
-		}
+		goto exit;
+	}
 
 #ifdef ALS_BACKLIGHT_DEBUG
-		Trace(
-			TRACE_LEVEL_INFORMATION,
-			TRACE_FLAG_OTHER,
-			"ALS reading of %d lux",
-			context->AlsData.Sample);
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_OTHER,
+		"ALS reading of %d lux",
+		context->AlsData.Sample);
 #endif
 
-
+	//
+	// Do we have a timeout enabled, which has expired?
+	//
+	if (context->Timeout != 0 &&
+		(ULONG)GetTickCount() - (ULONG)context->LastInputTime > context->Timeout)
+	{
 		//
-		// Did we turn off the backlights while waiting?
+		// Turn off backlights
 		//
-		if (context->TchBklPollAls == FALSE)
+		if (!NT_SUCCESS(TchBklEnable(context, FALSE)))
 		{
-			return;
-		}
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_OTHER,
+				"Error disabling backlights, may be stuck on!");
 
-		//
-		// Do we have a timeout enabled, which has expired?
-		//
-		if (context->Timeout != 0 &&
-			GetTickCount() - context->LastInputTime > context->Timeout)
-		{
-			//
-			// Turn off backlights
-			//
-			WdfWaitLockAcquire(context->BacklightLock, NULL);
-
-			if (!NT_SUCCESS(TchBklEnable(context, FALSE)))
-			{
-				Trace(
-					TRACE_LEVEL_ERROR,
-					TRACE_FLAG_OTHER,
-					"Error disabling backlights, may be stuck on!");
-
-				NT_ASSERT(FALSE);
-			}
-
-			WdfWaitLockRelease(context->BacklightLock);
-			continue;
+			NT_ASSERT(FALSE);
 		}
 
-		//
-		// Initiate an intensity change if necessary
-		//
-		intensity = TchBklGetIntensity(context, context->AlsData.Sample);
-		TchBklSetIntensity(context, intensity);
+		goto exit;
 	}
+
+	//
+	// Initiate an intensity change if necessary
+	//
+	TchBklUpdateIntensity(context, context->AlsData.Sample);
+
+	TchBklStartAlsRead(context);
+
+exit:
+
+	WdfWaitLockRelease(context->BacklightLock);
 }
 
 NTSTATUS
@@ -881,7 +1601,9 @@ Return Value:
 		//
 		if (BklContext->Timeout != 0)
 		{
-			BklContext->LastInputTime = (ULONG)GetTickCount();
+			InterlockedExchange(
+				&BklContext->LastInputTime,
+				(LONG)GetTickCount());
 		}
 
 		//
@@ -960,23 +1682,31 @@ Return Value:
 		// readings will adjust the intensity afterwards.
 		//
 		TchBklSetIntensity(BklContext, BKL_DEFAULT_INTENSITY);
+		BklContext->AlsLuxLevel = BklContext->BklNumLevels;
 
 		//
-		// Kick off a work item to continuously monitor ambient light 
+		// Keep a read pending on the ALS to monitor ambient light 
 		// changes and adjust the backlight intensity accordingly
 		//
 		BklContext->TchBklPollAls = TRUE;
 
-
-		WdfWorkItemEnqueue(BklContext->TchBklPollAlsWorkItem);
+		status = TchBklStartAlsRead(BklContext);
 	}
 	else
 	{
 		//
-		// Stop the ALS sensor
+		// Stop the ALS sensor, an outstanding read is cancelled and its
+		// completion ignored by the work item
 		//
 		BklContext->TchBklPollAls = FALSE;
 
+		WdfTimerStop(BklContext->AlsRetryTimer, FALSE);
+
+		if (BklContext->AlsReadPending)
+		{
+			WdfRequestCancelSentRequest(BklContext->AlsReadRequest);
+		}
+
 		status = WdfIoTargetSendIoctlSynchronously(
 			BklContext->AlsIoTarget,
 			NULL,
@@ -1030,6 +1760,7 @@ Return Value:
 
 --*/
 {
+	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_IO_TARGET_OPEN_PARAMS openParams;
 	NTSTATUS status;
 
@@ -1095,6 +1826,43 @@ Return Value:
 			goto exit;
 		}
 
+		//
+		// Preallocate the read request used to stream ALS samples, it is
+		// reused for every read and deleted along with the I/O target
+		//
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = BklContext->AlsIoTarget;
+
+		status = WdfRequestCreate(
+			&attributes,
+			BklContext->AlsIoTarget,
+			&BklContext->AlsReadRequest);
+
+		if (NT_SUCCESS(status))
+		{
+			WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+			attributes.ParentObject = BklContext->AlsReadRequest;
+
+			status = WdfMemoryCreatePreallocated(
+				&attributes,
+				&BklContext->AlsData,
+				sizeof(ALS_DATA),
+				&BklContext->AlsReadMemory);
+		}
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_OTHER,
+				"Error: Could not allocate ALS read request - STATUS:%X",
+				status);
+
+			WdfObjectDelete(BklContext->AlsIoTarget);
+			BklContext->AlsIoTarget = NULL;
+			goto exit;
+		}
+
 		//
 		// Enable the backlight if both ALS and HWN are ready
 		//
@@ -1150,12 +1918,22 @@ Return Value:
 
 		WdfWaitLockRelease(BklContext->BacklightLock);
 
+		//
+		// Wait for the cancelled read to complete and its work item to
+		// run before the request goes away with the target
+		//
+		WdfTimerStop(BklContext->AlsRetryTimer, TRUE);
+		WdfIoTargetStop(BklContext->AlsIoTarget, WdfIoTargetCancelSentIo);
+		WdfWorkItemFlush(BklContext->TchBklPollAlsWorkItem);
+
 		//
 		// Deleting the object will close the I/O target if it's not already 
 		// invalid.
 		//
 		WdfObjectDelete(BklContext->AlsIoTarget);
 		BklContext->AlsIoTarget = NULL;
+		BklContext->AlsReadRequest = NULL;
+		BklContext->AlsReadMemory = NULL;
 	}
 
 	return STATUS_SUCCESS;
@@ -1183,6 +1961,7 @@ Return Value:
 
 --*/
 {
+	WDF_OBJECT_ATTRIBUTES attributes;
 	ULONG i;
 	WDF_IO_TARGET_OPEN_PARAMS openParams;
 	NTSTATUS status;
@@ -1267,6 +2046,41 @@ Return Value:
 		BklContext->HwnConfiguration->HwNSettingsInfo[i].HwNSettings[HWN_INTENSITY] = 100;
 	}
 
+	//
+	// Preallocate the request and memory used for asynchronous updates,
+	// both are deleted along with the I/O target
+	//
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = BklContext->HwnIoTarget;
+
+	status = WdfRequestCreate(
+		&attributes,
+		BklContext->HwnIoTarget,
+		&BklContext->HwnRequest);
+
+	if (NT_SUCCESS(status))
+	{
+		WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+		attributes.ParentObject = BklContext->HwnRequest;
+
+		status = WdfMemoryCreatePreallocated(
+			&attributes,
+			BklContext->HwnConfiguration,
+			BklContext->HwnConfigurationSize,
+			&BklContext->HwnMemory);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Error: Could not allocate HWN request - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
 	//
 	// Enable the backlight if both ALS and HWN are ready
 	//
@@ -1317,12 +2131,22 @@ Return Value:
 
 	WdfWaitLockRelease(BklContext->BacklightLock);
 
+	//
+	// Finish the fade out before the target goes away
+	//
+	if (BklContext->HwnRequest != NULL)
+	{
+		TchBklFlushFade(BklContext);
+	}
+
 	//
 	// Deleting the object will close the I/O target if it's not already 
 	// invalid.
 	//
 	WdfObjectDelete(BklContext->HwnIoTarget);
 	BklContext->HwnIoTarget = NULL;
+	BklContext->HwnRequest = NULL;
+	BklContext->HwnMemory = NULL;
 
 	//
 	// Free HWN related pool allocations
@@ -1424,8 +2248,9 @@ TchOnMonitorStateChange(
 
 Routine Description:
 
-	This callback is invoked on monitor state changes. Here we turn on/off
-	adaptive capacitive button backlighting based on the monitor state.
+	Passed monitor state changes by TchOnDisplayStateChange. Here we turn
+	on/off adaptive capacitive button backlighting based on the monitor
+	state.
 
 Arguments:
 
@@ -1490,7 +2315,9 @@ exit:
 
 BKL_CONTEXT*
 TchBklInitialize(
-	IN WDFDEVICE FxDevice
+	IN WDFDEVICE FxDevice,
+	IN const BKL_LUX_TABLE_ENTRY* LuxTable,
+	IN ULONG LuxLevels
 )
 /*++
 
@@ -1501,6 +2328,8 @@ Routine Description:
 Arguments:
 
 	FxDevice - Framework device object for this device instance
+	LuxTable - validated lux table from the controller configuration
+	LuxLevels - number of levels in the table
 
 Return Value:
 
@@ -1510,6 +2339,7 @@ Return Value:
 {
 	WDF_OBJECT_ATTRIBUTES attributes;
 	WDF_WORKITEM_CONFIG config;
+	WDF_TIMER_CONFIG timerConfig;
 	BKL_CONTEXT* context;
 	NTSTATUS status;
 	WORKITEM_CONTEXT* workItemContext;
@@ -1541,7 +2371,7 @@ Return Value:
 	context->FxDevice = FxDevice;
 	context->HwnReady = FALSE;
 	context->AlsReady = FALSE;
-	context->LastInputTime = (ULONG)GetTickCount();
+	context->LastInputTime = (LONG)GetTickCount();
 
 	status = WdfWaitLockCreate(
 		WDF_NO_OBJECT_ATTRIBUTES,
@@ -1575,7 +2405,7 @@ Return Value:
 	}
 
 	//
-	// Allocate a work item which will poll the ALS sensor for light changes
+	// Allocate a work item which processes ALS samples as reads complete
 	//
 	WDF_WORKITEM_CONFIG_INIT(&config, TchBklGetLightSensorValue);
 	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
@@ -1603,24 +2433,102 @@ Return Value:
 	workItemContext->BklContext = context;
 
 	//
-	// Read the Milliux <-> Intensity table from the registry
+	// Allocate a passive level timer used to retry failed ALS reads
 	//
-	status = TchBklGetCustomLuxIntensityMap(context);
+	WDF_TIMER_CONFIG_INIT(&timerConfig, TchBklOnAlsRetryTimer);
+	timerConfig.AutomaticSerialization = FALSE;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&attributes, WORKITEM_CONTEXT);
+	attributes.ParentObject = context->FxDevice;
+	attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfTimerCreate(
+		&timerConfig,
+		&attributes,
+		&context->AlsRetryTimer);
 
 	if (!NT_SUCCESS(status))
 	{
 		Trace(
-			TRACE_LEVEL_WARNING,
+			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_OTHER,
-			"Warning, no platform-configured lux mapping table in registry - STATUS:%X",
-			status);//ST//
+			"Could not create WDFTIMER object - STATUS:%X",
+			status);
 
-		//
-		// And grab the default table if it's not specified or specified wrong
-		//
-		TchBklGetDefaultLuxIntensityMap(context);
+		goto exit;
+	}
+
+	GetTouchBacklightContext(context->AlsRetryTimer)->BklContext = context;
+
+	//
+	// Allocate a passive level timer which drives backlight fades
+	//
+	WDF_TIMER_CONFIG_INIT(&timerConfig, TchBklOnFadeTimer);
+	timerConfig.AutomaticSerialization = FALSE;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&attributes, WORKITEM_CONTEXT);
+	attributes.ParentObject = context->FxDevice;
+	attributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfTimerCreate(
+		&timerConfig,
+		&attributes,
+		&context->FadeTimer);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Could not create WDFTIMER object - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	GetTouchBacklightContext(context->FadeTimer)->BklContext = context;
+
+	//
+	// Allocate a work item which re-enables timed out backlights on touch
+	//
+	WDF_WORKITEM_CONFIG_INIT(&config, TchBklReenableWorkItem);
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	WDF_OBJECT_ATTRIBUTES_SET_CONTEXT_TYPE(&attributes, WORKITEM_CONTEXT);
+	attributes.ParentObject = context->FxDevice;
+
+	status = WdfWorkItemCreate(
+		&config,
+		&attributes,
+		&context->ReenableWorkItem);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Could not create WDFWORKITEM object - STATUS:%X",
+			status);
+
+		goto exit;
 	}
 
+	GetTouchBacklightContext(context->ReenableWorkItem)->BklContext = context;
+
+	//
+	// The Millilux <-> Intensity table was read with the rest of the
+	// controller configuration
+	//
+	NT_ASSERT(LuxLevels > 0 && LuxLevels <= BKL_MAX_LEVELS);
+
+	RtlCopyMemory(
+		context->BklLuxTable,
+		LuxTable,
+		LuxLevels * sizeof(BKL_LUX_TABLE_ENTRY));
+
+	context->BklNumLevels = LuxLevels;
+
 	//
 	// Check for the HWN driver to become available (if not already)
 	//
@@ -1667,30 +2575,6 @@ Return Value:
 		goto exit;
 	}
 
-	//
-	// Register for monitor state changes (used to illuminate and deluminate
-	// the capacitive buttons). As D-state changes may not coincide with 
-	// monitor state changes.
-	//
-	status = PoRegisterPowerSettingCallback(
-		WdfDeviceWdmGetDeviceObject(FxDevice),
-		&GUID_MONITOR_POWER_ON,
-		TchOnMonitorStateChange,
-		(PVOID)context,
-		&context->MonitorChangeNotificationHandle);
-
-	if (!NT_SUCCESS(status))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_OTHER,
-			"Could not register for monitor state changes - STATUS:%X",
-			status);
-
-		goto exit;
-	}
-
-
 exit:
 
 	if (!NT_SUCCESS(status))
@@ -1731,16 +2615,6 @@ Return Value:
 	//
 	BklContext->Timeout = 0;
 
-	//
-	// Deregister for monitor state notifications
-	//
-	if (BklContext->MonitorChangeNotificationHandle != NULL)
-	{
-		PoUnregisterPowerSettingCallback(
-			BklContext->MonitorChangeNotificationHandle);
-		BklContext->MonitorChangeNotificationHandle = NULL;
-	}
-
 	//
 	// Cut the lights
 	//
@@ -1783,12 +2657,34 @@ Return Value:
 	}
 
 	//
-	// Deallocate Lux table if allocated
+	// Nothing may reference the context once it is freed
 	//
-	if (BklContext->BklLuxTable != NULL)
+	if (BklContext->AlsRetryTimer != NULL)
+	{
+		WdfTimerStop(BklContext->AlsRetryTimer, TRUE);
+		WdfObjectDelete(BklContext->AlsRetryTimer);
+		BklContext->AlsRetryTimer = NULL;
+	}
+
+	if (BklContext->FadeTimer != NULL)
+	{
+		WdfTimerStop(BklContext->FadeTimer, TRUE);
+		WdfObjectDelete(BklContext->FadeTimer);
+		BklContext->FadeTimer = NULL;
+	}
+
+	if (BklContext->ReenableWorkItem != NULL)
+	{
+		WdfWorkItemFlush(BklContext->ReenableWorkItem);
+		WdfObjectDelete(BklContext->ReenableWorkItem);
+		BklContext->ReenableWorkItem = NULL;
+	}
+
+	if (BklContext->TchBklPollAlsWorkItem != NULL)
 	{
-		ExFreePoolWithTag(BklContext->BklLuxTable, TOUCH_POOL_TAG);
-		BklContext->BklLuxTable = NULL;
+		WdfWorkItemFlush(BklContext->TchBklPollAlsWorkItem);
+		WdfObjectDelete(BklContext->TchBklPollAlsWorkItem);
+		BklContext->TchBklPollAlsWorkItem = NULL;
 	}
 
 	//
@@ -1816,47 +2712,45 @@ Return Value:
 }
 
 VOID
-TchBklNotifyTouchActivity(
-	IN BKL_CONTEXT* BklContext,
-	IN DWORD Time
+TchBklReenableWorkItem(
+	IN WDFWORKITEM WorkItem
 )
 /*++
 
 Routine Description:
 
-	Re-enables the backlights if they timed out and the user touched the screen
+	Turns backlights that timed out back on after touch activity. Runs
+	outside the touch path so HWN and ALS I/O never delay input reports.
 
 Arguments:
 
-	BklContext - Backlight control context
-	Time - Time of user input (touch or button)
+	WorkItem - WDFWORKITEM object
 
 Return Value:
 
-	None.
+	None
 
 --*/
 {
+	BKL_CONTEXT* context;
 	NTSTATUS status;
+	WORKITEM_CONTEXT* workItemContext;
 
-	//
-	// If no backlights are controlled or no timeout is specified, ignore
-	//
-	if ((BklContext == NULL) || (BklContext->Timeout == 0))
-	{
-		return;
-	}
+	workItemContext = GetTouchBacklightContext(WorkItem);
+	context = workItemContext->BklContext;
 
-	BklContext->LastInputTime = Time;
+	WdfWaitLockAcquire(context->BacklightLock, NULL);
 
 	//
-	// If ALS monitoring is disabled, re-enable it
+	// Activity after this point queues the work item again if needed
 	//
-	if (BklContext->TchBklPollAls == FALSE)
+	InterlockedExchange(&context->ReenablePending, 0);
+
+	if (context->TchBklPollAls == FALSE)
 	{
-		WdfWaitLockAcquire(BklContext->BacklightLock, NULL);
+		context->ReenableCount++;
 
-		status = TchBklEnable(BklContext, TRUE);
+		status = TchBklEnable(context, TRUE);
 
 		if (!NT_SUCCESS(status))
 		{
@@ -1867,7 +2761,53 @@ Return Value:
 
 			NT_ASSERT(FALSE);
 		}
+	}
 
-		WdfWaitLockRelease(BklContext->BacklightLock);
+	WdfWaitLockRelease(context->BacklightLock);
+}
+
+VOID
+TchBklNotifyTouchActivity(
+	IN BKL_CONTEXT* BklContext,
+	IN DWORD Time
+)
+/*++
+
+Routine Description:
+
+	Records user activity and re-enables the backlights if they timed out.
+	Called from the touch path, so it only stores the timestamp and at
+	most queues a work item; it never blocks.
+
+Arguments:
+
+	BklContext - Backlight control context
+	Time - Time of user input (touch or button)
+
+Return Value:
+
+	None.
+
+--*/
+{
+	//
+	// If no backlights are controlled or no timeout is specified, ignore
+	//
+	if ((BklContext == NULL) || (BklContext->Timeout == 0))
+	{
+		return;
+	}
+
+	InterlockedExchange(&BklContext->LastInputTime, (LONG)Time);
+
+	//
+	// If ALS monitoring is disabled, re-enable it. A stale read of the
+	// polling flag at worst queues a work item that finds nothing to do.
+	//
+	if (BklContext->TchBklPollAls == FALSE &&
+		InterlockedCompareExchange(&BklContext->ReenablePending, 1, 0) == 0)
+	{
+		InterlockedIncrement(&BklContext->ReenableRequests);
+		WdfWorkItemEnqueue(BklContext->ReenableWorkItem);
 	}
 }
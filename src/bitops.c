@@ -2,135 +2,106 @@
 #include <wdm.h>
 #include <wdf.h>
 #include <bitops.h>
-#include <hweight.h>
 
-void bitmap_set(unsigned long* map, unsigned int start, int len)
+VOID bitmap_set(BITMAP_WORD* Map, ULONG Start, ULONG Len)
 {
-	unsigned long* p = map + BIT_WORD(start);
-	const unsigned int size = start + len;
-	int bits_to_set = BITS_PER_LONG - (start % BITS_PER_LONG);
-	unsigned long mask_to_set = BITMAP_FIRST_WORD_MASK(start);//c4146 maybe need change to signed?
+	BITMAP_WORD* p = Map + BIT_WORD(Start);
+	const ULONG size = Start + Len;
+	ULONG bits_to_set = BITS_PER_BITMAP_WORD - (Start % BITS_PER_BITMAP_WORD);
+	BITMAP_WORD mask_to_set = BITMAP_FIRST_WORD_MASK(Start);
 
-	while (len - bits_to_set >= 0)
+	while (Len >= bits_to_set)
 	{
 		*p |= mask_to_set;
-		len -= bits_to_set;
-		bits_to_set = BITS_PER_LONG;
-		mask_to_set = ~0UL;
+		Len -= bits_to_set;
+		bits_to_set = BITS_PER_BITMAP_WORD;
+		mask_to_set = BITMAP_WORD_MAX;
 		p++;
 	}
 
-	if (len)
+	if (Len)
 	{
 		mask_to_set &= BITMAP_LAST_WORD_MASK(size);
 		*p |= mask_to_set;
 	}
 }
 
-int bitmap_weight(const unsigned long* bitmap, unsigned int bits)//c4146 maybe need change to signed?
+BOOLEAN bitmap_empty(const BITMAP_WORD* Map, ULONG Bits)
 {
-	unsigned int k, lim = bits / BITS_PER_LONG;
-	int w = 0;
+	ULONG k, lim = Bits / BITS_PER_BITMAP_WORD;
 
 	for (k = 0; k < lim; k++)
-		w += hweight_long(bitmap[k]);
+		if (Map[k])
+			return FALSE;
 
-	if (bits % BITS_PER_LONG)
-		w += hweight_long(bitmap[k] & BITMAP_LAST_WORD_MASK(bits));
+	if (Bits % BITS_PER_BITMAP_WORD)
+		if (Map[k] & BITMAP_LAST_WORD_MASK(Bits))
+			return FALSE;
 
-	return w;
+	return TRUE;
 }
 
-static inline unsigned long __ffs(unsigned long word)
+BOOLEAN bitmap_equal(const BITMAP_WORD* Map1, const BITMAP_WORD* Map2, ULONG Bits)
 {
-	int num = 0;
+	ULONG k, lim = Bits / BITS_PER_BITMAP_WORD;
 
-#if defined(ARM64) || defined(AMD64)
-	if ((word & 0xffffffff) == 0)
-	{
-		num += 32;
-		word >>= 32;
-	}
-#endif
-	if ((word & 0xffff) == 0)
-	{
-		num += 16;
-		word >>= 16;
-	}
-	if ((word & 0xff) == 0)
-	{
-		num += 8;
-		word >>= 8;
-	}
-	if ((word & 0xf) == 0)
-	{
-		num += 4;
-		word >>= 4;
-	}
-	if ((word & 0x3) == 0)
-	{
-		num += 2;
-		word >>= 2;
-	}
-	if ((word & 0x1) == 0)
-		num += 1;
-	return num;
+	for (k = 0; k < lim; k++)
+		if (Map1[k] != Map2[k])
+			return FALSE;
+
+	if (Bits % BITS_PER_BITMAP_WORD)
+		if ((Map1[k] ^ Map2[k]) & BITMAP_LAST_WORD_MASK(Bits))
+			return FALSE;
+
+	return TRUE;
 }
 
-unsigned long find_first_bit(const unsigned long* addr, unsigned long size)
+ULONG bitmap_weight(const BITMAP_WORD* Map, ULONG Bits)
 {
-	unsigned long idx;
+	ULONG k, lim = Bits / BITS_PER_BITMAP_WORD;
+	ULONG w = 0;
+
+	for (k = 0; k < lim; k++)
+		w += bitmap_word_weight(Map[k]);
+
+	if (Bits % BITS_PER_BITMAP_WORD)
+		w += bitmap_word_weight(Map[k] & BITMAP_LAST_WORD_MASK(Bits));
+
+	return w;
+}
 
-	for (idx = 0; idx * BITS_PER_LONG < size; idx++)
+ULONG find_first_bit(const BITMAP_WORD* Map, ULONG Size)
+{
+	ULONG idx;
+
+	for (idx = 0; idx * BITS_PER_BITMAP_WORD < Size; idx++)
 	{
-		if (addr[idx])
-			return min(idx * BITS_PER_LONG + __ffs(addr[idx]), size);
+		if (Map[idx])
+			return min(idx * BITS_PER_BITMAP_WORD + bitmap_word_ffs(Map[idx]), Size);
 	}
 
-	return size;
+	return Size;
 }
 
-/*
-* This is a common helper function for find_next_bit, find_next_zero_bit, and
-* find_next_and_bit. The differences are:
-*  - The "invert" argument, which is XORed with each fetched word before
-*    searching it for one bits.
-*  - The optional "addr2", which is anded with "addr1" if present.
-*/
-static inline unsigned long _find_next_bit(const unsigned long* addr1,
-	const unsigned long* addr2, unsigned long nbits,
-	unsigned long start, unsigned long invert)
+ULONG find_next_bit(const BITMAP_WORD* Map, ULONG Size, ULONG Offset)
 {
-	unsigned long tmp;
-
-	if (start >= nbits) return nbits;
+	BITMAP_WORD tmp;
 
-	tmp = addr1[start / BITS_PER_LONG];
-	if (addr2)
-		tmp &= addr2[start / BITS_PER_LONG];
-	tmp ^= invert;
+	if (Offset >= Size)
+		return Size;
 
 	/* Handle 1st word. */
-	tmp &= BITMAP_FIRST_WORD_MASK(start);
-	start = round_down_ul(start, BITS_PER_LONG);
+	tmp = Map[BIT_WORD(Offset)] & BITMAP_FIRST_WORD_MASK(Offset);
+	Offset -= Offset % BITS_PER_BITMAP_WORD;
 
 	while (!tmp)
 	{
-		start += BITS_PER_LONG;
-		if (start >= nbits)
-			return nbits;
-
-		tmp = addr1[start / BITS_PER_LONG];
-		if (addr2)
-			tmp &= addr2[start / BITS_PER_LONG];
-		tmp ^= invert;
+		Offset += BITS_PER_BITMAP_WORD;
+		if (Offset >= Size)
+			return Size;
+
+		tmp = Map[BIT_WORD(Offset)];
 	}
 
-	return min(start + __ffs(tmp), nbits);
+	return min(Offset + bitmap_word_ffs(tmp), Size);
 }
-
-unsigned long find_next_bit(const unsigned long* addr, unsigned long size,
-	unsigned long offset)
-{
-	return _find_next_bit(addr, NULL, size, offset, 0UL);
-}
\ No newline at end of file
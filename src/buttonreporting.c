@@ -33,7 +33,8 @@ RmiServiceCapacitiveButtonInterrupt(
 Routine Description:
 
 	This routine services capacitive button (F$1A) interrupts, it reads
-	button data and fills a HID keyboard report with the relevant information
+	button data and feeds it to the button state machines, which queue
+	HID keyboard and consumer reports as needed
 
 Arguments:
 
@@ -51,6 +52,7 @@ Return Value:
 	RMI4_F1A_DATA_REGISTERS dataF1A;
 	int index;
 	NTSTATUS status;
+	ULONG64 timestamp;
 
 	//
 	// If the controller doesn't support buttons, ignore this interrupt
@@ -113,6 +115,8 @@ Return Value:
 		goto exit;
 	}
 
+    timestamp = KeQueryInterruptTime();
+
     for(int i = 0; i < RMI4_MAX_BUTTONS; i++)
     {
         if(ReversedKeys)
@@ -125,240 +129,1159 @@ Return Value:
         }
     }
 
-    status = FillButtonsReportFromCache(ControllerContext);
+    status = FillButtonsReportFromCache(ControllerContext, timestamp);
 
 exit:
     return status;
 }
 
-NTSTATUS 
-FillButtonsReportFromCache(
-    IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+static
+NTSTATUS
+ButtonsQueueReport(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN UCHAR ReportId,
+	IN UCHAR Keys
 )
+/*++
+
+Routine Description:
+
+	Appends a capacitive key report to the pending HID report queue
+
+Arguments:
+
+	ControllerContext - Touch controller context
+	ReportId - REPORTID_CAPKEY_KEYBOARD or REPORTID_CAPKEY_CONSUMER
+	Keys - Key bits to report as pressed, zero releases all keys
+
+Return Value:
+
+	NTSTATUS indicating whether a queue slot was available
+
+--*/
 {
-    NTSTATUS status = STATUS_SUCCESS;
+	PHID_INPUT_REPORT hidReport = NULL;
+	NTSTATUS status;
 
-    BOOLEAN* prevData = ControllerContext->ButtonsCache.prevPhysicalState;
-    BOOLEAN* data = ControllerContext->ButtonsCache.PhysicalState;
-    BOOLEAN* Logical = ControllerContext->ButtonsCache.LogicalState;
-    //
-    // Update button states. This mapping should be made registry configurable
-    //
+	status = GetNextHidReport(ControllerContext, &hidReport);
 
-    //
-    PHID_INPUT_REPORT hidReport = NULL;
-    PHID_KEY_REPORT hidKeys;
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_HID,
+			"Can't get report queue slot for button event - STATUS:%X",
+			status);
 
-    for(int i = 0; i < RMI4_MAX_BUTTONS; i++)
-    {
-        if(data[i] && !prevData[i])
-        {
-            Logical[i] = TRUE;
-            WdfTimerStart(ControllerContext->ButtonsTimer, WDF_REL_TIMEOUT_IN_MS(1500));
-        }
-    }
+		goto exit;
+	}
 
-    if(!data[1] && prevData[1]) //when up key
-    {
-        if(Logical[1]) //send key Down if Logical is true
-        {
-            //get hidReports from Queue
-            GetNextHidReport(ControllerContext, &hidReport);
-            hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD;
-            hidKeys = &(hidReport->KeyReport);
-            hidKeys->bKeys |= (1 << 0);
-        }
+	hidReport->ReportID = ReportId;
+	hidReport->KeyReport.bKeys = Keys;
 
-        GetNextHidReport(ControllerContext, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD; //send empty report(up all keys)
+exit:
 
-        Logical[1] = FALSE;
-    }
+	return status;
+}
 
-    BOOLEAN b0 = !data[0] && prevData[0] && Logical[0];
-    BOOLEAN b2 = !data[2] && prevData[2] && Logical[2];
+static
+NTSTATUS
+ButtonsQueueAction(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN RMI4_BUTTON_ACTION* Action
+)
+/*++
 
-    if(b0 || b2)
-    {
-        //get two hidReports from Queue
-        GetNextHidReport(ControllerContext, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_CONSUMER;
-        hidKeys = &(hidReport->KeyReport);
-        hidKeys->bKeys |= (b0) ? (1 << 0) : 0;
-        hidKeys->bKeys |= (b2) ? (1 << 1) : 0;
-        
-        GetNextHidReport(ControllerContext, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_CONSUMER;
-
-        Logical[0] = FALSE;
-        Logical[2] = FALSE;
-    }
+Routine Description:
 
-    //up ALT for alt+tab when button is up
-    if(!data[2] && prevData[2] && !Logical[2])
-    {
-        GetNextHidReport(ControllerContext, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD;
-    }
+	Reports a press of the action keys followed by a release of every
+	key that is not latched until the button goes up
 
-    //
-    // On return of success, this request will be completed up the stack
-    //
+Arguments:
 
-    for(int i = 0; i < RMI4_MAX_BUTTONS; i++)
-        ControllerContext->ButtonsCache.prevPhysicalState[i] = ControllerContext->ButtonsCache.PhysicalState[i];
+	ControllerContext - Touch controller context
+	Action - Keys to report
 
-//exit:
-    return status;
+Return Value:
+
+	NTSTATUS indicating whether both reports were queued
+
+--*/
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (Action->ReportId == 0)
+	{
+		goto exit;
+	}
+
+	status = ButtonsQueueReport(
+		ControllerContext,
+		Action->ReportId,
+		Action->Keys | Action->LatchKeys);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = ButtonsQueueReport(
+		ControllerContext,
+		Action->ReportId,
+		Action->LatchKeys);
+
+exit:
+
+	return status;
 }
 
-REPORTED_BUTTON
-TchHandleButtonArea(
-	IN ULONG ControllerX,
-	IN ULONG ControllerY,
-	IN PTOUCH_SCREEN_PROPERTIES Props
+static
+NTSTATUS
+ButtonsUpdateState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN int Button,
+	IN ULONG64 Timestamp
 )
+/*++
+
+Routine Description:
+
+	Advances the state machine of one button to the given time. A long
+	press or repeat that fell due before Timestamp is applied before the
+	current physical state is evaluated, so a release that is serviced
+	late still produces the hold action.
+
+	Up   -> Down : button pressed, hold deadline scheduled
+	Down -> Up   : released before hold time, tap action reported
+	Down -> Held : hold time elapsed, hold action reported
+	Held -> Held : repeat interval elapsed, hold action reported again
+	Held -> Up   : released, latched keys released
+
+Arguments:
+
+	ControllerContext - Touch controller context
+	Button - Index of the button to evaluate
+	Timestamp - Interrupt time of the sample, in 100ns units
+
+Return Value:
+
+	NTSTATUS indicating whether all generated reports were queued
+
+--*/
 {
-#ifdef EXPERIMENTAL_LEGACY_BUTTON_SUPPORT
-	//
-	// Hardcoded values now for RX100
-	//
-    ULONG ButtonAreaXMin = 0;
-    ULONG ButtonAreaYMin = 1280;
-    ULONG ButtonAreaXMax = 768;
-    ULONG ButtonAreaYMax = 1390;
-                           
-    ULONG BackAreaXMin =   0;
-    ULONG BackAreaYMin =   1300;
-    ULONG BackAreaXMax =   216;
-    ULONG BackAreaYMax =   1390;
-                           
-    ULONG StartAreaXMin =  297;
-    ULONG StartAreaYMin =  1300;
-    ULONG StartAreaXMax =  472;
-    ULONG StartAreaYMax =  1390;
-                           
-    ULONG SearchAreaXMin = 553;
-    ULONG SearchAreaYMin = 1300;
-    ULONG SearchAreaXMax = 768;
-    ULONG SearchAreaYMax = 1390;
+	RMI4_BUTTONS_CACHE* cache = &ControllerContext->ButtonsCache;
+	RMI4_BUTTON_MAP* map = &ControllerContext->Config->ButtonMap[Button];
+	NTSTATUS status = STATUS_SUCCESS;
 
-	//
-	// Swap the axes reported by the touch controller if requested
-	//
-	if (Props->TouchSwapAxes)
+	if (cache->State[Button] != ButtonStateUp &&
+		cache->NextEventTime[Button] != 0 &&
+		Timestamp >= cache->NextEventTime[Button])
 	{
-		ULONG temp = ControllerY;
-		ControllerY = ControllerX;
-		ControllerX = temp;
+		status = ButtonsQueueAction(ControllerContext, &map->Hold);
+
+		cache->State[Button] = ButtonStateHeld;
+		cache->NextEventTime[Button] = (map->RepeatInterval != 0) ?
+			Timestamp + BUTTONS_MS_TO_INTERRUPT_TIME(map->RepeatInterval) : 0;
 	}
 
-	//
-	// Invert the coordinates as requested
-	//
-	if (Props->TouchInvertXAxis)
+	switch (cache->State[Button])
 	{
-		if (ControllerX >= Props->TouchPhysicalWidth)
+	case ButtonStateUp:
+		if (cache->PhysicalState[Button])
+		{
+			cache->State[Button] = ButtonStateDown;
+			cache->NextEventTime[Button] =
+				(map->Hold.ReportId != 0 && map->HoldTime != 0) ?
+				Timestamp + BUTTONS_MS_TO_INTERRUPT_TIME(map->HoldTime) : 0;
+		}
+		break;
+
+	case ButtonStateDown:
+		if (!cache->PhysicalState[Button])
 		{
-			ControllerX = Props->TouchPhysicalWidth - 1u;
+			status = ButtonsQueueAction(ControllerContext, &map->Tap);
+
+			if (NT_SUCCESS(status) && map->Tap.LatchKeys != 0)
+			{
+				status = ButtonsQueueReport(ControllerContext, map->Tap.ReportId, 0);
+			}
+
+			cache->State[Button] = ButtonStateUp;
+			cache->NextEventTime[Button] = 0;
 		}
+		break;
 
-		ControllerX = Props->TouchPhysicalWidth - ControllerX - 1u;
+	case ButtonStateHeld:
+		if (!cache->PhysicalState[Button])
+		{
+			if (map->Hold.LatchKeys != 0)
+			{
+				status = ButtonsQueueReport(ControllerContext, map->Hold.ReportId, 0);
+			}
+
+			cache->State[Button] = ButtonStateUp;
+			cache->NextEventTime[Button] = 0;
+		}
+		break;
 	}
-	if (Props->TouchInvertYAxis)
+
+	return status;
+}
+
+static
+VOID
+ButtonsArmTimer(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN ULONG64 Timestamp
+)
+/*++
+
+Routine Description:
+
+	Arms the buttons timer for the earliest pending long press or repeat,
+	or stops it when no button has a pending deadline
+
+Arguments:
+
+	ControllerContext - Touch controller context
+	Timestamp - Interrupt time the deadlines are relative to
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_BUTTONS_CACHE* cache = &ControllerContext->ButtonsCache;
+	ULONG64 deadline = 0;
+	int i;
+
+	for (i = 0; i < RMI4_MAX_BUTTONS; i++)
 	{
-		if (ControllerY >= Props->TouchPhysicalHeight)
+		if (cache->NextEventTime[i] != 0 &&
+			(deadline == 0 || cache->NextEventTime[i] < deadline))
 		{
-			ControllerY = Props->TouchPhysicalHeight - 1u;
+			deadline = cache->NextEventTime[i];
 		}
+	}
+
+	if (deadline == 0)
+	{
+		if (cache->TimerArmed)
+		{
+			WdfTimerStop(ControllerContext->ButtonsTimer, FALSE);
+			cache->TimerArmed = FALSE;
+		}
+
+		goto exit;
+	}
 
-		ControllerY = Props->TouchPhysicalHeight - ControllerY - 1u;
+	if (cache->TimerArmed && cache->TimerDeadline == deadline)
+	{
+		goto exit;
 	}
 
-	if (ControllerX > ButtonAreaXMin && ControllerX < ButtonAreaXMax && ControllerY > ButtonAreaYMin && ControllerY < ButtonAreaYMax)
+	WdfTimerStart(
+		ControllerContext->ButtonsTimer,
+		-(LONGLONG)((deadline > Timestamp) ? deadline - Timestamp : 1));
+
+	cache->TimerDeadline = deadline;
+	cache->TimerArmed = TRUE;
+
+exit:
+
+	return;
+}
+
+NTSTATUS
+FillButtonsReportFromCache(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN ULONG64 Timestamp
+)
+/*++
+
+Routine Description:
+
+	Runs the button state machines against the current physical button
+	state and queues the resulting keyboard and consumer reports. Must be
+	called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+	Timestamp - Interrupt time of the sample, in 100ns units
+
+Return Value:
+
+	NTSTATUS indicating whether all generated reports were queued
+
+--*/
+{
+	NTSTATUS status = STATUS_SUCCESS;
+	NTSTATUS buttonStatus;
+	int i;
+
+	for (i = 0; i < RMI4_MAX_BUTTONS; i++)
 	{
-		if (ControllerX > BackAreaXMin && ControllerX < BackAreaXMax && ControllerY > BackAreaYMin && ControllerY < BackAreaYMax)
+		buttonStatus = ButtonsUpdateState(ControllerContext, i, Timestamp);
+
+		if (!NT_SUCCESS(buttonStatus))
 		{
-			return BUTTON_BACK;
+			status = buttonStatus;
 		}
-		if (ControllerX > StartAreaXMin && ControllerX < StartAreaXMax && ControllerY > StartAreaYMin && ControllerY < StartAreaYMax)
+	}
+
+	ButtonsArmTimer(ControllerContext, Timestamp);
+
+	return status;
+}
+
+VOID
+ButtonsResetState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Forgets pressed buttons and pending long presses once the controller
+	stops reporting. Must be called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_BUTTONS_CACHE* cache = &ControllerContext->ButtonsCache;
+	int i;
+
+	for (i = 0; i < RMI4_MAX_BUTTONS; i++)
+	{
+		cache->PhysicalState[i] = FALSE;
+		cache->State[i] = ButtonStateUp;
+		cache->NextEventTime[i] = 0;
+	}
+
+	if (cache->TimerArmed)
+	{
+		WdfTimerStop(ControllerContext->ButtonsTimer, FALSE);
+		cache->TimerArmed = FALSE;
+	}
+}
+
+REPORTED_BUTTON
+TchHandleButtonArea(
+	IN RMI4_BUTTON_REGIONS* Regions,
+	IN ULONG ControllerX,
+	IN ULONG ControllerY
+)
+/*++
+
+Routine Description:
+
+	Hit-tests a contact against the button regions. Contacts outside the
+	band holding all regions are rejected with two comparisons, the rest
+	are only tested against the regions crossing their column.
+
+Arguments:
+
+	Regions - Button regions, in controller coordinates
+	ControllerX - Contact X position as reported by the controller
+	ControllerY - Contact Y position as reported by the controller
+
+Return Value:
+
+	BUTTON_NONE for ordinary touches, BUTTON_UNKNOWN for dead zones,
+	otherwise the button number (index + 1) of the region hit
+
+--*/
+{
+	RMI4_BUTTON_REGION* region;
+	ULONG column;
+	UCHAR candidates;
+	ULONG i;
+
+	if (Regions->Count == 0 ||
+		ControllerX < Regions->XMin || ControllerX > Regions->XMax ||
+		ControllerY < Regions->YMin || ControllerY > Regions->YMax)
+	{
+		return BUTTON_NONE;
+	}
+
+	column = Regions->ColumnsOnY ?
+		ControllerY - Regions->YMin :
+		ControllerX - Regions->XMin;
+
+	candidates = Regions->Columns[column >> Regions->ColumnShift];
+
+	//
+	// Regions listed first take priority, so buttons can sit on a dead zone
+	//
+	for (i = 0; candidates != 0; i++, candidates >>= 1)
+	{
+		if ((candidates & 1) == 0)
 		{
-			return BUTTON_START;
+			continue;
 		}
-		if (ControllerX > SearchAreaXMin && ControllerX < SearchAreaXMax && ControllerY > SearchAreaYMin && ControllerY < SearchAreaYMax)
+
+		region = &Regions->Region[i];
+
+		if (ControllerX >= region->XMin && ControllerX <= region->XMax &&
+			ControllerY >= region->YMin && ControllerY <= region->YMax)
 		{
-			return BUTTON_SEARCH;
+			return (REPORTED_BUTTON)region->Button;
 		}
-		return BUTTON_UNKNOWN;
 	}
-#else
-	UNREFERENCED_PARAMETER((ControllerX, ControllerY, Props));
-#endif
+
 	return BUTTON_NONE;
 }
 
-void 
-ButtonsTimerHandler(
-    WDFTIMER Timer
+static
+BOOLEAN
+ButtonsParseRegion(
+	IN PCUNICODE_STRING String,
+	OUT ULONG Values[BUTTON_REGION_FIELDS]
 )
+/*++
+
+Routine Description:
+
+	Parses a "button,x1,y1,x2,y2" region description
+
+Arguments:
+
+	String - Region description from the registry
+	Values - Receives the parsed fields
+
+Return Value:
+
+	TRUE if the string held exactly the expected decimal fields
+
+--*/
 {
-    WDFDEVICE FxDevice = (WDFDEVICE)WdfTimerGetParentObject(Timer);
-    PDEVICE_EXTENSION devContext = GetDeviceContext(FxDevice);
-    RMI4_CONTROLLER_CONTEXT* controller = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+	ULONG field = 0;
+	BOOLEAN digits = FALSE;
+	WCHAR c;
+	ULONG i;
 
-    BOOLEAN* Logical = controller->ButtonsCache.LogicalState;
+	RtlZeroMemory(Values, sizeof(ULONG) * BUTTON_REGION_FIELDS);
 
-    PHID_INPUT_REPORT hidReport = NULL;
-    PHID_KEY_REPORT hidKeys;
-    BOOLEAN flag = FALSE;
+	for (i = 0; i < String->Length / sizeof(WCHAR); i++)
+	{
+		c = String->Buffer[i];
 
-    if(Logical[2])
-    {
-        //get two hidReports from Queue
-        //GetNextHidReport(controller, &hidReport);
-        //hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD;
-        //hidKeys = &(hidReport->KeyReport);
-        //hidKeys->bKeys |= (1 << 2);//alt
-
-        GetNextHidReport(controller, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD;
-        hidKeys = &(hidReport->KeyReport);
-        hidKeys->bKeys |= (1 << 2);//alt
-        hidKeys->bKeys |= (1 << 1);//tab
-
-        GetNextHidReport(controller, &hidReport);
-        hidReport->ReportID = REPORTID_CAPKEY_KEYBOARD;
-        hidKeys = &(hidReport->KeyReport);
-        hidKeys->bKeys |= (1 << 2);//alt
-        //hidKeys->bKeys &= ~(1 << 1);//UP Tab
-
-        Logical[2] = FALSE;
-        flag = TRUE;
-    }
+		if (c >= L'0' && c <= L'9')
+		{
+			Values[field] = Values[field] * 10 + (c - L'0');
+			digits = TRUE;
 
-    if(flag)
-    {
-        SendHidReports(
-            devContext->PingPongQueue,
-            controller->HidQueue,
-            controller->HidQueueCount
-        );
-        controller->HidQueueCount = 0;
-    }
+			if (Values[field] > MAXUSHORT)
+			{
+				return FALSE;
+			}
+		}
+		else if (c == L',')
+		{
+			if (!digits || ++field == BUTTON_REGION_FIELDS)
+			{
+				return FALSE;
+			}
+
+			digits = FALSE;
+		}
+		else if (c != L' ')
+		{
+			return FALSE;
+		}
+	}
 
-    //Trace(TRACE_LEVEL_INFORMATION, TRACE_FLAG_HID, "Buttons Timer reached!");
+	return (digits && field == BUTTON_REGION_FIELDS - 1);
 }
 
-void
-ButtonsInitTimer(
-    RMI4_CONTROLLER_CONTEXT* ControllerContext
+static
+VOID
+ButtonsAddRegion(
+	IN RMI4_BUTTON_REGIONS* Regions,
+	IN PTOUCH_SCREEN_PROPERTIES Props,
+	IN ULONG Values[BUTTON_REGION_FIELDS]
 )
-{
-    WDF_TIMER_CONFIG       timerConfig;
-    WDF_OBJECT_ATTRIBUTES  timerAttributes;
-    WDF_TIMER_CONFIG_INIT(&timerConfig, ButtonsTimerHandler);
-    WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
-    timerAttributes.ParentObject = ControllerContext->FxDevice;
-
-    WdfTimerCreate(&timerConfig, &timerAttributes, &ControllerContext->ButtonsTimer);
-}
\ No newline at end of file
+/*++
+
+Routine Description:
+
+	Converts a region given in touch orientation (after axis swap and
+	inversion, as configured in the screen properties) to controller
+	coordinates and appends it to the region table, so contacts never
+	need to be transformed before hit-testing.
+
+Arguments:
+
+	Regions - Region table to extend
+	Props - Screen properties describing the controller orientation
+	Values - Button number (0 for a dead zone) and inclusive bounds
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_BUTTON_REGION* region;
+	ULONG xMin = Values[1];
+	ULONG yMin = Values[2];
+	ULONG xMax = Values[3];
+	ULONG yMax = Values[4];
+	ULONG temp;
+
+	if (Values[0] > RMI4_MAX_BUTTONS || xMin > xMax || yMin > yMax)
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Ignoring invalid button region %d,%d,%d,%d,%d",
+			Values[0], xMin, yMin, xMax, yMax);
+
+		goto exit;
+	}
+
+	if (Regions->Count == RMI4_MAX_BUTTON_REGIONS)
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Too many button regions, only %d supported",
+			RMI4_MAX_BUTTON_REGIONS);
+
+		goto exit;
+	}
+
+	if (Props->TouchInvertXAxis)
+	{
+		if (xMin >= Props->TouchPhysicalWidth)
+		{
+			goto exit;
+		}
+
+		xMax = min(xMax, Props->TouchPhysicalWidth - 1u);
+		temp = xMin;
+		xMin = Props->TouchPhysicalWidth - xMax - 1u;
+		xMax = Props->TouchPhysicalWidth - temp - 1u;
+	}
+
+	if (Props->TouchInvertYAxis)
+	{
+		if (yMin >= Props->TouchPhysicalHeight)
+		{
+			goto exit;
+		}
+
+		yMax = min(yMax, Props->TouchPhysicalHeight - 1u);
+		temp = yMin;
+		yMin = Props->TouchPhysicalHeight - yMax - 1u;
+		yMax = Props->TouchPhysicalHeight - temp - 1u;
+	}
+
+	region = &Regions->Region[Regions->Count++];
+
+	if (Props->TouchSwapAxes)
+	{
+		region->XMin = yMin;
+		region->YMin = xMin;
+		region->XMax = yMax;
+		region->YMax = xMax;
+	}
+	else
+	{
+		region->XMin = xMin;
+		region->YMin = yMin;
+		region->XMax = xMax;
+		region->YMax = yMax;
+	}
+
+	region->Button = (UCHAR)((Values[0] == 0) ? BUTTON_UNKNOWN : Values[0]);
+
+exit:
+
+	return;
+}
+
+static
+VOID
+ButtonsBuildRegionColumns(
+	IN RMI4_BUTTON_REGIONS* Regions
+)
+/*++
+
+Routine Description:
+
+	Computes the band holding all regions and the per-column candidate
+	masks used by TchHandleButtonArea
+
+Arguments:
+
+	Regions - Region table to index
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_BUTTON_REGION* region;
+	ULONG first;
+	ULONG last;
+	ULONG span;
+	ULONG i;
+	ULONG j;
+
+	RtlZeroMemory(Regions->Columns, sizeof(Regions->Columns));
+
+	if (Regions->Count == 0)
+	{
+		return;
+	}
+
+	Regions->XMin = Regions->YMin = MAXULONG;
+	Regions->XMax = Regions->YMax = 0;
+
+	for (i = 0; i < Regions->Count; i++)
+	{
+		region = &Regions->Region[i];
+
+		Regions->XMin = min(Regions->XMin, region->XMin);
+		Regions->YMin = min(Regions->YMin, region->YMin);
+		Regions->XMax = max(Regions->XMax, region->XMax);
+		Regions->YMax = max(Regions->YMax, region->YMax);
+	}
+
+	Regions->ColumnsOnY =
+		(Regions->YMax - Regions->YMin) > (Regions->XMax - Regions->XMin);
+
+	span = Regions->ColumnsOnY ?
+		Regions->YMax - Regions->YMin :
+		Regions->XMax - Regions->XMin;
+
+	Regions->ColumnShift = 0;
+	while ((span >> Regions->ColumnShift) >= RMI4_BUTTON_REGION_COLUMNS)
+	{
+		Regions->ColumnShift++;
+	}
+
+	for (i = 0; i < Regions->Count; i++)
+	{
+		region = &Regions->Region[i];
+
+		if (Regions->ColumnsOnY)
+		{
+			first = (region->YMin - Regions->YMin) >> Regions->ColumnShift;
+			last = (region->YMax - Regions->YMin) >> Regions->ColumnShift;
+		}
+		else
+		{
+			first = (region->XMin - Regions->XMin) >> Regions->ColumnShift;
+			last = (region->XMax - Regions->XMin) >> Regions->ColumnShift;
+		}
+
+		for (j = first; j <= last; j++)
+		{
+			Regions->Columns[j] |= (UCHAR)(1 << i);
+		}
+	}
+}
+
+static
+VOID
+ButtonsLoadRegions(
+	IN WDFKEY DeviceKey,
+	IN WDFKEY SharedKey,
+	IN OUT RMI4_CONFIG_SNAPSHOT* Config
+)
+/*++
+
+Routine Description:
+
+	Loads the on-screen button and dead zone regions from the ButtonRegions
+	multi-string of the device key, or of the shared buttons key if the
+	device key has none. Each string is "button,x1,y1,x2,y2" with
+	inclusive bounds in touch orientation, where button is 1 to
+	RMI4_MAX_BUTTONS, or 0 for a dead zone that swallows contacts. Earlier
+	entries take priority where regions overlap.
+
+Arguments:
+
+	DeviceKey - Opened device hardware key, NULL if there is none
+	SharedKey - Opened shared buttons key, NULL if there is none
+	Config - Snapshot being built, its screen properties already read
+
+Return Value:
+
+	None
+
+--*/
+{
+#ifdef EXPERIMENTAL_LEGACY_BUTTON_SUPPORT
+	//
+	// RX100 layout: back, start and search keys below the display
+	//
+	static ULONG legacyRegions[][BUTTON_REGION_FIELDS] =
+	{
+		{ BUTTON_BACK, 1, 1301, 215, 1389 },
+		{ BUTTON_START, 298, 1301, 471, 1389 },
+		{ BUTTON_SEARCH, 554, 1301, 767, 1389 },
+		{ 0, 1, 1281, 767, 1389 }
+	};
+#endif
+	DECLARE_CONST_UNICODE_STRING(regionsValue, BUTTON_REGIONS_VALUE);
+	RMI4_BUTTON_REGIONS* regions = &Config->ButtonRegions;
+	ULONG values[BUTTON_REGION_FIELDS];
+	WDFCOLLECTION regionStrings = NULL;
+	WDFSTRING stringHandle;
+	UNICODE_STRING string;
+	NTSTATUS status;
+	ULONG i;
+
+	RtlZeroMemory(regions, sizeof(RMI4_BUTTON_REGIONS));
+
+	if (DeviceKey == NULL && SharedKey == NULL)
+	{
+		goto exit;
+	}
+
+	status = WdfCollectionCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&regionStrings);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Couldn't allocate a collection for button regions - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = STATUS_OBJECT_NAME_NOT_FOUND;
+
+	if (DeviceKey != NULL)
+	{
+		status = WdfRegistryQueryMultiString(
+			DeviceKey,
+			&regionsValue,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			regionStrings);
+	}
+
+	if (!NT_SUCCESS(status) && SharedKey != NULL)
+	{
+		status = WdfRegistryQueryMultiString(
+			SharedKey,
+			&regionsValue,
+			WDF_NO_OBJECT_ATTRIBUTES,
+			regionStrings);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	for (i = 0; i < WdfCollectionGetCount(regionStrings); i++)
+	{
+		stringHandle = WdfCollectionGetItem(regionStrings, i);
+		WdfStringGetUnicodeString(stringHandle, &string);
+
+		if (!ButtonsParseRegion(&string, values))
+		{
+			Trace(
+				TRACE_LEVEL_WARNING,
+				TRACE_FLAG_INIT,
+				"Button region string %d is malformed",
+				i);
+
+			continue;
+		}
+
+		ButtonsAddRegion(regions, &Config->Props, values);
+	}
+
+exit:
+
+	if (regionStrings != NULL)
+	{
+		WdfObjectDelete(regionStrings);
+	}
+
+#ifdef EXPERIMENTAL_LEGACY_BUTTON_SUPPORT
+	if (regions->Count == 0)
+	{
+		for (i = 0; i < ARRAYSIZE(legacyRegions); i++)
+		{
+			ButtonsAddRegion(regions, &Config->Props, legacyRegions[i]);
+		}
+	}
+#endif
+
+	ButtonsBuildRegionColumns(regions);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Loaded %d button regions",
+		regions->Count);
+}
+
+VOID
+ButtonsTimerHandler(
+	IN WDFTIMER Timer
+)
+/*++
+
+Routine Description:
+
+	Fires when the earliest pending long press or repeat falls due. The
+	state machines are evaluated at the current time and any reports they
+	generate are completed immediately.
+
+Arguments:
+
+	Timer - Buttons timer, parented to the device
+
+Return Value:
+
+	None
+
+--*/
+{
+	WDFDEVICE fxDevice = (WDFDEVICE)WdfTimerGetParentObject(Timer);
+	PDEVICE_EXTENSION devContext = GetDeviceContext(fxDevice);
+	RMI4_CONTROLLER_CONTEXT* controller;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+
+	//
+	// The timer is parented to the device and may still fire once the
+	// controller context is gone
+	//
+	if (controller == NULL)
+	{
+		goto exit;
+	}
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	controller->ButtonsCache.TimerArmed = FALSE;
+
+	status = FillButtonsReportFromCache(controller, KeQueryInterruptTime());
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_HID,
+			"Error reporting button long press - STATUS:%X",
+			status);
+	}
+
+	if (controller->HidQueueCount > 0)
+	{
+		SendHidReports(
+			devContext->PingPongQueue,
+			controller->HidQueue,
+			controller->HidQueueCount);
+
+		controller->HidQueueCount = 0;
+	}
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+exit:
+
+	return;
+}
+
+static
+VOID
+ButtonsReadAction(
+	IN WDFKEY Key,
+	IN PCWSTR ValueName,
+	IN OUT RMI4_BUTTON_ACTION* Action
+)
+/*++
+
+Routine Description:
+
+	Reads a packed button action from the registry. The value keeps its
+	default when absent; a report id other than the keyboard or consumer
+	collection disables the action.
+
+Arguments:
+
+	Key - Opened buttons settings key
+	ValueName - Registry value holding the packed action
+	Action - Action to update
+
+Return Value:
+
+	None
+
+--*/
+{
+	UNICODE_STRING valueName;
+	NTSTATUS status;
+	ULONG value;
+
+	RtlInitUnicodeString(&valueName, ValueName);
+
+	status = WdfRegistryQueryULong(Key, &valueName, &value);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	Action->ReportId = BUTTON_ACTION_REPORTID(value);
+	Action->Keys = BUTTON_ACTION_KEYS(value);
+	Action->LatchKeys = BUTTON_ACTION_LATCH_KEYS(value);
+
+	if (Action->ReportId != REPORTID_CAPKEY_KEYBOARD &&
+		Action->ReportId != REPORTID_CAPKEY_CONSUMER)
+	{
+		Action->ReportId = 0;
+	}
+
+exit:
+
+	return;
+}
+
+static
+VOID
+ButtonsLoadMapping(
+	IN WDFKEY DeviceKey,
+	IN WDFKEY SharedKey,
+	IN OUT RMI4_CONFIG_SNAPSHOT* Config
+)
+/*++
+
+Routine Description:
+
+	Fills the per-button action table with the default mapping and then
+	applies the overrides of the shared buttons key followed by those of
+	the device key:
+
+	ButtonNTap, ButtonNHold - packed action (report id, keys, latch keys)
+	ButtonNHoldTime - long press time in milliseconds, 0 disables it
+	ButtonNRepeat - hold action repeat interval in milliseconds
+
+	Default mapping:
+	Button 0 - tap: consumer Search
+	Button 1 - tap: keyboard left GUI (Start)
+	Button 2 - tap: consumer Back, hold: ALT+TAB with ALT held until release
+
+Arguments:
+
+	DeviceKey - Opened device hardware key, NULL if there is none
+	SharedKey - Opened shared buttons key, NULL if there is none
+	Config - Snapshot being built
+
+Return Value:
+
+	None
+
+--*/
+{
+	static const PCWSTR tapValues[RMI4_MAX_BUTTONS] =
+		{ L"Button0Tap", L"Button1Tap", L"Button2Tap" };
+	static const PCWSTR holdValues[RMI4_MAX_BUTTONS] =
+		{ L"Button0Hold", L"Button1Hold", L"Button2Hold" };
+	static const PCWSTR holdTimeValues[RMI4_MAX_BUTTONS] =
+		{ L"Button0HoldTime", L"Button1HoldTime", L"Button2HoldTime" };
+	static const PCWSTR repeatValues[RMI4_MAX_BUTTONS] =
+		{ L"Button0Repeat", L"Button1Repeat", L"Button2Repeat" };
+	RMI4_BUTTON_MAP* map = Config->ButtonMap;
+	WDFKEY keys[2] = { SharedKey, DeviceKey };
+	UNICODE_STRING valueName;
+	ULONG value;
+	ULONG k;
+	int i;
+
+	RtlZeroMemory(map, sizeof(Config->ButtonMap));
+
+	map[0].Tap.ReportId = REPORTID_CAPKEY_CONSUMER;
+	map[0].Tap.Keys = BUTTON_CONSUMER_SEARCH;
+
+	map[1].Tap.ReportId = REPORTID_CAPKEY_KEYBOARD;
+	map[1].Tap.Keys = BUTTON_KEYBOARD_GUI;
+
+	map[2].Tap.ReportId = REPORTID_CAPKEY_CONSUMER;
+	map[2].Tap.Keys = BUTTON_CONSUMER_BACK;
+	map[2].Hold.ReportId = REPORTID_CAPKEY_KEYBOARD;
+	map[2].Hold.Keys = BUTTON_KEYBOARD_TAB;
+	map[2].Hold.LatchKeys = BUTTON_KEYBOARD_ALT;
+	map[2].HoldTime = BUTTONS_DEFAULT_HOLD_TIME;
+
+	for (k = 0; k < ARRAYSIZE(keys); k++)
+	{
+		if (keys[k] == NULL)
+		{
+			continue;
+		}
+
+		for (i = 0; i < RMI4_MAX_BUTTONS; i++)
+		{
+			ButtonsReadAction(keys[k], tapValues[i], &map[i].Tap);
+			ButtonsReadAction(keys[k], holdValues[i], &map[i].Hold);
+
+			RtlInitUnicodeString(&valueName, holdTimeValues[i]);
+			if (NT_SUCCESS(WdfRegistryQueryULong(keys[k], &valueName, &value)))
+			{
+				map[i].HoldTime = value;
+			}
+
+			RtlInitUnicodeString(&valueName, repeatValues[i]);
+			if (NT_SUCCESS(WdfRegistryQueryULong(keys[k], &valueName, &value)))
+			{
+				map[i].RepeatInterval = value;
+			}
+		}
+	}
+}
+
+VOID
+ButtonsLoadConfiguration(
+	IN WDFDEVICE FxDevice,
+	IN OUT RMI4_CONFIG_SNAPSHOT* Config
+)
+/*++
+
+Routine Description:
+
+	Reads the button mapping and the on-screen button regions of a
+	configuration snapshot. As with the controller settings, values of
+	the device hardware key take precedence over those of the shared
+	buttons key, so devices of one machine can be mapped apart. Regions
+	are converted to controller coordinates with the snapshot's screen
+	properties.
+
+Arguments:
+
+	FxDevice - a handle to the framework device object
+	Config - Snapshot being built, its screen properties already read
+
+Return Value:
+
+	None
+
+--*/
+{
+	DECLARE_CONST_UNICODE_STRING(buttonsSettingsPath, BUTTONS_REGISTRY_PATH);
+	WDFKEY deviceKey = NULL;
+	WDFKEY sharedKey = NULL;
+	NTSTATUS status;
+
+	status = WdfDeviceOpenRegistryKey(
+		FxDevice,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&deviceKey);
+
+	if (!NT_SUCCESS(status))
+	{
+		deviceKey = NULL;
+	}
+
+	status = WdfRegistryOpenKey(
+		NULL,
+		&buttonsSettingsPath,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&sharedKey);
+
+	if (!NT_SUCCESS(status))
+	{
+		sharedKey = NULL;
+	}
+
+	if (deviceKey == NULL && sharedKey == NULL)
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_INIT,
+			"No button mapping in registry, using defaults");
+	}
+
+	ButtonsLoadMapping(deviceKey, sharedKey, Config);
+	ButtonsLoadRegions(deviceKey, sharedKey, Config);
+
+	if (sharedKey != NULL)
+	{
+		WdfRegistryClose(sharedKey);
+	}
+
+	if (deviceKey != NULL)
+	{
+		WdfRegistryClose(deviceKey);
+	}
+}
+
+NTSTATUS
+ButtonsInitialize(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Creates the timer used for long press and repeat deadlines. The
+	timer runs at passive level so it can take the controller lock, and
+	is only armed while a deadline is pending. The button mapping and
+	regions are part of the configuration snapshot.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	WDF_TIMER_CONFIG timerConfig;
+	WDF_OBJECT_ATTRIBUTES timerAttributes;
+	NTSTATUS status;
+
+	WDF_TIMER_CONFIG_INIT(&timerConfig, ButtonsTimerHandler);
+	timerConfig.AutomaticSerialization = FALSE;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&timerAttributes);
+	timerAttributes.ParentObject = ControllerContext->FxDevice;
+	timerAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfTimerCreate(
+		&timerConfig,
+		&timerAttributes,
+		&ControllerContext->ButtonsTimer);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not create buttons timer - STATUS:%X",
+			status);
+
+		ControllerContext->ButtonsTimer = NULL;
+	}
+
+	return status;
+}
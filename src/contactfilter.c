@@ -0,0 +1,339 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contactfilter.c
+
+	Abstract:
+
+		Adaptive low pass filter applied to each tracked contact between
+		the finger cache update and report generation. The cutoff of each
+		axis follows the contact speed: a resting or slowly moving finger
+		is smoothed heavily to remove jitter, a fast one is followed
+		closely to keep latency low. All arithmetic is fixed point.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "rmiinternal.h"
+#include "contactfilter.h"
+#include "debug.h"
+//#include "contactfilter.tmh"
+
+static ULONG
+RmiFilterAlpha(
+	IN ULONG64 Rate,
+	IN ULONG Elapsed
+)
+/*++
+
+Routine Description:
+
+	Computes the smoothing factor of a first order low pass filter,
+	tau = 1 / (2 * pi * fc), sampled Elapsed after the previous sample:
+	alpha = 1 / (1 + tau / Te) = k / (k + 1) with k = 2 * pi * fc * Te.
+
+Arguments:
+
+	Rate - cutoff in mHz scaled by 2 * pi in 16.16 fixed point
+	Elapsed - time since the previous sample, in 100us units
+
+Return Value:
+
+	Smoothing factor in 16.16 fixed point
+
+--*/
+{
+	ULONG64 k;
+
+	k = Rate * Elapsed / RMI4_FILTER_RATE_DIVISOR;
+
+	return (ULONG)((k << RMI4_FILTER_ALPHA_SHIFT) / (k + RMI4_FILTER_ALPHA_ONE));
+}
+
+static USHORT
+RmiFilterAxis(
+	IN const RMI4_FILTER_PARAMETERS* Parameters,
+	IN OUT LONG* Position,
+	IN OUT LONG* Speed,
+	IN USHORT Sample,
+	IN ULONG Elapsed,
+	IN ULONG DerivativeAlpha
+)
+/*++
+
+Routine Description:
+
+	Filters one coordinate of a contact. The speed estimate is smoothed
+	with the derivative cutoff and raises the position cutoff by Beta
+	per unit of speed.
+
+Arguments:
+
+	Parameters - compiled filter tuning
+	Position - filtered position, updated with the sample
+	Speed - filtered speed, updated with the sample
+	Sample - position reported by the controller
+	Elapsed - time since the previous sample, in 100us units
+	DerivativeAlpha - smoothing factor of the speed estimate
+
+Return Value:
+
+	The filtered position rounded to controller units
+
+--*/
+{
+	LONG delta;
+	LONG speed;
+	ULONG64 magnitude;
+	ULONG64 rate;
+	ULONG alpha;
+
+	delta = ((LONG)Sample << RMI4_FILTER_FRACTION_BITS) - *Position;
+
+	speed = (LONG)(((LONG64)delta * RMI4_FILTER_TICKS_PER_SECOND) /
+		((LONG64)Elapsed << RMI4_FILTER_FRACTION_BITS));
+
+	*Speed += (LONG)(((LONG64)(speed - *Speed) * DerivativeAlpha) >> RMI4_FILTER_ALPHA_SHIFT);
+
+	magnitude = (*Speed < 0) ? (ULONG64)(-(LONG64)*Speed) : (ULONG64)*Speed;
+
+	if (magnitude >= Parameters->SpeedLimit)
+	{
+		rate = (ULONG64)RMI4_FILTER_MAX_CUTOFF * RMI4_FILTER_TWO_PI;
+	}
+	else
+	{
+		rate = Parameters->MinCutoffRate + Parameters->BetaRate * magnitude;
+	}
+
+	alpha = RmiFilterAlpha(rate, Elapsed);
+
+	*Position += (LONG)(((LONG64)delta * alpha + (RMI4_FILTER_ALPHA_ONE >> 1)) >> RMI4_FILTER_ALPHA_SHIFT);
+
+	return (USHORT)((*Position + (1 << (RMI4_FILTER_FRACTION_BITS - 1))) >> RMI4_FILTER_FRACTION_BITS);
+}
+
+VOID
+RmiFilterCompile(
+	IN const RMI4_FILTER_SETTINGS* Settings,
+	OUT RMI4_FILTER_PARAMETERS* Parameters
+)
+/*++
+
+Routine Description:
+
+	Validates the filter tuning read from the registry and compiles it
+	into the rates used while servicing interrupts. Values out of range
+	are clamped.
+
+Arguments:
+
+	Settings - tuning read from the registry
+	Parameters - receives the compiled tuning
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG minCutoff;
+	ULONG derivativeCutoff;
+	ULONG beta;
+
+	minCutoff = min(max(Settings->MinCutoff, 1), RMI4_FILTER_MAX_CUTOFF);
+	derivativeCutoff = min(max(Settings->DerivativeCutoff, 1), RMI4_FILTER_MAX_CUTOFF);
+	beta = min(Settings->Beta, RMI4_FILTER_MAX_BETA);
+
+	Parameters->Enabled = (Settings->Enable != 0);
+	Parameters->MinCutoffRate = (ULONG64)minCutoff * RMI4_FILTER_TWO_PI;
+	Parameters->BetaRate = (ULONG64)beta * RMI4_FILTER_TWO_PI;
+	Parameters->DerivativeRate = (ULONG64)derivativeCutoff * RMI4_FILTER_TWO_PI;
+
+	//
+	// Past this speed the cutoff is at its maximum, which also keeps
+	// BetaRate * speed from overflowing
+	//
+	if (beta == 0)
+	{
+		Parameters->SpeedLimit = MAXULONG64;
+	}
+	else
+	{
+		Parameters->SpeedLimit =
+			(RMI4_FILTER_MAX_CUTOFF - minCutoff) / beta;
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REGISTRY,
+		"Contact filter %s, min cutoff %lu mHz, beta %lu, derivative cutoff %lu mHz",
+		Parameters->Enabled ? "enabled" : "disabled",
+		minCutoff,
+		beta,
+		derivativeCutoff);
+}
+
+VOID
+RmiFilterStart(
+	OUT RMI4_FILTER_STATE* State,
+	IN USHORT X,
+	IN USHORT Y,
+	IN ULONG Time
+)
+/*++
+
+Routine Description:
+
+	Starts filtering a new contact at its reported position
+
+Arguments:
+
+	State - filter state of the contact
+	X - reported X position
+	Y - reported Y position
+	Time - scan time of the report, in 100us units
+
+Return Value:
+
+	None
+
+--*/
+{
+	State->X = (LONG)X << RMI4_FILTER_FRACTION_BITS;
+	State->Y = (LONG)Y << RMI4_FILTER_FRACTION_BITS;
+	State->SpeedX = 0;
+	State->SpeedY = 0;
+	State->Time = Time;
+}
+
+VOID
+RmiFilterSample(
+	IN const RMI4_FILTER_PARAMETERS* Parameters,
+	IN OUT RMI4_FILTER_STATE* State,
+	IN OUT PUSHORT X,
+	IN OUT PUSHORT Y,
+	IN ULONG Time
+)
+/*++
+
+Routine Description:
+
+	Feeds the next reported position of a contact to its filter
+
+Arguments:
+
+	Parameters - compiled filter tuning
+	State - filter state of the contact, started with RmiFilterStart
+	X - reported X position, replaced with the filtered one
+	Y - reported Y position, replaced with the filtered one
+	Time - scan time of the report, in 100us units
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG derivativeAlpha;
+	ULONG elapsed;
+
+	elapsed = Time - State->Time;
+	elapsed = min(max(elapsed, 1), RMI4_FILTER_MAX_ELAPSED);
+	State->Time = Time;
+
+	derivativeAlpha = RmiFilterAlpha(Parameters->DerivativeRate, elapsed);
+
+	*X = RmiFilterAxis(
+		Parameters,
+		&State->X,
+		&State->SpeedX,
+		*X,
+		elapsed,
+		derivativeAlpha);
+
+	*Y = RmiFilterAxis(
+		Parameters,
+		&State->Y,
+		&State->SpeedY,
+		*Y,
+		elapsed,
+		derivativeAlpha);
+}
+
+VOID
+RmiFilterContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Filters the reported positions of the contacts in the finger cache,
+	after it was updated with a frame read from the controller. The
+	positions the controller reported are left as they are. A new
+	contact starts the filter at its reported position, a lifted contact
+	keeps the position it was last reported at. Called with the
+	controller lock held.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	const RMI4_FILTER_PARAMETERS* parameters = &ControllerContext->Config->Filter;
+	ULONG fingers = ControllerContext->SlotCapacity;
+	RMI4_FINGER_INFO* report;
+	RMI4_FILTER_STATE* state;
+	ULONG now;
+	ULONG i;
+
+	if (!parameters->Enabled)
+	{
+		bitmap_zero(cache->FilterPrimed, fingers);
+		return;
+	}
+
+	now = (ULONG)cache->ScanTime;
+
+	//
+	// Slots marked dirty were lifted on this frame
+	//
+	for (i = find_first_bit(cache->FingerSlotDirty, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotDirty, fingers, i + 1))
+	{
+		__clear_bit(i, cache->FilterPrimed);
+	}
+
+	for (i = find_first_bit(cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+	{
+		state = &cache->Filter[i];
+		report = &cache->Report[i];
+
+		if (!test_bit(i, cache->FilterPrimed))
+		{
+			RmiFilterStart(state, report->x, report->y, now);
+			__set_bit(i, cache->FilterPrimed);
+			continue;
+		}
+
+		RmiFilterSample(parameters, state, &report->x, &report->y, now);
+	}
+}
@@ -0,0 +1,318 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contactpredictor.c
+
+	Abstract:
+
+		Moves each tracked contact ahead along its path by a configured
+		horizon, to make up for the time a report spends in the bus, the
+		input stack and the compositor before it is displayed. Velocity
+		and acceleration come from the last positions of the contact and
+		their scan times. A contact is only moved once its history is
+		long enough and consistent: it is left in place when it is slow,
+		has just reversed, or would be moved backwards.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "rmiinternal.h"
+#include "contactpredictor.h"
+#include "debug.h"
+//#include "contactpredictor.tmh"
+
+static LONG
+RmiPredictorClamp(
+	IN LONG64 Value,
+	IN LONG Limit
+)
+{
+	if (Value > Limit)
+	{
+		return Limit;
+	}
+	else if (Value < -Limit)
+	{
+		return -Limit;
+	}
+
+	return (LONG)Value;
+}
+
+static USHORT
+RmiPredictorAxis(
+	IN const RMI4_PREDICTOR_PARAMETERS* Parameters,
+	IN OUT LONG* Position,
+	IN OUT LONG* Velocity,
+	IN OUT LONG* Acceleration,
+	IN USHORT Sample,
+	IN ULONG Elapsed,
+	IN ULONG Samples
+)
+/*++
+
+Routine Description:
+
+	Updates the history of one coordinate of a contact and extrapolates
+	it over the horizon: p + v * h + a * h^2 / 2.
+
+Arguments:
+
+	Parameters - compiled prediction tuning
+	Position - last position, replaced with the sample
+	Velocity - last velocity, replaced with the one ending at the sample
+	Acceleration - smoothed acceleration, updated with the sample
+	Sample - position of the contact
+	Elapsed - time since the previous sample, in 100us units
+	Samples - samples seen before this one
+
+Return Value:
+
+	The predicted position, or Sample when the history does not allow
+	a confident prediction
+
+--*/
+{
+	LONG velocity;
+	LONG acceleration;
+	LONG64 displacement;
+	LONG64 horizon = Parameters->Horizon;
+	BOOLEAN confident = (Samples + 1 >= RMI4_PREDICTOR_MIN_SAMPLES);
+
+	velocity = RmiPredictorClamp(
+		((LONG64)Sample - *Position) * RMI4_PREDICTOR_TICKS_PER_SECOND / Elapsed,
+		RMI4_PREDICTOR_MAX_VELOCITY);
+
+	if (Samples >= 2)
+	{
+		//
+		// A reversal makes the previous velocity meaningless for the
+		// acceleration, start that estimate over
+		//
+		if ((velocity < 0 && *Velocity > 0) || (velocity > 0 && *Velocity < 0))
+		{
+			*Acceleration = 0;
+			confident = FALSE;
+		}
+		else
+		{
+			acceleration = RmiPredictorClamp(
+				((LONG64)velocity - *Velocity) * RMI4_PREDICTOR_TICKS_PER_SECOND / Elapsed,
+				RMI4_PREDICTOR_MAX_ACCELERATION);
+
+			*Acceleration += (acceleration - *Acceleration) / 2;
+		}
+	}
+
+	*Position = Sample;
+	*Velocity = velocity;
+
+	if (!confident ||
+		(ULONG)((velocity < 0) ? -velocity : velocity) < Parameters->MinSpeed)
+	{
+		return Sample;
+	}
+
+	displacement =
+		(LONG64)velocity * horizon / RMI4_PREDICTOR_TICKS_PER_SECOND +
+		(LONG64)*Acceleration * horizon * horizon /
+			(2LL * RMI4_PREDICTOR_TICKS_PER_SECOND * RMI4_PREDICTOR_TICKS_PER_SECOND);
+
+	//
+	// Deceleration that would carry the contact back past where it is
+	// now only means it stops within the horizon
+	//
+	if ((displacement < 0) != (velocity < 0))
+	{
+		displacement = 0;
+	}
+
+	displacement = RmiPredictorClamp(displacement, (LONG)Parameters->MaxDistance);
+	displacement += Sample;
+
+	return (USHORT)min(max(displacement, 0), MAXUSHORT);
+}
+
+VOID
+RmiPredictorCompile(
+	IN const RMI4_PREDICTOR_SETTINGS* Settings,
+	OUT RMI4_PREDICTOR_PARAMETERS* Parameters
+)
+/*++
+
+Routine Description:
+
+	Validates the prediction tuning read from the registry and compiles
+	it into the form used while servicing interrupts. Values out of
+	range are clamped.
+
+Arguments:
+
+	Settings - tuning read from the registry
+	Parameters - receives the compiled tuning
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG horizon;
+
+	horizon = min(Settings->Horizon, RMI4_PREDICTOR_MAX_HORIZON);
+
+	Parameters->Enabled = (horizon != 0);
+	Parameters->Horizon = horizon * RMI4_PREDICTOR_TICKS_PER_MS;
+	Parameters->MaxDistance = min(Settings->MaxDistance, MAXUSHORT);
+	Parameters->MinSpeed = Settings->MinSpeed;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REGISTRY,
+		"Contact prediction %s, horizon %lu ms, max distance %lu, min speed %lu",
+		Parameters->Enabled ? "enabled" : "disabled",
+		horizon,
+		Parameters->MaxDistance,
+		Parameters->MinSpeed);
+}
+
+VOID
+RmiPredictorSample(
+	IN const RMI4_PREDICTOR_PARAMETERS* Parameters,
+	IN OUT RMI4_PREDICTOR_STATE* State,
+	IN OUT PUSHORT X,
+	IN OUT PUSHORT Y,
+	IN ULONG Time
+)
+/*++
+
+Routine Description:
+
+	Feeds the next position of a contact to its history and replaces it
+	with the predicted one. A contact whose history is empty, or was
+	not seen for longer than RMI4_PREDICTOR_MAX_GAP, starts a new one.
+
+Arguments:
+
+	Parameters - compiled prediction tuning
+	State - prediction history of the contact, zeroed on touch down
+	X - X position, replaced with the predicted one
+	Y - Y position, replaced with the predicted one
+	Time - scan time of the position, in 100us units
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG elapsed = Time - State->Time;
+
+	if (State->Samples == 0 || elapsed > RMI4_PREDICTOR_MAX_GAP)
+	{
+		State->X = *X;
+		State->Y = *Y;
+		State->VelocityX = 0;
+		State->VelocityY = 0;
+		State->AccelerationX = 0;
+		State->AccelerationY = 0;
+		State->Time = Time;
+		State->Samples = 1;
+		return;
+	}
+
+	elapsed = max(elapsed, 1);
+
+	*X = RmiPredictorAxis(
+		Parameters,
+		&State->X,
+		&State->VelocityX,
+		&State->AccelerationX,
+		*X,
+		elapsed,
+		State->Samples);
+
+	*Y = RmiPredictorAxis(
+		Parameters,
+		&State->Y,
+		&State->VelocityY,
+		&State->AccelerationY,
+		*Y,
+		elapsed,
+		State->Samples);
+
+	State->Time = Time;
+	State->Samples = min(State->Samples + 1, RMI4_PREDICTOR_MIN_SAMPLES);
+}
+
+VOID
+RmiPredictContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Replaces the reported positions of the contacts in the finger cache
+	with their predicted ones, after they were filtered. The positions
+	the controller reported are left as they are. A lifted contact keeps
+	the position it was last reported at, so the lift does not jump
+	back, and its history is dropped. Called with the controller lock
+	held.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	const RMI4_PREDICTOR_PARAMETERS* parameters = &ControllerContext->Config->Predictor;
+	ULONG fingers = ControllerContext->SlotCapacity;
+	RMI4_FINGER_INFO* report;
+	ULONG now;
+	ULONG i;
+
+	//
+	// Slots marked dirty were lifted on this frame
+	//
+	for (i = find_first_bit(cache->FingerSlotDirty, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotDirty, fingers, i + 1))
+	{
+		cache->Predictor[i].Samples = 0;
+	}
+
+	if (!parameters->Enabled)
+	{
+		return;
+	}
+
+	now = (ULONG)cache->ScanTime;
+
+	for (i = find_first_bit(cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+	{
+		report = &cache->Report[i];
+
+		RmiPredictorSample(
+			parameters,
+			&cache->Predictor[i],
+			&report->x,
+			&report->y,
+			now);
+	}
+}
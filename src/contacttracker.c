@@ -0,0 +1,504 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		contacttracker.c
+
+	Abstract:
+
+		Assigns the contact IDs reported to the OS. Firmware may move a
+		contact to another slot, or hand a slot vacated by a lift to a new
+		contact within the same frame, so IDs are not taken from the slot
+		numbers but from nearest neighbour matching against the contacts
+		of the previous frame. Matching that is ambiguous falls back to
+		slot identity. The tracker works on fixed arrays of at most
+		RMI4_TRACKER_MAX_CONTACTS contacts and never allocates, with more
+		contacts down IDs follow the slots.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "rmiinternal.h"
+#include "contacttracker.h"
+#include "debug.h"
+//#include "contacttracker.tmh"
+
+static ULONG64
+RmiTrackerDistance(
+	IN const RMI4_TRACKED_CONTACT* Previous,
+	IN const RMI4_FINGER_INFO* Slot
+)
+/*++
+
+Routine Description:
+
+	Returns the squared distance between a contact and where a contact
+	of the previous frame was expected to be, had it kept moving by the
+	same amount
+
+--*/
+{
+	LONG64 dx = (LONG64)Slot->x - ((LONG64)Previous->X + Previous->DeltaX);
+	LONG64 dy = (LONG64)Slot->y - ((LONG64)Previous->Y + Previous->DeltaY);
+
+	return (ULONG64)(dx * dx + dy * dy);
+}
+
+static UCHAR
+RmiTrackerFindSlot(
+	IN const RMI4_CONTACT_TRACKER* Tracker,
+	IN ULONG Slot
+)
+{
+	ULONG p;
+
+	for (p = 0; p < Tracker->Count; p++)
+	{
+		if (Tracker->Previous[p].Slot == Slot)
+		{
+			return (UCHAR)p;
+		}
+	}
+
+	return RMI4_TRACKER_NO_MATCH;
+}
+
+static UCHAR
+RmiTrackerNewId(
+	IN OUT BITMAP_WORD* Used,
+	IN ULONG Slot,
+	IN ULONG Limit
+)
+/*++
+
+Routine Description:
+
+	Picks the ID of a new contact: the slot number when it is free, so
+	that IDs match the slots as long as the firmware keeps contacts in
+	place, else the lowest free ID. IDs stay below Limit, the Maximum
+	Count of the report descriptor, whose Contact Identifier goes up to
+	Limit - 1.
+
+Return Value:
+
+	The ID, or RMI4_TRACKER_NO_MATCH when every ID is taken
+
+--*/
+{
+	ULONG id = Slot;
+
+	if (id >= Limit || test_bit(id, Used))
+	{
+		for (id = 0; id < Limit && test_bit(id, Used); id++)
+		{
+		}
+
+		if (id == Limit)
+		{
+			return RMI4_TRACKER_NO_MATCH;
+		}
+	}
+
+	__set_bit(id, Used);
+
+	return (UCHAR)id;
+}
+
+VOID
+RmiTrackerCompile(
+	IN const RMI4_TRACKER_SETTINGS* Settings,
+	IN const TOUCH_SCREEN_PROPERTIES* Props,
+	OUT RMI4_TRACKER_PARAMETERS* Parameters
+)
+/*++
+
+Routine Description:
+
+	Compiles the contact tracking tuning read from the registry
+
+Arguments:
+
+	Settings - tuning read from the registry
+	Props - screen properties, for the default tracking distance
+	Parameters - receives the compiled tuning
+
+Return Value:
+
+	None
+
+--*/
+{
+	ULONG64 distance = Settings->MaxDistance;
+
+	if (distance == 0)
+	{
+		distance = ((ULONG64)Props->TouchPhysicalWidth + Props->TouchPhysicalHeight) /
+			RMI4_TRACKER_DISTANCE_DIVISOR;
+	}
+
+	distance = min(max(distance, 1), MAXUSHORT);
+
+	Parameters->Enabled = (Settings->Enable != 0);
+	Parameters->MaxDistanceSquared = distance * distance;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REGISTRY,
+		"Contact tracking %s, max distance %llu",
+		Parameters->Enabled ? "enabled" : "disabled",
+		distance);
+}
+
+VOID
+RmiTrackContacts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Assigns IDs to the contacts of the frame just read into the finger
+	cache, before it is filtered. Each contact is matched with a contact
+	of the previous frame when they are mutual nearest neighbours within
+	the tracking distance and no other contact is nearly as close, else
+	with the contact its slot held if that one is within the tracking
+	distance. Unmatched contacts are new.
+
+	A matched contact that changed slot takes its filter and predictor
+	state along and the lift of its old slot is hidden. A previous
+	contact left unmatched while its slot went on with a new contact is
+	queued to be reported lifted, at the position it was last reported
+	at. A new contact that finds every ID below the Maximum Count taken,
+	by contacts down or lifting on this frame, is hidden until the next
+	frame frees one. Called with the controller lock held.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	RMI4_CONTACT_TRACKER* tracker = cache->Tracker;
+	const RMI4_TRACKER_PARAMETERS* parameters = &ControllerContext->Config->Tracker;
+	ULONG fingers = ControllerContext->SlotCapacity;
+	BITMAP_WORD used[BITS_TO_WORDS(MAXUCHAR + 1)];
+	ULONG limit = min(RMI4_REPORT_MAX_COUNT(ControllerContext), MAXUCHAR);
+	UCHAR current[RMI4_TRACKER_MAX_CONTACTS];
+	UCHAR match[RMI4_TRACKER_MAX_CONTACTS];
+	UCHAR nearest[RMI4_TRACKER_MAX_CONTACTS];
+	ULONG64 best[RMI4_TRACKER_MAX_CONTACTS];
+	BOOLEAN ambiguous[RMI4_TRACKER_MAX_CONTACTS];
+	BOOLEAN primed[RMI4_TRACKER_MAX_CONTACTS];
+	RMI4_FILTER_STATE filter[RMI4_TRACKER_MAX_CONTACTS];
+	RMI4_PREDICTOR_STATE predictor[RMI4_TRACKER_MAX_CONTACTS];
+	RMI4_TRACKED_CONTACT next[RMI4_TRACKER_MAX_CONTACTS];
+	const RMI4_TRACKED_CONTACT* previous;
+	RMI4_FINGER_INFO* slot;
+	ULONG matched = 0;
+	ULONG count = 0;
+	ULONG kept = 0;
+	BOOLEAN overflow = FALSE;
+	ULONG64 distance;
+	ULONG64 second;
+	ULONG c;
+	ULONG p;
+	ULONG i;
+
+	tracker->LiftCount = 0;
+	bitmap_zero(cache->ContactHidden, fingers);
+
+	//
+	// IDs of the previous frame stay reserved on this one, including the
+	// ones of contacts lifting now
+	//
+	bitmap_zero(used, MAXUCHAR + 1);
+
+	for (i = find_first_bit(cache->ContactTracked, fingers);
+		i < fingers;
+		i = find_next_bit(cache->ContactTracked, fingers, i + 1))
+	{
+		__set_bit(cache->ContactId[i], used);
+	}
+
+	for (i = find_first_bit(cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+	{
+		if (count == RMI4_TRACKER_MAX_CONTACTS)
+		{
+			overflow = TRUE;
+			break;
+		}
+
+		current[count++] = (UCHAR)i;
+	}
+
+	if (!parameters->Enabled ||
+		overflow ||
+		tracker->Count == RMI4_TRACKER_OVERFLOW)
+	{
+		//
+		// IDs follow the slots
+		//
+		for (i = find_first_bit(cache->FingerSlotValid, fingers);
+			i < fingers;
+			i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+		{
+			if (!test_bit(i, cache->ContactTracked))
+			{
+				cache->ContactId[i] = RmiTrackerNewId(used, i, limit);
+			}
+		}
+
+		for (c = 0; c < count && tracker->Count != RMI4_TRACKER_OVERFLOW; c++)
+		{
+			match[c] = RmiTrackerFindSlot(tracker, current[c]);
+		}
+
+		goto exit;
+	}
+
+	//
+	// Nearest previous contact of each contact, and whether the next
+	// nearest is too close to tell them apart
+	//
+	for (c = 0; c < count; c++)
+	{
+		slot = &cache->FingerSlot[current[c]];
+		best[c] = MAXULONG64;
+		second = MAXULONG64;
+		match[c] = RMI4_TRACKER_NO_MATCH;
+
+		for (p = 0; p < tracker->Count; p++)
+		{
+			distance = RmiTrackerDistance(&tracker->Previous[p], slot);
+
+			if (distance < best[c])
+			{
+				second = best[c];
+				best[c] = distance;
+				match[c] = (UCHAR)p;
+			}
+			else if (distance < second)
+			{
+				second = distance;
+			}
+		}
+
+		ambiguous[c] = (second != MAXULONG64) &&
+			(second < best[c] * RMI4_TRACKER_AMBIGUITY_RATIO * RMI4_TRACKER_AMBIGUITY_RATIO);
+	}
+
+	//
+	// Nearest contact of each previous contact
+	//
+	for (p = 0; p < tracker->Count; p++)
+	{
+		second = MAXULONG64;
+		nearest[p] = RMI4_TRACKER_NO_MATCH;
+
+		for (c = 0; c < count; c++)
+		{
+			distance = RmiTrackerDistance(&tracker->Previous[p], &cache->FingerSlot[current[c]]);
+
+			if (distance < second)
+			{
+				second = distance;
+				nearest[p] = (UCHAR)c;
+			}
+		}
+	}
+
+	//
+	// Keep the unambiguous mutual nearest neighbours
+	//
+	for (c = 0; c < count; c++)
+	{
+		p = match[c];
+
+		if (p == RMI4_TRACKER_NO_MATCH ||
+			ambiguous[c] ||
+			best[c] > parameters->MaxDistanceSquared ||
+			nearest[p] != c)
+		{
+			match[c] = RMI4_TRACKER_NO_MATCH;
+			continue;
+		}
+
+		matched |= (1 << p);
+	}
+
+	//
+	// Fall back to slot identity for the others
+	//
+	for (c = 0; c < count; c++)
+	{
+		if (match[c] != RMI4_TRACKER_NO_MATCH)
+		{
+			continue;
+		}
+
+		p = RmiTrackerFindSlot(tracker, current[c]);
+
+		if (p != RMI4_TRACKER_NO_MATCH &&
+			!(matched & (1 << p)) &&
+			RmiTrackerDistance(&tracker->Previous[p], &cache->FingerSlot[current[c]]) <=
+				parameters->MaxDistanceSquared)
+		{
+			match[c] = (UCHAR)p;
+			matched |= (1 << p);
+		}
+	}
+
+	//
+	// Take the filter and predictor state of the previous contacts before
+	// any is moved to another slot
+	//
+	for (p = 0; p < tracker->Count; p++)
+	{
+		i = tracker->Previous[p].Slot;
+		filter[p] = cache->Filter[i];
+		predictor[p] = cache->Predictor[i];
+		primed[p] = test_bit(i, cache->FilterPrimed);
+	}
+
+	for (c = 0; c < count; c++)
+	{
+		i = current[c];
+		p = match[c];
+
+		if (p == RMI4_TRACKER_NO_MATCH)
+		{
+			cache->ContactId[i] = RmiTrackerNewId(used, i, limit);
+
+			//
+			// The firmware kept the slot for what is a new contact, do not
+			// smooth or extrapolate it from the old one
+			//
+			if (test_bit(i, cache->ContactTracked))
+			{
+				__clear_bit(i, cache->FilterPrimed);
+				cache->Predictor[i].Samples = 0;
+			}
+
+			continue;
+		}
+
+		cache->ContactId[i] = tracker->Previous[p].Id;
+
+		if (tracker->Previous[p].Slot != i)
+		{
+			cache->Filter[i] = filter[p];
+			cache->Predictor[i] = predictor[p];
+
+			if (primed[p])
+			{
+				__set_bit(i, cache->FilterPrimed);
+			}
+			else
+			{
+				__clear_bit(i, cache->FilterPrimed);
+			}
+		}
+	}
+
+	for (p = 0; p < tracker->Count; p++)
+	{
+		previous = &tracker->Previous[p];
+
+		if (matched & (1 << p))
+		{
+			//
+			// The contact went on in another slot, the lift of its old
+			// one must not end it
+			//
+			if (test_bit(previous->Slot, cache->FingerSlotDirty))
+			{
+				__set_bit(previous->Slot, cache->ContactHidden);
+			}
+		}
+		else if (!test_bit(previous->Slot, cache->FingerSlotDirty))
+		{
+			//
+			// Its slot went on with another contact, report it lifted
+			//
+			tracker->Lifts[tracker->LiftCount].Id = previous->Id;
+			tracker->Lifts[tracker->LiftCount].X = cache->Report[previous->Slot].x;
+			tracker->Lifts[tracker->LiftCount].Y = cache->Report[previous->Slot].y;
+			tracker->LiftCount++;
+		}
+	}
+
+exit:
+
+	//
+	// Contacts left without an ID are not reported and not remembered,
+	// they are new again on the next frame
+	//
+	RtlCopyMemory(
+		cache->ContactTracked,
+		cache->FingerSlotValid,
+		BITS_TO_WORDS(fingers) * sizeof(BITMAP_WORD));
+
+	for (i = find_first_bit(cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+	{
+		if (cache->ContactId[i] == RMI4_TRACKER_NO_MATCH)
+		{
+			__set_bit(i, cache->ContactHidden);
+			__clear_bit(i, cache->ContactTracked);
+		}
+	}
+
+	//
+	// Remember this frame for the next one
+	//
+	if (overflow)
+	{
+		tracker->Count = RMI4_TRACKER_OVERFLOW;
+	}
+	else
+	{
+		for (c = 0; c < count; c++)
+		{
+			if (!test_bit(current[c], cache->ContactTracked))
+			{
+				continue;
+			}
+
+			slot = &cache->FingerSlot[current[c]];
+
+			next[kept].Slot = current[c];
+			next[kept].Id = cache->ContactId[current[c]];
+			next[kept].X = slot->x;
+			next[kept].Y = slot->y;
+			next[kept].DeltaX = 0;
+			next[kept].DeltaY = 0;
+
+			if (tracker->Count != RMI4_TRACKER_OVERFLOW &&
+				match[c] != RMI4_TRACKER_NO_MATCH)
+			{
+				next[kept].DeltaX = (LONG)slot->x - tracker->Previous[match[c]].X;
+				next[kept].DeltaY = (LONG)slot->y - tracker->Previous[match[c]].Y;
+			}
+
+			kept++;
+		}
+
+		RtlCopyMemory(tracker->Previous, next, kept * sizeof(RMI4_TRACKED_CONTACT));
+		tracker->Count = kept;
+	}
+}
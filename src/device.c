@@ -21,7 +21,8 @@
 #include "internal.h"
 #include "controller.h"
 #include "device.h"
-#include "spb.h"
+#include "hid.h"
+#include "transport.h"
 #include "idle.h"
 #include "debug.h"
 //#include "device.tmh"
@@ -90,7 +91,7 @@ OnInterruptIsr(
 	//
     status = TchServiceInterrupts(
         devContext->TouchContext,
-        &devContext->I2CContext,
+        &devContext->SpbContext,
         devContext->InputMode,
         &hidReportsFromDriver,
         &hidReportsCount
@@ -218,12 +219,14 @@ Return Value:
 {
 	NTSTATUS status;
 	PDEVICE_EXTENSION devContext;
+	ULONG64 wakeStartTime;
 
 	devContext = GetDeviceContext(Device);
+	wakeStartTime = KeQueryInterruptTime();
 
 	UNREFERENCED_PARAMETER(PreviousState);
 
-	status = TchWakeDevice(devContext->TouchContext, &devContext->I2CContext);
+	status = TchWakeDevice(devContext->TouchContext, &devContext->SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -241,10 +244,12 @@ Return Value:
 	//
 	devContext->ServiceInterruptsAfterD0Entry = TRUE;
 
+	TchMarkStartPhase(Device, TchStartPhaseD0Entry);
+
 	//
 	// Complete any pending Idle IRPs
 	//
-	TchCompleteIdleIrp(devContext);
+	TchCompleteIdleIrp(devContext, wakeStartTime);
 
 	return status;
 }
@@ -281,7 +286,7 @@ Return Value:
 
 	UNREFERENCED_PARAMETER(TargetState);
 
-	status = TchStandbyDevice(devContext->TouchContext, &devContext->I2CContext);
+	status = TchStandbyDevice(devContext->TouchContext, &devContext->SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -334,8 +339,11 @@ OnPrepareHardware(
 	status = STATUS_INSUFFICIENT_RESOURCES;
 	devContext = GetDeviceContext(FxDevice);
 
+	TchMarkStartPhase(FxDevice, TchStartPhasePrepareHardware);
+
 	//
-	// Get the resouce hub connection ID for our I2C driver
+	// Get the resouce hub connection ID of the I2C or SPI controller and
+	// pick the RMI transport matching the bus
 	//
 	resourceCount = WdfCmResourceListGetCount(FxResourcesTranslated);
 
@@ -343,17 +351,31 @@ OnPrepareHardware(
 	{
 		res = WdfCmResourceListGetDescriptor(FxResourcesTranslated, i);
 
-		if (res->Type == CmResourceTypeConnection &&
-			res->u.Connection.Class == CM_RESOURCE_CONNECTION_CLASS_SERIAL &&
-			res->u.Connection.Type == CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C)
+		if (res->Type != CmResourceTypeConnection ||
+			res->u.Connection.Class != CM_RESOURCE_CONNECTION_CLASS_SERIAL)
 		{
-			devContext->I2CContext.I2cResHubId.LowPart =
-				res->u.Connection.IdLowPart;
-			devContext->I2CContext.I2cResHubId.HighPart =
-				res->u.Connection.IdHighPart;
+			continue;
+		}
 
-			status = STATUS_SUCCESS;
+		if (res->u.Connection.Type == CM_RESOURCE_CONNECTION_TYPE_SERIAL_I2C)
+		{
+			devContext->SpbContext.Transport = &SpbI2cTransport;
+		}
+		else if (res->u.Connection.Type == CM_RESOURCE_CONNECTION_TYPE_SERIAL_SPI)
+		{
+			devContext->SpbContext.Transport = &SpbSpiTransport;
+		}
+		else
+		{
+			continue;
 		}
+
+		devContext->SpbContext.ResHubId.LowPart =
+			res->u.Connection.IdLowPart;
+		devContext->SpbContext.ResHubId.HighPart =
+			res->u.Connection.IdHighPart;
+
+		status = STATUS_SUCCESS;
 	}
 
 	if (!NT_SUCCESS(status))
@@ -367,10 +389,16 @@ OnPrepareHardware(
 		goto exit;
 	}
 
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Using RMI over %s",
+		devContext->SpbContext.Transport->Name);
+
 	//
 	// Initialize Spb so the driver can issue reads/writes
 	//
-	status = SpbTargetInitialize(FxDevice, &devContext->I2CContext);
+	status = SpbTargetInitialize(FxDevice, &devContext->SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -383,6 +411,8 @@ OnPrepareHardware(
 		goto exit;
 	}
 
+	TchMarkStartPhase(FxDevice, TchStartPhaseTransport);
+
 	//
 	// Prepare the hardware for touch scanning
 	//
@@ -416,10 +446,12 @@ OnPrepareHardware(
 		goto exit;
 	}
 
+	TchMarkStartPhase(FxDevice, TchStartPhaseSettings);
+
 	//
 	// Start the controller
 	//
-	status = TchStartDevice(devContext->TouchContext, &devContext->I2CContext);
+	status = TchStartDevice(devContext->TouchContext, &devContext->SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -432,6 +464,25 @@ OnPrepareHardware(
 		goto exit;
 	}
 
+	//
+	// The report descriptor depends on the screen properties and the
+	// contact count of this controller
+	//
+	status = TchBuildReportDescriptor(FxDevice);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error building HID report descriptor - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	TchMarkStartPhase(FxDevice, TchStartPhaseReportDescriptor);
+
 exit:
 
 	return status;
@@ -469,7 +520,7 @@ OnReleaseHardware(
 
 	devContext = GetDeviceContext(FxDevice);
 
-	status = TchStopDevice(devContext->TouchContext, &devContext->I2CContext);
+	status = TchStopDevice(devContext->TouchContext, &devContext->SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -481,6 +532,7 @@ OnReleaseHardware(
 	}
 
 	status = TchFreeContext(devContext->TouchContext);
+	devContext->TouchContext = NULL;
 
 	if (!NT_SUCCESS(status))
 	{
@@ -491,7 +543,9 @@ OnReleaseHardware(
 			status);
 	}
 
-	SpbTargetDeinitialize(FxDevice, &GetDeviceContext(FxDevice)->I2CContext);
+	TchFreeReportDescriptor(FxDevice);
+
+	SpbTargetDeinitialize(FxDevice, &GetDeviceContext(FxDevice)->SpbContext);
 
 	return status;
 }
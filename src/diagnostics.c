@@ -0,0 +1,1173 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		diagnostics.c
+
+	Abstract:
+
+		Diagnostic device interface. Exposes driver internals such as
+		memory usage and raw capacitance frames to user mode tools
+		and takes firmware updates through device IOCTLs.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "internal.h"
+#include "controller.h"
+#include "rmiinternal.h"
+#include "debug.h"
+#include "Function34.h"
+#include "Function54.h"
+#include <wdmsec.h>
+#include <initguid.h>
+#include <devguid.h>
+#include "diagnostics.h"
+//#include "diagnostics.tmh"
+
+C_ASSERT(TOUCH_DIAG_F34_FLASH_CONFIG_ONLY == RMI4_F34_FLASH_CONFIG_ONLY);
+C_ASSERT(TOUCH_DIAG_F34_FLASH_RESUME == RMI4_F34_FLASH_RESUME);
+C_ASSERT(TOUCH_DIAG_F34_STATE_DONE == F34FlashDone);
+C_ASSERT(TOUCH_DIAG_START_D0_ENTRY == TchStartPhaseD0Entry);
+C_ASSERT(TOUCH_DIAG_START_COMPLETE == TchStartPhaseComplete);
+C_ASSERT(TOUCH_DIAG_START_PHASE_COUNT == TchStartPhaseCount);
+C_ASSERT(TOUCH_DIAG_RELOAD_REGISTERS_CHANGED == TCH_CONFIG_REGISTERS_CHANGED);
+C_ASSERT(TOUCH_DIAG_RELOAD_REGISTERS_PENDING == TCH_CONFIG_REGISTERS_PENDING);
+
+static NTSTATUS
+TchDiagGetMemoryUsage(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request,
+	OUT size_t* BytesReturned
+)
+/*++
+
+Routine Description:
+
+	Reports the memory held for the touch controller, including the
+	F12 register descriptor arena.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+	BytesReturned - Receives the number of bytes written to the output
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PTOUCH_DIAG_MEMORY_USAGE usage;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_MEMORY_USAGE),
+		(PVOID*)&usage,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	RtlZeroMemory(usage, sizeof(TOUCH_DIAG_MEMORY_USAGE));
+	usage->Size = sizeof(TOUCH_DIAG_MEMORY_USAGE);
+	usage->ControllerContextBytes = sizeof(RMI4_CONTROLLER_CONTEXT);
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	if (controller->BklContext != NULL)
+	{
+		usage->BacklightContextBytes = sizeof(BKL_CONTEXT);
+	}
+
+	usage->F12DescriptorArenaBytes = (ULONG)controller->Setup->F12DescArena.Size;
+	usage->F12DescriptorArenaUsed = (ULONG)controller->Setup->F12DescArena.Used;
+	usage->F12RegisterCount =
+		controller->Setup->QueryRegDesc.NumRegisters +
+		controller->Setup->ControlRegDesc.NumRegisters +
+		controller->Setup->DataRegDesc.NumRegisters;
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	*BytesReturned = sizeof(TOUCH_DIAG_MEMORY_USAGE);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagF54Start(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request
+)
+/*++
+
+Routine Description:
+
+	Starts streaming F54 reports into the output buffer of the request.
+	The buffer is locked and mapped once, frames are read from the
+	controller straight into it. The request stays pending in the F54
+	queue until the stream is stopped or the request is cancelled.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+
+Return Value:
+
+	STATUS_PENDING if the request now backs the stream, otherwise the
+	status to complete the request with
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PTOUCH_DIAG_F54_START start;
+	PMDL mdl;
+	PVOID ring;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_F54_START),
+		(PVOID*)&start,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfRequestRetrieveOutputWdmMdl(Request, &mdl);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	ring = MmGetSystemAddressForMdlSafe(mdl, NormalPagePriority | MdlMappingNoExecute);
+
+	if (ring == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	if (start->ReportType > MAXUCHAR)
+	{
+		status = STATUS_INVALID_PARAMETER;
+		goto exit;
+	}
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	status = RmiF54StartStream(
+		controller,
+		(UCHAR)start->ReportType,
+		ring,
+		MmGetMdlByteCount(mdl));
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfRequestForwardToIoQueue(Request, DevContext->F54Queue);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REPORTING,
+			"Error queueing F54 stream request - STATUS:%X",
+			status);
+
+		WdfWaitLockAcquire(controller->ControllerLock, NULL);
+		RmiF54StopStream(controller);
+		WdfWaitLockRelease(controller->ControllerLock);
+
+		goto exit;
+	}
+
+	status = STATUS_PENDING;
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagF54Stop(
+	IN PDEVICE_EXTENSION DevContext
+)
+/*++
+
+Routine Description:
+
+	Stops the F54 stream and completes the request backing its ring.
+
+Arguments:
+
+	DevContext - Device context
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	WDFREQUEST streamRequest;
+	NTSTATUS status;
+
+	status = WdfIoQueueRetrieveNextRequest(DevContext->F54Queue, &streamRequest);
+
+	if (!NT_SUCCESS(status))
+	{
+		status = STATUS_INVALID_DEVICE_STATE;
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller != NULL)
+	{
+		WdfWaitLockAcquire(controller->ControllerLock, NULL);
+		RmiF54StopStream(controller);
+		WdfWaitLockRelease(controller->ControllerLock);
+	}
+
+	WdfRequestComplete(streamRequest, STATUS_SUCCESS);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagF34Flash(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request
+)
+/*++
+
+Routine Description:
+
+	Flashes the firmware image in the output buffer of the request and
+	restarts the controller through the regular start path, with the
+	interrupt disabled. A firmware that changes the contact count, or
+	that the controller cannot be started with, has the device
+	re-enumerated so the report descriptor is built again. A capture
+	in progress is stopped first. The request completes once the update
+	is done or has failed, progress is read back with
+	IOCTL_TOUCH_DIAG_F34_GET_PROGRESS.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PTOUCH_DIAG_F34_FLASH flash;
+	PMDL mdl;
+	PUCHAR image;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveInputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_F34_FLASH),
+		(PVOID*)&flash,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfRequestRetrieveOutputWdmMdl(Request, &mdl);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	image = MmGetSystemAddressForMdlSafe(mdl, NormalPagePriority | MdlMappingNoExecute);
+
+	if (image == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	//
+	// The restart frees the F12 register descriptors and the backlight
+	// context, which the ISR uses outside the controller lock. Keep the
+	// ISR from running until the controller is back; disabling waits
+	// for one in progress.
+	//
+	WdfInterruptDisable(DevContext->InterruptObject);
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	RmiF54StopStream(controller);
+
+	status = RmiF34Flash(
+		controller,
+		&DevContext->SpbContext,
+		image,
+		MmGetMdlByteCount(mdl),
+		flash->Flags);
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		WdfInterruptEnable(DevContext->InterruptObject);
+		goto exit;
+	}
+
+	TchStopDevice(controller, &DevContext->SpbContext);
+
+	status = TchStartDevice(controller, &DevContext->SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error restarting touch device after update - STATUS:%X",
+			status);
+	}
+	else if (RMI4_REPORT_MAX_COUNT(controller) != DevContext->ReportMaxCount)
+	{
+		//
+		// The report descriptor HIDClass holds was built for the contact
+		// count of the previous firmware
+		//
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Contact count changed from %u to %u, re-enumerating",
+			DevContext->ReportMaxCount,
+			RMI4_REPORT_MAX_COUNT(controller));
+
+		status = STATUS_DEVICE_CONFIGURATION_ERROR;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		//
+		// The interrupt stays disabled, the framework enables it again
+		// when the restarted device enters D0
+		//
+		WdfDeviceSetFailed(DevContext->FxDevice, WdfDeviceFailedAttemptRestart);
+		goto exit;
+	}
+
+	WdfInterruptEnable(DevContext->InterruptObject);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagF34GetProgress(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request,
+	OUT size_t* BytesReturned
+)
+/*++
+
+Routine Description:
+
+	Reports the progress of the last firmware update.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+	BytesReturned - Receives the number of bytes written to the output
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	RMI4_F34_FLASH* flash;
+	PTOUCH_DIAG_F34_PROGRESS progress;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_F34_PROGRESS),
+		(PVOID*)&progress,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	flash = &controller->F34Flash;
+
+	RtlZeroMemory(progress, sizeof(TOUCH_DIAG_F34_PROGRESS));
+	progress->Size = sizeof(TOUCH_DIAG_F34_PROGRESS);
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	progress->State = flash->State;
+	progress->Flags = flash->Flags;
+	progress->LastStatus = flash->LastStatus;
+	progress->ControllerStatus = flash->ControllerStatus;
+	progress->BlockSize = flash->Query.BlockSize;
+	progress->FirmwareBlocks = flash->Query.FirmwareBlocks;
+	progress->ConfigBlocks = flash->Query.ConfigBlocks;
+	progress->NextBlock = flash->NextBlock;
+	progress->BytesWritten = flash->BytesWritten;
+	progress->BytesVerified = flash->BytesVerified;
+	progress->ElapsedTime = flash->ElapsedTime;
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	*BytesReturned = sizeof(TOUCH_DIAG_F34_PROGRESS);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagGetStartTimeline(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request,
+	OUT size_t* BytesReturned
+)
+/*++
+
+Routine Description:
+
+	Reports when each phase of the last device start completed, relative
+	to the start of OnPrepareHardware.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+	BytesReturned - Receives the number of bytes written to the output
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PTOUCH_DIAG_START_TIMELINE timeline;
+	ULONG64 startTime;
+	ULONG i;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_START_TIMELINE),
+		(PVOID*)&timeline,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	RtlZeroMemory(timeline, sizeof(TOUCH_DIAG_START_TIMELINE));
+	timeline->Size = sizeof(TOUCH_DIAG_START_TIMELINE);
+	timeline->PhaseCount = TOUCH_DIAG_START_PHASE_COUNT;
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	if (controller->Setup->TopologyCached)
+	{
+		timeline->Flags |= TOUCH_DIAG_START_TOPOLOGY_PERSISTED;
+	}
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	startTime = DevContext->StartPhaseTime[TchStartPhasePrepareHardware];
+
+	for (i = 0; i < TOUCH_DIAG_START_PHASE_COUNT; i++)
+	{
+		if (DevContext->StartPhaseTime[i] == 0)
+		{
+			timeline->PhaseTime[i] = MAXULONG64;
+		}
+		else
+		{
+			timeline->PhaseTime[i] = DevContext->StartPhaseTime[i] - startTime;
+		}
+	}
+
+	*BytesReturned = sizeof(TOUCH_DIAG_START_TIMELINE);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagGetStatistics(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request,
+	OUT size_t* BytesReturned
+)
+/*++
+
+Routine Description:
+
+	Reports the screen-off, idle and backlight re-enable counters and
+	latencies.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+	BytesReturned - Receives the number of bytes written to the output
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PTOUCH_DIAG_STATISTICS statistics;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_STATISTICS),
+		(PVOID*)&statistics,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)DevContext->TouchContext;
+
+	if (controller == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	RtlZeroMemory(statistics, sizeof(TOUCH_DIAG_STATISTICS));
+	statistics->Size = sizeof(TOUCH_DIAG_STATISTICS);
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	statistics->ScreenOffTransitions = controller->ScreenOffTransitions;
+	statistics->ScreenOffLatency = controller->ScreenOffLatency;
+	statistics->ScreenOnLatency = controller->ScreenOnLatency;
+
+	if (controller->BklContext != NULL)
+	{
+		statistics->BacklightReenableRequests = (ULONG)controller->BklContext->ReenableRequests;
+		statistics->BacklightReenables = controller->BklContext->ReenableCount;
+	}
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	statistics->IdleRequests = (ULONG)DevContext->IdleStats.Requests;
+	statistics->IdleCompletions = (ULONG)DevContext->IdleStats.Completions;
+	statistics->IdleCancellations = (ULONG)DevContext->IdleStats.Cancellations;
+	statistics->IdleLastEntryLatency = DevContext->IdleStats.LastEntryLatency;
+	statistics->IdleMaxEntryLatency = DevContext->IdleStats.MaxEntryLatency;
+	statistics->IdleLastExitLatency = DevContext->IdleStats.LastExitLatency;
+	statistics->IdleMaxExitLatency = DevContext->IdleStats.MaxExitLatency;
+
+	*BytesReturned = sizeof(TOUCH_DIAG_STATISTICS);
+
+exit:
+	return status;
+}
+
+static NTSTATUS
+TchDiagReloadConfiguration(
+	IN PDEVICE_EXTENSION DevContext,
+	IN WDFREQUEST Request,
+	OUT size_t* BytesReturned
+)
+/*++
+
+Routine Description:
+
+	Reads the registry configuration again and publishes it in place of
+	the running one.
+
+Arguments:
+
+	DevContext - Device context
+	Request - The IOCTL request
+	BytesReturned - Receives the number of bytes written to the output
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	PTOUCH_DIAG_RELOAD_CONFIG reload;
+	ULONG version;
+	ULONG flags;
+	NTSTATUS status;
+
+	status = WdfRequestRetrieveOutputBuffer(
+		Request,
+		sizeof(TOUCH_DIAG_RELOAD_CONFIG),
+		(PVOID*)&reload,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (DevContext->TouchContext == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	status = TchReloadConfiguration(
+		DevContext->TouchContext,
+		&DevContext->SpbContext,
+		&version,
+		&flags);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	RtlZeroMemory(reload, sizeof(TOUCH_DIAG_RELOAD_CONFIG));
+	reload->Size = sizeof(TOUCH_DIAG_RELOAD_CONFIG);
+	reload->Version = version;
+	reload->Flags = flags;
+
+	*BytesReturned = sizeof(TOUCH_DIAG_RELOAD_CONFIG);
+
+exit:
+	return status;
+}
+
+VOID
+TchDiagF54RequestCanceled(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request
+)
+/*++
+
+Routine Description:
+
+	Stops the F54 stream when the request backing its ring is cancelled,
+	typically because the tool exited or closed its handle.
+
+Arguments:
+
+	Queue - Handle to the F54 queue
+	Request - The cancelled stream request
+
+Return Value:
+
+	None
+
+--*/
+{
+	PDEVICE_EXTENSION devContext;
+	RMI4_CONTROLLER_CONTEXT* controller;
+
+	devContext = GetDeviceContext(WdfIoQueueGetDevice(Queue));
+	controller = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+
+	if (controller != NULL)
+	{
+		WdfWaitLockAcquire(controller->ControllerLock, NULL);
+		RmiF54StopStream(controller);
+		WdfWaitLockRelease(controller->ControllerLock);
+	}
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+}
+
+VOID
+TchDiagOnDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+/*++
+
+Routine Description:
+
+	Dispatches IOCTLs sent to the diagnostic device interface.
+
+Arguments:
+
+	Queue - Handle to the diagnostic queue
+	Request - Handle to a framework request object
+	OutputBufferLength - Length of the request's output buffer
+	InputBufferLength - Length of the request's input buffer
+	IoControlCode - The diagnostic IOCTL
+
+Return Value:
+
+	None, status is indicated when completing the request
+
+--*/
+{
+	PDEVICE_EXTENSION devContext;
+	size_t bytesReturned = 0;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+
+	devContext = GetDeviceContext(WdfIoQueueGetDevice(Queue));
+
+	switch (IoControlCode)
+	{
+	case IOCTL_TOUCH_DIAG_GET_MEMORY_USAGE:
+		status = TchDiagGetMemoryUsage(devContext, Request, &bytesReturned);
+		break;
+
+	case IOCTL_TOUCH_DIAG_F54_START:
+		status = TchDiagF54Start(devContext, Request);
+		break;
+
+	case IOCTL_TOUCH_DIAG_F54_STOP:
+		status = TchDiagF54Stop(devContext);
+		break;
+
+	case IOCTL_TOUCH_DIAG_F34_FLASH:
+		status = TchDiagF34Flash(devContext, Request);
+		break;
+
+	case IOCTL_TOUCH_DIAG_F34_GET_PROGRESS:
+		status = TchDiagF34GetProgress(devContext, Request, &bytesReturned);
+		break;
+
+	case IOCTL_TOUCH_DIAG_GET_START_TIMELINE:
+		status = TchDiagGetStartTimeline(devContext, Request, &bytesReturned);
+		break;
+
+	case IOCTL_TOUCH_DIAG_RELOAD_CONFIG:
+		status = TchDiagReloadConfiguration(devContext, Request, &bytesReturned);
+		break;
+
+	case IOCTL_TOUCH_DIAG_GET_STATISTICS:
+		status = TchDiagGetStatistics(devContext, Request, &bytesReturned);
+		break;
+
+	default:
+		status = STATUS_INVALID_DEVICE_REQUEST;
+		break;
+	}
+
+	//
+	// A started stream keeps its request pending in the F54 queue
+	//
+	if (status == STATUS_PENDING)
+	{
+		return;
+	}
+
+	WdfRequestCompleteWithInformation(Request, status, bytesReturned);
+}
+
+VOID
+TchDiagPdoOnDeviceControl(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request,
+	IN size_t OutputBufferLength,
+	IN size_t InputBufferLength,
+	IN ULONG IoControlCode
+)
+/*++
+
+Routine Description:
+
+	Handles IOCTLs sent to the diagnostic PDO by forwarding them to the
+	diagnostic queue of the touch device
+
+Arguments:
+
+	Queue - Default queue of the diagnostic PDO
+	Request - Framework request object
+	OutputBufferLength - Length of the output buffer
+	InputBufferLength - Length of the input buffer
+	IoControlCode - IOCTL code
+
+Return Value:
+
+	None, status is indicated when completing the request
+
+--*/
+{
+	TOUCH_DIAG_PDO_CONTEXT* pdoContext;
+	WDF_REQUEST_FORWARD_OPTIONS forwardOptions;
+	NTSTATUS status;
+
+	UNREFERENCED_PARAMETER(OutputBufferLength);
+	UNREFERENCED_PARAMETER(InputBufferLength);
+	UNREFERENCED_PARAMETER(IoControlCode);
+
+	pdoContext = GetDiagPdoContext(WdfIoQueueGetDevice(Queue));
+
+	WDF_REQUEST_FORWARD_OPTIONS_INIT(&forwardOptions);
+
+	status = WdfRequestForwardToParentDeviceIoQueue(
+		Request,
+		pdoContext->ParentQueue,
+		&forwardOptions);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_OTHER,
+			"Error forwarding diagnostic request - STATUS:%X",
+			status);
+
+		WdfRequestComplete(Request, status);
+	}
+}
+
+NTSTATUS
+TchDiagCreatePdo(
+	IN WDFDEVICE FxDevice,
+	IN WDFQUEUE ParentQueue,
+	OUT WDFDEVICE* Pdo
+)
+/*++
+
+Routine Description:
+
+	Creates the raw PDO the diagnostic interface is exposed on. The touch
+	device itself sits below HID class, which does not pass device
+	IOCTLs down, so user mode tools open this child instead. Tools can
+	flash firmware through it, so it is restricted to SYSTEM and
+	administrators.
+
+Arguments:
+
+	FxDevice - Framework device object of the touch device
+	ParentQueue - Queue of the touch device requests are forwarded to
+	Pdo - Receives the diagnostic PDO
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	DECLARE_CONST_UNICODE_STRING(deviceId, TOUCH_DIAG_PDO_DEVICE_ID);
+	DECLARE_CONST_UNICODE_STRING(instanceId, TOUCH_DIAG_PDO_INSTANCE_ID);
+	DECLARE_CONST_UNICODE_STRING(description, TOUCH_DIAG_PDO_DESCRIPTION);
+	DECLARE_CONST_UNICODE_STRING(location, TOUCH_DIAG_PDO_LOCATION);
+
+	PWDFDEVICE_INIT deviceInit;
+	WDF_OBJECT_ATTRIBUTES attributes;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	WDF_DEVICE_PNP_CAPABILITIES pnpCaps;
+	WDFDEVICE pdo;
+	NTSTATUS status;
+
+	pdo = NULL;
+
+	deviceInit = WdfPdoInitAllocate(FxDevice);
+
+	if (deviceInit == NULL)
+	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
+
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error allocating diagnostic PDO init - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = WdfPdoInitAssignRawDevice(deviceInit, &GUID_DEVCLASS_HIDCLASS);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfDeviceInitAssignSDDLString(deviceInit, &SDDL_DEVOBJ_SYS_ALL_ADM_ALL);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfPdoInitAssignDeviceID(deviceInit, &deviceId);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfPdoInitAssignInstanceID(deviceInit, &instanceId);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = WdfPdoInitAddDeviceText(deviceInit, &description, &location, 0x409);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	WdfPdoInitSetDefaultLocale(deviceInit, 0x409);
+	WdfPdoInitAllowForwardingRequestToParent(deviceInit);
+
+	WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&attributes, TOUCH_DIAG_PDO_CONTEXT);
+
+	status = WdfDeviceCreate(&deviceInit, &attributes, &pdo);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating diagnostic PDO - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	GetDiagPdoContext(pdo)->ParentQueue = ParentQueue;
+
+	WDF_DEVICE_PNP_CAPABILITIES_INIT(&pnpCaps);
+	pnpCaps.SurpriseRemovalOK = WdfTrue;
+	pnpCaps.NoDisplayInUI = WdfTrue;
+
+	WdfDeviceSetPnpCapabilities(pdo, &pnpCaps);
+
+	WDF_IO_QUEUE_CONFIG_INIT_DEFAULT_QUEUE(&queueConfig, WdfIoQueueDispatchSequential);
+	queueConfig.EvtIoDeviceControl = TchDiagPdoOnDeviceControl;
+
+	status = WdfIoQueueCreate(
+		pdo,
+		&queueConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		WDF_NO_HANDLE);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating diagnostic PDO queue - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = WdfDeviceCreateDeviceInterface(
+		pdo,
+		&GUID_DEVINTERFACE_TOUCH_DIAGNOSTICS,
+		NULL);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating diagnostic device interface - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = WdfFdoAddStaticChild(FxDevice, pdo);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error adding diagnostic PDO - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	*Pdo = pdo;
+	pdo = NULL;
+
+exit:
+
+	if (deviceInit != NULL)
+	{
+		WdfDeviceInitFree(deviceInit);
+	}
+
+	if (pdo != NULL)
+	{
+		WdfObjectDelete(pdo);
+	}
+
+	return status;
+}
+
+NTSTATUS
+TchDiagInitialize(
+	IN WDFDEVICE FxDevice
+)
+/*++
+
+Routine Description:
+
+	Creates the diagnostic queue and the raw PDO that exposes the
+	diagnostic device interface. The queue is power managed, so requests
+	only reach the driver while the controller context exists.
+
+Arguments:
+
+	FxDevice - Framework device object
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	PDEVICE_EXTENSION devContext;
+	WDF_IO_QUEUE_CONFIG queueConfig;
+	WDF_OBJECT_ATTRIBUTES queueAttributes;
+	NTSTATUS status;
+
+	devContext = GetDeviceContext(FxDevice);
+
+	//
+	// The F54 queue holds the request backing a capture ring. It is not
+	// power managed so the ring survives idle transitions, and it runs
+	// at passive level since cancellation waits on the controller lock.
+	//
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
+	queueConfig.PowerManaged = WdfFalse;
+	queueConfig.EvtIoCanceledOnQueue = TchDiagF54RequestCanceled;
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&queueAttributes);
+	queueAttributes.ExecutionLevel = WdfExecutionLevelPassive;
+
+	status = WdfIoQueueCreate(
+		FxDevice,
+		&queueConfig,
+		&queueAttributes,
+		&devContext->F54Queue);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating F54 queue - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchSequential);
+	queueConfig.EvtIoDeviceControl = TchDiagOnDeviceControl;
+
+	status = WdfIoQueueCreate(
+		FxDevice,
+		&queueConfig,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&devContext->TestQueue);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating diagnostic queue - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = TchDiagCreatePdo(FxDevice, devContext->TestQueue, &devContext->DiagPdo);
+
+exit:
+
+	return status;
+}
@@ -24,7 +24,9 @@
 #include "device.h"
 #include "hid.h"
 #include "queue.h"
+#include "idle.h"
 #include "debug.h"
+#include "diagnostics.h"
 
 //#include "driver.tmh"
 
@@ -206,6 +208,7 @@ Return Value:
 	WDF_INTERRUPT_CONFIG interruptConfig;
 	WDF_PNPPOWER_EVENT_CALLBACKS pnpPowerCallbacks;
 	WDF_IO_QUEUE_CONFIG queueConfig;
+	WDF_WORKITEM_CONFIG workitemConfig;
 	NTSTATUS status;
 
 	UNREFERENCED_PARAMETER(Driver);
@@ -319,6 +322,7 @@ Return Value:
 	WDF_IO_QUEUE_CONFIG_INIT(&queueConfig, WdfIoQueueDispatchManual);
 
 	queueConfig.PowerManaged = WdfFalse;
+	queueConfig.EvtIoCanceledOnQueue = TchIdleRequestCanceledOnQueue;
 
 	status = WdfIoQueueCreate(
 		fxDevice,
@@ -338,6 +342,46 @@ Return Value:
 		goto exit;
 	}
 
+	//
+	// The idle callback is invoked from a work item, which is allocated
+	// once here and reused for every idle notification request
+	//
+	WDF_WORKITEM_CONFIG_INIT(&workitemConfig, TchIdleIrpWorkitem);
+	WDF_OBJECT_ATTRIBUTES_INIT(&attributes);
+	attributes.ParentObject = fxDevice;
+
+	status = WdfWorkItemCreate(
+		&workitemConfig,
+		&attributes,
+		&devContext->IdleWorkItem);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error creating idle work item - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	devContext->IdleState = IdleStateActive;
+
+	//
+	// Diagnostics are optional, the touch stack works without them
+	//
+	status = TchDiagInitialize(fxDevice);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Warning, diagnostic interface unavailable - STATUS:%X",
+			status);
+	}
+
 	//
 	// Create an interrupt object for hardware notifications
 	//
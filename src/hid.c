@@ -98,106 +98,136 @@ const HID_DESCRIPTOR gHidDescriptor =
 };
 
 NTSTATUS
-TchGenerateHidReportDescriptor
-(
-	IN PDEVICE_EXTENSION Context,
-	IN WDFMEMORY outMemory
+TchBuildReportDescriptor(
+	IN WDFDEVICE Device
 )
-{
-	NTSTATUS status = 0;
-	RMI4_CONTROLLER_CONTEXT* touchContext = (RMI4_CONTROLLER_CONTEXT*)Context->TouchContext;
+/*++
+
+Routine Description:
+
+	Builds this device's copy of the report descriptor, with the touch
+	extents and contact count of the controller it was started with
+	patched over the placeholders. It is built once when the hardware is
+	prepared and not changed until it is released.
+
+Arguments:
+
+	Device - Handle to WDF Device Object
+
+Return Value:
 
-	PUCHAR hidReportDescBuffer = (PUCHAR)ExAllocatePoolWithTag(
-		NonPagedPool,
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	PDEVICE_EXTENSION devContext = GetDeviceContext(Device);
+	RMI4_CONTROLLER_CONTEXT* touchContext = (RMI4_CONTROLLER_CONTEXT*)devContext->TouchContext;
+	PUCHAR hidReportDescBuffer;
+	ULONG displayWidth;
+	ULONG displayHeight;
+	USHORT maxCount;
+	ULONG i;
+
+	NT_ASSERT(devContext->ReportDescriptor == NULL);
+
+	displayWidth = touchContext->Config->Props.DisplayPhysicalWidth;
+	displayHeight = touchContext->Config->Props.DisplayPhysicalHeight;
+	maxCount = RMI4_REPORT_MAX_COUNT(touchContext);
+
+	hidReportDescBuffer = (PUCHAR)ExAllocatePoolWithTag(
+		NonPagedPoolNx,
 		gdwcbReportDescriptor,
-		TOUCH_POOL_TAG
-	);
+		TOUCH_POOL_TAG);
 
 	if (hidReportDescBuffer == NULL)
 	{
 		Trace(
-			TRACE_LEVEL_INFORMATION,
+			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_HID,
-			"Failed to create hidReportDescBuffer on %p",
-			hidReportDescBuffer);
+			"Failed to allocate the HID report descriptor");
 
-		return STATUS_FATAL_MEMORY_EXHAUSTION;
+		return STATUS_INSUFFICIENT_RESOURCES;
 	}
 
-	Trace(
-		TRACE_LEVEL_INFORMATION,
-		TRACE_FLAG_HID,
-		"Created hidReportDescBuffer on %p",
-		hidReportDescBuffer);
-
 	RtlCopyBytes(
 		hidReportDescBuffer,
 		gReportDescriptor,
-		gdwcbReportDescriptor
-	);
+		gdwcbReportDescriptor);
 
-	for (unsigned int i = 0; i < gdwcbReportDescriptor - 2; i++)
+	for (i = 0; i < gdwcbReportDescriptor - 2; i++)
 	{
-		if (*(hidReportDescBuffer + i) == LOGICAL_MAXIMUM_2)
+		if (hidReportDescBuffer[i] != LOGICAL_MAXIMUM_2)
 		{
-			if (*(hidReportDescBuffer + i + 1) == 254 &&
-				*(hidReportDescBuffer + i + 2) == 254)
-			{
-				*(hidReportDescBuffer + i + 1) = touchContext->Props.DisplayPhysicalWidth & 0xff;
-				*(hidReportDescBuffer + i + 2) = (touchContext->Props.DisplayPhysicalWidth >> 8) & 0xff;
-
-				Trace(
-					TRACE_LEVEL_INFORMATION,
-					TRACE_FLAG_HID,
-					"Set X=%u in %p",
-					touchContext->Props.DisplayPhysicalWidth,
-					hidReportDescBuffer + i);
-			}
-			if (*(hidReportDescBuffer + i + 1) == 253 &&
-				*(hidReportDescBuffer + i + 2) == 253)
-			{
-				*(hidReportDescBuffer + i + 1) = touchContext->Props.DisplayPhysicalHeight & 0xff;
-				*(hidReportDescBuffer + i + 2) = (touchContext->Props.DisplayPhysicalHeight >> 8) & 0xff;
-
-				Trace(
-					TRACE_LEVEL_INFORMATION,
-					TRACE_FLAG_HID,
-					"Set Y=%u in %p",
-					touchContext->Props.DisplayPhysicalHeight,
-					hidReportDescBuffer + i);
-			}
+			continue;
+		}
+
+		if (hidReportDescBuffer[i + 1] == 254 &&
+			hidReportDescBuffer[i + 2] == 254)
+		{
+			hidReportDescBuffer[i + 1] = displayWidth & 0xff;
+			hidReportDescBuffer[i + 2] = (displayWidth >> 8) & 0xff;
+		}
+		else if (hidReportDescBuffer[i + 1] == 253 &&
+			hidReportDescBuffer[i + 2] == 253)
+		{
+			hidReportDescBuffer[i + 1] = displayHeight & 0xff;
+			hidReportDescBuffer[i + 2] = (displayHeight >> 8) & 0xff;
+		}
+		else if (hidReportDescBuffer[i + 1] == 252 &&
+			hidReportDescBuffer[i + 2] == 252)
+		{
+			hidReportDescBuffer[i + 1] = maxCount & 0xff;
+			hidReportDescBuffer[i + 2] = (maxCount >> 8) & 0xff;
+		}
+		else if (hidReportDescBuffer[i + 1] == 251 &&
+			hidReportDescBuffer[i + 2] == 251)
+		{
+			hidReportDescBuffer[i + 1] = (maxCount - 1) & 0xff;
+			hidReportDescBuffer[i + 2] = ((maxCount - 1) >> 8) & 0xff;
 		}
 	}
 
 	Trace(
 		TRACE_LEVEL_INFORMATION,
 		TRACE_FLAG_HID,
-		"Set X=%u and Y=%u in hidReportDescriptor",
-		touchContext->Props.DisplayPhysicalWidth,
-		touchContext->Props.DisplayPhysicalHeight);
+		"Set X=%u, Y=%u and Maximum Count=%u in hidReportDescriptor",
+		displayWidth,
+		displayHeight,
+		maxCount);
 
-	//
-	// Use hardcoded Report descriptor
-	//
-	status = WdfMemoryCopyFromBuffer(
-		outMemory,
-		0,
-		(PVOID)hidReportDescBuffer,
-		gdwcbReportDescriptor);
+	devContext->ReportDescriptor = hidReportDescBuffer;
+	devContext->ReportMaxCount = maxCount;
 
-	if (!NT_SUCCESS(status))
+	return STATUS_SUCCESS;
+}
+
+VOID
+TchFreeReportDescriptor(
+	IN WDFDEVICE Device
+)
+/*++
+
+Routine Description:
+
+	Releases the report descriptor built by TchBuildReportDescriptor
+
+Arguments:
+
+	Device - Handle to WDF Device Object
+
+Return Value:
+
+	None
+
+--*/
+{
+	PDEVICE_EXTENSION devContext = GetDeviceContext(Device);
+
+	if (devContext->ReportDescriptor != NULL)
 	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_HID,
-			"Error copying HID report descriptor to request memory - STATUS:%X",
-			status);
-		goto exit;
+		ExFreePoolWithTag(devContext->ReportDescriptor, TOUCH_POOL_TAG);
+		devContext->ReportDescriptor = NULL;
 	}
-
-exit:
-	ExFreePoolWithTag((PVOID)hidReportDescBuffer, TOUCH_POOL_TAG);
-	return status;
 }
 
 NTSTATUS
@@ -263,7 +293,7 @@ Return Value:
 
 			TchServiceInterrupts(
 				devContext->TouchContext,
-				&devContext->I2CContext,
+				&devContext->SpbContext,
 				devContext->InputMode,
                 &hidReports,
 				&reportsCount);
@@ -464,11 +494,10 @@ Return Value:
 
 --*/
 {
+	PDEVICE_EXTENSION devContext;
 	WDFMEMORY memory;
 	NTSTATUS status;
 
-	UNREFERENCED_PARAMETER(Device);
-
 	//
 	// This IOCTL is METHOD_NEITHER so WdfRequestRetrieveOutputMemory
 	// will correctly retrieve buffer from Irp->UserBuffer.
@@ -490,11 +519,27 @@ Return Value:
 		goto exit;
 	}
 
-	PDEVICE_EXTENSION devCtx = GetDeviceContext(Device);
+	devContext = GetDeviceContext(Device);
+
+	if (devContext->ReportDescriptor == NULL)
+	{
+		status = STATUS_DEVICE_NOT_READY;
+		goto exit;
+	}
+
+	status = WdfMemoryCopyFromBuffer(
+		memory,
+		0,
+		devContext->ReportDescriptor,
+		gdwcbReportDescriptor);
 
-	status = TchGenerateHidReportDescriptor(devCtx, memory);
 	if (!NT_SUCCESS(status))
 	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_HID,
+			"Error copying HID report descriptor to request memory - STATUS:%X",
+			status);
 		goto exit;
 	}
 
@@ -1,29 +0,0 @@
-/* HWeight Linux Port */
-#include <wdm.h>
-#include <wdf.h>
-#include <hweight.h>
-
-
-unsigned int hweight32(unsigned int w)
-{
-	unsigned int res = w - ((w >> 1) & 0x55555555);
-	res = (res & 0x33333333) + ((res >> 2) & 0x33333333);
-	res = (res + (res >> 4)) & 0x0F0F0F0F;
-	res = res + (res >> 8);
-	return (res + (res >> 16)) & 0x000000FF;
-}
-
-ULONGLONG hweight64(ULONGLONG w)
-{
-#if ARM || X86
-	return hweight32((unsigned int)(w >> 32)) +
-		hweight32((unsigned int)w);
-#else
-	ULONGLONG res = w - ((w >> 1) & 0x5555555555555555ul);
-	res = (res & 0x3333333333333333ul) + ((res >> 2) & 0x3333333333333333ul);
-	res = (res + (res >> 4)) & 0x0F0F0F0F0F0F0F0Ful;
-	res = res + (res >> 8);
-	res = res + (res >> 16);
-	return (res + (res >> 32)) & 0x00000000000000FFul;
-#endif
-}
\ No newline at end of file
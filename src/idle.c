@@ -118,53 +118,40 @@ Return Value:
 		goto exit;
 	}
 
+	//
+	// HIDClass only keeps one idle notification outstanding, a second
+	// one while the first is still held is a protocol violation
+	//
+	if (InterlockedCompareExchange(
+		&devContext->IdleState,
+		IdleStatePending,
+		IdleStateActive) != IdleStateActive)
 	{
-		//
-		// Create a workitem for the idle callback
-		//
-		WDF_OBJECT_ATTRIBUTES workItemAttributes;
-		WDF_WORKITEM_CONFIG workitemConfig;
-		WDFWORKITEM idleWorkItem;
-		PIDLE_WORKITEM_CONTEXT idleWorkItemContext;
-
-		WDF_OBJECT_ATTRIBUTES_INIT_CONTEXT_TYPE(&workItemAttributes, IDLE_WORKITEM_CONTEXT);
-		workItemAttributes.ParentObject = devContext->FxDevice;
-
-		WDF_WORKITEM_CONFIG_INIT(&workitemConfig, TchIdleIrpWorkitem);
-
-		status = WdfWorkItemCreate(
-			&workitemConfig,
-			&workItemAttributes,
-			&idleWorkItem
-		);
-
-		if (!NT_SUCCESS(status)) {
-			Trace(
-				TRACE_LEVEL_ERROR,
-				TRACE_FLAG_HID,
-				"Error creating creating idle work item - STATUS:%X",
-				status);
-			goto exit;
-		}
+		status = STATUS_DEVICE_BUSY;
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_IDLE,
+			"Error: Idle Notification request %p received while another is held - STATUS:%X",
+			Request,
+			status);
+		goto exit;
+	}
 
-		//
-		// Set the workitem context
-		//
-		idleWorkItemContext = GetWorkItemContext(idleWorkItem);
-		idleWorkItemContext->FxDevice = devContext->FxDevice;
-		idleWorkItemContext->FxRequest = Request;
+	devContext->IdleRequest = Request;
+	devContext->IdleRequestTime = KeQueryInterruptTime();
+	InterlockedIncrement(&devContext->IdleStats.Requests);
 
-		//
-		// Enqueue a workitem for the idle callback
-		//
-		WdfWorkItemEnqueue(idleWorkItem);
+	//
+	// Invoke the idle callback from the device's idle work item
+	//
+	WdfWorkItemEnqueue(devContext->IdleWorkItem);
 
-		//
-		// Mark the request as pending so that 
-		// we can complete it when we come out of idle
-		//
-		*Pending = TRUE;
-	}
+	//
+	// Mark the request as pending so that 
+	// we can complete it when we come out of idle
+	//
+	*Pending = TRUE;
+	status = STATUS_SUCCESS;
 
 exit:
 
@@ -194,21 +181,23 @@ Return Value:
 --*/
 {
 	NTSTATUS status;
-	PIDLE_WORKITEM_CONTEXT idleWorkItemContext;
+	WDFREQUEST request;
 	PDEVICE_EXTENSION deviceContext;
 	PHID_SUBMIT_IDLE_NOTIFICATION_CALLBACK_INFO idleCallbackInfo;
+	ULONG64 latency;
 
-	idleWorkItemContext = GetWorkItemContext(IdleWorkItem);
-	NT_ASSERT(idleWorkItemContext != NULL);
-
-	deviceContext = GetDeviceContext(idleWorkItemContext->FxDevice);
+	deviceContext = GetDeviceContext(WdfWorkItemGetParentObject(IdleWorkItem));
 	NT_ASSERT(deviceContext != NULL);
+	NT_ASSERT(deviceContext->IdleState == IdleStatePending);
+
+	request = deviceContext->IdleRequest;
+	deviceContext->IdleRequest = NULL;
 
 	//
-	// Get the idle callback info from the workitem context
+	// Get the idle callback info from the request
 	//
 	idleCallbackInfo = (PHID_SUBMIT_IDLE_NOTIFICATION_CALLBACK_INFO)
-		IoGetCurrentIrpStackLocation(WdfRequestWdmGetIrp(idleWorkItemContext->FxRequest))->\
+		IoGetCurrentIrpStackLocation(WdfRequestWdmGetIrp(request))->\
 		Parameters.DeviceIoControl.Type3InputBuffer;
 
 	//
@@ -216,12 +205,25 @@ Return Value:
 	//
 	idleCallbackInfo->IdleCallback(idleCallbackInfo->IdleContext);
 
+	latency = KeQueryInterruptTime() - deviceContext->IdleRequestTime;
+	deviceContext->IdleStats.LastEntryLatency = latency;
+	if (latency > deviceContext->IdleStats.MaxEntryLatency)
+	{
+		deviceContext->IdleStats.MaxEntryLatency = latency;
+	}
+
+	//
+	// The request is parked before it is forwarded, as the queue may
+	// cancel it (and return the handshake to active) right away
+	//
+	InterlockedExchange(&deviceContext->IdleState, IdleStateParked);
+
 	//
 	// Park this request in our IdleQueue and mark it as pending
 	// This way if the IRP was cancelled, WDF will cancel it for us
 	//
 	status = WdfRequestForwardToIoQueue(
-		idleWorkItemContext->FxRequest,
+		request,
 		deviceContext->IdleQueue);
 
 	if (!NT_SUCCESS(status))
@@ -237,38 +239,36 @@ Return Value:
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_IDLE,
 			"Error forwarding idle notification Request:0x%p to IdleQueue:0x%p - STATUS:%X",
-			idleWorkItemContext->FxRequest,
+			request,
 			deviceContext->IdleQueue,
 			status);
 
 		//
 		// Complete the request if we couldnt forward to the Idle Queue
 		//
-		WdfRequestComplete(idleWorkItemContext->FxRequest, status);
+		InterlockedExchange(&deviceContext->IdleState, IdleStateActive);
+		WdfRequestComplete(request, status);
 	}
 	else
 	{
 		Trace(
 			TRACE_LEVEL_INFORMATION,
 			TRACE_FLAG_IDLE,
-			"Forwarded idle notification Request:0x%p to IdleQueue:0x%p - STATUS:%X",
-			idleWorkItemContext->FxRequest,
+			"Forwarded idle notification Request:0x%p to IdleQueue:0x%p in %llu us - STATUS:%X",
+			request,
 			deviceContext->IdleQueue,
+			latency / 10,
 			status);
 	}
 
-	//
-	// Delete the workitem since we're done with it
-	//
-	WdfObjectDelete(IdleWorkItem);
-
 	return;
 }
 
 
 VOID
 TchCompleteIdleIrp(
-	IN PDEVICE_EXTENSION FxDeviceContext
+	IN PDEVICE_EXTENSION FxDeviceContext,
+	IN ULONG64 WakeStartTime
 )
 /*++
 
@@ -281,6 +281,8 @@ Arguments:
 
 	FxDeviceContext -  Pointer to Device Context for the device
 
+	WakeStartTime - Interrupt time at which D0 entry started
+
 Return Value:
 
 
@@ -289,6 +291,15 @@ Return Value:
 {
 	NTSTATUS status;
 	WDFREQUEST request = NULL;
+	ULONG64 latency;
+
+	//
+	// Most D0 entries happen without an idle request parked
+	//
+	if (FxDeviceContext->IdleState != IdleStateParked)
+	{
+		return;
+	}
 
 	//
 	// Lets try to retrieve the Idle IRP from the Idle queue
@@ -312,18 +323,69 @@ Return Value:
 	else
 	{
 		//
-		// Complete the Idle IRP
+		// Complete the Idle IRP, a new one may arrive as soon as it is
 		//
+		InterlockedExchange(&FxDeviceContext->IdleState, IdleStateActive);
+		InterlockedIncrement(&FxDeviceContext->IdleStats.Completions);
+
 		WdfRequestComplete(request, status);
 
+		latency = KeQueryInterruptTime() - WakeStartTime;
+		FxDeviceContext->IdleStats.LastExitLatency = latency;
+		if (latency > FxDeviceContext->IdleStats.MaxExitLatency)
+		{
+			FxDeviceContext->IdleStats.MaxExitLatency = latency;
+		}
+
 		Trace(
 			TRACE_LEVEL_INFORMATION,
 			TRACE_FLAG_IDLE,
-			"Completed idle notification Request:0x%p from IdleQueue:0x%p - STATUS:%X",
+			"Completed idle notification Request:0x%p from IdleQueue:0x%p in %llu us - STATUS:%X",
 			request,
 			FxDeviceContext->IdleQueue,
+			latency / 10,
 			status);
 	}
 
 	return;
-}
\ No newline at end of file
+}
+
+VOID
+TchIdleRequestCanceledOnQueue(
+	IN WDFQUEUE Queue,
+	IN WDFREQUEST Request
+)
+/*++
+
+Routine Description:
+
+	Invoked when HIDClass cancels the idle notification request while
+	it is parked in the IdleQueue.
+
+Arguments:
+
+	Queue - Handle to the IdleQueue
+
+	Request - The cancelled idle notification request
+
+Return Value:
+
+	None
+
+--*/
+{
+	PDEVICE_EXTENSION devContext;
+
+	devContext = GetDeviceContext(WdfIoQueueGetDevice(Queue));
+
+	InterlockedExchange(&devContext->IdleState, IdleStateActive);
+	InterlockedIncrement(&devContext->IdleStats.Cancellations);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_IDLE,
+		"Idle notification Request:0x%p cancelled",
+		Request);
+
+	WdfRequestComplete(Request, STATUS_CANCELLED);
+}
@@ -18,13 +18,15 @@
 
 --*/
 
+#include "internal.h"
 #include "rmiinternal.h"
-#include "spb.h"
+#include "transport.h"
 #include "debug.h"
 #include "Function01.h"
 #include "Function1A.h"
 #include "Function11.h"
 #include "Function12.h"
+#include "Function54.h"
 #include "buttonreporting.h"
 //#include "init.tmh"
 
@@ -69,11 +71,10 @@ RmiChangePage(
 	{
 		page = (BYTE)DesiredPage;
 
-		status = SpbWriteDataSynchronously(
-			SpbContext,
-			RMI4_PAGE_SELECT_ADDRESS,
-			&page,
-			sizeof(BYTE));
+		//
+		// The transport decides how the page is mapped in
+		//
+		status = SpbSetPage(SpbContext, page);
 
 		if (NT_SUCCESS(status))
 		{
@@ -194,16 +195,14 @@ RmiGetFirmwareVersion(
 	}
 
 	//
-	// Store all F01 query registers, which contain the product ID
-	//
-	// TODO: Fix transfer size when SPB can support larger I2C 
-	//       transactions
+	// Store all F01 query registers, which contain the product ID and
+	// firmware build and identify the firmware to the persisted topology
 	//
 	status = SpbReadDataSynchronously(
 		SpbContext,
 		ControllerContext->Descriptors[index].QueryBase,
-		&ControllerContext->F01QueryRegisters,
-		sizeof(BYTE) * FIELD_OFFSET(RMI4_F01_QUERY_REGISTERS, ProductID10));
+		&ControllerContext->Setup->F01QueryRegisters,
+		RMI4_F01_IDENTITY_BYTES);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -253,10 +252,19 @@ RmiConfigureFunctions(
 	int i;
 	BOOLEAN f01Flag = FALSE,
 		f11Flag = FALSE,
-		f1aFlag = FALSE;
+		f1aFlag = FALSE,
+		f54Flag = FALSE;
 
 	ControllerContext->IsF12Digitizer = FALSE;
 
+	//
+	// Serviced interrupt sources are collected as functions are configured
+	//
+	ControllerContext->DeviceIrqMask = 0;
+	ControllerContext->TouchIrqMask = 0;
+	ControllerContext->ButtonIrqMask = 0;
+	ControllerContext->TestIrqMask = 0;
+
 	for (i = 0; i < RMI4_MAX_FUNCTIONS; i++)
 	{
 		switch (ControllerContext->Descriptors[i].Number)
@@ -273,6 +281,9 @@ RmiConfigureFunctions(
 		case RMI4_F1A_0D_CAP_BUTTON_SENSOR:
 			f1aFlag = TRUE;
 			break;
+		case RMI4_F54_TEST_REPORTING:
+			f54Flag = TRUE;
+			break;
 		default:
 			break;
 		}
@@ -313,14 +324,113 @@ RmiConfigureFunctions(
 		}
 	}
 
+	//
+	// Size the finger cache and report queue for the contact count the
+	// touch function reported. Button only devices still need a queue.
+	//
+	status = RmiAllocateSlotStorage(ControllerContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Error can't allocate contact slots - STATUS %x",
+			status
+		);
+		goto exit;
+	}
+
 	if (f1aFlag)
 		status = RmiConfigureFunction1A(ControllerContext, SpbContext);
 
+	//
+	// Test reporting is optional, a failure only disables capture
+	//
+	if (f54Flag)
+		RmiConfigureFunction54(ControllerContext, SpbContext);
+	else
+		ControllerContext->HasTestReporting = FALSE;
+
 	if (f01Flag)
 		status = RmiConfigureFunction01(ControllerContext, SpbContext);
 
-    //temporaly init buttons timer TODO if(f1aflag || touchButtons)
-    ButtonsInitTimer(ControllerContext);
+exit:
+
+	return status;
+}
+
+NTSTATUS
+RmiApplyPendingConfiguration(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Programs the register images of a configuration reload that could
+	not be written when the snapshot was published. Only the F11 and
+	F01 control registers are written: the functions are not discovered
+	again and the finger cache is kept, so contacts on the screen carry
+	on across a reload. Called with the controller lock held, in D0
+	with the display on.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller
+	context
+
+	SpbContext - A pointer to the current i2c context
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS status = STATUS_SUCCESS;
+
+	if (!ControllerContext->ConfigurePending)
+	{
+		goto exit;
+	}
+
+	//
+	// F12 has no register image in the configuration
+	//
+	if (!ControllerContext->IsF12Digitizer &&
+		RmiGetFunctionIndex(
+			ControllerContext->Descriptors,
+			ControllerContext->FunctionCount,
+			RMI4_F11_2D_TOUCHPAD_SENSOR) != ControllerContext->FunctionCount)
+	{
+		status = RmiSetFunction11Control(
+			ControllerContext,
+			SpbContext);
+	}
+
+	if (NT_SUCCESS(status))
+	{
+		status = RmiConfigureFunction01(
+			ControllerContext,
+			SpbContext);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not apply configuration %d - STATUS:%X",
+			ControllerContext->Config->Version,
+			status);
+
+		goto exit;
+	}
+
+	ControllerContext->ConfigurePending = FALSE;
+
 exit:
 
 	return status;
@@ -355,15 +465,25 @@ RmiBuildFunctionsTable(
 	UCHAR address;
 	int function;
 	int page;
+	int irqPosition;
+	int irqCount;
 	NTSTATUS status;
 
 
+	//
+	// Functions are rescanned when the firmware may have changed, the F12
+	// register descriptors held by the topology are stale from now on
+	//
+	ControllerContext->Setup->Topology.F12Valid = FALSE;
+	ControllerContext->Setup->TopologyCached = FALSE;
+
 	//
 	// First function is at a fixed address 
 	//
 	function = 0;
 	address = RMI4_FIRST_FUNCTION_ADDRESS;
 	page = 0;
+	irqPosition = 0;
 
 	//
 	// Discover chip functions one by one
@@ -437,6 +557,35 @@ RmiBuildFunctionsTable(
 				ControllerContext->Descriptors[function].Number);
 
 			ControllerContext->FunctionOnPage[function] = page;
+
+			//
+			// Interrupt sources are numbered in discovery order, each
+			// function owning IrqCount consecutive status bits. F01
+			// carries RMI4_MAX_INTERRUPT_SOURCES of them, a function
+			// owning sources past those could never be serviced.
+			//
+			irqCount = ControllerContext->Descriptors[function].VersionIrq.IrqCount;
+
+			if (irqPosition + irqCount > RMI4_MAX_INTERRUPT_SOURCES)
+			{
+				Trace(
+					TRACE_LEVEL_ERROR,
+					TRACE_FLAG_INIT,
+					"Function $%x interrupt sources %d to %d are past the %d F01 carries",
+					ControllerContext->Descriptors[function].Number,
+					irqPosition,
+					irqPosition + irqCount - 1,
+					RMI4_MAX_INTERRUPT_SOURCES);
+
+				status = STATUS_INVALID_DEVICE_STATE;
+				goto exit;
+			}
+
+			ControllerContext->FunctionIrqMask[function] =
+				((1UL << irqCount) - 1) << irqPosition;
+
+			irqPosition += irqCount;
+
 			function++;
 			address = address - sizeof(RMI4_FUNCTION_DESCRIPTOR);
 		}
@@ -686,23 +835,21 @@ exit:
 	return status;
 }
 
-NTSTATUS
-TchStartDevice(
-	IN VOID* ControllerContext,
+static NTSTATUS
+RmiDiscoverTopology(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
 	IN SPB_CONTEXT* SpbContext
 )
 /*++
 
   Routine Description:
 
-	This routine is called in response to the KMDF prepare hardware call
-	to initialize the touch controller for use.
+	Scans the controller for its functions and reads the firmware
+	version.
 
   Arguments:
 
-	ControllerContext - A pointer to the current touch controller
-	context
-
+	ControllerContext - A pointer to the current touch controller context
 	SpbContext - A pointer to the current i2c context
 
   Return Value:
@@ -711,27 +858,8 @@ TchStartDevice(
 
 --*/
 {
-	RMI4_CONTROLLER_CONTEXT* controller;
-	ULONG interruptStatus;
 	NTSTATUS status;
 
-	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
-	interruptStatus = 0;
-	status = STATUS_SUCCESS;
-
-	//
-	// Initialize capacitive button LED support
-	//
-	controller->BklContext = TchBklInitialize(controller->FxDevice);
-
-	if (controller->BklContext == NULL)
-	{
-		Trace(
-			TRACE_LEVEL_WARNING,
-			TRACE_FLAG_INIT,
-			"Warning, failed to initialize touch button backlight control");
-	}
-
 	//
 	// Populate context with RMI function descriptors
 	//
@@ -749,23 +877,6 @@ TchStartDevice(
 		goto exit;
 	}
 
-	//
-	// Initialize RMI function control registers
-	//
-	status = RmiConfigureFunctions(
-		ControllerContext,
-		SpbContext);
-
-	if (!NT_SUCCESS(status))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Could not configure RMI functions - STATUS:%X",
-			status);
-		goto exit;
-	}
-
 	//
 	// Read and store the firmware version
 	//
@@ -783,139 +894,878 @@ TchStartDevice(
 		goto exit;
 	}
 
-	//
-	// Clear any pending interrupts
-	//
-	status = RmiCheckInterrupts(
-		ControllerContext,
-		SpbContext,
-		&interruptStatus
-	);
-
-	if (!NT_SUCCESS(status))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Could not get interrupt status - STATUS:%X%",
-			status);
-	}
-
 exit:
 
 	return status;
 }
 
-NTSTATUS
-TchStopDevice(
-	IN VOID* ControllerContext,
+static NTSTATUS
+RmiLoadTopology(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
 	IN SPB_CONTEXT* SpbContext
 )
 /*++
 
-Routine Description:
-
-	This routine cleans up the device that is stopped.
+  Routine Description:
 
-Argument:
+	Takes the function table and firmware version from the topology
+	persisted by a previous start. The F01 query registers are read
+	where the topology places them, so one read both locates F01 and
+	identifies the firmware. Any difference means the topology belongs
+	to other firmware and the functions have to be discovered.
 
-	ControllerContext - Touch controller context
+  Arguments:
 
+	ControllerContext - A pointer to the current touch controller context
 	SpbContext - A pointer to the current i2c context
 
-Return Value:
+  Return Value:
+
+	NTSTATUS indicating success or failure
 
-	NTSTATUS indicating sucess or failure
 --*/
 {
-	RMI4_CONTROLLER_CONTEXT* controller;
+	RMI4_F01_QUERY_REGISTERS identity;
+	RMI4_TOPOLOGY* topology;
+	int index;
+	int i;
+	NTSTATUS status;
 
-	UNREFERENCED_PARAMETER(SpbContext);
+	topology = &ControllerContext->Setup->Topology;
 
-	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	status = TchRegistryReadTopology(
+		ControllerContext->FxDevice,
+		topology);
 
-	if (NULL != controller->BklContext)
+	if (!NT_SUCCESS(status))
 	{
-		TchBklDeinitialize(controller->BklContext);
-		controller->BklContext = NULL;
+		goto exit;
 	}
 
-	return STATUS_SUCCESS;
-}
-
-NTSTATUS
-TchAllocateContext(
-	OUT VOID** ControllerContext,
-	IN WDFDEVICE FxDevice
-)
-/*++
-
-Routine Description:
+	index = RmiGetFunctionIndex(
+		topology->Descriptors,
+		(int)topology->FunctionCount,
+		RMI4_F01_RMI_DEVICE_CONTROL);
 
-	This routine allocates a controller context.
+	if (index == (int)topology->FunctionCount)
+	{
+		status = STATUS_REVISION_MISMATCH;
+		goto exit;
+	}
 
-Argument:
+	status = RmiChangePage(
+		ControllerContext,
+		SpbContext,
+		topology->FunctionOnPage[index]);
 
-	ControllerContext - Touch controller context
-	FxDevice - Framework device object
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
 
-Return Value:
+	RtlZeroMemory(&identity, sizeof(identity));
 
-	NTSTATUS indicating sucess or failure
---*/
-{
-	RMI4_CONTROLLER_CONTEXT* context;
-	NTSTATUS status;
+	status = SpbReadDataSynchronously(
+		SpbContext,
+		topology->Descriptors[index].QueryBase,
+		&identity,
+		RMI4_F01_IDENTITY_BYTES);
 
-	context = ExAllocatePoolWithTag(
-		NonPagedPool,
-		sizeof(RMI4_CONTROLLER_CONTEXT),
-		TOUCH_POOL_TAG);
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
 
-	if (NULL == context)
+	if (RtlCompareMemory(
+		&identity,
+		&topology->F01QueryRegisters,
+		RMI4_F01_IDENTITY_BYTES) != RMI4_F01_IDENTITY_BYTES)
 	{
 		Trace(
-			TRACE_LEVEL_ERROR,
+			TRACE_LEVEL_INFORMATION,
 			TRACE_FLAG_INIT,
-			"Could not allocate controller context!");
+			"Controller firmware differs from the persisted topology");
 
-		status = STATUS_UNSUCCESSFUL;
+		status = STATUS_REVISION_MISMATCH;
 		goto exit;
 	}
 
-	RtlZeroMemory(context, sizeof(RMI4_CONTROLLER_CONTEXT));
-	context->FxDevice = FxDevice;
-
-	//
-	// Get screen properties and populate context
-	//
-	TchGetScreenProperties(&context->Props);
+	ControllerContext->FunctionCount = (int)topology->FunctionCount;
 
-	//
-	// Allocate a WDFWAITLOCK for guarding access to the
-	// controller HW and driver controller context
-	//
-	status = WdfWaitLockCreate(
-		WDF_NO_OBJECT_ATTRIBUTES,
-		&context->ControllerLock);
+	RtlCopyMemory(
+		ControllerContext->Descriptors,
+		topology->Descriptors,
+		sizeof(ControllerContext->Descriptors));
 
-	if (!NT_SUCCESS(status))
+	for (i = 0; i < RMI4_MAX_FUNCTIONS; i++)
 	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_INIT,
-			"Could not allocate controller context - STATUS:%X",
-			status);
+		ControllerContext->FunctionOnPage[i] = topology->FunctionOnPage[i];
+		ControllerContext->FunctionIrqMask[i] = topology->FunctionIrqMask[i];
+	}
 
-		goto exit;
+	RtlCopyMemory(
+		&ControllerContext->Setup->F01QueryRegisters,
+		&identity,
+		sizeof(identity));
 
-	}
+	ControllerContext->Setup->TopologyCached = TRUE;
 
-	*ControllerContext = context;
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Using the persisted topology of %d RMI functions",
+		ControllerContext->FunctionCount);
 
 exit:
 
-	return status;
+	if (!NT_SUCCESS(status))
+	{
+		topology->F12Valid = FALSE;
+	}
+
+	return status;
+}
+
+static BOOLEAN
+RmiCopyTopology(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	OUT RMI4_TOPOLOGY* Topology
+)
+/*++
+
+  Routine Description:
+
+	Copies the topology of the configured controller. The F12 register
+	descriptors were recorded when F12 was configured. Called with the
+	controller lock held, as the functions may be reconfigured at any
+	time once the device has started.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller context
+	Topology - Receives the topology
+
+  Return Value:
+
+	TRUE if the topology was discovered on this start and has to be
+	persisted
+
+--*/
+{
+	RMI4_TOPOLOGY* topology;
+	int i;
+
+	topology = &ControllerContext->Setup->Topology;
+
+	topology->Signature = RMI4_TOPOLOGY_SIGNATURE;
+	topology->Version = RMI4_TOPOLOGY_VERSION;
+	topology->FunctionCount = (ULONG)ControllerContext->FunctionCount;
+
+	RtlCopyMemory(
+		&topology->F01QueryRegisters,
+		&ControllerContext->Setup->F01QueryRegisters,
+		sizeof(RMI4_F01_QUERY_REGISTERS));
+
+	RtlCopyMemory(
+		topology->Descriptors,
+		ControllerContext->Descriptors,
+		sizeof(topology->Descriptors));
+
+	for (i = 0; i < RMI4_MAX_FUNCTIONS; i++)
+	{
+		topology->FunctionOnPage[i] = (UCHAR)ControllerContext->FunctionOnPage[i];
+		topology->FunctionIrqMask[i] = ControllerContext->FunctionIrqMask[i];
+	}
+
+	RtlCopyMemory(Topology, topology, sizeof(RMI4_TOPOLOGY));
+
+	return !ControllerContext->Setup->TopologyCached;
+}
+
+static VOID
+RmiTraceFirmwareVersion(
+	IN const RMI4_F01_QUERY_REGISTERS* QueryRegisters
+)
+/*++
+
+  Routine Description:
+
+	Logs the product ID and firmware build read from the F01 query
+	registers.
+
+  Arguments:
+
+	QueryRegisters - F01 query registers of the controller
+
+  Return Value:
+
+	None
+
+--*/
+{
+	CHAR productId[10];
+
+	RtlCopyMemory(
+		productId,
+		&QueryRegisters->ProductID1,
+		sizeof(productId) - 1);
+
+	productId[sizeof(productId) - 1] = '\0';
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Controller %s, manufacturer %u, product info %02X%02X, date %02X%02X",
+		productId,
+		QueryRegisters->ManufacturerID,
+		QueryRegisters->ProductInfo0,
+		QueryRegisters->ProductInfo1,
+		QueryRegisters->Date0,
+		QueryRegisters->Date1);
+}
+
+VOID
+TchMarkStartPhase(
+	IN WDFDEVICE FxDevice,
+	IN TCH_START_PHASE Phase
+)
+/*++
+
+  Routine Description:
+
+	Records the completion of a device start phase. Preparing the
+	hardware starts a new timeline, D0 entry is only recorded the first
+	time after that.
+
+  Arguments:
+
+	FxDevice - Framework device object
+	Phase - The phase that completed
+
+  Return Value:
+
+	None
+
+--*/
+{
+	PDEVICE_EXTENSION devContext;
+
+	devContext = GetDeviceContext(FxDevice);
+
+	if (Phase == TchStartPhasePrepareHardware)
+	{
+		RtlZeroMemory(
+			devContext->StartPhaseTime,
+			sizeof(devContext->StartPhaseTime));
+	}
+	else if (Phase == TchStartPhaseD0Entry &&
+		devContext->StartPhaseTime[Phase] != 0)
+	{
+		return;
+	}
+
+	devContext->StartPhaseTime[Phase] = KeQueryInterruptTime();
+}
+
+VOID
+TchStartWorkItem(
+	IN WDFWORKITEM WorkItem
+)
+/*++
+
+  Routine Description:
+
+	Completes the device start once touch scanning is enabled. None of
+	the work here is needed to report touch input, so it is kept off the
+	start path: backlight and ambient light sensor bring-up, display
+	state notifications, firmware version logging and persisting a newly
+	discovered topology.
+
+  Arguments:
+
+	WorkItem - Work item parented to the framework device
+
+  Return Value:
+
+	None
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	BKL_LUX_TABLE_ENTRY luxTable[BKL_MAX_LEVELS];
+	ULONG luxLevels;
+	RMI4_TOPOLOGY* topology;
+	BKL_CONTEXT* bklContext;
+	WDFDEVICE fxDevice;
+	BOOLEAN persist;
+	NTSTATUS status;
+
+	fxDevice = (WDFDEVICE)WdfWorkItemGetParentObject(WorkItem);
+	controller = (RMI4_CONTROLLER_CONTEXT*)GetDeviceContext(fxDevice)->TouchContext;
+
+	TchMarkStartPhase(fxDevice, TchStartPhaseWorkItem);
+
+	//
+	// Initialize capacitive button LED support. Interrupt servicing
+	// already runs and picks the context up once it is published.
+	//
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	luxLevels = controller->Config->LuxLevels;
+	RtlCopyMemory(
+		luxTable,
+		controller->Config->LuxTable,
+		luxLevels * sizeof(BKL_LUX_TABLE_ENTRY));
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	bklContext = TchBklInitialize(fxDevice, luxTable, luxLevels);
+
+	if (bklContext == NULL)
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Warning, failed to initialize touch button backlight control");
+	}
+
+	InterlockedExchangePointer((PVOID volatile*)&controller->BklContext, bklContext);
+
+	TchMarkStartPhase(fxDevice, TchStartPhaseBacklight);
+
+	//
+	// Register for monitor state changes, button interrupts are not
+	// serviced while the display is off. Until then the display is
+	// taken to be on, as it is while the device starts. The callback
+	// also drives the button backlight published above.
+	//
+	status = PoRegisterPowerSettingCallback(
+		WdfDeviceWdmGetDeviceObject(fxDevice),
+		&GUID_MONITOR_POWER_ON,
+		TchOnDisplayStateChange,
+		(PVOID)controller,
+		&controller->MonitorChangeNotificationHandle);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Could not register for monitor state changes - STATUS:%X",
+			status);
+
+		controller->MonitorChangeNotificationHandle = NULL;
+	}
+
+	TchMarkStartPhase(fxDevice, TchStartPhaseDisplayCallback);
+
+	topology = ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(RMI4_TOPOLOGY),
+		TOUCH_POOL_TAG);
+
+	if (topology == NULL)
+	{
+		goto exit;
+	}
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+	persist = RmiCopyTopology(controller, topology);
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	RmiTraceFirmwareVersion(&topology->F01QueryRegisters);
+
+	//
+	// A start without the topology only costs the discovery
+	//
+	if (persist)
+	{
+		(VOID)TchRegistryWriteTopology(fxDevice, topology);
+	}
+
+	ExFreePoolWithTag(topology, TOUCH_POOL_TAG);
+
+exit:
+
+	TchMarkStartPhase(fxDevice, TchStartPhaseComplete);
+}
+
+NTSTATUS
+TchStartDevice(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	This routine is called in response to the KMDF prepare hardware call
+	to initialize the touch controller for use.
+
+  Arguments:
+
+	ControllerContext - A pointer to the current touch controller
+	context
+
+	SpbContext - A pointer to the current i2c context
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	ULONG interruptStatus;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	interruptStatus = 0;
+	status = STATUS_SUCCESS;
+
+	//
+	// Take the RMI function descriptors and firmware version from the
+	// persisted topology when the firmware is unchanged, otherwise
+	// discover them
+	//
+	status = RmiLoadTopology(
+		controller,
+		SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		status = RmiDiscoverTopology(
+			controller,
+			SpbContext);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+	}
+
+	TchMarkStartPhase(controller->FxDevice, TchStartPhaseTopology);
+
+	//
+	// Initialize RMI function control registers
+	//
+	status = RmiConfigureFunctions(
+		ControllerContext,
+		SpbContext);
+
+	if (!NT_SUCCESS(status) && controller->Setup->TopologyCached)
+	{
+		//
+		// A persisted topology the controller does not accept is
+		// dropped and the functions are discovered again
+		//
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_INIT,
+			"Persisted topology rejected, rediscovering - STATUS:%X",
+			status);
+
+		status = RmiDiscoverTopology(
+			controller,
+			SpbContext);
+
+		if (!NT_SUCCESS(status))
+		{
+			goto exit;
+		}
+
+		status = RmiConfigureFunctions(
+			ControllerContext,
+			SpbContext);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not configure RMI functions - STATUS:%X",
+			status);
+		goto exit;
+	}
+
+	//
+	// Clear any pending interrupts
+	//
+	status = RmiCheckInterrupts(
+		ControllerContext,
+		SpbContext,
+		&interruptStatus
+	);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not get interrupt status - STATUS:%X%",
+			status);
+	}
+
+	status = STATUS_SUCCESS;
+
+	TchMarkStartPhase(controller->FxDevice, TchStartPhaseConfigured);
+
+	//
+	// Touch scanning is enabled, finish the start off the critical path
+	//
+	WdfWorkItemEnqueue(controller->StartWorkItem);
+
+exit:
+
+	return status;
+}
+
+NTSTATUS
+TchStopDevice(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+	This routine cleans up the device that is stopped.
+
+Argument:
+
+	ControllerContext - Touch controller context
+
+	SpbContext - A pointer to the current i2c context
+
+Return Value:
+
+	NTSTATUS indicating sucess or failure
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+
+	UNREFERENCED_PARAMETER(SpbContext);
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+
+	//
+	// The start work item may still be setting up what is torn down here
+	//
+	WdfWorkItemFlush(controller->StartWorkItem);
+
+	if (NULL != controller->MonitorChangeNotificationHandle)
+	{
+		PoUnregisterPowerSettingCallback(controller->MonitorChangeNotificationHandle);
+		controller->MonitorChangeNotificationHandle = NULL;
+	}
+
+	if (NULL != controller->BklContext)
+	{
+		TchBklDeinitialize(controller->BklContext);
+		controller->BklContext = NULL;
+	}
+
+	//
+	// The capture ring belongs to a diagnostic request, stop writing
+	// into it before the controller goes away
+	//
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+	RmiF54StopStream(controller);
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	RmiFreeRegisterDescriptors(controller);
+
+	return STATUS_SUCCESS;
+}
+
+NTSTATUS
+TchReloadConfiguration(
+	IN VOID* ControllerContext,
+	IN SPB_CONTEXT* SpbContext,
+	OUT PULONG Version,
+	OUT PULONG Flags
+)
+/*++
+
+  Routine Description:
+
+	Reads the configuration again and publishes it in place of the
+	running one. The snapshot is built and validated without the
+	controller lock, then swapped in under it, so interrupt servicing
+	sees either the old or the new configuration in full. Register
+	images that changed are programmed right away when the controller
+	is scanning, otherwise when it is next woken.
+
+	The report descriptor handed to HIDClass depends on the display
+	extents, a configuration changing them needs the device restarted.
+
+  Arguments:
+
+	ControllerContext - Touch controller context
+
+	SpbContext - A pointer to the current i2c context
+
+	Version - Receives the version of the published configuration
+
+	Flags - Receives TCH_CONFIG_* flags
+
+  Return Value:
+
+	NTSTATUS indicating success or failure, the running configuration
+	is kept on failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	RMI4_CONFIG_SNAPSHOT* config = NULL;
+	RMI4_CONFIG_SNAPSHOT* previous;
+	BKL_CONTEXT* bklContext;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	*Version = 0;
+	*Flags = 0;
+
+	//
+	// The start work item may still be handing the lux table of the
+	// running configuration to the backlight
+	//
+	WdfWorkItemFlush(controller->StartWorkItem);
+
+	status = TchConfigBuild(controller->FxDevice, &config);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Rejected configuration reload - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	previous = controller->Config;
+
+	if (config->Props.DisplayPhysicalWidth != previous->Props.DisplayPhysicalWidth ||
+		config->Props.DisplayPhysicalHeight != previous->Props.DisplayPhysicalHeight)
+	{
+		WdfWaitLockRelease(controller->ControllerLock);
+
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Display extents changed to %dx%d, restart the device to apply them",
+			config->Props.DisplayPhysicalWidth,
+			config->Props.DisplayPhysicalHeight);
+
+		status = STATUS_NOT_SUPPORTED;
+		goto exit;
+	}
+
+	config->Version = previous->Version + 1;
+	controller->Config = config;
+
+	if (RtlCompareMemory(
+			&config->F01Ctrl,
+			&previous->F01Ctrl,
+			sizeof(RMI4_F01_CTRL_REGISTERS)) != sizeof(RMI4_F01_CTRL_REGISTERS) ||
+		RtlCompareMemory(
+			&config->F11Ctrl,
+			&previous->F11Ctrl,
+			sizeof(RMI4_F11_CTRL_REGISTERS)) != sizeof(RMI4_F11_CTRL_REGISTERS))
+	{
+		*Flags |= TCH_CONFIG_REGISTERS_CHANGED;
+		controller->ConfigurePending = TRUE;
+
+		if (controller->DevicePowerState == PowerDeviceD0 &&
+			!controller->DisplayOff)
+		{
+			(VOID)RmiApplyPendingConfiguration(controller, SpbContext);
+		}
+	}
+
+	if (controller->ConfigurePending)
+	{
+		*Flags |= TCH_CONFIG_REGISTERS_PENDING;
+	}
+
+	bklContext = controller->BklContext;
+	*Version = config->Version;
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	//
+	// The backlight takes its own lock. Reloads are serialized by the
+	// diagnostic queue, so the published snapshot cannot be replaced
+	// and freed before its table is copied.
+	//
+	if (bklContext != NULL)
+	{
+		TchBklSetLuxTable(
+			bklContext,
+			config->LuxTable,
+			config->LuxLevels);
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REGISTRY,
+		"Published configuration %d, flags %X",
+		*Version,
+		*Flags);
+
+	config = previous;
+
+exit:
+
+	if (config != NULL)
+	{
+		TchConfigFree(config);
+	}
+
+	return status;
+}
+
+NTSTATUS
+TchAllocateContext(
+	OUT VOID** ControllerContext,
+	IN WDFDEVICE FxDevice
+)
+/*++
+
+Routine Description:
+
+	This routine allocates a controller context.
+
+Argument:
+
+	ControllerContext - Touch controller context
+	FxDevice - Framework device object
+
+Return Value:
+
+	NTSTATUS indicating sucess or failure
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* context;
+	WDF_WORKITEM_CONFIG workItemConfig;
+	WDF_OBJECT_ATTRIBUTES workItemAttributes;
+	NTSTATUS status;
+
+	//
+	// The context starts with a DECLSPEC_CACHEALIGN member
+	//
+	context = ExAllocatePoolWithTag(
+		NonPagedPoolNxCacheAligned,
+		sizeof(RMI4_CONTROLLER_CONTEXT),
+		TOUCH_POOL_TAG);
+
+	if (NULL == context)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not allocate controller context!");
+
+		status = STATUS_UNSUCCESSFUL;
+		goto exit;
+	}
+
+	RtlZeroMemory(context, sizeof(RMI4_CONTROLLER_CONTEXT));
+	context->FxDevice = FxDevice;
+
+	context->Setup = ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(RMI4_CONTROLLER_SETUP),
+		TOUCH_POOL_TAG);
+
+	if (NULL == context->Setup)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not allocate controller configuration!");
+
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	RtlZeroMemory(context->Setup, sizeof(RMI4_CONTROLLER_SETUP));
+
+	//
+	// Allocate a WDFWAITLOCK for guarding access to the
+	// controller HW and driver controller context
+	//
+	status = WdfWaitLockCreate(
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&context->ControllerLock);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not allocate controller context - STATUS:%X",
+			status);
+
+		goto exit;
+
+	}
+
+	//
+	// Create the long press timer once, the controller can be
+	// reconfigured many times over the device lifetime
+	//
+	status = ButtonsInitialize(context);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	status = RmiF54Initialize(context);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	WDF_WORKITEM_CONFIG_INIT(&workItemConfig, TchStartWorkItem);
+
+	WDF_OBJECT_ATTRIBUTES_INIT(&workItemAttributes);
+	workItemAttributes.ParentObject = FxDevice;
+
+	status = WdfWorkItemCreate(
+		&workItemConfig,
+		&workItemAttributes,
+		&context->StartWorkItem);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not create start work item - STATUS:%X",
+			status);
+
+		context->StartWorkItem = NULL;
+		goto exit;
+	}
+
+	*ControllerContext = context;
+
+exit:
+
+	if (!NT_SUCCESS(status) && context != NULL)
+	{
+		TchFreeContext(context);
+	}
+
+	return status;
 }
 
 NTSTATUS
@@ -943,12 +1793,43 @@ Return Value:
 
 	if (controller != NULL)
 	{
+		if (controller->StartWorkItem != NULL)
+		{
+			WdfWorkItemFlush(controller->StartWorkItem);
+			WdfObjectDelete(controller->StartWorkItem);
+		}
+
+		if (controller->ButtonsTimer != NULL)
+		{
+			WdfTimerStop(controller->ButtonsTimer, TRUE);
+			WdfObjectDelete(controller->ButtonsTimer);
+		}
+
+		if (controller->F54Stream.PollTimer != NULL)
+		{
+			controller->F54Stream.Active = FALSE;
+			WdfTimerStop(controller->F54Stream.PollTimer, TRUE);
+			WdfObjectDelete(controller->F54Stream.PollTimer);
+		}
 
 		if (controller->ControllerLock != NULL)
 		{
 			WdfObjectDelete(controller->ControllerLock);
 		}
 
+		RmiFreeRegisterDescriptors(controller);
+		RmiFreeSlotStorage(controller);
+
+		if (controller->Setup != NULL)
+		{
+			ExFreePoolWithTag(controller->Setup, TOUCH_POOL_TAG);
+		}
+
+		if (controller->Config != NULL)
+		{
+			TchConfigFree(controller->Config);
+		}
+
 		ExFreePoolWithTag(controller, TOUCH_POOL_TAG);
 	}
 
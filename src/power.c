@@ -19,9 +19,13 @@
 --*/
 
 #include "controller.h"
+#include "internal.h"
 #include "rmiinternal.h"
-#include "spb.h"
+#include "transport.h"
 #include "debug.h"
+#include "Function01.h"
+#include "Function54.h"
+#include "buttonreporting.h"
 //#include "power.tmh"
 
 NTSTATUS
@@ -51,13 +55,10 @@ Return Value:
 
 --*/
 {
-	RMI4_F01_CTRL_REGISTERS* controlF01;
-	UCHAR deviceControl;
+	RMI4_F01_CTRL_REGISTERS controlF01;
 	int index;
 	NTSTATUS status;
 
-	controlF01 = (RMI4_F01_CTRL_REGISTERS*)&deviceControl;
-
 	//
 	// Find RMI device control function housing sleep settings
 	// 
@@ -98,8 +99,8 @@ Return Value:
 	status = SpbReadDataSynchronously(
 		SpbContext,
 		ControllerContext->Descriptors[index].ControlBase,
-		&deviceControl,
-		sizeof(deviceControl)
+		&controlF01.DeviceControl.All,
+		sizeof(controlF01.DeviceControl.All)
 	);
 
 	if (!NT_SUCCESS(status))
@@ -116,7 +117,7 @@ Return Value:
 	//
 	// Assign new sleep state
 	//
-	controlF01->DeviceControl.SleepMode = SleepState;
+	controlF01.DeviceControl.SleepMode = SleepState;
 
 	//
 	// Write setting back to the controller
@@ -124,8 +125,8 @@ Return Value:
 	status = SpbWriteDataSynchronously(
 		SpbContext,
 		ControllerContext->Descriptors[index].ControlBase,
-		&deviceControl,
-		sizeof(deviceControl)
+		&controlF01.DeviceControl.All,
+		sizeof(controlF01.DeviceControl.All)
 	);
 
 	if (!NT_SUCCESS(status))
@@ -144,6 +145,176 @@ exit:
 	return status;
 }
 
+VOID
+RmiInvalidateTouchState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+   Forgets cached contacts once the controller stops scanning. The lifts
+   of contacts still reported down are sent right away, as no interrupt
+   will complete them while the controller sleeps. Must be called with
+   the controller lock held.
+
+Arguments:
+
+   ControllerContext - Touch controller context
+
+Return Value:
+
+   None
+
+--*/
+{
+	PDEVICE_EXTENSION devContext = GetDeviceContext(ControllerContext->FxDevice);
+
+	RmiResetFingerCache(ControllerContext);
+
+	ButtonsResetState(ControllerContext);
+
+	if (ControllerContext->HidQueueCount > 0)
+	{
+		SendHidReports(
+			devContext->PingPongQueue,
+			ControllerContext->HidQueue,
+			ControllerContext->HidQueueCount);
+
+		ControllerContext->HidQueueCount = 0;
+	}
+}
+
+NTSTATUS
+RmiEnterScreenOffState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+   Stops touch and button reporting while the display is off. Touch and
+   button interrupt sources are disabled first, then the controller is
+   put to sleep through F01. DisplayOff is only left set if both steps
+   succeed, otherwise the interrupt sources are enabled again so the
+   controller stays in the state DisplayOff describes.
+
+Arguments:
+
+   ControllerContext - Touch controller context
+
+   SpbContext - A pointer to the current i2c context
+
+Return Value:
+
+   NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS status;
+
+	//
+	// The interrupt enable mask drops touch and button sources while
+	// DisplayOff is set
+	//
+	ControllerContext->DisplayOff = TRUE;
+
+	status = RmiSetInterruptEnable(
+		ControllerContext,
+		SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_POWER,
+			"Could not disable touch interrupts for screen-off - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = RmiChangeSleepState(
+		ControllerContext,
+		SpbContext,
+		RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_SLEEPING);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_POWER,
+			"Could not sleep touch controller for screen-off - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	RmiInvalidateTouchState(ControllerContext);
+
+exit:
+
+	if (!NT_SUCCESS(status))
+	{
+		ControllerContext->DisplayOff = FALSE;
+
+		(VOID)RmiSetInterruptEnable(
+			ControllerContext,
+			SpbContext);
+	}
+
+	return status;
+}
+
+NTSTATUS
+RmiExitScreenOffState(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+Routine Description:
+
+   Restores normal operation when the display turns back on. The F01
+   control registers (sleep mode, doze settings and interrupt enable)
+   are rewritten from the cached configuration in one transfer.
+   DisplayOff stays set if they cannot be written.
+
+Arguments:
+
+   ControllerContext - Touch controller context
+
+   SpbContext - A pointer to the current i2c context
+
+Return Value:
+
+   NTSTATUS indicating success or failure
+
+--*/
+{
+	NTSTATUS status;
+
+	ControllerContext->DisplayOff = FALSE;
+
+	status = RmiConfigureFunction01(
+		ControllerContext,
+		SpbContext);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_POWER,
+			"Could not restore touch controller after screen-off - STATUS:%X",
+			status);
+
+		ControllerContext->DisplayOff = TRUE;
+	}
+
+	return status;
+}
+
 NTSTATUS
 TchWakeDevice(
 	IN VOID* ControllerContext,
@@ -172,6 +343,8 @@ Return Value:
 
 	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
 
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
 	//
 	// Check if we were already on
 	//
@@ -183,24 +356,58 @@ Return Value:
 	controller->DevicePowerState = PowerDeviceD0;
 
 	//
-	// Attempt to put the controller into operating mode 
+	// Attempt to put the controller into operating mode, unless the
+	// display is off in which case it stays in the screen-off state
 	//
-	status = RmiChangeSleepState(
+	if (!controller->DisplayOff)
+	{
+		//
+		// Program register images of a reload made while asleep
+		//
+		(VOID)RmiApplyPendingConfiguration(
+			controller,
+			SpbContext);
+
+		status = RmiChangeSleepState(
+			controller,
+			SpbContext,
+			RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_OPERATING);
+
+		if (!NT_SUCCESS(status))
+		{
+			Trace(
+				TRACE_LEVEL_ERROR,
+				TRACE_FLAG_POWER,
+				"Error waking touch controller - STATUS:%X",
+				status);
+		}
+	}
+
+	//
+	// Apply interrupt source changes made while the controller was off
+	//
+	status = RmiSetInterruptEnable(
 		controller,
-		SpbContext,
-		RMI4_F11_DEVICE_CONTROL_SLEEP_MODE_OPERATING);
+		SpbContext);
 
 	if (!NT_SUCCESS(status))
 	{
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_POWER,
-			"Error waking touch controller - STATUS:%X",
+			"Error restoring interrupt enable mask - STATUS:%X",
 			status);
 	}
 
+	//
+	// A capture parked on D0 exit picks up again
+	//
+	RmiF54ResumeStream(controller);
+
 exit:
 
+	WdfWaitLockRelease(controller->ControllerLock);
+
 	return STATUS_SUCCESS;
 }
 
@@ -239,6 +446,12 @@ Return Value:
 	//
 	WdfWaitLockAcquire(controller->ControllerLock, NULL);
 
+	//
+	// Stop requesting and reading F54 reports, the controller is about
+	// to sleep and is not to be talked to until D0 entry
+	//
+	RmiF54ParkStream(controller);
+
 	//
 	// Put the chip in sleep mode
 	//
@@ -261,12 +474,159 @@ Return Value:
 	//
 	// Invalidate state
 	//
-	controller->FingerCache.FingerSlotValid = 0;
-	controller->FingerCache.FingerSlotDirty = 0;
-	controller->FingerCache.FingerDownCount = 0;
-    controller->HidQueueCount = 0;
+	RmiInvalidateTouchState(controller);
+
+	WdfWaitLockRelease(controller->ControllerLock);
+
+	return STATUS_SUCCESS;
+}
+NTSTATUS
+TchOnDisplayStateChange(
+	_In_ LPCGUID SettingGuid,
+	_In_reads_bytes_(ValueLength) PVOID Value,
+	_In_ ULONG ValueLength,
+	_Inout_opt_ PVOID Context
+)
+/*++
+
+Routine Description:
+
+	This callback is invoked on monitor state changes. While the display
+	is off the controller is kept in a low power screen-off state with
+	touch and button interrupts disabled, as D-state changes may not
+	coincide with monitor state changes. The notification is then passed
+	on to capacitive button backlight control, this is the only monitor
+	state callback the driver registers.
+
+	DisplayOff only takes the new state once the transition succeeded,
+	so a failed transition is tried again on the next notification.
+
+Arguments:
+
+	SettingGuid - GUID_MONITOR_POWER_ON (the only notification registered)
+	Value - Either MONITOR_IS_ON or MONITOR_IS_OFF
+	ValueLength - Ignored, always sizeof(ULONG)
+	Context - Touch controller context
+
+Return Value:
+
+	Ignored, always returns STATUS_SUCCESS
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	PDEVICE_EXTENSION devContext;
+	BKL_CONTEXT* bklContext;
+	ULONG monitorState;
+	BOOLEAN displayOff;
+	ULONG64 startTime;
+	ULONG64 latency;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)Context;
+
+	//
+	// Should never happen, but we don't care about events unrelated to display
+	//
+	if (!InlineIsEqualGUID(SettingGuid, &GUID_MONITOR_POWER_ON))
+	{
+		goto exit;
+	}
+
+	//
+	// Should never happen, but check for bad parameters for this notification
+	//
+	if (Value == NULL || ValueLength != sizeof(ULONG) || controller == NULL)
+	{
+		goto exit;
+	}
+
+	monitorState = *((PULONG)Value);
+	displayOff = (monitorState == MONITOR_IS_OFF) ? TRUE : FALSE;
+	devContext = GetDeviceContext(controller->FxDevice);
+
+	WdfWaitLockAcquire(controller->ControllerLock, NULL);
+
+	if (controller->DisplayOff == displayOff)
+	{
+		goto release;
+	}
+
+	//
+	// While the controller is in D3 the new state is applied on wake
+	//
+	if (controller->DevicePowerState != PowerDeviceD0)
+	{
+		controller->DisplayOff = displayOff;
+		goto release;
+	}
+
+	startTime = KeQueryInterruptTime();
+
+	if (displayOff)
+	{
+		status = RmiEnterScreenOffState(
+			controller,
+			&devContext->SpbContext);
+	}
+	else
+	{
+		status = RmiExitScreenOffState(
+			controller,
+			&devContext->SpbContext);
+	}
+
+	latency = KeQueryInterruptTime() - startTime;
+
+	if (!NT_SUCCESS(status))
+	{
+		goto release;
+	}
+
+	if (displayOff)
+	{
+		controller->ScreenOffTransitions++;
+		controller->ScreenOffLatency = latency;
+
+		RmiF54ParkStream(controller);
+	}
+	else
+	{
+		controller->ScreenOnLatency = latency;
+
+		(VOID)RmiApplyPendingConfiguration(
+			controller,
+			&devContext->SpbContext);
+
+		RmiF54ResumeStream(controller);
+	}
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_POWER,
+		"Screen-%s transition took %llu us",
+		displayOff ? "off" : "on",
+		latency / 10);
+
+release:
+
+	bklContext = controller->BklContext;
 
 	WdfWaitLockRelease(controller->ControllerLock);
 
+	//
+	// The backlight follows the monitor even if the controller could not
+	//
+	if (bklContext != NULL)
+	{
+		(VOID)TchOnMonitorStateChange(
+			SettingGuid,
+			Value,
+			ValueLength,
+			bklContext);
+	}
+
+exit:
+
 	return STATUS_SUCCESS;
-}
\ No newline at end of file
+}
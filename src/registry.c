@@ -21,6 +21,12 @@
 --*/
 
 #include "rmiinternal.h"
+#include "Function01.h"
+#include "Function11.h"
+#include "buttonreporting.h"
+#include "contactfilter.h"
+#include "contactpredictor.h"
+#include "contacttracker.h"
 #include "debug.h"
 //#include "registry.tmh"
 
@@ -29,7 +35,7 @@
 // RMI4 specification for a full description of the fields and value meanings
 //
 
-static RMI4_CONFIGURATION gDefaultConfiguration =
+static const RMI4_CONFIGURATION gDefaultConfiguration =
 {
 	//
 	// RMI4 F01 - Device control settings
@@ -39,7 +45,7 @@ static RMI4_CONFIGURATION gDefaultConfiguration =
 		1,                                              // No Sleep (do sleep)
 		0,                                              // Report Rate (standard)
 		1,                                              // Configured
-		0xf,                                            // Interrupt Enable
+		0,                                              // Interrupt Enable (extra sources)
 		RMI4_MILLISECONDS_TO_TENTH_MILLISECONDS(20),    // Doze Interval
 		10,                                             // Doze Threshold
 		RMI4_SECONDS_TO_HALF_SECONDS(2)                 // Doze Holdoff
@@ -91,12 +97,42 @@ static RMI4_CONFIGURATION gDefaultConfiguration =
 	//
 	// Internal driver settings
 	//
+	0x0,                                                // Controller stays powered in D3
+
+	//
+	// Contact filter
+	//
+	{
+		1,                                              // Enable
+		RMI4_FILTER_DEFAULT_MIN_CUTOFF,                 // MinCutoff
+		RMI4_FILTER_DEFAULT_BETA,                       // Beta
+		RMI4_FILTER_DEFAULT_DERIVATIVE_CUTOFF           // DerivativeCutoff
+	},
+
+	//
+	// Contact prediction
+	//
 	{
-		0x0,                                            // Controller stays powered in D3
+		RMI4_PREDICTOR_DEFAULT_HORIZON,                 // Horizon (off)
+		RMI4_PREDICTOR_DEFAULT_MAX_DISTANCE,            // MaxDistance
+		RMI4_PREDICTOR_DEFAULT_MIN_SPEED                // MinSpeed
+	},
+
+	//
+	// Contact tracking
+	//
+	{
+		1,                                              // Enable
+		0                                               // MaxDistance (from sensor size)
 	},
 };
 
-RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
+//
+// Values read over the defaults above. EntryContext holds the offset of the
+// field in RMI4_CONFIGURATION and is rebased on a private copy of the table,
+// so the template itself is never written.
+//
+static const RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
 {
 	//
 	// RMI4 F01 - Device control settings
@@ -106,72 +142,72 @@ RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
 		L"SleepMode",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, SleepMode)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.SleepMode,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"NoSleep",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, NoSleep)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.NoSleep,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ReportRate",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, ReportRate)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.ReportRate,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"Configured",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, Configured)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.Configured,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"InterruptEnable",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, InterruptEnable)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.InterruptEnable,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DozeInterval",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, DozeInterval)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.DozeInterval,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DozeThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, DozeThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.DozeThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DozeHoldoff",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, DeviceSettings) +
 			FIELD_OFFSET(RMI4_F01_CTRL_REGISTERS_LOGICAL, DozeHoldoff)),
-		REG_DWORD,
-		&gDefaultConfiguration.DeviceSettings.DozeHoldoff,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 
 	//
@@ -182,333 +218,333 @@ RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
 		L"ReportingMode",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ReportingMode)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ReportingMode,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"AbsPosFilt",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, AbsPosFilt)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.AbsPosFilt,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"RelPosFilt",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, RelPosFilt)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.RelPosFilt,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"RelBallistics",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, RelBallistics)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.RelBallistics,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"Dribble",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, Dribble)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.Dribble,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"PalmDetectThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, PalmDetectThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.PalmDetectThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"MotionSensitivity",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, MotionSensitivity)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.MotionSensitivity,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ManTrackEn",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ManTrackEn)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ManTrackEn,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ManTrackedFinger",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ManTrackedFinger)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ManTrackedFinger,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DeltaXPosThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, DeltaXPosThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.DeltaXPosThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DeltaYPosThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, DeltaYPosThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.DeltaYPosThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"Velocity",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, Velocity)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.Velocity,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"Acceleration",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, Acceleration)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.Acceleration,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"SensorMaxXPos",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, SensorMaxXPos)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.SensorMaxXPos,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"SensorMaxYPos",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, SensorMaxYPos)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.SensorMaxYPos,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 		{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ZTouchThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ZTouchThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ZTouchThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ZHysteresis",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ZHysteresis)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ZHysteresis,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"SmallZThreshold",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, SmallZThreshold)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.SmallZThreshold,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"SmallZScaleFactor",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, SmallZScaleFactor)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.SmallZScaleFactor,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"LargeZScaleFactor",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, LargeZScaleFactor)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.LargeZScaleFactor,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"AlgorithmSelection",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, AlgorithmSelection)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.AlgorithmSelection,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"WxScaleFactor",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, WxScaleFactor)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.WxScaleFactor,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"WxOffset",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, WxOffset)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.WxOffset,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"WyScaleFactor",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, WyScaleFactor)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.WyScaleFactor,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"WyOffset",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, WyOffset)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.WyOffset,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"XPitch",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, XPitch)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.XPitch,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"YPitch",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, YPitch)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.YPitch,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"FingerWidthX",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, FingerWidthX)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.FingerWidthX,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"FingerWidthY",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, FingerWidthY)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.FingerWidthY,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"ReportMeasuredSize",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, ReportMeasuredSize)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.ReportMeasuredSize,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"SegmentationSensitivity",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, SegmentationSensitivity)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.SegmentationSensitivity,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"XClipLo",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, XClipLo)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.XClipLo,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"XClipHi",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, XClipHi)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.XClipHi,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"YClipLo",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, YClipLo)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.YClipLo,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"YClipHi",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, YClipHi)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.YClipHi,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"MinFingerSeparation",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, MinFingerSeparation)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.MinFingerSeparation,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"MaxFingerMovement",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TouchSettings) +
 			FIELD_OFFSET(RMI4_F11_CTRL_REGISTERS_LOGICAL, MaxFingerMovement)),
-		REG_DWORD,
-		&gDefaultConfiguration.TouchSettings.MaxFingerMovement,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
 	},
 
 	//
@@ -522,9 +558,90 @@ RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"PepRemovesVoltageInD3",
 		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, PepRemovesVoltageInD3)),
-		REG_DWORD,
-		&gDefaultConfiguration.PepRemovesVoltageInD3,
-		sizeof(UINT32)
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactFilterEnable",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, FilterSettings) +
+			FIELD_OFFSET(RMI4_FILTER_SETTINGS, Enable)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactFilterMinCutoff",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, FilterSettings) +
+			FIELD_OFFSET(RMI4_FILTER_SETTINGS, MinCutoff)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactFilterBeta",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, FilterSettings) +
+			FIELD_OFFSET(RMI4_FILTER_SETTINGS, Beta)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactFilterDerivativeCutoff",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, FilterSettings) +
+			FIELD_OFFSET(RMI4_FILTER_SETTINGS, DerivativeCutoff)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactPredictionHorizon",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, PredictorSettings) +
+			FIELD_OFFSET(RMI4_PREDICTOR_SETTINGS, Horizon)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactPredictionMaxDistance",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, PredictorSettings) +
+			FIELD_OFFSET(RMI4_PREDICTOR_SETTINGS, MaxDistance)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactPredictionMinSpeed",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, PredictorSettings) +
+			FIELD_OFFSET(RMI4_PREDICTOR_SETTINGS, MinSpeed)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactTrackingEnable",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TrackerSettings) +
+			FIELD_OFFSET(RMI4_TRACKER_SETTINGS, Enable)),
+		REG_NONE,
+		NULL,
+		0
+	},
+	{
+		NULL, RTL_QUERY_REGISTRY_DIRECT,
+		L"ContactTrackingMaxDistance",
+		(PVOID)(FIELD_OFFSET(RMI4_CONFIGURATION, TrackerSettings) +
+			FIELD_OFFSET(RMI4_TRACKER_SETTINGS, MaxDistance)),
+		REG_NONE,
+		NULL,
+		0
 	},
 
 	//
@@ -539,77 +656,123 @@ RTL_QUERY_REGISTRY_TABLE gRegistryTable[] =
 		0
 	}
 };
-static const ULONG gcbRegistryTable = sizeof(gRegistryTable);
-static const ULONG gcRegistryTable =
-sizeof(gRegistryTable) / sizeof(gRegistryTable[0]);
-
 
 NTSTATUS
-TchRegistryGetControllerSettings(
-	IN VOID* ControllerContext
+TchRegistryQueryTable(
+	IN WDFDEVICE FxDevice,
+	IN PCWSTR SharedKeyPath,
+	IN const RTL_QUERY_REGISTRY_TABLE* Template,
+	IN ULONG TemplateBytes,
+	IN PVOID Base
 )
 /*++
 
   Routine Description:
 
-	This routine retrieves controller wide settings
-	from the registry.
+	Reads the values described by a registry table template into a per
+	device structure. The machine wide key shared by every controller is
+	read first, then the device's hardware key so values set for one
+	instance override the shared ones. Values found in neither key keep
+	whatever Base already holds.
 
   Arguments:
 
 	FxDevice - a handle to the framework device object
-	Settings - A pointer to the chip settings structure
+	SharedKeyPath - absolute path of the machine wide settings key
+	Template - direct query table terminated by an empty entry, with
+		EntryContext holding field offsets into Base
+	TemplateBytes - size of the template in bytes
+	Base - structure receiving the values
 
   Return Value:
 
-	NTSTATUS indicating success or failure
+	NTSTATUS indicating success or failure, a missing key is not an error
 
 --*/
 {
-	RMI4_CONTROLLER_CONTEXT* controller;
+	PRTL_QUERY_REGISTRY_TABLE regTable;
+	ULONG entries;
+	WDFKEY key = NULL;
+	NTSTATUS status;
 	ULONG i;
-	PRTL_QUERY_REGISTRY_TABLE regTable = NULL;
-	NTSTATUS status = STATUS_SUCCESS;
 
-	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+	entries = TemplateBytes / sizeof(RTL_QUERY_REGISTRY_TABLE);
 
 	//
 	// RtlQueryRegistryValues table must be allocated from NonPagedPool
 	//
-
 	regTable = ExAllocatePoolWithTag(
-		NonPagedPool,
-		gcbRegistryTable,
+		NonPagedPoolNx,
+		TemplateBytes,
 		TOUCH_POOL_TAG);
 
 	if (regTable == NULL)
 	{
+		status = STATUS_INSUFFICIENT_RESOURCES;
 		goto exit;
 	}
 
 	RtlCopyMemory(
 		regTable,
-		gRegistryTable,
-		gcbRegistryTable);
+		Template,
+		TemplateBytes);
 
 	//
 	// Update offset values with base pointer
-	// 
-
-	for (i = 0; i < gcRegistryTable - 1; i++)
+	//
+	for (i = 0; i < entries - 1; i++)
 	{
 		(regTable + i)->EntryContext = (PVOID)(
 			((SIZE_T)(regTable + i)->EntryContext) +
-			((ULONG_PTR)&controller->Config));
+			((ULONG_PTR)Base));
 	}
 
-	//
-	// Populate device context with registry or default configurations
-	//
-
 	status = RtlQueryRegistryValues(
 		RTL_REGISTRY_ABSOLUTE,
-		TOUCH_CONTROLLER_SETTINGS_REG_KEY,
+		SharedKeyPath,
+		regTable,
+		NULL,
+		NULL);
+
+	if (status == STATUS_OBJECT_NAME_NOT_FOUND)
+	{
+		status = STATUS_SUCCESS;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Error retrieving shared registry configuration - STATUS:%X",
+			status);
+
+		goto exit;
+	}
+
+	status = WdfDeviceOpenRegistryKey(
+		FxDevice,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_REGISTRY,
+			"No hardware key, using shared configuration - STATUS:%X",
+			status);
+
+		key = NULL;
+		status = STATUS_SUCCESS;
+		goto exit;
+	}
+
+	status = RtlQueryRegistryValues(
+		RTL_REGISTRY_HANDLE,
+		(PCWSTR)WdfRegistryWdmGetHandle(key),
 		regTable,
 		NULL,
 		NULL);
@@ -619,7 +782,7 @@ TchRegistryGetControllerSettings(
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_REGISTRY,
-			"Error retrieving registry configuration - STATUS:%X",
+			"Error retrieving device registry configuration - STATUS:%X",
 			status);
 
 		goto exit;
@@ -627,6 +790,98 @@ TchRegistryGetControllerSettings(
 
 exit:
 
+	if (key != NULL)
+	{
+		WdfRegistryClose(key);
+	}
+
+	if (regTable != NULL)
+	{
+		ExFreePoolWithTag(regTable, TOUCH_POOL_TAG);
+	}
+
+	return status;
+}
+
+NTSTATUS
+TchConfigBuild(
+	IN WDFDEVICE FxDevice,
+	OUT RMI4_CONFIG_SNAPSHOT** Config
+)
+/*++
+
+  Routine Description:
+
+	Builds a configuration snapshot in a single pass over the registry.
+	Each source is read once: the screen properties, the controller
+	settings, the buttons key and the backlight lux table. The values
+	are then validated and compiled into the F01 and F11 register images,
+	the contact filter, prediction and tracking tuning and the button
+	regions in controller coordinates, so nothing is converted again when
+	the controller is programmed or reports.
+
+  Arguments:
+
+	FxDevice - a handle to the framework device object
+	Config - receives the snapshot, freed with TchConfigFree. Its
+		version is stamped when it is published.
+
+  Return Value:
+
+	NTSTATUS indicating success or failure. Controller settings that
+	cannot be read are defaulted, screen properties that leave no area
+	to scale coordinates over fail the build.
+
+--*/
+{
+	RMI4_CONFIG_SNAPSHOT* config;
+	NTSTATUS status;
+
+	*Config = NULL;
+
+	config = ExAllocatePoolWithTag(
+		NonPagedPoolNx,
+		sizeof(RMI4_CONFIG_SNAPSHOT),
+		TOUCH_POOL_TAG);
+
+	if (config == NULL)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Could not allocate configuration snapshot");
+
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	RtlZeroMemory(config, sizeof(RMI4_CONFIG_SNAPSHOT));
+
+	status = TchGetScreenProperties(FxDevice, &config->Props);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	//
+	// Start with default values
+	//
+	RtlCopyMemory(
+		&config->Settings,
+		&gDefaultConfiguration,
+		sizeof(RMI4_CONFIGURATION));
+
+	//
+	// Populate the snapshot with registry overrides
+	//
+	status = TchRegistryQueryTable(
+		FxDevice,
+		TOUCH_CONTROLLER_SETTINGS_REG_KEY,
+		gRegistryTable,
+		sizeof(gRegistryTable),
+		&config->Settings);
+
 	if (!NT_SUCCESS(status))
 	{
 		//
@@ -634,7 +889,7 @@ exit:
 		// issue reading configuration data from the registry
 		//
 		RtlCopyMemory(
-			&controller->Config,
+			&config->Settings,
 			&gDefaultConfiguration,
 			sizeof(RMI4_CONFIGURATION));
 
@@ -647,18 +902,308 @@ exit:
 		status = STATUS_SUCCESS;
 	}
 
-	if (controller->Config.TouchSettings.SensorMaxXPos == 254)
+	if (config->Settings.TouchSettings.SensorMaxXPos == 254)
 	{
-		controller->Config.TouchSettings.SensorMaxXPos = controller->Props.DisplayPhysicalWidth;
+		config->Settings.TouchSettings.SensorMaxXPos = config->Props.DisplayPhysicalWidth;
 	}
-	if (controller->Config.TouchSettings.SensorMaxYPos == 253)
+	if (config->Settings.TouchSettings.SensorMaxYPos == 253)
 	{
-		controller->Config.TouchSettings.SensorMaxYPos = controller->Props.DisplayPhysicalHeight;
+		config->Settings.TouchSettings.SensorMaxYPos = config->Props.DisplayPhysicalHeight;
 	}
 
-	if (regTable != NULL)
+	//
+	// Compile the register images programmed into the controller
+	//
+	RmiConvertF01ToPhysical(
+		&config->Settings.DeviceSettings,
+		&config->F01Ctrl);
+
+	RmiConvertF11ToPhysical(
+		&config->Settings.TouchSettings,
+		&config->F11Ctrl);
+
+	RmiFilterCompile(
+		&config->Settings.FilterSettings,
+		&config->Filter);
+
+	RmiPredictorCompile(
+		&config->Settings.PredictorSettings,
+		&config->Predictor);
+
+	RmiTrackerCompile(
+		&config->Settings.TrackerSettings,
+		&config->Props,
+		&config->Tracker);
+
+	ButtonsLoadConfiguration(FxDevice, config);
+
+	TchBklLoadLuxTable(config->LuxTable, &config->LuxLevels);
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_REGISTRY,
+		"Built configuration, display %dx%d, %d button regions, %d lux levels",
+		config->Props.DisplayPhysicalWidth,
+		config->Props.DisplayPhysicalHeight,
+		config->ButtonRegions.Count,
+		config->LuxLevels);
+
+	*Config = config;
+	config = NULL;
+
+exit:
+
+	if (config != NULL)
 	{
-		ExFreePoolWithTag(regTable, TOUCH_POOL_TAG);
+		TchConfigFree(config);
+	}
+
+	return status;
+}
+
+VOID
+TchConfigFree(
+	IN RMI4_CONFIG_SNAPSHOT* Config
+)
+/*++
+
+  Routine Description:
+
+	Frees a configuration snapshot that is no longer published
+
+  Arguments:
+
+	Config - snapshot built by TchConfigBuild
+
+  Return Value:
+
+	None
+
+--*/
+{
+	ExFreePoolWithTag(Config, TOUCH_POOL_TAG);
+}
+
+NTSTATUS
+TchRegistryGetControllerSettings(
+	IN VOID* ControllerContext
+)
+/*++
+
+  Routine Description:
+
+	This routine builds and publishes the first configuration snapshot
+	of one controller when the hardware is prepared. Later snapshots
+	replace it through TchReloadConfiguration.
+
+  Arguments:
+
+	ControllerContext - Touch controller context
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_CONTROLLER_CONTEXT* controller;
+	NTSTATUS status;
+
+	controller = (RMI4_CONTROLLER_CONTEXT*)ControllerContext;
+
+	NT_ASSERT(controller->Config == NULL);
+
+	status = TchConfigBuild(
+		controller->FxDevice,
+		&controller->Config);
+
+	if (NT_SUCCESS(status))
+	{
+		controller->Config->Version = 1;
+	}
+
+	return status;
+}
+
+NTSTATUS
+TchRegistryReadTopology(
+	IN WDFDEVICE FxDevice,
+	OUT RMI4_TOPOLOGY* Topology
+)
+/*++
+
+  Routine Description:
+
+	Reads the controller topology persisted by a previous start from the
+	device's hardware key. Only the layout of the value is checked here,
+	the caller validates it against the firmware.
+
+  Arguments:
+
+	FxDevice - a handle to the framework device object
+	Topology - receives the topology
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	DECLARE_CONST_UNICODE_STRING(valueName, TOUCH_TOPOLOGY_VALUE_NAME);
+	WDFKEY key = NULL;
+	ULONG valueLength = 0;
+	ULONG valueType = REG_NONE;
+	ULONG f12Bytes = 0;
+	NTSTATUS status;
+	int i;
+
+	status = WdfDeviceOpenRegistryKey(
+		FxDevice,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_READ,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+
+	if (!NT_SUCCESS(status))
+	{
+		key = NULL;
+		goto exit;
+	}
+
+	status = WdfRegistryQueryValue(
+		key,
+		&valueName,
+		sizeof(RMI4_TOPOLOGY),
+		Topology,
+		&valueLength,
+		&valueType);
+
+	if (!NT_SUCCESS(status))
+	{
+		goto exit;
+	}
+
+	if (valueType != REG_BINARY ||
+		valueLength != sizeof(RMI4_TOPOLOGY) ||
+		Topology->Signature != RMI4_TOPOLOGY_SIGNATURE ||
+		Topology->Version != RMI4_TOPOLOGY_VERSION ||
+		Topology->FunctionCount == 0 ||
+		Topology->FunctionCount >= RMI4_MAX_FUNCTIONS)
+	{
+		status = STATUS_REVISION_MISMATCH;
+		goto exit;
+	}
+
+	//
+	// A topology whose functions own sources F01 does not carry was not
+	// discovered by this driver
+	//
+	for (i = 0; i < RMI4_MAX_FUNCTIONS; i++)
+	{
+		if (Topology->FunctionIrqMask[i] >= (1UL << RMI4_MAX_INTERRUPT_SOURCES))
+		{
+			status = STATUS_REVISION_MISMATCH;
+			goto exit;
+		}
+	}
+
+	for (i = 0; i < RMI_REG_DESC_COUNT; i++)
+	{
+		f12Bytes += Topology->F12StructSize[i];
+
+		if (Topology->F12PresenceSize[i] > RMI_REG_DESC_PRESENCE_MAX)
+		{
+			status = STATUS_REVISION_MISMATCH;
+			goto exit;
+		}
+	}
+
+	if (f12Bytes > RMI4_TOPOLOGY_F12_BYTES)
+	{
+		status = STATUS_REVISION_MISMATCH;
+		goto exit;
+	}
+
+exit:
+
+	if (key != NULL)
+	{
+		WdfRegistryClose(key);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_INFORMATION,
+			TRACE_FLAG_REGISTRY,
+			"No usable controller topology in the device key - STATUS:%X",
+			status);
+	}
+
+	return status;
+}
+
+NTSTATUS
+TchRegistryWriteTopology(
+	IN WDFDEVICE FxDevice,
+	IN const RMI4_TOPOLOGY* Topology
+)
+/*++
+
+  Routine Description:
+
+	Persists the controller topology in the device's hardware key, it
+	replaces the topology of any previous firmware.
+
+  Arguments:
+
+	FxDevice - a handle to the framework device object
+	Topology - the topology discovered on this start
+
+  Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	DECLARE_CONST_UNICODE_STRING(valueName, TOUCH_TOPOLOGY_VALUE_NAME);
+	WDFKEY key = NULL;
+	NTSTATUS status;
+
+	status = WdfDeviceOpenRegistryKey(
+		FxDevice,
+		PLUGPLAY_REGKEY_DEVICE,
+		KEY_WRITE,
+		WDF_NO_OBJECT_ATTRIBUTES,
+		&key);
+
+	if (!NT_SUCCESS(status))
+	{
+		key = NULL;
+		goto exit;
+	}
+
+	status = WdfRegistryAssignValue(
+		key,
+		&valueName,
+		REG_BINARY,
+		sizeof(RMI4_TOPOLOGY),
+		(PVOID)Topology);
+
+exit:
+
+	if (key != NULL)
+	{
+		WdfRegistryClose(key);
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_WARNING,
+			TRACE_FLAG_REGISTRY,
+			"Could not persist the controller topology - STATUS:%X",
+			status);
 	}
 
 	return status;
@@ -21,14 +21,54 @@
 #include "controller.h"
 #include "config.h"
 #include "rmiinternal.h"
-#include "spb.h"
+#include "transport.h"
 #include "debug.h"
 #include "buttonreporting.h"
 #include "hid.h"
 #include "Function11.h"
 #include "Function12.h"
+#include "Function54.h"
+#include "contactfilter.h"
+#include "contactpredictor.h"
+#include "contacttracker.h"
 //#include "report.tmh"
 
+static VOID
+RmiStartReportedPositions(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Starts the reported position of each contact down from the position
+	the controller reported, for the filter and the predictor to move.
+	FingerSlot keeps the controller positions, which the reporting mode
+	and the tracker compare frames with. A lifted slot keeps the position
+	its contact was last reported at.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	ULONG fingers = ControllerContext->SlotCapacity;
+	ULONG i;
+
+	for (i = find_first_bit(cache->FingerSlotValid, fingers);
+		i < fingers;
+		i = find_next_bit(cache->FingerSlotValid, fingers, i + 1))
+	{
+		cache->Report[i] = cache->FingerSlot[i];
+	}
+}
+
 NTSTATUS
 RmiGetTouchesFromController(
 	IN RMI4_CONTROLLER_CONTEXT* ControllerContext,
@@ -46,6 +86,14 @@ RmiGetTouchesFromController(
 		status = GetTouchesFromF11(ControllerContext, SpbContext);
 	}
 
+	if (NT_SUCCESS(status))
+	{
+		RmiTrackContacts(ControllerContext);
+		RmiStartReportedPositions(ControllerContext);
+		RmiFilterContacts(ControllerContext);
+		RmiPredictContacts(ControllerContext);
+	}
+
 	return status;
 }
 
@@ -83,6 +131,8 @@ Return Value:
     NTSTATUS status;
     RMI4_FINGER_CACHE* fingerCache = &(ControllerContext->FingerCache);
     RMI4_BUTTONS_CACHE* buttonsCache = &(ControllerContext->ButtonsCache);
+    RMI4_CONTACT_TRACKER* tracker = fingerCache->Tracker;
+    RMI4_CONTACT_LIFT* lift;
 
 	int currentFingerIndex;
 	int fingersToReport;
@@ -92,26 +142,46 @@ Return Value:
 
     int touchesReported = 0;
     int keyTouchesReported = 0;
+    int hiddenTouches = 0;
+    int orderIndex = 0;
+
+    //
+    // First report keys. Contacts in button or dead zone regions are
+    // marked in KeyMask and left out of the touch reports below
+    //
+    bitmap_zero(fingerCache->KeyMask, ControllerContext->MaxFingers);
 
-    //first report keys
     for(i = 0; i < fingerCache->FingerDownCount; i++)
     {
-        USHORT X1 = (USHORT)fingerCache->FingerSlot[fingerCache->FingerDownOrder[i]].x;
-        USHORT Y1 = (USHORT)fingerCache->FingerSlot[fingerCache->FingerDownOrder[i]].y;
+        int slot = fingerCache->FingerDownOrder[i];
 
-        ULONG ButtonIndex = TchHandleButtonArea(X1, Y1, Props);
+        //
+        // Lifts of contacts that went on in another slot are not reported
+        //
+        if(test_bit(slot, fingerCache->ContactHidden))
+        {
+            hiddenTouches++;
+            continue;
+        }
 
-        if(ButtonIndex != BUTTON_NONE)
+        REPORTED_BUTTON button = TchHandleButtonArea(
+            &ControllerContext->Config->ButtonRegions,
+            fingerCache->FingerSlot[slot].x,
+            fingerCache->FingerSlot[slot].y);
+
+        if(button != BUTTON_NONE)
         {
-            fingerCache->IsKey[i] = TRUE;
+            __set_bit(slot, fingerCache->KeyMask);
             keyTouchesReported++;
-            if(ButtonIndex != BUTTON_UNKNOWN)
-                buttonsCache->PhysicalState[ButtonIndex - 1] = fingerCache->FingerSlot[fingerCache->FingerDownOrder[i]].fingerStatus;
+            if(button != BUTTON_UNKNOWN)
+                buttonsCache->PhysicalState[button - 1] = fingerCache->FingerSlot[slot].fingerStatus;
         }
     }
     if(keyTouchesReported > 0)
     {
-        status = FillButtonsReportFromCache(ControllerContext);
+        status = FillButtonsReportFromCache(
+            ControllerContext,
+            fingerCache->ScanTime * 1000);
         if(!NT_SUCCESS(status))
         {
             Trace(
@@ -123,7 +193,26 @@ Return Value:
         }
     }
     
-    UCHAR touchesToReport = ((fingerCache->FingerDownCount - keyTouchesReported) & 0xFF);
+    //
+    // Contacts whose slot was taken over by a new contact are reported
+    // lifted after the slots. A frame cannot carry more contacts than the
+    // Maximum Count of the report descriptor.
+    //
+    int touchesToReport = fingerCache->FingerDownCount - keyTouchesReported -
+        hiddenTouches + tracker->LiftCount;
+
+    if(touchesToReport > RMI4_REPORT_MAX_COUNT(ControllerContext))
+    {
+        Trace(
+            TRACE_LEVEL_WARNING,
+            TRACE_FLAG_HID,
+            "Reporting %d of %d contacts",
+            RMI4_REPORT_MAX_COUNT(ControllerContext),
+            touchesToReport
+        );
+
+        touchesToReport = RMI4_REPORT_MAX_COUNT(ControllerContext);
+    }
 
     //and report touches
     while(touchesToReport>0)
@@ -164,7 +253,7 @@ Return Value:
         //
         if(touchesReported == 0)
         {
-            hidTouch->InputReport.ActualCount = touchesToReport;
+            hidTouch->InputReport.ActualCount = (UCHAR)touchesToReport;
         }
         else
         {
@@ -174,22 +263,41 @@ Return Value:
         //
         // Only two fingers supported yet
         //
-        for(currentFingerIndex = 0; currentFingerIndex < fingersToReport; currentFingerIndex++)
+        for(currentFingerIndex = 0; currentFingerIndex < fingersToReport; orderIndex++)
         {
-            //if this touch reported as key ignore it
-            if(fingerCache->IsKey[touchesReported])
+            if(orderIndex >= fingerCache->FingerDownCount)
             {
+                lift = &tracker->Lifts[orderIndex - fingerCache->FingerDownCount];
+
+                hidTouch->InputReport.Contacts[currentFingerIndex].ContactId = lift->Id;
+
+                SctatchX = lift->X;
+                ScratchY = lift->Y;
+                TchTranslateToDisplayCoordinates(&SctatchX, &ScratchY, Props);
+
+                hidTouch->InputReport.Contacts[currentFingerIndex].wXData = SctatchX;
+                hidTouch->InputReport.Contacts[currentFingerIndex].wYData = ScratchY;
+
                 touchesReported++;
-                currentFingerIndex--;
+                touchesToReport--;
+                currentFingerIndex++;
                 continue;
             }
 
-            int currentlyReporting = fingerCache->FingerDownOrder[touchesReported];
+            int currentlyReporting = fingerCache->FingerDownOrder[orderIndex];
 
-            hidTouch->InputReport.Contacts[currentFingerIndex].ContactId = (UCHAR)currentlyReporting;
+            //if this touch reported as key or hidden ignore it
+            if(test_bit(currentlyReporting, fingerCache->KeyMask) ||
+                test_bit(currentlyReporting, fingerCache->ContactHidden))
+            {
+                continue;
+            }
+
+            hidTouch->InputReport.Contacts[currentFingerIndex].ContactId =
+                fingerCache->ContactId[currentlyReporting];
 
-            SctatchX = (USHORT)fingerCache->FingerSlot[currentlyReporting].x;
-            ScratchY = (USHORT)fingerCache->FingerSlot[currentlyReporting].y;
+            SctatchX = (USHORT)fingerCache->Report[currentlyReporting].x;
+            ScratchY = (USHORT)fingerCache->Report[currentlyReporting].y;
 
             //
             // Perform per-platform x/y adjustments to controller coordinates
@@ -222,11 +330,17 @@ Return Value:
                 hidTouch->InputReport.Contacts[currentFingerIndex].bStatus
             );
 #endif
+
+            currentFingerIndex++;
         }
 
     }
 
 exit:
+    //
+    // Lifts queued by the tracker are reported once
+    //
+    tracker->LiftCount = 0;
     return;
 }
 
@@ -286,12 +400,6 @@ Return Value:
 			goto exit;
 		}
 
-		//
-		// Prepare to report touches via HID reports
-		//
-        for(int i = 0; i < RMI4_MAX_TOUCHES; i++)
-            ControllerContext->FingerCache.IsKey[i] = FALSE;
-
 		//
 		// If no touches are present return that no data needed to be reported
 		//
@@ -321,7 +429,7 @@ Return Value:
 	//
     RmiFillHidReportFromCache(
         ControllerContext,
-        &ControllerContext->Props
+        &ControllerContext->Config->Props
     );
 
 	//
@@ -400,27 +508,45 @@ Return Value:
 	}
 
 	//
-	// Driver only services 0D cap button and 2D touch messages currently
+	// Sources disabled at runtime may still latch their status bits
+	//
+	controller->InterruptStatus &= controller->InterruptEnableMask;
+
+	//
+	// Device status was already handled while reading interrupt status
+	//
+	controller->InterruptStatus &= ~controller->DeviceIrqMask;
+
+	//
+	// Driver only services 0D cap button, 2D touch and F54 test
+	// reporting messages currently
 	//
 	if (controller->InterruptStatus &
-		~(RMI4_INTERRUPT_BIT_0D_CAP_BUTTON | RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED | RMI4_INTERRUPT_BIT_2D_TOUCH))
+		~(controller->ButtonIrqMask | controller->TouchIrqMask | controller->TestIrqMask))
 	{
 		Trace(
 			TRACE_LEVEL_WARNING,
 			TRACE_FLAG_INTERRUPT,
 			"Ignoring following interrupt flags - STATUS:%X",
 			controller->InterruptStatus &
-			~(RMI4_INTERRUPT_BIT_0D_CAP_BUTTON | 
-				RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED |
-				RMI4_INTERRUPT_BIT_2D_TOUCH));
+			~(controller->ButtonIrqMask | controller->TouchIrqMask | controller->TestIrqMask));
 
 		//
 		// Mask away flags we don't service
 		//
 		controller->InterruptStatus &=
-			(RMI4_INTERRUPT_BIT_0D_CAP_BUTTON |
-				RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED |
-				RMI4_INTERRUPT_BIT_2D_TOUCH);
+			(controller->ButtonIrqMask | controller->TouchIrqMask | controller->TestIrqMask);
+	}
+
+	//
+	// A completed F54 report never produces a HID report, it is read
+	// into the capture ring and the next one requested
+	//
+	if (controller->InterruptStatus & controller->TestIrqMask)
+	{
+		RmiF54ServiceInterrupt(controller, SpbContext);
+
+		controller->InterruptStatus &= ~controller->TestIrqMask;
 	}
 
 	//
@@ -429,29 +555,20 @@ Return Value:
 	//
 	status = STATUS_UNSUCCESSFUL;
 
-    BOOLEAN reversedKeys = FALSE;
 	//
 	// Service a capacitive button event if indicated by hardware
 	//
-	if (controller->InterruptStatus & RMI4_INTERRUPT_BIT_0D_CAP_BUTTON || 
-		controller->InterruptStatus & RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED)
+	if (controller->InterruptStatus & controller->ButtonIrqMask)
 	{
-
-		if (controller->InterruptStatus & RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED)
-		{
-			reversedKeys = TRUE;
-		}
-
 		status = RmiServiceCapacitiveButtonInterrupt(
 			ControllerContext,
 			SpbContext,
-			reversedKeys);
+			(controller->ButtonIrqMask & RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED) != 0);
 
 		//
 		// mask cap buttons interupts after service
 		//
-		controller->InterruptStatus &= ~RMI4_INTERRUPT_BIT_0D_CAP_BUTTON;
-		controller->InterruptStatus &= ~RMI4_INTERRUPT_BIT_0D_CAP_BUTTON_REVERSED;
+		controller->InterruptStatus &= ~controller->ButtonIrqMask;
 
         //
         //report if status unsuccess
@@ -469,7 +586,7 @@ Return Value:
 	//
 	// Service a touch data event if indicated by hardware 
 	//
-	if (controller->InterruptStatus & RMI4_INTERRUPT_BIT_2D_TOUCH)
+	if (controller->InterruptStatus & controller->TouchIrqMask)
 	{
 
 		status = RmiServiceTouchDataInterrupt(
@@ -480,7 +597,7 @@ Return Value:
 		//
 		// clear interupt
 		//
-		controller->InterruptStatus &= ~RMI4_INTERRUPT_BIT_2D_TOUCH;
+		controller->InterruptStatus &= ~controller->TouchIrqMask;
 
 		//
 		// report error
@@ -500,25 +617,343 @@ Return Value:
 	//
 
 exit:
-    
+
+	//
+	// Reports queued by one source are completed even if a source
+	// serviced after it had nothing to report
+	//
+	if (controller->HidQueueCount != 0)
+	{
+		status = STATUS_SUCCESS;
+	}
+
     *HidReports = controller->HidQueue;
     (*HidReportsLength) = controller->HidQueueCount;
     controller->HidQueueCount = 0;
 
+	WdfWaitLockRelease(controller->ControllerLock);
+
 	//
 	// Turn on capacitive key backlights that may have timed out
-	// due to user inactivity
+	// due to user inactivity. This only records a timestamp and never
+	// blocks, so it is done after the controller lock is dropped.
 	//
 	if (NT_SUCCESS(status) && (controller->BklContext != NULL))
 	{
 		TchBklNotifyTouchActivity(controller->BklContext, (DWORD)GetTickCount());
 	}
 
-	WdfWaitLockRelease(controller->ControllerLock);
-
 	return status;
 }
 
+static VOID
+RmiReportLifts(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Queues reports lifting every contact last reported down, at the
+	position it was last reported at. RmiInvalidateTouchState sends
+	them right away, otherwise they are completed with the reports of
+	the next serviced interrupt.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	PHID_INPUT_REPORT hidReport = NULL;
+	HID_CONTACT_POINT* contact;
+	USHORT x;
+	USHORT y;
+	int count = 0;
+	int reported = 0;
+	int slot;
+	int i;
+	NTSTATUS status;
+
+	for (i = 0; i < cache->FingerDownCount; i++)
+	{
+		slot = cache->FingerDownOrder[i];
+
+		if (test_bit(slot, cache->FingerSlotValid) &&
+			!test_bit(slot, cache->KeyMask) &&
+			!test_bit(slot, cache->ContactHidden))
+		{
+			count++;
+		}
+	}
+
+	for (i = 0; i < cache->FingerDownCount && reported < count; i++)
+	{
+		slot = cache->FingerDownOrder[i];
+
+		if (!test_bit(slot, cache->FingerSlotValid) ||
+			test_bit(slot, cache->KeyMask) ||
+			test_bit(slot, cache->ContactHidden))
+		{
+			continue;
+		}
+
+		if (reported % SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT == 0)
+		{
+			status = GetNextHidReport(ControllerContext, &hidReport);
+
+			if (!NT_SUCCESS(status))
+			{
+				Trace(
+					TRACE_LEVEL_ERROR,
+					TRACE_FLAG_HID,
+					"Could not queue the lift of %d contacts - STATUS:%X",
+					count - reported,
+					status);
+
+				break;
+			}
+
+			hidReport->ReportID = REPORTID_MTOUCH;
+			hidReport->TouchReport.InputReport.ScanTime = cache->ScanTime & 0xFFFF;
+			hidReport->TouchReport.InputReport.ActualCount =
+				(UCHAR)((reported == 0) ? count : 0);
+		}
+
+		contact = &hidReport->TouchReport.InputReport.Contacts[
+			reported % SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT];
+
+		x = cache->Report[slot].x;
+		y = cache->Report[slot].y;
+
+		TchTranslateToDisplayCoordinates(&x, &y, &ControllerContext->Config->Props);
+
+		contact->ContactId = cache->ContactId[slot];
+		contact->wXData = x;
+		contact->wYData = y;
+
+		reported++;
+	}
+}
+
+VOID
+RmiResetFingerCache(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Forgets every tracked contact. Contacts reported down are first
+	queued to be reported lifted, so they do not stay down on the host.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+
+	if (ControllerContext->SlotStorage != NULL)
+	{
+		RmiReportLifts(ControllerContext);
+
+		bitmap_zero(cache->FingerSlotValid, ControllerContext->SlotCapacity);
+		bitmap_zero(cache->FingerSlotDirty, ControllerContext->SlotCapacity);
+		bitmap_zero(cache->FrameValid, ControllerContext->SlotCapacity);
+		bitmap_zero(cache->FilterPrimed, ControllerContext->SlotCapacity);
+		bitmap_zero(cache->ContactTracked, ControllerContext->SlotCapacity);
+		bitmap_zero(cache->ContactHidden, ControllerContext->SlotCapacity);
+
+		cache->Tracker->Count = 0;
+		cache->Tracker->LiftCount = 0;
+
+		RtlZeroMemory(
+			cache->Predictor,
+			ControllerContext->SlotCapacity * sizeof(RMI4_PREDICTOR_STATE));
+	}
+
+	cache->FingerDownCount = 0;
+}
+
+VOID
+RmiFreeSlotStorage(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Releases the finger cache and HID report queue storage.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	None
+
+--*/
+{
+	if (ControllerContext->SlotStorage != NULL)
+	{
+		ExFreePoolWithTag(ControllerContext->SlotStorage, TOUCH_POOL_TAG);
+	}
+
+	RtlZeroMemory(&ControllerContext->FingerCache, sizeof(RMI4_FINGER_CACHE));
+	ControllerContext->SlotStorage = NULL;
+	ControllerContext->SlotCapacity = 0;
+	ControllerContext->HidQueue = NULL;
+	ControllerContext->HidQueueCapacity = 0;
+	ControllerContext->HidQueueCount = 0;
+}
+
+NTSTATUS
+RmiAllocateSlotStorage(
+	IN RMI4_CONTROLLER_CONTEXT* ControllerContext
+)
+/*++
+
+Routine Description:
+
+	Sizes the finger cache and the HID report queue for the MaxFingers
+	contacts the touch function was configured with. Storage is kept
+	when a reconfiguration reports the same capacity. Either way the
+	contacts down are reported lifted, and reports still queued are
+	carried over to new storage.
+
+Arguments:
+
+	ControllerContext - Touch controller context
+
+Return Value:
+
+	NTSTATUS indicating success or failure
+
+--*/
+{
+	RMI4_FINGER_CACHE* cache = &ControllerContext->FingerCache;
+	ULONG fingers = ControllerContext->MaxFingers;
+	ULONG mapBytes = BITS_TO_WORDS(fingers) * sizeof(BITMAP_WORD);
+	ULONG queueCapacity;
+	SIZE_T slotsOffset;
+	SIZE_T filterOffset;
+	SIZE_T predictorOffset;
+	SIZE_T trackerOffset;
+	SIZE_T mapsOffset;
+	SIZE_T orderOffset;
+	SIZE_T size;
+	PUCHAR storage;
+	NTSTATUS status = STATUS_SUCCESS;
+
+	RmiResetFingerCache(ControllerContext);
+
+	if (ControllerContext->SlotStorage != NULL &&
+		ControllerContext->SlotCapacity == fingers)
+	{
+		goto exit;
+	}
+
+	//
+	// One frame reports at most every slot, lifted or down, and the lift
+	// of every contact whose slot the tracker saw taken over, which also
+	// held a slot on the previous frame. On top of those go the lifts a
+	// reset queues before the next interrupt is serviced.
+	//
+	queueCapacity =
+		DIV_ROUND_UP(2 * fingers, SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT) +
+		max(DIV_ROUND_UP(fingers, SYNAPTICS_TOUCH_DIGITIZER_FINGER_REPORT_COUNT),
+			(ULONG)ControllerContext->HidQueueCount) +
+		EXTRA_REPORTS_IN_QUEUE;
+
+	//
+	// Reports, then the slot, frame and report arrays, the filter and
+	// predictor state, the tracker, then the seven bitmaps, the report
+	// order and the contact IDs
+	//
+	slotsOffset = ALIGN_UP_BY(queueCapacity * sizeof(HID_INPUT_REPORT), sizeof(ULONG64));
+	filterOffset = ALIGN_UP_BY(slotsOffset + 3 * fingers * sizeof(RMI4_FINGER_INFO), sizeof(ULONG64));
+	predictorOffset = ALIGN_UP_BY(filterOffset + fingers * sizeof(RMI4_FILTER_STATE), sizeof(ULONG64));
+	trackerOffset = ALIGN_UP_BY(predictorOffset + fingers * sizeof(RMI4_PREDICTOR_STATE), sizeof(ULONG64));
+	mapsOffset = ALIGN_UP_BY(trackerOffset + sizeof(RMI4_CONTACT_TRACKER), sizeof(ULONG64));
+	orderOffset = mapsOffset + 7 * mapBytes;
+	size = orderOffset + 2 * fingers;
+
+	storage = ExAllocatePoolWithTag(NonPagedPoolNx, size, TOUCH_POOL_TAG);
+
+	if (storage == NULL)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_INIT,
+			"Could not allocate storage for %lu contacts",
+			fingers);
+
+		RmiFreeSlotStorage(ControllerContext);
+
+		status = STATUS_INSUFFICIENT_RESOURCES;
+		goto exit;
+	}
+
+	RtlZeroMemory(storage, size);
+
+	if (ControllerContext->HidQueueCount != 0)
+	{
+		RtlCopyMemory(
+			storage,
+			ControllerContext->HidQueue,
+			ControllerContext->HidQueueCount * sizeof(HID_INPUT_REPORT));
+	}
+
+	if (ControllerContext->SlotStorage != NULL)
+	{
+		ExFreePoolWithTag(ControllerContext->SlotStorage, TOUCH_POOL_TAG);
+	}
+
+	RtlZeroMemory(cache, sizeof(RMI4_FINGER_CACHE));
+
+	ControllerContext->SlotStorage = storage;
+	ControllerContext->SlotCapacity = (BYTE)fingers;
+	ControllerContext->HidQueue = (PHID_INPUT_REPORT)storage;
+	ControllerContext->HidQueueCapacity = (int)queueCapacity;
+
+	cache->FingerSlot = (RMI4_FINGER_INFO*)(storage + slotsOffset);
+	cache->Frame = cache->FingerSlot + fingers;
+	cache->Report = cache->Frame + fingers;
+	cache->Filter = (RMI4_FILTER_STATE*)(storage + filterOffset);
+	cache->Predictor = (RMI4_PREDICTOR_STATE*)(storage + predictorOffset);
+	cache->Tracker = (RMI4_CONTACT_TRACKER*)(storage + trackerOffset);
+	cache->FingerSlotValid = (BITMAP_WORD*)(storage + mapsOffset);
+	cache->FingerSlotDirty = (BITMAP_WORD*)(storage + mapsOffset + mapBytes);
+	cache->FrameValid = (BITMAP_WORD*)(storage + mapsOffset + 2 * mapBytes);
+	cache->KeyMask = (BITMAP_WORD*)(storage + mapsOffset + 3 * mapBytes);
+	cache->FilterPrimed = (BITMAP_WORD*)(storage + mapsOffset + 4 * mapBytes);
+	cache->ContactTracked = (BITMAP_WORD*)(storage + mapsOffset + 5 * mapBytes);
+	cache->ContactHidden = (BITMAP_WORD*)(storage + mapsOffset + 6 * mapBytes);
+	cache->FingerDownOrder = storage + orderOffset;
+	cache->ContactId = storage + orderOffset + fingers;
+
+	Trace(
+		TRACE_LEVEL_INFORMATION,
+		TRACE_FLAG_INIT,
+		"Tracking up to %lu contacts in %Iu bytes",
+		fingers,
+		size);
+
+exit:
+	return status;
+}
 
 NTSTATUS
 GetNextHidReport(
@@ -526,7 +961,7 @@ GetNextHidReport(
     IN PHID_INPUT_REPORT* HidReport
 )
 {
-    if(ControllerContext->HidQueueCount < MAX_REPORTS_IN_QUEUE)
+    if(ControllerContext->HidQueueCount < ControllerContext->HidQueueCapacity)
     {
         *HidReport = &(ControllerContext->HidQueue[ControllerContext->HidQueueCount]);
         ControllerContext->HidQueueCount++;
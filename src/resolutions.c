@@ -34,7 +34,7 @@
 // aligned.
 //
 
-TOUCH_SCREEN_PROPERTIES gDefaultProperties =
+static const TOUCH_SCREEN_PROPERTIES gDefaultProperties =
 {
 	0,
 	0,
@@ -62,151 +62,155 @@ TOUCH_SCREEN_PROPERTIES gDefaultProperties =
 };
 
 
-RTL_QUERY_REGISTRY_TABLE gResParamsRegTable[] =
+//
+// Read over the defaults above from the shared key and the device's
+// hardware key, see TchRegistryQueryTable
+//
+static const RTL_QUERY_REGISTRY_TABLE gResParamsRegTable[] =
 {
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchSwapAxes",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchSwapAxes),
-		REG_DWORD,
-		&gDefaultProperties.TouchSwapAxes,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchInvertXAxis",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchInvertXAxis),
-		REG_DWORD,
-		&gDefaultProperties.TouchInvertXAxis,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchInvertYAxis",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchInvertYAxis),
-		REG_DWORD,
-		&gDefaultProperties.TouchInvertYAxis,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchPhysicalWidth",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchPhysicalWidth),
-		REG_DWORD,
-		&gDefaultProperties.TouchPhysicalWidth,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchPhysicalHeight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchPhysicalHeight),
-		REG_DWORD,
-		&gDefaultProperties.TouchPhysicalHeight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchPhysicalButtonHeight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchPhysicalButtonHeight),
-		REG_DWORD,
-		&gDefaultProperties.TouchPhysicalButtonHeight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchPillarBoxWidthLeft",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchPillarBoxWidthLeft),
-		REG_DWORD,
-		&gDefaultProperties.TouchPillarBoxWidthLeft,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchPillarBoxWidthRight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchPillarBoxWidthRight),
-		REG_DWORD,
-		&gDefaultProperties.TouchPillarBoxWidthRight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchLetterBoxHeightTop",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchLetterBoxHeightTop),
-		REG_DWORD,
-		&gDefaultProperties.TouchLetterBoxHeightTop,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"TouchLetterBoxHeightBottom",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, TouchLetterBoxHeightBottom),
-		REG_DWORD,
-		&gDefaultProperties.TouchLetterBoxHeightBottom,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayPhysicalWidth",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayPhysicalWidth),
-		REG_DWORD,
-		&gDefaultProperties.DisplayPhysicalWidth,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayPhysicalHeight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayPhysicalHeight),
-		REG_DWORD,
-		&gDefaultProperties.DisplayPhysicalHeight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayViewableWidth",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayViewableWidth),
-		REG_DWORD,
-		&gDefaultProperties.DisplayViewableWidth,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayViewableHeight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayViewableHeight),
-		REG_DWORD,
-		&gDefaultProperties.DisplayViewableHeight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayPillarBoxWidthLeft",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayPillarBoxWidthLeft),
-		REG_DWORD,
-		&gDefaultProperties.DisplayPillarBoxWidthLeft,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayPillarBoxWidthRight",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayPillarBoxWidthRight),
-		REG_DWORD,
-		&gDefaultProperties.DisplayPillarBoxWidthRight,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayLetterBoxHeightTop",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayLetterBoxHeightTop),
-		REG_DWORD,
-		&gDefaultProperties.DisplayLetterBoxHeightTop,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	{
 		NULL, RTL_QUERY_REGISTRY_DIRECT,
 		L"DisplayLetterBoxHeightBottom",
 		(PVOID)FIELD_OFFSET(TOUCH_SCREEN_PROPERTIES, DisplayLetterBoxHeightBottom),
-		REG_DWORD,
-		&gDefaultProperties.DisplayLetterBoxHeightBottom,
-		sizeof(ULONG)
+		REG_NONE,
+		NULL,
+		0
 	},
 	//
 	// List Terminator - set to NULL to indicate end of table
@@ -221,12 +225,6 @@ RTL_QUERY_REGISTRY_TABLE gResParamsRegTable[] =
 	}
 };
 
-static const ULONG gcbRegistryTable = sizeof(gResParamsRegTable);
-static const ULONG gcRegistryTable =
-sizeof(gResParamsRegTable) / sizeof(gResParamsRegTable[0]);
-
-static counter = 0;
-
 VOID
 TchTranslateToDisplayCoordinates(
 	IN PUSHORT PX,
@@ -262,8 +260,6 @@ TchTranslateToDisplayCoordinates(
 	X = (ULONG)*PX;
 	Y = (ULONG)*PY;
 
-	Props->DisplayAdjustedButtonHeight;
-
 	//
 	 // Swap the axes reported by the touch controller if requested
 	 //
@@ -378,8 +374,9 @@ TchTranslateToDisplayCoordinates(
 	*PY = (USHORT)Y;
 }
 
-VOID
+NTSTATUS
 TchGetScreenProperties(
+	IN WDFDEVICE FxDevice,
 	IN PTOUCH_SCREEN_PROPERTIES Props
 )
 /*++
@@ -387,53 +384,23 @@ TchGetScreenProperties(
   Routine Description:
 
 	This routine retrieves coordinate translation settings
-	from the registry.
+	from the registry and derives the values used by
+	TchTranslateToDisplayCoordinates.
 
   Arguments:
 
+	FxDevice - a handle to the framework device object
 	Props - receives the Props
 
   Return Value:
 
-	None. On failure, defaults are returned.
+	STATUS_INVALID_PARAMETER if the settings leave no area to scale
+	coordinates over. Settings that cannot be read are defaulted.
 
 --*/
 {
-	ULONG i;
-	PRTL_QUERY_REGISTRY_TABLE regTable;
 	NTSTATUS status;
 
-	regTable = NULL;
-
-	//
-	// Table passed to RtlQueryRegistryValues must be allocated 
-	// from NonPagedPool
-	//
-	regTable = ExAllocatePoolWithTag(
-		NonPagedPool,
-		gcbRegistryTable,
-		TOUCH_POOL_TAG);
-
-	if (regTable == NULL)
-	{
-		return;
-	}
-
-	RtlCopyMemory(
-		regTable,
-		gResParamsRegTable,
-		gcbRegistryTable);
-
-	//
-	// Update offset values with base pointer
-	// 
-	for (i = 0; i < gcRegistryTable - 1; i++)
-	{
-		(regTable + i)->EntryContext = (PVOID)(
-			((SIZE_T)(regTable + i)->EntryContext) +
-			((ULONG_PTR)Props));
-	}
-
 	//
 	// Start with default values
 	//
@@ -443,14 +410,14 @@ TchGetScreenProperties(
 		sizeof(TOUCH_SCREEN_PROPERTIES));
 
 	//
-	// Populate device context with registry overrides (or defaults)
+	// Populate device context with registry overrides
 	//
-	status = RtlQueryRegistryValues(
-		RTL_REGISTRY_ABSOLUTE,
+	status = TchRegistryQueryTable(
+		FxDevice,
 		TOUCH_SCREEN_PROPERTIES_REG_KEY,
-		regTable,
-		NULL,
-		NULL);
+		gResParamsRegTable,
+		sizeof(gResParamsRegTable),
+		Props);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -480,7 +447,7 @@ TchGetScreenProperties(
 	{
 		Props->TouchPhysicalWidth = Props->DisplayPhysicalWidth;
 	}
-	if (Props->DisplayPhysicalHeight == 253)
+	if (Props->TouchPhysicalHeight == 253)
 	{
 		Props->TouchPhysicalHeight = Props->DisplayPhysicalHeight;
 	}
@@ -535,6 +502,36 @@ TchGetScreenProperties(
 			gDefaultProperties.TouchLetterBoxHeightBottom;
 	}
 
+	//
+	// The transform divides by the adjusted extents, reject settings
+	// whose borders or button area cover the whole screen
+	//
+	if (Props->TouchPillarBoxWidthLeft +
+		Props->TouchPillarBoxWidthRight >=
+		Props->TouchPhysicalWidth ||
+		Props->TouchLetterBoxHeightTop +
+		Props->TouchLetterBoxHeightBottom +
+		Props->TouchPhysicalButtonHeight >=
+		Props->TouchPhysicalHeight ||
+		Props->DisplayPillarBoxWidthLeft +
+		Props->DisplayPillarBoxWidthRight >=
+		Props->DisplayPhysicalWidth ||
+		Props->DisplayLetterBoxHeightTop +
+		Props->DisplayLetterBoxHeightBottom >=
+		Props->DisplayPhysicalHeight)
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_REGISTRY,
+			"Screen properties leave no touch or display area (%dx%d, %dx%d)",
+			Props->TouchPhysicalWidth,
+			Props->TouchPhysicalHeight,
+			Props->DisplayPhysicalWidth,
+			Props->DisplayPhysicalHeight);
+
+		return STATUS_INVALID_PARAMETER;
+	}
+
 	//
 	// Calculate a few parameters for later use
 	//
@@ -564,8 +561,5 @@ TchGetScreenProperties(
 		Props->DisplayLetterBoxHeightBottom +
 		Props->DisplayAdjustedButtonHeight;
 
-	if (regTable != NULL)
-	{
-		ExFreePoolWithTag(regTable, TOUCH_POOL_TAG);
-	}
+	return STATUS_SUCCESS;
 }
@@ -8,7 +8,8 @@
 
 	Abstract:
 
-		Contains all I2C-specific functionality
+		Contains the SPB target management and the transport
+		independent register access used by the touch core
 
 	Environment:
 
@@ -20,13 +21,15 @@
 
 #include "internal.h"
 #include "controller.h"
+#include "rmiinternal.h"
 #include "debug.h"
 //#include "spb.tmh"
 
 NTSTATUS
-SpbDoWriteDataSynchronously(
+SpbSendWrite(
 	IN SPB_CONTEXT* SpbContext,
-	IN UCHAR Address,
+	IN PUCHAR Header,
+	IN ULONG HeaderLength,
 	IN PVOID Data,
 	IN ULONG Length
 )
@@ -35,14 +38,16 @@ SpbDoWriteDataSynchronously(
   Routine Description:
 
 	This helper routine abstracts creating and sending an I/O
-	request (I2C Write) to the Spb I/O target.
+	request (Write) to the Spb I/O target. The transport header and
+	the data payload are sent in one transfer. Called with SpbLock held.
 
   Arguments:
 
-	SpbContext - Pointer to the current device context
-	Address    - The I2C register address to write to
-	Data       - A buffer to receive the data at at the above address
-	Length     - The amount of data to be read from the above address
+	SpbContext   - Pointer to the current device context
+	Header       - The transport header, the register address for I2C
+	HeaderLength - Size of the header in bytes
+	Data         - The payload following the header, may be NULL
+	Length       - The size of the payload
 
   Return Value:
 
@@ -52,15 +57,16 @@ SpbDoWriteDataSynchronously(
 {
 	PUCHAR buffer;
 	ULONG length;
+	ULONG_PTR bytesWritten = 0;
 	WDFMEMORY memory;
 	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
 	NTSTATUS status;
 
 	//
-	// The address pointer and data buffer must be combined
-	// into one contiguous buffer representing the write transaction.
+	// The header and data buffer must be combined into one
+	// contiguous buffer representing the write transaction.
 	//
-	length = Length + 1;
+	length = HeaderLength + Length;
 	memory = NULL;
 
 	if (length > DEFAULT_SPB_BUFFER_SIZE)
@@ -71,7 +77,7 @@ SpbDoWriteDataSynchronously(
 			TOUCH_POOL_TAG,
 			length,
 			&memory,
-			&buffer);
+			(PVOID*)&buffer);
 
 		if (!NT_SUCCESS(status))
 		{
@@ -99,14 +105,17 @@ SpbDoWriteDataSynchronously(
 	}
 
 	//
-	// Transaction starts by specifying the address bytes
+	// Transaction starts with the header
 	//
-	RtlCopyMemory(buffer, &Address, sizeof(Address));
+	RtlCopyMemory(buffer, Header, HeaderLength);
 
 	//
-	// Address is followed by the data payload
+	// Header is followed by the data payload
 	//
-	RtlCopyMemory((buffer + sizeof(Address)), Data, length - sizeof(Address));
+	if (Length != 0)
+	{
+		RtlCopyMemory((buffer + HeaderLength), Data, Length);
+	}
 
 	status = WdfIoTargetSendWriteSynchronously(
 		SpbContext->SpbIoTarget,
@@ -114,7 +123,17 @@ SpbDoWriteDataSynchronously(
 		&memoryDescriptor,
 		NULL,
 		NULL,
-		NULL);
+		&bytesWritten);
+
+	//
+	// A write the controller stopped acknowledging part way through
+	// left the registers partly written
+	//
+	if (NT_SUCCESS(status) &&
+		bytesWritten != length)
+	{
+		status = STATUS_DEVICE_DATA_ERROR;
+	}
 
 	if (!NT_SUCCESS(status))
 	{
@@ -136,6 +155,37 @@ exit:
 	return status;
 }
 
+NTSTATUS
+SpbSetPageRegister(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Page
+)
+/*++
+
+  Routine Description:
+
+	Maps in a register page by writing the RMI4 page select register,
+	which is present at the same offset on every page. Both the I2C and
+	the SPI transports page this way. Called with SpbLock held.
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Page       - The page to map in
+
+  Return Value:
+
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	return SpbContext->Transport->Write(
+		SpbContext,
+		(USHORT)((SpbContext->Page << 8) | RMI4_PAGE_SELECT_ADDRESS),
+		&Page,
+		sizeof(Page));
+}
+
 NTSTATUS
 SpbWriteDataSynchronously(
 	IN SPB_CONTEXT* SpbContext,
@@ -147,16 +197,15 @@ SpbWriteDataSynchronously(
 
   Routine Description:
 
-	This routine abstracts creating and sending an I/O
-	request (I2C Write) to the Spb I/O target and utilizes
-	a helper routine to do work inside of locked code.
+	This routine writes to a register of the page currently mapped in,
+	through the transport the controller is connected with.
 
   Arguments:
 
 	SpbContext - Pointer to the current device context
-	Address    - The I2C register address to write to
-	Data       - A buffer to receive the data at at the above address
-	Length     - The amount of data to be read from the above address
+	Address    - The register address to write to
+	Data       - A buffer holding the data to write at the above address
+	Length     - The amount of data to be written to the above address
 
   Return Value:
 
@@ -166,16 +215,24 @@ SpbWriteDataSynchronously(
 {
 	NTSTATUS status;
 
+	if (Length > SpbContext->Transport->MaxTransferSize)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto exit;
+	}
+
 	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
 
-	status = SpbDoWriteDataSynchronously(
+	status = SpbContext->Transport->Write(
 		SpbContext,
-		Address,
+		(USHORT)((SpbContext->Page << 8) | Address),
 		Data,
 		Length);
 
 	WdfWaitLockRelease(SpbContext->SpbLock);
 
+exit:
+
 	return status;
 }
 
@@ -190,13 +247,14 @@ SpbReadDataSynchronously(
 
   Routine Description:
 
-	This helper routine abstracts creating and sending an I/O
-	request (I2C Read) to the Spb I/O target.
+	This routine reads from a register of the page currently mapped in,
+	through the transport the controller is connected with. Reads are
+	one burst, callers split larger transfers by SpbGetMaxTransferSize.
 
   Arguments:
 
 	SpbContext - Pointer to the current device context
-	Address    - The I2C register address to read from
+	Address    - The register address to read from
 	Data       - A buffer to receive the data at at the above address
 	Length     - The amount of data to be read from the above address
 
@@ -206,106 +264,69 @@ SpbReadDataSynchronously(
 
 --*/
 {
-	PUCHAR buffer;
-	WDFMEMORY memory;
-	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
 	NTSTATUS status;
 
-#if ARM || X86
-	ULONG bytesRead;
-#else
-	ULONGLONG bytesRead;
-#endif
+	if (Length > SpbContext->Transport->MaxTransferSize)
+	{
+		status = STATUS_INVALID_BUFFER_SIZE;
+		goto exit;
+	}
 
 	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
 
-	memory = NULL;
-	status = STATUS_INVALID_PARAMETER;
-	bytesRead = 0;
-
-	//
-	// Read transactions start by writing an address pointer
-	//
-	status = SpbDoWriteDataSynchronously(
+	status = SpbContext->Transport->Read(
 		SpbContext,
-		Address,
-		NULL,
-		0);
+		(USHORT)((SpbContext->Page << 8) | Address),
+		Data,
+		Length);
 
-	if (!NT_SUCCESS(status))
-	{
-		Trace(
-			TRACE_LEVEL_ERROR,
-			TRACE_FLAG_SPB,
-			"Error setting address pointer for Spb read - STATUS:%X",
-			status);
-		goto exit;
-	}
+	WdfWaitLockRelease(SpbContext->SpbLock);
 
-	if (Length > DEFAULT_SPB_BUFFER_SIZE)
-	{
-		status = WdfMemoryCreate(
-			WDF_NO_OBJECT_ATTRIBUTES,
-			NonPagedPool,
-			TOUCH_POOL_TAG,
-			Length,
-			&memory,
-			&buffer);
+exit:
 
-		if (!NT_SUCCESS(status))
-		{
-			Trace(
-				TRACE_LEVEL_ERROR,
-				TRACE_FLAG_SPB,
-				"Error allocating memory for Spb read - STATUS:%X",
-				status);
-			goto exit;
-		}
+	return status;
+}
 
-		WDF_MEMORY_DESCRIPTOR_INIT_HANDLE(
-			&memoryDescriptor,
-			memory,
-			NULL);
-	}
-	else
-	{
-		buffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->ReadMemory, NULL);
+NTSTATUS
+SpbSetPage(
+	IN SPB_CONTEXT* SpbContext,
+	IN UCHAR Page
+)
+/*++
 
-		WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
-			&memoryDescriptor,
-			(PVOID)buffer,
-			Length);
-	}
+  Routine Description:
 
+	Maps in the register page later reads and writes address
 
-	status = WdfIoTargetSendReadSynchronously(
-		SpbContext->SpbIoTarget,
-		NULL,
-		&memoryDescriptor,
-		NULL,
-		NULL,
-		&bytesRead);
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Page       - The page to map in
+
+  Return Value:
 
-	if (!NT_SUCCESS(status) ||
-		bytesRead != Length)
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	NTSTATUS status;
+
+	WdfWaitLockAcquire(SpbContext->SpbLock, NULL);
+
+	status = SpbContext->Transport->SetPage(SpbContext, Page);
+
+	if (NT_SUCCESS(status))
+	{
+		SpbContext->Page = Page;
+	}
+	else
 	{
 		Trace(
 			TRACE_LEVEL_ERROR,
 			TRACE_FLAG_SPB,
-			"Error reading from Spb - STATUS:%X",
+			"Error selecting register page %d - STATUS:%X",
+			Page,
 			status);
-		goto exit;
-	}
-
-	//
-	// Copy back to the caller's buffer
-	//
-	RtlCopyMemory(Data, buffer, Length);
-
-exit:
-	if (NULL != memory)
-	{
-		WdfObjectDelete(memory);
 	}
 
 	WdfWaitLockRelease(SpbContext->SpbLock);
@@ -313,6 +334,29 @@ exit:
 	return status;
 }
 
+ULONG
+SpbGetMaxTransferSize(
+	IN SPB_CONTEXT* SpbContext
+)
+/*++
+
+  Routine Description:
+
+	Returns the largest payload the transport moves in one burst
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+
+  Return Value:
+
+	Size in bytes
+
+--*/
+{
+	return SpbContext->Transport->MaxTransferSize;
+}
+
 VOID
 SpbTargetDeinitialize(
 	IN WDFDEVICE FxDevice,
@@ -416,8 +460,8 @@ SpbTargetInitialize(
 
 	status = RESOURCE_HUB_CREATE_PATH_FROM_ID(
 		&spbDeviceName,
-		SpbContext->I2cResHubId.LowPart,
-		SpbContext->I2cResHubId.HighPart);
+		SpbContext->ResHubId.LowPart,
+		SpbContext->ResHubId.HighPart);
 
 	if (!NT_SUCCESS(status))
 	{
@@ -0,0 +1,190 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		spbi2c.c
+
+	Abstract:
+
+		RMI4 over I2C. A register is addressed by a single byte in the
+		page currently selected, reads write the address pointer and
+		then read the data in a second transfer.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "internal.h"
+#include "controller.h"
+#include "debug.h"
+//#include "spbi2c.tmh"
+
+static SPB_TRANSPORT_READ SpbI2cRead;
+static SPB_TRANSPORT_WRITE SpbI2cWrite;
+
+const SPB_TRANSPORT SpbI2cTransport =
+{
+	"I2C",
+	MAXUSHORT,
+	SpbI2cRead,
+	SpbI2cWrite,
+	SpbSetPageRegister
+};
+
+static
+NTSTATUS
+SpbI2cWrite(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	This routine sends an I2C write of the register address followed
+	by the data payload. Called with SpbLock held.
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Address    - The RMI address, only the low byte goes on the bus
+	Data       - A buffer holding the data to write at the above address
+	Length     - The amount of data to be written to the above address
+
+  Return Value:
+
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	UCHAR address = (UCHAR)(Address & 0xFF);
+
+	return SpbSendWrite(
+		SpbContext,
+		&address,
+		sizeof(address),
+		Data,
+		Length);
+}
+
+static
+NTSTATUS
+SpbI2cRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	This helper routine abstracts creating and sending an I/O
+	request (I2C Read) to the Spb I/O target. Called with SpbLock held.
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Address    - The RMI address, only the low byte goes on the bus
+	Data       - A buffer to receive the data at at the above address
+	Length     - The amount of data to be read from the above address
+
+  Return Value:
+
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	PUCHAR buffer;
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	NTSTATUS status;
+
+#if ARM || X86
+	ULONG bytesRead;
+#else
+	ULONGLONG bytesRead;
+#endif
+
+	bytesRead = 0;
+
+	//
+	// Read transactions start by writing an address pointer
+	//
+	status = SpbI2cWrite(
+		SpbContext,
+		Address,
+		NULL,
+		0);
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error setting address pointer for Spb read - STATUS:%X",
+			status);
+		goto exit;
+	}
+
+	if (Length > DEFAULT_SPB_BUFFER_SIZE)
+	{
+		//
+		// Large reads such as F54 reports go straight into the caller's
+		// buffer instead of a temporary allocation and a copy
+		//
+		buffer = (PUCHAR)Data;
+	}
+	else
+	{
+		buffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->ReadMemory, NULL);
+	}
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		(PVOID)buffer,
+		Length);
+
+	status = WdfIoTargetSendReadSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesRead);
+
+	if (NT_SUCCESS(status) &&
+		bytesRead != Length)
+	{
+		status = STATUS_DEVICE_DATA_ERROR;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error reading from Spb - STATUS:%X",
+			status);
+		goto exit;
+	}
+
+	//
+	// Copy back to the caller's buffer
+	//
+	if (buffer != Data)
+	{
+		RtlCopyMemory(Data, buffer, Length);
+	}
+
+exit:
+
+	return status;
+}
@@ -0,0 +1,199 @@
+/*++
+	Copyright (c) Microsoft Corporation. All Rights Reserved.
+	Sample code. Dealpoint ID #843729.
+
+	Module Name:
+
+		spbspi.c
+
+	Abstract:
+
+		RMI4 over SPI. Every transfer starts with a two byte header
+		holding the 16 bit register address, the top bit of the first
+		byte set for reads. A read is sent as one SPB sequence so chip
+		select stays asserted between the header and the data.
+
+	Environment:
+
+		Kernel mode
+
+	Revision History:
+
+--*/
+
+#include "internal.h"
+#include "controller.h"
+#include "debug.h"
+#include <spb.h>
+//#include "spbspi.tmh"
+
+#define RMI_SPI_READ                0x80
+#define RMI_SPI_HEADER_SIZE         2
+
+//
+// Some parts need time between the header and the first data byte
+//
+#define RMI_SPI_READ_DELAY_US       0
+
+static SPB_TRANSPORT_READ SpbSpiRead;
+static SPB_TRANSPORT_WRITE SpbSpiWrite;
+
+const SPB_TRANSPORT SpbSpiTransport =
+{
+	"SPI",
+	MAXUSHORT,
+	SpbSpiRead,
+	SpbSpiWrite,
+	SpbSetPageRegister
+};
+
+static
+NTSTATUS
+SpbSpiWrite(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	This routine sends the write header followed by the data payload in
+	a single SPI transfer. Called with SpbLock held.
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Address    - The 16 bit RMI address to write to
+	Data       - A buffer holding the data to write at the above address
+	Length     - The amount of data to be written to the above address
+
+  Return Value:
+
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	UCHAR header[RMI_SPI_HEADER_SIZE];
+
+	header[0] = (UCHAR)((Address >> 8) & ~RMI_SPI_READ);
+	header[1] = (UCHAR)(Address & 0xFF);
+
+	return SpbSendWrite(
+		SpbContext,
+		header,
+		sizeof(header),
+		Data,
+		Length);
+}
+
+static
+NTSTATUS
+SpbSpiRead(
+	IN SPB_CONTEXT* SpbContext,
+	IN USHORT Address,
+	IN PVOID Data,
+	IN ULONG Length
+)
+/*++
+
+  Routine Description:
+
+	This routine reads a register range with one SPB sequence, the read
+	header is written and the data read back without releasing chip
+	select. Called with SpbLock held.
+
+  Arguments:
+
+	SpbContext - Pointer to the current device context
+	Address    - The 16 bit RMI address to read from
+	Data       - A buffer to receive the data at at the above address
+	Length     - The amount of data to be read from the above address
+
+  Return Value:
+
+	NTSTATUS Status indicating success or failure
+
+--*/
+{
+	SPB_TRANSFER_LIST_AND_ENTRIES(2) sequence;
+	WDF_MEMORY_DESCRIPTOR memoryDescriptor;
+	PUCHAR header;
+	PUCHAR buffer;
+	NTSTATUS status;
+	ULONG_PTR bytesTransferred = 0;
+
+	//
+	// The header and small reads use the default buffers, large reads
+	// such as F54 reports go straight into the caller's buffer
+	//
+	header = (PUCHAR)WdfMemoryGetBuffer(SpbContext->WriteMemory, NULL);
+	header[0] = (UCHAR)((Address >> 8) | RMI_SPI_READ);
+	header[1] = (UCHAR)(Address & 0xFF);
+
+	if (Length > DEFAULT_SPB_BUFFER_SIZE)
+	{
+		buffer = (PUCHAR)Data;
+	}
+	else
+	{
+		buffer = (PUCHAR)WdfMemoryGetBuffer(SpbContext->ReadMemory, NULL);
+	}
+
+	SPB_TRANSFER_LIST_INIT(&(sequence.List), 2);
+
+	sequence.List.Transfers[0] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionToDevice,
+		0,
+		header,
+		RMI_SPI_HEADER_SIZE);
+
+	sequence.List.Transfers[1] = SPB_TRANSFER_LIST_ENTRY_INIT_SIMPLE(
+		SpbTransferDirectionFromDevice,
+		RMI_SPI_READ_DELAY_US,
+		buffer,
+		Length);
+
+	WDF_MEMORY_DESCRIPTOR_INIT_BUFFER(
+		&memoryDescriptor,
+		&sequence,
+		sizeof(sequence));
+
+	status = WdfIoTargetSendIoctlSynchronously(
+		SpbContext->SpbIoTarget,
+		NULL,
+		IOCTL_SPB_EXECUTE_SEQUENCE,
+		&memoryDescriptor,
+		NULL,
+		NULL,
+		&bytesTransferred);
+
+	if (NT_SUCCESS(status) &&
+		bytesTransferred != RMI_SPI_HEADER_SIZE + Length)
+	{
+		status = STATUS_DEVICE_DATA_ERROR;
+	}
+
+	if (!NT_SUCCESS(status))
+	{
+		Trace(
+			TRACE_LEVEL_ERROR,
+			TRACE_FLAG_SPB,
+			"Error reading from Spb - STATUS:%X",
+			status);
+		goto exit;
+	}
+
+	//
+	// Copy back to the caller's buffer
+	//
+	if (buffer != Data)
+	{
+		RtlCopyMemory(Data, buffer, Length);
+	}
+
+exit:
+
+	return status;
+}